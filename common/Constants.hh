@@ -37,5 +37,7 @@ static constexpr auto RETRIEVE_FAILED_WORKFLOW_NAME = "retrieve_failed";
 static constexpr auto ARCHIVE_FAILED_WORKFLOW_NAME = "archive_failed";
 static constexpr auto WF_CUSTOM_ATTRIBUTES_TO_FST_EQUALS = "=";
 static constexpr auto WF_CUSTOM_ATTRIBUTES_TO_FST_SEPARATOR = ";;;";
+static constexpr auto INLINE_BUFFER_ATTR_NAME = "sys.file.buffer";
+static constexpr auto INLINE_ONLY_ATTR_NAME = "sys.file.inline.only";
 
 EOSCOMMONNAMESPACE_END
\ No newline at end of file
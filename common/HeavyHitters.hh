@@ -0,0 +1,244 @@
+//------------------------------------------------------------------------------
+//! @file HeavyHitters.hh
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#pragma once
+#include "common/Namespace.hh"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+EOSCOMMONNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Class HeavyHitters - bounded memory top-k tracking of weighted keys using
+//! the Space-Saving algorithm. At most "capacity" keys are monitored, kept in
+//! a min-heap ordered by their counter. A new key replaces the key with the
+//! smallest counter and inherits its counter as error. Every reported counter
+//! overestimates the true weight of its key by at most its error, which is
+//! itself bounded by Total() / capacity. Any key with a true weight above
+//! this bound is guaranteed to be monitored.
+//!
+//! Each key also carries an auxiliary counter which is accumulated only while
+//! the key is monitored e.g. the number of bytes read for a key ranked by
+//! number of accesses. The class is not thread-safe.
+//------------------------------------------------------------------------------
+class HeavyHitters
+{
+public:
+  //! Monitored key as returned by Top
+  struct Entry {
+    std::string mKey; ///< Key
+    uint64_t mCount; ///< Estimated weight, never below the true weight
+    uint64_t mError; ///< Maximum overestimation of the weight
+    uint64_t mAux; ///< Auxiliary counter accumulated while monitored
+  };
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param capacity maximum number of monitored keys
+  //----------------------------------------------------------------------------
+  explicit HeavyHitters(size_t capacity = 1024):
+    mCapacity(capacity ? capacity : 1), mTotal(0)
+  {}
+
+  //----------------------------------------------------------------------------
+  //! Add weight to a key
+  //!
+  //! @param key key
+  //! @param weight weight to add to the key counter
+  //! @param aux value to add to the auxiliary counter
+  //----------------------------------------------------------------------------
+  void Add(const std::string& key, uint64_t weight = 1, uint64_t aux = 0)
+  {
+    mTotal += weight;
+    auto it = mIndex.find(key);
+
+    if (it != mIndex.end()) {
+      Slot& slot = mHeap[it->second];
+      slot.mCount += weight;
+      slot.mAux += aux;
+      SiftDown(it->second);
+      return;
+    }
+
+    if (mHeap.size() < mCapacity) {
+      it = mIndex.emplace(key, mHeap.size()).first;
+      mHeap.push_back(Slot{&*it, weight, 0, aux});
+      SiftUp(mHeap.size() - 1);
+      return;
+    }
+
+    // Evict the key with the smallest counter, the new key inherits it
+    Slot& min = mHeap[0];
+    mIndex.erase(min.mNode->first);
+    it = mIndex.emplace(key, 0).first;
+    min.mNode = &*it;
+    min.mError = min.mCount;
+    min.mCount += weight;
+    min.mAux = aux;
+    SiftDown(0);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the k keys with the highest counters sorted in descending order,
+  //! keys with equal counters are sorted alphabetically
+  //----------------------------------------------------------------------------
+  std::vector<Entry> Top(size_t k) const
+  {
+    std::vector<const Slot*> slots;
+    slots.reserve(mHeap.size());
+
+    for (const auto& slot : mHeap) {
+      slots.push_back(&slot);
+    }
+
+    k = std::min(k, slots.size());
+    std::partial_sort(slots.begin(), slots.begin() + k, slots.end(),
+    [](const Slot * l, const Slot * r) {
+      if (l->mCount == r->mCount) {
+        return (l->mNode->first < r->mNode->first);
+      }
+
+      return (l->mCount > r->mCount);
+    });
+    std::vector<Entry> top;
+    top.reserve(k);
+
+    for (size_t i = 0; i < k; ++i) {
+      top.push_back(Entry{slots[i]->mNode->first, slots[i]->mCount,
+                          slots[i]->mError, slots[i]->mAux});
+    }
+
+    return top;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the upper bound of the error of any reported counter
+  //----------------------------------------------------------------------------
+  inline uint64_t MaxError() const
+  {
+    return (mHeap.size() < mCapacity) ? 0 : mHeap[0].mCount;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the total weight added since the last reset
+  //----------------------------------------------------------------------------
+  inline uint64_t Total() const
+  {
+    return mTotal;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get number of monitored keys
+  //----------------------------------------------------------------------------
+  inline size_t Size() const
+  {
+    return mHeap.size();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Remove all the keys
+  //----------------------------------------------------------------------------
+  void Clear()
+  {
+    mHeap.clear();
+    mHeap.shrink_to_fit();
+    mIndex.clear();
+    mTotal = 0;
+  }
+
+private:
+  typedef std::unordered_map<std::string, size_t> IndexMap;
+
+  //! Heap slot pointing to the index map node holding its key and position
+  struct Slot {
+    IndexMap::value_type* mNode;
+    uint64_t mCount;
+    uint64_t mError;
+    uint64_t mAux;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Swap two heap slots and update the index
+  //----------------------------------------------------------------------------
+  inline void Swap(size_t a, size_t b)
+  {
+    std::swap(mHeap[a], mHeap[b]);
+    mHeap[a].mNode->second = a;
+    mHeap[b].mNode->second = b;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Move slot towards the root while smaller than its parent
+  //----------------------------------------------------------------------------
+  void SiftUp(size_t pos)
+  {
+    while (pos) {
+      size_t parent = (pos - 1) / 2;
+
+      if (mHeap[parent].mCount <= mHeap[pos].mCount) {
+        break;
+      }
+
+      Swap(parent, pos);
+      pos = parent;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Move slot towards the leaves while bigger than any of its children
+  //----------------------------------------------------------------------------
+  void SiftDown(size_t pos)
+  {
+    while (true) {
+      size_t min = pos;
+      size_t left = 2 * pos + 1;
+      size_t right = left + 1;
+
+      if ((left < mHeap.size()) && (mHeap[left].mCount < mHeap[min].mCount)) {
+        min = left;
+      }
+
+      if ((right < mHeap.size()) && (mHeap[right].mCount < mHeap[min].mCount)) {
+        min = right;
+      }
+
+      if (min == pos) {
+        break;
+      }
+
+      Swap(min, pos);
+      pos = min;
+    }
+  }
+
+  size_t mCapacity; ///< Maximum number of monitored keys
+  uint64_t mTotal; ///< Total weight added
+  std::vector<Slot> mHeap; ///< Min-heap of monitored keys by counter
+  //! Map of monitored keys to their position in the heap
+  IndexMap mIndex;
+};
+
+EOSCOMMONNAMESPACE_END
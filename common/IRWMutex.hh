@@ -58,6 +58,13 @@ public:
   //----------------------------------------------------------------------------
   virtual int TimedRdLock(uint64_t timeout_ns) = 0;
 
+  //----------------------------------------------------------------------------
+  //! Try to read lock the mutex without blocking
+  //!
+  //! @return 0 if successful, otherwise error number
+  //----------------------------------------------------------------------------
+  virtual int TryLockRead() = 0;
+
   //----------------------------------------------------------------------------
   //! Lock for write
   //----------------------------------------------------------------------------
@@ -76,6 +83,13 @@ public:
   //! @return 0 if successful, otherwise error number
   //----------------------------------------------------------------------------
   virtual int TimedWrLock(uint64_t timeout_ns) = 0;
+
+  //----------------------------------------------------------------------------
+  //! Try to write lock the mutex without blocking
+  //!
+  //! @return 0 if successful, otherwise error number
+  //----------------------------------------------------------------------------
+  virtual int TryLockWrite() = 0;
 };
 
 EOSCOMMONNAMESPACE_END
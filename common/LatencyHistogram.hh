@@ -0,0 +1,307 @@
+//------------------------------------------------------------------------------
+//! @file LatencyHistogram.hh
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#pragma once
+#include "common/Namespace.hh"
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+EOSCOMMONNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Class LatencyHistogram - log-linear histogram of latencies in microseconds
+//! in the spirit of HDR histograms. Every power of two is split into
+//! sSubBuckets linear buckets, which bounds the relative error of any
+//! percentile to 1/sSubBuckets while keeping the histogram small enough to be
+//! merged and kept per time window. Values above the range end up in the
+//! last bucket.
+//------------------------------------------------------------------------------
+class LatencyHistogram
+{
+public:
+  //! Number of linear sub-buckets per power of two, as a power of two
+  static constexpr int sSubBits = 3;
+  static constexpr int sSubBuckets = 1 << sSubBits;
+  //! Highest power of two covered i.e. 2^31 us ~ 35 minutes
+  static constexpr int sMaxExp = 31;
+  //! Total number of buckets
+  static constexpr int sNumBins = (sMaxExp - sSubBits + 2) * sSubBuckets;
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //----------------------------------------------------------------------------
+  LatencyHistogram()
+  {
+    Clear();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get bucket index for a value
+  //----------------------------------------------------------------------------
+  static inline int BucketIndex(uint64_t value)
+  {
+    if (value < (uint64_t) sSubBuckets) {
+      return (int) value;
+    }
+
+    int exp = 63 - __builtin_clzll(value);
+
+    if (exp > sMaxExp) {
+      return sNumBins - 1;
+    }
+
+    int sub = (int)((value >> (exp - sSubBits)) & (sSubBuckets - 1));
+    return (exp - sSubBits + 1) * sSubBuckets + sub;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the lowest value falling into a bucket
+  //----------------------------------------------------------------------------
+  static inline uint64_t BucketLow(int index)
+  {
+    if (index < sSubBuckets) {
+      return (uint64_t) index;
+    }
+
+    int exp = index / sSubBuckets + sSubBits - 1;
+    uint64_t sub = (uint64_t)(index % sSubBuckets);
+    return ((uint64_t) sSubBuckets + sub) << (exp - sSubBits);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the value representing a bucket i.e. its midpoint
+  //----------------------------------------------------------------------------
+  static inline double BucketValue(int index)
+  {
+    if (index < sSubBuckets) {
+      return (double) index;
+    }
+
+    uint64_t low = BucketLow(index);
+    uint64_t width = 1ull << (index / sSubBuckets - 1);
+    return low + (width - 1) / 2.0;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Add value to the histogram
+  //----------------------------------------------------------------------------
+  inline void Add(uint64_t value, uint64_t count = 1)
+  {
+    mBins[BucketIndex(value)] += count;
+    mCount += count;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Add count to a bucket
+  //----------------------------------------------------------------------------
+  inline void AddBin(int index, uint64_t count)
+  {
+    mBins[index] += count;
+    mCount += count;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Merge another histogram into this one
+  //----------------------------------------------------------------------------
+  void Merge(const LatencyHistogram& other)
+  {
+    if (!other.mCount) {
+      return;
+    }
+
+    for (int i = 0; i < sNumBins; ++i) {
+      mBins[i] += other.mBins[i];
+    }
+
+    mCount += other.mCount;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Reset the histogram
+  //----------------------------------------------------------------------------
+  void Clear()
+  {
+    memset(mBins, 0, sizeof(mBins));
+    mCount = 0;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get number of values in the histogram
+  //----------------------------------------------------------------------------
+  inline uint64_t Count() const
+  {
+    return mCount;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the value at the given quantile
+  //!
+  //! @param quantile value between 0 and 1 e.g. 0.99 for the 99th percentile
+  //!
+  //! @return value at quantile or 0 if the histogram is empty
+  //----------------------------------------------------------------------------
+  double Percentile(double quantile) const
+  {
+    if (!mCount) {
+      return 0;
+    }
+
+    uint64_t rank = (uint64_t)(quantile * mCount + 0.5);
+
+    if (rank < 1) {
+      rank = 1;
+    } else if (rank > mCount) {
+      rank = mCount;
+    }
+
+    uint64_t seen = 0;
+
+    for (int i = 0; i < sNumBins; ++i) {
+      seen += mBins[i];
+
+      if (seen >= rank) {
+        return BucketValue(i);
+      }
+    }
+
+    return BucketValue(sNumBins - 1);
+  }
+
+private:
+  uint64_t mBins[sNumBins]; ///< Bucket counters
+  uint64_t mCount; ///< Total number of values
+};
+
+//------------------------------------------------------------------------------
+//! Class LatencyWindows - latency histograms over the last 5s, 1min, 5min
+//! and 1h. Each window is a ring of histograms covering a fixed time slice,
+//! slices which fell out of the window are reset lazily. The resolution of a
+//! window is its length divided by the number of slices.
+//------------------------------------------------------------------------------
+class LatencyWindows
+{
+public:
+  //! Window identifiers
+  enum Window {
+    k5s = 0,
+    k60s = 1,
+    k300s = 2,
+    k3600s = 3,
+    kNumWindows = 4
+  };
+
+  //----------------------------------------------------------------------------
+  //! Get window name as used in the monitoring output
+  //----------------------------------------------------------------------------
+  static const char* GetName(int window)
+  {
+    static const char* names[kNumWindows] = {"5s", "60s", "300s", "3600s"};
+    return names[window];
+  }
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //----------------------------------------------------------------------------
+  LatencyWindows() = default;
+
+  //----------------------------------------------------------------------------
+  //! Add histogram collected at time now to all the windows
+  //----------------------------------------------------------------------------
+  void Add(const LatencyHistogram& hist, time_t now = time(0))
+  {
+    for (int w = 0; w < kNumWindows; ++w) {
+      Ring& ring = mRings[w];
+      int64_t slot = (int64_t) now / SliceLen(w);
+      int pos = (int)(slot % NumSlices(w));
+
+      if (ring.mStamp[pos] != slot) {
+        ring.mSlices[pos].Clear();
+        ring.mStamp[pos] = slot;
+      }
+
+      ring.mSlices[pos].Merge(hist);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get histogram of a window at time now
+  //----------------------------------------------------------------------------
+  LatencyHistogram Get(int window, time_t now = time(0)) const
+  {
+    LatencyHistogram hist;
+    const Ring& ring = mRings[window];
+    int64_t slot = (int64_t) now / SliceLen(window);
+
+    for (int i = 0; i < NumSlices(window); ++i) {
+      if ((ring.mStamp[i] > slot - NumSlices(window)) &&
+          (ring.mStamp[i] <= slot)) {
+        hist.Merge(ring.mSlices[i]);
+      }
+    }
+
+    return hist;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Reset all the windows
+  //----------------------------------------------------------------------------
+  void Clear()
+  {
+    for (int w = 0; w < kNumWindows; ++w) {
+      for (int i = 0; i < sMaxSlices; ++i) {
+        mRings[w].mSlices[i].Clear();
+        mRings[w].mStamp[i] = 0;
+      }
+    }
+  }
+
+private:
+  static constexpr int sMaxSlices = 12;
+
+  //----------------------------------------------------------------------------
+  //! Number of slices of a window
+  //----------------------------------------------------------------------------
+  static inline int NumSlices(int window)
+  {
+    static const int slices[kNumWindows] = {5, 12, 10, 12};
+    return slices[window];
+  }
+
+  //----------------------------------------------------------------------------
+  //! Length of a slice of a window in seconds
+  //----------------------------------------------------------------------------
+  static inline int SliceLen(int window)
+  {
+    static const int length[kNumWindows] = {1, 5, 30, 300};
+    return length[window];
+  }
+
+  struct Ring {
+    LatencyHistogram mSlices[sMaxSlices];
+    int64_t mStamp[sMaxSlices] = {0};
+  };
+
+  Ring mRings[kNumWindows]; ///< One ring of slices per window
+};
+
+EOSCOMMONNAMESPACE_END
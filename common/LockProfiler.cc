@@ -0,0 +1,653 @@
+//------------------------------------------------------------------------------
+// File: LockProfiler.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "common/LockProfiler.hh"
+#include <algorithm>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+EOSCOMMONNAMESPACE_BEGIN
+
+namespace
+{
+//------------------------------------------------------------------------------
+//! Add to a counter only written by the owning thread - a plain load and
+//! store is enough and avoids the locked instruction of fetch_add
+//------------------------------------------------------------------------------
+template<typename T>
+inline void
+OwnerAdd(std::atomic<T>& counter, T value)
+{
+  counter.store(counter.load(std::memory_order_relaxed) + value,
+                std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+//! Per-thread set-associative cache of call sites to site ids, so call sites
+//! mapping to the same set don't keep evicting each other. Only trivially
+//! destructible thread locals are used on the lock path since locks can still
+//! be taken while the thread locals of an exiting thread are destroyed.
+//------------------------------------------------------------------------------
+struct SiteCacheEntry {
+  const char* mName;
+  const char* mFile;
+  int mLine;
+  int mWrite;
+  int mId;
+};
+
+constexpr size_t sSiteCacheSets = 64;
+constexpr size_t sSiteCacheWays = 4;
+
+struct SiteCacheSet {
+  SiteCacheEntry mWays[sSiteCacheWays];
+  uint32_t mVictim; ///< Next way to replace
+};
+
+thread_local SiteCacheSet tlSiteCache[sSiteCacheSets];
+
+//------------------------------------------------------------------------------
+//! Hash of the content of a call site - the same header can have different
+//! file pointers in different units
+//------------------------------------------------------------------------------
+inline size_t
+SiteHash(const char* name, const char* file, int line, bool write)
+{
+  size_t h = 14695981039346656037ull;
+
+  for (const char* s = name; *s; ++s) {
+    h = (h ^ (unsigned char) *s) * 1099511628211ull;
+  }
+
+  h = (h ^ 0xff) * 1099511628211ull;
+
+  for (const char* s = file; *s; ++s) {
+    h = (h ^ (unsigned char) *s) * 1099511628211ull;
+  }
+
+  h = (h ^ (size_t) line) * 1099511628211ull;
+  return (h ^ (size_t) write) * 1099511628211ull;
+}
+
+//------------------------------------------------------------------------------
+//! Locks of the calling thread whose hold time is measured
+//------------------------------------------------------------------------------
+struct HeldLock {
+  const void* mLock;
+  int mId;
+  uint64_t mStart;
+};
+
+struct HeldStack {
+  HeldLock mLocks[LockProfiler::sMaxHeld];
+  int mSize;
+  uint32_t mCount; ///< Acquisitions used for the hold time sampling
+};
+
+thread_local HeldStack tlHeld;
+thread_local LockProfiler::Shard* tlShard = nullptr;
+thread_local bool tlExited = false;
+}
+
+//------------------------------------------------------------------------------
+//! Returns the shard of an exiting thread to the pool
+//------------------------------------------------------------------------------
+struct ThreadProfile {
+  ~ThreadProfile()
+  {
+    tlExited = true;
+
+    if (tlShard) {
+      LockProfiler::GetInstance().ReleaseShard(tlShard);
+      tlShard = nullptr;
+    }
+  }
+};
+
+namespace
+{
+thread_local ThreadProfile tlProfile;
+}
+
+std::atomic<bool> LockProfiler::sEnabled(false);
+
+//------------------------------------------------------------------------------
+// SiteCounters constructor
+//------------------------------------------------------------------------------
+LockProfiler::SiteCounters::SiteCounters()
+{
+  for (int i = 0; i < LatencyHistogram::sNumBins; ++i) {
+    mWaitHist[i].store(0, std::memory_order_relaxed);
+    mHoldHist[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Shard constructor
+//------------------------------------------------------------------------------
+LockProfiler::Shard::Shard()
+{
+  for (int i = 0; i < sMaxSites; ++i) {
+    mSites[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Shard destructor
+//------------------------------------------------------------------------------
+LockProfiler::Shard::~Shard()
+{
+  for (int i = 0; i < sMaxSites; ++i) {
+    delete mSites[i].load(std::memory_order_relaxed);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Get singleton instance - never destroyed since locks are taken until the
+// very end of the process
+//------------------------------------------------------------------------------
+LockProfiler&
+LockProfiler::GetInstance()
+{
+  static LockProfiler* instance = new LockProfiler();
+  return *instance;
+}
+
+//------------------------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------------------------
+LockProfiler::LockProfiler():
+  mNumSites(0)
+{
+  for (int i = 0; i < sMaxSites; ++i) {
+    mSites[i].store(nullptr, std::memory_order_relaxed);
+  }
+
+  for (int i = 0; i < sSiteTableSize; ++i) {
+    mSiteTable[i].store(nullptr, std::memory_order_relaxed);
+  }
+
+  const char* env = getenv("EOS_LOCK_PROFILER");
+
+  if (env && !strcmp(env, "1")) {
+    sEnabled = true;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Get monotonic time in nanoseconds
+//------------------------------------------------------------------------------
+uint64_t
+LockProfiler::GetNowInNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (1000000000ull * ts.tv_sec + ts.tv_nsec);
+}
+
+//------------------------------------------------------------------------------
+// Find a registered call site in the site table, lock-free
+//------------------------------------------------------------------------------
+int
+LockProfiler::FindSite(size_t hash, const char* name, const LockCallSite& site,
+                       bool write, size_t& slot) const
+{
+  for (int probe = 0; probe < sSiteTableSize; ++probe) {
+    slot = (hash + probe) % sSiteTableSize;
+    const Site* entry = mSiteTable[slot].load(std::memory_order_acquire);
+
+    if (!entry) {
+      return -1;
+    }
+
+    if ((entry->mHash == hash) && (entry->mLine == site.mLine) &&
+        (entry->mWrite == write) && (entry->mLock == name) &&
+        (entry->mFile == site.mFile)) {
+      return entry->mId;
+    }
+  }
+
+  slot = sSiteTableSize;
+  return -1;
+}
+
+//------------------------------------------------------------------------------
+// Get the id of a call site, registers it if needed
+//------------------------------------------------------------------------------
+int
+LockProfiler::GetSiteId(const char* name, const LockCallSite& site,
+                        bool write)
+{
+  SiteCacheSet& set = tlSiteCache[((((uintptr_t) site.mFile) >> 3) +
+                                   site.mLine * 31 + (((uintptr_t) name) >> 3) +
+                                   write) % sSiteCacheSets];
+
+  for (size_t way = 0; way < sSiteCacheWays; ++way) {
+    SiteCacheEntry& entry = set.mWays[way];
+
+    if ((entry.mFile == site.mFile) && (entry.mLine == site.mLine) &&
+        (entry.mName == name) && (entry.mWrite == (int) write)) {
+      return entry.mId;
+    }
+  }
+
+  size_t hash = SiteHash(name, site.mFile, site.mLine, write);
+  size_t slot;
+  int id = FindSite(hash, name, site, write, slot);
+
+  if (id < 0) {
+    std::lock_guard<std::mutex> lock(mSiteMutex);
+    id = FindSite(hash, name, site, write, slot);
+    int num_sites = mNumSites.load(std::memory_order_relaxed);
+
+    if ((id < 0) && (slot < (size_t) sSiteTableSize) &&
+        (num_sites < sMaxSites)) {
+      // Sites are immutable once published and never freed
+      Site* entry = new Site{name, site.mFunction, site.mFile, site.mLine,
+                             write, hash, num_sites};
+      mSites[num_sites].store(entry, std::memory_order_relaxed);
+      mNumSites.store(num_sites + 1, std::memory_order_release);
+      mSiteTable[slot].store(entry, std::memory_order_release);
+      id = num_sites;
+    }
+  }
+
+  SiteCacheEntry& entry = set.mWays[set.mVictim++ % sSiteCacheWays];
+  entry.mName = name;
+  entry.mFile = site.mFile;
+  entry.mLine = site.mLine;
+  entry.mWrite = write;
+  entry.mId = id;
+  return id;
+}
+
+//------------------------------------------------------------------------------
+// Get the shard of the calling thread
+//------------------------------------------------------------------------------
+LockProfiler::Shard*
+LockProfiler::GetShard()
+{
+  if (tlShard || tlExited) {
+    return tlShard;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!mFree.empty()) {
+      tlShard = mFree.back();
+      mFree.pop_back();
+    } else {
+      mShards.emplace_back(new Shard());
+      tlShard = mShards.back().get();
+    }
+  }
+  // Touch the guard so that it gets constructed and gives the shard back
+  (void) &tlProfile;
+  return tlShard;
+}
+
+//------------------------------------------------------------------------------
+// Return the shard of an exiting thread to the pool
+//------------------------------------------------------------------------------
+void
+LockProfiler::ReleaseShard(Shard* shard)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  mFree.push_back(shard);
+}
+
+//------------------------------------------------------------------------------
+// Record a lock acquisition by the calling thread
+//------------------------------------------------------------------------------
+void
+LockProfiler::Acquired(const void* lock, const char* name,
+                       const LockCallSite& site, bool write,
+                       uint64_t wait_start)
+{
+  int id = GetSiteId(name, site, write);
+  Shard* shard = GetShard();
+
+  if ((id < 0) || !shard) {
+    return;
+  }
+
+  SiteCounters* counters = shard->mSites[id].load(std::memory_order_relaxed);
+
+  if (!counters) {
+    counters = new SiteCounters();
+    shard->mSites[id].store(counters, std::memory_order_release);
+  }
+
+  OwnerAdd(counters->mAcquired, (uint64_t) 1);
+  uint64_t now = 0;
+
+  if (wait_start) {
+    now = GetNowInNs();
+    uint64_t wait_us = (now - wait_start) / 1000;
+    OwnerAdd(counters->mContended, (uint64_t) 1);
+    OwnerAdd(counters->mWaitSum, wait_us);
+    OwnerAdd(counters->mWaitHist[LatencyHistogram::BucketIndex(wait_us)],
+             (uint32_t) 1);
+  }
+
+  // Contended acquisitions are always sampled, the others every n-th time
+  if ((wait_start || ((++tlHeld.mCount % sHoldSampling) == 0)) &&
+      (tlHeld.mSize < sMaxHeld)) {
+    HeldLock& held = tlHeld.mLocks[tlHeld.mSize++];
+    held.mLock = lock;
+    held.mId = id;
+    held.mStart = (now ? now : GetNowInNs());
+  }
+}
+
+//------------------------------------------------------------------------------
+// Record a lock release by the calling thread
+//------------------------------------------------------------------------------
+void
+LockProfiler::Released(const void* lock)
+{
+  if (!tlHeld.mSize) {
+    return;
+  }
+
+  for (int i = tlHeld.mSize - 1; i >= 0; --i) {
+    if (tlHeld.mLocks[i].mLock != lock) {
+      continue;
+    }
+
+    HeldLock held = tlHeld.mLocks[i];
+
+    for (int j = i + 1; j < tlHeld.mSize; ++j) {
+      tlHeld.mLocks[j - 1] = tlHeld.mLocks[j];
+    }
+
+    --tlHeld.mSize;
+
+    // The shard can be gone if the thread is exiting
+    if (!tlShard) {
+      return;
+    }
+
+    SiteCounters* counters =
+      tlShard->mSites[held.mId].load(std::memory_order_relaxed);
+    uint64_t hold_us = (GetNowInNs() - held.mStart) / 1000;
+    OwnerAdd(counters->mHoldN, (uint64_t) 1);
+    OwnerAdd(counters->mHoldSum, hold_us);
+    OwnerAdd(counters->mHoldHist[LatencyHistogram::BucketIndex(hold_us)],
+             (uint32_t) 1);
+    return;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Get the statistics of all call sites
+//------------------------------------------------------------------------------
+std::vector<LockProfiler::SiteStats>
+LockProfiler::GetStats()
+{
+  int num_sites = mNumSites.load(std::memory_order_acquire);
+  std::vector<SiteStats> stats(num_sites);
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  for (int id = 0; id < num_sites; ++id) {
+    const Site* site = mSites[id].load(std::memory_order_relaxed);
+    SiteStats& st = stats[id];
+    st.mLock = site->mLock;
+    st.mFunction = site->mFunction;
+    st.mFile = site->mFile;
+    st.mLine = site->mLine;
+    st.mWrite = site->mWrite;
+    st.mAcquired = st.mContended = st.mWaitSum = st.mHoldN = st.mHoldSum = 0;
+    st.mWait.Clear();
+    st.mHold.Clear();
+
+    for (auto& shard : mShards) {
+      SiteCounters* counters =
+        shard->mSites[id].load(std::memory_order_acquire);
+
+      if (!counters) {
+        continue;
+      }
+
+      st.mAcquired += counters->mAcquired.load(std::memory_order_relaxed);
+      st.mContended += counters->mContended.load(std::memory_order_relaxed);
+      st.mWaitSum += counters->mWaitSum.load(std::memory_order_relaxed);
+      st.mHoldN += counters->mHoldN.load(std::memory_order_relaxed);
+      st.mHoldSum += counters->mHoldSum.load(std::memory_order_relaxed);
+
+      for (int i = 0; i < LatencyHistogram::sNumBins; ++i) {
+        uint32_t wait = counters->mWaitHist[i].load(std::memory_order_relaxed);
+        uint32_t hold = counters->mHoldHist[i].load(std::memory_order_relaxed);
+
+        if (wait) {
+          st.mWait.AddBin(i, wait);
+        }
+
+        if (hold) {
+          st.mHold.AddBin(i, hold);
+        }
+      }
+    }
+  }
+
+  return stats;
+}
+
+//------------------------------------------------------------------------------
+// Reset all counters - increments running concurrently in other threads can
+// survive the reset
+//------------------------------------------------------------------------------
+void
+LockProfiler::Reset()
+{
+  int num_sites = mNumSites.load(std::memory_order_acquire);
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  for (auto& shard : mShards) {
+    for (int id = 0; id < num_sites; ++id) {
+      SiteCounters* counters =
+        shard->mSites[id].load(std::memory_order_acquire);
+
+      if (!counters) {
+        continue;
+      }
+
+      counters->mAcquired = 0;
+      counters->mContended = 0;
+      counters->mWaitSum = 0;
+      counters->mHoldN = 0;
+      counters->mHoldSum = 0;
+
+      for (int i = 0; i < LatencyHistogram::sNumBins; ++i) {
+        counters->mWaitHist[i] = 0;
+        counters->mHoldHist[i] = 0;
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Print the call sites with the largest total wait time and the locks
+// ordered by total wait time
+//------------------------------------------------------------------------------
+void
+LockProfiler::Print(std::string& out, size_t top, bool monitoring)
+{
+  std::vector<SiteStats> stats = GetStats();
+  std::map<std::string, SiteStats> locks;
+
+  for (auto& st : stats) {
+    auto it = locks.find(st.mLock);
+
+    if (it == locks.end()) {
+      it = locks.emplace(st.mLock, st).first;
+      it->second.mFunction = it->second.mFile = "";
+      it->second.mLine = 0;
+      continue;
+    }
+
+    it->second.mAcquired += st.mAcquired;
+    it->second.mContended += st.mContended;
+    it->second.mWaitSum += st.mWaitSum;
+    it->second.mHoldN += st.mHoldN;
+    it->second.mHoldSum += st.mHoldSum;
+    it->second.mWait.Merge(st.mWait);
+    it->second.mHold.Merge(st.mHold);
+  }
+
+  auto by_wait = [](const SiteStats & a, const SiteStats & b) {
+    return (a.mWaitSum != b.mWaitSum) ? (a.mWaitSum > b.mWaitSum) :
+           (a.mContended > b.mContended);
+  };
+  std::vector<SiteStats> lock_stats;
+
+  for (auto& elem : locks) {
+    lock_stats.push_back(elem.second);
+  }
+
+  std::sort(lock_stats.begin(), lock_stats.end(), by_wait);
+  std::sort(stats.begin(), stats.end(), by_wait);
+  char outline[1024];
+
+  if (!monitoring) {
+    snprintf(outline, sizeof(outline),
+             "# lock contention profiler is %s, times in ms\n",
+             IsEnabled() ? "on" : "off");
+    out += outline;
+    snprintf(outline, sizeof(outline),
+             "%-24s %12s %10s %8s %12s %10s %10s %10s\n", "lock", "acquired",
+             "contended", "ratio", "wait-total", "wait-p50", "wait-p99",
+             "hold-p99");
+    out += outline;
+  }
+
+  for (auto& st : lock_stats) {
+    if (!st.mAcquired) {
+      continue;
+    }
+
+    double ratio = 100.0 * st.mContended / st.mAcquired;
+
+    if (monitoring) {
+      snprintf(outline, sizeof(outline),
+               "lock=%s acquired=%llu contended=%llu wait.total=%.03f "
+               "wait.p50=%.03f wait.p99=%.03f hold.p99=%.03f\n",
+               st.mLock.c_str(), (unsigned long long) st.mAcquired,
+               (unsigned long long) st.mContended, st.mWaitSum / 1000.0,
+               st.mWait.Percentile(0.5) / 1000.0,
+               st.mWait.Percentile(0.99) / 1000.0,
+               st.mHold.Percentile(0.99) / 1000.0);
+    } else {
+      snprintf(outline, sizeof(outline),
+               "%-24s %12llu %10llu %7.02f%% %12.03f %10.03f %10.03f %10.03f\n",
+               st.mLock.c_str(), (unsigned long long) st.mAcquired,
+               (unsigned long long) st.mContended, ratio, st.mWaitSum / 1000.0,
+               st.mWait.Percentile(0.5) / 1000.0,
+               st.mWait.Percentile(0.99) / 1000.0,
+               st.mHold.Percentile(0.99) / 1000.0);
+    }
+
+    out += outline;
+  }
+
+  if (!monitoring) {
+    snprintf(outline, sizeof(outline),
+             "# top %lu waiting call sites\n"
+             "%-24s %-2s %10s %12s %10s %10s %10s %10s  %s\n",
+             (unsigned long) top, "lock", "rw", "contended", "wait-total",
+             "wait-p50", "wait-p99", "hold-avg", "hold-p99", "site");
+    out += outline;
+  }
+
+  size_t printed = 0;
+
+  for (auto& st : stats) {
+    if (!st.mContended || (printed++ >= top)) {
+      break;
+    }
+
+    const char* file = strrchr(st.mFile.c_str(), '/');
+    file = (file ? file + 1 : st.mFile.c_str());
+    double hold_avg = st.mHoldN ? (1.0 * st.mHoldSum / st.mHoldN) : 0;
+
+    if (monitoring) {
+      snprintf(outline, sizeof(outline),
+               "site=%s:%d function=%s lock=%s mode=%s acquired=%llu "
+               "contended=%llu wait.total=%.03f wait.p50=%.03f "
+               "wait.p99=%.03f hold.avg=%.03f hold.p99=%.03f\n",
+               file, st.mLine, st.mFunction.c_str(), st.mLock.c_str(),
+               st.mWrite ? "w" : "r", (unsigned long long) st.mAcquired,
+               (unsigned long long) st.mContended, st.mWaitSum / 1000.0,
+               st.mWait.Percentile(0.5) / 1000.0,
+               st.mWait.Percentile(0.99) / 1000.0, hold_avg / 1000.0,
+               st.mHold.Percentile(0.99) / 1000.0);
+    } else {
+      snprintf(outline, sizeof(outline),
+               "%-24s %-2s %10llu %12.03f %10.03f %10.03f %10.03f %10.03f  "
+               "%s:%d %s\n", st.mLock.c_str(), st.mWrite ? "w" : "r",
+               (unsigned long long) st.mContended, st.mWaitSum / 1000.0,
+               st.mWait.Percentile(0.5) / 1000.0,
+               st.mWait.Percentile(0.99) / 1000.0, hold_avg / 1000.0,
+               st.mHold.Percentile(0.99) / 1000.0, file, st.mLine,
+               st.mFunction.c_str());
+    }
+
+    out += outline;
+  }
+}
+
+//------------------------------------------------------------------------------
+// ProfiledMutexHelper constructor
+//------------------------------------------------------------------------------
+ProfiledMutexHelper::ProfiledMutexHelper(XrdSysMutex& mutex, const char* name,
+    const LockCallSite& site):
+  mMutex(&mutex)
+{
+  if (!LockProfiler::IsEnabled()) {
+    mMutex->Lock();
+    return;
+  }
+
+  uint64_t wait_start = 0;
+
+  if (!mMutex->CondLock()) {
+    wait_start = LockProfiler::GetNowInNs();
+    mMutex->Lock();
+  }
+
+  LockProfiler::GetInstance().Acquired(mMutex, name, site, true, wait_start);
+}
+
+//------------------------------------------------------------------------------
+// ProfiledMutexHelper destructor
+//------------------------------------------------------------------------------
+ProfiledMutexHelper::~ProfiledMutexHelper()
+{
+  LockProfiler::Released(mMutex);
+  mMutex->UnLock();
+}
+
+EOSCOMMONNAMESPACE_END
@@ -0,0 +1,277 @@
+//------------------------------------------------------------------------------
+// File: LockProfiler.hh
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#pragma once
+#include "common/Namespace.hh"
+#include "common/LatencyHistogram.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+EOSCOMMONNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Call site of a lock acquisition - the default arguments are evaluated at
+//! the place where a lock function taking a LockCallSite with default value
+//! is called, so the call sites don't need to be changed.
+//------------------------------------------------------------------------------
+struct LockCallSite {
+  LockCallSite(const char* function = __builtin_FUNCTION(),
+               const char* file = __builtin_FILE(),
+               int line = __builtin_LINE()):
+    mFunction(function), mFile(file), mLine(line) {}
+
+  const char* mFunction;
+  const char* mFile;
+  int mLine;
+};
+
+//------------------------------------------------------------------------------
+//! Class LockProfiler - contention profiler of the RWMutex and
+//! ProfiledMutexHelper locks. It is off by default and enabled with
+//! "ns mutex --togglecontention" or the environment variable
+//! EOS_LOCK_PROFILER=1.
+//!
+//! An acquisition first tries the lock, only if this fails the time waiting
+//! for it is measured. The hold time is measured for the contended and for
+//! every sHoldSampling-th uncontended acquisition of a thread. The counters
+//! are kept per call site (file, line and lock mode) in per-thread shards
+//! like the MGM statistics, so the lock path never touches shared cache lines.
+//------------------------------------------------------------------------------
+class LockProfiler
+{
+public:
+  //! Maximum number of call sites, further ones are not profiled
+  static constexpr int sMaxSites = 2048;
+  //! Number of buckets of the call site hash table
+  static constexpr int sSiteTableSize = 2 * sMaxSites;
+  //! Every n-th uncontended acquisition of a thread has its hold time measured
+  static constexpr int sHoldSampling = 64;
+  //! Maximum number of sampled locks held at the same time by a thread
+  static constexpr int sMaxHeld = 8;
+
+  //----------------------------------------------------------------------------
+  //! Counters of a call site in one shard, times are in microseconds
+  //----------------------------------------------------------------------------
+  struct SiteCounters {
+    std::atomic<uint64_t> mAcquired {0};
+    std::atomic<uint64_t> mContended {0};
+    std::atomic<uint64_t> mWaitSum {0};
+    std::atomic<uint64_t> mHoldN {0};
+    std::atomic<uint64_t> mHoldSum {0};
+    //! Histograms of the contended waits and the hold times
+    std::atomic<uint32_t> mWaitHist[LatencyHistogram::sNumBins];
+    std::atomic<uint32_t> mHoldHist[LatencyHistogram::sNumBins];
+
+    SiteCounters();
+  };
+
+  //----------------------------------------------------------------------------
+  //! Per-thread shard of call site counters - only the owning thread adds
+  //----------------------------------------------------------------------------
+  struct Shard {
+    std::atomic<SiteCounters*> mSites[sMaxSites];
+
+    Shard();
+    ~Shard();
+  };
+
+  //----------------------------------------------------------------------------
+  //! Statistics of a call site summed over all threads
+  //----------------------------------------------------------------------------
+  struct SiteStats {
+    std::string mLock; ///< Lock name
+    std::string mFunction; ///< Function taking the lock
+    std::string mFile; ///< Source file
+    int mLine; ///< Source line
+    bool mWrite; ///< Exclusive lock
+    uint64_t mAcquired; ///< Number of acquisitions
+    uint64_t mContended; ///< Number of acquisitions which had to wait
+    uint64_t mWaitSum; ///< Total wait time in us
+    uint64_t mHoldN; ///< Number of hold time samples
+    uint64_t mHoldSum; ///< Sum of the hold time samples in us
+    LatencyHistogram mWait; ///< Wait times of the contended acquisitions
+    LatencyHistogram mHold; ///< Sampled hold times
+  };
+
+  //----------------------------------------------------------------------------
+  //! Get singleton instance
+  //----------------------------------------------------------------------------
+  static LockProfiler& GetInstance();
+
+  //----------------------------------------------------------------------------
+  //! Check if profiling is enabled
+  //----------------------------------------------------------------------------
+  static inline bool IsEnabled()
+  {
+    return sEnabled.load(std::memory_order_relaxed);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Enable/disable profiling, it is disabled by default unless the
+  //! environment variable EOS_LOCK_PROFILER is set to 1
+  //----------------------------------------------------------------------------
+  static void SetEnabled(bool on)
+  {
+    sEnabled = on;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get monotonic time in nanoseconds used for the wait times
+  //----------------------------------------------------------------------------
+  static uint64_t GetNowInNs();
+
+  //----------------------------------------------------------------------------
+  //! Record a lock acquisition by the calling thread
+  //!
+  //! @param lock address of the lock
+  //! @param name name of the lock, only used the first time a site is seen
+  //! @param site call site
+  //! @param write true for an exclusive lock
+  //! @param wait_start start of the wait as returned by GetNowInNs or 0 if
+  //!        the lock was acquired without waiting
+  //----------------------------------------------------------------------------
+  void Acquired(const void* lock, const char* name, const LockCallSite& site,
+                bool write, uint64_t wait_start);
+
+  //----------------------------------------------------------------------------
+  //! Record a lock release by the calling thread - this is cheap if the
+  //! acquisition was not sampled
+  //!
+  //! @param lock address of the lock
+  //----------------------------------------------------------------------------
+  static void Released(const void* lock);
+
+  //----------------------------------------------------------------------------
+  //! Get the statistics of all call sites
+  //----------------------------------------------------------------------------
+  std::vector<SiteStats> GetStats();
+
+  //----------------------------------------------------------------------------
+  //! Reset all counters
+  //----------------------------------------------------------------------------
+  void Reset();
+
+  //----------------------------------------------------------------------------
+  //! Print the call sites with the largest total wait time and the locks
+  //! ordered by total wait time
+  //!
+  //! @param out output string
+  //! @param top maximum number of call sites printed
+  //! @param monitoring print in monitoring format <key>=<value>
+  //----------------------------------------------------------------------------
+  void Print(std::string& out, size_t top = 20, bool monitoring = false);
+
+private:
+  static std::atomic<bool> sEnabled;
+
+  //! Call site description, immutable once registered
+  struct Site {
+    std::string mLock;
+    std::string mFunction;
+    std::string mFile;
+    int mLine;
+    bool mWrite;
+    size_t mHash; ///< Hash of lock, file, line and mode
+    int mId;
+  };
+
+  //! Registered call sites indexed by id, readers don't take any lock
+  std::atomic<Site*> mSites[sMaxSites];
+  std::atomic<int> mNumSites; ///< Number of registered call sites
+  //! Open addressing hash table of the registered call sites
+  std::atomic<Site*> mSiteTable[sSiteTableSize];
+  std::mutex mSiteMutex; ///< Serializes the registration of call sites
+  std::mutex mMutex; ///< Protects the members below
+  std::vector<std::unique_ptr<Shard>> mShards; ///< All shards
+  std::vector<Shard*> mFree; ///< Shards not owned by any thread
+
+  //----------------------------------------------------------------------------
+  //! Constructor - use GetInstance
+  //----------------------------------------------------------------------------
+  LockProfiler();
+
+  //----------------------------------------------------------------------------
+  //! Get the id of a call site, registers it if needed
+  //!
+  //! @return id or -1 if there are too many sites
+  //----------------------------------------------------------------------------
+  int GetSiteId(const char* name, const LockCallSite& site, bool write);
+
+  //----------------------------------------------------------------------------
+  //! Look up a registered call site without locking
+  //!
+  //! @param hash hash of the call site
+  //! @param slot set to the slot of the site or of the first free slot, or
+  //!        to sSiteTableSize if the table is full
+  //!
+  //! @return id or -1 if the site is not registered
+  //----------------------------------------------------------------------------
+  int FindSite(size_t hash, const char* name, const LockCallSite& site,
+               bool write, size_t& slot) const;
+
+  //----------------------------------------------------------------------------
+  //! Get the shard of the calling thread
+  //----------------------------------------------------------------------------
+  Shard* GetShard();
+
+  //----------------------------------------------------------------------------
+  //! Return the shard of an exiting thread to the pool
+  //----------------------------------------------------------------------------
+  void ReleaseShard(Shard* shard);
+
+  friend struct ThreadProfile;
+};
+
+//------------------------------------------------------------------------------
+//! Class ProfiledMutexHelper - scoped lock of an XrdSysMutex whose contention
+//! is recorded by the LockProfiler, use instead of XrdSysMutexHelper
+//------------------------------------------------------------------------------
+class ProfiledMutexHelper
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Constructor - locks the mutex
+  //!
+  //! @param mutex mutex to lock
+  //! @param name name of the lock shown by the profiler
+  //! @param site call site, filled in automatically
+  //----------------------------------------------------------------------------
+  ProfiledMutexHelper(XrdSysMutex& mutex, const char* name,
+                      const LockCallSite& site = LockCallSite());
+
+  //----------------------------------------------------------------------------
+  //! Destructor - unlocks the mutex
+  //----------------------------------------------------------------------------
+  ~ProfiledMutexHelper();
+
+  ProfiledMutexHelper(const ProfiledMutexHelper&) = delete;
+  ProfiledMutexHelper& operator=(const ProfiledMutexHelper&) = delete;
+
+private:
+  XrdSysMutex* mMutex;
+};
+
+EOSCOMMONNAMESPACE_END
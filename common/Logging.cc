@@ -24,9 +24,409 @@
 #include "common/Namespace.hh"
 #include "common/Logging.hh"
 #include "XrdSys/XrdSysPthread.hh"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
 
 EOSCOMMONNAMESPACE_BEGIN
 
+namespace
+{
+//! Size of the buffer a log line is formatted in
+const size_t kLogMsgBufferSize = 1024 * 1024;
+
+//------------------------------------------------------------------------------
+//! Log message queued for the background writer
+//------------------------------------------------------------------------------
+struct LogRecord {
+  uint64_t mSeq; ///< Position of the record in the order of all records
+  struct timeval mTv;
+  int mPriority;
+  int mLine;
+  int mUid;
+  int mGid;
+  size_t mMsgPos; ///< Offset of the message text in mText
+  std::string mText; ///< Formatted log line
+  std::string mFile; ///< Source file
+  std::string mFunc; ///< Calling function
+  std::string mName; ///< Truncated name of the caller
+};
+
+//------------------------------------------------------------------------------
+//! Single producer/single consumer ring of log records filled by one thread
+//! and drained by the background writer. The records are reused so that their
+//! strings keep their capacity.
+//------------------------------------------------------------------------------
+class LogRing
+{
+public:
+  static const size_t kSize = 256; ///< Number of records, a power of two
+  std::atomic<bool> mOrphaned; ///< Set when the producer thread exited
+
+  LogRing(): mOrphaned(false), mHead(0), mTail(0), mRecords(kSize) {}
+
+  //----------------------------------------------------------------------------
+  //! Producer: get the next record to fill or nullptr if the ring is full
+  //----------------------------------------------------------------------------
+  LogRecord* Reserve()
+  {
+    size_t head = mHead.load(std::memory_order_relaxed);
+
+    if (head - mTail.load(std::memory_order_acquire) >= kSize) {
+      return nullptr;
+    }
+
+    return &mRecords[head & (kSize - 1)];
+  }
+
+  //----------------------------------------------------------------------------
+  //! Producer: publish the record returned by Reserve
+  //----------------------------------------------------------------------------
+  void Commit()
+  {
+    mHead.store(mHead.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Consumer: get the oldest record or nullptr if the ring is empty
+  //----------------------------------------------------------------------------
+  LogRecord* Front()
+  {
+    size_t tail = mTail.load(std::memory_order_relaxed);
+
+    if (tail == mHead.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+
+    return &mRecords[tail & (kSize - 1)];
+  }
+
+  //----------------------------------------------------------------------------
+  //! Consumer: release the record returned by Front
+  //----------------------------------------------------------------------------
+  void Pop()
+  {
+    mTail.store(mTail.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Check if all records were written
+  //----------------------------------------------------------------------------
+  bool Empty() const
+  {
+    return (mTail.load(std::memory_order_acquire) ==
+            mHead.load(std::memory_order_acquire));
+  }
+
+private:
+  std::atomic<size_t> mHead; ///< Number of records committed
+  std::atomic<size_t> mTail; ///< Number of records written
+  std::vector<LogRecord> mRecords;
+};
+
+//------------------------------------------------------------------------------
+//! Per-thread state of the asynchronous logging
+//------------------------------------------------------------------------------
+struct LogThreadState {
+  std::shared_ptr<LogRing> mRing; ///< Ring registered with the writer
+  char* mBuffer; ///< Format buffer, its content is returned by log
+
+  LogThreadState(): mBuffer(0) {}
+
+  ~LogThreadState()
+  {
+    if (mRing) {
+      mRing->mOrphaned = true;
+    }
+
+    free(mBuffer);
+  }
+};
+
+thread_local LogThreadState tLogState;
+
+//------------------------------------------------------------------------------
+//! Scope of a log call using the background writer, the writer is only
+//! destroyed once no such call is left
+//------------------------------------------------------------------------------
+class AsyncCallerScope
+{
+public:
+  AsyncCallerScope(std::atomic<size_t>& callers): mCallers(callers)
+  {
+    mCallers++;
+  }
+
+  ~AsyncCallerScope()
+  {
+    mCallers--;
+  }
+
+private:
+  std::atomic<size_t>& mCallers;
+};
+
+//------------------------------------------------------------------------------
+// Get the short source file name - we show only one hierarchy directory like
+// Acl (assuming that we have only file names like *.cc and *.hh)
+//------------------------------------------------------------------------------
+XrdOucString
+ShortFileName(const char* file)
+{
+  XrdOucString File = file;
+  File.erase(0, File.rfind("/") + 1);
+  File.erase(File.length() - 3);
+  return File;
+}
+}
+
+//------------------------------------------------------------------------------
+//! Class AsyncWriter - background thread writing the messages queued by the
+//! logging threads in their rings. Every record gets a sequence number when
+//! it is queued and the records are written in this order across all rings.
+//------------------------------------------------------------------------------
+class Logging::AsyncWriter
+{
+public:
+  //! Maximum number of records written without releasing gMutex
+  static const size_t kMaxDrain = 4096;
+
+  //----------------------------------------------------------------------------
+  //! Constructor - starts the writer thread
+  //----------------------------------------------------------------------------
+  AsyncWriter(Logging& logging):
+    mLogging(logging), mStop(false), mSeq(0), mWritten(0), mWakeup(false)
+  {
+    mThread = std::thread(&AsyncWriter::Run, this);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Destructor - stops the writer thread and writes the remaining messages,
+  //! there must be no caller queueing messages anymore
+  //----------------------------------------------------------------------------
+  ~AsyncWriter()
+  {
+    mStop = true;
+    Wake();
+    mThread.join();
+
+    while (Drain()) {}
+  }
+
+  //----------------------------------------------------------------------------
+  //! Queue a formatted message in the ring of the calling thread
+  //!
+  //! @return true if queued, false if the writer is stopped
+  //----------------------------------------------------------------------------
+  bool Push(const struct timeval& tv, const char* func, const char* file,
+            int line, int uid, int gid, const char* truncname, int priority,
+            const char* buffer, size_t msgpos)
+  {
+    LogThreadState& state = tLogState;
+
+    if (!state.mRing) {
+      state.mRing = std::make_shared<LogRing>();
+      std::lock_guard<std::mutex> lock(mMutex);
+      mRings.push_back(state.mRing);
+    }
+
+    LogRecord* rec;
+
+    while (!(rec = state.mRing->Reserve())) {
+      if (mStop) {
+        return false;
+      }
+
+      // the writer doesn't keep up - wait for it rather than drop messages
+      Wake();
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    rec->mTv = tv;
+    rec->mPriority = priority;
+    rec->mLine = line;
+    rec->mUid = uid;
+    rec->mGid = gid;
+    rec->mMsgPos = msgpos;
+    rec->mText.assign(buffer);
+    rec->mFile.assign(file);
+    rec->mFunc.assign(func);
+    rec->mName.assign(truncname);
+    // the sequence number is taken just before publishing, the writer waits
+    // for a missing number only while its record is being committed
+    rec->mSeq = mSeq++;
+    state.mRing->Commit();
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Wait until all messages queued so far are written
+  //----------------------------------------------------------------------------
+  void Flush()
+  {
+    uint64_t seq = mSeq.load();
+
+    while (!mStop && (mWritten.load() < seq)) {
+      Wake();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Wake up the writer thread
+  //----------------------------------------------------------------------------
+  void Wake()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mWakeMutex);
+      mWakeup = true;
+    }
+    mCond.notify_one();
+  }
+
+private:
+  typedef std::pair<uint64_t, LogRing*> front_t;
+  typedef std::priority_queue<front_t, std::vector<front_t>,
+          std::greater<front_t>> front_queue_t;
+
+  Logging& mLogging;
+  std::atomic<bool> mStop; ///< Set to stop the writer thread
+  std::atomic<uint64_t> mSeq; ///< Sequence number of the next record queued
+  std::atomic<uint64_t> mWritten; ///< Sequence number of the next record written
+  std::mutex mMutex; ///< Protects mRings
+  std::vector<std::shared_ptr<LogRing>> mRings; ///< Rings of all threads
+  std::mutex mWakeMutex; ///< Mutex for mCond and mWakeup
+  std::condition_variable mCond; ///< Wakes up the writer thread
+  bool mWakeup; ///< Set by Wake, reset by the writer thread
+  std::thread mThread;
+
+  //----------------------------------------------------------------------------
+  //! Writer thread loop - polls the rings while asynchronous logging is
+  //! enabled and sleeps until woken up otherwise
+  //----------------------------------------------------------------------------
+  void Run()
+  {
+    while (!mStop) {
+      if (Drain()) {
+        continue;
+      }
+
+      if (mWritten.load() != mSeq.load()) {
+        // a record is being committed
+        std::this_thread::yield();
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(mWakeMutex);
+
+      if (mLogging.gAsync) {
+        mCond.wait_for(lock, std::chrono::milliseconds(10));
+      } else {
+        mCond.wait(lock, [this]() {
+          return mStop || mWakeup || mLogging.gAsync;
+        });
+      }
+
+      mWakeup = false;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the first record of every ring
+  //----------------------------------------------------------------------------
+  void Fronts(std::vector<std::shared_ptr<LogRing>>& rings,
+              front_queue_t& fronts)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      rings = mRings;
+    }
+    fronts = front_queue_t();
+
+    for (auto it = rings.begin(); it != rings.end(); ++it) {
+      LogRecord* rec = (*it)->Front();
+
+      if (rec) {
+        fronts.push(std::make_pair(rec->mSeq, it->get()));
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Write the queued messages of all rings in sequence order, stops at a
+  //! sequence number which is not committed yet
+  //!
+  //! @return number of messages written
+  //----------------------------------------------------------------------------
+  size_t Drain()
+  {
+    std::vector<std::shared_ptr<LogRing>> rings;
+    front_queue_t fronts;
+    size_t nwritten = 0;
+    bool refreshed = true;
+    XrdSysMutexHelper scope_lock(mLogging.gMutex);
+    Fronts(rings, fronts);
+
+    while (nwritten < kMaxDrain) {
+      if (fronts.empty() || (fronts.top().first != mWritten.load())) {
+        if (refreshed) {
+          break;
+        }
+
+        // the next record may be in a ring which was empty before
+        Fronts(rings, fronts);
+        refreshed = true;
+        continue;
+      }
+
+      LogRing* ring = fronts.top().second;
+      fronts.pop();
+      Write(*ring->Front());
+      ring->Pop();
+      mWritten++;
+      nwritten++;
+      refreshed = false;
+      LogRecord* rec = ring->Front();
+
+      if (rec) {
+        fronts.push(std::make_pair(rec->mSeq, ring));
+      }
+    }
+
+    for (auto it = rings.begin(); it != rings.end(); ++it) {
+      // an orphaned ring gets no new records, once empty it can be dropped
+      if ((*it)->mOrphaned && (*it)->Empty()) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRings.erase(std::find(mRings.begin(), mRings.end(), *it));
+      }
+    }
+
+    return nwritten;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Write one message - needs gMutex
+  //----------------------------------------------------------------------------
+  void Write(LogRecord& rec)
+  {
+    XrdOucString File = ShortFileName(rec.mFile.c_str());
+    mLogging.WriteLine(&rec.mText[0], rec.mMsgPos, rec.mFunc.c_str(),
+                       File.c_str(), rec.mLine, rec.mUid, rec.mGid,
+                       rec.mName.c_str(), rec.mPriority);
+
+    // don't keep the memory of exceptionally long messages in the ring
+    if (rec.mText.capacity() > 64 * 1024) {
+      std::string().swap(rec.mText);
+    }
+  }
+};
+
 Mapping::VirtualIdentity Logging::gZeroVid;
 
 //------------------------------------------------------------------------------
@@ -34,7 +434,7 @@ Mapping::VirtualIdentity Logging::gZeroVid;
 //------------------------------------------------------------------------------
 Logging::Logging():
   gLogMask(0), gPriorityLevel(0), gToSysLog(false),  gUnit("none"),
-  gShortFormat(0)
+  gShortFormat(0), gAsync(false), mAsyncCallers(0)
 {
   // Initialize the log array and sets the log circular size
   gLogCircularIndex.resize(LOG_DEBUG + 1);
@@ -57,6 +457,72 @@ Logging::Logging():
       gToSysLog = true;
     }
   }
+
+  if (getenv("EOS_LOG_ASYNC")) {
+    XrdOucString async = getenv("EOS_LOG_ASYNC");
+
+    if ((async == "1") || (async == "true")) {
+      SetAsync(true);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Destructor
+//------------------------------------------------------------------------------
+Logging::~Logging()
+{
+  gAsync = false;
+  WaitAsyncCallers();
+  mWriter.reset();
+}
+
+//------------------------------------------------------------------------------
+// Wait until no log call is using the background writer
+//------------------------------------------------------------------------------
+void
+Logging::WaitAsyncCallers()
+{
+  while (mAsyncCallers.load()) {
+    std::this_thread::yield();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Enable/disable asynchronous logging
+//------------------------------------------------------------------------------
+void
+Logging::SetAsync(bool onoff)
+{
+  if (onoff) {
+    XrdSysMutexHelper scope_lock(gMutex);
+
+    if (!mWriter) {
+      mWriter.reset(new AsyncWriter(*this));
+    }
+  }
+
+  gAsync = onoff;
+
+  if (onoff) {
+    mWriter->Wake();
+  } else {
+    // messages of calls which saw asynchronous logging enabled are written
+    // before returning
+    WaitAsyncCallers();
+    Flush();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Wait until all queued messages are written
+//------------------------------------------------------------------------------
+void
+Logging::Flush()
+{
+  if (mWriter) {
+    mWriter->Flush();
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -91,8 +557,6 @@ Logging::log(const char* func, const char* file, int line, const char* logid,
              const Mapping::VirtualIdentity& vid, const char* cident, int priority,
              const char* msg, ...)
 {
-  static int logmsgbuffersize = 1024 * 1024;
-
   // short cut if log messages are masked
   if (!((LOG_MASK(priority) & gLogMask))) {
     return "";
@@ -113,43 +577,97 @@ Logging::log(const char* func, const char* file, int line, const char* logid,
     }
   }
 
+  XrdOucString File = ShortFileName(file);
+  XrdOucString truncname = vid.name;
+
+  // we show only the last 16 bytes of the name
+  if (truncname.length() > 16) {
+    truncname.insert("..", 0);
+    truncname.erase(0, truncname.length() - 16);
+  }
+
+  struct timeval tv;
+  struct timezone tz;
+  va_list args;
+  size_t msgpos;
+
+  if (gAsync) {
+    AsyncCallerScope caller(mAsyncCallers);
+
+    // re-check, SetAsync(false) and the destructor wait for the callers which
+    // were counted while asynchronous logging was enabled
+    if (gAsync) {
+      gettimeofday(&tv, &tz);
+
+      if (rate_limit(tv, priority, file, line)) {
+        return "";
+      }
+
+      // format without the global mutex, the writer thread does the output
+      LogThreadState& state = tLogState;
+
+      if (!state.mBuffer) {
+        state.mBuffer = (char*) malloc(kLogMsgBufferSize);
+      }
+
+      va_start(args, msg);
+      msgpos = FormatLine(state.mBuffer, kLogMsgBufferSize, tv, func,
+                          File.c_str(), line, logid, vid, cident, priority,
+                          truncname.c_str(), msg, args);
+      va_end(args);
+
+      if (mWriter->Push(tv, func, file, line, vid.uid, vid.gid,
+                        truncname.c_str(), priority, state.mBuffer, msgpos)) {
+        return state.mBuffer;
+      }
+
+      // the writer is already stopped
+      XrdSysMutexHelper scope_lock(gMutex);
+      return WriteLine(state.mBuffer, msgpos, func, File.c_str(), line, vid.uid,
+                       vid.gid, truncname.c_str(), priority);
+    }
+  }
+
   static char* buffer = 0;
+  XrdSysMutexHelper scope_lock(gMutex);
 
   if (!buffer) {
     // 1 M print buffer
-    buffer = (char*) malloc(logmsgbuffersize);
+    buffer = (char*) malloc(kLogMsgBufferSize);
   }
 
-  XrdOucString File = file;
-  // we show only one hierarchy directory like Acl (assuming that we have only
-  // file names like *.cc and *.hh
-  File.erase(0, File.rfind("/") + 1);
-  File.erase(File.length() - 3);
-  static time_t current_time;
-  static struct timeval tv;
-  static struct timezone tz;
-  struct tm tm;
-  XrdSysMutexHelper scope_lock(gMutex);
-  va_list args;
-  va_start(args, msg);
   gettimeofday(&tv, &tz);
-  current_time = tv.tv_sec;
-  static char linen[16];
-  sprintf(linen, "%d", line);
-  static char fcident[1024];
-  XrdOucString truncname = vid.name;
+  va_start(args, msg);
+  msgpos = FormatLine(buffer, kLogMsgBufferSize, tv, func, File.c_str(), line,
+                      logid, vid, cident, priority, truncname.c_str(), msg, args);
+  va_end(args);
 
-  // we show only the last 16 bytes of the name
-  if (truncname.length() > 16) {
-    truncname.insert("..", 0);
-    truncname.erase(0, truncname.length() - 16);
+  if (rate_limit(tv, priority, file, line)) {
+    return "";
   }
 
+  return WriteLine(buffer, msgpos, func, File.c_str(), line, vid.uid, vid.gid,
+                   truncname.c_str(), priority);
+}
+
+//------------------------------------------------------------------------------
+// Format the header and the message of a log line
+//------------------------------------------------------------------------------
+size_t
+Logging::FormatLine(char* buffer, size_t size, const struct timeval& tv,
+                    const char* func, const char* File, int line,
+                    const char* logid, const Mapping::VirtualIdentity& vid,
+                    const char* cident, int priority, const char* truncname,
+                    const char* msg, va_list args)
+{
+  time_t current_time = tv.tv_sec;
+  struct tm tm;
+  char fcident[1024];
   char sourceline[64];
+  localtime_r(&current_time, &tm);
+  snprintf(sourceline, sizeof(sourceline) - 1, "%s:%d", File, line);
 
   if (gShortFormat) {
-    localtime_r(&current_time, &tm);
-    snprintf(sourceline, sizeof(sourceline) - 1, "%s:%s", File.c_str(), linen);
     XrdOucString slog = logid;
 
     if (slog.beginswith("logid:")) {
@@ -168,10 +686,9 @@ Logging::log(const char* func, const char* file, int line, const char* logid,
               sourceline);
     }
   } else {
-    sprintf(fcident, "tident=%s sec=%-5s uid=%d gid=%d name=%s geo=\"%s\"", cident,
-            vid.prot.c_str(), vid.uid, vid.gid, truncname.c_str(), vid.geolocation.c_str());
-    localtime_r(&current_time, &tm);
-    snprintf(sourceline, sizeof(sourceline) - 1, "%s:%s", File.c_str(), linen);
+    snprintf(fcident, sizeof(fcident),
+             "tident=%s sec=%-5s uid=%d gid=%d name=%s geo=\"%s\"", cident,
+             vid.prot.c_str(), vid.uid, vid.gid, truncname, vid.geolocation.c_str());
     sprintf(buffer,
             "%02d%02d%02d %02d:%02d:%02d time=%lu.%06lu func=%-24s level=%s logid=%s unit=%s tid=%016lx source=%-30s %s ",
             tm.tm_year - 100, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min,
@@ -180,13 +697,23 @@ Logging::log(const char* func, const char* file, int line, const char* logid,
             (unsigned long) XrdSysThread::ID(), sourceline, fcident);
   }
 
-  char* ptr = buffer + strlen(buffer);
+  size_t msgpos = strlen(buffer);
   // limit the length of the output to buffer-1 length
-  vsnprintf(ptr, logmsgbuffersize - (ptr - buffer + 1), msg, args);
+  vsnprintf(buffer + msgpos, size - (msgpos + 1), msg, args);
+  return msgpos;
+}
 
-  if (rate_limit(tv, priority, file, line)) {
-    return "";
-  }
+//------------------------------------------------------------------------------
+// Write a formatted log line and store it in the log memory
+//------------------------------------------------------------------------------
+const char*
+Logging::WriteLine(char* buffer, size_t msgpos, const char* func,
+                   const char* File, int line, int uid, int gid,
+                   const char* truncname, int priority)
+{
+  char* ptr = buffer + msgpos;
+  char sourceline[64];
+  snprintf(sourceline, sizeof(sourceline) - 1, "%s:%d", File, line);
 
   if (gToSysLog) {
     syslog(priority, "%s", ptr);
@@ -199,16 +726,16 @@ Logging::log(const char* func, const char* file, int line, const char* logid,
       fflush(gLogFanOut["*"]);
     }
 
-    if (gLogFanOut.count(File.c_str())) {
+    if (gLogFanOut.count(File)) {
       buffer[15] = 0;
-      fprintf(gLogFanOut[File.c_str()], "%s %s%s%s %-30s %s \n",
+      fprintf(gLogFanOut[File], "%s %s%s%s %-30s %s \n",
               buffer,
               GetLogColour(GetPriorityString(priority)),
               GetPriorityString(priority),
               EOS_TEXTNORMAL,
               sourceline,
               ptr);
-      fflush(gLogFanOut[File.c_str()]);
+      fflush(gLogFanOut[File]);
       buffer[15] = ' ';
     } else {
       if (gLogFanOut.count("#")) {
@@ -218,9 +745,9 @@ Logging::log(const char* func, const char* file, int line, const char* logid,
                 GetLogColour(GetPriorityString(priority)),
                 GetPriorityString(priority),
                 EOS_TEXTNORMAL,
-                vid.uid,
-                vid.gid,
-                truncname.c_str(),
+                uid,
+                gid,
+                truncname,
                 func,
                 ptr
                );
@@ -236,7 +763,6 @@ Logging::log(const char* func, const char* file, int line, const char* logid,
     fflush(stderr);
   }
 
-  va_end(args);
   const char* rptr;
   // store into global log memory
   gLogMemory[priority][(gLogCircularIndex[priority]) % gCircularIndexSize] =
@@ -256,6 +782,8 @@ Logging::rate_limit(struct timeval& tv, int priority, const char* file,
   static int last_line = 0;
   static int last_priority = priority;
   static struct timeval last_tv;
+  // asynchronous log calls don't hold gMutex
+  std::lock_guard<std::mutex> lock(mRateMutex);
 
   if ((line == last_line) &&
       (priority == last_priority) &&
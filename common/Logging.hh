@@ -41,6 +41,11 @@
  * all messages which are not in any other fan-out (besides '*') into that file.
  * The fan-out functionality assumes that
  * source filenames follow the pattern <fan-out-name>.xx !!!!
+ * With 'SetAsync' (or EOS_LOG_ASYNC=1) messages are formatted by the calling
+ * thread without taking the global mutex and handed over through a per-thread
+ * ring buffer to a background writer thread which does the fan-out, syslog
+ * and the in-memory log used by 'eos debug getlog'. The writer keeps the order
+ * in which the messages were queued across all threads.
  */
 
 #ifndef __EOSCOMMON_LOGGING_HH__
@@ -52,10 +57,14 @@
 #include "XrdSys/XrdSysPthread.hh"
 #include "XrdSys/XrdSysLogger.hh"
 #include "XrdSec/XrdSecEntity.hh"
+#include <stdarg.h>
 #include <string.h>
 #include <sys/syslog.h>
 #include <sys/time.h>
 #include <uuid/uuid.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -74,6 +83,24 @@ EOSCOMMONNAMESPACE_BEGIN
 #define EOS_TEXTBOLD   "\033[1m"
 #define EOS_TEXTUNBOLD "\033[0m"
 
+//------------------------------------------------------------------------------
+//! Lowest priority of the log messages compiled in - the messages of lower
+//! priority are compiled out e.g. with -DEOSCOMMONLOGGING_COMPILE_PRIORITY=LOG_INFO
+//! (cmake -DNO_DEBUG_LOG=ON)
+//------------------------------------------------------------------------------
+#ifndef EOSCOMMONLOGGING_COMPILE_PRIORITY
+#define EOSCOMMONLOGGING_COMPILE_PRIORITY LOG_DEBUG
+#endif
+
+//------------------------------------------------------------------------------
+//! Check if a priority is compiled in and enabled - the log macros check this
+//! before evaluating their arguments
+//------------------------------------------------------------------------------
+#define EOS_LOG_ENABLED(__EOSCOMMON_LOG_PRIORITY__) \
+  (((__EOSCOMMON_LOG_PRIORITY__) <= EOSCOMMONLOGGING_COMPILE_PRIORITY) && \
+   (eos::common::Logging::GetInstance().gLogMask.load(std::memory_order_relaxed) & \
+    LOG_MASK(__EOSCOMMON_LOG_PRIORITY__)))
+
 //------------------------------------------------------------------------------
 //! Log Macros usable in objects inheriting from the logId Class
 //------------------------------------------------------------------------------
@@ -82,58 +109,74 @@ EOSCOMMONNAMESPACE_BEGIN
     this->uid, this->gid, this->ruid, this->rgid, this->cident, \
     LOG_MASK(__EOSCOMMON_LOG_PRIORITY__) , __VA_ARGS__
 #define eos_debug(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, this->logId, \
-                                          vid, this->cident, (LOG_DEBUG), __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_DEBUG) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, this->logId, \
+                                           vid, this->cident, (LOG_DEBUG), __VA_ARGS__) : "")
 #define eos_info(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, this->logId, \
-                                          vid, this->cident, (LOG_INFO), __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_INFO) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, this->logId, \
+                                           vid, this->cident, (LOG_INFO), __VA_ARGS__) : "")
 #define eos_notice(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, this->logId, \
-                                          vid, this->cident, (LOG_NOTICE), __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_NOTICE) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, this->logId, \
+                                           vid, this->cident, (LOG_NOTICE), __VA_ARGS__) : "")
 #define eos_warning(...) \
+  (EOS_LOG_ENABLED(LOG_WARNING) ? \
    eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, this->logId, \
-                                           vid, this->cident, (LOG_WARNING), __VA_ARGS__)
+                                           vid, this->cident, (LOG_WARNING), __VA_ARGS__) : "")
 #define eos_err(...) \
+  (EOS_LOG_ENABLED(LOG_ERR) ? \
    eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, this->logId, \
-                                           vid, this->cident, (LOG_ERR) , __VA_ARGS__)
+                                           vid, this->cident, (LOG_ERR) , __VA_ARGS__) : "")
 #define eos_crit(...) \
+  (EOS_LOG_ENABLED(LOG_CRIT) ? \
    eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, this->logId, \
-                                           vid, this->cident, (LOG_CRIT), __VA_ARGS__)
+                                           vid, this->cident, (LOG_CRIT), __VA_ARGS__) : "")
 #define eos_alert(...) \
+  (EOS_LOG_ENABLED(LOG_ALERT) ? \
    eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, this->logId, \
-                                           vid, this->cident, (LOG_ALERT)  , __VA_ARGS__)
+                                           vid, this->cident, (LOG_ALERT)  , __VA_ARGS__) : "")
 #define eos_emerg(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, this->logId, \
-                                          vid, this->cident, (LOG_EMERG)  , __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_EMERG) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, this->logId, \
+                                           vid, this->cident, (LOG_EMERG)  , __VA_ARGS__) : "")
 
 //------------------------------------------------------------------------------
 //! Log Macros usable in singleton objects used by individual threads
 //! You should define locally LodId ThreadLogId in the thread function
 //------------------------------------------------------------------------------
 #define eos_thread_debug(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, ThreadLogId.logId, \
-                                          vid, ThreadLogId.cident, (LOG_DEBUG)  , __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_DEBUG) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, ThreadLogId.logId, \
+                                           vid, ThreadLogId.cident, (LOG_DEBUG)  , __VA_ARGS__) : "")
 #define eos_thread_info(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, ThreadLogId.logId, \
-                                          vid, ThreadLogId.cident, (LOG_INFO)   , __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_INFO) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, ThreadLogId.logId, \
+                                           vid, ThreadLogId.cident, (LOG_INFO)   , __VA_ARGS__) : "")
 #define eos_thread_notice(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, ThreadLogId.logId, \
-                                          vid, ThreadLogId.cident, (LOG_NOTICE) , __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_NOTICE) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, ThreadLogId.logId, \
+                                           vid, ThreadLogId.cident, (LOG_NOTICE) , __VA_ARGS__) : "")
 #define eos_thread_warning(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, ThreadLogId.logId, \
-                                          vid, ThreadLogId.cident, (LOG_WARNING), __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_WARNING) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, ThreadLogId.logId, \
+                                           vid, ThreadLogId.cident, (LOG_WARNING), __VA_ARGS__) : "")
 #define eos_thread_err(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, ThreadLogId.logId, \
-                                          vid, ThreadLogId.cident, (LOG_ERR)    , __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_ERR) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, ThreadLogId.logId, \
+                                           vid, ThreadLogId.cident, (LOG_ERR)    , __VA_ARGS__) : "")
 #define eos_thread_crit(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, ThreadLogId.logId, \
-                                          vid, ThreadLogId.cident, (LOG_CRIT)   , __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_CRIT) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, ThreadLogId.logId, \
+                                           vid, ThreadLogId.cident, (LOG_CRIT)   , __VA_ARGS__) : "")
 #define eos_thread_alert(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, ThreadLogId.logId, \
-                                          vid, ThreadLogId.cident, (LOG_ALERT)  , __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_ALERT) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, ThreadLogId.logId, \
+                                           vid, ThreadLogId.cident, (LOG_ALERT)  , __VA_ARGS__) : "")
 #define eos_thread_emerg(...) \
+  (EOS_LOG_ENABLED(LOG_EMERG) ? \
    eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, ThreadLogId.logId, \
-                                           vid, ThreadLogId.cident, (LOG_EMERG)  , __VA_ARGS__)
+                                           vid, ThreadLogId.cident, (LOG_EMERG)  , __VA_ARGS__) : "")
 
 //------------------------------------------------------------------------------
 //! Log Macros usable from static member functions without LogId object
@@ -142,41 +185,57 @@ EOSCOMMONNAMESPACE_BEGIN
   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static", \
     0,0,0,0, "",  (__EOSCOMMON_LOG_PRIORITY__) , __VA_ARGS__
 #define eos_static_debug(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static..............................", \
-                                          eos::common::Logging::gZeroVid, "", (LOG_DEBUG), __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_DEBUG) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static..............................", \
+                                           eos::common::Logging::gZeroVid, "", (LOG_DEBUG), __VA_ARGS__) : "")
 #define eos_static_info(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static..............................", \
-                             eos::common::Logging::gZeroVid, "", (LOG_INFO), __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_INFO) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static..............................", \
+                                           eos::common::Logging::gZeroVid, "", (LOG_INFO), __VA_ARGS__) : "")
 #define eos_static_notice(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static..............................", \
-                                          eos::common::Logging::gZeroVid, "", (LOG_NOTICE), __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_NOTICE) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static..............................", \
+                                           eos::common::Logging::gZeroVid, "", (LOG_NOTICE), __VA_ARGS__) : "")
 #define eos_static_warning(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static..............................", \
-                                          eos::common::Logging::gZeroVid, "", (LOG_WARNING), __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_WARNING) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static..............................", \
+                                           eos::common::Logging::gZeroVid, "", (LOG_WARNING), __VA_ARGS__) : "")
 #define eos_static_err(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static..............................", \
-                                          eos::common::Logging::gZeroVid, "", (LOG_ERR), __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_ERR) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static..............................", \
+                                           eos::common::Logging::gZeroVid, "", (LOG_ERR), __VA_ARGS__) : "")
 #define eos_static_crit(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static..............................", \
-                                          eos::common::Logging::gZeroVid, "", (LOG_CRIT), __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_CRIT) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static..............................", \
+                                           eos::common::Logging::gZeroVid, "", (LOG_CRIT), __VA_ARGS__) : "")
 #define eos_static_alert(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static..............................", \
-                                          eos::common::Logging::gZeroVid, "", (LOG_ALERT)  , __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_ALERT) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static..............................", \
+                                           eos::common::Logging::gZeroVid, "", (LOG_ALERT)  , __VA_ARGS__) : "")
 #define eos_static_emerg(...) \
-  eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static..............................", \
-                                          eos::common::Logging::gZeroVid,"", (LOG_EMERG)  , __VA_ARGS__)
+  (EOS_LOG_ENABLED(LOG_EMERG) ? \
+   eos::common::Logging::GetInstance().log(__FUNCTION__,__FILE__, __LINE__, "static..............................", \
+                                           eos::common::Logging::gZeroVid,"", (LOG_EMERG)  , __VA_ARGS__) : "")
 
 //------------------------------------------------------------------------------
 //! Log Macros to check if a function would log in a certain log level
 //------------------------------------------------------------------------------
-#define EOS_LOGS_DEBUG   eos::common::Logging::GetInstance().shouldlog(__FUNCTION__,(LOG_DEBUG)  )
-#define EOS_LOGS_INFO    eos::common::Logging::GetInstance().shouldlog(__FUNCTION__,(LOG_INFO)   )
-#define EOS_LOGS_NOTICE  eos::common::Logging::GetInstance().shouldlog(__FUNCTION__,(LOG_NOTICE) )
-#define EOS_LOGS_WARNING eos::common::Logging::GetInstance().shouldlog(__FUNCTION__,(LOG_WARNING))
-#define EOS_LOGS_ERR     eos::common::Logging::GetInstance().shouldlog(__FUNCTION__,(LOG_ERR)    )
-#define EOS_LOGS_CRIT    eos::common::Logging::GetInstance().shouldlog(__FUNCTION__,(LOG_CRIT)   )
-#define EOS_LOGS_ALERT   eos::common::Logging::GetInstance().shouldlog(__FUNCTION__,(LOG_ALERT)  )
-#define EOS_LOGS_EMERG   eos::common::Logging::GetInstance().shouldlog(__FUNCTION__,(LOG_EMERG)  )
+#define EOS_LOGS_DEBUG   (EOS_LOG_ENABLED(LOG_DEBUG) && \
+  eos::common::Logging::GetInstance().shouldlog(__FUNCTION__,(LOG_DEBUG)  ))
+#define EOS_LOGS_INFO    (EOS_LOG_ENABLED(LOG_INFO) && \
+  eos::common::Logging::GetInstance().shouldlog(__FUNCTION__,(LOG_INFO)   ))
+#define EOS_LOGS_NOTICE  (EOS_LOG_ENABLED(LOG_NOTICE) && \
+  eos::common::Logging::GetInstance().shouldlog(__FUNCTION__,(LOG_NOTICE) ))
+#define EOS_LOGS_WARNING (EOS_LOG_ENABLED(LOG_WARNING) && \
+  eos::common::Logging::GetInstance().shouldlog(__FUNCTION__,(LOG_WARNING)))
+#define EOS_LOGS_ERR     (EOS_LOG_ENABLED(LOG_ERR) && \
+  eos::common::Logging::GetInstance().shouldlog(__FUNCTION__,(LOG_ERR)    ))
+#define EOS_LOGS_CRIT    (EOS_LOG_ENABLED(LOG_CRIT) && \
+  eos::common::Logging::GetInstance().shouldlog(__FUNCTION__,(LOG_CRIT)   ))
+#define EOS_LOGS_ALERT   (EOS_LOG_ENABLED(LOG_ALERT) && \
+  eos::common::Logging::GetInstance().shouldlog(__FUNCTION__,(LOG_ALERT)  ))
+#define EOS_LOGS_EMERG   (EOS_LOG_ENABLED(LOG_EMERG) && \
+  eos::common::Logging::GetInstance().shouldlog(__FUNCTION__,(LOG_EMERG)  ))
 
 #define EOSCOMMONLOGGING_CIRCULARINDEXSIZE 10000
 
@@ -309,7 +368,7 @@ public:
   LogCircularIndex gLogCircularIndex; //< global circular index
   LogArray gLogMemory; //< global logging memory
   unsigned long gCircularIndexSize; //< global circular index size
-  int gLogMask; //< log mask
+  std::atomic<int> gLogMask; //< log mask, read by the log macros
   int gPriorityLevel; //< log priority
   bool gToSysLog; //< duplicate into syslog
   XrdSysMutex gMutex; //< global mutex
@@ -321,6 +380,8 @@ public:
   int gShortFormat; //< indiciating if the log-output is in short format
   //! Here one can define log fan-out to different file descriptors than stderr
   std::map<std::string, FILE*> gLogFanOut;
+  //! Indicating if messages are written by the background writer thread
+  std::atomic<bool> gAsync;
 
   //----------------------------------------------------------------------------
   //! Get singleton instance - this method MUST be in the header file so that
@@ -357,6 +418,20 @@ public:
     gToSysLog = onoff;
   }
 
+  //----------------------------------------------------------------------------
+  //! Enable/disable asynchronous logging. When disabled, all messages queued
+  //! so far are written before returning and the writer thread sleeps until
+  //! asynchronous logging is enabled again.
+  //!
+  //! @param onoff if true messages are written by the background writer thread
+  //----------------------------------------------------------------------------
+  void SetAsync(bool onoff);
+
+  //----------------------------------------------------------------------------
+  //! Wait until all messages queued for the background writer are written
+  //----------------------------------------------------------------------------
+  void Flush();
+
   //----------------------------------------------------------------------------
   //! Set the log filter
   //----------------------------------------------------------------------------
@@ -555,7 +630,8 @@ public:
   //! @param priority priority level of the message
   //! @param msg the actual log message
   //!
-  //! @return pointer to the log message
+  //! @return pointer to the log message, in asynchronous mode it is valid
+  //!         until the next message logged by the calling thread
   //----------------------------------------------------------------------------
   const char* log(const char* func, const char* file, int line,
                   const char* logid, const Mapping::VirtualIdentity& vid,
@@ -575,11 +651,63 @@ public:
 
   bool rate_limit(struct timeval& tv, int priority, const char* file, int line);
 
+  //----------------------------------------------------------------------------
+  //! Destructor - waits for the log calls using the writer thread, then
+  //! stops it and writes all pending messages
+  //----------------------------------------------------------------------------
+  ~Logging();
+
 private:
+  class AsyncWriter;
+  std::unique_ptr<AsyncWriter> mWriter; ///< Background writer, once enabled
+  //! Number of log calls currently queueing to the background writer
+  std::atomic<size_t> mAsyncCallers;
+  std::mutex mRateMutex; ///< Protects the state of rate_limit
+
+  //----------------------------------------------------------------------------
+  //! Wait until no log call is queueing to the background writer
+  //----------------------------------------------------------------------------
+  void WaitAsyncCallers();
+
   //----------------------------------------------------------------------------
   //! Constructor - use GetInstance to get singleton object
   //----------------------------------------------------------------------------
   Logging();
+
+  //----------------------------------------------------------------------------
+  //! Format the header and the message of a log line
+  //!
+  //! @param buffer output buffer
+  //! @param size size of the output buffer
+  //! @param tv time of the message
+  //! @param File short source file name
+  //! @param truncname truncated name of the caller
+  //! @param args arguments of the format string msg
+  //! @see log for the remaining parameters
+  //!
+  //! @return offset of the message text in the buffer
+  //----------------------------------------------------------------------------
+  size_t FormatLine(char* buffer, size_t size, const struct timeval& tv,
+                    const char* func, const char* File, int line,
+                    const char* logid, const Mapping::VirtualIdentity& vid,
+                    const char* cident, int priority, const char* truncname,
+                    const char* msg, va_list args);
+
+  //----------------------------------------------------------------------------
+  //! Write a formatted log line to syslog, the fan-out files and stderr and
+  //! store it in the log memory - needs gMutex
+  //!
+  //! @param buffer formatted log line
+  //! @param msgpos offset of the message text in the buffer
+  //! @param File short source file name
+  //! @param truncname truncated name of the caller
+  //! @see log for the remaining parameters
+  //!
+  //! @return pointer to the message stored in the log memory
+  //----------------------------------------------------------------------------
+  const char* WriteLine(char* buffer, size_t msgpos, const char* func,
+                        const char* File, int line, int uid, int gid,
+                        const char* truncname, int priority);
 };
 
 EOSCOMMONNAMESPACE_END
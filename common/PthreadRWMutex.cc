@@ -105,6 +105,15 @@ PthreadRWMutex::TimedRdLock(uint64_t timeout_ns)
   return retc;
 }
 
+//------------------------------------------------------------------------------
+// Try to read lock the mutex without blocking
+//------------------------------------------------------------------------------
+int
+PthreadRWMutex::TryLockRead()
+{
+  return pthread_rwlock_tryrdlock(&mMutex);
+}
+
 //------------------------------------------------------------------------------
 // Unlock a read lock
 //------------------------------------------------------------------------------
@@ -159,4 +168,13 @@ PthreadRWMutex::TimedWrLock(uint64_t timeout_ns)
   return retc;
 }
 
+//------------------------------------------------------------------------------
+// Try to write lock the mutex without blocking
+//------------------------------------------------------------------------------
+int
+PthreadRWMutex::TryLockWrite()
+{
+  return pthread_rwlock_trywrlock(&mMutex);
+}
+
 EOSCOMMONNAMESPACE_END
@@ -66,6 +66,13 @@ public:
   //----------------------------------------------------------------------------
   int TimedRdLock(uint64_t timeout_ns) override;
 
+  //----------------------------------------------------------------------------
+  //! Try to read lock the mutex without blocking
+  //!
+  //! @return 0 if successful, otherwise error number
+  //----------------------------------------------------------------------------
+  int TryLockRead() override;
+
   //----------------------------------------------------------------------------
   //! Unlock a read lock
   //----------------------------------------------------------------------------
@@ -90,6 +97,13 @@ public:
   //----------------------------------------------------------------------------
   int TimedWrLock(uint64_t timeout_ns) override;
 
+  //----------------------------------------------------------------------------
+  //! Try to write lock the mutex without blocking
+  //!
+  //! @return 0 if successful, otherwise error number
+  //----------------------------------------------------------------------------
+  int TryLockWrite() override;
+
 private:
   pthread_rwlock_t mMutex;
   pthread_rwlockattr_t mAttr;
@@ -106,11 +106,28 @@ pthread_rwlock_t RWMutex::mOrderChkLock;
       } while(needloop);                                                       \
     }                                                                          \
   }
+
+// trylock = TryLockRead or TryLockWrite, sets locked if the lock was acquired
+#define EOS_RWMUTEX_PROFILE_TRYLOCK(trylock)                                \
+  bool isprofiled = LockProfiler::IsEnabled(); uint64_t waitstart = 0;      \
+  bool locked = isprofiled && !mMutexImpl->trylock();                       \
+  if (isprofiled && !locked) waitstart = LockProfiler::GetNowInNs();
+
+#define EOS_RWMUTEX_PROFILE_ACQUIRED(write)                                 \
+  if (isprofiled) {                                                         \
+    LockProfiler::GetInstance().Acquired(this, mDebugName.empty() ?         \
+      "unnamed" : mDebugName.c_str(), site, write, waitstart);              \
+  }
+
+#define EOS_RWMUTEX_PROFILE_RELEASED LockProfiler::Released(this);
 #else
 #define EOS_RWMUTEX_CHECKORDER_LOCK
 #define EOS_RWMUTEX_CHECKORDER_UNLOCK
 #define EOS_RWMUTEX_TIMER_START
 #define EOS_RWMUTEX_TIMER_STOP_AND_UPDATE(what) ++(what##LockCounter);
+#define EOS_RWMUTEX_PROFILE_TRYLOCK(trylock) bool locked = false;
+#define EOS_RWMUTEX_PROFILE_ACQUIRED(write)
+#define EOS_RWMUTEX_PROFILE_RELEASED
 #endif
 
 //------------------------------------------------------------------------------
@@ -251,7 +268,7 @@ RWMutex::TimedRdLock(uint64_t timeout_ns)
 // Lock for read
 //------------------------------------------------------------------------------
 void
-RWMutex::LockRead()
+RWMutex::LockRead(const LockCallSite& site)
 {
   EOS_RWMUTEX_CHECKORDER_LOCK;
   EOS_RWMUTEX_TIMER_START;
@@ -267,14 +284,16 @@ RWMutex::LockRead()
 
 #endif
   int retc = 0;
+  EOS_RWMUTEX_PROFILE_TRYLOCK(TryLockRead);
 
-  if ((retc = mMutexImpl->LockRead())) {
+  if (!locked && (retc = mMutexImpl->LockRead())) {
     fprintf(stderr, "%s Failed to read-lock: %s\n", __FUNCTION__,
             strerror(retc));
     std::terminate();
   }
 
   EOS_RWMUTEX_TIMER_STOP_AND_UPDATE(mRd);
+  EOS_RWMUTEX_PROFILE_ACQUIRED(false);
 }
 
 //------------------------------------------------------------------------------
@@ -284,6 +303,7 @@ void
 RWMutex::UnLockRead()
 {
   EOS_RWMUTEX_CHECKORDER_UNLOCK;
+  EOS_RWMUTEX_PROFILE_RELEASED;
 #ifdef EOS_INSTRUMENTED_RWMUTEX
 
   if (mEnableDeadlockCheck || mTransientDeadlockCheck) {
@@ -316,7 +336,7 @@ RWMutex::UnLockRead()
 // Lock for write
 //------------------------------------------------------------------------------
 void
-RWMutex::LockWrite()
+RWMutex::LockWrite(const LockCallSite& site)
 {
   EOS_RWMUTEX_CHECKORDER_LOCK;
   EOS_RWMUTEX_TIMER_START;
@@ -332,8 +352,11 @@ RWMutex::LockWrite()
 
 #endif
   int retc = 0;
+  EOS_RWMUTEX_PROFILE_TRYLOCK(TryLockWrite);
 
-  if (mBlocking) {
+  if (locked) {
+    // Acquired without waiting by the profiler
+  } else if (mBlocking) {
     // A blocking mutex is just a normal lock for write
     if ((retc = mMutexImpl->LockWrite())) {
       fprintf(stderr, "%s Failed to write-lock: %s\n", __FUNCTION__,
@@ -382,6 +405,7 @@ RWMutex::LockWrite()
   mLastWriteLock = std::chrono::duration_cast<std::chrono::milliseconds>
                    (std::chrono::steady_clock::now().time_since_epoch()).count();
   EOS_RWMUTEX_TIMER_STOP_AND_UPDATE(mWr);
+  EOS_RWMUTEX_PROFILE_ACQUIRED(true);
 }
 
 //------------------------------------------------------------------------------
@@ -391,6 +415,7 @@ void
 RWMutex::UnLockWrite()
 {
   EOS_RWMUTEX_CHECKORDER_UNLOCK;
+  EOS_RWMUTEX_PROFILE_RELEASED;
 #ifdef EOS_INSTRUMENTED_RWMUTEX
 
   if (mEnableDeadlockCheck || mTransientDeadlockCheck) {
@@ -1275,24 +1300,24 @@ RWMutex::ResetCheckOrder()
 //------------------------------------------------------------------------------
 // Constructor
 //------------------------------------------------------------------------------
-RWMutexWriteLock::RWMutexWriteLock(RWMutex& mutex):
+RWMutexWriteLock::RWMutexWriteLock(RWMutex& mutex, const LockCallSite& site):
   mWrMutex(&mutex)
 {
-  mWrMutex->LockWrite();
+  mWrMutex->LockWrite(site);
 }
 
 //----------------------------------------------------------------------------
 // Grab mutex and write lock it
 //----------------------------------------------------------------------------
 void
-RWMutexWriteLock::Grab(RWMutex& mutex)
+RWMutexWriteLock::Grab(RWMutex& mutex, const LockCallSite& site)
 {
   if (mWrMutex) {
     throw std::runtime_error("already holding a mutex");
   }
 
   mWrMutex = &mutex;
-  mWrMutex->LockWrite();
+  mWrMutex->LockWrite(site);
 }
 
 
@@ -1323,23 +1348,23 @@ RWMutexWriteLock::~RWMutexWriteLock()
 //------------------------------------------------------------------------------
 // Constructor
 //------------------------------------------------------------------------------
-RWMutexReadLock::RWMutexReadLock(RWMutex& mutex)
+RWMutexReadLock::RWMutexReadLock(RWMutex& mutex, const LockCallSite& site)
 {
-  Grab(mutex);
+  Grab(mutex, site);
 }
 
 //----------------------------------------------------------------------------
 // Grab mutex and write lock it
 //----------------------------------------------------------------------------
 void
-RWMutexReadLock::Grab(RWMutex& mutex)
+RWMutexReadLock::Grab(RWMutex& mutex, const LockCallSite& site)
 {
   if (mRdMutex) {
     throw std::runtime_error("already holding a mutex");
   }
 
   mRdMutex = &mutex;
-  mRdMutex->LockRead();
+  mRdMutex->LockRead(site);
   mAcquiredAt = std::chrono::steady_clock::now();
 }
 
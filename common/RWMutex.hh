@@ -45,6 +45,11 @@
 //! The added latency by order checking for 3 mutexes and 1 rule is about 15%
 //! of the locking/unlocking execution time. An estimation of this added latency
 //! is provided.
+//!
+//! Contention profiling
+//! When compiled with EOS_INSTRUMENTED_RWMUTEX, every lock acquisition first
+//! tries the lock and only measures the wait time if this fails. The wait and
+//! sampled hold times are recorded per call site by the LockProfiler.
 //------------------------------------------------------------------------------
 
 #pragma once
@@ -55,6 +60,7 @@
 #include "common/Namespace.hh"
 #include "common/Timing.hh"
 #include "common/IRWMutex.hh"
+#include "common/LockProfiler.hh"
 #include "XrdSys/XrdSysPthread.hh"
 #include <stdio.h>
 #include <stdint.h>
@@ -165,8 +171,10 @@ public:
 
   //----------------------------------------------------------------------------
   //! Lock for read
+  //!
+  //! @param site call site recorded by the lock profiler
   //----------------------------------------------------------------------------
-  void LockRead();
+  void LockRead(const LockCallSite& site = LockCallSite());
 
   //----------------------------------------------------------------------------
   //! Unlock a read lock
@@ -184,8 +192,10 @@ public:
 
   //----------------------------------------------------------------------------
   //! Lock for write
+  //!
+  //! @param site call site recorded by the lock profiler
   //----------------------------------------------------------------------------
-  void LockWrite();
+  void LockWrite(const LockCallSite& site = LockCallSite());
 
   //----------------------------------------------------------------------------
   //! Unlock a write lock
@@ -592,15 +602,17 @@ public:
   //! Constructor
   //!
   //! @param mutex mutex to lock for write
+  //! @param site call site recorded by the lock profiler
   //----------------------------------------------------------------------------
-  RWMutexWriteLock(RWMutex& mutex);
+  RWMutexWriteLock(RWMutex& mutex, const LockCallSite& site = LockCallSite());
 
   //----------------------------------------------------------------------------
   //! Grab mutex and write lock it
   //!
   //! @param mutex mutex to lock for write
+  //! @param site call site recorded by the lock profiler
   //----------------------------------------------------------------------------
-  void Grab(RWMutex& mutex);
+  void Grab(RWMutex& mutex, const LockCallSite& site = LockCallSite());
 
   //----------------------------------------------------------------------------
   //! Release the write lock after grab
@@ -631,15 +643,17 @@ public:
   //! Constructor
   //!
   //! @param mutex mutex to handle
+  //! @param site call site recorded by the lock profiler
   //----------------------------------------------------------------------------
-  RWMutexReadLock(RWMutex& mutex);
+  RWMutexReadLock(RWMutex& mutex, const LockCallSite& site = LockCallSite());
 
   //----------------------------------------------------------------------------
   //! Grab mutex and read lock it
   //!
   //! @param mutex mutex to lock for read
+  //! @param site call site recorded by the lock profiler
   //----------------------------------------------------------------------------
-  void Grab(RWMutex& mutex);
+  void Grab(RWMutex& mutex, const LockCallSite& site = LockCallSite());
 
   //----------------------------------------------------------------------------
   //! Release the write lock after grab
@@ -29,6 +29,22 @@
 
 EOSCOMMONNAMESPACE_BEGIN
 
+//------------------------------------------------------------------------------
+//! Create an empty Report object
+//------------------------------------------------------------------------------
+Report::Report():
+  ots(0), cts(0), otms(0), ctms(0), uid(0), gid(0), td("none"), lid(0),
+  fid(0), fsid(0), rb(0), rb_min(0), rb_max(0), rb_sigma(0), rv_op(0),
+  rvb_min(0), rvb_max(0), rvb_sum(0), rvb_sigma(0), rs_op(0), rsb_min(0),
+  rsb_max(0), rsb_sum(0), rsb_sigma(0), rc_min(0), rc_max(0), rc_sum(0),
+  rc_sigma(0), wb(0), wb_min(0), wb_max(0), wb_sigma(0), sfwdb(0), sbwdb(0),
+  sxlfwdb(0), sxlbwdb(0), nrc(0), nwc(0), nfwds(0), nbwds(0), nxlfwds(0),
+  nxlbwds(0), rt(0), rvt(0), wt(0), osize(0), csize(0), dsize(0), dc_ts(0),
+  dc_tns(0), dm_ts(0), dm_tns(0), da_ts(0), da_tns(0)
+{
+  SetHost("none");
+}
+
 //------------------------------------------------------------------------------
 //!
 //! Create a Report object based on a report env representation
@@ -47,16 +63,7 @@ Report::Report(XrdOucEnv& report)
   uid = (uid_t) atoi(report.Get("ruid") ? report.Get("ruid") : "0");
   gid = (gid_t) atoi(report.Get("rgid") ? report.Get("rgid") : "0");
   td = report.Get("td") ? report.Get("td") : "none";
-  host = report.Get("host") ? report.Get("host") : "none";
-  server_name = host;
-  server_domain = host;
-
-  auto dpos = host.find('.');
-  if (dpos != std::string::npos)
-  {
-    server_name.erase(dpos);
-    server_domain.erase(0, dpos + 1);
-  }
+  SetHost(report.Get("host") ? report.Get("host") : "none");
 
   lid = strtoul(report.Get("lid") ? report.Get("lid") : "0", 0, 10);
   fid = strtoull(report.Get("fid") ? report.Get("fid") : "0", 0, 10);
@@ -105,15 +112,7 @@ Report::Report(XrdOucEnv& report)
   // sec extensions
   sec_prot = report.Get("sec.prot") ? report.Get("sec.prot") : "";
   sec_name = report.Get("sec.name") ? report.Get("sec.name") : "";
-  sec_host = report.Get("sec.host") ? report.Get("sec.host") : "";
-  sec_domain = report.Get("sec.host") ? report.Get("sec.host") : "";
-
-  dpos = sec_host.find('.');
-  if (dpos != std::string::npos)
-  {
-    sec_host.erase(dpos);
-    sec_domain.erase(0, dpos + 1);
-  }
+  SetSecHost(report.Get("sec.host") ? report.Get("sec.host") : "");
 
   sec_vorg = report.Get("sec.vorg") ? report.Get("sec.vorg") : "";
   sec_role = report.Get("sec.role") ? report.Get("sec.role") : "";
@@ -182,6 +181,65 @@ Report::Dump(XrdOucString& out, bool dumpsec)
 
   out += "\n";
 }
+
+//------------------------------------------------------------------------------
+// Set the server host and split it into server name and domain
+//------------------------------------------------------------------------------
+void
+Report::SetHost(const std::string& fqdn)
+{
+  host = fqdn;
+  server_name = host;
+  server_domain = host;
+  auto dpos = host.find('.');
+
+  if (dpos != std::string::npos) {
+    server_name.erase(dpos);
+    server_domain.erase(0, dpos + 1);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Set the client host and split it into client host name and domain
+//------------------------------------------------------------------------------
+void
+Report::SetSecHost(const std::string& fqdn)
+{
+  sec_host = fqdn;
+  sec_domain = fqdn;
+  auto dpos = sec_host.find('.');
+
+  if (dpos != std::string::npos) {
+    sec_host.erase(dpos);
+    sec_domain.erase(0, dpos + 1);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Map the name of a report field to the key used in the report env
+//------------------------------------------------------------------------------
+std::string
+Report::EnvKey(const std::string& field)
+{
+  if (field == "logid") {
+    return "log";
+  }
+
+  if (field == "uid") {
+    return "ruid";
+  }
+
+  if (field == "gid") {
+    return "rgid";
+  }
+
+  if (field.compare(0, 4, "sec_") == 0) {
+    return "sec." + field.substr(4);
+  }
+
+  return field;
+}
+
 /*----------------------------------------------------------------------------*/
 
 EOSCOMMONNAMESPACE_END
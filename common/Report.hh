@@ -53,7 +53,8 @@ EOSCOMMONNAMESPACE_BEGIN
 
 class Report {
   // ---------------------------------------------------------------------------
-  // the creator of the XrdOucEnv input is defined in XrdFstOfsFile.hh MakeReportEnv
+  // the XrdOucEnv input is rendered from the eos::fst::IoReport filled by
+  // XrdFstOfsFile::MakeReport
   // ---------------------------------------------------------------------------
 private:
 
@@ -131,6 +132,11 @@ public:
   std::string sec_info;    //< auth info (=dn if moninfo configuredin GSI plugin)
   std::string sec_app;     //< auth application
 
+  // ---------------------------------------------------------------------------
+  //! Constructor of an empty report
+  // ---------------------------------------------------------------------------
+  Report();
+
   // ---------------------------------------------------------------------------
   //! Constructor by report env
   // ---------------------------------------------------------------------------
@@ -145,6 +151,22 @@ public:
   //! Dump the report contents into a string
   // ---------------------------------------------------------------------------
   void Dump(XrdOucString &out, bool dumpsec=false);
+
+  // ---------------------------------------------------------------------------
+  //! Set the server host and split it into server name and domain
+  // ---------------------------------------------------------------------------
+  void SetHost(const std::string& fqdn);
+
+  // ---------------------------------------------------------------------------
+  //! Set the client host and split it into client host name and domain
+  // ---------------------------------------------------------------------------
+  void SetSecHost(const std::string& fqdn);
+
+  // ---------------------------------------------------------------------------
+  //! Map the name of a report field (as used in eos::fst::IoReport) to the
+  //! key used in the report env e.g. sec_app => sec.app
+  // ---------------------------------------------------------------------------
+  static std::string EnvKey(const std::string& field);
 };
 
 /*----------------------------------------------------------------------------*/
@@ -59,6 +59,15 @@ SharedMutex::TimedRdLock(uint64_t timeout_ns)
   }
 }
 
+//------------------------------------------------------------------------------
+// Try to read lock the mutex without blocking
+//------------------------------------------------------------------------------
+int
+SharedMutex::TryLockRead()
+{
+  return (mSharedMutex.try_lock_shared() ? 0 : EBUSY);
+}
+
 //------------------------------------------------------------------------------
 // Lock for write
 //------------------------------------------------------------------------------
@@ -92,4 +101,13 @@ SharedMutex::TimedWrLock(uint64_t timeout_ns)
   }
 }
 
+//------------------------------------------------------------------------------
+// Try to write lock the mutex without blocking
+//------------------------------------------------------------------------------
+int
+SharedMutex::TryLockWrite()
+{
+  return (mSharedMutex.try_lock() ? 0 : EBUSY);
+}
+
 EOSCOMMONNAMESPACE_END
@@ -82,6 +82,13 @@ public:
   //----------------------------------------------------------------------------
   int TimedRdLock(uint64_t timeout_ns) override;
 
+  //----------------------------------------------------------------------------
+  //! Try to read lock the mutex without blocking
+  //!
+  //! @return 0 if successful, otherwise error number
+  //----------------------------------------------------------------------------
+  int TryLockRead() override;
+
   //----------------------------------------------------------------------------
   //! Lock for write
   //----------------------------------------------------------------------------
@@ -101,6 +108,13 @@ public:
   //----------------------------------------------------------------------------
   int TimedWrLock(uint64_t timeout_ns) override;
 
+  //----------------------------------------------------------------------------
+  //! Try to write lock the mutex without blocking
+  //!
+  //! @return 0 if successful, otherwise error number
+  //----------------------------------------------------------------------------
+  int TryLockWrite() override;
+
 private:
   std::shared_timed_mutex mSharedMutex;
 };
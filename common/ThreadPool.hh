@@ -23,22 +23,187 @@
 
 #pragma once
 #include "common/Namespace.hh"
-#include "common/ConcurrentQueue.hh"
+#include "common/Logging.hh"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
 #include <future>
+#include <memory>
+#include <mutex>
 #include <sstream>
-
-#ifdef __APPLE__
-#include <cmath>
-#endif
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 EOSCOMMONNAMESPACE_BEGIN
 
 //------------------------------------------------------------------------------------
 //! @brief Dynamically scaling pool of threads which will asynchronously execute tasks
+//!
+//! Every worker owns a deque of tasks. Tasks pushed by a worker go to its own
+//! deque and are taken back in LIFO order, tasks pushed by other threads go
+//! to a shared inject queue which the workers serve in FIFO order. Idle
+//! workers steal from the front of the other deques, so a worker blocked in a
+//! long task does not hold back the tasks it spawned. Tasks are stored in a move-only wrapper with
+//! inline storage, so small callables don't need any allocation.
 //------------------------------------------------------------------------------------
 class ThreadPool
 {
 public:
+  //----------------------------------------------------------------------------
+  //! Move-only task keeping callables of up to sInlineSize bytes inline
+  //----------------------------------------------------------------------------
+  class Task
+  {
+  public:
+    static constexpr size_t sInlineSize = 64;
+
+    Task(): mOps(nullptr) {}
+
+    template<typename F, typename Fn = typename std::decay<F>::type,
+             typename = typename std::enable_if<!std::is_same<Fn, Task>::value>::type>
+    explicit Task(F&& func)
+    {
+      using fits_inline = std::integral_constant<bool,
+            (sizeof(Fn) <= sInlineSize) &&
+            (alignof(Fn) <= alignof(std::max_align_t)) &&
+            std::is_nothrow_move_constructible<Fn>::value>;
+      Init<Fn>(std::forward<F>(func), fits_inline());
+    }
+
+    Task(Task&& other) noexcept: mOps(other.mOps)
+    {
+      if (mOps) {
+        mOps->mMove(&mStorage, &other.mStorage);
+        other.mOps = nullptr;
+      }
+    }
+
+    Task& operator=(Task&& other) noexcept
+    {
+      if (this != &other) {
+        Reset();
+
+        if (other.mOps) {
+          mOps = other.mOps;
+          mOps->mMove(&mStorage, &other.mStorage);
+          other.mOps = nullptr;
+        }
+      }
+
+      return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task()
+    {
+      Reset();
+    }
+
+    //--------------------------------------------------------------------------
+    //! Destroy the callable
+    //--------------------------------------------------------------------------
+    void Reset()
+    {
+      if (mOps) {
+        mOps->mDestroy(&mStorage);
+        mOps = nullptr;
+      }
+    }
+
+    explicit operator bool() const
+    {
+      return (mOps != nullptr);
+    }
+
+    void operator()()
+    {
+      mOps->mInvoke(&mStorage);
+    }
+
+  private:
+    struct Ops {
+      void (*mInvoke)(void*);
+      void (*mMove)(void*, void*); ///< Move construct and destroy the source
+      void (*mDestroy)(void*);
+    };
+
+    //! Callable stored in place
+    template<typename Fn>
+    struct InlineOps {
+      static void Invoke(void* ptr)
+      {
+        (*static_cast<Fn*>(ptr))();
+      }
+
+      static void Move(void* dst, void* src)
+      {
+        new(dst) Fn(std::move(*static_cast<Fn*>(src)));
+        static_cast<Fn*>(src)->~Fn();
+      }
+
+      static void Destroy(void* ptr)
+      {
+        static_cast<Fn*>(ptr)->~Fn();
+      }
+
+      static const Ops* Get()
+      {
+        static const Ops ops = {&Invoke, &Move, &Destroy};
+        return &ops;
+      }
+    };
+
+    //! Callable too large to be stored in place
+    template<typename Fn>
+    struct HeapOps {
+      static void Invoke(void* ptr)
+      {
+        (**static_cast<Fn**>(ptr))();
+      }
+
+      static void Move(void* dst, void* src)
+      {
+        *static_cast<Fn**>(dst) = *static_cast<Fn**>(src);
+      }
+
+      static void Destroy(void* ptr)
+      {
+        delete *static_cast<Fn**>(ptr);
+      }
+
+      static const Ops* Get()
+      {
+        static const Ops ops = {&Invoke, &Move, &Destroy};
+        return &ops;
+      }
+    };
+
+    template<typename Fn, typename F>
+    void Init(F&& func, std::true_type)
+    {
+      new(&mStorage) Fn(std::forward<F>(func));
+      mOps = InlineOps<Fn>::Get();
+    }
+
+    template<typename Fn, typename F>
+    void Init(F&& func, std::false_type)
+    {
+      *reinterpret_cast<Fn**>(&mStorage) = new Fn(std::forward<F>(func));
+      mOps = HeapOps<Fn>::Get();
+    }
+
+    const Ops* mOps;
+    typename std::aligned_storage<sInlineSize, alignof(std::max_align_t)>::type
+    mStorage;
+  };
+
   //----------------------------------------------------------------------------------
   //! @brief Create a new thread pool
   //!
@@ -66,98 +231,20 @@ public:
                       const std::string& identifier = "default"):
     mId(identifier)
   {
+    threadsMin = std::max(threadsMin, 1u);
     threadsMax = threadsMin > threadsMax ? threadsMin : threadsMax;
-    auto threadPoolFunc = [this] {
-      std::pair<bool, std::shared_ptr<std::function<void(void)>>> task;
-      bool toContinue = true;
-
-      do {
-        mTasks.wait_pop(task);
-        toContinue = task.first;
-
-        // Termination is signalled by false
-        if (toContinue)
-        {
-          (*(task.second))();
-        }
-      } while (toContinue);
-    };
 
-    for (auto i = 0u; i < std::max(threadsMin, 1u); i++) {
-      mThreadPool.emplace_back(
-        std::async(std::launch::async, threadPoolFunc)
-      );
+    for (auto i = 0u; i < threadsMax; i++) {
+      mQueues.emplace_back(new WorkQueue());
     }
 
-    mThreadCount += threadsMin;
+    SetThreadCount(threadsMin);
 
     if (threadsMax > threadsMin) {
-      auto maintainerThreadFunc = [this, threadPoolFunc, threadsMin, threadsMax,
-      samplingInterval, samplingNumber, averageWaitingJobsPerNewThread] {
-        auto rounds = 0u, sumQueueSize = 0u;
-        auto signalFuture = mMaintainerSignal.get_future();
-
-        while (true)
-        {
-          if (signalFuture.valid()) {
-            if (signalFuture.wait_for(std::chrono::seconds(samplingInterval)) ==
-            std::future_status::ready) {
-              break;
-            }
-          } else {
-            break;
-          }
-
-          // Check first if we have finished, removable threads/futures and remove them
-          mThreadPool.erase(
-            std::remove_if(
-              mThreadPool.begin(),
-              mThreadPool.end(),
-          [](std::future<void>& future) {
-            return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
-          }
-            ),
-          mThreadPool.end()
-          );
-          sumQueueSize += mTasks.size();
-
-          if (++rounds == samplingNumber) {
-            auto averageQueueSize = (double) sumQueueSize / rounds;
-
-            if (averageQueueSize > mThreadCount) {
-              auto threadsToAdd =
-                std::min((unsigned int) floor(averageQueueSize /
-                                              averageWaitingJobsPerNewThread),
-                         threadsMax - mThreadCount);
-
-              for (auto i = 0u; i < threadsToAdd; i++) {
-                mThreadPool.emplace_back(
-                  std::async(std::launch::async, threadPoolFunc)
-                );
-              }
-
-              mThreadCount += threadsToAdd;
-            } else {
-              unsigned int threadsToRemove =
-                mThreadCount - std::max((unsigned int) floor(averageQueueSize), threadsMin);
-
-              // Push in fake tasks for each threads to be stopped so threads can wake up and
-              // notice that they should terminate. Termination is signalled with false.
-              for (auto i = 0u; i < threadsToRemove; i++) {
-                auto fakeTask = std::make_pair(false,
-                                               std::make_shared<std::function<void(void)>>([] {}));
-                mTasks.push(fakeTask);
-              }
-
-              mThreadCount -= threadsToRemove;
-            }
-
-            sumQueueSize = 0u;
-            rounds = 0u;
-          }
-        }
-      };
-      mMaintainerThread.reset(new std::thread(maintainerThreadFunc));
+      mMaintainerThread.reset(new std::thread(&ThreadPool::Maintain, this,
+                                              threadsMin, threadsMax,
+                                              samplingInterval, samplingNumber,
+                                              std::max(averageWaitingJobsPerNewThread, 1u)));
     }
   }
 
@@ -171,49 +258,54 @@ public:
   //!
   //! @return future of the return type to communicate with your task
   //----------------------------------------------------------------------------
-  template<typename Ret>
-  std::future<Ret> PushTask(std::function<Ret(void)> func)
+  template<typename Ret, typename F>
+  std::future<Ret> PushTask(F&& func)
   {
-    auto task = std::make_shared<std::packaged_task<Ret(void)>>(func);
-    auto taskFunc = std::make_pair(
-                      true,
-                      std::make_shared<std::function<void(void)>>(
-    [task] {
-      (*task)();
-    }
-                      )
-                    );
-    mTasks.push(taskFunc);
-    return task->get_future();
+    std::packaged_task<Ret(void)> task(std::forward<F>(func));
+    std::future<Ret> future = task.get_future();
+    Push(Task(std::move(task)));
+    return future;
   }
 
   //----------------------------------------------------------------------------
-  //! @brief Stop the thread pool. All threads will be stopped and the pool
-  //! cannot be used again.
+  //! @brief Push a task for execution without any way to get its result, this
+  //! avoids the allocation of the shared state of a future. Exceptions thrown
+  //! by the task are logged and dropped.
+  //!
+  //! @param func the function for the task to execute
+  //----------------------------------------------------------------------------
+  template<typename F>
+  void Execute(F&& func)
+  {
+    Push(Task(std::forward<F>(func)));
+  }
+
+  //----------------------------------------------------------------------------
+  //! @brief Stop the thread pool. The tasks already pushed are executed, then
+  //! all threads are stopped and the pool cannot be used again.
   //----------------------------------------------------------------------------
   void Stop()
   {
     if (mMaintainerThread && mMaintainerThread->joinable()) {
-      mMaintainerSignal.set_value();
+      {
+        std::lock_guard<std::mutex> lock(mMaintainerMutex);
+        mStopMaintainer = true;
+      }
+      mMaintainerCv.notify_all();
       mMaintainerThread->join();
     }
 
-    // Push in fake tasks for each threads so all waiting can wake up and
-    // notice that running is over. Termination is signalled with false.
-    for (auto i = 0u; i < mThreadPool.size(); i++) {
-      auto fakeTask = std::make_pair(false,
-                                     std::make_shared<std::function<void(void)>>([] {}));
-      mTasks.push(fakeTask);
+    {
+      std::lock_guard<std::mutex> lock(mSleepMutex);
+      mStop = true;
+      mSleepCv.notify_all();
     }
 
-    for (auto& future : mThreadPool) {
-      if (future.valid()) {
-        future.get();
+    for (auto& queue : mQueues) {
+      if (queue->mThread.joinable()) {
+        queue->mThread.join();
       }
     }
-
-    mTasks.clear();
-    mThreadPool.clear();
   }
 
   //----------------------------------------------------------------------------
@@ -230,8 +322,8 @@ public:
   std::string GetInfo()
   {
     std::ostringstream oss;
-    oss <<  "id=" << mId << ", queue_size=" << mTasks.size()
-        << ",thread_pool_size=" << mThreadPool.size();
+    oss <<  "id=" << mId << ", queue_size=" << mPending.load()
+        << ",thread_pool_size=" << mThreadCount.load();
     return oss.str();
   }
 
@@ -242,12 +334,264 @@ public:
   ThreadPool& operator=(ThreadPool&&) = delete;
 
 private:
-  std::vector<std::future<void>> mThreadPool;
-  eos::common::ConcurrentQueue<std::pair<bool, std::shared_ptr<std::function<void(void)>>>>
-  mTasks;
+  //----------------------------------------------------------------------------
+  //! Deque of tasks - a worker takes its own tasks from the back, the inject
+  //! queue and the thieves take from the front
+  //----------------------------------------------------------------------------
+  struct WorkQueue {
+    std::mutex mMutex;
+    std::deque<Task> mTasks;
+    std::atomic<size_t> mSize {0}; ///< Lets the thieves skip empty deques
+    std::thread mThread;
+    bool mRunning {false}; ///< Protected by mSleepMutex
+  };
+
+  //----------------------------------------------------------------------------
+  //! Pool and index of the worker running in the calling thread
+  //----------------------------------------------------------------------------
+  struct WorkerContext {
+    ThreadPool* mPool;
+    unsigned int mIndex;
+  };
+
+  static WorkerContext& GetContext()
+  {
+    static thread_local WorkerContext context {nullptr, 0};
+    return context;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Queue a task and wake up a sleeping worker
+  //----------------------------------------------------------------------------
+  void Push(Task&& task)
+  {
+    WorkerContext& context = GetContext();
+    WorkQueue& queue = (context.mPool == this) ? *mQueues[context.mIndex] :
+                       mInject;
+    // Count the task before publishing it so that the worker taking it never
+    // decrements the counter below zero. This pairs with the sleeping worker
+    // checking mPending after incrementing mSleeping, either the worker sees
+    // the task or we see the worker.
+    mPending.fetch_add(1);
+    {
+      std::lock_guard<std::mutex> lock(queue.mMutex);
+      queue.mTasks.push_back(std::move(task));
+      queue.mSize.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (mSleeping.load()) {
+      std::lock_guard<std::mutex> lock(mSleepMutex);
+      mSleepCv.notify_one();
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Take a task from the back or the front of a deque
+  //----------------------------------------------------------------------------
+  static bool Pop(WorkQueue& queue, Task& task, bool lifo)
+  {
+    if (!queue.mSize.load(std::memory_order_relaxed)) {
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lock(queue.mMutex);
+
+    if (queue.mTasks.empty()) {
+      return false;
+    }
+
+    if (lifo) {
+      task = std::move(queue.mTasks.back());
+      queue.mTasks.pop_back();
+    } else {
+      task = std::move(queue.mTasks.front());
+      queue.mTasks.pop_front();
+    }
+
+    queue.mSize.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Take the next task of a worker - its own tasks in LIFO order, then the
+  //! external ones in FIFO order. The inject queue is looked at first every
+  //! sInjectInterval tasks so that workers spawning tasks don't starve it.
+  //----------------------------------------------------------------------------
+  bool Next(WorkQueue& own, unsigned int& ticks, Task& task)
+  {
+    if ((++ticks % sInjectInterval == 0) && Pop(mInject, task, false)) {
+      return true;
+    }
+
+    return (Pop(own, task, true) || Pop(mInject, task, false));
+  }
+
+  //----------------------------------------------------------------------------
+  //! Take a task from the front of another worker's deque
+  //----------------------------------------------------------------------------
+  bool Steal(unsigned int index, Task& task)
+  {
+    size_t num = mQueues.size();
+
+    for (size_t i = 1; i < num; ++i) {
+      if (Pop(*mQueues[(index + i) % num], task, false)) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Worker loop - workers above the thread count exit once they find no
+  //! more tasks, so the deque of a retired worker is drained by stealing
+  //----------------------------------------------------------------------------
+  void WorkerLoop(unsigned int index)
+  {
+    WorkerContext& context = GetContext();
+    context.mPool = this;
+    context.mIndex = index;
+    WorkQueue& own = *mQueues[index];
+    Task task;
+    int spins = 0;
+    unsigned int ticks = 0;
+
+    while (true) {
+      if (Next(own, ticks, task) || Steal(index, task)) {
+        mPending.fetch_sub(1);
+        Run(task);
+        task.Reset();
+        spins = 0;
+        continue;
+      }
+
+      // Look again for a short while before sleeping, this saves the wake up
+      // of the workers when tasks are pushed at a high rate
+      if (spins++ < sSpinsBeforeSleep) {
+        std::this_thread::yield();
+        continue;
+      }
+
+      spins = 0;
+
+      std::unique_lock<std::mutex> lock(mSleepMutex);
+
+      if ((index >= mThreadCount) || (mStop && !mPending)) {
+        own.mRunning = false;
+        break;
+      }
+
+      ++mSleeping;
+      mSleepCv.wait_for(lock, std::chrono::seconds(1), [this, index] {
+        return (mPending || mStop || (index >= mThreadCount));
+      });
+      --mSleeping;
+    }
+
+    context.mPool = nullptr;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Run a task, exceptions can only escape from tasks pushed with Execute
+  //----------------------------------------------------------------------------
+  void Run(Task& task)
+  {
+    try {
+      task();
+    } catch (const std::exception& e) {
+      eos_static_err("msg=\"thread pool task failed\" pool=%s what=\"%s\"",
+                     mId.c_str(), e.what());
+    } catch (...) {
+      eos_static_err("msg=\"thread pool task failed\" pool=%s", mId.c_str());
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Set the number of workers, starting the missing ones and waking up the
+  //! ones which have to exit
+  //----------------------------------------------------------------------------
+  void SetThreadCount(unsigned int count)
+  {
+    std::lock_guard<std::mutex> lock(mSleepMutex);
+    mThreadCount = count;
+
+    for (auto i = 0u; i < count; i++) {
+      WorkQueue& queue = *mQueues[i];
+
+      if (!queue.mRunning) {
+        // The previous worker of this slot has exited or is exiting
+        if (queue.mThread.joinable()) {
+          queue.mThread.join();
+        }
+
+        queue.mRunning = true;
+        queue.mThread = std::thread(&ThreadPool::WorkerLoop, this, i);
+      }
+    }
+
+    mSleepCv.notify_all();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Maintainer loop - samples the number of waiting tasks and scales the
+  //! number of workers between threadsMin and threadsMax
+  //----------------------------------------------------------------------------
+  void Maintain(unsigned int threadsMin, unsigned int threadsMax,
+                unsigned int samplingInterval, unsigned int samplingNumber,
+                unsigned int averageWaitingJobsPerNewThread)
+  {
+    auto rounds = 0u;
+    uint64_t sumQueueSize = 0;
+    std::unique_lock<std::mutex> lock(mMaintainerMutex);
+
+    while (!mMaintainerCv.wait_for(lock, std::chrono::seconds(samplingInterval),
+    [this] { return mStopMaintainer; })) {
+      sumQueueSize += mPending;
+
+      if (++rounds == samplingNumber) {
+        auto averageQueueSize = (double) sumQueueSize / rounds;
+        unsigned int threadCount = mThreadCount;
+
+        if (averageQueueSize > threadCount) {
+          auto threadsToAdd =
+            std::min((unsigned int) floor(averageQueueSize /
+                                          averageWaitingJobsPerNewThread),
+                     threadsMax - threadCount);
+
+          if (threadsToAdd) {
+            SetThreadCount(threadCount + threadsToAdd);
+          }
+        } else {
+          unsigned int threads = std::max((unsigned int) floor(averageQueueSize),
+                                          threadsMin);
+
+          if (threads < threadCount) {
+            SetThreadCount(threads);
+          }
+        }
+
+        sumQueueSize = 0;
+        rounds = 0u;
+      }
+    }
+  }
+
+  //! Number of empty scans of an idle worker before going to sleep
+  static constexpr int sSpinsBeforeSleep = 64;
+  //! Number of tasks after which a worker serves the inject queue first
+  static constexpr unsigned int sInjectInterval = 61;
+  std::vector<std::unique_ptr<WorkQueue>> mQueues; ///< One deque per worker
+  WorkQueue mInject; ///< Tasks pushed by threads outside of the pool
+  std::atomic_uint mThreadCount {0}; ///< Number of active workers
+  std::atomic<uint64_t> mPending {0}; ///< Tasks queued but not yet started
+  std::atomic_int mSleeping {0}; ///< Workers waiting for tasks
+  std::mutex mSleepMutex; ///< Protects sleeping, scaling and stopping
+  std::condition_variable mSleepCv;
+  bool mStop {false};
   std::unique_ptr<std::thread> mMaintainerThread;
-  std::promise<void> mMaintainerSignal;
-  std::atomic_uint mThreadCount {0};
+  std::mutex mMaintainerMutex;
+  std::condition_variable mMaintainerCv;
+  bool mStopMaintainer {false};
   std::string mId; ///< Thread pool identifier
 };
 
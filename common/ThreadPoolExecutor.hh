@@ -0,0 +1,88 @@
+//------------------------------------------------------------------------------
+// File: common/ThreadPoolExecutor.hh
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#pragma once
+#include "common/Namespace.hh"
+#include "common/ThreadPool.hh"
+#include <folly/Executor.h>
+
+EOSCOMMONNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Class ThreadPoolExecutor - folly::Executor running the tasks in a
+//! ThreadPool, so folly futures can be continued via a pool shared with
+//! other users or via a pool owned by the executor.
+//------------------------------------------------------------------------------
+class ThreadPoolExecutor: public folly::Executor
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Constructor using an existing pool which has to outlive the executor
+  //!
+  //! @param pool thread pool
+  //----------------------------------------------------------------------------
+  explicit ThreadPoolExecutor(ThreadPool& pool):
+    mPool(&pool)
+  {}
+
+  //----------------------------------------------------------------------------
+  //! Constructor creating a pool owned by the executor
+  //!
+  //! @param threadsMin minimum number of threads
+  //! @param threadsMax maximum number of threads
+  //! @param identifier pool identifier
+  //----------------------------------------------------------------------------
+  ThreadPoolExecutor(unsigned int threadsMin, unsigned int threadsMax,
+                     const std::string& identifier):
+    mOwnedPool(new ThreadPool(threadsMin, threadsMax, 10, 12, 10, identifier)),
+    mPool(mOwnedPool.get())
+  {}
+
+  //----------------------------------------------------------------------------
+  //! Destructor - an owned pool runs the queued tasks before it is destroyed
+  //----------------------------------------------------------------------------
+  ~ThreadPoolExecutor() override = default;
+
+  //----------------------------------------------------------------------------
+  //! Queue a function for execution
+  //!
+  //! @param func function to execute
+  //----------------------------------------------------------------------------
+  void add(folly::Func func) override
+  {
+    mPool->Execute(std::move(func));
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the underlying thread pool
+  //----------------------------------------------------------------------------
+  ThreadPool& GetPool()
+  {
+    return *mPool;
+  }
+
+private:
+  std::unique_ptr<ThreadPool> mOwnedPool; ///< Pool owned by the executor
+  ThreadPool* mPool; ///< Pool running the tasks
+};
+
+EOSCOMMONNAMESPACE_END
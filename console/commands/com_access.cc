@@ -215,7 +215,10 @@ com_access(char* arg1)
         in += "&mgm.access.stall=";
         in += id;
 
-        if ((rtype.beginswith("rate:user:")) || (rtype.beginswith("rate:group:"))) {
+        if ((rtype.beginswith("rate:user:")) || (rtype.beginswith("rate:group:")) ||
+            (rtype.beginswith("bucket:user:")) ||
+            (rtype.beginswith("bucket:group:")) ||
+            (rtype.beginswith("bucket:host:"))) {
           if ((rtype.find(":"), 11) != STR_NPOS) {
             in += "&mgm.access.type=";
             in += rtype;
@@ -323,12 +326,24 @@ com_access_usage:
   fprintf(stdout, "\n");
   fprintf(stdout,
           "                                                : rule strength: user-limit >> group-limit >> wildcard-limit\n");
+  fprintf(stdout,
+          "access set limit <rate>[:<burst>] bucket:{user,group,host}:{name}:<op>\n");
+  fprintf(stdout,
+          "       bucket:{user,group,host}:{name}:<op>     : token bucket rate limit - requests exceeding <rate> Hz after the bucket of <burst> requests is exhausted are stalled until a token is available\n");
+  fprintf(stdout,
+          "                                                  <op> : * for all, r for read, w for write or the MGM function name e.g. stat, open\n");
+  fprintf(stdout,
+          "                                                  bucket:user:*:<op> : every user gets a separate bucket\n");
+  fprintf(stdout,
+          "                                                  - <burst> defaults to <rate>\n");
+  fprintf(stdout, "\n");
   fprintf(stdout, "access rm  stall [r|w|ENOENT|ENONET]:\n");
   fprintf(stdout,
           "                                                  removes global stall time\n");
   fprintf(stdout,
           "                                          [r|w] : removes stall time for read or write requests\n");
   fprintf(stdout, "       rm limit rate:{user,group}:{name}:<counter\n");
+  fprintf(stdout, "       rm limit bucket:{user,group,host}:{name}:<op>\n");
   fprintf(stdout,
           "                                                : remove rate limitation\n");
   fprintf(stdout, "access ls [-m] [-n] :\n");
@@ -354,6 +369,8 @@ com_access_usage:
           "  access set limit 2000 rate:group:zp:Stat        Limit the stat rate for the zp group to 2kHz\n");
   fprintf(stdout,
           "  access rm limit rate:user:*:OpenRead            Removes the defined limit\n");
+  fprintf(stdout,
+          "  access set limit 500:1000 bucket:user:*:stat    Limit every user to 500 stat/s with bursts of 1000\n");
   global_retc = EINVAL;
   return (0);
 }
@@ -156,6 +156,8 @@ com_fusex(char* arg1)
         } else {
           if (option == "-f") {
             options += "f";
+          } else if (option == "-b") {
+            options += "b";
           } else {
             if (option == "-l") {
               options += "l";
@@ -177,13 +179,15 @@ com_fusex(char* arg1)
   return (0);
 com_fusex_usage:
   fprintf(stdout,
-          "usage: fusex ls [-l] [-f]                         :  print statistics about eosxd fuse clients\n");
+          "usage: fusex ls [-l] [-f] [-b]                    :  print statistics about eosxd fuse clients\n");
   fprintf(stdout,
           "                [no option]                                          -  break down by client host [default]\n");
   fprintf(stdout,
           "                -l                                                   -  break down by client host and show statistics \n");
   fprintf(stdout,
           "                -f                                                   -  show ongoing flush locks\n");
+  fprintf(stdout,
+          "                -b                                                   -  show statistics of the md update and cap release broadcasts\n");
   fprintf(stdout, "\n");
   fprintf(stdout,
           "       fuxex evict <uuid> [<reason>]                                 :  evict a fuse client\n");
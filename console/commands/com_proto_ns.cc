@@ -113,6 +113,12 @@ NsHelper::ParseCommand(const char* arg)
           mutex->set_toggle_order(true);
         } else if (soption == "--toggledeadlock") {
           mutex->set_toggle_deadlock(true);
+        } else if (soption == "--contention") {
+          mutex->set_contention(true);
+        } else if (soption == "--togglecontention") {
+          mutex->set_toggle_contention(true);
+        } else if (soption == "--resetcontention") {
+          mutex->set_reset_contention(true);
         } else if (soption == "--smplrate1") {
           mutex->set_sample_rate1(true);
         } else if (soption == "--smplrate10") {
@@ -385,7 +391,7 @@ void com_ns_help()
       << "    -a      : break down by uid/gid" << std::endl
       << "    -m      : display in monitoring format <key>=<value>" << std::endl
       << "    -n      : display numerical uid/gid(s)" << std::endl
-      << "    --reset : reset namespace counters" << std::endl
+      << "    --reset : reset namespace and lock contention counters" << std::endl
       << std::endl
       << "  ns mutex [<option>]" << std::endl
       << "    manage mutex monitoring. Option can be:" << std::endl
@@ -398,6 +404,11 @@ void com_ns_help()
       << std::endl
       << "    --smplrate100    : set timing sample rate at 100% (severe slow-down)"
       << std::endl
+      << "    --contention     : print the lock wait and hold time percentiles per"
+      << " lock and the call sites waiting the most" << std::endl
+      << "    --togglecontention : toggle the contention profiling (default off)"
+      << std::endl
+      << "    --resetcontention  : reset the contention counters" << std::endl
       << std::endl
       << "  ns compact off|on <delay> [<interval>] [<type>]" << std::endl
       << "    enable online compaction after <delay> seconds" << std::endl
@@ -47,6 +47,7 @@ public:
   XrdOucString FstHostPort; // <host>:<port>
   XrdOucString FstS3Credentials; // S3 storage credentials <access>:<secret>
   XrdOucString Manager; // <host>:<port>
+  std::string ReportBatchManager; // manager which accepts report batches
   XrdOucString KernelVersion; // kernel version of the host
   std::string ProtoWFEndpoint; // proto wf endpoint (typically CTA frontend)
   std::string ProtoWFResource; //  proto wf resource (typically CTA frontend)
@@ -1616,36 +1616,30 @@ XrdFstOfs::MakeDeletionReport(eos::common::FileSystem::fsid_t fsid,
                               unsigned long long fid,
                               struct stat& deletion_stat)
 {
-  XrdOucString reportString;
-  char report[16384];
-  snprintf(report, sizeof(report) - 1,
-           "log=%s&"
-           "host=%s&fid=%llu&fsid=%u&"
-           "dc_ts=%lu&dc_tns=%lu&"
-           "dm_ts=%lu&dm_tns=%lu&"
-           "da_ts=%lu&da_tns=%lu&"
-           "dsize=%li&sec.app=deletion"
-           , this->logId
-           , gOFS.mHostName, fid, fsid
+  eos::fst::IoReport report;
+  report.set_logid(this->logId);
+  report.set_host(gOFS.mHostName);
+  report.set_fid(fid);
+  report.set_fsid(fsid);
 #ifdef __APPLE__
-           , deletion_stat.st_ctimespec.tv_sec
-           , deletion_stat.st_ctimespec.tv_nsec
-           , deletion_stat.st_mtimespec.tv_sec
-           , deletion_stat.st_mtimespec.tv_nsec
-           , deletion_stat.st_atimespec.tv_sec
-           , deletion_stat.st_atimespec.tv_nsec
+  report.set_dc_ts(deletion_stat.st_ctimespec.tv_sec);
+  report.set_dc_tns(deletion_stat.st_ctimespec.tv_nsec);
+  report.set_dm_ts(deletion_stat.st_mtimespec.tv_sec);
+  report.set_dm_tns(deletion_stat.st_mtimespec.tv_nsec);
+  report.set_da_ts(deletion_stat.st_atimespec.tv_sec);
+  report.set_da_tns(deletion_stat.st_atimespec.tv_nsec);
 #else
-           , deletion_stat.st_ctim.tv_sec
-           , deletion_stat.st_ctim.tv_nsec
-           , deletion_stat.st_mtim.tv_sec
-           , deletion_stat.st_mtim.tv_nsec
-           , deletion_stat.st_atim.tv_sec
-           , deletion_stat.st_atim.tv_nsec
+  report.set_dc_ts(deletion_stat.st_ctim.tv_sec);
+  report.set_dc_tns(deletion_stat.st_ctim.tv_nsec);
+  report.set_dm_ts(deletion_stat.st_mtim.tv_sec);
+  report.set_dm_tns(deletion_stat.st_mtim.tv_nsec);
+  report.set_da_ts(deletion_stat.st_atim.tv_sec);
+  report.set_da_tns(deletion_stat.st_atim.tv_nsec);
 #endif
-           , deletion_stat.st_size);
-  reportString = report;
+  report.set_dsize(deletion_stat.st_size);
+  report.set_sec_app("deletion");
   gOFS.ReportQueueMutex.Lock();
-  gOFS.ReportQueue.push(reportString);
+  gOFS.ReportQueue.push(std::move(report));
   gOFS.ReportQueueMutex.UnLock();
 }
 EOSFSTNAMESPACE_END
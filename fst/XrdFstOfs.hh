@@ -28,6 +28,7 @@
 #include "fst/Config.hh"
 #include "fst/Fmd.hh"
 #include "common/Logging.hh"
+#include "proto/IoReport.pb.h"
 #include "mq/XrdMqMessaging.hh"
 #include "mq/XrdMqSharedObject.hh"
 #include "XrdOfs/XrdOfs.hh"
@@ -365,7 +366,7 @@ public:
   //! Queue where file transaction reports get stored and picked up by a
   //! thread running in the Storage class.
   XrdSysMutex ReportQueueMutex;
-  std::queue<XrdOucString> ReportQueue;
+  std::queue<eos::fst::IoReport> ReportQueue;
   //! Queue where log error are stored and picked up by a thread running in Storage
   XrdSysMutex ErrorReportQueueMutex;
   std::queue<XrdOucString> ErrorReportQueue;
@@ -701,7 +701,7 @@ XrdFstOfsFile::AddWriteTime()
 // Make report
 //------------------------------------------------------------------------------
 void
-XrdFstOfsFile::MakeReportEnv(XrdOucString& reportString)
+XrdFstOfsFile::MakeReport(eos::fst::IoReport& report)
 {
   // compute avg, min, max, sigma for read and written bytes
   unsigned long long rmin, rmax, rsum;
@@ -717,7 +717,6 @@ XrdFstOfsFile::MakeReportEnv(XrdOucString& reportString)
     ComputeStatistics(monReadvBytes, rvmin, rvmax, rvsum, rvsigma);
     ComputeStatistics(monReadSingleBytes, rsmin, rsmax, rssum, rssigma);
     ComputeStatistics(monReadvCount, rcmin, rcmax, rcsum, rcsigma);
-    char report[16384];
 
     if (rmin == 0xffffffff) {
       rmin = 0;
@@ -727,52 +726,80 @@ XrdFstOfsFile::MakeReportEnv(XrdOucString& reportString)
       wmin = 0;
     }
 
-    snprintf(report, sizeof(report) - 1,
-             "log=%s&path=%s&ruid=%u&rgid=%u&td=%s&"
-             "host=%s&lid=%lu&fid=%llu&fsid=%lu&"
-             "ots=%lu&otms=%lu&"
-             "cts=%lu&ctms=%lu&"
-             "nrc=%lu&nwc=%lu&"
-             "rb=%llu&rb_min=%llu&rb_max=%llu&rb_sigma=%.02f&"
-             "rv_op=%llu&rvb_min=%llu&rvb_max=%llu&rvb_sum=%llu&rvb_sigma=%.02f&"
-             "rs_op=%llu&rsb_min=%llu&rsb_max=%llu&rsb_sum=%llu&rsb_sigma=%.02f&"
-             "rc_min=%lu&rc_max=%lu&rc_sum=%lu&rc_sigma=%.02f&"
-             "wb=%llu&wb_min=%llu&wb_max=%llu&wb_sigma=%.02f&"
-             "sfwdb=%llu&sbwdb=%llu&sxlfwdb=%llu&sxlbwdb=%llu&"
-             "nfwds=%lu&nbwds=%lu&nxlfwds=%lu&nxlbwds=%lu&"
-             "rt=%.02f&rvt=%.02f&wt=%.02f&osize=%llu&csize=%llu&%s"
-             , this->logId
-             , mCapOpaque->Get("mgm.path") ? mCapOpaque->Get("mgm.path") : mNsPath.c_str()
-             , this->vid.uid, this->vid.gid, tIdent.c_str()
-             , gOFS.mHostName, mLid, mFileId, mFsId
-             , openTime.tv_sec, (unsigned long) openTime.tv_usec / 1000
-             , closeTime.tv_sec, (unsigned long) closeTime.tv_usec / 1000
-             , rCalls, wCalls
-             , rsum, rmin, rmax, rsigma
-             , (unsigned long long)monReadvBytes.size(), rvmin, rvmax, rvsum, rvsigma
-             , (unsigned long long)monReadSingleBytes.size(), rsmin, rsmax, rssum, rssigma
-             , rcmin, rcmax, rcsum, rcsigma
-             , wsum
-             , wmin
-             , wmax
-             , wsigma
-             , sFwdBytes
-             , sBwdBytes
-             , sXlFwdBytes
-             , sXlBwdBytes
-             , nFwdSeeks
-             , nBwdSeeks
-             , nXlFwdSeeks
-             , nXlBwdSeeks
-             , ((rTime.tv_sec * 1000.0) + (rTime.tv_usec / 1000.0))
-             , ((rvTime.tv_sec * 1000.0) + (rvTime.tv_usec / 1000.0))
-             , ((wTime.tv_sec * 1000.0) + (wTime.tv_usec / 1000.0))
-             , (unsigned long long) openSize
-             , (unsigned long long) closeSize
-             , eos::common::SecEntity::ToEnv(mSecString.c_str(),
-                 ((mTpcFlag == kTpcDstSetup) ||
-                  (mTpcFlag == kTpcSrcRead)) ? "tpc" : 0).c_str());
-    reportString = report;
+    report.set_rv_op(monReadvBytes.size());
+    report.set_rs_op(monReadSingleBytes.size());
+  }
+  report.set_logid(this->logId);
+  report.set_path(mCapOpaque->Get("mgm.path") ? mCapOpaque->Get("mgm.path") :
+                  mNsPath.c_str());
+  report.set_uid(this->vid.uid);
+  report.set_gid(this->vid.gid);
+  report.set_td(tIdent.c_str());
+  report.set_host(gOFS.mHostName);
+  report.set_lid(mLid);
+  report.set_fid(mFileId);
+  report.set_fsid(mFsId);
+  report.set_ots(openTime.tv_sec);
+  report.set_otms(openTime.tv_usec / 1000);
+  report.set_cts(closeTime.tv_sec);
+  report.set_ctms(closeTime.tv_usec / 1000);
+  report.set_nrc(rCalls);
+  report.set_nwc(wCalls);
+  report.set_rb(rsum);
+  report.set_rb_min(rmin);
+  report.set_rb_max(rmax);
+  report.set_rb_sigma(rsigma);
+  report.set_rvb_min(rvmin);
+  report.set_rvb_max(rvmax);
+  report.set_rvb_sum(rvsum);
+  report.set_rvb_sigma(rvsigma);
+  report.set_rsb_min(rsmin);
+  report.set_rsb_max(rsmax);
+  report.set_rsb_sum(rssum);
+  report.set_rsb_sigma(rssigma);
+  report.set_rc_min(rcmin);
+  report.set_rc_max(rcmax);
+  report.set_rc_sum(rcsum);
+  report.set_rc_sigma(rcsigma);
+  report.set_wb(wsum);
+  report.set_wb_min(wmin);
+  report.set_wb_max(wmax);
+  report.set_wb_sigma(wsigma);
+  report.set_sfwdb(sFwdBytes);
+  report.set_sbwdb(sBwdBytes);
+  report.set_sxlfwdb(sXlFwdBytes);
+  report.set_sxlbwdb(sXlBwdBytes);
+  report.set_nfwds(nFwdSeeks);
+  report.set_nbwds(nBwdSeeks);
+  report.set_nxlfwds(nXlFwdSeeks);
+  report.set_nxlbwds(nXlBwdSeeks);
+  report.set_rt((rTime.tv_sec * 1000.0) + (rTime.tv_usec / 1000.0));
+  report.set_rvt((rvTime.tv_sec * 1000.0) + (rvTime.tv_usec / 1000.0));
+  report.set_wt((wTime.tv_sec * 1000.0) + (wTime.tv_usec / 1000.0));
+  report.set_osize(openSize);
+  report.set_csize(closeSize);
+  // the security entity is stored as prot|name|host|vorg|grps|role|info|app
+  std::vector<std::string> tokens;
+  std::string entitystring = mSecString.c_str();
+  eos::common::StringConversion::EmptyTokenize(entitystring, tokens, "|");
+
+  if (tokens.size() > 7) {
+    report.set_sec_prot(tokens[0]);
+    report.set_sec_name(tokens[1]);
+    report.set_sec_host(tokens[2]);
+    report.set_sec_vorg(tokens[3]);
+    report.set_sec_grps(tokens[4]);
+    report.set_sec_role(tokens[5]);
+    report.set_sec_info(tokens[6]);
+
+    if ((tokens[7].empty() || (tokens[7] == "-")) &&
+        ((mTpcFlag == kTpcDstSetup) || (mTpcFlag == kTpcSrcRead))) {
+      report.set_sec_app("tpc");
+    } else {
+      report.set_sec_app(tokens[7]);
+    }
+  } else {
+    eos_err("msg=\"illegal security entity\" sec=\"%s\"", mSecString.c_str());
   }
 }
 
@@ -1501,10 +1528,10 @@ XrdFstOfsFile::close()
         // We don't want a report for the source tpc setup. The kTpcSrcRead
         // stage actually uses the opaque info from kTpcSrcSetup and that's
         // why we also generate a report at this stage.
-        XrdOucString reportString = "";
-        MakeReportEnv(reportString);
+        eos::fst::IoReport report;
+        MakeReport(report);
         gOFS.ReportQueueMutex.Lock();
-        gOFS.ReportQueue.push(reportString);
+        gOFS.ReportQueue.push(std::move(report));
         gOFS.ReportQueueMutex.UnLock();
       }
 
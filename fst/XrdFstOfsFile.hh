@@ -31,6 +31,7 @@
 #include "fst/checksum/CheckSum.hh"
 #include "fst/storage/Storage.hh"
 #include "common/FileId.hh"
+#include "proto/IoReport.pb.h"
 #include "XrdOfs/XrdOfs.hh"
 #include "XrdOfs/XrdOfsTPCInfo.hh"
 #include "XrdOuc/XrdOucString.hh"
@@ -566,9 +567,11 @@ private:
   }
 
   //----------------------------------------------------------------------------
-  //! Create report as a string
+  //! Fill the IO report of the file transaction from the counters
+  //!
+  //! @param report report to fill
   //----------------------------------------------------------------------------
-  void MakeReportEnv(XrdOucString& reportString);
+  void MakeReport(eos::fst::IoReport& report);
 
   //----------------------------------------------------------------------------
   //! Static method used to start an asynchronous thread which is doing the
@@ -43,6 +43,7 @@ Storage::Communicator()
   std::string watch_symkey = "symkey";
   std::string watch_manager = "manager";
   std::string watch_publishinterval = "publish.interval";
+  std::string watch_reportbatch = "report.batch";
   std::string watch_debuglevel = "debug.level";
   std::string watch_gateway = "txgw";
   std::string watch_gateway_rate = "gw.rate";
@@ -63,6 +64,8 @@ Storage::Communicator()
         XrdMqSharedObjectChangeNotifier::kMqSubjectModification);
   ok &= gOFS.ObjectNotifier.SubscribesToKey("communicator", watch_publishinterval,
         XrdMqSharedObjectChangeNotifier::kMqSubjectModification);
+  ok &= gOFS.ObjectNotifier.SubscribesToKey("communicator", watch_reportbatch,
+        XrdMqSharedObjectChangeNotifier::kMqSubjectModification);
   ok &= gOFS.ObjectNotifier.SubscribesToKey("communicator", watch_debuglevel,
         XrdMqSharedObjectChangeNotifier::kMqSubjectModification);
   ok &= gOFS.ObjectNotifier.SubscribesToKey("communicator", watch_gateway,
@@ -243,6 +246,21 @@ Storage::Communicator()
             gOFS.ObjectManager.HashMutex.UnLockRead();
           }
 
+          if (key == "report.batch") {
+            gOFS.ObjectManager.HashMutex.LockRead();
+            // we received the manager accepting report batches
+            XrdMqSharedHash* hash = gOFS.ObjectManager.GetObject(queue.c_str(), "hash");
+
+            if (hash) {
+              std::string manager = hash->Get("report.batch");
+              eos_static_info("report.batch=%s", manager.c_str());
+              XrdSysMutexHelper lock(Config::gConfig.Mutex);
+              Config::gConfig.ReportBatchManager = manager;
+            }
+
+            gOFS.ObjectManager.HashMutex.UnLockRead();
+          }
+
           if (key == "debug.level") {
             gOFS.ObjectManager.HashMutex.LockRead();
             // we received a manager
@@ -24,49 +24,182 @@
 /*----------------------------------------------------------------------------*/
 #include "fst/storage/Storage.hh"
 #include "fst/XrdFstOfs.hh"
-
+#include "common/Report.hh"
+#include "common/SymKeys.hh"
+#include "proto/IoReport.pb.h"
 /*----------------------------------------------------------------------------*/
 
 EOSFSTNAMESPACE_BEGIN
 
+//! Maximum number of reports packed into one message
+static constexpr size_t sMaxReportBatch = 1024;
+
+//------------------------------------------------------------------------------
+//! Render an IoReport in the report env format understood by all MGMs, only
+//! the fields which are set are rendered
+//------------------------------------------------------------------------------
+static void
+IoReportToEnv(const eos::fst::IoReport& in, std::string& out)
+{
+  using google::protobuf::FieldDescriptor;
+  const google::protobuf::Descriptor* desc = in.GetDescriptor();
+  const google::protobuf::Reflection* refl = in.GetReflection();
+  char val[64];
+  out.clear();
+
+  for (int i = 0; i < desc->field_count(); ++i) {
+    const FieldDescriptor* field = desc->field(i);
+
+    if (!refl->HasField(in, field)) {
+      continue;
+    }
+
+    if (out.length()) {
+      out += '&';
+    }
+
+    out += eos::common::Report::EnvKey(field->name());
+    out += '=';
+
+    switch (field->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_STRING:
+      out += refl->GetString(in, field);
+      continue;
+
+    case FieldDescriptor::CPPTYPE_UINT32:
+      snprintf(val, sizeof(val), "%u", refl->GetUInt32(in, field));
+      break;
+
+    case FieldDescriptor::CPPTYPE_UINT64:
+      snprintf(val, sizeof(val), "%llu",
+               (unsigned long long) refl->GetUInt64(in, field));
+      break;
+
+    case FieldDescriptor::CPPTYPE_DOUBLE:
+      snprintf(val, sizeof(val), "%.02f", refl->GetDouble(in, field));
+      break;
+
+    case FieldDescriptor::CPPTYPE_FLOAT:
+      snprintf(val, sizeof(val), "%.02f", refl->GetFloat(in, field));
+      break;
+
+    default:
+      val[0] = '\0';
+      break;
+    }
+
+    out += val;
+  }
+}
+
+//------------------------------------------------------------------------------
+//! Check if the current manager advertised that it accepts report batches
+//------------------------------------------------------------------------------
+static bool
+ManagerAcceptsBatch()
+{
+  XrdSysMutexHelper lock(Config::gConfig.Mutex);
+  return (Config::gConfig.ReportBatchManager.length() &&
+          (Config::gConfig.ReportBatchManager == Config::gConfig.Manager.c_str()));
+}
+
+//------------------------------------------------------------------------------
+//! Send a report message to the MGM report queue
+//------------------------------------------------------------------------------
+static bool
+SendReportMessage(const char* body, const XrdOucString& receiver)
+{
+  // this type of messages can have no receiver
+  XrdMqMessage message("report");
+  message.MarkAsMonitor();
+  message.SetBody(body);
+
+  if (!XrdMqMessaging::gMessageClient.SendMessage(message, receiver.c_str())) {
+    // display communication error
+    eos_static_err("cannot send report broadcast");
+    return false;
+  }
+
+  return true;
+}
+
 /*----------------------------------------------------------------------------*/
 void
 Storage::Report()
 {
-  // this thread send's report messages from the report queue
+  // this thread sends the reports from the report queue - they are packed
+  // into compressed protobuf batches once the manager advertised it accepts
+  // them via the 'report.batch' node config, otherwise or with
+  // EOS_FST_REPORT_LEGACY=1 one env string per report is sent
   bool failure;
+  bool legacy = (getenv("EOS_FST_REPORT_LEGACY") &&
+                 !strcmp(getenv("EOS_FST_REPORT_LEGACY"), "1"));
   XrdOucString monitorReceiver = Config::gConfig.FstDefaultReceiverQueue;
   monitorReceiver.replace("*/mgm", "*/report");
+  // reports taken from the queue, the ones which failed to be sent before are
+  // still pending and are sent first
+  eos::fst::IoReportBatch pending;
+  std::string env;
 
   while (1) {
     failure = false;
+    bool batch = !legacy && ManagerAcceptsBatch();
     gOFS.ReportQueueMutex.Lock();
 
-    while (gOFS.ReportQueue.size() > 0) {
-      gOFS.ReportQueueMutex.UnLock();
-      gOFS.ReportQueueMutex.Lock();
-      // send all reports away and dump them into the log
-      XrdOucString report = gOFS.ReportQueue.front();
+    while (gOFS.ReportQueue.size() || pending.report_size()) {
+      while ((pending.report_size() < (int) sMaxReportBatch) &&
+             gOFS.ReportQueue.size()) {
+        pending.add_report()->Swap(&gOFS.ReportQueue.front());
+        gOFS.ReportQueue.pop();
+        // dump all reports into the log
+        IoReportToEnv(pending.report(pending.report_size() - 1), env);
+        eos_static_info("%s", env.c_str());
+      }
+
       gOFS.ReportQueueMutex.UnLock();
-      eos_static_info("%s", report.c_str());
-      // this type of messages can have no receiver
-      XrdMqMessage message("report");
-      message.MarkAsMonitor();
-      XrdOucString msgbody;
-      message.SetBody(report.c_str());
-      eos_debug("broadcasting report message: %s", msgbody.c_str());
-
-      if (!XrdMqMessaging::gMessageClient.SendMessage(message,
-          monitorReceiver.c_str())) {
-        // display communication error
-        eos_err("cannot send report broadcast");
-        failure = true;
-        gOFS.ReportQueueMutex.Lock();
-        break;
+
+      if (batch) {
+        std::string raw, body;
+
+        if (!pending.SerializeToString(&raw) ||
+            !eos::common::SymKey::ZBase64(raw, body)) {
+          eos_err("msg=\"failed to encode report batch, dropping it\" "
+                  "num_reports=%d", pending.report_size());
+          pending.Clear();
+          gOFS.ReportQueueMutex.Lock();
+          continue;
+        }
+
+        body.insert(0, "iostat.batch=");
+
+        if (!SendReportMessage(body.c_str(), monitorReceiver)) {
+          failure = true;
+          gOFS.ReportQueueMutex.Lock();
+          break;
+        }
+
+        pending.Clear();
+      } else {
+        int sent = 0;
+
+        for (; sent < pending.report_size(); ++sent) {
+          IoReportToEnv(pending.report(sent), env);
+
+          if (!SendReportMessage(env.c_str(), monitorReceiver)) {
+            failure = true;
+            break;
+          }
+        }
+
+        pending.mutable_report()->DeleteSubrange(0, sent);
+
+        if (failure) {
+          gOFS.ReportQueueMutex.Lock();
+          break;
+        }
       }
 
       gOFS.ReportQueueMutex.Lock();
-      gOFS.ReportQueue.pop();
     }
 
     gOFS.ReportQueueMutex.UnLock();
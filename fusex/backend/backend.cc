@@ -42,6 +42,8 @@ backend::backend()
 {
   timeout = 0;
   put_timeout = 0;
+  mdquery = false;
+  mdbatch = false;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -200,12 +202,13 @@ backend::getMD(fuse_req_t req,
                uint64_t myclock,
                std::vector<eos::fusex::container>& contv,
                bool listing,
-               std::string authid
+               std::string authid,
+               bool ifclock
               )
 /* -------------------------------------------------------------------------- */
 {
   std::string requestURL = getURL(req, inode, myclock, listing ? "LS" : "GET",
-                                  authid);
+                                  authid, ifclock);
   return fetchResponse(requestURL, contv);
 }
 
@@ -230,6 +233,14 @@ backend::fetchResponse(std::string& requestURL,
                       )
 /* -------------------------------------------------------------------------- */
 {
+  if (mdquery) {
+    int rc = fetchQueryResponse(requestURL, contv);
+
+    if (rc >= 0) {
+      return rc;
+    }
+  }
+
   eos_static_debug("request='%s'", requestURL.c_str());
   double total_exec_time_sec = 0;
   XrdCl::XRootDStatus status;
@@ -254,11 +265,10 @@ backend::fetchResponse(std::string& requestURL,
 
     if (!status.IsOK()) {
       // in case of any failure
-      if (status.errNo == XErrorCode::kXR_NotFound) {
-        // this is just no such file or directory
-        eos_static_debug("error=status is NOT ok : %s", status.ToString().c_str());
-        errno = ENOENT;
-        return ENOENT;
+      if ((status.errNo == XErrorCode::kXR_NotFound) ||
+          (mapStatus(status) == EEXIST)) {
+        // not existing or unchanged since the given clock
+        return mapStatus(status);
       }
 
       eos_static_err("fetch-exec-ms=%.02f sum-query-exec-ms=%.02f ok=%d err=%d fatal=%d status-code=%d err-no=%d",
@@ -267,21 +277,6 @@ backend::fetchResponse(std::string& requestURL,
       eos_static_err("error=status is NOT ok : %s %d %d", status.ToString().c_str(),
                      status.code, status.errNo);
 
-      if (status.code == XrdCl::errAuthFailed) {
-        // this is an authentication error which results in permission denied
-        errno = EPERM;
-        return EPERM;
-      }
-
-      std::string xrootderr = status.GetErrorMessage();
-
-      // the xrootd mapping of errno to everything unknwon to EIO is really unfortunate
-      if (xrootderr.find("get-cap-clock-out-of-sync") != std::string::npos) {
-        // this is a time synchronization error
-        errno = EL2NSYNC;
-        return EL2NSYNC;
-      }
-
       if (
         (status.code == XrdCl::errConnectionError) ||
         (status.code == XrdCl::errSocketTimeout) ||
@@ -303,23 +298,7 @@ backend::fetchResponse(std::string& requestURL,
       }
 
       // all the other errors are reported back
-      if (status.errNo) {
-        errno = XrdCl::Proxy::status2errno(status);
-        eos_static_err("error=status is not ok : errno=%d", errno);
-
-        // xrootd does not transport E2BIG ... sigh
-        if (errno == ENAMETOOLONG) {
-          errno = E2BIG;
-        }
-
-        return errno;
-      }
-
-      if (status.code) {
-        errno = EIO;
-        eos_static_err("error=status is not ok : code=%d", errno);
-        return errno;
-      }
+      return mapStatus(status);
     } else {
       eos_static_debug("fetch-exec-ms=%.02f sum-fetch-exec-ms=%.02f ok=%d err=%d fatal=%d status-code=%d err-no=%d",
                        exec_time_sec * 1000.0, total_exec_time_sec * 1000.0, status.IsOK(),
@@ -354,10 +333,121 @@ backend::fetchResponse(std::string& requestURL,
     eos_static_debug("rbytes=%lu offset=%llu", bytesread, offset);
   } while (bytesread);
 
+  return parseResponse(response, contv);
+}
+
+/* -------------------------------------------------------------------------- */
+int
+/* -------------------------------------------------------------------------- */
+backend::fetchQueryResponse(std::string& requestURL,
+                            std::vector<eos::fusex::container>& contv
+                           )
+/* -------------------------------------------------------------------------- */
+{
+  // the MD get operation is implemented as a single query on the persistent
+  // connection of the user - concurrent requests are multiplexed by XrdCl on
+  // the same channel, each one identified by its stream id
+  XrdCl::URL url(requestURL);
+  std::string sarg = url.GetPathWithParams();
+  sarg += "&mgm.pcmd=fusexget";
+
+  // the MGM does not accept larger opaque information in queries
+  if (sarg.length() >= 16384) {
+    return -1;
+  }
+
+  eos_static_debug("query='%s'", sarg.c_str());
+  XrdCl::Buffer arg;
+  arg.FromString(sarg);
+  XrdCl::Buffer* rawresponse = 0;
+  XrdCl::XRootDStatus status = Query(url, XrdCl::QueryCode::OpaqueFile, arg,
+                                     rawresponse);
+  std::unique_ptr<XrdCl::Buffer> response(rawresponse);
+
+  if (!status.IsOK()) {
+    if ((status.code == XrdCl::errErrorResponse) &&
+        (status.errNo == kXR_ArgInvalid)) {
+      // failed over to an MGM which does not know the query, it is
+      // advertised again by the next MGM config message
+      eos_static_warning("msg=\"MGM rejected MD query - using open/read\"");
+      mdquery = false;
+      return -1;
+    }
+
+    if ((status.errNo != XErrorCode::kXR_NotFound) &&
+        (mapStatus(status) != EEXIST)) {
+      eos_static_err("error=status is NOT ok : %s %d %d", status.ToString().c_str(),
+                     status.code, status.errNo);
+    }
+
+    return mapStatus(status);
+  }
+
+  if (!response || !response->GetBuffer()) {
+    eos_static_err("no response retrieved");
+    return EIO;
+  }
+
+  std::string sresponse(response->GetBuffer(), response->GetSize());
+  return parseResponse(sresponse, contv);
+}
+
+/* -------------------------------------------------------------------------- */
+int
+/* -------------------------------------------------------------------------- */
+backend::mapStatus(const XrdCl::XRootDStatus& status)
+/* -------------------------------------------------------------------------- */
+{
+  if (status.errNo == XErrorCode::kXR_NotFound) {
+    // this is just no such file or directory
+    eos_static_debug("error=status is NOT ok : %s", status.ToString().c_str());
+    errno = ENOENT;
+    return ENOENT;
+  }
+
+  if (status.code == XrdCl::errAuthFailed) {
+    // this is an authentication error which results in permission denied
+    errno = EPERM;
+    return EPERM;
+  }
+
+  std::string xrootderr = status.GetErrorMessage();
+
+  // the xrootd mapping of errno to everything unknwon to EIO is really unfortunate
+  if (xrootderr.find("get-cap-clock-out-of-sync") != std::string::npos) {
+    // this is a time synchronization error
+    errno = EL2NSYNC;
+    return EL2NSYNC;
+  }
+
+  if (status.errNo) {
+    errno = XrdCl::Proxy::status2errno(status);
+    eos_static_err("error=status is not ok : errno=%d", errno);
+
+    // xrootd does not transport E2BIG ... sigh
+    if (errno == ENAMETOOLONG) {
+      errno = E2BIG;
+    }
+
+    return errno;
+  }
+
+  errno = EIO;
+  eos_static_err("error=status is not ok : code=%d", errno);
+  return errno;
+}
+
+/* -------------------------------------------------------------------------- */
+int
+/* -------------------------------------------------------------------------- */
+backend::parseResponse(const std::string& response,
+                       std::vector<eos::fusex::container>& contv)
+/* -------------------------------------------------------------------------- */
+{
   eos_static_debug("response-size=%u response=%s",
                    response.size(), response.c_str());
   //eos_static_debug("response-dump=%s", eos::common::StringConversion::string_to_hex(response).c_str());
-  offset = 0;
+  off_t offset = 0;
   eos::fusex::container cont;
 
   do {
@@ -387,7 +477,21 @@ backend::fetchResponse(std::string& requestURL,
           return EINVAL;
         }
 
-        contv.push_back(cont);
+        if ((cont.type() == cont.MDMAP) && contv.size() &&
+            (contv.back().type() == cont.MDMAP) &&
+            (contv.back().ref_inode_() == cont.ref_inode_())) {
+          // a large listing arrives in pages of the same parent, merge them
+          // back into a single container before they get applied
+          auto dst = contv.back().mutable_md_map_()->mutable_md_map_();
+          auto src = cont.mutable_md_map_()->mutable_md_map_();
+
+          for (auto it = src->begin(); it != src->end(); ++it) {
+            (*dst)[it->first].Swap(&it->second);
+          }
+        } else {
+          contv.push_back(cont);
+        }
+
         eos_static_debug("parsed %ld/%ld", offset, response.size());
 
         if (offset == (off_t) response.size()) {
@@ -640,6 +744,102 @@ backend::putMD(const fuse_id& id, eos::fusex::md* md, std::string authid,
   }
 }
 
+/* -------------------------------------------------------------------------- */
+int
+/* -------------------------------------------------------------------------- */
+backend::putMDBatch(const fuse_id& id, eos::fusex::md_batch& batch,
+                    std::vector<int>& rcs, std::vector<uint64_t>& md_inos)
+{
+  // the records are prepared by the caller (authid set, no locks held), the
+  // MGM applies them one after the other and returns one ack per record
+  if (!mdbatch) {
+    return -1;
+  }
+
+  XrdCl::URL url("root://" + hostport);
+  url.SetPath("/dummy");
+  XrdCl::URL::ParamsMap query;
+  fusexrdlogin::loginurl(url, query, id.uid, id.gid, id.pid, 0);
+  query["eos.app"] = "fuse";
+  url.SetParams(query);
+
+  for (int i = 0; i < batch.md__size(); ++i) {
+    batch.mutable_md_(i)->set_clientuuid(clientuuid);
+  }
+
+  std::string mdstream;
+
+  if (!batch.SerializeToString(&mdstream)) {
+    eos_static_err("fatal serialization error");
+    return EFAULT;
+  }
+
+  XrdCl::Buffer arg;
+  XrdCl::Buffer* rawresponse = 0;
+  std::string prefix = "/?fusexb:";
+  arg.Append(prefix.c_str(), prefix.length());
+  arg.Append(mdstream.c_str(), mdstream.length());
+  eos_static_debug("query: url=%s path=%s length=%d batch-size=%d",
+                   url.GetURL().c_str(), prefix.c_str(), mdstream.length(),
+                   batch.md__size());
+  XrdCl::XRootDStatus status = Query(url, XrdCl::QueryCode::OpaqueFile, arg,
+                                     rawresponse, put_timeout);
+  std::unique_ptr<XrdCl::Buffer> response(rawresponse);
+
+  if (!status.IsOK()) {
+    if ((status.code == XrdCl::errErrorResponse) &&
+        (status.errNo == kXR_ArgInvalid)) {
+      // failed over to an MGM which does not know batches, see above
+      eos_static_warning("msg=\"MGM rejected MD batch - sending records one by one\"");
+      mdbatch = false;
+      return -1;
+    }
+
+    eos_static_err("batch query resulted in error url=%s", url.GetURL().c_str());
+
+    if (status.code == XrdCl::errErrorResponse) {
+      return mapErrCode(status.errNo);
+    } else {
+      return EIO;
+    }
+  }
+
+  if (!response || !response->GetBuffer() || (response->GetSize() <= 6) ||
+      strncmp(response->GetBuffer(), "Fusex:", 6)) {
+    eos_static_err("protocol error - illegal response received");
+    return EIO;
+  }
+
+  std::string sresponse;
+  std::string b64response;
+  b64response.assign(response->GetBuffer() + 6, response->GetSize() - 6);
+  eos::common::SymKey::DeBase64(b64response, sresponse);
+  eos::fusex::response resp;
+
+  if (!resp.ParseFromString(sresponse) || (resp.type() != resp.ACKS) ||
+      (resp.acks__size() != batch.md__size())) {
+    eos_static_err("parsing error/wrong response type received");
+    return EIO;
+  }
+
+  rcs.assign(resp.acks__size(), 0);
+  md_inos.assign(resp.acks__size(), 0);
+
+  for (int i = 0; i < resp.acks__size(); ++i) {
+    const eos::fusex::ack& ack = resp.acks_(i);
+
+    if (ack.code() == ack.OK) {
+      md_inos[i] = ack.md_ino();
+    } else {
+      eos_static_err("failed batched query command for ino=%lx error='%s'",
+                     batch.md_(i).id(), ack.err_msg().c_str());
+      rcs[i] = ack.err_no() ? (int) ack.err_no() : EIO;
+    }
+  }
+
+  return 0;
+}
+
 /* -------------------------------------------------------------------------- */
 int
 /* -------------------------------------------------------------------------- */
@@ -817,7 +1017,7 @@ backend::getURL(fuse_req_t req, uint64_t inode, const std::string& name,
 std::string
 /* -------------------------------------------------------------------------- */
 backend::getURL(fuse_req_t req, uint64_t inode, uint64_t clock, std::string op,
-                std::string authid)
+                std::string authid, bool ifclock)
 /* -------------------------------------------------------------------------- */
 {
   XrdCl::URL url("root://" + hostport);
@@ -828,6 +1028,17 @@ backend::getURL(fuse_req_t req, uint64_t inode, uint64_t clock, std::string op,
   query["mgm.clock"] =
     eos::common::StringConversion::GetSizeString(sclock,
         (unsigned long long) clock);
+
+  if (ifclock) {
+    // ask for EEXIST instead of the md if it did not change since clock
+    query["mgm.ifclock"] = "1";
+  }
+
+  if (op == "LS") {
+    // large listings may be sent in pages, they are merged in parseResponse
+    query["mgm.lspage"] = "1";
+  }
+
   char hexinode[32];
   snprintf(hexinode, sizeof(hexinode), "%08lx", (unsigned long) inode);
   query["mgm.inode"] =
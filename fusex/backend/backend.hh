@@ -34,6 +34,7 @@
 #include "XrdCl/XrdClURL.hh"
 
 #include <sys/statvfs.h>
+#include <atomic>
 
 class backend
 {
@@ -46,6 +47,14 @@ public:
   int init(std::string& hostport, std::string& remotemountdir, double& timeout,
            double& put_timeout);
 
+  // optional requests advertised by the MGM in its config message, both are
+  // off until an MGM advertises them
+  void set_features(bool query, bool batch)
+  {
+    mdquery = query;
+    mdbatch = batch;
+  }
+
   int getMD(fuse_req_t req,
             const std::string& path,
             std::vector<eos::fusex::container>& cont,
@@ -60,12 +69,14 @@ public:
             std::string authid = ""
            );
 
+  // with ifclock the MGM answers EEXIST if the md did not change since myclock
   int getMD(fuse_req_t req,
             uint64_t inode,
             uint64_t myclock,
             std::vector<eos::fusex::container>& cont,
             bool listing,
-            std::string authid = ""
+            std::string authid = "",
+            bool ifclock = false
            );
 
   int doLock(fuse_req_t req,
@@ -77,6 +88,10 @@ public:
                     std::vector<eos::fusex::container>& cont
                    );
 
+  int fetchQueryResponse(std::string& url,
+                         std::vector<eos::fusex::container>& cont
+                        );
+
   int rmRf(fuse_req_t req, eos::fusex::md* md);
 
   int putMD(fuse_req_t req, eos::fusex::md* md, std::string authid,
@@ -84,6 +99,18 @@ public:
   int putMD(const fuse_id& id, eos::fusex::md* md, std::string authid,
             XrdSysMutex* locker);
 
+  //----------------------------------------------------------------------------
+  //! Send a batch of md records with a single request
+  //!
+  //! @param rcs per record return code
+  //! @param md_inos per record remote inode, 0 if not acknowledged
+  //!
+  //! @return 0 if the batch was handled, -1 if the MGM does not support
+  //!         batches (send the records one by one) or an errno
+  //----------------------------------------------------------------------------
+  int putMDBatch(const fuse_id& id, eos::fusex::md_batch& batch,
+                 std::vector<int>& rcs, std::vector<uint64_t>& md_inos);
+
   int getCAP(fuse_req_t req,
              uint64_t inode,
              std::vector<eos::fusex::container>& cont
@@ -102,7 +129,8 @@ private:
   std::string getURL(fuse_req_t req, uint64_t inode, const std::string& name,
                      std::string op = "GET", std::string authid = "");
   std::string getURL(fuse_req_t req, uint64_t inode, uint64_t clock,
-                     std::string op = "GET", std::string authid = "");
+                     std::string op = "GET", std::string authid = "",
+                     bool ifclock = false);
 
   std::string hostport;
   std::string mount;
@@ -112,6 +140,18 @@ private:
 
   int mapErrCode(int retc);
 
+  int mapStatus(const XrdCl::XRootDStatus& status);
+
+  int parseResponse(const std::string& response,
+                    std::vector<eos::fusex::container>& cont);
+
+  // MD GETs are sent as a single query over the persistent connection instead
+  // of an open/read/close sequence, if the MGM advertises it
+  std::atomic<bool> mdquery;
+
+  // md records are pushed in batches, if the MGM advertises it
+  std::atomic<bool> mdbatch;
+
   XrdCl::XRootDStatus Query(XrdCl::URL& url,
                             XrdCl::QueryCode::Code query_code, XrdCl::Buffer& arg,
                             XrdCl::Buffer*& repsonse,
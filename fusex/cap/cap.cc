@@ -89,8 +89,7 @@ void
 cap::reset()
 /* -------------------------------------------------------------------------- */
 {
-  XrdSysMutexHelper mLock(capmap);
-  capmap.clear();
+  capmap.clearTS();
 }
 
 /* -------------------------------------------------------------------------- */
@@ -154,12 +153,12 @@ cap::ls()
 /* -------------------------------------------------------------------------- */
 {
   std::string listing;
-  XrdSysMutexHelper mLock(capmap);
-
-  for (auto it = capmap.begin(); it != capmap.end(); ++it) {
-    listing += it->second->dump(false);
+  size_t ncaps = 0;
+  capmap.for_eachTS([&listing, &ncaps](const std::string&, shared_cap & cap) {
+    listing += cap->dump(false);
     listing += "\n";
-  }
+    ncaps++;
+  });
 
   if (listing.size() > (64 * 1000)) {
     listing.resize((64 * 1000));
@@ -167,7 +166,7 @@ cap::ls()
   }
 
   char csize[32];
-  snprintf(csize, sizeof(csize), "# [ %lu caps ]\n", capmap.size());
+  snprintf(csize, sizeof(csize), "# [ %lu caps ]\n", ncaps);
   listing += csize;
   return listing;
 }
@@ -183,11 +182,12 @@ cap::get(fuse_req_t req,
   std::string cid = cap::capx::capid(req, ino);
   std::string clientid = cap::capx::getclientid(req);
   eos_static_debug("inode=%08lx cap-id=%s", ino, cid.c_str());
-  XrdSysMutexHelper mLock(capmap);
+  cmap::Shard& shard = capmap.shard_of(cid);
+  XrdSysMutexHelper mLock(shard);
+  auto it = shard.map.find(cid);
 
-  if (capmap.count(cid)) {
-    shared_cap cap = capmap[cid];
-    return cap;
+  if (it != shard.map.end()) {
+    return it->second;
   } else {
     shared_cap cap = std::make_shared<capx>();
     cap->set_clientid(clientid);
@@ -198,7 +198,7 @@ cap::get(fuse_req_t req,
     cap->set_gid(fuse_req_ctx(req)->gid);
     cap->set_vtime(0);
     cap->set_vtime_ns(0);
-    capmap[cid] = cap;
+    shard.map[cid] = cap;
     //    mds->increase_cap(ino, lock);
     return cap;
   }
@@ -212,16 +212,14 @@ cap::get(fuse_ino_t ino, std::string clientid)
 {
   std::string cid = cap::capx::capid(ino, clientid);
   eos_static_debug("inode=%08lx cap-id=%s", ino, cid.c_str());
-  XrdSysMutexHelper mLock(capmap);
+  shared_cap cap;
 
-  if (capmap.count(cid)) {
-    shared_cap cap = capmap[cid];
-    return cap;
-  } else {
-    shared_cap cap = std::make_shared<capx>();
+  if (!capmap.retrieveTS(cid, cap)) {
+    cap = std::make_shared<capx>();
     cap->set_id(0);
-    return cap;
   }
+
+  return cap;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -234,23 +232,23 @@ cap::store(fuse_req_t req,
   std::string clientid = cap::capx::getclientid(req);
   uint64_t id = mds->vmaps().forward(icap.id());
   std::string cid = cap::capx::capid(req, id); // cid uses the local inode
-  XrdSysMutexHelper mLock(capmap);
+  cmap::Shard& shard = capmap.shard_of(cid);
+  XrdSysMutexHelper mLock(shard);
+  shared_cap& cap = shard.map[cid];
 
-  if (capmap.count(cid)) {
-    shared_cap cap = capmap[cid];
+  if (cap) {
     *cap = icap;
     cap->set_id(id);
   } else {
-    shared_cap cap = std::make_shared<capx>();
+    cap = std::make_shared<capx>();
     cap->set_clientid(clientid);
     *cap = icap;
     cap->set_id(id);
-    capmap[cid] = cap;
   }
 
   eos_static_debug("store inode=[r:%lx l:%lx] capid=%s cap: %s", icap.id(), id,
                    cid.c_str(),
-                   capmap[cid]->dump().c_str());
+                   cap->dump().c_str());
 }
 
 /* -------------------------------------------------------------------------- */
@@ -261,14 +259,15 @@ cap::forget(const std::string& cid)
 {
   fuse_ino_t inode = 0;
   {
-    XrdSysMutexHelper mLock(capmap);
+    cmap::Shard& shard = capmap.shard_of(cid);
+    XrdSysMutexHelper mLock(shard);
+    auto it = shard.map.find(cid);
 
-    if (capmap.count(cid)) {
+    if (it != shard.map.end()) {
       eos_static_debug("forget capid=%s cap: %s", cid.c_str(),
-                       capmap[cid]->dump().c_str());
-      shared_cap cap = capmap[cid];
-      inode = cap->id();
-      capmap.erase(cid);
+                       it->second->dump().c_str());
+      inode = it->second->id();
+      shard.map.erase(it);
     } else {
       eos_static_debug("forget capid=%s cap: ENOENT", cid.c_str());
     }
@@ -299,9 +298,8 @@ cap::imply(shared_cap cap,
   implied_cap->set_vtime(cap->vtime() + 300);
   std::string clientid = cap->clientid();
   std::string cid = capx::capid(ino, clientid);
-  XrdSysMutexHelper mLock(capmap);
   // TODO: deal with the influence of mode to the cap itself
-  capmap[cid] = implied_cap;
+  capmap.insertTS(cid, implied_cap);
   return cid;
 }
 
@@ -340,12 +338,13 @@ cap::acquire(fuse_req_t req,
 
     eos_static_debug("%s", cap->dump().c_str());
   }
-  XrdSysMutexHelper mLock(capmap);
+  cmap::Shard& shard = capmap.shard_of(cid);
+  XrdSysMutexHelper mLock(shard);
   XrdSysMutexHelper mLock2(cap->Locker());
 
   if (try_attach) {
-    if (!capmap.count(cid)) {
-      capmap[cid] = cap;
+    if (!shard.map.count(cid)) {
+      shard.map[cid] = cap;
       cap->set_id(ino);
     }
   }
@@ -480,59 +479,66 @@ cap::capflush(ThreadAssistant& assistant)
 {
   while (!assistant.terminationRequested()) {
     {
-      cmap capdelmap;
       cinodes capdelinodes;
-      capmap.Lock();
+      // freeze the whole map, no cap may appear while forgetting all md
+      capmap.lock_all();
 
-      if (!capmap.size()) {
+      if (!capmap.size_nolock()) {
         eos_static_debug("forgetting all md from mdmap");
         mds->forget_all();
       }
 
-      for (auto it = capmap.begin(); it != capmap.end(); ++it) {
-        XrdSysMutexHelper cLock(it->second->Locker());
+      capmap.unlock_all();
 
-        if (forgetlist.has(it->second->id())) {
-          eos_static_debug("remove %s - deleted", it->second->dump().c_str());
-          capdelmap[it->first] = it->second;
-          continue;
-        }
+      for (size_t i = 0; i < capmap.shards(); ++i) {
+        cmap::Shard& shard = capmap.shard(i);
+        XrdSysMutexHelper mLock(shard);
+        std::vector<std::string> capdel;
+
+        for (auto it = shard.map.begin(); it != shard.map.end(); ++it) {
+          XrdSysMutexHelper cLock(it->second->Locker());
+
+          if (forgetlist.has(it->second->id())) {
+            eos_static_debug("remove %s - deleted", it->second->dump().c_str());
+            capdel.push_back(it->first);
+            continue;
+          }
 
-        // make a list of caps to timeout
-        if (!it->second->valid(false)) {
-          capdelmap[it->first] = it->second;
-          eos_static_debug("expire %s", it->second->dump().c_str());
-          mds->decrease_cap(it->second->id());
-          capdelinodes.insert(it->second->id());
-        } else {
-          if (0) {
-            // don't do automatic cap extension for the time being
-            time_t vtime = it->second->vtime();
-            time_t utime = it->second->used();
-            time_t period = vtime - utime;
-
-            if ((period < 90) && (period > 15)) {
-              // if cap was used during last 90 seconds, we automatically ask
-              // for an extension of CAP_EXTENSION_TIME
-              XrdSysMutexHelper eLock(extensionLock);
-              extensionmap[it->second->authid()] = CAP_EXTENSION_TIME;
-              it->second->set_vtime(vtime + CAP_EXTENSION_TIME);
-              eos_static_info("authid=%s vtime=%lu extended-vtime=%lu",
-                              it->second->authid().c_str(),
-                              vtime,
-                              it->second->vtime());
+          // make a list of caps to timeout
+          if (!it->second->valid(false)) {
+            capdel.push_back(it->first);
+            eos_static_debug("expire %s", it->second->dump().c_str());
+            mds->decrease_cap(it->second->id());
+            capdelinodes.insert(it->second->id());
+          } else {
+            if (0) {
+              // don't do automatic cap extension for the time being
+              time_t vtime = it->second->vtime();
+              time_t utime = it->second->used();
+              time_t period = vtime - utime;
+
+              if ((period < 90) && (period > 15)) {
+                // if cap was used during last 90 seconds, we automatically ask
+                // for an extension of CAP_EXTENSION_TIME
+                XrdSysMutexHelper eLock(extensionLock);
+                extensionmap[it->second->authid()] = CAP_EXTENSION_TIME;
+                it->second->set_vtime(vtime + CAP_EXTENSION_TIME);
+                eos_static_info("authid=%s vtime=%lu extended-vtime=%lu",
+                                it->second->authid().c_str(),
+                                vtime,
+                                it->second->vtime());
+              }
             }
           }
         }
-      }
 
-      for (auto it = capdelmap.begin(); it != capdelmap.end(); ++it) {
-        // remove the expired or invalidated by delete caps
-        capmap.erase(it->first);
+        for (auto it = capdel.begin(); it != capdel.end(); ++it) {
+          // remove the expired or invalidated by delete caps
+          shard.map.erase(*it);
+        }
       }
 
       forgetlist.clear();
-      capmap.UnLock();
 
       for (auto it = capdelinodes.begin(); it != capdelinodes.end(); ++it) {
         kernelcache::inval_inode(*it, false);
@@ -30,6 +30,7 @@
 #include "llfusexx.hh"
 #include "backend/backend.hh"
 #include "md/md.hh"
+#include "misc/ShardedMap.hh"
 #include "fusex/fusex.pb.h"
 
 #include "XrdSys/XrdSysPthread.hh"
@@ -146,7 +147,7 @@ public:
     shared_quota get(shared_cap cap);
   };
 
-  class cmap : public std::map<std::string, shared_cap>, public XrdSysMutex
+  class cmap : public ShardedMap<std::string, shared_cap>
   //----------------------------------------------------------------------------
   {
   public:
@@ -302,8 +303,7 @@ public:
 
   size_t size()
   {
-    XrdSysMutexHelper mLock(capmap);
-    return capmap.size();
+    return capmap.sizeTS();
   }
 
 
@@ -312,7 +312,6 @@ public:
 private:
 
   cmap capmap;
-  cmap capextionsmap;
   qmap quotamap;
 
   backend* mdbackend;
@@ -0,0 +1,425 @@
+//------------------------------------------------------------------------------
+//! @file blockindex.cc
+//! @brief LRU index of the blocks resident in the disk cache
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "blockindex.hh"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <map>
+#include <vector>
+
+namespace
+{
+//! header of a saved index, followed by (inode, block) records in
+//! least recently used order
+struct index_header_t {
+  char magic[8];
+  uint64_t blocksize;
+  uint64_t nblocks;
+};
+
+const char sIndexMagic[8] = {'e', 'o', 's', 'x', 'd', 'b', 'i', '1'};
+}
+
+/* -------------------------------------------------------------------------- */
+blockindex::blockindex(size_t blocksize, uint64_t maxsize, evict_t evict) :
+  mBlockSize(blocksize), mMaxBlocks(0), mEvict(evict), mDirty(false),
+  mInterval(60)
+/* -------------------------------------------------------------------------- */
+{
+  if (maxsize) {
+    mMaxBlocks = maxsize / mBlockSize;
+
+    if (!mMaxBlocks) {
+      mMaxBlocks = 1;
+    }
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+blockindex::~blockindex()
+/* -------------------------------------------------------------------------- */
+{
+  tSaver.join();
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+blockindex::defined(off_t offset, size_t count, off_t eof, uint64_t& first,
+                    uint64_t& last)
+/* -------------------------------------------------------------------------- */
+{
+  off_t end = offset + count;
+  first = (offset + mBlockSize - 1) / mBlockSize;
+  last = (end >= eof) ? (end + mBlockSize - 1) / mBlockSize : end / mBlockSize;
+
+  if (last < first) {
+    last = first;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+blockindex::add(const key_t& key)
+/* -------------------------------------------------------------------------- */
+{
+  auto it = mBlocks.find(key);
+
+  if (it != mBlocks.end()) {
+    mLRU.splice(mLRU.begin(), mLRU, it->second);
+    return;
+  }
+
+  mLRU.push_front(key);
+  mBlocks[key] = mLRU.begin();
+  mInodes[key.first].insert(key.second);
+  mDirty = true;
+
+  while (mMaxBlocks && (mBlocks.size() > mMaxBlocks)) {
+    key_t victim = mLRU.back();
+    mEvicted.push_back(victim);
+    remove(victim);
+    mStats.evictions++;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+blockindex::remove(const key_t& key)
+/* -------------------------------------------------------------------------- */
+{
+  auto it = mBlocks.find(key);
+
+  if (it == mBlocks.end()) {
+    return;
+  }
+
+  mLRU.erase(it->second);
+  mBlocks.erase(it);
+  auto in = mInodes.find(key.first);
+  in->second.erase(key.second);
+
+  if (in->second.empty()) {
+    mInodes.erase(in);
+  }
+
+  mDirty = true;
+}
+
+/* -------------------------------------------------------------------------- */
+size_t
+/* -------------------------------------------------------------------------- */
+blockindex::lookup(fuse_ino_t ino, off_t offset, size_t count)
+/* -------------------------------------------------------------------------- */
+{
+  if (!count) {
+    return 0;
+  }
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  uint64_t last = (offset + count - 1) / mBlockSize;
+  size_t avail = 0;
+
+  for (uint64_t b = offset / mBlockSize; b <= last; ++b) {
+    auto it = mBlocks.find(key_t(ino, b));
+
+    if (it == mBlocks.end()) {
+      break;
+    }
+
+    mLRU.splice(mLRU.begin(), mLRU, it->second);
+    avail = std::min((size_t)((b + 1) * mBlockSize - offset), count);
+  }
+
+  if (avail) {
+    mStats.hits++;
+  } else {
+    mStats.misses++;
+  }
+
+  return avail;
+}
+
+/* -------------------------------------------------------------------------- */
+off_t
+/* -------------------------------------------------------------------------- */
+blockindex::prefix(fuse_ino_t ino)
+/* -------------------------------------------------------------------------- */
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  auto in = mInodes.find(ino);
+
+  if (in == mInodes.end()) {
+    return 0;
+  }
+
+  uint64_t n = 0;
+
+  for (auto it = in->second.begin(); it != in->second.end(); ++it, ++n) {
+    if (*it != n) {
+      break;
+    }
+  }
+
+  return n * mBlockSize;
+}
+
+/* -------------------------------------------------------------------------- */
+bool
+/* -------------------------------------------------------------------------- */
+blockindex::resident(fuse_ino_t ino, uint64_t block)
+/* -------------------------------------------------------------------------- */
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mBlocks.count(key_t(ino, block));
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+blockindex::forget(fuse_ino_t ino, off_t offset, size_t count, off_t eof)
+/* -------------------------------------------------------------------------- */
+{
+  uint64_t first, last;
+  defined(offset, count, eof, first, last);
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  for (uint64_t b = first; b < last; ++b) {
+    remove(key_t(ino, b));
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+blockindex::insert(fuse_ino_t ino, off_t offset, size_t count, off_t eof)
+/* -------------------------------------------------------------------------- */
+{
+  uint64_t first, last;
+  defined(offset, count, eof, first, last);
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  for (uint64_t b = first; b < last; ++b) {
+    add(key_t(ino, b));
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+blockindex::truncate(fuse_ino_t ino, off_t size)
+/* -------------------------------------------------------------------------- */
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  auto in = mInodes.find(ino);
+
+  if (in == mInodes.end()) {
+    return;
+  }
+
+  uint64_t first = (size + mBlockSize - 1) / mBlockSize;
+  std::vector<uint64_t> drop(in->second.lower_bound(first), in->second.end());
+
+  for (auto b : drop) {
+    remove(key_t(ino, b));
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+blockindex::evict()
+/* -------------------------------------------------------------------------- */
+{
+  std::vector<key_t> victims;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    victims.swap(mEvicted);
+  }
+
+  for (auto& victim : victims) {
+    mEvict(victim.first, victim.second * mBlockSize, mBlockSize);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+int
+/* -------------------------------------------------------------------------- */
+blockindex::save(const std::string& path)
+/* -------------------------------------------------------------------------- */
+{
+  std::vector<key_t> keys;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    keys.assign(mLRU.rbegin(), mLRU.rend());
+    mDirty = false;
+  }
+  std::string tmppath = path + ".tmp";
+  int fd = ::open(tmppath.c_str(), O_CREAT | O_TRUNC | O_WRONLY, S_IRWXU);
+  int rc = 0;
+
+  if (fd < 0) {
+    rc = errno;
+  } else {
+#ifndef __APPLE__
+    // the index must not refer to blocks which are not yet on disk
+    ::syncfs(fd);
+#endif
+    index_header_t header;
+    memcpy(header.magic, sIndexMagic, sizeof(header.magic));
+    header.blocksize = mBlockSize;
+    header.nblocks = keys.size();
+    std::vector<uint64_t> records;
+    records.reserve(2 * keys.size());
+
+    for (auto& key : keys) {
+      records.push_back(key.first);
+      records.push_back(key.second);
+    }
+
+    size_t len = records.size() * sizeof(uint64_t);
+
+    if ((::write(fd, &header, sizeof(header)) != sizeof(header)) ||
+        (len && (::write(fd, records.data(), len) != (ssize_t) len)) ||
+        ::fsync(fd)) {
+      rc = errno ? errno : EIO;
+    }
+
+    ::close(fd);
+
+    if (!rc && ::rename(tmppath.c_str(), path.c_str())) {
+      rc = errno;
+    }
+  }
+
+  if (rc) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mDirty = true;
+  }
+
+  return rc;
+}
+
+/* -------------------------------------------------------------------------- */
+int
+/* -------------------------------------------------------------------------- */
+blockindex::load(const std::string& path, validate_t validate)
+/* -------------------------------------------------------------------------- */
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+
+  if (fd < 0) {
+    return (errno == ENOENT) ? 0 : errno;
+  }
+
+  index_header_t header;
+  std::vector<uint64_t> records;
+
+  if ((::read(fd, &header, sizeof(header)) != sizeof(header)) ||
+      memcmp(header.magic, sIndexMagic, sizeof(header.magic)) ||
+      (header.blocksize != mBlockSize)) {
+    // unknown format or a different block size, start with an empty cache
+    ::close(fd);
+    return EINVAL;
+  }
+
+  records.resize(2 * header.nblocks);
+  size_t len = records.size() * sizeof(uint64_t);
+
+  if (len && (::read(fd, records.data(), len) != (ssize_t) len)) {
+    ::close(fd);
+    return EIO;
+  }
+
+  ::close(fd);
+  std::map<fuse_ino_t, std::set<uint64_t> > inodes;
+
+  for (size_t i = 0; i < records.size(); i += 2) {
+    inodes[records[i]].insert(records[i + 1]);
+  }
+
+  for (auto it = inodes.begin(); it != inodes.end(); ++it) {
+    validate(it->first, it->second);
+  }
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  for (size_t i = 0; i < records.size(); i += 2) {
+    if (inodes[records[i]].count(records[i + 1])) {
+      add(key_t(records[i], records[i + 1]));
+    }
+  }
+
+  return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+blockindex::run(const std::string& path, size_t interval)
+/* -------------------------------------------------------------------------- */
+{
+  mPath = path;
+  mInterval = interval;
+  tSaver.reset(&blockindex::saver, this);
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+blockindex::saver(ThreadAssistant& assistant)
+/* -------------------------------------------------------------------------- */
+{
+  while (!assistant.terminationRequested()) {
+    assistant.wait_for(std::chrono::seconds(mInterval));
+    bool dirty;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      dirty = mDirty;
+    }
+
+    if (dirty) {
+      save(mPath);
+    }
+  }
+
+  // save the latest state on shutdown
+  save(mPath);
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+blockindex::get_stats(stats_t& stats)
+/* -------------------------------------------------------------------------- */
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  stats = mStats;
+  stats.blocks = mBlocks.size();
+  stats.inodes = mInodes.size();
+}
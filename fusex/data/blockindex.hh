@@ -0,0 +1,197 @@
+//------------------------------------------------------------------------------
+//! @file blockindex.hh
+//! @brief LRU index of the blocks resident in the disk cache
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef FUSE_BLOCKINDEX_HH_
+#define FUSE_BLOCKINDEX_HH_
+
+#include "llfusexx.hh"
+#include "common/AssistedThread.hh"
+#include <functional>
+#include <list>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//! The disk cache stores the data of an inode in a sparse file. This index
+//! tracks which fixed size blocks of these files hold valid data, keyed by
+//! (inode, block number), in least recently used order. When the cache grows
+//! beyond its size the least recently used block is removed in O(1). Its data
+//! is dropped by the evict callback, which punches a hole into the cache file,
+//! when evict() is called - this runs without the index lock, so that the
+//! callback can serialize with the readers and writers of the inode. The index
+//! is saved periodically next to the cache files and reloaded on startup.
+//!
+//! A block is only made resident once a write defined all of its bytes,
+//! either by covering it completely or by covering it up to the end of file.
+//! Writes into the same inode have to be serialized by the caller.
+//------------------------------------------------------------------------------
+
+class blockindex
+{
+public:
+
+  //! drop the data of a block from the cache file
+  typedef std::function<void(fuse_ino_t ino, off_t offset, size_t size)>
+  evict_t;
+
+  //! remove the blocks of an inode which don't hold data anymore
+  typedef std::function<void(fuse_ino_t ino, std::set<uint64_t>& blocks)>
+  validate_t;
+
+  typedef struct stats {
+
+    stats() : hits(0), misses(0), evictions(0), blocks(0), inodes(0) { }
+
+    uint64_t hits; // reads starting in a resident block
+    uint64_t misses; // reads starting in a block which is not resident
+    uint64_t evictions; // blocks evicted to stay within the cache size
+    uint64_t blocks; // resident blocks
+    uint64_t inodes; // inodes with resident blocks
+  } stats_t;
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param blocksize size of a block
+  //! @param maxsize maximum size of all resident blocks, 0 for unlimited
+  //! @param evict callback dropping an evicted block
+  //----------------------------------------------------------------------------
+  blockindex(size_t blocksize, uint64_t maxsize, evict_t evict);
+
+  virtual ~blockindex();
+
+  size_t blocksize() const
+  {
+    return mBlockSize;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the number of bytes from offset which are resident, at most count
+  //! bytes. The resident blocks are moved to the front of the LRU list.
+  //----------------------------------------------------------------------------
+  size_t lookup(fuse_ino_t ino, off_t offset, size_t count);
+
+  //----------------------------------------------------------------------------
+  //! Get the number of bytes from the start of the file which are resident
+  //----------------------------------------------------------------------------
+  off_t prefix(fuse_ino_t ino);
+
+  //----------------------------------------------------------------------------
+  //! Check if a block is resident without touching the LRU order
+  //----------------------------------------------------------------------------
+  bool resident(fuse_ino_t ino, uint64_t block);
+
+  //----------------------------------------------------------------------------
+  //! Drop the blocks which a write of count bytes at offset is going to
+  //! define - must be called before writing, so that no block is evicted
+  //! between writing it and making it resident
+  //!
+  //! @param eof file size after the write
+  //----------------------------------------------------------------------------
+  void forget(fuse_ino_t ino, off_t offset, size_t count, off_t eof);
+
+  //----------------------------------------------------------------------------
+  //! Make the blocks defined by a write of count bytes at offset resident
+  //!
+  //! @param eof file size after the write
+  //----------------------------------------------------------------------------
+  void insert(fuse_ino_t ino, off_t offset, size_t count, off_t eof);
+
+  //----------------------------------------------------------------------------
+  //! Drop the blocks starting at or after size
+  //----------------------------------------------------------------------------
+  void truncate(fuse_ino_t ino, off_t size);
+
+  //----------------------------------------------------------------------------
+  //! Call the evict callback for the blocks removed to stay within the cache
+  //! size by insert or load - must not be called with a lock held which the
+  //! callback takes. A block can be resident again when its callback runs.
+  //----------------------------------------------------------------------------
+  void evict();
+
+  //----------------------------------------------------------------------------
+  //! Save the index to a file
+  //----------------------------------------------------------------------------
+  int save(const std::string& path);
+
+  //----------------------------------------------------------------------------
+  //! Load the index saved by a previous run, keeping only the blocks which
+  //! pass the validation
+  //----------------------------------------------------------------------------
+  int load(const std::string& path, validate_t validate);
+
+  //----------------------------------------------------------------------------
+  //! Save the index to path every interval seconds if it changed and once
+  //! more when the index is destroyed
+  //----------------------------------------------------------------------------
+  void run(const std::string& path, size_t interval);
+
+  void get_stats(stats_t& stats);
+
+private:
+
+  typedef std::pair<fuse_ino_t, uint64_t> key_t;
+
+  struct key_hash {
+    size_t operator()(const key_t& key) const
+    {
+      return std::hash<uint64_t>()(key.first * 0x9e3779b97f4a7c15ull ^
+                                   key.second);
+    }
+  };
+
+  typedef std::list<key_t> lru_t;
+
+  // range [first, last) of the blocks defined by a write
+  void defined(off_t offset, size_t count, off_t eof, uint64_t& first,
+               uint64_t& last);
+
+  // requires mMutex
+  void add(const key_t& key);
+  void remove(const key_t& key);
+
+  void saver(ThreadAssistant& assistant);
+
+  size_t mBlockSize;
+  uint64_t mMaxBlocks;
+  evict_t mEvict;
+
+  std::mutex mMutex;
+  lru_t mLRU; // most recently used first
+  std::unordered_map<key_t, lru_t::iterator, key_hash> mBlocks;
+  // resident blocks per inode
+  std::unordered_map<fuse_ino_t, std::set<uint64_t> > mInodes;
+  // removed blocks whose data was not yet dropped by the evict callback
+  std::vector<key_t> mEvicted;
+  stats_t mStats;
+  bool mDirty;
+
+  std::string mPath;
+  size_t mInterval;
+  AssistedThread tSaver;
+};
+
+#endif /* FUSE_BLOCKINDEX_HH_ */
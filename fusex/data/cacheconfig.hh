@@ -42,8 +42,12 @@ struct cacheconfig {
   size_t max_read_ahead_blocks; // max  number of read-ahead blocks
   float clean_threshold; // filling percentage of the cache disk when we start to delete
   std::string read_ahead_strategy; // string values 'none', 'static', 'dynamic'
+  size_t parallel_streams; // XrdCl sub-streams per data server channel (reads only)
   std::string journal;
   bool clean_on_startup; // indicate that the cache is not reusable after restart
+  bool write_back; // close returns when the journal is durable, upload later
+  size_t write_back_threads; // number of journal upload threads
+  uint64_t write_back_bandwidth; // upload bandwidth limit in bytes/s, 0=off
 };
 
 #endif
@@ -68,27 +68,52 @@ int cachesyncer::sync(int fd, interval_tree<uint64_t,
     return 0;
   }
 
-  CollectiveHandler handler(journal.size() + ((truncatesize != -1) ? 1 : 0));
+  // split the journal entries into chunks if the bandwidth is throttled
+  struct chunk_t {
+    off_t cacheoff;
+    off_t offset;
+    size_t size;
+  };
+  std::vector<chunk_t> chunks;
+
+  for (auto itr = journal.begin(); itr != journal.end(); ++itr) {
+    for (uint64_t low = itr->low; low < itr->high;) {
+      size_t size = itr->high - low;
+
+      if (throttle && (size > sChunkSize)) {
+        size = sChunkSize;
+      }
+
+      chunks.push_back({(off_t)(itr->value + offshift + (low - itr->low)),
+                        (off_t) low, size});
+      low += size;
+    }
+  }
+
+  CollectiveHandler handler(chunks.size() + ((truncatesize != -1) ? 1 : 0));
   std::map<size_t, bufferll> bufferm;
   size_t i = 0;
 
-  for (auto itr = journal.begin(); itr != journal.end(); ++itr) {
-    off_t cacheoff = itr->value + offshift;
-    size_t size = itr->high - itr->low;
-    bufferm[i].resize(size);
-    int bytesRead = pread(fd, bufferm[i].ptr(), size, cacheoff);
+  for (auto chunk = chunks.begin(); chunk != chunks.end(); ++chunk) {
+    bufferm[i].resize(chunk->size);
+    int bytesRead = pread(fd, bufferm[i].ptr(), chunk->size, chunk->cacheoff);
 
     if (bytesRead < 0) {
       // TODO handle error
       return -1;
     }
 
-    if (bytesRead < (int) size) {
+    if (bytesRead < (int) chunk->size) {
       // TODO handle error
     }
 
+    if (throttle) {
+      throttle(chunk->size);
+    }
+
     // do async write
-    XrdCl::XRootDStatus st = file.Write(itr->low, size, bufferm[i].ptr(), &handler);
+    XrdCl::XRootDStatus st = file.Write(chunk->offset, chunk->size,
+                                        bufferm[i].ptr(), &handler);
 
     if (!st.IsOK()) {
       handler.Report(new XrdCl::XRootDStatus(st));
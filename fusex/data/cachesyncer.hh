@@ -12,14 +12,22 @@
 
 #include "XrdCl/XrdClFile.hh"
 
+#include <functional>
+
 class cachesyncer
 {
 public:
 
+  typedef std::function<void(size_t)> throttle_t;
+
   /**
    * We expect a file that has been already opened
+   *
+   * If a throttle is given, it is called before sending each chunk of
+   * at most sChunkSize bytes and may block to limit the bandwidth
    */
-  cachesyncer(XrdCl::File& file) : file(file) { }
+  cachesyncer(XrdCl::File& file, throttle_t throttle = throttle_t()) :
+    file(file), throttle(throttle) { }
 
   virtual ~cachesyncer() { }
 
@@ -29,7 +37,10 @@ public:
 
 private:
 
+  static const size_t sChunkSize = 4 * 1024 * 1024;
+
   XrdCl::File& file;
+  throttle_t throttle;
 };
 
 #endif /* FUSEX_CACHESYNCER_HH_ */
@@ -31,6 +31,7 @@
 #include "misc/fusexrdlogin.hh"
 #include "common/Logging.hh"
 #include "common/SymKeys.hh"
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -39,6 +40,7 @@ bufferllmanager data::datax::sBufferManager;
 std::string data::datax::kInlineAttribute = "sys.file.buffer";
 std::string data::datax::kInlineMaxSize = "sys.file.inline.maxsize";
 std::string data::datax::kInlineCompressor = "sys.file.inline.compressor";
+std::string data::datax::kInlineOnly = "sys.file.inline.only";
 
 /* -------------------------------------------------------------------------- */
 data::data()
@@ -71,28 +73,46 @@ data::get(fuse_req_t req,
           metad::shared_md md)
 /* -------------------------------------------------------------------------- */
 {
-  XrdSysMutexHelper mLock(datamap);
+  dmap::Shard& shard = datamap.shard_of(ino);
+  XrdSysMutexHelper mLock(shard);
+  auto it = shard.map.find(ino);
 
-  if (datamap.count(ino)) {
-    shared_data io = datamap[ino];
+  if (it != shard.map.end()) {
+    shared_data io = it->second;
     io->attach(); // client ref counting
     return io;
   } else {
     // protect against running out of file descriptors
-    size_t openfiles = datamap.size();
+    size_t openfiles = 0;
     size_t openlimit = (EosFuse::Instance().Config().options.fdlimit - 128) / 2;
 
-    while ((openfiles = datamap.size()) > openlimit) {
-      datamap.UnLock();
+    while (true) {
+      shard.UnLock();
+      openfiles = datamap.sizeTS();
+
+      if (openfiles <= openlimit) {
+        shard.Lock();
+        break;
+      }
+
       eos_static_warning("open-files=%lu limit=%lu - waiting for release of file descriptors",
                          openfiles, openlimit);
       std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-      datamap.Lock();
+      shard.Lock();
+    }
+
+    // somebody might have opened the same inode meanwhile
+    it = shard.map.find(ino);
+
+    if (it != shard.map.end()) {
+      shared_data io = it->second;
+      io->attach();
+      return io;
     }
 
     shared_data io = std::make_shared<datax>(md);
     io->set_id(ino, req);
-    datamap[(fuse_ino_t) io->id()] = io;
+    shard.map[(fuse_ino_t) io->id()] = io;
     io->attach();
     return io;
   }
@@ -104,13 +124,7 @@ bool
 data::has(fuse_ino_t ino)
 /* -------------------------------------------------------------------------- */
 {
-  XrdSysMutexHelper mLock(datamap);
-
-  if (datamap.count(ino)) {
-    return true;
-  } else {
-    return false;
-  }
+  return datamap.countTS(ino);
 }
 
 /* -------------------------------------------------------------------------- */
@@ -120,17 +134,15 @@ data::release(fuse_req_t req,
               fuse_ino_t ino)
 /* -------------------------------------------------------------------------- */
 {
-  XrdSysMutexHelper mLock(datamap);
+  shared_data io;
 
-  if (datamap.count(ino)) {
-    shared_data io = datamap[ino];
+  if (datamap.retrieveTS(ino, io)) {
     io->detach();
     // the object is cleaned by the flush thread
   }
 
-  if (datamap.count(ino + 0xffffffff)) {
+  if (datamap.retrieveTS(ino + 0xffffffff, io)) {
     // in case this is an unlinked object
-    shared_data io = datamap[ino + 0xffffffff];
     io->detach();
   }
 }
@@ -140,10 +152,9 @@ void
 data::update_cookie(uint64_t ino, std::string& cookie)
 /* -------------------------------------------------------------------------- */
 {
-  XrdSysMutexHelper mLock(datamap);
+  shared_data io;
 
-  if (datamap.count(ino)) {
-    shared_data io = datamap[ino];
+  if (datamap.retrieveTS(ino, io)) {
     io->attach(); // client ref counting
     io->store_cookie(cookie);
     io->detach();
@@ -156,10 +167,9 @@ void
 data::invalidate_cache(fuse_ino_t ino)
 /* -------------------------------------------------------------------------- */
 {
-  XrdSysMutexHelper mLock(datamap);
+  shared_data io;
 
-  if (datamap.count(ino)) {
-    shared_data io = datamap[ino];
+  if (datamap.retrieveTS(ino, io)) {
     io->attach(); // client ref counting
     io->cache_invalidate();
     io->detach();
@@ -169,20 +179,104 @@ data::invalidate_cache(fuse_ino_t ino)
 /* -------------------------------------------------------------------------- */
 void
 /* -------------------------------------------------------------------------- */
-data::unlink(fuse_req_t req, fuse_ino_t ino)
+data::replay()
 /* -------------------------------------------------------------------------- */
 {
-  XrdSysMutexHelper mLock(datamap);
+  if (!cachehandler::instance().journaled()) {
+    return;
+  }
+
+  // journals left by a previous run are uploaded before the mount is served,
+  // several journals of the same inode one after the other - oldest first
+  std::vector<std::string> manifests;
+  journalcache::replays(manifests);
+
+  if (manifests.empty()) {
+    return;
+  }
+
+  std::map<std::string, std::vector<std::string> > inodes;
+  std::map<std::string, uint64_t> sizes;
+
+  for (auto it = manifests.begin(); it != manifests.end(); ++it) {
+    std::string journal = it->substr(0, it->length() - 3);
+    std::string key = it->substr(0, it->rfind(".jc."));
+    struct stat buf;
+    inodes[key].push_back(*it);
+
+    if (!::stat(journal.c_str(), &buf)) {
+      sizes[key] += buf.st_size;
+    }
+  }
+
+  eos_static_warning("replaying %lu journals of %lu inodes", manifests.size(),
+                     inodes.size());
+  writeback* wb = &datamap.uploader;
+
+  for (auto it = inodes.begin(); it != inodes.end(); ++it) {
+    std::vector<std::string> list = it->second;
+    wb->schedule(sizes[it->first], [list, wb]() {
+      for (auto m = list.begin(); m != list.end(); ++m) {
+        int rc = journalcache::replay(*m, &data::replay_url, [wb](size_t bytes) {
+          wb->throttle(bytes);
+        });
+
+        if (rc) {
+          // the newer journals must not overtake this one
+          return rc;
+        }
+      }
+
+      return 0;
+    });
+  }
+
+  wb->drain();
+}
+
+/* -------------------------------------------------------------------------- */
+std::string
+/* -------------------------------------------------------------------------- */
+data::replay_url(const journalcache::remote_t& remote)
+/* -------------------------------------------------------------------------- */
+{
+  // the url of the journal's writer can't be reused, it was built with the
+  // login of a connection of the previous run
+  std::string lfn;
+
+  if (remote.ino) {
+    char sino[128];
+    snprintf(sino, sizeof(sino), "ino:%lx", remote.ino);
+    lfn = sino;
+  } else {
+    lfn = remote.path;
+  }
+
+  XrdCl::URL url(datax::remote_url(EosFuse::Instance().Config().hostport, lfn));
+  XrdCl::URL::ParamsMap query = url.GetParams();
+  fusexrdlogin::loginurl(url, query, remote.uid, remote.gid, getpid(),
+                         remote.ino);
+  url.SetParams(query);
+  return url.GetURL();
+}
 
-  if (datamap.count(ino)) {
-    XrdSysMutexHelper helper(datamap[ino]->Locker());
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+data::unlink(fuse_req_t req, fuse_ino_t ino)
+/* -------------------------------------------------------------------------- */
+{
+  shared_data io;
+  // put the unlinked inode in a high bucket, it is removed by the flush thread
+  datamap.moveTS(ino, ino + 0xffffffff, io, [req](shared_data & d) {
+    XrdSysMutexHelper helper(d->Locker());
     // wait for open in flight to be done
-    datamap[ino]->WaitOpen();
-    datamap[ino]->unlink(req);
-    // put the unlinked inode in a high bucket, will be removed by the flush thread
-    datamap[ino + 0xffffffff] = datamap[ino];
-    datamap.erase(ino);
-    eos_static_info("datacache::unlink size=%lu", datamap.size());
+    d->WaitOpen();
+    d->unlink(req);
+  });
+
+  if (io) {
+    eos_static_info("datacache::unlink size=%lu", datamap.sizeTS());
   } else {
     shared_data io = std::make_shared<datax>();
     io->set_id(ino, req);
@@ -212,6 +306,29 @@ data::datax::flush_nolock(fuse_req_t req, bool wait_open, bool wait_writes)
   bool journal_recovery = false;
   errno = 0;
 
+  if (write_back() && mFile->has_xrdiorw(req)) {
+    if (!wait_writes) {
+      // the journal is uploaded in the background after the close
+      return journalcommit();
+    }
+
+    // the journal is full or the data is needed remotely: upload it now
+    int rc = journalflush(req);
+
+    if (rc) {
+      eos_debug("try recovery");
+
+      if ((rc = TryRecovery(req, true)) || (rc = journalflush(req))) {
+        eos_err("journal-flushing failed rc=%d", rc);
+        return rc;
+      }
+    }
+
+    mFile->journal()->done_flush();
+    eos_info("retc=0");
+    return 0;
+  }
+
   if (mFile->journal() && mFile->has_xrdiorw(req)) {
     eos_info("flushing journal");
     ssize_t truncate_size = mFile->journal()->get_truncatesize();
@@ -379,6 +496,116 @@ data::datax::journalflush(std::string cid)
   return 0;
 }
 
+/* -------------------------------------------------------------------------- */
+int
+/* -------------------------------------------------------------------------- */
+data::datax::journalcommit()
+/* -------------------------------------------------------------------------- */
+{
+  // call this with a mLock locked
+  eos_info("");
+  journalcache::remote_t remote;
+  {
+    XrdSysMutexHelper mdLock(mMd->Locker());
+    remote.ino = mMd->md_ino();
+    // the journal is replayed by inode, the path is used if the file was not
+    // yet created remotely
+    std::string lpath = EosFuse::Instance().mds.calculateLocalPath(mMd);
+
+    if (lpath.length()) {
+      remote.path = EosFuse::Instance().Config().remotemountdir;
+
+      while (remote.path.length() && (remote.path.back() == '/')) {
+        remote.path.pop_back();
+      }
+
+      remote.path += lpath;
+    }
+  }
+  remote.uid = mRemoteUid;
+  remote.gid = mRemoteGid;
+  int rc = mFile->journal()->commit(remote);
+
+  if (rc) {
+    eos_err("journal-commit failed - ino=%08lx errno=%d", id(), rc);
+    return rc;
+  }
+
+  eos_info("retc=0");
+  return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+int
+/* -------------------------------------------------------------------------- */
+data::datax::journalflush_writeback(std::string cid, writeback& uploader)
+/* -------------------------------------------------------------------------- */
+{
+  // called by the upload threads for a detached file
+  eos_info("");
+  XrdCl::Proxy* proxy = 0;
+  int rc = 0;
+  {
+    XrdSysMutexHelper lLock(mLock);
+
+    if (mFile->xrdiorw(cid)->stateTS() == XrdCl::Proxy::FAILED) {
+      // the open failed after the file has been closed
+      eos_debug("try recovery");
+      rc = TryRecovery(0, true);
+    }
+
+    proxy = mFile->xrdiorw(cid);
+  }
+
+  if (!rc) {
+    // the journal is uploaded without holding the data object lock, the
+    // flusher doesn't touch the proxy while the upload is pending
+    cachesyncer cachesync(*((XrdCl::File*) proxy),
+    [&uploader](size_t bytes) {
+      uploader.throttle(bytes);
+    });
+
+    if (mFile->journal()->remote_sync(cachesync)) {
+      rc = EREMOTEIO;
+    }
+  }
+
+  XrdSysMutexHelper lLock(mLock);
+
+  if (rc) {
+    eos_debug("try recovery");
+
+    if (!TryRecovery(0, true) && !journalflush(cid)) {
+      rc = 0;
+    }
+  }
+
+  if (rc && mIsUnlinked) {
+    // the file has been deleted meanwhile, nobody will read this data
+    mFile->journal()->reset();
+    rc = 0;
+  }
+
+  mWriteBackPending = false;
+
+  if (rc) {
+    eos_err("journal-upload failed - ino=%08lx retc=%d - retry in %d seconds",
+            id(), rc, sWriteBackRetry);
+    mWriteBackRetry = time(NULL) + sWriteBackRetry;
+    return rc;
+  }
+
+  mFile->journal()->done_flush();
+  proxy = mFile->xrdiorw(cid);
+
+  if (!attached_nolock() && proxy->IsOpen()) {
+    proxy->set_state_TS(XrdCl::Proxy::WAITWRITE);
+  }
+
+  eos_info("retc=0");
+  return 0;
+}
+
 /* -------------------------------------------------------------------------- */
 int
 /* -------------------------------------------------------------------------- */
@@ -439,75 +666,19 @@ data::datax::attach(fuse_req_t freq, std::string& cookie, int flags)
     mFlags = flags;
   }
 
-  // check for file inlining only for the first attach call
-  if ((!inline_buffer) && (EosFuse::Instance().Config().inliner.max_size ||
-                           mMd->inlinesize())) {
-    if (mMd->inlinesize()) {
-      mInlineMaxSize = mMd->inlinesize();
-    } else {
-      mInlineMaxSize = EosFuse::Instance().Config().inliner.max_size;
-    }
-
-    auto attrMap = mMd->attr();
-
-    if (attrMap.count(kInlineMaxSize)) {
-      mInlineMaxSize = strtoull(attrMap[kInlineMaxSize].c_str(), 0, 10);
-    }
-
-    if (attrMap.count(kInlineCompressor)) {
-      mInlineCompressor = attrMap[kInlineCompressor];
-    } else {
-      mInlineCompressor = EosFuse::Instance().Config().inliner.default_compressor;
-    }
-
-    eos_debug("inline-size=%llu inline-compressor=%s", mInlineMaxSize,
-              mInlineCompressor.c_str());
-    // reserve buffer for inlining
-    inline_buffer = std::make_shared<bufferll>(mInlineMaxSize,
-                    mInlineMaxSize);
-    mIsInlined = true;
-
-    if (attrMap.count(kInlineAttribute)) {
-      std::string base64_string(attrMap[kInlineAttribute].c_str(),
-                                attrMap[kInlineAttribute].size());
-      std::string raw_string;
-      bool decoding = false;
-
-      if (base64_string.substr(0, 8) == "zbase64:") {
-        SymKey::ZDeBase64(base64_string, raw_string);
-        decoding = true;
-      } else if (base64_string.substr(0, 7) == "base64:") {
-        SymKey::DeBase64(base64_string, raw_string);
-        decoding = true;
-      }
-
-      if (decoding) {
-        // decode attribute to buffer
-        inline_buffer->writeData(raw_string.c_str(), 0, raw_string.size());
-
-        // in case there is any inconsistency between size and attribute buffer, just ignore this one
-        if (raw_string.size() != mMd->size()) {
-          inline_buffer = 0;
-          // delete the inline buffer
-          (mMd->mutable_attr())->erase(kInlineAttribute);
-          mIsInlined = false;
-        }
-      } else {
-        mIsInlined = false;
-      }
-    } else {
-      if (mMd->size()) {
-        mIsInlined = false;
-      }
-    }
-  }
-
   if (flags & (O_RDWR | O_WRONLY)) {
     isRW = true;
   }
 
-  eos_info("cookie=%s flags=%o isrw=%d md-size=%d %s", cookie.c_str(), flags,
-           isRW, mMd->size(),
+  // check for file inlining only for the first attach call
+  if ((!inline_buffer) && (EosFuse::Instance().Config().inliner.max_size ||
+                           mMd->inlinesize() ||
+                           mMd->attr().count(kInlineOnly))) {
+    inline_load(freq, flags);
+  }
+
+  eos_info("cookie=%s flags=%o isrw=%d md-size=%d inline-only=%d %s",
+           cookie.c_str(), flags, isRW, mMd->size(), mInlineOnly,
            isRW ? mRemoteUrlRW.c_str() : mRemoteUrlRO.c_str());
   // store the currently known size here
   mSize = mMd->size();
@@ -543,74 +714,249 @@ data::datax::attach(fuse_req_t freq, std::string& cookie, int flags)
     throw std::runtime_error(msg);
   }
 
+  if (mInlineOnly) {
+    // the contents lives in the md record, there is nothing to open on an FST
+    // until the file outgrows the inline size
+    if (isRW) {
+      mInlineAttachedRW++;
+    }
+
+    return bcache | jcache;
+  }
+
   if (isRW) {
-    if (!mFile->has_xrdiorw(freq) || mFile->xrdiorw(freq)->IsClosing() ||
-        mFile->xrdiorw(freq)->IsClosed()) {
-      if (mFile->has_xrdiorw(freq) && (mFile->xrdiorw(freq)->IsClosing() ||
-                                       mFile->xrdiorw(freq)->IsClosed())) {
-        mFile->xrdiorw(freq)->WaitClose();
-        mFile->xrdiorw(freq)->attach();
+    attach_rw(freq, 1);
+  } else {
+    attach_ro(freq, flags);
+  }
+
+  return bcache | jcache;
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+data::datax::inline_load(fuse_req_t freq, int flags)
+/* -------------------------------------------------------------------------- */
+{
+  if (mMd->inlinesize()) {
+    mInlineMaxSize = mMd->inlinesize();
+  } else {
+    mInlineMaxSize = EosFuse::Instance().Config().inliner.max_size;
+  }
+
+  auto attrMap = mMd->attr();
+
+  if (attrMap.count(kInlineMaxSize)) {
+    mInlineMaxSize = strtoull(attrMap[kInlineMaxSize].c_str(), 0, 10);
+  }
+
+  if (attrMap.count(kInlineCompressor)) {
+    mInlineCompressor = attrMap[kInlineCompressor];
+  } else if (mMd->inlinecompressor().length()) {
+    mInlineCompressor = mMd->inlinecompressor();
+  } else {
+    mInlineCompressor = EosFuse::Instance().Config().inliner.default_compressor;
+  }
+
+  eos_debug("inline-size=%llu inline-compressor=%s", mInlineMaxSize,
+            mInlineCompressor.c_str());
+  // reserve buffer for inlining
+  inline_buffer = std::make_shared<bufferll>(mInlineMaxSize,
+                  mInlineMaxSize);
+  mIsInlined = true;
+  mInlineOnly = false;
+
+  if (attrMap.count(kInlineAttribute)) {
+    std::string base64_string(attrMap[kInlineAttribute].c_str(),
+                              attrMap[kInlineAttribute].size());
+    std::string raw_string;
+    bool decoding = false;
+
+    if (base64_string.substr(0, 8) == "zbase64:") {
+      SymKey::ZDeBase64(base64_string, raw_string);
+      decoding = true;
+    } else if (base64_string.substr(0, 7) == "base64:") {
+      SymKey::DeBase64(base64_string, raw_string);
+      decoding = true;
+    }
+
+    if (decoding) {
+      // decode attribute to buffer
+      inline_buffer->writeData(raw_string.c_str(), 0, raw_string.size());
+
+      // in case there is any inconsistency between size and attribute buffer, just ignore this one
+      if (raw_string.size() != mMd->size()) {
+        inline_buffer = 0;
+        // delete the inline buffer
+        (mMd->mutable_attr())->erase(kInlineAttribute);
+        mIsInlined = false;
       } else {
-        // attach an rw io object
-        mFile->set_xrdiorw(freq, new XrdCl::Proxy());
-        mFile->xrdiorw(freq)->attach();
-        mFile->xrdiorw(freq)->set_id(id(), req());
+        // the file has no replica on any FST
+        mInlineOnly = attrMap.count(kInlineOnly);
       }
+    } else {
+      mIsInlined = false;
+    }
+  } else {
+    if (mMd->size()) {
+      mIsInlined = false;
+    } else if (create_inline_only(flags, mInlineMaxSize, mMd->inlineonly(),
+                                  mFile->has_xrdiorw(freq) ||
+                                  mFile->has_xrdioro(freq))) {
+      // a new file stays in the md record until it outgrows the inline size
+      mInlineOnly = true;
+    }
+  }
 
-      XrdCl::OpenFlags::Flags targetFlags = XrdCl::OpenFlags::Update;
-      XrdCl::Access::Mode mode = XrdCl::Access::UR | XrdCl::Access::UW |
-                                 XrdCl::Access::UX;
-      mFile->xrdiorw(freq)->OpenAsync(mRemoteUrlRW.c_str(), targetFlags, mode, 0);
+  if (mMd->attr().count(kInlineOnly) && !mInlineOnly) {
+    eos_err("inline-only file can not be inlined size=%lu", mMd->size());
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+data::datax::attach_rw(fuse_req_t freq, size_t nattach)
+/* -------------------------------------------------------------------------- */
+{
+  if (!mFile->has_xrdiorw(freq) || mFile->xrdiorw(freq)->IsClosing() ||
+      mFile->xrdiorw(freq)->IsClosed()) {
+    if (mFile->has_xrdiorw(freq) && (mFile->xrdiorw(freq)->IsClosing() ||
+                                     mFile->xrdiorw(freq)->IsClosed())) {
+      mFile->xrdiorw(freq)->WaitClose();
+
+      for (size_t i = 0; i < nattach; ++i) {
+        mFile->xrdiorw(freq)->attach();
+      }
     } else {
-      if (mFile->xrdiorw(freq)->IsWaitWrite()) {
-        // re-open the file in the state machine
-        mFile->xrdiorw(freq)->set_state_TS(XrdCl::Proxy::OPENED);
+      // attach an rw io object
+      mFile->set_xrdiorw(freq, new XrdCl::Proxy());
+
+      for (size_t i = 0; i < nattach; ++i) {
+        mFile->xrdiorw(freq)->attach();
       }
 
-      mFile->xrdiorw(freq)->attach();
+      mFile->xrdiorw(freq)->set_id(id(), req());
     }
+
+    XrdCl::OpenFlags::Flags targetFlags = XrdCl::OpenFlags::Update;
+    XrdCl::Access::Mode mode = XrdCl::Access::UR | XrdCl::Access::UW |
+                               XrdCl::Access::UX;
+    mFile->xrdiorw(freq)->OpenAsync(mRemoteUrlRW.c_str(), targetFlags, mode, 0);
   } else {
-    if (!mFile->has_xrdioro(freq) || mFile->xrdioro(freq)->IsClosing() ||
-        mFile->xrdioro(freq)->IsClosed()) {
-      if (mFile->has_xrdioro(freq) && (mFile->xrdioro(freq)->IsClosing() ||
-                                       mFile->xrdioro(freq)->IsClosed())) {
-        mFile->xrdioro(freq)->WaitClose();
-        mFile->xrdioro(freq)->attach();
-      } else {
-        mFile->set_xrdioro(freq, new XrdCl::Proxy());
-        mFile->xrdioro(freq)->attach();
-        mFile->xrdioro(freq)->set_id(id(), req());
-
-        if (!(flags & O_SYNC)) {
-          if (EOS_LOGS_DEBUG)
-            eos_debug("readhead: strategy=%s nom:%lu max:%lu",
-                      cachehandler::instance().get_config().read_ahead_strategy.c_str(),
-                      cachehandler::instance().get_config().default_read_ahead_size,
-                      cachehandler::instance().get_config().max_read_ahead_size);
-
-          mFile->xrdioro(freq)->set_readahead_strategy(
-            XrdCl::Proxy::readahead_strategy_from_string(
-              cachehandler::instance().get_config().read_ahead_strategy),
-            4096,
-            cachehandler::instance().get_config().default_read_ahead_size,
-            cachehandler::instance().get_config().max_read_ahead_size,
-            cachehandler::instance().get_config().max_read_ahead_blocks
-          );
-          mFile->xrdioro(freq)->set_readahead_maximum_position(mSize);
-        }
-      }
+    if (mFile->xrdiorw(freq)->IsWaitWrite()) {
+      // re-open the file in the state machine
+      mFile->xrdiorw(freq)->set_state_TS(XrdCl::Proxy::OPENED);
+    }
+
+    for (size_t i = 0; i < nattach; ++i) {
+      mFile->xrdiorw(freq)->attach();
+    }
+  }
+}
 
-      XrdCl::OpenFlags::Flags targetFlags = XrdCl::OpenFlags::Read;
-      XrdCl::Access::Mode mode = XrdCl::Access::UR | XrdCl::Access::UX;
-      // we might need to wait for a creation to go through
-      WaitOpen();
-      mFile->xrdioro(freq)->OpenAsync(mRemoteUrlRO.c_str(), targetFlags, mode, 0);
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+data::datax::attach_ro(fuse_req_t freq, int flags)
+/* -------------------------------------------------------------------------- */
+{
+  if (!mFile->has_xrdioro(freq) || mFile->xrdioro(freq)->IsClosing() ||
+      mFile->xrdioro(freq)->IsClosed()) {
+    if (mFile->has_xrdioro(freq) && (mFile->xrdioro(freq)->IsClosing() ||
+                                     mFile->xrdioro(freq)->IsClosed())) {
+      mFile->xrdioro(freq)->WaitClose();
+      mFile->xrdioro(freq)->attach();
     } else {
+      mFile->set_xrdioro(freq, new XrdCl::Proxy());
       mFile->xrdioro(freq)->attach();
+      mFile->xrdioro(freq)->set_id(id(), req());
+
+      if (!(flags & O_SYNC)) {
+        if (EOS_LOGS_DEBUG)
+          eos_debug("readhead: strategy=%s nom:%lu max:%lu",
+                    cachehandler::instance().get_config().read_ahead_strategy.c_str(),
+                    cachehandler::instance().get_config().default_read_ahead_size,
+                    cachehandler::instance().get_config().max_read_ahead_size);
+
+        mFile->xrdioro(freq)->set_readahead_strategy(
+          XrdCl::Proxy::readahead_strategy_from_string(
+            cachehandler::instance().get_config().read_ahead_strategy),
+          4096,
+          cachehandler::instance().get_config().default_read_ahead_size,
+          cachehandler::instance().get_config().max_read_ahead_size,
+          cachehandler::instance().get_config().max_read_ahead_blocks
+        );
+        mFile->xrdioro(freq)->set_readahead_maximum_position(mSize);
+      }
     }
+
+    XrdCl::OpenFlags::Flags targetFlags = XrdCl::OpenFlags::Read;
+    XrdCl::Access::Mode mode = XrdCl::Access::UR | XrdCl::Access::UX;
+    // we might need to wait for a creation to go through
+    WaitOpen();
+    mFile->xrdioro(freq)->OpenAsync(mRemoteUrlRO.c_str(), targetFlags, mode, 0);
+  } else {
+    mFile->xrdioro(freq)->attach();
   }
+}
 
-  return bcache | jcache;
+/* -------------------------------------------------------------------------- */
+int
+/* -------------------------------------------------------------------------- */
+data::datax::inline_spill(fuse_req_t req)
+/* -------------------------------------------------------------------------- */
+{
+  // the file outgrows the inline size - open it on an FST for all the handles
+  // attached so far and upload the inlined contents first
+  eos_info("spilling inline-only file size=%lu", inline_buffer->getSize());
+  mInlineOnly = false;
+  (mMd->mutable_attr())->erase(kInlineOnly);
+  attach_rw(req, mInlineAttachedRW ? mInlineAttachedRW : 1);
+  mInlineAttachedRW = 0;
+  size_t isize = inline_buffer->getSize();
+
+  if (isize) {
+    XrdCl::Proxy::write_handler handler =
+      mFile->xrdiorw(req)->WriteAsyncPrepare(isize, 0, 0);
+    XrdCl::XRootDStatus status =
+      mFile->xrdiorw(req)->ScheduleWriteAsync(inline_buffer->ptr(), handler);
+
+    if ((!status.IsOK()) && (!EosFuse::Instance().Config().recovery.write)) {
+      errno = XrdCl::Proxy::status2errno(status);
+      eos_err("async remote-io failed msg=\"%s\"", status.ToString().c_str());
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+ssize_t
+/* -------------------------------------------------------------------------- */
+data::datax::inline_pread(void* buf, size_t count, off_t offset)
+/* -------------------------------------------------------------------------- */
+{
+  size_t fsize = mMd->size();
+
+  if ((size_t) offset >= fsize) {
+    return 0;
+  }
+
+  size_t avail_bytes = std::min(count, (size_t)(fsize - offset));
+  size_t isize = inline_buffer->getSize();
+  size_t incore = ((size_t) offset < isize) ?
+                  std::min(avail_bytes, (size_t)(isize - offset)) : 0;
+
+  if (incore) {
+    memcpy(buf, inline_buffer->ptr() + offset, incore);
+  }
+
+  // a truncation might have extended the file beyond the buffered contents
+  memset((char*) buf + incore, 0, avail_bytes - incore);
+  return avail_bytes;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -639,10 +985,16 @@ data::datax::inline_file(ssize_t size)
       (*(mMd->mutable_attr()))[kInlineAttribute] = base64_string;
       (*(mMd->mutable_attr()))[kInlineMaxSize] = std::to_string(mInlineMaxSize);
       (*(mMd->mutable_attr()))[kInlineCompressor] = mInlineCompressor;
+
+      if (mInlineOnly) {
+        (*(mMd->mutable_attr()))[kInlineOnly] = "1";
+      }
+
       return true;
     } else {
       // remove the extended attribute
       (mMd->mutable_attr())->erase(kInlineAttribute);
+      (mMd->mutable_attr())->erase(kInlineOnly);
       mIsInlined = false;
       return false;
     }
@@ -1531,7 +1883,11 @@ data::datax::detach(fuse_req_t req, std::string& cookie, int flags)
   int xio = 0;
 
   if (isRW) {
-    if (mFile->has_xrdiorw(req)) {
+    if (mInlineOnly) {
+      if (mInlineAttachedRW) {
+        mInlineAttachedRW--;
+      }
+    } else if (mFile->has_xrdiorw(req)) {
       mFile->xrdiorw(req)->detach();
     }
   } else {
@@ -1596,22 +1952,16 @@ data::datax::pread(fuse_req_t req, void* buf, size_t count, off_t offset)
     }
   }
 
+  if (!inline_buffer && mMd->attr().count(kInlineOnly)) {
+    // the inline buffer was invalidated by a remote update
+    inline_load(req, 0);
+  }
+
   if (inline_buffer && inlined() &&
-      (count + offset) < mInlineMaxSize) {
+      (mInlineOnly || ((count + offset) < mInlineMaxSize))) {
     // possibly return data from an inlined buffer
-    ssize_t avail_bytes = 0;
-
-    if (((size_t) offset < mMd->size())) {
-      if ((offset + count) > mMd->size()) {
-        avail_bytes = mMd->size() - offset;
-      } else {
-        avail_bytes = count;
-      }
-    } else {
-      avail_bytes = 0;
-    }
-
-    memcpy(buf, inline_buffer->ptr() + offset, avail_bytes);
+    ssize_t avail_bytes = inline_pread(buf, count, offset);
+    mLock.UnLock();
     return avail_bytes;
   }
 
@@ -1740,7 +2090,22 @@ data::datax::pwrite(fuse_req_t req, const void* buf, size_t count, off_t offset)
 
   // inlined-files
   if (inline_buffer) {
-    if ((count + offset) < mInlineMaxSize) {
+    if (mInlineOnly) {
+      if ((count + offset) <= mInlineMaxSize) {
+        // the md record is the only copy of the contents
+        inline_buffer->writeData(buf, offset, count);
+
+        if ((off_t)(offset + count) > mSize) {
+          mSize = count + offset;
+        }
+
+        return count;
+      }
+
+      if (inline_spill(req)) {
+        return -1;
+      }
+    } else if ((count + offset) < mInlineMaxSize) {
       // copy into file inline buffer
       inline_buffer->writeData(buf, offset, count);
     }
@@ -1777,71 +2142,85 @@ data::datax::pwrite(fuse_req_t req, const void* buf, size_t count, off_t offset)
       dw = jw;
     }
 
-    // send an asynchronous upstream write, which does not wait for the file open to be done
-    XrdCl::Proxy::write_handler handler =
-      mFile->xrdiorw(req)->WriteAsyncPrepare(count, offset, 0);
-    XrdCl::XRootDStatus status =
-      mFile->xrdiorw(req)->ScheduleWriteAsync(buf, handler);
-    // test if we switch to xoff mode, where we only write into the journal
-    size_t cnt = 0;
+    if (write_back()) {
+      // the journal keeps the data until it is uploaded after the close,
+      // synchronous writes are uploaded right away
+      if (mFlags & O_SYNC) {
+        int rc = flush_nolock(req, true, true);
 
-    while (mFile->xrdiorw(req)->HasTooManyWritesInFlight()) {
-      if (!cnt % 1000) {
-        eos_warning("doing XOFF");
+        if (rc) {
+          eos_err("pseudo-sync journal upload failed errno=%d", rc);
+          errno = rc;
+          return -1;
+        }
       }
+    } else {
+      // send an asynchronous upstream write, which does not wait for the file open to be done
+      XrdCl::Proxy::write_handler handler =
+        mFile->xrdiorw(req)->WriteAsyncPrepare(count, offset, 0);
+      XrdCl::XRootDStatus status =
+        mFile->xrdiorw(req)->ScheduleWriteAsync(buf, handler);
+      // test if we switch to xoff mode, where we only write into the journal
+      size_t cnt = 0;
+
+      while (mFile->xrdiorw(req)->HasTooManyWritesInFlight()) {
+        if (!cnt % 1000) {
+          eos_warning("doing XOFF");
+        }
 
-      mXoff = true;
-      std::this_thread::sleep_for(std::chrono::milliseconds(5));
-      cnt++;
-    }
+        mXoff = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        cnt++;
+      }
 
-    mXoff = false;
+      mXoff = false;
 
-    if ((!status.IsOK()) && (!EosFuse::Instance().Config().recovery.write)) {
-      errno = XrdCl::Proxy::status2errno(status);
-      eos_err("async remote-io failed msg=\"%s\"", status.ToString().c_str());
-      return -1;
-    }
+      if ((!status.IsOK()) && (!EosFuse::Instance().Config().recovery.write)) {
+        errno = XrdCl::Proxy::status2errno(status);
+        eos_err("async remote-io failed msg=\"%s\"", status.ToString().c_str());
+        return -1;
+      }
 
-    if (mFlags & O_SYNC) {
-      eos_debug("O_SYNC");
-      // make sure the file gets opened
-      XrdCl::XRootDStatus status = mFile->xrdiorw(req)->WaitOpen();
+      if (mFlags & O_SYNC) {
+        eos_debug("O_SYNC");
+        // make sure the file gets opened
+        XrdCl::XRootDStatus status = mFile->xrdiorw(req)->WaitOpen();
 
-      if (!status.IsOK()) {
-        if (TryRecovery(req, true)) {
-          errno = XrdCl::Proxy::status2errno(status);
-          eos_err("pseudo-sync remote-io failed msg=\"%s\"", status.ToString().c_str());
-          return -1;
-        } else {
-          // re-send the write again
-          XrdCl::Proxy::write_handler handler =
-            mFile->xrdiorw(req)->WriteAsyncPrepare(count, offset, 0);
-          XrdCl::XRootDStatus status =
-            mFile->xrdiorw(req)->ScheduleWriteAsync(buf, handler);
+        if (!status.IsOK()) {
+          if (TryRecovery(req, true)) {
+            errno = XrdCl::Proxy::status2errno(status);
+            eos_err("pseudo-sync remote-io failed msg=\"%s\"", status.ToString().c_str());
+            return -1;
+          } else {
+            // re-send the write again
+            XrdCl::Proxy::write_handler handler =
+              mFile->xrdiorw(req)->WriteAsyncPrepare(count, offset, 0);
+            XrdCl::XRootDStatus status =
+              mFile->xrdiorw(req)->ScheduleWriteAsync(buf, handler);
+          }
         }
-      }
 
-      // make sure all writes were successfull
-      status = mFile->xrdiorw(req)->WaitWrite();
+        // make sure all writes were successfull
+        status = mFile->xrdiorw(req)->WaitWrite();
 
-      if (!status.IsOK()) {
-        if (TryRecovery(req, true)) {
-          errno = XrdCl::Proxy::status2errno(status);
-          eos_err("pseudo-sync remote-io failed msg=\"%s\"", status.ToString().c_str());
-          return -1;
-        } else {
-          // re-send the write again
-          XrdCl::Proxy::write_handler handler =
-            mFile->xrdiorw(req)->WriteAsyncPrepare(count, offset, 0);
-          XrdCl::XRootDStatus status =
-            mFile->xrdiorw(req)->ScheduleWriteAsync(buf, handler);
-          status = mFile->xrdiorw(req)->WaitWrite();
-
-          if (!status.IsOK()) {
+        if (!status.IsOK()) {
+          if (TryRecovery(req, true)) {
             errno = XrdCl::Proxy::status2errno(status);
             eos_err("pseudo-sync remote-io failed msg=\"%s\"", status.ToString().c_str());
             return -1;
+          } else {
+            // re-send the write again
+            XrdCl::Proxy::write_handler handler =
+              mFile->xrdiorw(req)->WriteAsyncPrepare(count, offset, 0);
+            XrdCl::XRootDStatus status =
+              mFile->xrdiorw(req)->ScheduleWriteAsync(buf, handler);
+            status = mFile->xrdiorw(req)->WaitWrite();
+
+            if (!status.IsOK()) {
+              errno = XrdCl::Proxy::status2errno(status);
+              eos_err("pseudo-sync remote-io failed msg=\"%s\"", status.ToString().c_str());
+              return -1;
+            }
           }
         }
       }
@@ -1884,22 +2263,16 @@ data::datax::peek_pread(fuse_req_t req, char*& buf, size_t count, off_t offset)
   buffer = sBufferManager.get_buffer(count);
   buf = buffer->ptr();
 
+  if (!inline_buffer && mMd->attr().count(kInlineOnly)) {
+    // the inline buffer was invalidated by a remote update
+    inline_load(req, 0);
+  }
+
   if (inline_buffer && inlined()) {
     // possibly return data from an inlined buffer
-    ssize_t avail_bytes = 0;
-
-    if (((size_t) offset < mMd->size())) {
-      if ((offset + count) > mMd->size()) {
-        avail_bytes = mMd->size() - offset;
-      } else {
-        avail_bytes = count;
-      }
-    } else {
-      avail_bytes = 0;
-    }
-
-    if (mMd->size() <= (unsigned long long) inline_buffer->getSize()) {
-      memcpy(buf, inline_buffer->ptr() + offset, avail_bytes);
+    if (mInlineOnly ||
+        (mMd->size() <= (unsigned long long) inline_buffer->getSize())) {
+      ssize_t avail_bytes = inline_pread(buf, count, offset);
       eos_debug("inline-read byte=%lld inline-buffer-size=%lld", avail_bytes,
                 inline_buffer->getSize());
       return avail_bytes;
@@ -2070,6 +2443,19 @@ data::datax::truncate(fuse_req_t req, off_t offset)
   int dt = 0;
 
   if (inline_buffer) {
+    if (mInlineOnly) {
+      if (((size_t) offset) <= mInlineMaxSize) {
+        // the md record is the only copy of the contents
+        inline_buffer->truncateData(offset);
+        mSize = offset;
+        return 0;
+      }
+
+      if (inline_spill(req)) {
+        return -1;
+      }
+    }
+
     if (inlined()) {
       if (((size_t) offset) < mInlineMaxSize) {
         // truncate file inline buffer
@@ -2145,6 +2531,19 @@ data::datax::sync()
 
   bool journal_recovery = false;
 
+  if (write_back()) {
+    // the journal has to be uploaded to make the data durable remotely
+    XrdSysMutexHelper lLock(mLock);
+
+    for (auto it = mFile->get_xrdiorw().begin();
+         it != mFile->get_xrdiorw().end(); ++it) {
+      if (journalflush(it->first)) {
+        errno = EREMOTEIO;
+        journal_recovery = true;
+      }
+    }
+  }
+
   for (auto it = mFile->get_xrdiorw().begin();
        it != mFile->get_xrdiorw().end(); ++it) {
     if (it->second->IsOpening()) {
@@ -2201,7 +2600,13 @@ data::datax::cache_invalidate()
   // truncate the block cache
   int dt = mFile->file() ? mFile->file()->truncate(0) : 0;
   int jt = mFile->journal() ? mFile->journal()->truncate(0, true) : 0;
-  inline_buffer = nullptr;
+
+  if (!(mInlineOnly && mInlineAttachedRW)) {
+    // reloaded from the md record when needed, unless a local writer holds
+    // the only copy of an inline-only file
+    inline_buffer = nullptr;
+    mInlineOnly = false;
+  }
 
   for (auto fit = mFile->get_xrdioro().begin();
        fit != mFile->get_xrdioro().end(); ++fit) {
@@ -2225,40 +2630,55 @@ data::datax::set_remote(const std::string& hostport,
 /* -------------------------------------------------------------------------- */
 {
   eos_info("");
-  std::string remoteurl;
-  remoteurl = "root://";
-  remoteurl += hostport;
-  remoteurl += "//fusex-open";
-  remoteurl += "?eos.lfn=";
+  std::string lfn;
 
   if (md_ino) {
-    remoteurl += "ino:";
+    lfn = "ino:";
     char sino[128];
     snprintf(sino, sizeof(sino), "%lx", md_ino);
-    remoteurl += sino;
+    lfn += sino;
   } else {
-    remoteurl += "pino:";
+    lfn = "pino:";
     char pino[128];
     snprintf(pino, sizeof(pino), "%lx", md_pino);
-    remoteurl += pino;
-    remoteurl += "/";
-    remoteurl += basename;
+    lfn += pino;
+    lfn += "/";
+    lfn += basename;
   }
 
-  remoteurl += "&eos.app=fuse&mgm.mtime=0&mgm.fusex=1&eos.bookingsize=0";
-  XrdCl::URL url(remoteurl);
+  XrdCl::URL url(remote_url(hostport, lfn));
   XrdCl::URL::ParamsMap query = url.GetParams();
   fusexrdlogin::loginurl(url, query, req, md_ino);
   url.SetParams(query);
-  remoteurl = url.GetURL();
+  std::string remoteurl = url.GetURL();
 
   if (isRW) {
     mRemoteUrlRW = remoteurl;
+    // the journal manifest records the writer to replay its journal
+    fuse_id writer(req);
+    mRemoteUid = writer.uid;
+    mRemoteGid = writer.gid;
   } else {
     mRemoteUrlRO = remoteurl;
   }
 }
 
+/* -------------------------------------------------------------------------- */
+std::string
+/* -------------------------------------------------------------------------- */
+data::datax::remote_url(const std::string& hostport, const std::string& lfn)
+/* -------------------------------------------------------------------------- */
+{
+  std::string remoteurl;
+  remoteurl = "root://";
+  remoteurl += hostport;
+  remoteurl += "//fusex-open";
+  remoteurl += "?eos.lfn=";
+  remoteurl += lfn;
+  remoteurl += "&eos.app=fuse&mgm.mtime=0&mgm.fusex=1&eos.bookingsize=0";
+  return remoteurl;
+}
+
 /* -------------------------------------------------------------------------- */
 void
 /* -------------------------------------------------------------------------- */
@@ -2269,14 +2689,10 @@ data::dmap::ioflush(ThreadAssistant& assistant)
     {
       //eos_static_debug("");
       std::vector<shared_data> data;
-      {
-        // avoid mutex contention
-        XrdSysMutexHelper mLock(this);
-
-        for (auto it = this->begin(); it != this->end(); ++it) {
-          data.push_back(it->second);
-        }
-      }
+      // avoid mutex contention
+      this->for_eachTS([&data](const fuse_ino_t&, shared_data & io) {
+        data.push_back(io);
+      });
 
       for (auto it = data.begin(); it != data.end(); ++it) {
         eos_static_info("dbmap-in %08lx => %lx", (*it)->id(), &(*it));
@@ -2288,7 +2704,7 @@ data::dmap::ioflush(ThreadAssistant& assistant)
           eos_static_info("dbmap-in => ino:%16lx %lx attached=%d", (*it)->id(), &(*it),
                           (*it)->attached_nolock());
 
-          if (!(*it)->attached_nolock()) {
+          if (!(*it)->attached_nolock() && !(*it)->writeback_pending()) {
             // files which are detached might need an upstream sync
             bool repeat = true;
 
@@ -2308,6 +2724,25 @@ data::dmap::ioflush(ThreadAssistant& assistant)
                   break;
                 }
 
+                if ((*it)->write_back() && !(*it)->unlinked() &&
+                    (fit->second->IsOpen() ||
+                     (fit->second->stateTS() == XrdCl::Proxy::FAILED)) &&
+                    (*it)->file()->journal()->pending()) {
+                  // hand the journal over to the upload threads
+                  if ((*it)->writeback_begin()) {
+                    shared_data io = *it;
+                    std::string cid = fit->first;
+                    writeback* wb = &uploader;
+                    eos_static_info("queueing journal upload for req=%s id=%08lx",
+                                    cid.c_str(), io->id());
+                    uploader.schedule(io->file()->journal()->size(), [io, cid, wb]() {
+                      return io->journalflush_writeback(cid, *wb);
+                    });
+                  }
+
+                  break;
+                }
+
                 if (fit->second->IsOpen()) {
                   eos_static_info("flushing journal for req=%s id=%08lx", fit->first.c_str(),
                                   (*it)->id());
@@ -2383,16 +2818,26 @@ data::dmap::ioflush(ThreadAssistant& assistant)
             }
           }
         }
-        XrdSysMutexHelper mLock(this);
-        XrdSysMutexHelper lLock((*it)->Locker());
-
-        // re-check that nobody is attached
-        if (!(*it)->attached_nolock() && !(*it)->file()->get_xrdiorw().size()) {
-          // here we make the data object unreachable for new clients
-          (*it)->detach_nolock();
-          cachehandler::instance().rm((*it)->id());
-          this->erase((*it)->id());
-          this->erase((*it)->id() + 0xffffffff);
+        bool erased = false;
+        {
+          Shard& shard = this->shard_of((*it)->id());
+          XrdSysMutexHelper mLock(shard);
+          XrdSysMutexHelper lLock((*it)->Locker());
+
+          // re-check that nobody is attached
+          if (!(*it)->attached_nolock() && !(*it)->file()->get_xrdiorw().size()) {
+            // here we make the data object unreachable for new clients
+            (*it)->detach_nolock();
+            cachehandler::instance().rm((*it)->id());
+            shard.map.erase((*it)->id());
+            erased = true;
+          }
+        }
+
+        if (erased) {
+          // the unlinked bucket lives in another shard, which must not be
+          // locked while holding the data object
+          this->eraseTS((*it)->id() + 0xffffffff);
         }
       }
 
@@ -27,12 +27,16 @@
 
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <fcntl.h>
 #include "data/cache.hh"
 #include "data/io.hh"
 #include "data/cachehandler.hh"
+#include "data/writeback.hh"
+#include "data/journalcache.hh"
 #include "md/md.hh"
 #include "cap/cap.hh"
 #include "common/AssistedThread.hh"
+#include "misc/ShardedMap.hh"
 #include "bufferll.hh"
 #include "llfusexx.hh"
 #include "fusex/fusex.pb.h"
@@ -63,8 +67,10 @@ public:
       mPrefetchHandler(0),
       mSimulateWriteErrorInFlush(false),
       mSimulateWriteErrorInFlusher(false),
-      mFlags(0), mXoff(false), mIsInlined(false), mInlineMaxSize(0),
-      mInlineCompressor("none"), mIsUnlinked(false)
+      mFlags(0), mXoff(false), mIsInlined(false), mInlineOnly(false),
+      mInlineAttachedRW(0), mInlineMaxSize(0), mInlineCompressor("none"),
+      mIsUnlinked(false), mWriteBackPending(false), mWriteBackRetry(0),
+      mRemoteUid(0), mRemoteGid(0)
     {
       inline_buffer = nullptr;
     }
@@ -74,8 +80,10 @@ public:
       mSimulateWriteErrorInFlush(false),
       mSimulateWriteErrorInFlusher(false),
       mFlags(0), mXoff(false),
-      mIsInlined(false), mInlineMaxSize(0), mInlineCompressor("none"),
-      mIsUnlinked(false) { }
+      mIsInlined(false), mInlineOnly(false), mInlineAttachedRW(0),
+      mInlineMaxSize(0), mInlineCompressor("none"),
+      mIsUnlinked(false), mWriteBackPending(false), mWriteBackRetry(0),
+      mRemoteUid(0), mRemoteGid(0) { }
 
     virtual ~datax() = default;
 
@@ -107,6 +115,8 @@ public:
     int journalflush(fuse_req_t req);
     int journalflush(std::string cid);
     int journalflush_async(std::string cid);
+    int journalcommit();
+    int journalflush_writeback(std::string cid, writeback& uploader);
     int attach(fuse_req_t req, std::string& cookie, int flags);
     bool inline_file(ssize_t size = -1);
     int detach(fuse_req_t req, std::string& cookie, int flags);
@@ -120,6 +130,10 @@ public:
                     fuse_req_t req,
                     bool isRW);
 
+    // url of the fusex-open of an eos.lfn on the MGM, without login
+    static std::string remote_url(const std::string& hostport,
+                                  const std::string& lfn);
+
     // IO bridge interface
     ssize_t pread(fuse_req_t req, void* buf, size_t count, off_t offset);
     ssize_t pwrite(fuse_req_t req, const void* buf, size_t count, off_t offset);
@@ -204,11 +218,63 @@ public:
       return mIsInlined;
     }
 
+    bool inline_only()
+    {
+      return mInlineOnly;
+    }
+
+    // value of the directory attribute sys.file.inline.only enabling
+    // inline-only files
+    static bool inline_only_enabled(const std::string& value)
+    {
+      return (strtol(value.c_str(), 0, 10) == 1);
+    }
+
+    // check if a file without inline contents is created inline-only: only
+    // on request of its directory and if nothing is opened on an FST yet
+    static bool create_inline_only(int flags, uint64_t inline_max_size,
+                                   bool dir_inline_only, bool has_io)
+    {
+      return ((flags & O_CREAT) && inline_max_size && dir_inline_only &&
+              !has_io);
+    }
+
+    // write-back: writes are only journaled and uploaded after the close
+    bool write_back()
+    {
+      return (mFile->journal() &&
+              cachehandler::instance().get_config().write_back);
+    }
+
+    bool writeback_pending()
+    {
+      // caller has to have this object locked
+      return mWriteBackPending;
+    }
+
+    bool writeback_begin()
+    {
+      // caller has to have this object locked
+      if (mWriteBackPending || (time(NULL) < mWriteBackRetry)) {
+        return false;
+      }
+
+      mWriteBackPending = true;
+      return true;
+    }
+
     static std::string kInlineAttribute;
     static std::string kInlineMaxSize;
     static std::string kInlineCompressor;
+    static std::string kInlineOnly;
 
   private:
+    void inline_load(fuse_req_t req, int flags);
+    int inline_spill(fuse_req_t req);
+    ssize_t inline_pread(void* buf, size_t count, off_t offset);
+    void attach_rw(fuse_req_t req, size_t nattach);
+    void attach_ro(fuse_req_t req, int flags);
+
     XrdSysMutex mLock;
     uint64_t mIno;
     fuse_req_t mReq;
@@ -216,6 +282,8 @@ public:
     off_t mSize;
     std::string mRemoteUrlRW;
     std::string mRemoteUrlRO;
+    uid_t mRemoteUid; // writer of the journal
+    gid_t mRemoteGid;
     std::string mBaseName;
     size_t mAttached;
     metad::shared_md mMd;
@@ -229,10 +297,19 @@ public:
 
     bool mXoff;
     bool mIsInlined;
+    // the contents lives only in the md record, the file has no FST replica
+    bool mInlineOnly;
+    // number of rw handles attached while the file is inline-only
+    size_t mInlineAttachedRW;
     uint64_t mInlineMaxSize;
     std::string mInlineCompressor;
     bufferllmanager::shared_buffer inline_buffer;
     bool mIsUnlinked;
+    // a journal upload is queued or running
+    bool mWriteBackPending;
+    // earliest time to retry a failed journal upload
+    time_t mWriteBackRetry;
+    static const int sWriteBackRetry = 60;
 
   };
 
@@ -319,7 +396,7 @@ public:
 
   //----------------------------------------------------------------------------
 
-  class dmap : public std::map<fuse_ino_t, shared_data>, public XrdSysMutex
+  class dmap : public ShardedMap<fuse_ino_t, shared_data>
   //----------------------------------------------------------------------------
   {
   public:
@@ -330,12 +407,19 @@ public:
 
     void run()
     {
+      if (cachehandler::instance().journaled()) {
+        uploader.run(cachehandler::instance().get_config().write_back_threads,
+                     cachehandler::instance().get_config().write_back_bandwidth);
+      }
+
       tIOFlush.reset(&dmap::ioflush, this);
     }
 
     void ioflush(ThreadAssistant&
                  assistant); // thread for delayed asynchronous close
 
+    writeback uploader; // journal upload threads in write-back mode
+
   private:
     AssistedThread tIOFlush;
   };
@@ -364,10 +448,19 @@ public:
 
   void invalidate_cache(fuse_ino_t ino);
 
+  void replay();
+
+  // url to replay the journal of a remote file with the login of its writer
+  static std::string replay_url(const journalcache::remote_t& remote);
+
+  void writeback_stats(writeback::stats_t& stats)
+  {
+    datamap.uploader.get_stats(stats);
+  }
+
   size_t size()
   {
-    XrdSysMutexHelper mLock(datamap);
-    return datamap.size();
+    return datamap.sizeTS();
   }
 
 
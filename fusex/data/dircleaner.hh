@@ -120,6 +120,11 @@ public:
     return externaltreeinfo;
   }
 
+  tree_info_t& get_tree()
+  {
+    return treeinfo;
+  }
+
   void set_trim_suffix(const std::string& sfx)
   {
     trim_suffix = sfx;
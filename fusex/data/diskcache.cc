@@ -28,6 +28,8 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <algorithm>
 #ifdef __APPLE__
 #define EKEYEXPIRED 127
 #include "XrdSys/XrdSysPlatform.hh"
@@ -39,7 +41,11 @@ bufferllmanager diskcache::sBufferManager;
 off_t diskcache::sMaxSize = 2 * 1024 * 1024ll;
 float diskcache::sCleanThreshold = 85.0;
 
+const size_t diskcache::sBlockSize = 256 * 1024;
+std::shared_timed_mutex diskcache::sInodeLock[diskcache::sInodeLocks];
+
 shared_ptr<dircleaner> diskcache::sDirCleaner;
+shared_ptr<blockindex> diskcache::sBlockIndex;
 
 /* -------------------------------------------------------------------------- */
 int
@@ -74,25 +80,44 @@ diskcache::init_daemonized(const cacheconfig& config)
     diskcache::sMaxSize = config.per_file_cache_max_size;
   }
 
+  // the cache size is kept by the block index, the dircleaner only takes
+  // care of the number of files and of a filling partition
   sDirCleaner = std::make_shared<dircleaner>(config.location,
-		config.total_file_cache_size,
+		0,
 		config.total_file_cache_inodes
 					    );
   sDirCleaner->set_trim_suffix(".dc");
+  sBlockIndex = std::make_shared<blockindex>(sBlockSize,
+		config.total_file_cache_size,
+		&diskcache::evict);
+  std::string indexpath = config.location + "/.blockindex";
 
   if (config.clean_on_startup) {
     eos_static_info("cleaning cache path=%s", config.location.c_str());
     sDirCleaner = std::make_shared<dircleaner>(config.location,
-		  config.total_file_cache_size,
+		  0,
 		  config.total_file_cache_inodes);
 
     if (sDirCleaner->cleanall(".dc")) {
       eos_static_err("cache cleanup failed");
       return -1;
     }
+
+    ::unlink(indexpath.c_str());
+  } else {
+    int rc = sBlockIndex->load(indexpath, &diskcache::validate);
+
+    if (rc) {
+      eos_static_warning("unable to load block index path=%s errno=%d - starting with an empty cache",
+			 indexpath.c_str(), rc);
+    }
+
+    // drop the blocks exceeding the cache size
+    sBlockIndex->evict();
   }
 
-  // start the disk cache leveling thread;
+  // start the block index saving thread
+  sBlockIndex->run(indexpath, 60);
   return 0;
 }
 
@@ -115,6 +140,14 @@ diskcache::~diskcache()
 int
 diskcache::location(std::string& path, bool mkpath)
 /* -------------------------------------------------------------------------- */
+{
+  return location(ino, path, mkpath);
+}
+
+/* -------------------------------------------------------------------------- */
+int
+diskcache::location(fuse_ino_t ino, std::string& path, bool mkpath)
+/* -------------------------------------------------------------------------- */
 {
   char cache_path[1024 + 20];
   snprintf(cache_path, sizeof(cache_path), "%s/%08lx/%08lX.dc",
@@ -152,6 +185,8 @@ diskcache::attach(fuse_req_t req, std::string& acookie, int flag)
     if (stat(path.c_str(), &attachstat)) {
       // a new file
       sDirCleaner->get_external_tree().change(0, 1);
+      // blocks of a cleaned up file are gone
+      sBlockIndex->truncate(ino, 0);
     }
 
     // need to open the file
@@ -238,6 +273,7 @@ diskcache::unlink()
       if (!rc) {
 	// a deleted file
 	sDirCleaner->get_external_tree().change(-buf.st_size, -1);
+	sBlockIndex->truncate(ino, 0);
       }
     }
   }
@@ -262,6 +298,15 @@ diskcache::pread(void* buf, size_t count, off_t offset)
     count = sMaxSize - offset;
   }
 
+  // read only the blocks which are resident, they can't be evicted before
+  // the read finished
+  std::shared_lock<std::shared_timed_mutex> iLock(inode_lock(ino));
+  count = sBlockIndex->lookup(ino, offset, count);
+
+  if (!count) {
+    return 0;
+  }
+
   return ::pread(fd, buf, count, offset);
 }
 
@@ -280,7 +325,27 @@ diskcache::pwrite(const void* buf, size_t count, off_t offset)
     count = sMaxSize - offset;
   }
 
-  return ::pwrite(fd, buf, count, offset);
+  ssize_t nwrite = 0;
+  {
+    std::shared_lock<std::shared_timed_mutex> iLock(inode_lock(ino));
+    struct stat st;
+
+    if (fstat(fd, &st)) {
+      return -1;
+    }
+
+    off_t eof = std::max((off_t) st.st_size, (off_t)(offset + count));
+    // blocks being overwritten must not be evicted and marked resident after
+    sBlockIndex->forget(ino, offset, count, eof);
+    nwrite = ::pwrite(fd, buf, count, offset);
+
+    if (nwrite == (ssize_t) count) {
+      sBlockIndex->insert(ino, offset, count, eof);
+    }
+  }
+  // drop the blocks removed to make space, this takes the lock of their inode
+  sBlockIndex->evict();
+  return nwrite;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -307,6 +372,7 @@ diskcache::truncate(off_t offset)
     sDirCleaner->get_external_tree().change(detachstat.st_size - attachstat.st_size,
 					    0);
     attachstat.st_size = offset;
+    sBlockIndex->truncate(ino, offset);
   }
 
   return rc;
@@ -335,7 +401,8 @@ diskcache::size()
       throw std::runtime_error("diskcache stat failure");
     }
 
-    return buf.st_size;
+    // the cached file start ends at the first evicted block
+    return std::min((off_t) buf.st_size, sBlockIndex->prefix(ino));
   } else {
     return 0;
   }
@@ -407,6 +474,7 @@ diskcache::rescue(std::string& rescue_location)
   }
 
   if (!rc) {
+    sBlockIndex->truncate(ino, 0);
     return ::rename(path.c_str(), rescue_location.c_str());
   } else {
     return rc;
@@ -425,3 +493,100 @@ diskcache::recovery_location(std::string& recovery_location)
   recovery_location + ".download";
   return rc;
 }
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+diskcache::evict(fuse_ino_t ino, off_t offset, size_t size)
+/* -------------------------------------------------------------------------- */
+{
+  // no read of the inode is in flight while the hole is punched and a block
+  // written again after its eviction keeps its data
+  std::unique_lock<std::shared_timed_mutex> iLock(inode_lock(ino));
+
+  if (sBlockIndex->resident(ino, offset / sBlockSize)) {
+    return;
+  }
+
+  std::string path;
+
+  if (location(ino, path, false)) {
+    return;
+  }
+
+  int efd = ::open(path.c_str(), O_WRONLY);
+
+  if (efd < 0) {
+    return;
+  }
+
+#ifndef __APPLE__
+
+  // free the space of the block, the file keeps its size
+  if (fallocate(efd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, size)) {
+    eos_static_err("failed to evict block path=%s offset=%lu errno=%d",
+		   path.c_str(), offset, errno);
+  }
+
+#endif
+  ::close(efd);
+}
+
+/* -------------------------------------------------------------------------- */
+std::shared_timed_mutex&
+/* -------------------------------------------------------------------------- */
+diskcache::inode_lock(fuse_ino_t ino)
+/* -------------------------------------------------------------------------- */
+{
+  return sInodeLock[ino % sInodeLocks];
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+diskcache::validate(fuse_ino_t ino, std::set<uint64_t>& blocks)
+/* -------------------------------------------------------------------------- */
+{
+  std::string path;
+  struct stat buf;
+  int vfd = -1;
+
+  if (location(ino, path, false) || ::stat(path.c_str(), &buf) ||
+      ((vfd = ::open(path.c_str(), O_RDONLY)) < 0)) {
+    blocks.clear();
+    return;
+  }
+
+  for (auto it = blocks.begin(); it != blocks.end();) {
+    off_t offset = *it * sBlockSize;
+    off_t end = std::min((off_t)(offset + sBlockSize), (off_t) buf.st_size);
+    bool valid = (offset < buf.st_size);
+#ifdef SEEK_HOLE
+
+    // a block evicted after the index was saved is a hole in the file
+    if (valid) {
+      valid = (::lseek(vfd, offset, SEEK_HOLE) >= end);
+    }
+
+#endif
+
+    if (valid) {
+      ++it;
+    } else {
+      it = blocks.erase(it);
+    }
+  }
+
+  ::close(vfd);
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+diskcache::get_stats(blockindex::stats_t& stats)
+/* -------------------------------------------------------------------------- */
+{
+  if (sBlockIndex) {
+    sBlockIndex->get_stats(stats);
+  }
+}
@@ -31,9 +31,11 @@
 #include "bufferll.hh"
 #include "data/cache.hh"
 #include "data/dircleaner.hh"
+#include "data/blockindex.hh"
 #include "data/cacheconfig.hh"
 #include "XrdSys/XrdSysPthread.hh"
 #include <map>
+#include <shared_mutex>
 #include <string>
 
 class diskcache : public cache
@@ -70,9 +72,24 @@ public:
     return sMaxSize;
   }
 
+  static void get_stats(blockindex::stats_t& stats);
+
 private:
   XrdSysMutex mMutex;
   int location(std::string& path, bool mkpath = true);
+  static int location(fuse_ino_t ino, std::string& path, bool mkpath);
+
+  // blockindex callbacks
+  static void evict(fuse_ino_t ino, off_t offset, size_t size);
+  static void validate(fuse_ino_t ino, std::set<uint64_t>& blocks);
+
+  // serializes the eviction of the blocks of an inode with its readers and
+  // writers, which take the lock shared
+  static std::shared_timed_mutex& inode_lock(fuse_ino_t ino);
+
+  static const size_t sBlockSize;
+  static const size_t sInodeLocks = 256;
+  static std::shared_timed_mutex sInodeLock[sInodeLocks];
   static off_t sMaxSize;
   static float sCleanThreshold;
 
@@ -90,6 +107,8 @@ private:
 
   static shared_ptr<dircleaner> sDirCleaner;
 
+  static shared_ptr<blockindex> sBlockIndex;
+
 };
 
 #endif /* FUSE_JOURNALCACHE_HH_ */
@@ -30,13 +30,15 @@
 #include "XrdSys/XrdSysPlatform.hh"
 #endif
 #include <algorithm>
+#include <fstream>
 #include <iostream>
 
 std::string journalcache::sLocation;
 size_t journalcache::sMaxSize = 128 * 1024 * 1024ll; // TODO Some dummy default
 
 journalcache::journalcache(fuse_ino_t ino) : ino(ino), cachesize(0),
-  truncatesize(-1), fd(-1), nbAttached(0), nbFlushed(0)
+  truncatesize(-1), fd(-1), nbAttached(0), nbFlushed(0), syncing(false),
+  syncsize(0)
 {
 }
 
@@ -95,6 +97,9 @@ int journalcache::read_journal()
     do {
       if (entrySize == 0) {
         header_t* header = reinterpret_cast<header_t*>(buffer + pos);
+        // entries appended while the journal was uploaded supersede the
+        // older entries they overlap
+        supersede(header->offset, header->offset + header->size);
         journal.insert(header->offset, header->offset + header->size,
                        totalBytesRead + pos);
         entrySize = header->size;
@@ -116,6 +121,34 @@ int journalcache::read_journal()
   return totalBytesRead;
 }
 
+void journalcache::supersede(uint64_t low, uint64_t high)
+{
+  struct entry_t {
+    uint64_t low;
+    uint64_t high;
+    uint64_t value;
+  };
+  std::vector<entry_t> entries;
+
+  for (auto& itr : journal.query(low, high)) {
+    entries.push_back({itr->low, itr->high, itr->value});
+  }
+
+  for (auto& e : entries) {
+    journal.erase(e.low, e.high);
+
+    if (e.low < low) {
+      journal.insert(e.low, low, e.value);
+    }
+
+    if (e.high > high) {
+      // the value is shifted like the data, offsets are computed relative to
+      // the start of an entry
+      journal.insert(high, e.high, e.value + (high - e.low));
+    }
+  }
+}
+
 int journalcache::attach(fuse_req_t req, std::string& cookie, int flags)
 {
   XrdSysMutexHelper lck(mtx);
@@ -157,6 +190,7 @@ int journalcache::unlink()
     rc = ::unlink(path.c_str());
   }
 
+  uncommit();
   return rc;
 }
 
@@ -171,6 +205,7 @@ int journalcache::rescue(std::string& rescue_location)
   }
 
   if (!rc) {
+    uncommit();
     return ::rename(path.c_str(), rescue_location.c_str());
   } else {
     return rc;
@@ -308,16 +343,24 @@ ssize_t journalcache::pwrite(const void* buf, size_t count, off_t offset)
   interval_tree<uint64_t, const void*> to_write;
   std::vector<chunk_t> updates;
   to_write.insert(offset, offset + count, buf);
-  auto res = journal.query(offset, offset + count);
+  int rc = 0;
 
-  for (auto itr : res) {
-    process_intersection(to_write, itr, updates);
-  }
+  if (syncing) {
+    // the entries being uploaded must not be updated in place, the write is
+    // appended and supersedes them
+    supersede(offset, offset + count);
+  } else {
+    auto res = journal.query(offset, offset + count);
 
-  int rc = update_cache(updates);
+    for (auto itr : res) {
+      process_intersection(to_write, itr, updates);
+    }
 
-  if (rc) {
-    return -1;
+    rc = update_cache(updates);
+
+    if (rc) {
+      return -1;
+    }
   }
 
   interval_tree<uint64_t, const void*>::iterator itr;
@@ -360,6 +403,11 @@ int journalcache::truncate(off_t offset, bool invalidate)
   int rc = 0;
   write_lock lck(clck);
 
+  while (!offset && syncing) {
+    // the journal file is read by the upload
+    clck.write_wait();
+  }
+
   if (offset) {
     truncatesize = offset;
   } else {
@@ -406,6 +454,12 @@ int journalcache::init(const cacheconfig& config)
 
 int journalcache::init_daemonized(const cacheconfig& config)
 {
+  // this has to happen before the cleaning, which would remove the journals
+  if (prepare_replay()) {
+    eos_static_err("failed to prepare the journal replay path=%s",
+                   config.journal.c_str());
+  }
+
   if (config.clean_on_startup) {
     eos_static_info("cleaning cache path=%s", config.journal.c_str());
     dircleaner dc(config.journal.c_str());
@@ -421,14 +475,56 @@ int journalcache::init_daemonized(const cacheconfig& config)
 
 int journalcache::remote_sync(cachesyncer& syncer)
 {
+  interval_tree<uint64_t, uint64_t> snapshot;
+  ssize_t synctruncatesize;
+  {
+    write_lock lck(clck);
+
+    while (syncing) {
+      clck.write_wait();
+    }
+
+    for (auto itr = journal.begin(); itr != journal.end(); ++itr) {
+      snapshot.insert(itr->low, itr->high, itr->value);
+    }
+
+    synctruncatesize = truncatesize;
+    syncsize = cachesize;
+    syncing = true;
+  }
+  // reads and writes go on while the snapshot is uploaded
+  int ret = syncer.sync(fd, snapshot, sizeof(header_t), synctruncatesize);
   write_lock lck(clck);
-  int ret = syncer.sync(fd, journal, sizeof(header_t), truncatesize);
+  syncing = false;
 
   if (!ret) {
-    journal.clear();
-    eos_static_debug("ret=%d truncatesize=%ld\n", ret, truncatesize);
-    ret |= ::ftruncate(fd, 0);
-    eos_static_debug("ret=%d errno=%d\n", ret, errno);
+    // drop what has been uploaded, the entries appended meanwhile are kept
+    std::vector<std::pair<uint64_t, uint64_t> > synced;
+
+    for (auto itr = journal.begin(); itr != journal.end(); ++itr) {
+      if (itr->value < syncsize) {
+        synced.push_back(std::make_pair(itr->low, itr->high));
+      }
+    }
+
+    for (auto& range : synced) {
+      journal.erase(range.first, range.second);
+    }
+
+    if (truncatesize == synctruncatesize) {
+      truncatesize = -1;
+    }
+
+    if (!journal.size()) {
+      eos_static_debug("ret=%d truncatesize=%ld\n", ret, truncatesize);
+      ret |= ::ftruncate(fd, 0);
+      eos_static_debug("ret=%d errno=%d\n", ret, errno);
+      cachesize = 0;
+
+      if (truncatesize == -1) {
+        uncommit();
+      }
+    }
   }
 
   clck.broadcast();
@@ -447,6 +543,10 @@ int journalcache::remote_sync_async(XrdCl::Proxy* proxy)
   off_t offshift = sizeof(header_t);
   write_lock lck(clck);
 
+  while (syncing) {
+    clck.write_wait();
+  }
+
   for (auto itr = journal.begin(); itr != journal.end(); ++itr) {
     off_t cacheoff = itr->value + offshift;
     size_t size = itr->high - itr->low;
@@ -492,17 +592,249 @@ int journalcache::remote_sync_async(XrdCl::Proxy* proxy)
   errno = 0;
   ret |= ::ftruncate(fd, 0);
   eos_static_debug("ret=%d errno=%d\n", ret, errno);
+  cachesize = 0;
+  uncommit();
   clck.broadcast();
   return ret;
 }
 
+int journalcache::commit(const remote_t& remote)
+{
+  write_lock lck(clck);
+
+  if (!cachesize && (truncatesize == -1)) {
+    return 0;
+  }
+
+  if (::fdatasync(fd)) {
+    return errno;
+  }
+
+  // the path is the last line, it can contain blanks
+  char header[128];
+  snprintf(header, sizeof(header), "%ld\n%lx\n%u %u\n", truncatesize,
+           remote.ino, remote.uid, remote.gid);
+  std::string manifest = header;
+  manifest += remote.path;
+  manifest += "\n";
+
+  if (manifest == committed) {
+    // nothing changed since the last commit
+    return 0;
+  }
+
+  std::string path;
+  int rc = location(path, false);
+
+  if (rc) {
+    return rc;
+  }
+
+  path += ".wb";
+  std::string tmppath = path + ".tmp";
+  int mfd = ::open(tmppath.c_str(), O_CREAT | O_TRUNC | O_WRONLY, S_IRWXU);
+
+  if (mfd < 0) {
+    return errno;
+  }
+
+  errno = 0;
+
+  if ((::write(mfd, manifest.c_str(), manifest.length()) !=
+       (ssize_t) manifest.length()) || ::fsync(mfd)) {
+    rc = errno ? errno : EIO;
+  }
+
+  ::close(mfd);
+
+  if (!rc && ::rename(tmppath.c_str(), path.c_str())) {
+    rc = errno;
+  }
+
+  if (rc) {
+    ::unlink(tmppath.c_str());
+    return rc;
+  }
+
+  // make the rename itself durable
+  int dfd = ::open(path.substr(0, path.rfind('/')).c_str(), O_RDONLY);
+
+  if (dfd >= 0) {
+    ::fsync(dfd);
+    ::close(dfd);
+  }
+
+  committed = manifest;
+  return 0;
+}
+
+void journalcache::uncommit()
+{
+  if (committed.empty()) {
+    return;
+  }
+
+  std::string path;
+
+  if (!location(path, false)) {
+    path += ".wb";
+    ::unlink(path.c_str());
+  }
+
+  committed.clear();
+}
+
+int journalcache::prepare_replay()
+{
+  // a journal with manifest is hard-linked to a name which is unique to this
+  // run before the manifest is moved, a crash in between leaves an orphan
+  // link behind, which is removed in the end
+  dircleaner dc(sLocation);
+
+  if (dc.scanall(".jc.wb")) {
+    return -1;
+  }
+
+  time_t now = time(NULL);
+
+  for (auto& it : dc.get_tree().treemap) {
+    const std::string& manifest = it.second.path;
+    std::string path = manifest.substr(0, manifest.length() - 3);
+    char replay[1024 + 64];
+    snprintf(replay, sizeof(replay), "%s.%lu.replay", path.c_str(), now);
+
+    if (::link(path.c_str(), replay)) {
+      eos_static_warning("dropping journal manifest path=%s errno=%d",
+                         manifest.c_str(), errno);
+      ::unlink(manifest.c_str());
+      continue;
+    }
+
+    std::string replay_manifest = replay;
+    replay_manifest += ".wb";
+
+    if (::rename(manifest.c_str(), replay_manifest.c_str())) {
+      eos_static_err("failed to move journal manifest path=%s errno=%d",
+                     manifest.c_str(), errno);
+      ::unlink(replay);
+      continue;
+    }
+
+    ::unlink(path.c_str());
+  }
+
+  if (dc.scanall(".replay")) {
+    return -1;
+  }
+
+  for (auto& it : dc.get_tree().treemap) {
+    std::string manifest = it.second.path + ".wb";
+
+    if (::access(manifest.c_str(), F_OK) && (errno == ENOENT)) {
+      ::unlink(it.second.path.c_str());
+    }
+  }
+
+  return 0;
+}
+
+void journalcache::replays(std::vector<std::string>& manifests)
+{
+  dircleaner dc(sLocation);
+
+  if (dc.scanall(".replay.wb")) {
+    eos_static_err("failed to scan journal manifests path=%s", sLocation.c_str());
+  }
+
+  // oldest first
+  for (auto& it : dc.get_tree().treemap) {
+    manifests.push_back(it.second.path);
+  }
+}
+
+int journalcache::replay(const std::string& manifest, url_t url_of,
+                         cachesyncer::throttle_t throttle)
+{
+  std::string path = manifest.substr(0, manifest.length() - 3);
+  std::ifstream in(manifest.c_str());
+  ssize_t truncatesize = -1;
+  remote_t remote;
+
+  if (!(in >> truncatesize >> std::hex >> remote.ino >> std::dec >> remote.uid
+        >> remote.gid) || !in.ignore() || !std::getline(in, remote.path) ||
+      (!remote.ino && remote.path.empty())) {
+    eos_static_err("invalid journal manifest path=%s", manifest.c_str());
+    return EINVAL;
+  }
+
+  std::string url = url_of(remote);
+
+  journalcache jc(0);
+  jc.fd = ::open(path.c_str(), O_RDWR);
+
+  if (jc.fd < 0) {
+    if (errno == ENOENT) {
+      ::unlink(manifest.c_str());
+      return 0;
+    }
+
+    return errno;
+  }
+
+  jc.cachesize = jc.read_journal();
+  jc.truncatesize = truncatesize;
+  int rc = 0;
+  XrdCl::File file;
+  XrdCl::XRootDStatus st = file.Open(url, XrdCl::OpenFlags::Update,
+                                     XrdCl::Access::UR | XrdCl::Access::UW | XrdCl::Access::UX);
+
+  if (!st.IsOK()) {
+    eos_static_err("failed to open journal replay target path=%s msg=\"%s\"",
+                   path.c_str(), st.ToString().c_str());
+    rc = EREMOTEIO;
+  } else {
+    cachesyncer cachesync(file, throttle);
+
+    if (cachesync.sync(jc.fd, jc.journal, sizeof(header_t), jc.truncatesize)) {
+      rc = EREMOTEIO;
+    }
+
+    st = file.Close();
+
+    if (!st.IsOK()) {
+      rc = EREMOTEIO;
+    }
+  }
+
+  ::close(jc.fd);
+  jc.fd = -1;
+
+  if (rc) {
+    eos_static_crit("journal replay failed path=%s - kept for the next start",
+                    path.c_str());
+    return rc;
+  }
+
+  eos_static_notice("replayed journal path=%s size=%lu", path.c_str(),
+                    jc.cachesize);
+  ::unlink(path.c_str());
+  ::unlink(manifest.c_str());
+  return 0;
+}
+
 int journalcache::reset()
 {
   write_lock lck(clck);
+
+  while (syncing) {
+    clck.write_wait();
+  }
+
   journal.clear();
   int retc = ::ftruncate(fd, 0);
   cachesize = 0;
   truncatesize = -1;
+  uncommit();
   clck.broadcast();
   return retc;
 }
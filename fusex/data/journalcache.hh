@@ -34,8 +34,10 @@
 #include "interval_tree.hh"
 
 #include <stdint.h>
+#include <functional>
 
 #include <string>
+#include <vector>
 
 class journalcache
 {
@@ -97,10 +99,42 @@ public:
     return 0;
   }
 
+  // upload a snapshot of the journal without holding the journal lock, the
+  // writes done meanwhile stay in the journal
   int remote_sync(cachesyncer& syncer);
 
   int remote_sync_async(XrdCl::Proxy* proxy);
 
+  // remote file of a journal as recorded in its manifest - the url is built
+  // again at replay time with the login of the replaying process
+  struct remote_t {
+    uint64_t ino; // remote inode, 0 if not yet known
+    std::string path; // resolved remote path
+    uid_t uid;
+    gid_t gid;
+  };
+
+  typedef std::function<std::string(const remote_t& remote)> url_t;
+
+  // write-back: make the journal durable and record the remote file and the
+  // truncation size in a manifest next to it, so that it can be replayed
+  // after a crash - the manifest is removed once the journal is synced
+  int commit(const remote_t& remote);
+
+  // true if the journal holds writes or a truncation to be synced
+  bool pending()
+  {
+    read_lock lck(clck);
+    return (cachesize || (truncatesize != -1));
+  }
+
+  // list the manifests of the journals left by a previous run
+  static void replays(std::vector<std::string>& manifests);
+
+  // upload a journal left by a previous run and remove it on success
+  static int replay(const std::string& manifest, url_t url,
+                    cachesyncer::throttle_t throttle);
+
   static int init(const cacheconfig& config);
   static int init_daemonized(const cacheconfig& config);
 
@@ -148,6 +182,15 @@ private:
 
   int read_journal();
 
+  // drop the range [low, high) from the journal, the entries overlapping it
+  // are cut - their data stays where it is in the journal file
+  void supersede(uint64_t low, uint64_t high);
+
+  void uncommit();
+
+  // move the journals with a manifest out of the way of new inodes
+  static int prepare_replay();
+
   fuse_ino_t ino;
   size_t cachesize;
   ssize_t truncatesize;
@@ -159,6 +202,11 @@ private:
   cachelock clck;
   XrdSysMutex mtx;
   bufferllmanager::shared_buffer buffer;
+  std::string committed; // manifest contents of the last commit
+  // a snapshot of the journal is being uploaded, the journal file below
+  // syncsize must not change until the upload finished
+  bool syncing;
+  size_t syncsize;
   static std::string sLocation;
   static size_t sMaxSize;
 };
@@ -0,0 +1,174 @@
+//------------------------------------------------------------------------------
+//! @file writeback.cc
+//! @brief pool of threads uploading closed file journals in the background
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "writeback.hh"
+#include <thread>
+
+/* -------------------------------------------------------------------------- */
+writeback::writeback() : mSeq(0), mBandwidth(0)
+/* -------------------------------------------------------------------------- */
+{
+}
+
+/* -------------------------------------------------------------------------- */
+writeback::~writeback()
+/* -------------------------------------------------------------------------- */
+{
+  // queued uploads are dropped, their journals are replayed after a restart
+  for (auto& th : mThreads) {
+    th->stop();
+  }
+
+  mCond.Broadcast();
+  mThreads.clear();
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+writeback::run(size_t nthreads, uint64_t bandwidth)
+/* -------------------------------------------------------------------------- */
+{
+  mBandwidth = bandwidth;
+  mNextSend = clock_t::now();
+
+  for (size_t i = 0; i < nthreads; ++i) {
+    mThreads.emplace_back(new AssistedThread(&writeback::upload, this));
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+writeback::schedule(uint64_t bytes, upload_t upload)
+/* -------------------------------------------------------------------------- */
+{
+  XrdSysCondVarHelper lLock(mCond);
+  job_t job;
+  job.seq = ++mSeq;
+  job.bytes = bytes;
+  job.upload = upload;
+  mPending[job.seq] = std::make_pair(clock_t::now(), bytes);
+  mQueue.push_back(job);
+  mCond.Signal();
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+writeback::drain()
+/* -------------------------------------------------------------------------- */
+{
+  XrdSysCondVarHelper lLock(mCond);
+
+  while (mPending.size() && mThreads.size()) {
+    mCond.WaitMS(100);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+writeback::throttle(size_t bytes)
+/* -------------------------------------------------------------------------- */
+{
+  if (!mBandwidth) {
+    return;
+  }
+
+  clock_t::time_point until;
+  {
+    std::lock_guard<std::mutex> lock(mThrottleMutex);
+    clock_t::time_point now = clock_t::now();
+
+    // don't accumulate more than one second of unused bandwidth
+    if (mNextSend < (now - std::chrono::seconds(1))) {
+      mNextSend = now - std::chrono::seconds(1);
+    }
+
+    mNextSend += std::chrono::nanoseconds((uint64_t)(1e9 * bytes / mBandwidth));
+    until = mNextSend;
+  }
+  std::this_thread::sleep_until(until);
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+writeback::get_stats(stats_t& stats)
+/* -------------------------------------------------------------------------- */
+{
+  XrdSysCondVarHelper lLock(mCond);
+  stats = mStats;
+  stats.backlog_files = mPending.size();
+  stats.backlog_bytes = 0;
+  stats.backlog_age = 0;
+
+  for (auto it = mPending.begin(); it != mPending.end(); ++it) {
+    stats.backlog_bytes += it->second.second;
+  }
+
+  if (mPending.size()) {
+    stats.backlog_age = std::chrono::duration<double>(clock_t::now() -
+                        mPending.begin()->second.first).count();
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+writeback::upload(ThreadAssistant& assistant)
+/* -------------------------------------------------------------------------- */
+{
+  while (!assistant.terminationRequested()) {
+    job_t job;
+    {
+      XrdSysCondVarHelper lLock(mCond);
+
+      while (mQueue.empty() && !assistant.terminationRequested()) {
+        mCond.WaitMS(250);
+      }
+
+      if (mQueue.empty()) {
+        break;
+      }
+
+      job = mQueue.front();
+      mQueue.pop_front();
+    }
+    int rc = job.upload();
+    {
+      XrdSysCondVarHelper lLock(mCond);
+      mPending.erase(job.seq);
+
+      if (rc) {
+        mStats.failed++;
+      } else {
+        mStats.uploaded_files++;
+        mStats.uploaded_bytes += job.bytes;
+      }
+
+      mCond.Broadcast();
+    }
+  }
+}
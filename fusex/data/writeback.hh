@@ -0,0 +1,130 @@
+//------------------------------------------------------------------------------
+//! @file writeback.hh
+//! @brief pool of threads uploading closed file journals in the background
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef FUSE_WRITEBACK_HH_
+#define FUSE_WRITEBACK_HH_
+
+#include "common/AssistedThread.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//! In write-back mode a close returns once the journal of a file is durable on
+//! the local disk. The journals are then uploaded to the FSTs by this pool of
+//! threads. All uploads share a single bandwidth limit.
+//------------------------------------------------------------------------------
+
+class writeback
+{
+public:
+
+  //! upload function, returns 0 on success
+  typedef std::function<int()> upload_t;
+
+  typedef struct stats {
+
+    stats() : backlog_files(0), backlog_bytes(0), backlog_age(0),
+      uploaded_files(0), uploaded_bytes(0), failed(0) { }
+
+    size_t backlog_files; // journals queued or being uploaded
+    uint64_t backlog_bytes; // size of the journals queued or being uploaded
+    double backlog_age; // seconds since the oldest journal was queued
+    uint64_t uploaded_files; // journals uploaded since startup
+    uint64_t uploaded_bytes; // journal bytes uploaded since startup
+    uint64_t failed; // failed uploads since startup
+  } stats_t;
+
+  writeback();
+
+  virtual ~writeback();
+
+  //----------------------------------------------------------------------------
+  //! Start the upload threads
+  //!
+  //! @param nthreads number of upload threads
+  //! @param bandwidth upload bandwidth limit in bytes/s, 0 for unlimited
+  //----------------------------------------------------------------------------
+  void run(size_t nthreads, uint64_t bandwidth);
+
+  //----------------------------------------------------------------------------
+  //! Queue an upload
+  //!
+  //! @param bytes size of the journal to upload
+  //! @param upload function doing the upload
+  //----------------------------------------------------------------------------
+  void schedule(uint64_t bytes, upload_t upload);
+
+  //----------------------------------------------------------------------------
+  //! Wait until all the queued uploads are done
+  //----------------------------------------------------------------------------
+  void drain();
+
+  //----------------------------------------------------------------------------
+  //! Block until the given number of bytes may be sent without exceeding the
+  //! bandwidth limit. Up to one second worth of bandwidth can be sent at once
+  //! after an idle period.
+  //----------------------------------------------------------------------------
+  void throttle(size_t bytes);
+
+  //----------------------------------------------------------------------------
+  //! Get the backlog and upload counters
+  //----------------------------------------------------------------------------
+  void get_stats(stats_t& stats);
+
+  uint64_t bandwidth() const
+  {
+    return mBandwidth;
+  }
+
+private:
+  typedef std::chrono::steady_clock clock_t;
+
+  struct job_t {
+    uint64_t seq;
+    uint64_t bytes;
+    upload_t upload;
+  };
+
+  void upload(ThreadAssistant& assistant);
+
+  XrdSysCondVar mCond;
+  std::deque<job_t> mQueue;
+  // queue time and size of the queued and running uploads by sequence number
+  std::map<uint64_t, std::pair<clock_t::time_point, uint64_t> > mPending;
+  uint64_t mSeq;
+  stats_t mStats;
+
+  std::mutex mThrottleMutex;
+  clock_t::time_point mNextSend;
+  uint64_t mBandwidth;
+
+  std::vector<std::unique_ptr<AssistedThread> > mThreads;
+};
+
+#endif /* FUSE_WRITEBACK_HH_ */
@@ -34,10 +34,67 @@ XrdCl::Proxy::chunk_vector XrdCl::Proxy::sTimeoutWriteAsyncChunks;
 XrdCl::Proxy::chunk_rvector XrdCl::Proxy::sTimeoutReadAsyncChunks;
 XrdSysMutex XrdCl::Proxy::sTimeoutAsyncChunksMutex;
 ssize_t XrdCl::Proxy::sChunkTimeout = 300;
+size_t XrdCl::Proxy::sParallelStreams = 1;
+XrdSysMutex XrdCl::Proxy::sMgmChannelMutex;
+std::map<std::string, std::unique_ptr<XrdCl::FileSystem>>
+    XrdCl::Proxy::sMgmChannels;
+std::atomic<uint64_t> XrdCl::Proxy::sReadBytes(0);
+std::atomic<uint64_t> XrdCl::Proxy::sWriteBytes(0);
 
 XrdCl::BufferManager XrdCl::Proxy::sWrBufferManager;
 XrdCl::BufferManager XrdCl::Proxy::sRaBufferManager;
 
+namespace
+{
+// drops the reply of the ping creating an MGM channel
+class DiscardHandler : public XrdCl::ResponseHandler
+{
+public:
+  void HandleResponse(XrdCl::XRootDStatus* status,
+                      XrdCl::AnyObject* response) override
+  {
+    delete status;
+    delete response;
+    delete this;
+  }
+};
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+XrdCl::Proxy::mgm_channel(const XrdCl::URL& url)
+/* -------------------------------------------------------------------------- */
+{
+  if (sParallelStreams <= 1) {
+    return;
+  }
+
+  std::string channel = url.GetHostId();
+  XrdSysMutexHelper lLock(sMgmChannelMutex);
+
+  if (sMgmChannels.count(channel)) {
+    return;
+  }
+
+  // sending the ping creates the channel, the reply is not needed. A data
+  // server channel created by XrdCl in the meantime gets a single stream too.
+  XrdCl::URL channel_url(url.GetURL());
+  channel_url.SetPath("/");
+  channel_url.SetParams("");
+  XrdCl::FileSystem* fs = new XrdCl::FileSystem(channel_url);
+  sMgmChannels[channel].reset(fs);
+  XrdCl::DefaultEnv::GetEnv()->PutInt("SubStreamsPerChannel", 1);
+  DiscardHandler* handler = new DiscardHandler();
+
+  if (!fs->Ping(handler, 0).IsOK()) {
+    delete handler;
+  }
+
+  XrdCl::DefaultEnv::GetEnv()->PutInt("SubStreamsPerChannel", sParallelStreams);
+  eos_static_info("channel=%s streams=1", channel.c_str());
+}
+
 /* -------------------------------------------------------------------------- */
 XRootDStatus
 /* -------------------------------------------------------------------------- */
@@ -324,6 +381,7 @@ XrdCl::Proxy::Read(uint64_t offset,
   if (status.IsOK()) {
     mPosition = offset + size;
     mTotalBytes += bytesRead;
+    sReadBytes += bytesRead;
   }
 
   return status;
@@ -853,6 +911,9 @@ XrdCl::Proxy::WriteAsync(uint64_t offset,
     // remove failing requests
     XrdSysCondVarHelper lLock(WriteCondVar());
     ChunkMap().erase((uint64_t) handler.get());
+  } else {
+    mTotalWriteBytes += size;
+    sWriteBytes += size;
   }
 
   return status;
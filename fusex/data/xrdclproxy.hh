@@ -32,6 +32,7 @@
 #include "llfusexx.hh"
 #include "common/Logging.hh"
 
+#include <algorithm>
 #include <memory>
 #include <map>
 #include <string>
@@ -494,9 +495,10 @@ public:
     XReadAheadMin = min;
     XReadAheadNom = nom;
     XReadAheadMax = max;
-    XReadAheadBlocksMax = rablocks;
-    XReadAheadBlocksNom = 1;
-    XReadAheadBlocksMin = 1;
+    XReadAheadBlocksMax = rablocks ? rablocks : 1;
+    // keep at least one block in flight per parallel stream
+    XReadAheadBlocksMin = std::min(sParallelStreams, XReadAheadBlocksMax);
+    XReadAheadBlocksNom = XReadAheadBlocksMin;
     XReadAheadReenableHits = 0;
   }
 
@@ -506,6 +508,25 @@ public:
     return (mTotalBytes) ? (100.0 * mTotalReadAheadHitBytes / mTotalBytes) : 0.0;
   }
 
+  // bytes/s read through this file handle since it was created
+  double get_read_rate()
+  {
+    double age = handle_age();
+    return age ? (mTotalBytes / age) : 0;
+  }
+
+  // bytes/s written through this file handle since it was created
+  double get_write_rate()
+  {
+    double age = handle_age();
+    return age ? (mTotalWriteBytes.load() / age) : 0;
+  }
+
+  off_t get_write_bytes()
+  {
+    return mTotalWriteBytes.load();
+  }
+
   float get_readahead_volume_efficiency()
   {
     XrdSysCondVarHelper lLock(ReadCondVar());
@@ -562,6 +583,9 @@ public:
     mReadAheadPosition = 0;
     mTotalBytes = 0;
     mTotalReadAheadHitBytes = 0;
+    mTotalReadAheadBytes = 0;
+    mTotalWriteBytes.store(0, std::memory_order_seq_cst);
+    eos::common::Timing::GetTimeSpec(mCreationTime);
     mAttached = 0;
     mTimeout = 0;
     mSelfDestruction.store(false, std::memory_order_seq_cst);
@@ -623,8 +647,10 @@ public:
   virtual ~Proxy()
   {
     Collect();
-    eos_notice("ra-efficiency=%f ra-vol-efficiency=%f", get_readahead_efficiency(),
-               get_readahead_volume_efficiency());
+    eos_notice("ra-efficiency=%f ra-vol-efficiency=%f rd-bytes=%ld rd-rate=%.02f MB/s wr-bytes=%ld wr-rate=%.02f MB/s",
+               get_readahead_efficiency(), get_readahead_volume_efficiency(),
+               mTotalBytes, get_read_rate() / 1000000.0,
+               get_write_bytes(), get_write_rate() / 1000000.0);
   }
 
   // ---------------------------------------------------------------------- //
@@ -1089,6 +1115,33 @@ public:
   static ssize_t
   sChunkTimeout; // time after we move an inflight chunk out of a proxy object into the static map
 
+  // number of XrdCl sub-streams per data server channel - XrdCl spreads the
+  // in-flight read requests of a file over them, writes go over the main
+  // stream. Channels to the MGM use a single stream, see mgm_channel.
+  static size_t parallel_streams(size_t n = 0)
+  {
+    if (n) {
+      sParallelStreams = n;
+      XrdCl::DefaultEnv::GetEnv()->PutInt("SubStreamsPerChannel", n);
+    }
+
+    return sParallelStreams;
+  }
+  static size_t sParallelStreams;
+
+  // XrdCl reads the sub-stream setting when it creates a channel. Channels
+  // to data servers are created while following the redirection of an open,
+  // the channel of a login to the MGM is created here with a single stream
+  // before the first request - to be called with every MGM url.
+  static void mgm_channel(const XrdCl::URL& url);
+  static XrdSysMutex sMgmChannelMutex;
+  static std::map<std::string, std::unique_ptr<XrdCl::FileSystem>> sMgmChannels;
+
+  // bytes read and written through all file handles, shown with their rates
+  // in the statistics file
+  static std::atomic<uint64_t> sReadBytes;
+  static std::atomic<uint64_t> sWriteBytes;
+
 private:
   OPEN_STATE open_state;
   struct timespec open_state_time;
@@ -1130,7 +1183,15 @@ private:
   off_t mTotalBytes;
   off_t mTotalReadAheadHitBytes;
   off_t mTotalReadAheadBytes;
+  std::atomic<off_t> mTotalWriteBytes;
   off_t mReadAheadMaximumPosition;
+  struct timespec mCreationTime;
+
+  double handle_age()
+  {
+    return ((double) eos::common::Timing::GetAgeInNs(&mCreationTime,
+            0) / 1000000000.0);
+  }
 
   XrdSysMutex mAttachedMutex;
   size_t mAttached;
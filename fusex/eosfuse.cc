@@ -82,6 +82,7 @@ extern "C" { /* this 'extern "C"' brace will eventually end up in the .h file, t
 #include "kv/kv.hh"
 #include "data/cache.hh"
 #include "data/cachehandler.hh"
+#include "data/diskcache.hh"
 
 #if ( FUSE_USE_VERSION > 28 )
 #include "EosFuseSessionLoop.hh"
@@ -394,7 +395,7 @@ EosFuse::run(int argc, char* argv[], void* userdata)
       }
 
       if (!root["inline"].isMember("max-size")) {
-        root["inline"]["max-size="] = 0;
+        root["inline"]["max-size"] = 0;
       }
 
       if (!root["inline"].isMember("default-compressor")) {
@@ -456,6 +457,18 @@ EosFuse::run(int argc, char* argv[], void* userdata)
       root["options"]["rm-rf-bulk"] = 0;
     }
 
+    if (!root["options"].isMember("md-flush-threads")) {
+      root["options"]["md-flush-threads"] = 4;
+    }
+
+    if (!root["options"].isMember("md-flush-batch")) {
+      root["options"]["md-flush-batch"] = 64;
+    }
+
+    if (!root["options"].isMember("md-warm-start")) {
+      root["options"]["md-warm-start"] = 0;
+    }
+
     // xrdcl default options
     XrdCl::DefaultEnv::GetEnv()->PutInt("TimeoutResolution", 1);
     XrdCl::DefaultEnv::GetEnv()->PutInt("ConnectionWindow", 10);
@@ -554,8 +567,20 @@ EosFuse::run(int argc, char* argv[], void* userdata)
       root["options"]["rm-rf-protect-levels"].asInt();
     config.options.rm_rf_bulk =
       root["options"]["rm-rf-bulk"].asInt();
+    config.options.md_flush_threads =
+      root["options"]["md-flush-threads"].asInt();
+    config.options.md_flush_batch = root["options"]["md-flush-batch"].asInt();
+
+    if (config.options.md_flush_threads < 1) {
+      config.options.md_flush_threads = 1;
+    }
+
+    if (config.options.md_flush_batch < 1) {
+      config.options.md_flush_batch = 1;
+    }
     config.options.show_tree_size = root["options"]["show-tree-size"].asInt();
     config.options.free_md_asap = root["options"]["free-md-asap"].asInt();
+    config.options.md_warm_start = root["options"]["md-warm-start"].asInt();
     config.options.cpu_core_affinity = root["options"]["cpu-core-affinity"].asInt();
     config.options.no_xattr = root["options"]["no-xattr"].asInt();
     config.options.no_hardlinks = root["options"]["no-link"].asInt();
@@ -654,6 +679,14 @@ EosFuse::run(int argc, char* argv[], void* userdata)
       config.statfilesuffix = "stats";
     }
 
+    if (config.options.md_warm_start && !config.mdcachedir.length() &&
+        !config.mdcachehost.length()) {
+      // there is nothing to start from without a persistent md cache
+      fprintf(stderr,
+              "warning: option md-warm-start requires mdcachedir or mdcachehost - disabled\n");
+      config.options.md_warm_start = 0;
+    }
+
     if (!config.mdcacheport) {
       config.mdcacheport = 6379;
     }
@@ -753,6 +786,22 @@ EosFuse::run(int argc, char* argv[], void* userdata)
       root["cache"]["read-ahead-strategy"] = "dynamic";
     }
 
+    if (!root["cache"].isMember("parallel-streams")) {
+      root["cache"]["parallel-streams"] = 1;
+    }
+
+    if (!root["cache"].isMember("write-back")) {
+      root["cache"]["write-back"] = 0;
+    }
+
+    if (!root["cache"].isMember("write-back-threads")) {
+      root["cache"]["write-back-threads"] = 4;
+    }
+
+    if (!root["cache"].isMember("write-back-bandwidth-mb")) {
+      root["cache"]["write-back-bandwidth-mb"] = 0;
+    }
+
     cconfig.location = root["cache"]["location"].asString();
     cconfig.journal = root["cache"]["journal"].asString();
     cconfig.default_read_ahead_size =
@@ -760,6 +809,19 @@ EosFuse::run(int argc, char* argv[], void* userdata)
     cconfig.max_read_ahead_size = root["cache"]["read-ahead-bytes-max"].asInt();
     cconfig.max_read_ahead_blocks = root["cache"]["read-ahead-blocks-max"].asInt();
     cconfig.read_ahead_strategy = root["cache"]["read-ahead-strategy"].asString();
+    cconfig.parallel_streams = root["cache"]["parallel-streams"].asUInt();
+
+    if (cconfig.parallel_streams < 1) {
+      cconfig.parallel_streams = 1;
+    }
+
+    if (cconfig.parallel_streams > 16) {
+      cconfig.parallel_streams = 16;
+    }
+
+    // every sub-stream is a separate TCP connection to a data server, they
+    // only carry reads - the channels to the MGM keep a single stream
+    XrdCl::Proxy::parallel_streams(cconfig.parallel_streams);
 
     if ((cconfig.read_ahead_strategy != "none") &&
         (cconfig.read_ahead_strategy != "static") &&
@@ -898,6 +960,17 @@ EosFuse::run(int argc, char* argv[], void* userdata)
     cconfig.per_file_journal_max_size =
       root["cache"]["file-journal-max-kb"].asUInt64() * 1024;
     cconfig.clean_threshold = root["cache"]["clean-threshold"].asDouble();
+    cconfig.write_back_threads = root["cache"]["write-back-threads"].asUInt();
+
+    if (cconfig.write_back_threads < 1) {
+      cconfig.write_back_threads = 1;
+    }
+
+    cconfig.write_back_bandwidth =
+      root["cache"]["write-back-bandwidth-mb"].asUInt64() * 1024 * 1024;
+    // write-back needs the journal to keep the data until it is uploaded
+    cconfig.write_back = (root["cache"]["write-back"].asInt() &&
+                          cconfig.journal.length());
     int rc = 0;
 
     if ((rc = cachehandler::instance().init(cconfig))) {
@@ -1174,6 +1247,9 @@ EosFuse::run(int argc, char* argv[], void* userdata)
       exit(errno);
     }
 
+    // upload the journals left behind by a previous run
+    datas.replay();
+
     fusestat.Add("getattr", 0, 0, 0);
     fusestat.Add("setattr", 0, 0, 0);
     fusestat.Add("setattr:chown", 0, 0, 0);
@@ -1183,6 +1259,7 @@ EosFuse::run(int argc, char* argv[], void* userdata)
     fusestat.Add("lookup", 0, 0, 0);
     fusestat.Add("opendir", 0, 0, 0);
     fusestat.Add("readdir", 0, 0, 0);
+    fusestat.Add("readdirplus", 0, 0, 0);
     fusestat.Add("releasedir", 0, 0, 0);
     fusestat.Add("statfs", 0, 0, 0);
     fusestat.Add("mknod", 0, 0, 0);
@@ -1210,8 +1287,16 @@ EosFuse::run(int argc, char* argv[], void* userdata)
     fusestat.Add(__SUM__TOTAL__, 0, 0, 0);
     tDumpStatistic.reset(&EosFuse::DumpStatistic, this);
     tStatCirculate.reset(&EosFuse::StatCirculate, this);
-    tMetaCacheFlush.reset(&metad::mdcflush, &mds);
+
+    for (int i = 0; i < config.options.md_flush_threads; ++i) {
+      tMetaCacheFlush.emplace_back(new AssistedThread(&metad::mdcflush, &mds));
+    }
+
     tMetaCommunicate.reset(&metad::mdcommunicate, &mds);
+
+    if (config.options.md_warm_start) {
+      tMetaSnapshot.reset(&metad::mdsnapshot, &mds);
+    }
     tCapFlush.reset(&cap::capflush, &caps);
     eos_static_warning("********************************************************************************");
     eos_static_warning("eosxd started version %s - FUSE protocol version %d",
@@ -1222,7 +1307,10 @@ EosFuse::run(int argc, char* argv[], void* userdata)
     eos_static_warning("zmq-connection         := %s", config.mqtargethost.c_str());
     eos_static_warning("zmq-identity           := %s", config.mqidentity.c_str());
     eos_static_warning("fd-limit               := %lu", config.options.fdlimit);
-    eos_static_warning("options                := backtrace=%d md-cache:%d md-enoent:%.02f md-timeout:%.02f md-put-timeout:%.02f data-cache:%d mkdir-sync:%d create-sync:%d symlink-sync:%d rename-sync:%d rmdir-sync:%d flush:%d flush-w-open:%d locking:%d no-fsync:%s ol-mode:%03o show-tree-size:%d free-md-asap:%d core-affinity:%d no-xattr:%d no-link:%d nocache-graceperiod:%d rm-rf-protect-level=%d rm-rf-bulk=%d",
+    eos_static_warning("md-flush               := threads:%d batch:%d",
+                       config.options.md_flush_threads,
+                       config.options.md_flush_batch);
+    eos_static_warning("options                := backtrace=%d md-cache:%d md-enoent:%.02f md-timeout:%.02f md-put-timeout:%.02f data-cache:%d mkdir-sync:%d create-sync:%d symlink-sync:%d rename-sync:%d rmdir-sync:%d flush:%d flush-w-open:%d locking:%d no-fsync:%s ol-mode:%03o show-tree-size:%d free-md-asap:%d md-warm-start:%d core-affinity:%d no-xattr:%d no-link:%d nocache-graceperiod:%d rm-rf-protect-level=%d rm-rf-bulk=%d",
                        config.options.enable_backtrace,
                        config.options.md_kernelcache,
                        config.options.md_kernelcache_enoent_timeout,
@@ -1241,6 +1329,7 @@ EosFuse::run(int argc, char* argv[], void* userdata)
                        config.options.overlay_mode,
                        config.options.show_tree_size,
                        config.options.free_md_asap,
+                       config.options.md_warm_start,
                        config.options.cpu_core_affinity,
                        config.options.no_xattr,
                        config.options.no_hardlinks,
@@ -1248,16 +1337,21 @@ EosFuse::run(int argc, char* argv[], void* userdata)
                        config.options.rm_rf_protect_levels,
                        config.options.rm_rf_bulk
                       );
-    eos_static_warning("cache                  := rh-type:%s rh-nom:%d rh-max:%d rh-blocks:%d tot-size=%ld tot-ino=%ld dc-loc:%s jc-loc:%s clean-thrs:%02f%%%",
+    eos_static_warning("cache                  := rh-type:%s rh-nom:%d rh-max:%d rh-blocks:%d streams:%lu tot-size=%ld tot-ino=%ld dc-loc:%s jc-loc:%s clean-thrs:%02f%%%",
                        cconfig.read_ahead_strategy.c_str(),
                        cconfig.default_read_ahead_size,
                        cconfig.max_read_ahead_size,
                        cconfig.max_read_ahead_blocks,
+                       cconfig.parallel_streams,
                        cconfig.total_file_cache_size,
                        cconfig.total_file_cache_inodes,
                        cconfig.location.c_str(),
                        cconfig.journal.c_str(),
                        cconfig.clean_threshold);
+    eos_static_warning("write-back             := enabled:%d threads:%lu bandwidth:%lu",
+                       cconfig.write_back,
+                       cconfig.write_back_threads,
+                       cconfig.write_back_bandwidth);
     eos_static_warning("read-recovery          := enabled:%d ropen:%d ropen-noserv:%d ropen-noserv-window:%u",
                        config.recovery.read,
                        config.recovery.read_open,
@@ -1323,8 +1417,13 @@ EosFuse::run(int argc, char* argv[], void* userdata)
     eos_static_warning("********************************************************************************");
     tDumpStatistic.join();
     tStatCirculate.join();
-    tMetaCacheFlush.join();
+
+    for (auto& thread : tMetaCacheFlush) {
+      thread->join();
+    }
+
     tMetaCommunicate.join();
+    tMetaSnapshot.join();
     tCapFlush.join();
     Mounter().terminate();
 
@@ -1415,6 +1514,11 @@ EosFuse::DumpStatistic(ThreadAssistant& assistant)
   eos_static_debug("started statistic dump thread");
   char ino_stat[16384];
   time_t start_time = time(NULL);
+  // previous totals to compute the I/O rates between two dumps
+  uint64_t last_rd_bytes = XrdCl::Proxy::sReadBytes.load();
+  uint64_t last_wr_bytes = XrdCl::Proxy::sWriteBytes.load();
+  struct timespec last_io_time;
+  eos::common::Timing::GetTimeSpec(last_io_time);
 
   while (!assistant.terminationRequested()) {
     eos::common::LinuxStat::linux_stat_t osstat;
@@ -1446,6 +1550,10 @@ EosFuse::DumpStatistic(ThreadAssistant& assistant)
              "ALL        inodes-open         := %lu\n"
              "ALL        inodes-vmap         := %lu\n"
              "ALL        inodes-caps         := %lu\n"
+             "ALL        lookups-neg-hit     := %lu\n"
+             "ALL        lookups-neg-stored  := %lu\n"
+             "ALL        inodes-warm         := %lu\n"
+             "ALL        inodes-revalidated  := %lu\n"
              "# -----------------------------------------------------------------------------------------------------------\n",
              this->getMdStat().inodes(),
              this->getMdStat().inodes_stacked(),
@@ -1455,7 +1563,11 @@ EosFuse::DumpStatistic(ThreadAssistant& assistant)
              this->getMdStat().inodes_deleted_ever(),
              this->datas.size(),
              this->mds.vmaps().size(),
-             this->caps.size()
+             this->caps.size(),
+             this->getMdStat().lookups_negative_hit(),
+             this->getMdStat().lookups_negative_stored(),
+             this->getMdStat().inodes_warm(),
+             this->getMdStat().inodes_revalidated()
             );
     sout += ino_stat;
     std::string s1;
@@ -1506,6 +1618,63 @@ EosFuse::DumpStatistic(ThreadAssistant& assistant)
              EosFuse::instance().config.clientuuid.c_str()
             );
     sout += ino_stat;
+    writeback::stats_t wbstat;
+    datas.writeback_stats(wbstat);
+    snprintf(ino_stat, sizeof(ino_stat),
+             "ALL        wb-backlog-files    := %lu\n"
+             "ALL        wb-backlog-bytes    := %s\n"
+             "ALL        wb-backlog-age      := %.02f\n"
+             "ALL        wb-uploaded-files   := %lu\n"
+             "ALL        wb-uploaded-bytes   := %s\n"
+             "ALL        wb-failed           := %lu\n"
+             "# -----------------------------------------------------------------------------------------------------------\n",
+             wbstat.backlog_files,
+             eos::common::StringConversion::GetReadableSizeString(s1,
+                 wbstat.backlog_bytes, "b"),
+             wbstat.backlog_age,
+             wbstat.uploaded_files,
+             eos::common::StringConversion::GetReadableSizeString(s2,
+                 wbstat.uploaded_bytes, "b"),
+             wbstat.failed);
+    sout += ino_stat;
+    blockindex::stats_t dcstat;
+    diskcache::get_stats(dcstat);
+    snprintf(ino_stat, sizeof(ino_stat),
+             "ALL        dc-hits             := %lu\n"
+             "ALL        dc-misses           := %lu\n"
+             "ALL        dc-hit-rate         := %.02f\n"
+             "ALL        dc-evictions        := %lu\n"
+             "ALL        dc-blocks           := %lu\n"
+             "ALL        dc-inodes           := %lu\n"
+             "# -----------------------------------------------------------------------------------------------------------\n",
+             dcstat.hits,
+             dcstat.misses,
+             (dcstat.hits + dcstat.misses) ?
+             100.0 * dcstat.hits / (dcstat.hits + dcstat.misses) : 0.0,
+             dcstat.evictions,
+             dcstat.blocks,
+             dcstat.inodes);
+    sout += ino_stat;
+    uint64_t rd_bytes = XrdCl::Proxy::sReadBytes.load();
+    uint64_t wr_bytes = XrdCl::Proxy::sWriteBytes.load();
+    double io_age = eos::common::Timing::GetAgeInNs(&last_io_time, 0) /
+                    1000000000.0;
+    eos::common::Timing::GetTimeSpec(last_io_time);
+    snprintf(ino_stat, sizeof(ino_stat),
+             "ALL        io-streams          := %lu\n"
+             "ALL        io-rd-bytes         := %s\n"
+             "ALL        io-rd-rate          := %.02f MB/s\n"
+             "ALL        io-wr-bytes         := %s\n"
+             "ALL        io-wr-rate          := %.02f MB/s\n"
+             "# -----------------------------------------------------------------------------------------------------------\n",
+             XrdCl::Proxy::parallel_streams(),
+             eos::common::StringConversion::GetReadableSizeString(s1, rd_bytes, "b"),
+             io_age ? (rd_bytes - last_rd_bytes) / io_age / 1000000.0 : 0.0,
+             eos::common::StringConversion::GetReadableSizeString(s2, wr_bytes, "b"),
+             io_age ? (wr_bytes - last_wr_bytes) / io_age / 1000000.0 : 0.0);
+    sout += ino_stat;
+    last_rd_bytes = rd_bytes;
+    last_wr_bytes = wr_bytes;
     std::ofstream dumpfile(EosFuse::Instance().config.statfilepath);
     dumpfile << sout;
     assistant.wait_for(std::chrono::seconds(1));
@@ -1994,7 +2163,18 @@ EosFuse::listdir(fuse_req_t req, fuse_ino_t ino, metad::shared_md& md)
     // retrieve md
     std::string authid = pcap->authid();
     cLock.UnLock();
+    eos::common::Timing timing("listdir");
+    COMMONTIMING("_start_", &timing);
     md = Instance().mds.get(req, ino, authid, true);
+    COMMONTIMING("_stop_", &timing);
+    size_t n_children = 0;
+    {
+      XrdSysMutexHelper mLock(md->Locker());
+      n_children = md->local_children().size();
+    }
+    Instance().getFuseStat().AddListing("listdir", fuse_req_ctx(req)->uid,
+                                        fuse_req_ctx(req)->gid, n_children,
+                                        timing.RealTime());
   }
 
   return rc;
@@ -2084,6 +2264,30 @@ EosFuse::opendir(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi)
                     dump(id, ino, 0, rc).c_str());
 }
 
+/* -------------------------------------------------------------------------- */
+static size_t
+/* -------------------------------------------------------------------------- */
+add_direntry(fuse_req_t req, char* buf, size_t bufsize, const char* name,
+             const struct stat* stbuf, off_t off, bool plus)
+/* -------------------------------------------------------------------------- */
+/*
+ * add a directory entry without a lookup reference to a readdir(plus) buffer
+ */
+{
+#if FUSE_USE_VERSION >= 30
+
+  if (plus) {
+    // an entry without inode number makes the kernel skip the attributes
+    struct fuse_entry_param e;
+    memset(&e, 0, sizeof(e));
+    e.attr = *stbuf;
+    return fuse_add_direntry_plus(req, buf, bufsize, name, &e, off);
+  }
+
+#endif
+  return fuse_add_direntry(req, buf, bufsize, name, stbuf, off);
+}
+
 /* -------------------------------------------------------------------------- */
 void
 /* -------------------------------------------------------------------------- */
@@ -2098,8 +2302,53 @@ EBADF  Invalid directory stream descriptor fi->fh
   COMMONTIMING("_start_", &timing);
   EXEC_TIMING_BEGIN(__func__);
   ADD_FUSE_STAT(__func__, req);
-  int rc = 0;
   fuse_id id(req);
+  int rc = readdir_fill(req, ino, size, off, fi, false);
+  EXEC_TIMING_END(__func__);
+  COMMONTIMING("_stop_", &timing);
+  eos_static_notice("t(ms)=%.03f %s", timing.RealTime(),
+                    dump(id, ino, 0, rc).c_str());
+}
+
+#if FUSE_USE_VERSION >= 30
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+EosFuse::readdirplus(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
+                     struct fuse_file_info* fi)
+/* -------------------------------------------------------------------------- */
+/*
+EBADF  Invalid directory stream descriptor fi->fh
+ */
+{
+  eos::common::Timing timing(__func__);
+  COMMONTIMING("_start_", &timing);
+  EXEC_TIMING_BEGIN(__func__);
+  ADD_FUSE_STAT(__func__, req);
+  fuse_id id(req);
+  int rc = readdir_fill(req, ino, size, off, fi, true);
+  EXEC_TIMING_END(__func__);
+  COMMONTIMING("_stop_", &timing);
+  eos_static_notice("t(ms)=%.03f %s", timing.RealTime(),
+                    dump(id, ino, 0, rc).c_str());
+}
+#endif
+
+/* -------------------------------------------------------------------------- */
+int
+/* -------------------------------------------------------------------------- */
+EosFuse::readdir_fill(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
+                      struct fuse_file_info* fi, bool plus)
+/* -------------------------------------------------------------------------- */
+/*
+ * fill a directory buffer - in plus mode every regular child is returned with
+ * its attributes and a lookup reference, as if the kernel had looked it up
+ */
+{
+  eos::common::Timing timing("readdir_fill");
+  COMMONTIMING("_start_", &timing);
+  int rc = 0;
+  size_t n_entries = 0;
 
   if (!fi->fh) {
     fuse_reply_err(req, EBADF);
@@ -2162,8 +2411,8 @@ EBADF  Invalid directory stream descriptor fi->fh
       memset(&stbuf, 0, sizeof(struct stat));
       stbuf.st_ino = cino;
       stbuf.st_mode = mode;
-      size_t a_size = fuse_add_direntry(req, b_ptr, size - b_size,
-                                        bname.c_str(), &stbuf, ++off);
+      size_t a_size = add_direntry(req, b_ptr, size - b_size,
+                                   bname.c_str(), &stbuf, ++off, plus);
       eos_static_info("name=%s ino=%08lx mode=%08x bytes=%u/%u",
                       bname.c_str(), cino, mode, a_size, size - b_size);
       b_ptr += a_size;
@@ -2187,8 +2436,8 @@ EBADF  Invalid directory stream descriptor fi->fh
         memset(&stbuf, 0, sizeof(struct stat));
         stbuf.st_ino = cino;
         stbuf.st_mode = mode;
-        size_t a_size = fuse_add_direntry(req, b_ptr, size - b_size,
-                                          bname.c_str(), &stbuf, ++off);
+        size_t a_size = add_direntry(req, b_ptr, size - b_size,
+                                     bname.c_str(), &stbuf, ++off, plus);
         eos_static_info("name=%s ino=%08lx mode=%08x bytes=%u/%u",
                         bname.c_str(), cino, mode, a_size, size - b_size);
         b_ptr += a_size;
@@ -2236,10 +2485,12 @@ EBADF  Invalid directory stream descriptor fi->fh
       struct stat stbuf;
       memset(&stbuf, 0, sizeof(struct stat));
       stbuf.st_ino = cino;
+      bool hardlink = false;
       {
         auto attrMap = cmd->attr();
 
         if (attrMap.count(k_mdino)) {
+          hardlink = true;
           uint64_t mdino = std::stoll(attrMap[k_mdino]);
           uint64_t local_ino = Instance().mds.vmaps().forward(mdino);
 
@@ -2255,8 +2506,36 @@ EBADF  Invalid directory stream descriptor fi->fh
         }
       }
       stbuf.st_mode = mode;
-      size_t a_size = fuse_add_direntry(req, b_ptr, size - b_size,
-                                        bname.c_str(), &stbuf, ++off);
+      size_t a_size = 0;
+#if FUSE_USE_VERSION >= 30
+
+      if (plus && !hardlink) {
+        // hand out the entry as lookup would do, the lookup reference is
+        // only taken if the entry fits into the buffer
+        XrdSysMutexHelper cLock(cmd->Locker());
+
+        if (cmd->id() == cino) {
+          struct fuse_entry_param e;
+          memset(&e, 0, sizeof(e));
+          cmd->set_pid(ino);
+          cmd->convert(e);
+          a_size = fuse_add_direntry_plus(req, b_ptr, size - b_size,
+                                          bname.c_str(), &e, off + 1);
+
+          if (a_size <= (size - b_size)) {
+            cmd->lookup_inc();
+          }
+        }
+      }
+
+#endif
+
+      if (!a_size) {
+        a_size = add_direntry(req, b_ptr, size - b_size, bname.c_str(), &stbuf,
+                              off + 1, plus);
+      }
+
+      ++off;
       eos_static_info("name=%s id=%#lx ino=%#lx mode=%#o bytes=%u/%u",
                       bname.c_str(), cino, stbuf.st_ino, mode, a_size, size - b_size);
 
@@ -2264,6 +2543,8 @@ EBADF  Invalid directory stream descriptor fi->fh
         break;
       }
 
+      n_entries++;
+
       // add to the shown list
       md->readdir_items.insert(it->first);
       b_ptr += a_size;
@@ -2279,10 +2560,12 @@ EBADF  Invalid directory stream descriptor fi->fh
     eos_static_debug("size=%lu off=%llu reply-size=%lu", size, off, b_size);
   }
 
-  EXEC_TIMING_END(__func__);
   COMMONTIMING("_stop_", &timing);
-  eos_static_notice("t(ms)=%.03f %s", timing.RealTime(),
-                    dump(id, ino, 0, rc).c_str());
+  Instance().getFuseStat().AddListing(plus ? "readdirplus" : "readdir",
+                                      fuse_req_ctx(req)->uid,
+                                      fuse_req_ctx(req)->gid, n_entries,
+                                      timing.RealTime());
+  return rc;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -3329,6 +3612,17 @@ The O_NONBLOCK flag was specified, and an incompatible lease was held on the fil
             md->set_inlinesize(strtoull(maxsize.c_str(), 0, 10));
           }
 
+          if (pmd->attr().count("sys.file.inline.compressor")) {
+            md->set_inlinecompressor(
+              (*pmd->mutable_attr())["sys.file.inline.compressor"]);
+          }
+
+          // new files are kept in the namespace only if the directory asks
+          if (pmd->attr().count("sys.file.inline.only")) {
+            md->set_inlineonly(data::datax::inline_only_enabled(
+                                 (*pmd->mutable_attr())["sys.file.inline.only"]));
+          }
+
           mLockParent.UnLock();
           mLock.Lock(&md->Locker());
         }
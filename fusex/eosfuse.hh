@@ -40,11 +40,13 @@
 #include "misc/FuseId.hh"
 #include "misc/stringTS.hh"
 #include "submount/SubMount.hh"
+#include <memory>
 #include <set>
 #include <signal.h>
 #include <string.h>
 #include <string>
 #include <thread>
+#include <vector>
 
 class EosFuse : public llfusexx::FuseBase<EosFuse>
 {
@@ -83,6 +85,14 @@ public:
   static void readdir(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
                       struct fuse_file_info* fi);
 
+#if FUSE_USE_VERSION >= 30
+  static void readdirplus(fuse_req_t req, fuse_ino_t ino, size_t size,
+                          off_t off, struct fuse_file_info* fi);
+#endif
+
+  static int readdir_fill(fuse_req_t req, fuse_ino_t ino, size_t size,
+                          off_t off, struct fuse_file_info* fi, bool plus);
+
   static void releasedir(fuse_req_t req, fuse_ino_t ino,
                          struct fuse_file_info* fi);
 
@@ -212,6 +222,8 @@ public:
       double md_kernelcache_enoent_timeout;
       double md_backend_timeout;
       double md_backend_put_timeout;
+      int md_flush_threads;
+      int md_flush_batch;
       int data_kernelcache;
       int mkdir_is_sync;
       int create_is_sync;
@@ -226,6 +238,7 @@ public:
       int rm_rf_bulk;
       int show_tree_size;
       int free_md_asap;
+      int md_warm_start;
       int cpu_core_affinity;
       mode_t overlay_mode;
       int no_xattr;
@@ -359,8 +372,9 @@ private:
 
   AssistedThread tDumpStatistic;
   AssistedThread tStatCirculate;
-  AssistedThread tMetaCacheFlush;
+  std::vector<std::unique_ptr<AssistedThread>> tMetaCacheFlush;
   AssistedThread tMetaCommunicate;
+  AssistedThread tMetaSnapshot;
   AssistedThread tCapFlush;
 
   void DumpStatistic(ThreadAssistant& assistant);
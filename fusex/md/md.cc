@@ -78,8 +78,9 @@ metad::init(backend* _mdbackend)
   std::string mdstream;
   // load the root node
   fuse_req_t req = 0;
-  XrdSysMutexHelper mLock(mdmap);
-  update(req, mdmap[1], "", true);
+  shared_md root;
+  mdmap.retrieveOrCreateTS(1, root);
+  update(req, root, "", true);
   next_ino.init(EosFuse::Instance().getKV());
 }
 
@@ -206,6 +207,20 @@ metad::lookup(fuse_req_t req, fuse_ino_t parent, const char* name)
 
           return md;
         }
+
+        if (pmd->is_negative(name)) {
+          // the MGM told us already, that this does not exist and would
+          // have broadcasted a creation in this directory
+          stat.lookups_negative_hit_inc();
+          md = std::make_shared<mdx>();
+          md->set_err(ENOENT);
+
+          if (EOS_LOGS_DEBUG) {
+            eos_static_debug("in negative list %016lx name=%s", pmd->id(), name);
+          }
+
+          return md;
+        }
       }
     } else {
       // --------------------------------------------------
@@ -216,9 +231,17 @@ metad::lookup(fuse_req_t req, fuse_ino_t parent, const char* name)
     // --------------------------------------------------
     // try to get the meta data record
     // --------------------------------------------------
+    uint64_t negative_epoch = pmd->negative_epoch();
     pmd->Locker().UnLock();
     md = get(req, inode, "", false, pmd, name);
     pmd->Locker().Lock();
+
+    if (!inode && !md->id() && (md->err() == ENOENT) && pmd->cap_count()) {
+      // remember the miss, unless the directory changed in the meanwhile
+      if (pmd->add_negative(name, negative_epoch)) {
+        stat.lookups_negative_stored_inc();
+      }
+    }
   } else {
     // --------------------------------------------------
     // no md available
@@ -293,19 +316,12 @@ void
 metad::forget_all()
 {
   // all but /
-  XrdSysMutexHelper lLock(mdmap);
+  size_t n = mdmap.erase_ifTS([](const fuse_ino_t & ino, shared_md & md) {
+    return ((ino != 1) && (!S_ISDIR(md->mode()) || md->deleted()));
+  });
 
-  for (auto it = mdmap.begin(); it != mdmap.end();) {
-    if (it->first != 1) {
-      if (!S_ISDIR(it->second->mode()) || it->second->deleted()) {
-        it = mdmap.erase(it);
-        stat.inodes_dec();
-      } else {
-        it++;
-      }
-    } else {
-      it++;
-    }
+  for (size_t i = 0; i < n; ++i) {
+    stat.inodes_dec();
   }
 }
 
@@ -565,7 +581,8 @@ metad::get(fuse_req_t req,
   shared_md md;
 
   if (ino) {
-    if (!mdmap.retrieveTS(ino, md)) {
+    if (!mdmap.retrieveTS(ino, md) &&
+        !(EosFuse::Instance().Config().options.md_warm_start && load(ino, md))) {
       md = std::make_shared<mdx>();
       md->set_md_ino(inomap.backward(ino));
     }
@@ -728,9 +745,14 @@ metad::get(fuse_req_t req,
       }
        */
       eos_static_info("ino=%016lx type=%d", md->md_ino(), md->type());
-      rc = mdbackend->getMD(req, md->md_ino(), listing ? ((md->type() != md->MDLS)
-                            ? 0 : md->clock()) : md->clock(),
-                            contv, listing, authid);
+      uint64_t clock = listing ? ((md->type() != md->MDLS) ? 0 : md->clock()) :
+                       md->clock();
+      // only a warm started record is fetched conditionally, the reply to a
+      // conditional request carries no cap
+      bool ifclock = md->revalidate && clock;
+      md->revalidate = false;
+      rc = mdbackend->getMD(req, md->md_ino(), clock, contv, listing, authid,
+                            ifclock);
     } else {
       if (md->id()) {
         // that can be a locally created entry which is not yet upstream
@@ -747,6 +769,20 @@ metad::get(fuse_req_t req,
     }
   }
 
+  if ((rc == EEXIST) && (thecase == 3)) {
+    // -------------------------------------------------------------------------
+    // the MGM clock did not change since we retrieved this record, the local
+    // record and a local listing are still valid
+    // -------------------------------------------------------------------------
+    stat.inodes_revalidated_inc();
+
+    if (EOS_LOGS_DEBUG) {
+      eos_static_debug("MD unchanged:\n%s", dump_md(md).c_str());
+    }
+
+    return md;
+  }
+
   if (!rc) {
     // -------------------------------------------------------------------------
     // we need to store all response data and eventually create missing
@@ -904,7 +940,8 @@ metad::update(fuse_req_t req, shared_md md, std::string authid,
     }
   }
 
-  flushentry fe(md->id(), authid, localstore ? mdx::LSTORE : mdx::UPDATE, req);
+  flushentry fe(md->id(), authid, localstore ? mdx::LSTORE : mdx::UPDATE, req,
+                md->pid());
   mdqueue[md->id()]++;
   mdflushqueue.push_back(fe);
   eos_static_info("added ino=%lx flushentry=%s queue-size=%u local-store=%d",
@@ -937,6 +974,7 @@ metad::add(fuse_req_t req, metad::shared_md pmd, metad::shared_md md,
     pmd->set_nlink(1);
     pmd->set_nchildren(pmd->nchildren() + 1);
     pmd->get_todelete().erase(md->name());
+    pmd->forget_negative(md->name());
     pid = pmd->id();
   }
   md->Locker().Lock();
@@ -954,7 +992,7 @@ metad::add(fuse_req_t req, metad::shared_md pmd, metad::shared_md md,
       mdflush.WaitMS(25);
     }
 
-    flushentry fe(id, authid, mdx::ADD, req);
+    flushentry fe(id, authid, mdx::ADD, req, pid);
     mdqueue[id]++;
     mdflushqueue.push_back(fe);
   }
@@ -1044,6 +1082,7 @@ metad::add_sync(fuse_req_t req, shared_md pmd, shared_md md, std::string authid)
     pmd->local_children()[md->name()] = md->id();
     pmd->set_nlink(1);
     pmd->get_todelete().erase(md->name());
+    pmd->forget_negative(md->name());
   }
   md->Locker().Lock();
   mdflush.Lock();
@@ -1144,7 +1183,7 @@ metad::remove(fuse_req_t req, metad::shared_md pmd, metad::shared_md md,
     return;
   }
 
-  flushentry fe(md->id(), authid, mdx::RM, req);
+  flushentry fe(md->id(), authid, mdx::RM, req, pmd->id());
   flushentry fep(pmd->id(), authid, mdx::LSTORE, req);
   mdflush.Lock();
 
@@ -1207,6 +1246,7 @@ metad::mv(fuse_req_t req, shared_md p1md, shared_md p2md, shared_md md,
     md->set_md_pino(p2md->md_ino());
     p1md->get_todelete()[oldname] = 0; //md->id(); // make it known as deleted
     p2md->get_todelete().erase(newname); // the new target is not deleted anymore
+    p2md->forget_negative(newname);
     md->setop_update();
     p1md->setop_update();
     p2md->setop_update();
@@ -1222,6 +1262,7 @@ metad::mv(fuse_req_t req, shared_md p1md, shared_md p2md, shared_md md,
     p1md->local_children().erase(md->name());
     p1md->get_todelete()[md->name()] = md->id(); // make it known as deleted
     p2md->get_todelete().erase(newname); // the new target is not deleted anymore
+    p2md->forget_negative(newname);
     md->set_name(newname);
     md->setop_update();
     p1md->setop_update();
@@ -1248,7 +1289,8 @@ metad::mv(fuse_req_t req, shared_md p1md, shared_md p2md, shared_md md,
     mdflushqueue.push_back(fe2);
   }
 
-  flushentry fe(md->id(), authid2, mdx::UPDATE, req);
+  // the rename itself is a barrier for the flusher threads
+  flushentry fe(md->id(), authid2, mdx::UPDATE, req, p2md->id(), true);
   mdqueue[md->id()]++;
   mdflushqueue.push_back(fe);
   stat.inodes_backlog_store(mdqueue.size());
@@ -1681,8 +1723,7 @@ metad::apply(fuse_req_t req, eos::fusex::container& cont, bool listing)
     md->Locker().UnLock();
 
     if (is_new) {
-      XrdSysMutexHelper mLock(mdmap);
-      mdmap[ino] = md;
+      mdmap.insertTS(ino, md);
       stat.inodes_inc();
       stat.inodes_ever_inc();
     }
@@ -1968,194 +2009,442 @@ metad::apply(fuse_req_t req, eos::fusex::container& cont, bool listing)
 void
 metad::mdcflush(ThreadAssistant& assistant)
 {
-  uint64_t lastflushid = 0;
+  // several of these threads run concurrently, each one picks the next
+  // entries which do not depend on anything queued before or still in flight
+  size_t max_batch = EosFuse::Instance().Config().options.md_flush_batch;
 
   while (!assistant.terminationRequested()) {
-    {
-      mdflush.Lock();
+    std::vector<flushentry> entries;
+    mdflush.Lock();
+    stat.inodes_backlog_store(mdqueue.size());
 
-      if (mdqueue.count(lastflushid)) {
-        // remove entries from the mdqueue, if their ref count is 0
-        if (!mdqueue[lastflushid]) {
-          mdqueue.erase(lastflushid);
-        }
+    while (!flush_next(entries, max_batch)) {
+      // TODO(gbitzes): Fix this, so we don't need to poll. Have ThreadAssistant
+      // accept callbacks for when termination is requested, so we can wake up
+      // any condvar.
+      mdflush.Wait(1);
+
+      if (assistant.terminationRequested()) {
+        mdflush.UnLock();
+        return;
       }
+    }
 
-      stat.inodes_backlog_store(mdqueue.size());
+    if (mdflushqueue.size()) {
+      // let another flusher look at the rest of the queue
+      mdflush.Signal();
+    }
 
-      while (mdqueue.size() == 0) {
-        // TODO(gbitzes): Fix this, so we don't need to poll. Have ThreadAssistant
-        // accept callbacks for when termination is requested, so we can wake up
-        // any condvar.
-        mdflush.Wait(1);
+    mdflush.UnLock();
 
-        if (assistant.terminationRequested()) {
-          mdflush.UnLock();
-          return;
-        }
-      }
+    if (entries.size() > 1) {
+      flush_batch(entries);
+    } else {
+      flush_entry(entries.front());
+    }
 
-      // TODO: add an optimzation to merge requests in the queue
-      auto it = mdflushqueue.begin();
-      uint64_t ino = it->id();
-      std::string authid = it->authid();
-      fuse_id f_id = it->get_fuse_id();
-      mdx::md_op op = it->op();
-      lastflushid = ino;
-      eos_static_info("metacache::flush ino=%#lx flushqueue-size=%u", ino,
-                      mdflushqueue.size());
-      eos_static_info("metacache::flush %s", flushentry::dump(*it).c_str());
-      mdflushqueue.erase(it);
-      mdqueue[ino]--;
-      mdflush.UnLock();
+    mdflush.Lock();
+    flush_done(entries);
+    mdflush.Broadcast();
+    mdflush.UnLock();
+  }
+}
 
-      if (assistant.terminationRequested()) {
-        return;
+/* -------------------------------------------------------------------------- */
+bool
+metad::flush_next(std::vector<flushentry>& entries, size_t max_batch)
+{
+  if (!mdflushqueue.next(entries, max_batch)) {
+    return false;
+  }
+
+  for (auto& e : entries) {
+    eos_static_info("metacache::flush ino=%#lx flushqueue-size=%u batch-size=%u",
+                    e.id(), mdflushqueue.size(), entries.size());
+    eos_static_info("metacache::flush %s", flushentry::dump(e).c_str());
+  }
+
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+void
+metad::flush_done(const std::vector<flushentry>& entries)
+{
+  mdflushqueue.done(entries);
+
+  for (auto& e : entries) {
+    auto it = mdqueue.find(e.id());
+
+    if (it != mdqueue.end()) {
+      // remove entries from the mdqueue, if their ref count is 0
+      if (it->second <= e.count()) {
+        mdqueue.erase(it);
+      } else {
+        it->second -= e.count();
       }
+    }
+  }
 
-      if (EOS_LOGS_DEBUG) {
-        eos_static_debug("metacache::flush ino=%016lx authid=%s op=%d", ino,
-                         authid.c_str(), (int) op);
+  stat.inodes_backlog_store(mdqueue.size());
+}
+
+/* -------------------------------------------------------------------------- */
+bool
+metad::flushqueue::next(std::vector<flushentry>& entries, size_t max_batch)
+{
+  if (inflight_barrier) {
+    return false;
+  }
+
+  flushdeps skipped;
+  auto it = queue.begin();
+
+  for (; it != queue.end(); ++it) {
+    if (it->barrier()) {
+      if (!inflight.empty() || !skipped.empty()) {
+        return false;
       }
 
-      {
-        shared_md md;
+      break;
+    }
 
-        if (!mdmap.retrieveTS(ino, md)) {
-          eos_static_crit("metacache::flush failed to retrieve ino=%016lx", ino);
+    if (inflight.blocks(*it) || skipped.blocks(*it)) {
+      skipped.add(*it);
+      continue;
+    }
+
+    break;
+  }
+
+  if (it == queue.end()) {
+    return false;
+  }
+
+  flushentry fe = *it;
+  it = queue.erase(it);
+
+  if (!fe.barrier()) {
+    if ((fe.op() == mdx::ADD) && (max_batch > 1)) {
+      entries.push_back(fe);
+
+      // collect sibling creations of the same user which can overtake the
+      // entries in between
+      while ((it != queue.end()) && (entries.size() < max_batch)) {
+        if (it->barrier()) {
+          break;
+        }
+
+        if ((it->op() == mdx::ADD) && (it->pid() == fe.pid()) &&
+            (it->get_fuse_id().uid == fe.get_fuse_id().uid) &&
+            (it->get_fuse_id().gid == fe.get_fuse_id().gid) &&
+            !inflight.blocks(*it) && !skipped.blocks(*it)) {
+          entries.push_back(*it);
+          it = queue.erase(it);
+        } else {
+          skipped.add(*it);
+          ++it;
+        }
+      }
+    } else {
+      // coalesce later updates of the same inode up to the next entry
+      // depending on it
+      for (; it != queue.end();) {
+        if (it->barrier() || (it->op() == mdx::RM)) {
+          break;
+        }
+
+        if ((it->id() != fe.id()) && (it->pid() != fe.id())) {
+          ++it;
           continue;
         }
 
-        eos_static_info("metacache::flush ino=%016lx", (unsigned long long) ino);
+        if (!fe.merge(*it)) {
+          break;
+        }
+
+        it = queue.erase(it);
+      }
+    }
+  }
 
-        if (op != metad::mdx::LSTORE) {
-          XrdSysMutexHelper mdLock(md->Locker());
+  if (entries.empty()) {
+    entries.push_back(fe);
+  }
 
-          if (!md->md_pino()) {
-            // when creating objects locally faster than pushed upstream
-            // we might not know the remote parent id when we insert a local
-            // creation request
-            shared_md pmd;
+  for (auto& e : entries) {
+    inflight.add(e);
 
-            if (mdmap.retrieveTS(md->pid(), pmd)) {
-              // TODO: check if we need to lock pmd? But then we have to enforce
-              // locking order child -> parent
-              uint64_t md_pino = pmd->md_ino();
-              eos_static_info("metacache::flush providing parent inode %016lx to %016lx",
-                              md->id(), md_pino);
-              md->set_md_pino(md_pino);
-            } else {
-              eos_static_crit("metacache::flush ino=%016lx parent remote inode not known",
-                              (unsigned long long) ino);
-            }
-          }
+    if (e.barrier()) {
+      inflight_barrier++;
+    }
+  }
+
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+void
+metad::flushqueue::done(const std::vector<flushentry>& entries)
+{
+  for (auto& e : entries) {
+    inflight.remove(e);
+
+    if (e.barrier()) {
+      inflight_barrier--;
+    }
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void
+metad::flush_pino(shared_md md)
+{
+  if (!md->md_pino()) {
+    // when creating objects locally faster than pushed upstream
+    // we might not know the remote parent id when we insert a local
+    // creation request
+    shared_md pmd;
+
+    if (mdmap.retrieveTS(md->pid(), pmd)) {
+      // TODO: check if we need to lock pmd? But then we have to enforce
+      // locking order child -> parent
+      uint64_t md_pino = pmd->md_ino();
+      eos_static_info("metacache::flush providing parent inode %016lx to %016lx",
+                      md->id(), md_pino);
+      md->set_md_pino(md_pino);
+    } else {
+      eos_static_crit("metacache::flush ino=%016lx parent remote inode not known",
+                      (unsigned long long) md->id());
+    }
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void
+metad::flush_batch(const std::vector<flushentry>& entries)
+{
+  // all entries are creations in the same directory by the same user
+  std::vector<shared_md> mds;
+  std::vector<const flushentry*> sent;
+  eos::fusex::md_batch batch;
+
+  for (auto& fe : entries) {
+    shared_md md;
+
+    if (!mdmap.retrieveTS(fe.id(), md)) {
+      eos_static_crit("metacache::flush failed to retrieve ino=%016lx", fe.id());
+      continue;
+    }
+
+    XrdSysMutexHelper mdLock(md->Locker());
+    flush_pino(md);
+
+    if (md->deleted()) {
+      // if the md was deleted in the meanwhile does not need to
+      // push it remote, since the response creates a race condition
+      continue;
+    }
+
+    md->set_operation(md->SET);
+    eos::fusex::md* bmd = batch.add_md_();
+    *bmd = *md;
+    bmd->set_type(bmd->MD);
+    bmd->set_authid(fe.authid());
+    mds.push_back(md);
+    sent.push_back(&fe);
+  }
+
+  if (mds.empty()) {
+    return;
+  }
+
+  std::vector<int> rcs;
+  std::vector<uint64_t> md_inos;
+  eos_static_info("metacache::flush backend::putMDBatch - start n=%u",
+                  mds.size());
+  int rc = mdbackend->putMDBatch(entries.front().get_fuse_id(), batch, rcs,
+                                 md_inos);
+  eos_static_info("metacache::flush backend::putMDBatch - stop rc=%d", rc);
+
+  if (rc == -1) {
+    // the MGM does not support batches
+    for (auto fe : sent) {
+      flush_entry(*fe);
+    }
+
+    return;
+  }
+
+  if (rc) {
+    rcs.assign(mds.size(), rc);
+    md_inos.assign(mds.size(), 0);
+  }
+
+  for (size_t i = 0; i < mds.size(); ++i) {
+    shared_md md = mds[i];
+    std::string mdstream;
+    {
+      XrdSysMutexHelper mdLock(md->Locker());
+
+      if (rcs[i]) {
+        eos_static_err("metacache::flush backend::putMDBatch failed ino=%016lx rc=%d",
+                       md->id(), rcs[i]);
+        // in this case we always clean this MD record to force a refresh
+        inomap.erase_bwd(md->id());
+        md->set_err(rcs[i]);
+      } else {
+        if (md_inos[i]) {
+          md->set_md_ino(md_inos[i]);
         }
 
-        if (md->id()) {
-          uint64_t removeentry = 0;
-          {
-            md->Locker().Lock();
-            int rc = 0;
+        inomap.insert(md->md_ino(), md->id());
+      }
 
-            if (op == metad::mdx::RM) {
-              md->set_operation(md->DELETE);
-            } else {
-              md->set_operation(md->SET);
-            }
+      if (md->getop() != md->RM) {
+        md->setop_none();
+        md->clear_mv_authid();
+      }
 
-            if ((op != metad::mdx::RM) && md->deleted()) {
-              // if the md was deleted in the meanwhile does not need to
-              // push it remote, since the response creates a race condition
-              md->Locker().UnLock();
-              continue;
-            }
+      md->clear_implied_authid();
+      md->Signal();
+      md->SerializeToString(&mdstream);
+    }
+    EosFuse::Instance().getKV()->put(sent[i]->id(), mdstream);
+  }
+}
 
-            if (((op == metad::mdx::ADD) ||
-                 (op == metad::mdx::UPDATE) ||
-                 (op == metad::mdx::RM)) &&
-                md->id() != 1) {
-              eos_static_info("metacache::flush backend::putMD - start");
-              eos::fusex::md::TYPE mdtype = md->type();
-              md->set_type(md->MD);
+/* -------------------------------------------------------------------------- */
+void
+metad::flush_entry(const flushentry& fe)
+{
+  uint64_t ino = fe.id();
+  std::string authid = fe.authid();
+  fuse_id f_id = fe.get_fuse_id();
+  mdx::md_op op = fe.op();
 
-              // push to backend
-              if ((rc = mdbackend->putMD(f_id, &(*md), authid, &(md->Locker())))) {
-                eos_static_err("metacache::flush backend::putMD failed rc=%d", rc);
-                // in this case we always clean this MD record to force a refresh
-                inomap.erase_bwd(md->id());
-                //removeentry=md->id();
-                md->set_err(rc);
-              } else {
-                inomap.insert(md->md_ino(), md->id());
-              }
+  if (EOS_LOGS_DEBUG) {
+    eos_static_debug("metacache::flush ino=%016lx authid=%s op=%d", ino,
+                     authid.c_str(), (int) op);
+  }
 
-              if (md->getop() != md->RM) {
-                md->setop_none();
-                md->clear_mv_authid();
-              }
+  shared_md md;
 
-              md->set_type(mdtype);
-              md->Signal();
-              eos_static_info("metacache::flush backend::putMD - stop");
-            }
+  if (!mdmap.retrieveTS(ino, md)) {
+    eos_static_crit("metacache::flush failed to retrieve ino=%016lx", ino);
+    return;
+  }
 
-            if ((op == metad::mdx::ADD) || (op == metad::mdx::UPDATE) ||
-                (op == metad::mdx::LSTORE)) {
-              std::string mdstream;
-              md->SerializeToString(&mdstream);
-              md->Locker().UnLock();
-              EosFuse::Instance().getKV()->put(ino, mdstream);
-            } else {
-              md->Locker().UnLock();
+  eos_static_info("metacache::flush ino=%016lx", (unsigned long long) ino);
 
-              if (op == metad::mdx::RM) {
-                EosFuse::Instance().getKV()->erase(ino);
-                // this step is coupled to the forget function, since we cannot
-                // forget an entry if we didn't process the outstanding KV changes
-                stat.inodes_deleted_dec();
+  if (op != metad::mdx::LSTORE) {
+    XrdSysMutexHelper mdLock(md->Locker());
+    flush_pino(md);
+  }
 
-                if (EOS_LOGS_DEBUG) {
-                  eos_static_debug("count=%d(-%d) - ino=%016x", md->lookup_is(), 1, ino);
-                }
+  if (md->id()) {
+    uint64_t removeentry = 0;
+    {
+      md->Locker().Lock();
+      int rc = 0;
 
-                XrdSysMutexHelper mLock(md->Locker());
+      if (op == metad::mdx::RM) {
+        md->set_operation(md->DELETE);
+      } else {
+        md->set_operation(md->SET);
+      }
 
-                if (md->lookup_dec(1)) {
-                  // forget this inode
-                  removeentry = ino;
-                }
-              }
-            }
-          }
+      if ((op != metad::mdx::RM) && md->deleted()) {
+        // if the md was deleted in the meanwhile does not need to
+        // push it remote, since the response creates a race condition
+        md->Locker().UnLock();
+        return;
+      }
 
-          if (removeentry) {
-            shared_md pmd;
+      if (((op == metad::mdx::ADD) ||
+           (op == metad::mdx::UPDATE) ||
+           (op == metad::mdx::RM)) &&
+          md->id() != 1) {
+        eos_static_info("metacache::flush backend::putMD - start");
+        eos::fusex::md::TYPE mdtype = md->type();
+        md->set_type(md->MD);
+
+        // push to backend
+        if ((rc = mdbackend->putMD(f_id, &(*md), authid, &(md->Locker())))) {
+          eos_static_err("metacache::flush backend::putMD failed rc=%d", rc);
+          // in this case we always clean this MD record to force a refresh
+          inomap.erase_bwd(md->id());
+          //removeentry=md->id();
+          md->set_err(rc);
+        } else {
+          inomap.insert(md->md_ino(), md->id());
+        }
 
-            if (EOS_LOGS_DEBUG) {
-              eos_static_debug("delete md object - ino=%016x", removeentry);
-            }
+        if (md->getop() != md->RM) {
+          md->setop_none();
+          md->clear_mv_authid();
+        }
 
-            {
-              if (EOS_LOGS_DEBUG) {
-                eos_static_debug("calling forget function %016x", removeentry);
-              }
+        md->set_type(mdtype);
+        md->Signal();
+        eos_static_info("metacache::flush backend::putMD - stop");
+      }
 
-              forget(0, removeentry, 0);
-            }
+      if ((op == metad::mdx::ADD) || (op == metad::mdx::UPDATE) ||
+          (op == metad::mdx::LSTORE)) {
+        std::string mdstream;
+        md->SerializeToString(&mdstream);
+        md->Locker().UnLock();
+        EosFuse::Instance().getKV()->put(ino, mdstream);
+      } else {
+        md->Locker().UnLock();
 
-            {
-              if (pmd) {
-                XrdSysMutexHelper mmLock(pmd->Locker());
-                // we don't remote entries from the local deletion list because there could be
-                // a race condition of a thread doing MDLS overwriting the locally deleted entry
-                pmd->get_todelete().erase(md->name());
-                pmd->Signal();
-              }
-            }
+        if (op == metad::mdx::RM) {
+          EosFuse::Instance().getKV()->erase(ino);
+          EosFuse::Instance().getKV()->erase(ino, "c");
+          // this step is coupled to the forget function, since we cannot
+          // forget an entry if we didn't process the outstanding KV changes
+          stat.inodes_deleted_dec();
+
+          if (EOS_LOGS_DEBUG) {
+            eos_static_debug("count=%d(-%d) - ino=%016x", md->lookup_is(), 1, ino);
+          }
+
+          XrdSysMutexHelper mLock(md->Locker());
+
+          if (md->lookup_dec(1)) {
+            // forget this inode
+            removeentry = ino;
           }
         }
       }
     }
+
+    if (removeentry) {
+      shared_md pmd;
+
+      if (EOS_LOGS_DEBUG) {
+        eos_static_debug("delete md object - ino=%016x", removeentry);
+      }
+
+      {
+        if (EOS_LOGS_DEBUG) {
+          eos_static_debug("calling forget function %016x", removeentry);
+        }
+
+        forget(0, removeentry, 0);
+      }
+
+      {
+        if (pmd) {
+          XrdSysMutexHelper mmLock(pmd->Locker());
+          // we don't remote entries from the local deletion list because there could be
+          // a race condition of a thread doing MDLS overwriting the locally deleted entry
+          pmd->get_todelete().erase(md->name());
+          pmd->Signal();
+        }
+      }
+    }
   }
 }
 
@@ -2284,7 +2573,7 @@ metad::mdcommunicate(ThreadAssistant& assistant)
   hb.mutable_heartbeat_()->set_host(zmq_clienthost);
   hb.mutable_heartbeat_()->set_uuid(zmq_clientuuid);
   hb.mutable_heartbeat_()->set_version(VERSION);
-  hb.mutable_heartbeat_()->set_protversion(hb.heartbeat_().PROTOCOLV3);
+  hb.mutable_heartbeat_()->set_protversion(hb.heartbeat_().PROTOCOLV4);
   hb.mutable_heartbeat_()->set_pid((int32_t) getpid());
   hb.mutable_heartbeat_()->set_starttime(time(NULL));
   hb.set_type(hb.HEARTBEAT);
@@ -2332,8 +2621,20 @@ metad::mdcommunicate(ThreadAssistant& assistant)
 
           std::string s((const char*) zmq_msg_data(&message), zmq_msg_size(&message));
           rsp.Clear();
+          std::vector<eos::fusex::response> rsps;
+
+          if (!rsp.ParseFromString(s)) {
+            eos_static_err("unable to parse message");
+          } else if (rsp.type() == rsp.BATCH) {
+            // a batch carries several responses which are applied in order
+            rsps.assign(rsp.batch_().begin(), rsp.batch_().end());
+          } else {
+            rsps.push_back(rsp);
+          }
+
+          for (auto rit = rsps.begin(); rit != rsps.end(); ++rit) {
+            rsp.Swap(&(*rit));
 
-          if (rsp.ParseFromString(s)) {
             if (rsp.type() == rsp.EVICT) {
               eos_static_crit("evicted from MD server - reason: %s",
                               rsp.evict_().reason().c_str());
@@ -2354,6 +2655,12 @@ metad::mdcommunicate(ThreadAssistant& assistant)
                                   rsp.config_().hbrate());
                 interval = (int) rsp.config_().hbrate();
               }
+
+              // an MGM not knowing the features leaves them unset
+              eos_static_notice("MGM features: md-query=%d md-batch=%d",
+                                rsp.config_().mdquery(), rsp.config_().mdbatch());
+              mdbackend->set_features(rsp.config_().mdquery(),
+                                      rsp.config_().mdbatch());
             }
 
             if (rsp.type() == rsp.LEASE) {
@@ -2472,9 +2779,17 @@ metad::mdcommunicate(ThreadAssistant& assistant)
                   eos_static_debug("%s op=%d", md->dump().c_str(), md->getop());
                 }
 
+                std::string md_name = md->name();
                 // update the local store
                 update(req, md, authid, true);
                 md->Locker().UnLock();
+                shared_md pmd;
+
+                if (pino && mdmap.retrieveTS(pino, pmd)) {
+                  // a created or renamed entry is not unknown anymore
+                  XrdSysMutexHelper pLock(pmd->Locker());
+                  pmd->forget_negative(md_name);
+                }
                 // adjust local quota
                 cap::shared_cap cap = EosFuse::Instance().caps.get(pino, md_clientid);
 
@@ -2554,8 +2869,6 @@ metad::mdcommunicate(ThreadAssistant& assistant)
                 md->Locker().UnLock();
               }
             }
-          } else {
-            eos_static_err("unable to parse message");
           }
 
           zmq_msg_close(&message);
@@ -2604,6 +2917,164 @@ metad::mdcommunicate(ThreadAssistant& assistant)
   }
 }
 
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+metad::mdsnapshot(ThreadAssistant& assistant)
+/* -------------------------------------------------------------------------- */
+{
+  while (!assistant.terminationRequested()) {
+    assistant.wait_for(std::chrono::seconds(60));
+    snapshot();
+  }
+
+  // the flusher threads are stopped already, store the final state
+  snapshot();
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+metad::snapshot()
+/* -------------------------------------------------------------------------- */
+{
+  // md records are stored in the KV store by the flusher, but the local
+  // listing of a directory lives only in memory - it is stored under the
+  // 'c' namespace together with the clock of the record it belongs to
+  std::vector<shared_md> mds;
+
+  for (size_t i = 0; i < mdmap.shards(); ++i) {
+    pmap::Shard& shard = mdmap.shard(i);
+    XrdSysMutexHelper sLock(shard);
+
+    for (auto it = shard.map.begin(); it != shard.map.end(); ++it) {
+      mds.push_back(it->second);
+    }
+  }
+
+  std::map<fuse_ino_t, size_t> digest;
+  size_t stored = 0;
+
+  for (auto it = mds.begin(); it != mds.end(); ++it) {
+    shared_md md = *it;
+    eos::fusex::md listing;
+    fuse_ino_t ino = 0;
+    std::vector<fuse_ino_t> children;
+    {
+      XrdSysMutexHelper mLock(md->Locker());
+
+      if (!md->id() || !S_ISDIR(md->mode()) || md->deleted() ||
+          (md->type() != md->MDLS)) {
+        continue;
+      }
+
+      ino = md->id();
+      listing.set_clock(md->clock());
+
+      for (auto c = md->local_children().begin(); c != md->local_children().end();
+           ++c) {
+        (*listing.mutable_children())[c->first] = c->second;
+        children.push_back(c->second);
+      }
+    }
+    // a listing with changes not yet known to the MGM would be trusted
+    // after a restart although the MGM clock did not move
+    bool pending = has_flush(ino);
+
+    for (auto c = children.begin(); !pending && (c != children.end()); ++c) {
+      pending = has_flush(*c);
+    }
+
+    if (pending) {
+      continue;
+    }
+
+    std::string lstream;
+    listing.SerializeToString(&lstream);
+    size_t d = std::hash<std::string>()(lstream);
+    auto last = snapshot_digest.find(ino);
+
+    if ((last != snapshot_digest.end()) && (last->second == d)) {
+      digest[ino] = d;
+      continue;
+    }
+
+    if (EosFuse::Instance().getKV()->put(ino, lstream, "c")) {
+      eos_static_err("failed to store listing of ino=%016lx", ino);
+      continue;
+    }
+
+    digest[ino] = d;
+    stored++;
+  }
+
+  snapshot_digest.swap(digest);
+  eos_static_info("stored %lu of %lu listings", stored, snapshot_digest.size());
+}
+
+/* -------------------------------------------------------------------------- */
+bool
+/* -------------------------------------------------------------------------- */
+metad::load(fuse_ino_t ino, shared_md& md)
+/* -------------------------------------------------------------------------- */
+{
+  std::string mdstream;
+  shared_md lmd = std::make_shared<mdx>();
+
+  if (EosFuse::Instance().getKV()->get(ino, mdstream) ||
+      !lmd->ParseFromString(mdstream) || (lmd->id() != ino) ||
+      !lmd->md_ino()) {
+    return false;
+  }
+
+  // nothing of a previous run is trusted before the MGM confirmed the clock
+  lmd->revalidate = true;
+  lmd->set_creator(false);
+  lmd->clear_capability();
+  lmd->set_type(lmd->MD);
+  lmd->setop_none();
+
+  if (S_ISDIR(lmd->mode())) {
+    std::string lstream;
+    eos::fusex::md listing;
+
+    if (!EosFuse::Instance().getKV()->get(ino, lstream, "c") &&
+        listing.ParseFromString(lstream) && (listing.clock() == lmd->clock())) {
+      for (auto it = listing.children().begin(); it != listing.children().end();
+           ++it) {
+        lmd->local_children()[it->first] = it->second;
+      }
+
+      lmd->set_type(lmd->MDLS);
+    }
+
+    lmd->mutable_children()->clear();
+    lmd->set_nchildren(lmd->local_children().size());
+  }
+
+  inomap.insert(lmd->md_ino(), ino);
+  {
+    pmap::Shard& s = mdmap.shard_of(ino);
+    XrdSysMutexHelper sLock(s);
+    auto it = s.map.find(ino);
+
+    if (it != s.map.end()) {
+      // loaded by someone else in the meanwhile
+      md = it->second;
+      return true;
+    }
+
+    s.map[ino] = lmd;
+  }
+  md = lmd;
+  stat.inodes_inc();
+  stat.inodes_ever_inc();
+  stat.inodes_warm_inc();
+  eos_static_info("warm-start ino=%016lx remote-ino=%016lx type=%d children=%lu",
+                  ino, lmd->md_ino(), lmd->type(), lmd->local_children().size());
+  return true;
+}
+
 /* -------------------------------------------------------------------------- */
 void
 metad::vmap::insert(fuse_ino_t a, fuse_ino_t b)
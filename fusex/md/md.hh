@@ -36,6 +36,7 @@
 #include "common/RWMutex.hh"
 #include "common/AssistedThread.hh"
 #include "misc/FuseId.hh"
+#include "misc/ShardedMap.hh"
 #include "XrdSys/XrdSysPthread.hh"
 #include <memory>
 #include <map>
@@ -68,7 +69,7 @@ public:
       ADD, MV, UPDATE, RM, SETSIZE, LSTORE, NONE
     };
 
-    mdx() : mSync(1)
+    mdx() : mSync(1), cap_gen(0), negative_gen(0), negative_changes(0)
     {
       setop_add();
       lookup_cnt.store(0, std::memory_order_seq_cst);
@@ -77,6 +78,8 @@ public:
       cap_count_reset();
       refresh = false;
       inline_size = 0;
+      inline_only = false;
+      revalidate = false;
     }
 
     mdx(fuse_ino_t ino) : mdx()
@@ -216,11 +219,13 @@ public:
     {
       // atomic operation, no need to lock before calling
       cap_cnt.fetch_sub(1, std::memory_order_seq_cst);
+      cap_gen.fetch_add(1, std::memory_order_seq_cst);
     }
 
     void cap_count_reset()
     {
       cap_cnt.store(0, std::memory_order_seq_cst);
+      cap_gen.fetch_add(1, std::memory_order_seq_cst);
     }
 
     int cap_count()
@@ -269,6 +274,54 @@ public:
       return _local_children;
     }
 
+    // -------------------------------------------------------------------------
+    // negative lookup cache: names which the MGM reported as not existing in
+    // this directory. The entries are only trusted while we hold a cap on the
+    // directory, since only then we receive the broadcasts of new entries.
+    // Any cap expiry or release drops all entries. Must be called with a lock.
+    // -------------------------------------------------------------------------
+
+    bool is_negative(const std::string& name)
+    {
+      sync_negative();
+      return _negative_children.count(name);
+    }
+
+    // epoch to take before asking the MGM about a name
+    uint64_t negative_epoch()
+    {
+      return cap_gen.load() + negative_changes;
+    }
+
+    // store a name unless an entry or a cap changed since epoch
+    bool add_negative(const std::string& name, uint64_t epoch)
+    {
+      sync_negative();
+
+      if (epoch != negative_epoch()) {
+        return false;
+      }
+
+      if (_negative_children.size() >= max_negative) {
+        _negative_children.clear();
+      }
+
+      _negative_children.insert(name);
+      return true;
+    }
+
+    void forget_negative(const std::string& name)
+    {
+      negative_changes++;
+      _negative_children.erase(name);
+    }
+
+    size_t negative_size()
+    {
+      sync_negative();
+      return _negative_children.size();
+    }
+
     const uint64_t inlinesize()
     {
       return inline_size;
@@ -279,16 +332,56 @@ public:
       inline_size = inlinesize;
     }
 
+    const std::string& inlinecompressor()
+    {
+      return inline_compressor;
+    }
+
+    void set_inlinecompressor(const std::string& compressor)
+    {
+      inline_compressor = compressor;
+    }
+
+    const bool inlineonly()
+    {
+      return inline_only;
+    }
+
+    void set_inlineonly(bool inlineonly)
+    {
+      inline_only = inlineonly;
+    }
+
   private:
+    static const size_t max_negative = 16384;
+
+    void sync_negative()
+    {
+      if (negative_gen != cap_gen.load()) {
+        // a cap was dropped since the entries have been stored
+        _negative_children.clear();
+        negative_gen = cap_gen.load();
+      }
+    }
+
     XrdSysMutex mLock;
     XrdSysCondVar mSync;
     std::atomic<md_op> op;
     std::atomic<int> lookup_cnt;
     std::atomic<int> cap_cnt;
+    std::atomic<uint64_t> cap_gen;
+    uint64_t negative_gen;
+    uint64_t negative_changes;
+    std::set<std::string> _negative_children;
     std::atomic<int> opendir_cnt;
     bool lock_remote;
     bool refresh;
+    // reloaded by a warm start, the next fetch only asks if it changed
+    bool revalidate;
     uint64_t inline_size;
+    std::string inline_compressor;
+    // created in a directory keeping new files in the namespace only
+    bool inline_only;
     std::vector<struct flock> locktable;
     std::map<std::string, uint64_t> todelete;
     std::map<std::string, uint64_t> _local_children;
@@ -333,7 +426,7 @@ public:
     XrdSysMutex mMutex;
   };
 
-  class pmap : public std::map<fuse_ino_t, shared_md>, public XrdSysMutex
+  class pmap : public ShardedMap<fuse_ino_t, shared_md>
   //----------------------------------------------------------------------------
   {
   public:
@@ -342,83 +435,58 @@ public:
 
     virtual ~pmap() { }
 
+    // TS stands for "thread-safe"
+
     bool retrieveOrCreateTS(fuse_ino_t ino, shared_md& ret)
     {
-      XrdSysMutexHelper mLock(this);
+      Shard& s = shard_of(ino);
+      XrdSysMutexHelper mLock(s);
+      auto it = s.map.find(ino);
 
-      if (this->retrieve(ino, ret)) {
+      if (it != s.map.end()) {
+        ret = it->second;
         return false;
       }
 
       ret = std::make_shared<mdx>();
 
       if (ino) {
-        (*this)[ino] = ret;
+        s.map[ino] = ret;
       }
 
       return true;
     }
 
-    // TS stands for "thread-safe"
-
-    bool retrieveTS(fuse_ino_t ino, shared_md& ret)
-    {
-      XrdSysMutexHelper mLock(this);
-      return this->retrieve(ino, ret);
-    }
-
-    bool retrieve(fuse_ino_t ino, shared_md& ret)
-    {
-      auto it = this->find(ino);
-
-      if (it == this->end()) {
-        return false;
-      }
-
-      ret = it->second;
-      return true;
-    }
-
-    // TS stands for "thread-safe"
-
-    void insertTS(fuse_ino_t ino, shared_md& md)
-    {
-      XrdSysMutexHelper mLock(this);
-      (*this)[ino] = md;
-    }
-
-    // TS stands for "thread-safe"
-
-    void eraseTS(fuse_ino_t ino)
-    {
-      XrdSysMutexHelper mLock(this);
-      this->erase(ino);
-    }
-
     void retrieveWithParentTS(fuse_ino_t ino, shared_md& md, shared_md& pmd)
     {
       // Atomically retrieve md objects for an inode, and its parent.
       while (true) {
-        // In this particular case, we need to first lock mdmap, and then
+        // In this particular case, we need to first lock the shard, and then
         // md.. The following algorithm is meant to avoid deadlocks with code
-        // which locks md first, and then mdmap.
+        // which locks md first, and then a shard.
         md.reset();
         pmd.reset();
-        XrdSysMutexHelper mLock(this);
+        Shard& s = shard_of(ino);
+        XrdSysMutexHelper mLock(s);
+        auto it = s.map.find(ino);
 
-        if (!retrieve(ino, md)) {
+        if (it == s.map.end()) {
           return; // ino not there, nothing to do
         }
 
+        md = it->second;
+
         // md has been found. Can we lock it?
         if (md->Locker().CondLock()) {
-          // Success!
-          retrieve(md->pid(), pmd);
+          // Success! The parent can live in another shard, which we may only
+          // lock after releasing ours - the locked md keeps its pid stable
+          mLock.UnLock();
+          retrieveTS(md->pid(), pmd);
           md->Locker().UnLock();
           return;
         }
 
-        // Nope, unlock mdmap and try again.
+        // Nope, unlock the shard and try again.
         mLock.UnLock();
         std::this_thread::sleep_for(std::chrono::milliseconds(1));
       }
@@ -501,11 +569,20 @@ public:
 
   int statvfs(fuse_req_t req, struct statvfs* svfs);
 
-  void mdcflush(ThreadAssistant& assistant); // thread pushing into md cache
+  void mdcflush(ThreadAssistant& assistant); // thread(s) pushing into md cache
 
   void mdcommunicate(ThreadAssistant&
                      assistant); // thread interacting with the MGM for meta data
 
+  void mdsnapshot(ThreadAssistant&
+                  assistant); // thread persisting listings for a warm start
+
+  // persist the local listings of all completely listed directories
+  void snapshot();
+
+  // warm start: restore an md record and its listing from the local KV store
+  bool load(fuse_ino_t ino, shared_md& md);
+
   int connect(std::string zmqtarget, std::string zmqidentity = "",
               std::string zmqname = "", std::string zmqclienthost = "",
               std::string zmqclientuuid = "");
@@ -538,6 +615,10 @@ public:
       _inodes_deleted.store(0, std::memory_order_seq_cst);
       _inodes_deleted_ever.store(0, std::memory_order_seq_cst);
       _inodes_backlog.store(0, std::memory_order_seq_cst);
+      _lookups_negative_hit.store(0, std::memory_order_seq_cst);
+      _lookups_negative_stored.store(0, std::memory_order_seq_cst);
+      _inodes_warm.store(0, std::memory_order_seq_cst);
+      _inodes_revalidated.store(0, std::memory_order_seq_cst);
     }
 
     void inodes_inc()
@@ -580,6 +661,26 @@ public:
       _inodes_deleted.fetch_sub(1, std::memory_order_seq_cst);
     }
 
+    void lookups_negative_hit_inc()
+    {
+      _lookups_negative_hit.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    void lookups_negative_stored_inc()
+    {
+      _lookups_negative_stored.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    void inodes_warm_inc()
+    {
+      _inodes_warm.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    void inodes_revalidated_inc()
+    {
+      _inodes_revalidated.fetch_add(1, std::memory_order_seq_cst);
+    }
+
     void inodes_backlog_store(ssize_t n)
     {
       _inodes_backlog.store(n, std::memory_order_seq_cst);
@@ -616,6 +717,26 @@ public:
       return _inodes_backlog.load();
     }
 
+    ssize_t lookups_negative_hit()
+    {
+      return _lookups_negative_hit.load();
+    }
+
+    ssize_t lookups_negative_stored()
+    {
+      return _lookups_negative_stored.load();
+    }
+
+    ssize_t inodes_warm()
+    {
+      return _inodes_warm.load();
+    }
+
+    ssize_t inodes_revalidated()
+    {
+      return _inodes_revalidated.load();
+    }
+
   private:
     std::atomic<ssize_t> _inodes;
     std::atomic<ssize_t> _inodes_stacked;
@@ -623,6 +744,10 @@ public:
     std::atomic<ssize_t> _inodes_backlog;
     std::atomic<ssize_t> _inodes_ever;
     std::atomic<ssize_t> _inodes_deleted_ever;
+    std::atomic<ssize_t> _lookups_negative_hit;
+    std::atomic<ssize_t> _lookups_negative_stored;
+    std::atomic<ssize_t> _inodes_warm;
+    std::atomic<ssize_t> _inodes_revalidated;
   };
 
   mdstat& stats()
@@ -697,7 +822,8 @@ public:
   public:
 
     flushentry(const uint64_t id, const std::string& aid, mdx::md_op o,
-               fuse_req_t req = 0) : _id(id), _authid(aid), _op(o)
+               fuse_req_t req = 0, uint64_t pid = 0, bool barrier = false) :
+      _id(id), _pid(pid), _authid(aid), _op(o), _barrier(barrier), _count(1)
     {
       if (req) {
         _fuse_id = fuse_id(req);
@@ -721,34 +847,223 @@ public:
       return _id;
     }
 
+    // parent inode at the time the entry was queued
+    uint64_t pid() const
+    {
+      return _pid;
+    }
+
+    // a barrier is flushed alone, after everything queued before it and
+    // before anything queued after it e.g. a rename
+    bool barrier() const
+    {
+      return _barrier;
+    }
+
+    // true if the entry is pushed to the MGM and not only to the local store
+    bool remote() const
+    {
+      return (_op != mdx::LSTORE);
+    }
+
+    // number of queued entries represented by this entry after coalescing
+    size_t count() const
+    {
+      return _count;
+    }
+
     fuse_id get_fuse_id() const
     {
       return _fuse_id;
     }
 
-    static std::deque<flushentry> merge(std::deque<flushentry>& f)
+    //--------------------------------------------------------------------------
+    //! Absorb a later entry of the same inode - the flush pushes the state
+    //! of the md record at flush time, hence a later update is redundant if
+    //! it is sent by the same authid and nothing in between depends on it
+    //!
+    //! @return true if absorbed
+    //--------------------------------------------------------------------------
+    bool merge(const flushentry& e)
     {
-      return f;
+      if ((e._id != _id) || e._barrier || _barrier) {
+        return false;
+      }
+
+      if ((e._op == mdx::LSTORE) && (_op != mdx::RM)) {
+        _count += e._count;
+        return true;
+      }
+
+      if ((e._op == mdx::UPDATE) && ((_op == mdx::ADD) ||
+                                     (_op == mdx::UPDATE)) &&
+          (e._authid == _authid)) {
+        _count += e._count;
+        return true;
+      }
+
+      return false;
     }
 
     static std::string dump(flushentry& e)
     {
       std::string out;
       char line[1024];
-      snprintf(line, sizeof(line), "authid=%s op=%d id=%lu uid=%u gid=%u pid=%u",
-               e.authid().c_str(), (int) e.op(), e.id(), e.get_fuse_id().uid,
-               e.get_fuse_id().gid, e.get_fuse_id().pid);
+      snprintf(line, sizeof(line),
+               "authid=%s op=%d id=%lu parent=%lu barrier=%d count=%lu uid=%u gid=%u pid=%u",
+               e.authid().c_str(), (int) e.op(), e.id(), e._pid, e._barrier,
+               e._count, e.get_fuse_id().uid, e.get_fuse_id().gid,
+               e.get_fuse_id().pid);
       out += line;
       return out;
     }
 
   private:
     uint64_t _id;
+    uint64_t _pid;
     std::string _authid;
     mdx::md_op _op;
+    bool _barrier;
+    size_t _count;
     fuse_id _fuse_id;
   };
 
+  //----------------------------------------------------------------------------
+  //! Ordering dependencies between flush entries. An entry has to wait for a
+  //! tracked entry if it concerns the same inode, if one is the parent of the
+  //! other (create-before-write, children before their directory) or if a
+  //! creation and a deletion happen in the same directory (names can be
+  //! reused). Local store entries only depend on entries of the same inode.
+  //----------------------------------------------------------------------------
+  class flushdeps
+  {
+  public:
+    void add(const flushentry& e)
+    {
+      ino.insert(e.id());
+
+      if (e.remote()) {
+        remote.insert(e.id());
+        pid.insert(e.pid());
+
+        if (e.op() == mdx::ADD) {
+          addpid.insert(e.pid());
+        }
+
+        if (e.op() == mdx::RM) {
+          rmpid.insert(e.pid());
+        }
+      }
+    }
+
+    void remove(const flushentry& e)
+    {
+      erase_one(ino, e.id());
+
+      if (e.remote()) {
+        erase_one(remote, e.id());
+        erase_one(pid, e.pid());
+
+        if (e.op() == mdx::ADD) {
+          erase_one(addpid, e.pid());
+        }
+
+        if (e.op() == mdx::RM) {
+          erase_one(rmpid, e.pid());
+        }
+      }
+    }
+
+    bool blocks(const flushentry& e) const
+    {
+      if (ino.count(e.id())) {
+        return true;
+      }
+
+      if (!e.remote()) {
+        return false;
+      }
+
+      if (pid.count(e.id()) || remote.count(e.pid())) {
+        return true;
+      }
+
+      if ((e.op() == mdx::ADD) && rmpid.count(e.pid())) {
+        return true;
+      }
+
+      if ((e.op() == mdx::RM) && addpid.count(e.pid())) {
+        return true;
+      }
+
+      return false;
+    }
+
+    bool empty() const
+    {
+      return ino.empty();
+    }
+
+  private:
+    static void erase_one(std::multiset<uint64_t>& set, uint64_t v)
+    {
+      auto it = set.find(v);
+
+      if (it != set.end()) {
+        set.erase(it);
+      }
+    }
+
+    std::multiset<uint64_t> ino; // inodes of all entries
+    std::multiset<uint64_t> remote; // inodes of remote entries
+    std::multiset<uint64_t> pid; // parents of remote entries
+    std::multiset<uint64_t> addpid; // parents of creations
+    std::multiset<uint64_t> rmpid; // parents of deletions
+  };
+
+  //----------------------------------------------------------------------------
+  //! Queue of the flush entries shared by the flusher threads - not thread
+  //! safe, used with mdflush locked
+  //----------------------------------------------------------------------------
+  class flushqueue
+  {
+  public:
+    flushqueue() : inflight_barrier(0) { }
+
+    void push_back(const flushentry& e)
+    {
+      queue.push_back(e);
+    }
+
+    size_t size() const
+    {
+      return queue.size();
+    }
+
+    //--------------------------------------------------------------------------
+    //! Pick the next entries to flush: the oldest entry which depends neither
+    //! on an entry in flight nor on an entry queued before it, followed by
+    //! sibling creations which can be sent in the same batch. Later updates
+    //! of the picked inode are coalesced into it.
+    //!
+    //! @param entries filled with the entries to flush
+    //! @param max_batch maximum number of creations flushed together
+    //!
+    //! @return false if nothing can be flushed now
+    //--------------------------------------------------------------------------
+    bool next(std::vector<flushentry>& entries, size_t max_batch);
+
+    //--------------------------------------------------------------------------
+    //! Release entries returned by next after their flush
+    //--------------------------------------------------------------------------
+    void done(const std::vector<flushentry>& entries);
+
+  private:
+    std::deque<flushentry> queue; // linear queue with all entries to flush
+    flushdeps inflight; // entries currently pushed by a flusher thread
+    size_t inflight_barrier; // number of barriers currently pushed
+  };
+
   typedef std::deque<flushentry> flushentry_set_t;
 
   void set_zmq_wants_to_connect(int val)
@@ -800,6 +1115,17 @@ private:
   };
 
   bool determineLockOrder(shared_md md1, shared_md md2);
+
+  // pick the next entries to flush - called with mdflush locked
+  bool flush_next(std::vector<flushentry>& entries, size_t max_batch);
+  // release entries after their flush - called with mdflush locked
+  void flush_done(const std::vector<flushentry>& entries);
+  // push a single entry to the MGM and the local store
+  void flush_entry(const flushentry& fe);
+  // push sibling creations to the MGM with a single request
+  void flush_batch(const std::vector<flushentry>& entries);
+  // provide the remote parent inode if not known yet - md has to be locked
+  void flush_pino(shared_md md);
   bool isChild(shared_md potentialChild, fuse_ino_t parentId);
 
   pmap mdmap;
@@ -811,7 +1137,7 @@ private:
   XrdSysCondVar mdflush;
 
   std::map<uint64_t, size_t> mdqueue; // inode, counter of mds to flush
-  std::deque<flushentry> mdflushqueue; // linear queue with all entries to flush
+  flushqueue mdflushqueue; // entries to flush and entries in flight
 
   size_t mdqueue_max_backlog;
 
@@ -826,6 +1152,9 @@ private:
   std::mutex zmq_socket_mutex;
   std::atomic<int> want_zmq_connect;
 
+  // digest of the listing last persisted per directory - used by snapshot()
+  std::map<fuse_ino_t, size_t> snapshot_digest;
+
   backend* mdbackend;
 };
 
@@ -0,0 +1,252 @@
+//------------------------------------------------------------------------------
+//! @file ShardedMap.hh
+//! @brief Hash map split into independently locked shards
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef FUSE_SHARDED_MAP_HH_
+#define FUSE_SHARDED_MAP_HH_
+
+#include "XrdSys/XrdSysPthread.hh"
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+//------------------------------------------------------------------------------
+//! Hash map split into a power of two number of shards, each protected by its
+//! own mutex. Operations on keys falling into different shards never contend.
+//!
+//! Functions with a TS suffix lock the shard themselves. Compound operations
+//! lock a single shard via shard_of() and work on its map directly. Iterating
+//! the whole map visits one shard after the other, holding only the lock of
+//! the visited shard, hence it does not give a consistent snapshot. A user
+//! locking a second shard while holding one has to do so in a fixed order of
+//! keys and must not use lock_all().
+//------------------------------------------------------------------------------
+
+template < typename Key, typename Value, typename Hash = std::hash<Key> >
+class ShardedMap
+{
+public:
+  typedef std::unordered_map<Key, Value, Hash> map_t;
+
+  class Shard : public XrdSysMutex
+  {
+  public:
+    map_t map;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param nshards number of shards, rounded up to a power of two
+  //----------------------------------------------------------------------------
+  explicit ShardedMap(size_t nshards = 64) : mNumShards(1)
+  {
+    while (mNumShards < nshards) {
+      mNumShards <<= 1;
+    }
+
+    mShards.reset(new Shard[mNumShards]);
+  }
+
+  virtual ~ShardedMap() { }
+
+  size_t shards() const
+  {
+    return mNumShards;
+  }
+
+  Shard& shard(size_t i)
+  {
+    return mShards[i];
+  }
+
+  Shard& shard_of(const Key& key)
+  {
+    size_t h = Hash()(key);
+    // mix the upper bits in, sequential keys still spread round robin
+    h ^= (h >> 16) ^ (h >> 32);
+    return mShards[h & (mNumShards - 1)];
+  }
+
+  bool retrieveTS(const Key& key, Value& value)
+  {
+    Shard& s = shard_of(key);
+    XrdSysMutexHelper mLock(s);
+    auto it = s.map.find(key);
+
+    if (it == s.map.end()) {
+      return false;
+    }
+
+    value = it->second;
+    return true;
+  }
+
+  void insertTS(const Key& key, const Value& value)
+  {
+    Shard& s = shard_of(key);
+    XrdSysMutexHelper mLock(s);
+    s.map[key] = value;
+  }
+
+  bool eraseTS(const Key& key)
+  {
+    Shard& s = shard_of(key);
+    XrdSysMutexHelper mLock(s);
+    return s.map.erase(key);
+  }
+
+  bool countTS(const Key& key)
+  {
+    Shard& s = shard_of(key);
+    XrdSysMutexHelper mLock(s);
+    return s.map.count(key);
+  }
+
+  size_t sizeTS()
+  {
+    size_t n = 0;
+
+    for (size_t i = 0; i < mNumShards; ++i) {
+      XrdSysMutexHelper mLock(mShards[i]);
+      n += mShards[i].map.size();
+    }
+
+    return n;
+  }
+
+  void clearTS()
+  {
+    for (size_t i = 0; i < mNumShards; ++i) {
+      XrdSysMutexHelper mLock(mShards[i]);
+      mShards[i].map.clear();
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Call f(key, value) for every entry, one shard locked at a time
+  //----------------------------------------------------------------------------
+  void for_eachTS(const std::function<void(const Key&, Value&)>& f)
+  {
+    for (size_t i = 0; i < mNumShards; ++i) {
+      XrdSysMutexHelper mLock(mShards[i]);
+
+      for (auto it = mShards[i].map.begin(); it != mShards[i].map.end(); ++it) {
+        f(it->first, it->second);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Erase every entry for which pred(key, value) is true, one shard locked
+  //! at a time
+  //!
+  //! @return number of erased entries
+  //----------------------------------------------------------------------------
+  size_t erase_ifTS(const std::function<bool(const Key&, Value&)>& pred)
+  {
+    size_t n = 0;
+
+    for (size_t i = 0; i < mNumShards; ++i) {
+      XrdSysMutexHelper mLock(mShards[i]);
+
+      for (auto it = mShards[i].map.begin(); it != mShards[i].map.end();) {
+        if (pred(it->first, it->second)) {
+          it = mShards[i].map.erase(it);
+          n++;
+        } else {
+          ++it;
+        }
+      }
+    }
+
+    return n;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Move the entry of a key to another key. f(value) is called while the
+  //! shard of the old key is locked, the entry is inserted under the new key
+  //! after releasing it, so no two shards are ever locked at the same time -
+  //! both keys may even fall into the same shard.
+  //!
+  //! @param value set to the moved value
+  //!
+  //! @return true if the old key was found and moved
+  //----------------------------------------------------------------------------
+  bool moveTS(const Key& from, const Key& to, Value& value,
+              const std::function<void(Value&)>& f)
+  {
+    {
+      Shard& s = shard_of(from);
+      XrdSysMutexHelper mLock(s);
+      auto it = s.map.find(from);
+
+      if (it == s.map.end()) {
+        return false;
+      }
+
+      value = it->second;
+      f(value);
+      s.map.erase(it);
+    }
+    insertTS(to, value);
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Lock/unlock all the shards e.g. to freeze the map during a global
+  //! operation - use sparingly
+  //----------------------------------------------------------------------------
+  void lock_all()
+  {
+    for (size_t i = 0; i < mNumShards; ++i) {
+      mShards[i].Lock();
+    }
+  }
+
+  void unlock_all()
+  {
+    for (size_t i = mNumShards; i > 0; --i) {
+      mShards[i - 1].UnLock();
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Size of the map - shards have to be locked by the caller
+  //----------------------------------------------------------------------------
+  size_t size_nolock() const
+  {
+    size_t n = 0;
+
+    for (size_t i = 0; i < mNumShards; ++i) {
+      n += mShards[i].map.size();
+    }
+
+    return n;
+  }
+
+private:
+  size_t mNumShards;
+  std::unique_ptr<Shard[]> mShards;
+};
+
+#endif
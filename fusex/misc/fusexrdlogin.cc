@@ -27,6 +27,7 @@
 #include "common/Macros.hh"
 #include "common/SymKeys.hh"
 #include "misc/FuseId.hh"
+#include "data/xrdclproxy.hh"
 #include <algorithm>
 #ifdef __APPLE__
 #define ECHRNG 44
@@ -75,6 +76,8 @@ int fusexrdlogin::loginurl(XrdCl::URL& url,
   }
 
   url.SetUserName(username);
+  // the MGM channel of this login uses a single stream
+  XrdCl::Proxy::mgm_channel(url);
   int rc = 0;
   eos_static_notice("%s uid=%u gid=%u rc=%d user-name=%s",
                     EosFuse::dump(id, ino, 0, rc).c_str(),
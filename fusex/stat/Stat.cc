@@ -66,6 +66,28 @@ Stat::AddExec(const char* tag, float exectime)
   Mutex.UnLock();
 }
 
+/*----------------------------------------------------------------------------*/
+void
+Stat::AddListing(const char* tag, uid_t uid, gid_t gid,
+                 unsigned long nentries, double exectime)
+{
+  std::string entries = std::string(tag) + ":entries";
+  std::string cost = std::string(tag) + ":ms/entry";
+  Mutex.Lock();
+  StatsUid[entries][uid] += nentries;
+  StatsGid[entries][gid] += nentries;
+  StatAvgUid[entries][uid].Add(nentries);
+  StatAvgGid[entries][gid].Add(nentries);
+
+  if (nentries) {
+    double per_entry = exectime / nentries;
+    StatExtUid[cost][uid].Insert(nentries, per_entry, per_entry, per_entry);
+    StatExtGid[cost][gid].Insert(nentries, per_entry, per_entry, per_entry);
+  }
+
+  Mutex.UnLock();
+}
+
 /*----------------------------------------------------------------------------*/
 unsigned long long
 Stat::GetTotal(const char* tag)
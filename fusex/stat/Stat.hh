@@ -526,6 +526,11 @@ public:
 
   void AddExec(const char* tag, float exectime);
 
+  // account a listing of nentries which took exectime ms: counts the entries
+  // in <tag>:entries and the cost per entry in <tag>:ms/entry
+  void AddListing(const char* tag, uid_t uid, gid_t gid,
+                  unsigned long nentries, double exectime);
+
   unsigned long long GetTotal(const char* tag);
 
   // warning: you have to lock the mutex if directly used
@@ -0,0 +1,169 @@
+//------------------------------------------------------------------------------
+//! @file block-index.cc
+//! @brief Tests of the LRU index of the disk cache blocks
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "fusex/data/blockindex.hh"
+#include "gtest/gtest.h"
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+const size_t bs = 1024;
+typedef std::vector<std::pair<fuse_ino_t, off_t> > evicted_t;
+}
+
+TEST(BlockIndex, Residency)
+{
+  evicted_t evicted;
+  blockindex index(bs, 0, [&evicted](fuse_ino_t ino, off_t offset, size_t) {
+    evicted.push_back(std::make_pair(ino, offset));
+  });
+  // nothing cached yet
+  ASSERT_EQ(index.lookup(1, 0, 100), 0u);
+  ASSERT_EQ(index.prefix(1), 0);
+  // a short write up to the end of file defines the first block
+  index.insert(1, 0, 100, 100);
+  ASSERT_EQ(index.lookup(1, 0, 100), 100u);
+  ASSERT_EQ(index.prefix(1), (off_t) bs);
+  // a write in the middle of a file defines only the blocks it covers
+  index.insert(2, 100, 3 * bs, 10 * bs);
+  ASSERT_EQ(index.lookup(2, 0, bs), 0u);
+  ASSERT_EQ(index.lookup(2, bs, 3 * bs), 2 * bs);
+  ASSERT_EQ(index.prefix(2), 0);
+  // reads stop at the first block which is not resident
+  index.insert(3, 0, 2 * bs, 4 * bs);
+  index.insert(3, 3 * bs, bs, 4 * bs);
+  ASSERT_EQ(index.lookup(3, 0, 4 * bs), 2 * bs);
+  ASSERT_EQ(index.lookup(3, 3 * bs, bs), bs);
+  ASSERT_EQ(index.prefix(3), (off_t)(2 * bs));
+  // truncation drops the blocks after the new size
+  index.truncate(3, bs + 1);
+  ASSERT_EQ(index.lookup(3, 0, 4 * bs), 2 * bs);
+  ASSERT_EQ(index.lookup(3, 3 * bs, bs), 0u);
+  index.truncate(3, 0);
+  ASSERT_EQ(index.prefix(3), 0);
+  // blocks about to be overwritten are not resident
+  index.forget(1, 0, 100, 100);
+  ASSERT_EQ(index.lookup(1, 0, 100), 0u);
+  ASSERT_TRUE(evicted.empty());
+  blockindex::stats_t stats;
+  index.get_stats(stats);
+  ASSERT_EQ(stats.blocks, 2u);
+  ASSERT_EQ(stats.inodes, 1u);
+  ASSERT_EQ(stats.evictions, 0u);
+}
+
+TEST(BlockIndex, Eviction)
+{
+  evicted_t evicted;
+  blockindex index(bs, 4 * bs, [&evicted](fuse_ino_t ino, off_t offset,
+  size_t) {
+    evicted.push_back(std::make_pair(ino, offset));
+  });
+  index.insert(1, 0, 2 * bs, 2 * bs);
+  index.insert(2, 0, 2 * bs, 2 * bs);
+  // touch the first block of inode 1
+  ASSERT_EQ(index.lookup(1, 0, bs), bs);
+  index.insert(3, 0, 2 * bs, 2 * bs);
+  // the removed blocks are only dropped by evict
+  ASSERT_TRUE(evicted.empty());
+  ASSERT_FALSE(index.resident(1, 1));
+  ASSERT_FALSE(index.resident(2, 0));
+  ASSERT_TRUE(index.resident(2, 1));
+  index.evict();
+  ASSERT_EQ(evicted.size(), 2u);
+  ASSERT_EQ(evicted[0], std::make_pair((fuse_ino_t) 1, (off_t) bs));
+  ASSERT_EQ(evicted[1], std::make_pair((fuse_ino_t) 2, (off_t) 0));
+  ASSERT_EQ(index.prefix(1), (off_t) bs);
+  ASSERT_EQ(index.prefix(2), 0);
+  ASSERT_EQ(index.lookup(2, bs, bs), bs);
+  blockindex::stats_t stats;
+  index.get_stats(stats);
+  ASSERT_EQ(stats.blocks, 4u);
+  ASSERT_EQ(stats.evictions, 2u);
+}
+
+TEST(BlockIndex, SaveLoad)
+{
+  char path[] = "/tmp/eos-fusex-blockindex-XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  auto noevict = [](fuse_ino_t, off_t, size_t) { };
+  {
+    blockindex index(bs, 0, noevict);
+    index.insert(1, 0, 2 * bs, 2 * bs);
+    index.insert(2, 0, 3 * bs, 3 * bs);
+    ASSERT_EQ(index.save(path), 0);
+  }
+  // a different block size is not accepted
+  {
+    blockindex index(2 * bs, 0, noevict);
+    ASSERT_NE(index.load(path, [](fuse_ino_t, std::set<uint64_t>&) { }), 0);
+  }
+  // load drops the blocks failing the validation and keeps the LRU order
+  evicted_t evicted;
+  blockindex index(bs, 3 * bs, [&evicted](fuse_ino_t ino, off_t offset,
+  size_t) {
+    evicted.push_back(std::make_pair(ino, offset));
+  });
+  ASSERT_EQ(index.load(path, [](fuse_ino_t ino, std::set<uint64_t>& blocks) {
+    if (ino == 2) {
+      blocks.erase(2);
+    }
+  }), 0);
+  index.evict();
+  ASSERT_EQ(evicted.size(), 1u);
+  ASSERT_EQ(evicted[0], std::make_pair((fuse_ino_t) 1, (off_t) 0));
+  ASSERT_EQ(index.lookup(1, bs, bs), bs);
+  ASSERT_EQ(index.lookup(2, 0, 3 * bs), 2 * bs);
+  unlink(path);
+}
+
+TEST(BlockIndex, EvictRewritten)
+{
+  // a block written again before its eviction ran is resident and has to
+  // keep its data, the callback checks this like diskcache::evict
+  std::vector<fuse_ino_t> dropped;
+  blockindex* pindex = nullptr;
+  blockindex index(bs, 2 * bs, [&](fuse_ino_t ino, off_t offset, size_t) {
+    if (!pindex->resident(ino, offset / bs)) {
+      dropped.push_back(ino);
+    }
+  });
+  pindex = &index;
+  index.insert(1, 0, bs, bs);
+  index.insert(2, 0, bs, bs);
+  index.insert(3, 0, bs, bs);
+  ASSERT_FALSE(index.resident(1, 0));
+  // inode 1 is written again, which evicts inode 2
+  index.forget(1, 0, bs, bs);
+  index.insert(1, 0, bs, bs);
+  index.evict();
+  ASSERT_EQ(dropped, std::vector<fuse_ino_t>({2}));
+  ASSERT_EQ(index.lookup(1, 0, bs), bs);
+  // nothing left to evict
+  dropped.clear();
+  index.evict();
+  ASSERT_TRUE(dropped.empty());
+}
@@ -0,0 +1,52 @@
+//------------------------------------------------------------------------------
+//! @file inline-only.cc
+//! @brief Tests of the creation of inline-only files
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "fusex/data/data.hh"
+#include "gtest/gtest.h"
+
+TEST(InlineOnly, DirectoryAttribute)
+{
+  ASSERT_TRUE(data::datax::inline_only_enabled("1"));
+  ASSERT_FALSE(data::datax::inline_only_enabled("0"));
+  ASSERT_FALSE(data::datax::inline_only_enabled(""));
+  ASSERT_FALSE(data::datax::inline_only_enabled("yes"));
+}
+
+TEST(InlineOnly, Creation)
+{
+  const uint64_t max_size = 4096;
+  // only opt-in directories get inline-only files
+  ASSERT_TRUE(data::datax::create_inline_only(O_CREAT | O_RDWR, max_size,
+              true, false));
+  ASSERT_FALSE(data::datax::create_inline_only(O_CREAT | O_RDWR, max_size,
+               false, false));
+  // inlining has to be enabled
+  ASSERT_FALSE(data::datax::create_inline_only(O_CREAT | O_RDWR, 0, true,
+               false));
+  // an existing file is never turned inline-only
+  ASSERT_FALSE(data::datax::create_inline_only(O_RDWR, max_size, true,
+               false));
+  // neither is a file already opened on an FST
+  ASSERT_FALSE(data::datax::create_inline_only(O_CREAT | O_RDWR, max_size,
+               true, true));
+}
@@ -11,7 +11,9 @@
 #include "fusex/data/cacheconfig.hh"
 #include "fusex/data/cachehandler.hh"
 #include <stdint.h>
+#include <string.h>
 #include <algorithm>
+#include <fstream>
 #include <vector>
 #include "gtest/gtest.h"
 
@@ -123,6 +125,76 @@ TEST(JournalCache, BasicSanity)
   ASSERT_EQ(rc, (int64_t) truncsize);
 }
 
+TEST(JournalCache, WriteBackManifest)
+{
+  cacheconfig config;
+  config.journal = "/tmp/";
+  config.location = "/tmp/";
+  config.per_file_journal_max_size = 128 * 1024 * 1024;
+  journalcache::init(config);
+  journalcache jc(6);
+  std::string cookie = "";
+  fuse_req_t req = 0;
+  ASSERT_EQ(jc.attach(req, cookie, true), 0);
+  char manifest[1024];
+  snprintf(manifest, sizeof(manifest), "/tmp//%08lx/%08lx.jc.wb", 0ul, 6ul);
+  journalcache::remote_t remote;
+  remote.ino = 0x1234;
+  remote.path = "/eos/dir with blanks/file";
+  remote.uid = 1000;
+  remote.gid = 100;
+  // nothing to commit for an empty journal
+  ASSERT_EQ(jc.commit(remote), 0);
+  ASSERT_NE(access(manifest, F_OK), 0);
+  ASSERT_FALSE(jc.pending());
+  ASSERT_EQ(jc.pwrite("write-back", 10, 0), 10);
+  ASSERT_TRUE(jc.pending());
+  ASSERT_EQ(jc.commit(remote), 0);
+  ASSERT_EQ(access(manifest, F_OK), 0);
+  {
+    std::ifstream in(manifest);
+    std::string truncsize, ino, ids, path;
+    std::getline(in, truncsize);
+    std::getline(in, ino);
+    std::getline(in, ids);
+    std::getline(in, path);
+    ASSERT_EQ(truncsize, "-1");
+    ASSERT_EQ(ino, "1234");
+    ASSERT_EQ(ids, "1000 100");
+    ASSERT_EQ(path, "/eos/dir with blanks/file");
+  }
+  // the replay builds the url from the manifest, here it can't be opened
+  // and the journal is kept
+  std::string journal(manifest, strlen(manifest) - 3);
+  std::string replay = journal + ".1.replay";
+  {
+    std::ifstream src(journal);
+    std::ofstream dst(replay);
+    dst << src.rdbuf();
+    std::ifstream msrc(manifest);
+    std::ofstream mdst(replay + ".wb");
+    mdst << msrc.rdbuf();
+  }
+  journalcache::remote_t replayed;
+  replayed.ino = 0;
+  ASSERT_NE(journalcache::replay(replay + ".wb", [&replayed](
+  const journalcache::remote_t & r) {
+    replayed = r;
+    return std::string("");
+  }, cachesyncer::throttle_t()), 0);
+  ASSERT_EQ(replayed.ino, remote.ino);
+  ASSERT_EQ(replayed.path, remote.path);
+  ASSERT_EQ(replayed.uid, remote.uid);
+  ASSERT_EQ(replayed.gid, remote.gid);
+  ASSERT_EQ(access((replay + ".wb").c_str(), F_OK), 0);
+  ::unlink(replay.c_str());
+  ::unlink((replay + ".wb").c_str());
+  // the manifest goes away together with the journal contents
+  ASSERT_EQ(jc.reset(), 0);
+  ASSERT_NE(access(manifest, F_OK), 0);
+  ASSERT_FALSE(jc.pending());
+}
+
 const std::string TestData::input =
   "Miusov, as a man man of breeding and deilcacy, could not but feel some inwrd qualms, when he reached the Father Superior's with Ivan: he felt ashamed of havin lost his temper. He felt that he ought to have disdaimed that despicable wretch, Fyodor Pavlovitch, too much to have been upset by him in Father Zossima's cell, and so to have forgotten himself. \"Teh monks were not to blame, in any case,\" he reflceted, on the steps. \"And if they're decent people here (and the Father Superior, I understand, is a nobleman) why not be friendly and courteous withthem? I won't argue, I'll fall in with everything, I'll win them by politness, and show them that I've nothing to do with that Aesop, thta buffoon, that Pierrot, and have merely been takken in over this affair, just as they have.\""
   "He determined to drop his litigation with the monastry, and relinguish his claims to the wood-cuting and fishery rihgts at once. He was the more ready to do this becuase the rights had becom much less valuable, and he had indeed the vaguest idea where the wood and river in quedtion were."
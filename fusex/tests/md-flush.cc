@@ -0,0 +1,199 @@
+//------------------------------------------------------------------------------
+//! @file md-flush.cc
+//! @brief Tests of the ordering of the metadata flush queue
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "fusex/md/md.hh"
+#include "gtest/gtest.h"
+#include <vector>
+
+namespace
+{
+typedef metad::flushentry entry_t;
+typedef std::vector<entry_t> entries_t;
+
+entry_t Add(uint64_t id, uint64_t pid)
+{
+  return entry_t(id, "authid", mdx::ADD, 0, pid);
+}
+
+entry_t Update(uint64_t id, uint64_t pid)
+{
+  return entry_t(id, "authid", mdx::UPDATE, 0, pid);
+}
+
+entry_t Rm(uint64_t id, uint64_t pid)
+{
+  return entry_t(id, "authid", mdx::RM, 0, pid);
+}
+
+entry_t Rename(uint64_t id, uint64_t newpid)
+{
+  return entry_t(id, "authid", mdx::UPDATE, 0, newpid, true);
+}
+
+entry_t LStore(uint64_t id)
+{
+  return entry_t(id, "authid", mdx::LSTORE);
+}
+
+//------------------------------------------------------------------------------
+// Take the next entries and return their inodes, empty if nothing is due
+//------------------------------------------------------------------------------
+std::vector<uint64_t> Next(metad::flushqueue& queue, entries_t& entries,
+                           size_t max_batch = 1)
+{
+  std::vector<uint64_t> ids;
+  entries.clear();
+
+  if (queue.next(entries, max_batch)) {
+    for (auto& e : entries) {
+      ids.push_back(e.id());
+    }
+  }
+
+  return ids;
+}
+}
+
+TEST(MdFlush, CreateBeforeChild)
+{
+  metad::flushqueue queue;
+  entries_t dir, file, none;
+  // mkdir d, create d/f and write f
+  queue.push_back(Add(10, 1));
+  queue.push_back(LStore(1));
+  queue.push_back(Add(11, 10));
+  queue.push_back(LStore(10));
+  queue.push_back(Update(11, 10));
+  ASSERT_EQ(Next(queue, dir), std::vector<uint64_t>({10}));
+  // the local store of the parent doesn't wait for the directory
+  entries_t lstore;
+  ASSERT_EQ(Next(queue, lstore), std::vector<uint64_t>({1}));
+  // the file waits for the creation of its directory
+  ASSERT_TRUE(Next(queue, none).empty());
+  queue.done(dir);
+  ASSERT_EQ(Next(queue, file), std::vector<uint64_t>({11}));
+  // the update of the file is coalesced into its creation
+  ASSERT_EQ(file[0].count(), 2u);
+  queue.done(file);
+  queue.done(lstore);
+  ASSERT_EQ(Next(queue, none), std::vector<uint64_t>({10}));
+  queue.done(none);
+  ASSERT_EQ(queue.size(), 0u);
+}
+
+TEST(MdFlush, UnrelatedConcurrent)
+{
+  metad::flushqueue queue;
+  entries_t first, second, third, none;
+  queue.push_back(Update(20, 2));
+  queue.push_back(Update(30, 3));
+  queue.push_back(Update(20, 2));
+  // different inodes in different directories go out together
+  ASSERT_EQ(Next(queue, first), std::vector<uint64_t>({20}));
+  ASSERT_EQ(first[0].count(), 2u);
+  ASSERT_EQ(Next(queue, second), std::vector<uint64_t>({30}));
+  ASSERT_TRUE(Next(queue, none).empty());
+  queue.done(first);
+  queue.done(second);
+  // an update of an inode in flight waits for it
+  queue.push_back(Update(40, 4));
+  ASSERT_EQ(Next(queue, first), std::vector<uint64_t>({40}));
+  queue.push_back(Update(40, 4));
+  ASSERT_TRUE(Next(queue, none).empty());
+  queue.done(first);
+  ASSERT_EQ(Next(queue, third), std::vector<uint64_t>({40}));
+}
+
+TEST(MdFlush, RenameChain)
+{
+  metad::flushqueue queue;
+  entries_t update, rename, none;
+  // a is moved from 5 to 6 and then to 7, y is unrelated
+  queue.push_back(Update(40, 4));
+  queue.push_back(Update(5, 1));
+  queue.push_back(Update(6, 1));
+  queue.push_back(Rename(50, 6));
+  queue.push_back(Update(6, 1));
+  queue.push_back(Update(7, 1));
+  queue.push_back(Rename(50, 7));
+  queue.push_back(Update(60, 8));
+  ASSERT_EQ(Next(queue, update), std::vector<uint64_t>({40}));
+  entries_t p5, p6;
+  ASSERT_EQ(Next(queue, p5), std::vector<uint64_t>({5}));
+  ASSERT_EQ(Next(queue, p6), std::vector<uint64_t>({6}));
+  // the rename waits for everything before it, nothing overtakes it
+  ASSERT_TRUE(Next(queue, none).empty());
+  queue.done(update);
+  queue.done(p5);
+  ASSERT_TRUE(Next(queue, none).empty());
+  queue.done(p6);
+  ASSERT_EQ(Next(queue, rename), std::vector<uint64_t>({50}));
+  ASSERT_TRUE(rename[0].barrier());
+  ASSERT_EQ(rename[0].pid(), 6u);
+  // nothing goes out while the rename is in flight
+  ASSERT_TRUE(Next(queue, none).empty());
+  queue.done(rename);
+  entries_t p7;
+  ASSERT_EQ(Next(queue, p6), std::vector<uint64_t>({6}));
+  ASSERT_EQ(Next(queue, p7), std::vector<uint64_t>({7}));
+  ASSERT_TRUE(Next(queue, none).empty());
+  queue.done(p6);
+  queue.done(p7);
+  // the second rename is not coalesced with the first one
+  ASSERT_EQ(Next(queue, rename), std::vector<uint64_t>({50}));
+  ASSERT_EQ(rename[0].pid(), 7u);
+  ASSERT_EQ(rename[0].count(), 1u);
+  ASSERT_TRUE(Next(queue, none).empty());
+  queue.done(rename);
+  ASSERT_EQ(Next(queue, update), std::vector<uint64_t>({60}));
+  queue.done(update);
+  ASSERT_EQ(queue.size(), 0u);
+}
+
+TEST(MdFlush, CreateAndDeleteInDirectory)
+{
+  metad::flushqueue queue;
+  entries_t batch, rm, add, none;
+  // three creations, a deletion and a creation possibly reusing its name
+  queue.push_back(Add(80, 9));
+  queue.push_back(Add(81, 9));
+  queue.push_back(Rm(84, 9));
+  queue.push_back(Add(82, 9));
+  queue.push_back(Add(83, 9));
+  // the creations before the deletion are batched, the ones after it wait
+  ASSERT_EQ(Next(queue, batch, 64), std::vector<uint64_t>({80, 81}));
+  ASSERT_TRUE(Next(queue, none, 64).empty());
+  queue.done(batch);
+  ASSERT_EQ(Next(queue, rm, 64), std::vector<uint64_t>({84}));
+  ASSERT_TRUE(Next(queue, none, 64).empty());
+  queue.done(rm);
+  ASSERT_EQ(Next(queue, add, 64), std::vector<uint64_t>({82, 83}));
+  queue.done(add);
+  // the content of a directory is deleted before the directory
+  queue.push_back(Rm(91, 90));
+  queue.push_back(Rm(90, 1));
+  ASSERT_EQ(Next(queue, rm), std::vector<uint64_t>({91}));
+  ASSERT_TRUE(Next(queue, none).empty());
+  queue.done(rm);
+  ASSERT_EQ(Next(queue, rm), std::vector<uint64_t>({90}));
+}
@@ -0,0 +1,227 @@
+//------------------------------------------------------------------------------
+//! @file sharded-map.cc
+//! @brief Multi-threaded stress test of the sharded inode maps
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "fusex/misc/ShardedMap.hh"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+typedef std::shared_ptr<uint64_t> shared_val;
+
+//! Map with a single global lock as used before by metad/data/cap
+class GlobalMap : public std::map<uint64_t, shared_val>, public XrdSysMutex
+{
+public:
+  bool retrieveTS(uint64_t key, shared_val& val)
+  {
+    XrdSysMutexHelper mLock(this);
+    auto it = find(key);
+
+    if (it == end()) {
+      return false;
+    }
+
+    val = it->second;
+    return true;
+  }
+
+  void insertTS(uint64_t key, const shared_val& val)
+  {
+    XrdSysMutexHelper mLock(this);
+    (*this)[key] = val;
+  }
+
+  bool eraseTS(uint64_t key)
+  {
+    XrdSysMutexHelper mLock(this);
+    return erase(key);
+  }
+};
+
+//------------------------------------------------------------------------------
+// Run a FUSE like workload - mostly lookups, some creations and deletions -
+// with the given number of threads and return the number of ops per second
+//------------------------------------------------------------------------------
+template<typename Map>
+double Hammer(Map& map, size_t nthreads, size_t nops, size_t ninodes)
+{
+  for (uint64_t ino = 1; ino <= ninodes; ++ino) {
+    map.insertTS(ino, std::make_shared<uint64_t>(ino));
+  }
+
+  std::atomic<size_t> errors {0};
+  std::vector<std::thread> workers;
+  auto start = std::chrono::steady_clock::now();
+
+  for (size_t t = 0; t < nthreads; ++t) {
+    workers.emplace_back([&, t]() {
+      uint64_t seed = 0x9e3779b97f4a7c15ull * (t + 1);
+
+      for (size_t i = 0; i < nops; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        uint64_t ino = 1 + (seed % ninodes);
+        shared_val val;
+
+        switch (seed % 16) {
+        case 0:
+          // temporary inode in a range no lookup ever touches
+          map.insertTS(ninodes + ino, std::make_shared<uint64_t>(ino));
+          break;
+
+        case 1:
+          map.eraseTS(ninodes + ino);
+          break;
+
+        default:
+          if (!map.retrieveTS(ino, val) || (*val != ino)) {
+            errors++;
+          }
+        }
+      }
+    });
+  }
+
+  for (auto& w : workers) {
+    w.join();
+  }
+
+  double secs = std::chrono::duration<double>
+                (std::chrono::steady_clock::now() - start).count();
+  EXPECT_EQ(0u, errors.load());
+  return (nthreads * nops) / secs;
+}
+}
+
+TEST(ShardedMap, Consistency)
+{
+  ShardedMap<uint64_t, shared_val> map(10);
+  ASSERT_EQ(16u, map.shards());
+
+  for (uint64_t ino = 1; ino <= 1000; ++ino) {
+    map.insertTS(ino, std::make_shared<uint64_t>(ino));
+  }
+
+  ASSERT_EQ(1000u, map.sizeTS());
+  size_t sum = 0;
+  map.for_eachTS([&sum](const uint64_t & ino, shared_val & val) {
+    ASSERT_EQ(ino, *val);
+    sum += ino;
+  });
+  ASSERT_EQ(500500u, sum);
+  ASSERT_EQ(500u, map.erase_ifTS([](const uint64_t & ino, shared_val&) {
+    return (ino % 2);
+  }));
+  ASSERT_FALSE(map.countTS(1));
+  ASSERT_TRUE(map.countTS(2));
+  ASSERT_TRUE(map.eraseTS(2));
+  ASSERT_FALSE(map.eraseTS(2));
+  ASSERT_EQ(499u, map.sizeTS());
+  map.clearTS();
+  ASSERT_EQ(0u, map.sizeTS());
+}
+
+TEST(ShardedMap, Stress)
+{
+  const size_t nops = 1000000;
+  const size_t ninodes = 100000;
+  size_t ncores = std::thread::hardware_concurrency();
+
+  if (ncores < 2) {
+    ncores = 2;
+  }
+
+  for (size_t nthreads = 1; nthreads <= ncores; nthreads *= 2) {
+    GlobalMap global;
+    ShardedMap<uint64_t, shared_val> sharded;
+    double global_rate = Hammer(global, nthreads, nops, ninodes);
+    double sharded_rate = Hammer(sharded, nthreads, nops, ninodes);
+    fprintf(stderr, "threads=%2lu global=%.02f Mops/s sharded=%.02f Mops/s "
+            "speedup=%.02f\n", nthreads, global_rate / 1e6, sharded_rate / 1e6,
+            sharded_rate / global_rate);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Concurrent unlinks moving small odd inodes to their high bucket while a
+// flush thread erases them - ino and ino + 0xffffffff share a shard for
+// every odd inode, locking both at the same time used to deadlock
+//------------------------------------------------------------------------------
+TEST(ShardedMap, UnlinkMove)
+{
+  const uint64_t ninodes = 1000;
+  const size_t nthreads = 8;
+  ShardedMap<uint64_t, shared_val> map;
+  std::atomic<bool> stop {false};
+  std::atomic<size_t> moved {0};
+  std::thread flusher([&]() {
+    while (!stop) {
+      for (uint64_t ino = 1; ino < 2 * ninodes; ino += 2) {
+        map.eraseTS(ino + 0xffffffff);
+      }
+    }
+  });
+
+  for (int round = 0; round < 100; ++round) {
+    for (uint64_t ino = 1; ino < 2 * ninodes; ino += 2) {
+      map.insertTS(ino, std::make_shared<uint64_t>(ino));
+    }
+
+    std::vector<std::thread> workers;
+
+    // all threads unlink the same inodes, every inode is moved once
+    for (size_t t = 0; t < nthreads; ++t) {
+      workers.emplace_back([&]() {
+        for (uint64_t ino = 1; ino < 2 * ninodes; ino += 2) {
+          shared_val val;
+          auto check = [ino](shared_val & v) {
+            ASSERT_EQ(ino, *v);
+          };
+
+          if (map.moveTS(ino, ino + 0xffffffff, val, check)) {
+            moved++;
+          }
+        }
+      });
+    }
+
+    for (auto& w : workers) {
+      w.join();
+    }
+  }
+
+  stop = true;
+  flusher.join();
+  ASSERT_EQ(100 * ninodes, moved.load());
+
+  for (uint64_t ino = 1; ino < 2 * ninodes; ino += 2) {
+    ASSERT_FALSE(map.countTS(ino));
+  }
+}
@@ -73,6 +73,12 @@ bool Access::gStallWrite = false;
 //! indicates a user or group rate stall entry
 bool Access::gStallUserGroup = false;
 
+//! indicates a token bucket rate limit entry
+bool Access::gStallBucket = false;
+
+//! token bucket rate limiter
+RateLimiter Access::gRateLimiter;
+
 //! singleton map for UID based redirection (not used yet)
 std::map<uid_t, std::string> Access::gUserRedirection;
 
@@ -138,7 +144,9 @@ Access::Reset()
   Access::gUserRedirection.clear();
   Access::gGroupRedirection.clear();
   Access::gStallGlobal = Access::gStallRead = \
-                         Access::gStallWrite = Access::gStallUserGroup = false;
+                         Access::gStallWrite = Access::gStallUserGroup = \
+                             Access::gStallBucket = false;
+  Access::gRateLimiter.SetRules(Access::gStallRules);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -277,6 +285,10 @@ Access::ApplyAccessConfig(bool applyredirectandstall)
             gStallUserGroup = true;
           }
 
+          if (RateLimiter::IsRule(subtokens[0])) {
+            gStallBucket = true;
+          }
+
           if (subtokens.size() == 3) {
             XrdOucString comment = subtokens[2].c_str();
 
@@ -309,6 +321,8 @@ Access::ApplyAccessConfig(bool applyredirectandstall)
       }
     }
   }
+
+  Access::gRateLimiter.SetRules(Access::gStallRules);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -388,7 +402,7 @@ Access::StoreAccessConfig()
   }
 
 
-  gStallRead = gStallWrite = gStallGlobal = gStallUserGroup = false;
+  gStallRead = gStallWrite = gStallGlobal = gStallUserGroup = gStallBucket = false;
 
   for (itstall = Access::gStallRules.begin();
        itstall != Access::gStallRules.end(); itstall++) {
@@ -422,8 +436,14 @@ Access::StoreAccessConfig()
     if ((itstall->first.find("rate:") == 0)) {
       gStallUserGroup = true;
     }
+
+    if (RateLimiter::IsRule(itstall->first)) {
+      gStallBucket = true;
+    }
   }
 
+  gRateLimiter.SetRules(Access::gStallRules);
+
   for (itredirect = Access::gRedirectionRules.begin();
        itredirect != Access::gRedirectionRules.end(); itredirect++) {
     redirect += itredirect->first.c_str();
@@ -31,6 +31,7 @@
 #include "mgm/Namespace.hh"
 #include "common/RWMutex.hh"
 #include "common/Mapping.hh"
+#include "mgm/RateLimiter.hh"
 #include <map>
 #include <vector>
 #include <string>
@@ -50,6 +51,8 @@ EOSMGMNAMESPACE_BEGIN
  * in gStallRules["*"]\n
  * 'r:*" => everything get's stalled in read operations as above.\n
  *'w:*" => everything get's stalled in write operations as above.\n\n
+ * 'bucket:{user,group,host}:{name,*}:{op}' => token bucket rate limit with
+ * value '<rate>[:<burst>]' enforced by gRateLimiter.\n\n
  * The same syntax is used in gRedirectionRules to define r+w,
  * r or w operation redirection.
  * The value in this map is defined as '<host>:<port>'
@@ -145,6 +148,12 @@ public:
   //! indicates a user or group rate stall entry
   static bool gStallUserGroup;
 
+  //! indicates a token bucket rate limit entry
+  static bool gStallBucket;
+
+  //! token bucket rate limiter built from the bucket:* stall rules
+  static RateLimiter gRateLimiter;
+
   //! map containing user based redirection
   static std::map<uid_t, std::string> gUserRedirection;
 
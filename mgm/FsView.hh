@@ -757,6 +757,10 @@ public:
       SetConfigMember("manager", gManagerId, true, mName.c_str(), true);
     }
 
+    // Advertise that this manager accepts binary report batches, the FSTs
+    // only send them while this matches their manager
+    SetConfigMember("report.batch", gManagerId, true, mName.c_str(), true);
+
     // By default set 2 balancing streams per node
     if (!(GetConfigMember("stat.balance.ntx").length())) {
       SetConfigMember("stat.balance.ntx", "2", true, mName.c_str(), true);
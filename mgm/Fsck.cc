@@ -24,11 +24,13 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include "common/Constants.hh"
 #include "common/FileId.hh"
 #include "common/LayoutId.hh"
 #include "common/Path.hh"
 #include "common/StringConversion.hh"
 #include "common/Mapping.hh"
+#include "common/LockProfiler.hh"
 #include "mgm/Fsck.hh"
 #include "mgm/XrdMgmOfs.hh"
 #include "mgm/Master.hh"
@@ -242,7 +244,7 @@ Fsck::Check(void)
         std::set<unsigned long long>::const_iterator it;
 
         if (fsid) {
-          XrdSysMutexHelper lock(eMutex);
+          eos::common::ProfiledMutexHelper lock(eMutex, "fsck::errors");
 
           // Add the fids into the error maps
           for (auto it = fids.cbegin(); it != fids.cend(); ++it) {
@@ -283,7 +285,7 @@ Fsck::Check(void)
             // need the FileMD contents, we just need to know if it exists.
             eos::Prefetcher::prefetchFilesystemFileListWithFileMDsAndWait(gOFS->eosView,
                 gOFS->eosFsView, fsid);
-            XrdSysMutexHelper lock(eMutex);
+            eos::common::ProfiledMutexHelper lock(eMutex, "fsck::errors");
             eos::common::RWMutexReadLock nslock(gOFS->eosViewRWMutex);
 
             for (auto it_fid = gOFS->eosFsView->getFileList(fsid);
@@ -311,7 +313,7 @@ Fsck::Check(void)
     {
       // Grab all files which have no replicas at all
       try {
-        XrdSysMutexHelper lock(eMutex);
+        eos::common::ProfiledMutexHelper lock(eMutex, "fsck::errors");
         eos::common::RWMutexReadLock nslock(gOFS->eosViewRWMutex);
         // it_fid not invalidated when items are added or removed for QDB
         // namespace, safe to release lock after each item.
@@ -335,7 +337,9 @@ Fsck::Check(void)
             continue;
           }
 
-          if (fmd && (!fmd->isLink())) {
+          // Inline-only files keep their contents in the namespace
+          if (fmd && (!fmd->isLink()) &&
+              !fmd->hasAttribute(eos::common::INLINE_ONLY_ATTR_NAME)) {
             eMap["zero_replica"].insert(it_fid->getElement());
             eCount["zero_replica"]++;
           }
@@ -353,7 +357,7 @@ Fsck::Check(void)
     }
 
     {
-      XrdSysMutexHelper lock(eMutex);
+      eos::common::ProfiledMutexHelper lock(eMutex, "fsck::errors");
 
       // Loop over unavailable filesystems
       for (auto ua_it = eFsUnavail.cbegin(); ua_it != eFsUnavail.cend();
@@ -409,7 +413,7 @@ Fsck::Check(void)
           continue;
         }
 
-        XrdSysMutexHelper lock(eMutex);
+        eos::common::ProfiledMutexHelper lock(eMutex, "fsck::errors");
         eos::common::RWMutexReadLock fs_lock(FsView::gFsView.ViewMutex);
         size_t nlocations = fmd->getNumLocation();
         size_t offlinelocations = 0;
@@ -458,7 +462,7 @@ Fsck::Check(void)
     {
       // Look for dark MD entries e.g. filesystem ids which have MD entries,
       // but have no configured file system
-      XrdSysMutexHelper lock(eMutex);
+      eos::common::ProfiledMutexHelper lock(eMutex, "fsck::errors");
       eos::common::RWMutexReadLock fs_rd_lock(FsView::gFsView.ViewMutex);
       eos::common::RWMutexReadLock ns_rd_lock(gOFS->eosViewRWMutex);
 
@@ -499,7 +503,7 @@ Fsck::Check(void)
 void
 Fsck::PrintOut(XrdOucString& out, XrdOucString option)
 {
-  XrdSysMutexHelper lock(mLogMutex);
+  eos::common::ProfiledMutexHelper lock(mLogMutex, "fsck::log");
   out = mLog;
 }
 
@@ -522,7 +526,7 @@ Fsck::Report(XrdOucString& out, XrdOucString& err, XrdOucString option,
 {
   bool printfid = (option.find("i") != STR_NPOS);
   bool printlfn = (option.find("l") != STR_NPOS);
-  XrdSysMutexHelper lock(eMutex);
+  eos::common::ProfiledMutexHelper lock(eMutex, "fsck::errors");
   XrdOucString checkoption = option;
   checkoption.replace("h", "");
   checkoption.replace("json", "");
@@ -929,7 +933,7 @@ Fsck::Report(XrdOucString& out, XrdOucString& err, XrdOucString option,
 bool
 Fsck::Repair(XrdOucString& out, XrdOucString& err, XrdOucString option)
 {
-  XrdSysMutexHelper lock(eMutex);
+  eos::common::ProfiledMutexHelper lock(eMutex, "fsck::errors");
 
   // Check for a valid action in option
   if ((option != "checksum") &&
@@ -1529,7 +1533,7 @@ Fsck::Repair(XrdOucString& out, XrdOucString& err, XrdOucString option)
 void
 Fsck::ClearLog()
 {
-  XrdSysMutexHelper lock(mLogMutex);
+  eos::common::ProfiledMutexHelper lock(mLogMutex, "fsck::log");
   mLog = "";
 }
 
@@ -1555,7 +1559,7 @@ Fsck::Log(bool overwrite, const char* msg, ...)
           (unsigned long) tv.tv_usec);
   ptr = buffer + strlen(buffer);
   vsprintf(ptr, msg, args);
-  XrdSysMutexHelper lock(mLogMutex);
+  eos::common::ProfiledMutexHelper lock(mLogMutex, "fsck::log");
 
   if (overwrite) {
     int spos = mLog.rfind("\n", mLog.length() - 2);
@@ -1576,7 +1580,7 @@ Fsck::Log(bool overwrite, const char* msg, ...)
 void
 Fsck::ResetErrorMaps()
 {
-  XrdSysMutexHelper lock(eMutex);
+  eos::common::ProfiledMutexHelper lock(eMutex, "fsck::errors");
   eFsMap.clear();
   eMap.clear();
   eCount.clear();
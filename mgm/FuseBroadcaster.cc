@@ -0,0 +1,399 @@
+//------------------------------------------------------------------------------
+//! @file FuseBroadcaster.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "mgm/FuseBroadcaster.hh"
+#include <cstdio>
+#include <set>
+
+EOSMGMNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------------------------
+FuseBroadcaster::FuseBroadcaster(send_t send, revoke_t revoke,
+                                 size_t nthreads,
+                                 std::chrono::milliseconds window,
+                                 size_t max_batch, size_t max_pending,
+                                 size_t max_send):
+  mSend(send), mRevoke(revoke), mWindow(window),
+  mMaxBatch(max_batch ? max_batch : 1), mMaxPending(max_pending),
+  mMaxSend(max_send)
+{
+  if (!nthreads) {
+    nthreads = 1;
+  }
+
+  for (size_t i = 0; i < nthreads; ++i) {
+    mShards.emplace_back(new Shard());
+  }
+}
+
+//------------------------------------------------------------------------------
+// Destructor
+//------------------------------------------------------------------------------
+FuseBroadcaster::~FuseBroadcaster()
+{
+  for (auto& shard : mShards) {
+    shard->mThread.join();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Start the sender threads
+//------------------------------------------------------------------------------
+void
+FuseBroadcaster::Start()
+{
+  for (auto& shard : mShards) {
+    shard->mThread.reset(&FuseBroadcaster::Sender, this, shard.get());
+  }
+}
+
+//------------------------------------------------------------------------------
+// Get the shard serving a client
+//------------------------------------------------------------------------------
+FuseBroadcaster::Shard&
+FuseBroadcaster::GetShard(const std::string& identity)
+{
+  return *mShards[std::hash<std::string>()(identity) % mShards.size()];
+}
+
+//------------------------------------------------------------------------------
+// Queue a metadata update
+//------------------------------------------------------------------------------
+void
+FuseBroadcaster::QueueMD(const std::string& identity, bool batching,
+                         eos::fusex::response& rsp, uint64_t cap_ino,
+                         const std::string& clientid)
+{
+  Entry entry;
+  entry.mKey = key_t(rsp.type(), rsp.md_().md_ino(), "");
+  entry.mRsp.Swap(&rsp);
+  entry.mCapIno = cap_ino;
+  entry.mClientId = clientid;
+  entry.mRevoke = false;
+  Shard& shard = GetShard(identity);
+  std::lock_guard<std::mutex> lock(shard.mMutex);
+  Add(shard, identity, batching, entry);
+}
+
+//------------------------------------------------------------------------------
+// Queue a cap release
+//------------------------------------------------------------------------------
+void
+FuseBroadcaster::QueueRelease(const std::string& identity, bool batching,
+                              eos::fusex::response& rsp)
+{
+  Entry entry;
+  entry.mKey = key_t(rsp.type(), rsp.lease_().md_ino(),
+                     rsp.lease_().clientid());
+  entry.mRsp.Swap(&rsp);
+  entry.mCapIno = std::get<1>(entry.mKey);
+  entry.mClientId = std::get<2>(entry.mKey);
+  entry.mRevoke = false;
+  Shard& shard = GetShard(identity);
+  std::lock_guard<std::mutex> lock(shard.mMutex);
+  Add(shard, identity, batching, entry);
+}
+
+//------------------------------------------------------------------------------
+// Queue an entry
+//------------------------------------------------------------------------------
+void
+FuseBroadcaster::Add(Shard& shard, const std::string& identity, bool batching,
+                     Entry& entry)
+{
+  ClientQueue& queue = shard.mQueues[identity];
+  queue.mBatching = batching;
+  shard.mStats.mQueued++;
+
+  if (queue.mEntries.empty()) {
+    shard.mDue.push_back(std::make_pair(clock_t::now() + mWindow, identity));
+  }
+
+  auto it = queue.mIndex.find(entry.mKey);
+  bool overflow = false;
+
+  if (it != queue.mIndex.end()) {
+    // the newer response supersedes the pending one, it moves to the end to
+    // keep its order relative to the responses queued in between
+    entry.mRevoke = entry.mRevoke || it->second->mRevoke;
+    queue.mEntries.erase(it->second);
+    queue.mIndex.erase(it);
+    shard.mStats.mCoalesced++;
+  } else if (mMaxPending && (queue.mEntries.size() >= mMaxPending) &&
+             (entry.mRsp.type() == eos::fusex::response::MD)) {
+    // the client doesn't keep up, release its caps instead
+    overflow = true;
+  }
+
+  queue.mEntries.push_back(Entry());
+  Entry& back = queue.mEntries.back();
+  back.mKey = entry.mKey;
+  back.mRsp.Swap(&entry.mRsp);
+  back.mCapIno = entry.mCapIno;
+  back.mClientId.swap(entry.mClientId);
+  back.mRevoke = entry.mRevoke;
+  queue.mIndex[back.mKey] = --queue.mEntries.end();
+
+  if (overflow) {
+    Overflow(shard, queue);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Replace the queued updates of a client by cap releases
+//------------------------------------------------------------------------------
+void
+FuseBroadcaster::Overflow(Shard& shard, ClientQueue& queue)
+{
+  std::set<std::pair<uint64_t, std::string>> caps;
+
+  for (auto it = queue.mEntries.begin(); it != queue.mEntries.end();) {
+    if (it->mRsp.type() != eos::fusex::response::MD) {
+      ++it;
+      continue;
+    }
+
+    caps.insert(std::make_pair(it->mCapIno, it->mClientId));
+    queue.mIndex.erase(it->mKey);
+    it = queue.mEntries.erase(it);
+    shard.mStats.mDropped++;
+  }
+
+  for (auto it = caps.begin(); it != caps.end(); ++it) {
+    key_t key(eos::fusex::response::LEASE, it->first, it->second);
+
+    auto kit = queue.mIndex.find(key);
+
+    if (kit != queue.mIndex.end()) {
+      // already asked for, the cap still has to be revoked
+      kit->second->mRevoke = true;
+      continue;
+    }
+
+    queue.mEntries.push_back(Entry());
+    Entry& back = queue.mEntries.back();
+    back.mKey = key;
+    back.mRsp.set_type(eos::fusex::response::LEASE);
+    back.mRsp.mutable_lease_()->set_type(eos::fusex::lease::RELEASECAP);
+    back.mRsp.mutable_lease_()->set_md_ino(it->first);
+    back.mRsp.mutable_lease_()->set_clientid(it->second);
+    back.mCapIno = it->first;
+    back.mClientId = it->second;
+    back.mRevoke = true;
+    queue.mIndex[key] = --queue.mEntries.end();
+    shard.mStats.mReleased++;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Send the messages of all clients whose coalescing window ended
+//------------------------------------------------------------------------------
+size_t
+FuseBroadcaster::Flush(clock_t::time_point now, bool force)
+{
+  size_t nsent = 0;
+
+  for (auto& shard : mShards) {
+    nsent += FlushShard(*shard, now, force);
+  }
+
+  return nsent;
+}
+
+//------------------------------------------------------------------------------
+// Send the due messages of one shard
+//------------------------------------------------------------------------------
+size_t
+FuseBroadcaster::FlushShard(Shard& shard, clock_t::time_point now, bool force)
+{
+  std::vector<std::pair<std::string, ClientQueue>> due;
+  {
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    std::vector<std::string> later;
+
+    while (!shard.mDue.empty() && (force || (shard.mDue.front().first <= now))) {
+      auto it = shard.mQueues.find(shard.mDue.front().second);
+      shard.mDue.pop_front();
+
+      if (it == shard.mQueues.end()) {
+        continue;
+      }
+
+      ClientQueue& queue = it->second;
+      due.push_back(std::make_pair(it->first, ClientQueue()));
+      due.back().second.mBatching = queue.mBatching;
+
+      if (force || !mMaxSend || (queue.mEntries.size() <= mMaxSend)) {
+        due.back().second.mEntries.swap(queue.mEntries);
+        shard.mQueues.erase(it);
+        continue;
+      }
+
+      // the client gets its share for this window, the remaining responses
+      // keep coalescing and count against max_pending
+      auto last = queue.mEntries.begin();
+
+      for (size_t n = 0; n < mMaxSend; ++n, ++last) {
+        queue.mIndex.erase(last->mKey);
+      }
+
+      due.back().second.mEntries.splice(due.back().second.mEntries.end(),
+                                        queue.mEntries, queue.mEntries.begin(),
+                                        last);
+      later.push_back(it->first);
+    }
+
+    for (auto it = later.begin(); it != later.end(); ++it) {
+      shard.mDue.push_back(std::make_pair(now + mWindow, *it));
+    }
+  }
+
+  // serialize and send without holding the shard mutex
+  size_t nsent = 0;
+  uint64_t nbatched = 0;
+
+  for (auto it = due.begin(); it != due.end(); ++it) {
+    entry_list_t& entries = it->second.mEntries;
+
+    while (!entries.empty()) {
+      eos::fusex::response rsp;
+      std::vector<std::pair<uint64_t, std::string>> revoke;
+
+      for (size_t n = 0; (n < mMaxBatch) && !entries.empty(); ++n) {
+        Entry& entry = entries.front();
+
+        if (entry.mRevoke) {
+          revoke.push_back(std::make_pair(entry.mCapIno, entry.mClientId));
+        }
+
+        if (!it->second.mBatching || (entries.size() == 1 && !n)) {
+          rsp.Swap(&entry.mRsp);
+          entries.pop_front();
+          break;
+        }
+
+        if (!n) {
+          rsp.set_type(eos::fusex::response::BATCH);
+        }
+
+        rsp.add_batch_()->Swap(&entry.mRsp);
+        entries.pop_front();
+        nbatched++;
+      }
+
+      std::string rspstream;
+      rsp.SerializeToString(&rspstream);
+      mSend(it->first, rspstream);
+      nsent++;
+
+      // the client drops the caps when it receives the release, the server
+      // must not send further updates for them
+      if (mRevoke) {
+        for (auto rit = revoke.begin(); rit != revoke.end(); ++rit) {
+          mRevoke(rit->first, rit->second);
+        }
+      }
+    }
+  }
+
+  if (nsent) {
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    shard.mStats.mMessages += nsent;
+    shard.mStats.mBatched += nbatched;
+  }
+
+  return nsent;
+}
+
+//------------------------------------------------------------------------------
+// Sender thread loop
+//------------------------------------------------------------------------------
+void
+FuseBroadcaster::Sender(Shard* shard, ThreadAssistant& assistant)
+{
+  while (!assistant.terminationRequested()) {
+    clock_t::time_point wakeup = clock_t::now() + mWindow;
+    {
+      std::lock_guard<std::mutex> lock(shard->mMutex);
+
+      if (!shard->mDue.empty() && (shard->mDue.front().first < wakeup)) {
+        wakeup = shard->mDue.front().first;
+      }
+    }
+    assistant.wait_until(wakeup);
+
+    if (assistant.terminationRequested()) {
+      break;
+    }
+
+    FlushShard(*shard, clock_t::now(), false);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Get the counters and the number of queued responses
+//------------------------------------------------------------------------------
+FuseBroadcaster::Stats
+FuseBroadcaster::GetStats(size_t& pending)
+{
+  Stats stats;
+  pending = 0;
+
+  for (auto& shard : mShards) {
+    std::lock_guard<std::mutex> lock(shard->mMutex);
+    stats.mQueued += shard->mStats.mQueued;
+    stats.mCoalesced += shard->mStats.mCoalesced;
+    stats.mMessages += shard->mStats.mMessages;
+    stats.mBatched += shard->mStats.mBatched;
+    stats.mDropped += shard->mStats.mDropped;
+    stats.mReleased += shard->mStats.mReleased;
+
+    for (auto it = shard->mQueues.begin(); it != shard->mQueues.end(); ++it) {
+      pending += it->second.mEntries.size();
+    }
+  }
+
+  return stats;
+}
+
+//------------------------------------------------------------------------------
+// Print the counters
+//------------------------------------------------------------------------------
+void
+FuseBroadcaster::Print(std::string& out)
+{
+  size_t pending = 0;
+  Stats stats = GetStats(pending);
+  char line[1024];
+  snprintf(line, sizeof(line),
+           "broadcast : queued=%lu coalesced=%lu messages=%lu batched=%lu "
+           "dropped=%lu released=%lu pending=%lu window=%ldms\n",
+           (unsigned long) stats.mQueued, (unsigned long) stats.mCoalesced,
+           (unsigned long) stats.mMessages, (unsigned long) stats.mBatched,
+           (unsigned long) stats.mDropped, (unsigned long) stats.mReleased,
+           (unsigned long) pending, (long) mWindow.count());
+  out += line;
+}
+
+EOSMGMNAMESPACE_END
@@ -0,0 +1,222 @@
+//------------------------------------------------------------------------------
+//! @file FuseBroadcaster.hh
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#pragma once
+#include "mgm/Namespace.hh"
+#include "mgm/fusex.pb.h"
+#include "common/AssistedThread.hh"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+EOSMGMNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Class FuseBroadcaster - asynchronous fan-out of the metadata updates and
+//! cap releases sent to the fuse clients. Messages are queued per client and
+//! sent by dedicated sender threads once the first queued message of a client
+//! is older than the coalescing window:
+//!
+//!  - an update of an inode replaces a pending update of the same inode, a
+//!    cap release replaces a pending release of the same cap
+//!  - clients speaking PROTOCOLV4 receive all their pending messages in
+//!    BATCH responses of at most max_batch messages, older clients receive
+//!    them one by one
+//!  - at most max_send responses are sent to a client per window, the others
+//!    stay queued for the next window
+//!  - if a client has more than max_pending messages queued, its pending
+//!    metadata updates are dropped and replaced by the release of the caps
+//!    they were sent for, so the client refetches the metadata on demand.
+//!    These caps are revoked on the server once the release is sent.
+//!
+//! Each client is served by a single sender thread, therefore the messages of
+//! one client are sent in the order they were queued.
+//------------------------------------------------------------------------------
+class FuseBroadcaster
+{
+public:
+  //! Send a serialized response to the client with the given zmq identity
+  typedef std::function<void(const std::string& identity,
+                             const std::string& data)> send_t;
+
+  //! Revoke the caps of a client id on an inode on the server
+  typedef std::function<void(uint64_t md_ino,
+                             const std::string& clientid)> revoke_t;
+
+  typedef std::chrono::steady_clock clock_t;
+
+  //! Counters of the broadcast pipeline
+  struct Stats {
+    Stats() : mQueued(0), mCoalesced(0), mMessages(0), mBatched(0),
+      mDropped(0), mReleased(0) {}
+
+    uint64_t mQueued; ///< Responses queued
+    uint64_t mCoalesced; ///< Responses replaced by a newer one
+    uint64_t mMessages; ///< Messages sent to clients
+    uint64_t mBatched; ///< Responses sent as part of a batch
+    uint64_t mDropped; ///< Updates dropped because a client fell behind
+    uint64_t mReleased; ///< Caps released instead of dropped updates
+  };
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param send function sending a message to a client
+  //! @param revoke function revoking the caps released after an overflow
+  //! @param nthreads number of sender threads
+  //! @param window coalescing window
+  //! @param max_batch maximum number of responses in a batch
+  //! @param max_pending maximum number of responses queued per client
+  //! @param max_send maximum number of responses sent per client and window
+  //----------------------------------------------------------------------------
+  FuseBroadcaster(send_t send, revoke_t revoke, size_t nthreads = 4,
+                  std::chrono::milliseconds window = std::chrono::milliseconds(10),
+                  size_t max_batch = 256, size_t max_pending = 4096,
+                  size_t max_send = 1024);
+
+  //----------------------------------------------------------------------------
+  //! Destructor - pending messages are dropped
+  //----------------------------------------------------------------------------
+  ~FuseBroadcaster();
+
+  //----------------------------------------------------------------------------
+  //! Start the sender threads
+  //----------------------------------------------------------------------------
+  void Start();
+
+  //----------------------------------------------------------------------------
+  //! Queue a metadata update
+  //!
+  //! @param identity zmq identity of the client
+  //! @param batching true if the client accepts BATCH responses
+  //! @param rsp MD response, swapped into the queue
+  //! @param cap_ino inode of the cap the update is sent for
+  //! @param clientid client id of the cap the update is sent for
+  //----------------------------------------------------------------------------
+  void QueueMD(const std::string& identity, bool batching,
+               eos::fusex::response& rsp, uint64_t cap_ino,
+               const std::string& clientid);
+
+  //----------------------------------------------------------------------------
+  //! Queue a cap release
+  //!
+  //! @param identity zmq identity of the client
+  //! @param batching true if the client accepts BATCH responses
+  //! @param rsp LEASE response, swapped into the queue
+  //----------------------------------------------------------------------------
+  void QueueRelease(const std::string& identity, bool batching,
+                    eos::fusex::response& rsp);
+
+  //----------------------------------------------------------------------------
+  //! Send the messages of all clients whose coalescing window ended
+  //!
+  //! @param now current time
+  //! @param force send all queued messages regardless of the window and of
+  //!        the per client limit
+  //!
+  //! @return number of messages sent
+  //----------------------------------------------------------------------------
+  size_t Flush(clock_t::time_point now, bool force = false);
+
+  //----------------------------------------------------------------------------
+  //! Get the counters and the number of queued responses
+  //----------------------------------------------------------------------------
+  Stats GetStats(size_t& pending);
+
+  //----------------------------------------------------------------------------
+  //! Print the counters
+  //----------------------------------------------------------------------------
+  void Print(std::string& out);
+
+private:
+  //! (response type, inode, client id) identifying coalescing responses
+  typedef std::tuple<int, uint64_t, std::string> key_t;
+
+  struct Entry {
+    key_t mKey;
+    eos::fusex::response mRsp;
+    uint64_t mCapIno; ///< Cap to release if an update is dropped
+    std::string mClientId;
+    bool mRevoke; ///< Release of an overflow, the cap is revoked when sent
+  };
+
+  typedef std::list<Entry> entry_list_t;
+
+  struct ClientQueue {
+    ClientQueue() : mBatching(false) {}
+
+    bool mBatching;
+    entry_list_t mEntries; ///< Responses in sending order
+    std::map<key_t, entry_list_t::iterator> mIndex;
+  };
+
+  struct Shard {
+    std::mutex mMutex;
+    std::map<std::string, ClientQueue> mQueues; ///< Queues by zmq identity
+    //! Clients with queued responses by end of their coalescing window
+    std::deque<std::pair<clock_t::time_point, std::string>> mDue;
+    Stats mStats;
+    AssistedThread mThread;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Queue an entry - requires the shard mutex
+  //----------------------------------------------------------------------------
+  void Add(Shard& shard, const std::string& identity, bool batching,
+           Entry& entry);
+
+  //----------------------------------------------------------------------------
+  //! Replace the queued updates of a client by cap releases - requires the
+  //! shard mutex
+  //----------------------------------------------------------------------------
+  void Overflow(Shard& shard, ClientQueue& queue);
+
+  //----------------------------------------------------------------------------
+  //! Send the due messages of one shard
+  //----------------------------------------------------------------------------
+  size_t FlushShard(Shard& shard, clock_t::time_point now, bool force);
+
+  //----------------------------------------------------------------------------
+  //! Sender thread loop
+  //----------------------------------------------------------------------------
+  void Sender(Shard* shard, ThreadAssistant& assistant);
+
+  Shard& GetShard(const std::string& identity);
+
+  send_t mSend;
+  revoke_t mRevoke;
+  std::chrono::milliseconds mWindow;
+  size_t mMaxBatch;
+  size_t mMaxPending;
+  size_t mMaxSend;
+  std::vector<std::unique_ptr<Shard>> mShards;
+};
+
+EOSMGMNAMESPACE_END
@@ -29,6 +29,7 @@
 #include "mgm/Policy.hh"
 #include "mgm/Quota.hh"
 #include "mgm/Recycle.hh"
+#include "common/LockProfiler.hh"
 #include "namespace/interface/IView.hh"
 #include "namespace/interface/ContainerIterators.hh"
 #include "namespace/Prefetcher.hh"
@@ -56,7 +57,12 @@ const char* k_nlink = "sys.eos.nlink";
 //------------------------------------------------------------------------------
 // Constructor
 //------------------------------------------------------------------------------
-FuseServer::FuseServer()
+FuseServer::FuseServer():
+  mBroadcaster([](const std::string & identity, const std::string & data) {
+  gOFS->zMQ->task->reply(identity, data);
+}, [this](uint64_t md_ino, const std::string & clientid) {
+  mCaps.Revoke(md_ino, clientid);
+})
 {
   eos_static_info("msg=\"starting fuse server\"");
   std::thread monitorthread(&FuseServer::Clients::MonitorHeartBeat,
@@ -64,6 +70,7 @@ FuseServer::FuseServer()
   monitorthread.detach();
   std::thread capthread(&FuseServer::MonitorCaps, this);
   capthread.detach();
+  mBroadcaster.Start();
 }
 
 //------------------------------------------------------------------------------
@@ -156,7 +163,7 @@ FuseServer::Clients::MonitorHeartBeat()
     // delete client ot be evicted because of a version mismatch
     for (auto it = evictversionmap.begin(); it != evictversionmap.end(); ++it) {
       std::string versionerror =
-        "Server supports PROTOCOLV3 and requires atleast PROTOCOLV2";
+        "Server supports PROTOCOLV4 and requires atleast PROTOCOLV2";
       std::string uuid = it->first;
       Evict(uuid, versionerror);
       mMap.erase(it->second);
@@ -181,7 +188,7 @@ bool
 FuseServer::Clients::Dispatch(const std::string identity,
                               eos::fusex::heartbeat& hb)
 {
-  gOFS->MgmStats.Add("Eosxd::int::Heartbeat", 0, 0, 1);
+  MGM_STATS_ADD("Eosxd::int::Heartbeat", 0, 0, 1);
   bool rc = true;
   eos::common::RWMutexWriteLock lLock(*this);
 
@@ -226,76 +233,35 @@ void
 FuseServer::MonitorCaps() noexcept
 {
   eos_static_info("msg=\"starting fusex monitor caps thread\"");
-  std::map<FuseServer::Caps::authid_t, time_t> outofquota;
-  uint64_t noquota = std::numeric_limits<long>::max() / 2;
+  std::map<FuseServer::Caps::quota_id_t, time_t> outofquota;
   size_t cnt = 0;
 
   while (1) {
     // expire caps
-    do {
-      if (Cap().expire()) {
-        Cap().pop();
-      } else {
-        break;
-      }
-    } while (1);
-
+    Cap().expire();
     time_t now = time(NULL);
 
     if (!(cnt % Clients().QuotaCheckInterval())) {
-      // check quota nodes every mQuotaCheckInterval iterations
-      typedef struct quotainfo {
-        quotainfo(uid_t _uid, gid_t _gid, uint64_t _qid) : uid(_uid), gid(_gid),
-          qid(_qid) {}
-        quotainfo() : uid(0), gid(0), qid(0) {}
-        uid_t uid;
-        gid_t gid;
-        uint64_t qid;
-        std::vector<std::string> authids;
-        std::string id()
-        {
-          char sid[64];
-          snprintf(sid, sizeof(sid), "%u:%u:%lu", uid, gid, qid);
-          return sid;
-        }
-      } quotainfo_t;
-      std::map<std::string, quotainfo_t> qmap;
+      // check quota nodes every mQuotaCheckInterval iterations - the caps are
+      // indexed by quota node, so each quota node is only looked up once
+      std::vector<FuseServer::Caps::quota_id_t> qids;
       {
-        if (EOS_LOGS_DEBUG) {
-          eos_static_debug("looping over caps n=%d", Cap().GetCaps().size());
-        }
-
         eos::common::RWMutexReadLock lLock(Cap());
-        std::map<FuseServer::Caps::authid_t, FuseServer::Caps::shared_cap>& allcaps =
-          Cap().GetCaps();
-
-        for (auto it = allcaps.begin(); it != allcaps.end(); ++it) {
-          if (EOS_LOGS_DEBUG) {
-            eos_static_debug("cap q-node %lx", it->second->_quota().quota_inode());
-          }
 
-          // if we find a cap with 'noquota' contents, we just ignore this one
-          if (it->second->_quota().inode_quota() == noquota) {
-            continue;
-          }
-
-          if (it->second->_quota().quota_inode()) {
-            quotainfo_t qi(it->second->uid(), it->second->gid(),
-                           it->second->_quota().quota_inode());
-
-            // skip if we did this already ...
-            if (qmap.count(qi.id())) {
-              qmap[qi.id()].authids.push_back(it->second->authid());
-            } else {
-              qmap[qi.id()] = qi;
-              qmap[qi.id()].authids.push_back(it->second->authid());
-            }
-          }
+        for (auto it = Cap().QuotaCaps().begin(); it != Cap().QuotaCaps().end();
+             ++it) {
+          qids.push_back(it->first);
         }
       }
 
-      for (auto it = qmap.begin(); it != qmap.end(); ++it) {
-        eos::IContainerMD::id_t qino_id = it->second.qid;
+      if (EOS_LOGS_DEBUG) {
+        eos_static_debug("looping over quota nodes n=%d", qids.size());
+      }
+
+      for (auto it = qids.begin(); it != qids.end(); ++it) {
+        uid_t uid = std::get<0>(*it);
+        gid_t gid = std::get<1>(*it);
+        eos::IContainerMD::id_t qino_id = std::get<2>(*it);
 
         if (EOS_LOGS_DEBUG) {
           eos_static_debug("checking qino=%d", qino_id);
@@ -304,44 +270,52 @@ FuseServer::MonitorCaps() noexcept
         long long avail_bytes = 0;
         long long avail_files = 0;
 
-        if (!Quota::QuotaBySpace(qino_id, it->second.uid, it->second.gid,
-                                 avail_files, avail_bytes)) {
-          for (auto auit = it->second.authids.begin();
-               auit != it->second.authids.end(); ++auit) {
-            if (EOS_LOGS_DEBUG)
-              eos_static_debug("checking qino=%d files=%ld bytes=%ld authid=%s",
-                               qino_id, avail_files, avail_bytes, auit->c_str());
-
-            if (((!avail_files || !avail_bytes) && (!outofquota.count(*auit))) ||
-                // first time out of quota
-                ((avail_files && avail_bytes) &&
-                 (outofquota.count(*auit)))) { // first time back to quota
-              // send the changed quota information via a cap update
-              FuseServer::Caps::shared_cap cap;
-              {
-                eos::common::RWMutexReadLock lLock(Cap());
-
-                if (Cap().GetCaps().count(*auit)) {
-                  cap = Cap().GetCaps()[*auit];
-                }
-              }
+        if (Quota::QuotaBySpace(qino_id, uid, gid, avail_files, avail_bytes)) {
+          continue;
+        }
 
-              if (cap) {
-                cap->mutable__quota()->set_inode_quota(avail_files);
-                cap->mutable__quota()->set_volume_quota(avail_bytes);
-                // send this cap (again)
-                Cap().BroadcastCap(cap);
-              }
+        bool isoutofquota = (!avail_files || !avail_bytes);
 
-              // mark to not send this again unless the quota status changes
-              if (!avail_files || !avail_bytes) {
-                outofquota[*auit] = now;
-              } else {
-                outofquota.erase(*auit);
+        if (EOS_LOGS_DEBUG)
+          eos_static_debug("checking qino=%d uid=%u gid=%u files=%ld bytes=%ld",
+                           qino_id, uid, gid, avail_files, avail_bytes);
+
+        if (isoutofquota == (outofquota.count(*it) != 0)) {
+          // no change since the last check
+          continue;
+        }
+
+        // first time out of quota or first time back to quota - send the
+        // changed quota information via a cap update
+        std::vector<FuseServer::Caps::shared_cap> caps;
+        {
+          eos::common::RWMutexReadLock lLock(Cap());
+          auto qit = Cap().QuotaCaps().find(*it);
+
+          if (qit != Cap().QuotaCaps().end()) {
+            for (auto auit = qit->second.begin(); auit != qit->second.end(); ++auit) {
+              auto cit = Cap().GetCaps().find(*auit);
+
+              if (cit != Cap().GetCaps().end()) {
+                caps.push_back(cit->second);
               }
             }
           }
         }
+
+        for (auto cap = caps.begin(); cap != caps.end(); ++cap) {
+          (*cap)->mutable__quota()->set_inode_quota(avail_files);
+          (*cap)->mutable__quota()->set_volume_quota(avail_bytes);
+          // send this cap (again)
+          Cap().BroadcastCap(*cap);
+        }
+
+        // mark to not send this again unless the quota status changes
+        if (isoutofquota) {
+          outofquota[*it] = now;
+        } else {
+          outofquota.erase(*it);
+        }
       }
 
       // expire some old out of quota entries
@@ -364,7 +338,7 @@ FuseServer::MonitorCaps() noexcept
     cnt++;
 
     if (gOFS) {
-      gOFS->MgmStats.Add("Eosxd::int::MonitorCaps", 0, 0, 1);
+      MGM_STATS_ADD("Eosxd::int::MonitorCaps", 0, 0, 1);
     }
   }
 
@@ -387,6 +361,10 @@ FuseServer::Print(std::string& out, std::string options, bool monitoring)
     gOFS->zMQ->gFuseServer.Flushs().Print(flushout);
     out += flushout;
   }
+
+  if (options.find("b") != std::string::npos) {
+    Broadcasts().Print(out);
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -543,70 +521,58 @@ FuseServer::Clients::Evict(std::string& uuid, std::string reason)
 int
 FuseServer::Clients::Dropcaps(const std::string& uuid, std::string& out)
 {
-  eos::common::RWMutexReadLock lLock(gOFS->zMQ->gFuseServer.Cap());
-  out += " dropping caps of '";
-  out += uuid;
-  out += "' : ";
-
-  if (!mUUIDView.count(uuid)) {
-    return ENOENT;
-  }
+  std::vector<FuseServer::Caps::shared_cap> cap2delete;
+  {
+    eos::common::RWMutexReadLock lLock(gOFS->zMQ->gFuseServer.Cap());
+    out += " dropping caps of '";
+    out += uuid;
+    out += "' : ";
 
-  std::string id = mUUIDView[uuid];
+    if (!mUUIDView.count(uuid)) {
+      return ENOENT;
+    }
 
-  for (auto it = gOFS->zMQ->gFuseServer.Cap().InodeCaps().begin();
-       it != gOFS->zMQ->gFuseServer.Cap().InodeCaps().end(); ++it) {
-    std::set<FuseServer::Caps::shared_cap> cap2delete;
+    for (auto it = gOFS->zMQ->gFuseServer.Cap().InodeCaps().begin();
+         it != gOFS->zMQ->gFuseServer.Cap().InodeCaps().end(); ++it) {
+      size_t ndelete = cap2delete.size();
 
-    for (auto sit = it->second.begin(); sit != it->second.end(); ++sit) {
-      if (gOFS->zMQ->gFuseServer.Cap().GetCaps().count(*sit)) {
-        FuseServer::Caps::shared_cap cap = gOFS->zMQ->gFuseServer.Cap().GetCaps()[*sit];
+      for (auto sit = it->second.begin(); sit != it->second.end(); ++sit) {
+        if (gOFS->zMQ->gFuseServer.Cap().GetCaps().count(*sit)) {
+          FuseServer::Caps::shared_cap cap = gOFS->zMQ->gFuseServer.Cap().GetCaps()[*sit];
 
-        if (cap->clientuuid() == uuid) {
-          cap2delete.insert(cap);
-          out += "\n ";
-          char ahex[20];
-          snprintf(ahex, sizeof(ahex), "%016lx", (unsigned long) cap->id());
-          std::string match = "";
-          match += "# i:";
-          match += ahex;
-          match += " a:";
-          match += cap->authid();
-          out += match;
+          if (cap->clientuuid() == uuid) {
+            cap2delete.push_back(cap);
+            out += "\n ";
+            char ahex[20];
+            snprintf(ahex, sizeof(ahex), "%016lx", (unsigned long) cap->id());
+            std::string match = "";
+            match += "# i:";
+            match += ahex;
+            match += " a:";
+            match += cap->authid();
+            out += match;
+          }
         }
       }
-    }
-
-    for (auto scap = cap2delete.begin(); scap != cap2delete.end(); ++scap) {
-      gOFS->zMQ->gFuseServer.Client().ReleaseCAP((uint64_t)(*scap)->id(),
-          (*scap)->clientuuid(),
-          (*scap)->clientid());
-      eos_static_info("erasing %llx %s %s", (*scap)->id(),
-                      (*scap)->clientid().c_str(), (*scap)->authid().c_str());
-      // erase cap by auth id
-      gOFS->zMQ->gFuseServer.Cap().GetCaps().erase((*scap)->authid());
-      // erase cap by inode
-      gOFS->zMQ->gFuseServer.Cap().InodeCaps()[(*scap)->id()].erase((
-            *scap)->authid());
 
-      if (!gOFS->zMQ->gFuseServer.Cap().InodeCaps()[(*scap)->id()].size()) {
-        gOFS->zMQ->gFuseServer.Cap().InodeCaps().erase((*scap)->id());
+      if (ndelete == cap2delete.size()) {
+        out += " <no caps held>\n";
       }
+    }
+  }
 
-      gOFS->zMQ->gFuseServer.Cap().ClientCaps()[(*scap)->clientid()].erase((
-            *scap)->authid());
-
-      if (!gOFS->zMQ->gFuseServer.Cap().ClientCaps()[(*scap)->clientid()].size()) {
-        gOFS->zMQ->gFuseServer.Cap().ClientCaps().erase((*scap)->clientid());
-      }
+  // ask for the release without holding the caps lock
+  for (auto scap = cap2delete.begin(); scap != cap2delete.end(); ++scap) {
+    ReleaseCAP((uint64_t)(*scap)->id(), (*scap)->clientuuid(),
+               (*scap)->clientid());
+  }
 
-      gOFS->zMQ->gFuseServer.Cap().ClientCaps()[(*scap)->clientid()].insert((
-            *scap)->authid());
-    }
+  eos::common::RWMutexWriteLock lLock(gOFS->zMQ->gFuseServer.Cap());
 
-    if (!cap2delete.size()) {
-      out += " <no caps held>\n";
-    }
+  for (auto scap = cap2delete.begin(); scap != cap2delete.end(); ++scap) {
+    eos_static_info("erasing %llx %s %s", (*scap)->id(),
+                    (*scap)->clientid().c_str(), (*scap)->authid().c_str());
+    gOFS->zMQ->gFuseServer.Cap().Remove(*scap);
   }
 
   return 0;
@@ -621,15 +587,13 @@ FuseServer::Clients::ReleaseCAP(uint64_t md_ino,
                                 const std::string& clientid
                                )
 {
-  gOFS->MgmStats.Add("Eosxd::int::ReleaseCap", 0, 0, 1);
+  MGM_STATS_ADD("Eosxd::int::ReleaseCap", 0, 0, 1);
   // prepare release cap message
   eos::fusex::response rsp;
   rsp.set_type(rsp.LEASE);
   rsp.mutable_lease_()->set_type(eos::fusex::lease::RELEASECAP);
   rsp.mutable_lease_()->set_md_ino(md_ino);
   rsp.mutable_lease_()->set_clientid(clientid);
-  std::string rspstream;
-  rsp.SerializeToString(&rspstream);
   eos::common::RWMutexReadLock lLock(*this);
 
   if (!mUUIDView.count(uuid)) {
@@ -637,9 +601,13 @@ FuseServer::Clients::ReleaseCAP(uint64_t md_ino,
   }
 
   std::string id = mUUIDView[uuid];
+  auto cit = mMap.find(id);
+  bool batching = ((cit != mMap.end()) &&
+                   (cit->second.heartbeat().protversion() >=
+                    eos::fusex::heartbeat::PROTOCOLV4));
   eos_static_info("msg=\"asking cap release\" uuid=%s clientid=%s id=%lx",
                   uuid.c_str(), clientid.c_str(), md_ino);
-  gOFS->zMQ->task->reply(id, rspstream);
+  gOFS->zMQ->gFuseServer.Broadcasts().QueueRelease(id, batching, rsp);
   return 0;
 }
 
@@ -653,12 +621,13 @@ FuseServer::Clients::SendMD(const eos::fusex::md& md,
                             uint64_t md_ino,
                             uint64_t md_pino,
                             uint64_t clock,
-                            struct timespec& p_mtime
+                            struct timespec& p_mtime,
+                            uint64_t cap_ino
                            )
 /*----------------------------------------------------------------------------*/
 
 {
-  gOFS->MgmStats.Add("Eosxd::int::SendMD", 0, 0, 1);
+  MGM_STATS_ADD("Eosxd::int::SendMD", 0, 0, 1);
   // prepare update message
   eos::fusex::response rsp;
   rsp.set_type(rsp.MD);
@@ -676,8 +645,6 @@ FuseServer::Clients::SendMD(const eos::fusex::md& md,
   }
 
   rsp.mutable_md_()->set_clock(clock);
-  std::string rspstream;
-  rsp.SerializeToString(&rspstream);
   eos::common::RWMutexReadLock lLock(*this);
 
   if (!mUUIDView.count(uuid)) {
@@ -685,9 +652,15 @@ FuseServer::Clients::SendMD(const eos::fusex::md& md,
   }
 
   std::string id = mUUIDView[uuid];
+  auto cit = mMap.find(id);
+  bool batching = ((cit != mMap.end()) &&
+                   (cit->second.heartbeat().protversion() >=
+                    eos::fusex::heartbeat::PROTOCOLV4));
   eos_static_info("msg=\"sending md update\" uuid=%s clientid=%s id=%lx",
                   uuid.c_str(), clientid.c_str(), md.md_ino());
-  gOFS->zMQ->task->reply(id, rspstream);
+  // serialization and sending happen on the broadcast threads
+  gOFS->zMQ->gFuseServer.Broadcasts().QueueMD(id, batching, rsp, cap_ino,
+      clientid);
   return 0;
 }
 
@@ -698,7 +671,7 @@ int
 FuseServer::Clients::SendCAP(FuseServer::Caps::shared_cap cap)
 /*----------------------------------------------------------------------------*/
 {
-  gOFS->MgmStats.Add("Eosxd::int::SendCAP", 0, 0, 1);
+  MGM_STATS_ADD("Eosxd::int::SendCAP", 0, 0, 1);
   // prepare update message
   eos::fusex::response rsp;
   rsp.set_type(rsp.CAP);
@@ -740,21 +713,16 @@ void
 FuseServer::Caps::Store(const eos::fusex::cap& ecap,
                         eos::common::Mapping::VirtualIdentity* vid)
 {
-  gOFS->MgmStats.Add("Eosxd::int::Store", 0, 0, 1);
+  MGM_STATS_ADD("Eosxd::int::Store", 0, 0, 1);
   eos::common::RWMutexWriteLock lLock(*this);
   eos_static_info("id=%lx clientid=%s authid=%s",
                   ecap.id(),
                   ecap.clientid().c_str(),
                   ecap.authid().c_str());
-  // fill the three views on caps
-  mTimeOrderedCap.push_back(ecap.authid());
-  mClientCaps[ecap.clientid()].insert(ecap.authid());
-  mClientInoCaps[ecap.clientid()].insert(ecap.id());
   shared_cap cap = std::make_shared<capx>();
   *cap = ecap;
   cap->set_vid(vid);
-  mCaps[ecap.authid()] = cap;
-  mInodeCaps[ecap.id()].insert(ecap.authid());
+  Add(cap);
 }
 
 //------------------------------------------------------------------------------
@@ -784,15 +752,159 @@ FuseServer::Caps::Imply(uint64_t md_ino,
   eos::common::Timing::GetTimeSpec(ts, true);
   implied_cap->set_vtime(ts.tv_sec + 300);
   implied_cap->set_vtime_ns(ts.tv_nsec);
-  // fill the three views on caps
-  mTimeOrderedCap.push_back(implied_authid);
-  mClientCaps[cap->clientid()].insert(implied_authid);
-  mClientInoCaps[cap->clientid()].insert(md_ino);
-  mCaps[implied_authid] = implied_cap;
-  mInodeCaps[md_ino].insert(implied_authid);
+  eos::common::RWMutexWriteLock lLock(*this);
+  Add(implied_cap);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool
+FuseServer::Caps::QuotaId(shared_cap cap, quota_id_t& qid)
+{
+  // caps with 'noquota' contents are not checked by the quota monitor
+  if (cap->_quota().inode_quota() == (uint64_t)(std::numeric_limits<long>::max() /
+      2)) {
+    return false;
+  }
+
+  if (!cap->_quota().quota_inode()) {
+    return false;
+  }
+
+  qid = quota_id_t(cap->uid(), cap->gid(), cap->_quota().quota_inode());
   return true;
 }
 
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void
+FuseServer::Caps::Add(shared_cap cap)
+{
+  auto it = mCaps.find(cap->authid());
+
+  if (it != mCaps.end()) {
+    Remove(it->second);
+  }
+
+  // fill the views on caps
+  mCaps[cap->authid()] = cap;
+  mClientCaps[cap->clientid()].insert(cap->authid());
+  mClientInoCaps[cap->clientid()].insert(cap->id());
+  mInodeCaps[cap->id()].insert(cap->authid());
+  mExpiry.Insert(cap->authid(), cap->vtime() + 10);
+  quota_id_t qid;
+
+  if (QuotaId(cap, qid)) {
+    mQuotaCaps[qid].insert(cap->authid());
+  }
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void
+FuseServer::Caps::Remove(shared_cap cap)
+{
+  auto it = mCaps.find(cap->authid());
+
+  if ((it == mCaps.end()) || (it->second != cap)) {
+    return;
+  }
+
+  mCaps.erase(it);
+  auto iit = mInodeCaps.find(cap->id());
+  bool client_holds_ino = false;
+
+  if (iit != mInodeCaps.end()) {
+    iit->second.erase(cap->authid());
+
+    for (auto sit = iit->second.begin(); sit != iit->second.end(); ++sit) {
+      auto cit = mCaps.find(*sit);
+
+      if ((cit != mCaps.end()) && (cit->second->clientid() == cap->clientid())) {
+        client_holds_ino = true;
+        break;
+      }
+    }
+
+    if (iit->second.empty()) {
+      mInodeCaps.erase(iit);
+    }
+  }
+
+  auto cit = mClientCaps.find(cap->clientid());
+
+  if (cit != mClientCaps.end()) {
+    cit->second.erase(cap->authid());
+
+    if (cit->second.empty()) {
+      mClientCaps.erase(cit);
+    }
+  }
+
+  auto ciit = mClientInoCaps.find(cap->clientid());
+
+  if ((ciit != mClientInoCaps.end()) && !client_holds_ino) {
+    ciit->second.erase(cap->id());
+
+    if (ciit->second.empty()) {
+      mClientInoCaps.erase(ciit);
+    }
+  }
+
+  // the quota contents of a cap can change, look up the quota node directly
+  if (cap->_quota().quota_inode()) {
+    auto qit = mQuotaCaps.find(quota_id_t(cap->uid(), cap->gid(),
+                                          cap->_quota().quota_inode()));
+
+    if (qit != mQuotaCaps.end()) {
+      qit->second.erase(cap->authid());
+
+      if (qit->second.empty()) {
+        mQuotaCaps.erase(qit);
+      }
+    }
+  }
+
+  // the expiry entry is dropped when its slot is visited
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+size_t
+FuseServer::Caps::expire()
+{
+  std::vector<authid_t> due;
+  size_t nexpired = 0;
+  time_t now = time(NULL);
+  eos::common::RWMutexWriteLock lLock(*this);
+  mExpiry.Advance(now, due);
+
+  for (auto it = due.begin(); it != due.end(); ++it) {
+    auto cit = mCaps.find(*it);
+
+    if (cit == mCaps.end()) {
+      continue;
+    }
+
+    shared_cap cap = cit->second;
+
+    if ((time_t)(cap->vtime() + 10) <= now) {
+      Remove(cap);
+      nexpired++;
+    } else {
+      // the cap has been extended or is due in a later turn of the wheel
+      mExpiry.Insert(*it, cap->vtime() + 10);
+    }
+  }
+
+  return nexpired;
+}
+
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
@@ -849,11 +961,14 @@ FuseServer::Clients::BroadcastConfig(const std::string& identity,
                                      eos::fusex::config& cfg)
 /*----------------------------------------------------------------------------*/
 {
-  gOFS->MgmStats.Add("Eosxd::int::BcConfig", 0, 0, 1);
+  MGM_STATS_ADD("Eosxd::int::BcConfig", 0, 0, 1);
   // prepare new heartbeat interval message
   eos::fusex::response rsp;
   rsp.set_type(rsp.CONFIG);
   *(rsp.mutable_config_()) = cfg;
+  // every config advertises the optional requests this MGM understands
+  rsp.mutable_config_()->set_mdquery(true);
+  rsp.mutable_config_()->set_mdbatch(true);
   std::string rspstream;
   rsp.SerializeToString(&rspstream);
   eos_static_info("msg=\"broadcast config to client\" name=%s heartbeat-rate=%d",
@@ -868,7 +983,7 @@ FuseServer::Clients::BroadcastDropAllCaps(const std::string& identity,
     eos::fusex::heartbeat& hb)
 /*----------------------------------------------------------------------------*/
 {
-  gOFS->MgmStats.Add("Eosxd::int::BcDropAll", 0, 0, 1);
+  MGM_STATS_ADD("Eosxd::int::BcDropAll", 0, 0, 1);
   // prepare drop all caps message
   eos::fusex::response rsp;
   rsp.set_type(rsp.DROPCAPS);
@@ -886,7 +1001,7 @@ int
 FuseServer::Caps::BroadcastReleaseFromExternal(uint64_t id)
 /*----------------------------------------------------------------------------*/
 {
-  gOFS->MgmStats.Add("Eosxd::int::BcReleaseExt", 0, 0, 1);
+  MGM_STATS_ADD("Eosxd::int::BcReleaseExt", 0, 0, 1);
   // broad-cast release for a given inode
   eos::common::RWMutexReadLock lLock(*this);
   eos_static_info("id=%lx ",
@@ -919,7 +1034,7 @@ FuseServer::Caps::BroadcastReleaseFromExternal(uint64_t id)
 int
 FuseServer::Caps::BroadcastRelease(const eos::fusex::md& md)
 {
-  gOFS->MgmStats.Add("Eosxd::int::BcRelease", 0, 0, 1);
+  MGM_STATS_ADD("Eosxd::int::BcRelease", 0, 0, 1);
   FuseServer::Caps::shared_cap refcap = Get(md.authid());
   eos::common::RWMutexReadLock lLock(*this);
   eos_static_info("id=%lx clientid=%s clientuuid=%s authid=%s",
@@ -978,7 +1093,7 @@ FuseServer::Caps::BroadcastMD(const eos::fusex::md& md,
                               uint64_t clock,
                               struct timespec& p_mtime)
 {
-  gOFS->MgmStats.Add("Eosxd::int::BcMD", 0, 0, 1);
+  MGM_STATS_ADD("Eosxd::int::BcMD", 0, 0, 1);
   FuseServer::Caps::shared_cap refcap = Get(md.authid());
   eos::common::RWMutexReadLock lLock(*this);
   eos_static_info("id=%lx clientid=%s clientuuid=%s authid=%s",
@@ -1017,7 +1132,8 @@ FuseServer::Caps::BroadcastMD(const eos::fusex::md& md,
                                                md_ino,
                                                md_pino,
                                                clock,
-                                               p_mtime);
+                                               p_mtime,
+                                               cap->id());
         // make sure we sent the update only once to each client, eveh if this
         // one has many caps
         clients_sent.insert(cap->clientuuid());
@@ -1057,13 +1173,15 @@ FuseServer::Caps::Print(std::string option, std::string filter)
 
   if (option == "t") {
     // print by time order
-    for (auto it = mTimeOrderedCap.begin(); it != mTimeOrderedCap.end(); ++it) {
-      if (!mCaps.count(*it)) {
-        continue;
-      }
+    std::multimap<uint64_t, shared_cap> timeordered;
 
+    for (auto it = mCaps.begin(); it != mCaps.end(); ++it) {
+      timeordered.insert(std::make_pair(it->second->vtime(), it->second));
+    }
+
+    for (auto it = timeordered.begin(); it != timeordered.end(); ++it) {
       char ahex[256];
-      shared_cap cap = mCaps[*it];
+      shared_cap cap = it->second;
       snprintf(ahex, sizeof(ahex), "%016lx", (unsigned long) cap->id());
       std::string match = "";
       match += "# i:";
@@ -1196,6 +1314,36 @@ FuseServer::Caps::Print(std::string option, std::string filter)
   return out;
 }
 
+//------------------------------------------------------------------------------
+// Remove the caps of a client id on an inode
+//------------------------------------------------------------------------------
+size_t
+FuseServer::Caps::Revoke(uint64_t md_ino, const std::string& clientid)
+{
+  eos::common::RWMutexWriteLock lLock(*this);
+  auto it = mInodeCaps.find(md_ino);
+
+  if (it == mInodeCaps.end()) {
+    return 0;
+  }
+
+  std::vector<shared_cap> caps;
+
+  for (auto sit = it->second.begin(); sit != it->second.end(); ++sit) {
+    auto cit = mCaps.find(*sit);
+
+    if ((cit != mCaps.end()) && (cit->second->clientid() == clientid)) {
+      caps.push_back(cit->second);
+    }
+  }
+
+  for (auto cap = caps.begin(); cap != caps.end(); ++cap) {
+    Remove(*cap);
+  }
+
+  return caps.size();
+}
+
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
@@ -1203,34 +1351,26 @@ int
 FuseServer::Caps::Delete(uint64_t md_ino)
 {
   eos::common::RWMutexWriteLock lLock(*this);
+  auto it = mInodeCaps.find(md_ino);
 
-  if (!mInodeCaps.count(md_ino)) {
+  if (it == mInodeCaps.end()) {
     return ENOENT;
   }
 
-  for (auto sit = mInodeCaps[md_ino].begin() ;
-       sit != mInodeCaps[md_ino].end();
-       ++sit) {
-    for (auto it = mClientCaps.begin(); it != mClientCaps.end(); it++) {
-      // erase authid from the client set
-      it->second.erase(*sit);
-      // erase authid from the time ordered list
-      mTimeOrderedCap.erase(std::remove(mTimeOrderedCap.begin(),
-                                        mTimeOrderedCap.end(),
-                                        *sit), mTimeOrderedCap.end());
-    }
-
-    if (mCaps.count(*sit)) {
-      shared_cap cap = mCaps[*sit];
+  std::vector<shared_cap> caps;
 
-      if (mClientInoCaps.count(cap->clientid())) {
-        mClientInoCaps[cap->clientid()].erase(md_ino);
-      }
+  for (auto sit = it->second.begin(); sit != it->second.end(); ++sit) {
+    auto cit = mCaps.find(*sit);
 
-      mCaps.erase(*sit);
+    if (cit != mCaps.end()) {
+      caps.push_back(cit->second);
     }
   }
 
+  for (auto cap = caps.begin(); cap != caps.end(); ++cap) {
+    Remove(*cap);
+  }
+
   // erase inode from the inode caps
   mInodeCaps.erase(md_ino);
   return 0;
@@ -1242,7 +1382,7 @@ FuseServer::Caps::Delete(uint64_t md_ino)
 FuseServer::Lock::shared_locktracker
 FuseServer::Lock::getLocks(uint64_t id)
 {
-  XrdSysMutexHelper lock(this);
+  eos::common::ProfiledMutexHelper lock(*this, "fuse::locks");
 
   // make sure you have this object locked
   if (!lockmap.count(id)) {
@@ -1258,7 +1398,7 @@ FuseServer::Lock::getLocks(uint64_t id)
 void
 FuseServer::Lock::purgeLocks()
 {
-  XrdSysMutexHelper lock(this);
+  eos::common::ProfiledMutexHelper lock(*this, "fuse::locks");
   std::set<uint64_t>purgeset;
 
   for (auto it = lockmap.begin(); it != lockmap.end(); ++it) {
@@ -1282,7 +1422,7 @@ FuseServer::Lock::dropLocks(uint64_t id, pid_t pid)
   // drop locks for a given inode/pid pair
   int retc = 0;
   {
-    XrdSysMutexHelper lock(this);
+    eos::common::ProfiledMutexHelper lock(*this, "fuse::locks");
 
     if (lockmap.count(id)) {
       lockmap[id]->removelk(pid);
@@ -1308,7 +1448,7 @@ FuseServer::Lock::dropLocks(const std::string& owner)
   // drop locks for a given owner
   int retc = 0;
   {
-    XrdSysMutexHelper lock(this);
+    eos::common::ProfiledMutexHelper lock(*this, "fuse::locks");
 
     for (auto it = lockmap.begin(); it != lockmap.end(); ++it) {
       it->second->removelk(owner);
@@ -1328,7 +1468,7 @@ FuseServer::Lock::lsLocks(const std::string& owner,
 {
   int retc = 0;
   {
-    XrdSysMutexHelper lock(this);
+    eos::common::ProfiledMutexHelper lock(*this, "fuse::locks");
 
     for (auto it = lockmap.begin(); it != lockmap.end(); ++it) {
       std::set<pid_t> rlk = it->second->getrlks(owner);
@@ -1347,7 +1487,7 @@ void
 FuseServer::Flush::beginFlush(uint64_t id, std::string client)
 {
   eos_static_info("ino=%016x client=%s", id, client.c_str());
-  XrdSysMutexHelper lock(this);
+  eos::common::ProfiledMutexHelper lock(*this, "fuse::flush");
   flush_info_t finfo(client);
   flushmap[id][client].Add(finfo);
 }
@@ -1359,7 +1499,7 @@ void
 FuseServer::Flush::endFlush(uint64_t id, std::string client)
 {
   eos_static_info("ino=%016x client=%s", id, client.c_str());
-  XrdSysMutexHelper lock(this);
+  eos::common::ProfiledMutexHelper lock(*this, "fuse::flush");
   flush_info_t finfo(client);
 
   if (flushmap[id][client].Remove(finfo)) {
@@ -1384,7 +1524,7 @@ FuseServer::Flush::hasFlush(uint64_t id)
 
   for (size_t i = 0 ; i < 8; ++i) {
     {
-      XrdSysMutexHelper lock(this);
+      eos::common::ProfiledMutexHelper lock(*this, "fuse::flush");
       has = validateFlush(id);
     }
 
@@ -1432,7 +1572,7 @@ FuseServer::Flush::validateFlush(uint64_t id)
 void
 FuseServer::Flush::expireFlush()
 {
-  XrdSysMutexHelper lock(this);
+  eos::common::ProfiledMutexHelper lock(*this, "fuse::flush");
 
   for (auto it = flushmap.begin(); it != flushmap.end();) {
     for (auto fit = it->second.begin(); fit != it->second.end();) {
@@ -1457,7 +1597,7 @@ FuseServer::Flush::expireFlush()
 void
 FuseServer::Flush::Print(std::string& out)
 {
-  XrdSysMutexHelper lock(this);
+  eos::common::ProfiledMutexHelper lock(*this, "fuse::flush");
 
   for (auto it = flushmap.begin(); it != flushmap.end(); ++it) {
     for (auto fit = it->second.begin(); fit != it->second.end(); ++fit) {
@@ -1480,7 +1620,7 @@ int
 FuseServer::FillContainerMD(uint64_t id, eos::fusex::md& dir,
                             eos::common::Mapping::VirtualIdentity* vid)
 {
-  gOFS->MgmStats.Add("Eosxd::int::FillContainerMD", vid->uid, vid->gid, 1);
+  MGM_STATS_ADD("Eosxd::int::FillContainerMD", vid->uid, vid->gid, 1);
   std::shared_ptr<eos::IContainerMD> cmd;
   eos::IContainerMD::ctime_t ctime;
   eos::IContainerMD::ctime_t mtime;
@@ -1572,7 +1712,7 @@ bool
 FuseServer::FillFileMD(uint64_t inode, eos::fusex::md& file,
                        eos::common::Mapping::VirtualIdentity* vid)
 {
-  gOFS->MgmStats.Add("Eosxd::int::FillFileMD", vid->uid, vid->gid, 1);
+  MGM_STATS_ADD("Eosxd::int::FillFileMD", vid->uid, vid->gid, 1);
   // fills file meta data by inode number
   std::shared_ptr<eos::IFileMD> fmd, gmd;
   eos::IFileMD::ctime_t ctime;
@@ -1679,7 +1819,7 @@ FuseServer::FillContainerCAP(uint64_t id,
                              std::string reuse_uuid,
                              bool issue_only_one)
 {
-  gOFS->MgmStats.Add("Eosxd::int::FillContainerCAP", vid->uid, vid->gid, 1);
+  MGM_STATS_ADD("Eosxd::int::FillContainerCAP", vid->uid, vid->gid, 1);
 
   if (issue_only_one) {
     if (EOS_LOGS_DEBUG) {
@@ -2017,7 +2157,7 @@ FuseServer::ValidatePERM(const eos::fusex::md& md, const std::string& mode,
                          eos::common::Mapping::VirtualIdentity* vid,
                          bool take_lock)
 {
-  gOFS->MgmStats.Add("Eosxd::int::ValidatePERM", vid->uid, vid->gid, 1);
+  MGM_STATS_ADD("Eosxd::int::ValidatePERM", vid->uid, vid->gid, 1);
   // -------------------------------------------------------------------------------------------------------------
   // - when an MGM was restarted it does not know anymore any client CAPs, but we can fallback to validate
   //   permissions on the fly again
@@ -2147,7 +2287,8 @@ FuseServer::HandleMD(const std::string& id,
                      const eos::fusex::md& md,
                      std::string* response,
                      uint64_t* clock,
-                     eos::common::Mapping::VirtualIdentity* vid)
+                     eos::common::Mapping::VirtualIdentity* vid,
+                     bool lspage)
 {
   std::string ops;
   int op_type = md.operation();
@@ -2186,7 +2327,7 @@ FuseServer::HandleMD(const std::string& id,
   }
 
   if (md.operation() == md.BEGINFLUSH) {
-    gOFS->MgmStats.Add("Eosxd::ext::BEGINFLUSH", vid->uid, vid->gid, 1);
+    MGM_STATS_ADD("Eosxd::ext::BEGINFLUSH", vid->uid, vid->gid, 1);
     // this is a flush begin/end indicator
     Flushs().beginFlush(md.md_ino(), md.clientuuid());
     eos::fusex::response resp;
@@ -2196,7 +2337,7 @@ FuseServer::HandleMD(const std::string& id,
   }
 
   if (md.operation() == md.ENDFLUSH) {
-    gOFS->MgmStats.Add("Eosxd::ext::ENDFLUSH", vid->uid, vid->gid, 1);
+    MGM_STATS_ADD("Eosxd::ext::ENDFLUSH", vid->uid, vid->gid, 1);
     Flushs().endFlush(md.md_ino(), md.clientuuid());
     eos::fusex::response resp;
     resp.set_type(resp.NONE);
@@ -2225,10 +2366,10 @@ FuseServer::HandleMD(const std::string& id,
       (*parent)[md.md_ino()].set_clientid(md.clientid());
 
       if (md.operation() == md.LS) {
-        gOFS->MgmStats.Add("Eosxd::ext::LS", vid->uid, vid->gid, 1);
+        MGM_STATS_ADD("Eosxd::ext::LS", vid->uid, vid->gid, 1);
         (*parent)[md.md_ino()].set_operation(md.LS);
       } else {
-        gOFS->MgmStats.Add("Eosxd::ext::GET", vid->uid, vid->gid, 1);
+        MGM_STATS_ADD("Eosxd::ext::GET", vid->uid, vid->gid, 1);
       }
 
       size_t n_attached = 1;
@@ -2239,6 +2380,7 @@ FuseServer::HandleMD(const std::string& id,
         // refresh the cap with the same authid
         FillContainerCAP(md.md_ino(), (*parent)[md.md_ino()], vid,
                          md.authid());
+        (*parent)[md.md_ino()].clear_operation();
         rd_ns_lock.Release();
 
         // store clock
@@ -2247,7 +2389,9 @@ FuseServer::HandleMD(const std::string& id,
         }
 
         if (md.operation() == md.LS) {
-          // attach children
+          // attach children - large listings are sent as several containers
+          // of up to 128 entries referencing the same parent inode to
+          // clients asking for pages
           auto map = (*parent)[md.md_ino()].children();
           auto it = map.begin();
 
@@ -2273,24 +2417,27 @@ FuseServer::HandleMD(const std::string& id,
             }
 
             rd_ns_lock.Release();
-          }
+            n_attached ++;
 
-          n_attached ++;
+            if (ListingPageFull(lspage, n_attached)) {
+              std::string rspstream;
+              cont.SerializeToString(&rspstream);
 
-          if (n_attached >= 128) {
-            std::string rspstream;
-            cont.SerializeToString(&rspstream);
+              if (!response) {
+                // send parent + first 128 children
+                gOFS->zMQ->task->reply(id, rspstream);
+              } else {
+                *response += Header(rspstream);
+                response->append(rspstream.c_str(), rspstream.size());
+              }
 
-            if (!response) {
-              // send parent + first 128 children
-              gOFS->zMQ->task->reply(id, rspstream);
-            } else {
-              *response += Header(rspstream);
-              response->append(rspstream.c_str(), rspstream.size());
+              n_attached = 0;
+              cont.Clear();
+              cont.set_type(cont.MDMAP);
+              cont.set_ref_inode_(md.md_ino());
+              mdmap = cont.mutable_md_map_();
+              parent = mdmap->mutable_md_map_();
             }
-
-            n_attached = 0;
-            cont.Clear();
           }
         }
 
@@ -2304,8 +2451,6 @@ FuseServer::HandleMD(const std::string& id,
         return retc;
       }
 
-      (*parent)[md.md_ino()].clear_operation();
-
       if (n_attached) {
         // send left-over children
         std::string rspstream;
@@ -2344,7 +2489,7 @@ FuseServer::HandleMD(const std::string& id,
   }
 
   if (md.operation() == md.SET) {
-    gOFS->MgmStats.Add("Eosxd::ext::SET", vid->uid, vid->gid, 1);
+    MGM_STATS_ADD("Eosxd::ext::SET", vid->uid, vid->gid, 1);
     uint64_t md_pino = md.md_pino();
 
     if (!md_pino) {
@@ -2564,19 +2709,19 @@ FuseServer::HandleMD(const std::string& id,
 
         switch (op) {
         case MOVE:
-          gOFS->MgmStats.Add("Eosxd::ext::MV", vid->uid, vid->gid, 1);
+          MGM_STATS_ADD("Eosxd::ext::MV", vid->uid, vid->gid, 1);
           break;
 
         case UPDATE:
-          gOFS->MgmStats.Add("Eosxd::ext::UPDATE", vid->uid, vid->gid, 1);
+          MGM_STATS_ADD("Eosxd::ext::UPDATE", vid->uid, vid->gid, 1);
           break;
 
         case CREATE:
-          gOFS->MgmStats.Add("Eosxd::ext::MKDIR", vid->uid, vid->gid, 1);
+          MGM_STATS_ADD("Eosxd::ext::MKDIR", vid->uid, vid->gid, 1);
           break;
 
         case RENAME:
-          gOFS->MgmStats.Add("Eosxd::ext::RENAME", vid->uid, vid->gid, 1);
+          MGM_STATS_ADD("Eosxd::ext::RENAME", vid->uid, vid->gid, 1);
           break;
         }
 
@@ -2863,19 +3008,19 @@ FuseServer::HandleMD(const std::string& id,
 
         switch (op) {
         case MOVE:
-          gOFS->MgmStats.Add("Eosxd::ext::MV", vid->uid, vid->gid, 1);
+          MGM_STATS_ADD("Eosxd::ext::MV", vid->uid, vid->gid, 1);
           break;
 
         case UPDATE:
-          gOFS->MgmStats.Add("Eosxd::ext::UPDATE", vid->uid, vid->gid, 1);
+          MGM_STATS_ADD("Eosxd::ext::UPDATE", vid->uid, vid->gid, 1);
           break;
 
         case CREATE:
-          gOFS->MgmStats.Add("Eosxd::ext::CREATE", vid->uid, vid->gid, 1);
+          MGM_STATS_ADD("Eosxd::ext::CREATE", vid->uid, vid->gid, 1);
           break;
 
         case RENAME:
-          gOFS->MgmStats.Add("Eosxd::ext::RENAME", vid->uid, vid->gid, 1);
+          MGM_STATS_ADD("Eosxd::ext::RENAME", vid->uid, vid->gid, 1);
           break;
         }
 
@@ -2914,7 +3059,7 @@ FuseServer::HandleMD(const std::string& id,
       uint64_t md_pino = md.md_pino();
 
       try {
-        gOFS->MgmStats.Add("Eosxd::ext::CREATELNK", vid->uid, vid->gid, 1);
+        MGM_STATS_ADD("Eosxd::ext::CREATELNK", vid->uid, vid->gid, 1);
         // link creation
         pcmd = gOFS->eosDirectoryService->getContainerMD(md.md_pino());
         fmd = pcmd->findFile(md.name());
@@ -3056,7 +3201,7 @@ FuseServer::HandleMD(const std::string& id,
       pcmd->setMTime(mtime);
 
       if (S_ISDIR(md.mode())) {
-        gOFS->MgmStats.Add("Eosxd::ext::RMDIR", vid->uid, vid->gid, 1);
+        MGM_STATS_ADD("Eosxd::ext::RMDIR", vid->uid, vid->gid, 1);
 
         // check if this directory is empty
         if (cmd->getNumContainers() || cmd->getNumFiles()) {
@@ -3084,7 +3229,7 @@ FuseServer::HandleMD(const std::string& id,
       }
 
       if (S_ISREG(md.mode()) || S_ISFIFO(md.mode())) {
-        gOFS->MgmStats.Add("Eosxd::ext::DELETE", vid->uid, vid->gid, 1);
+        MGM_STATS_ADD("Eosxd::ext::DELETE", vid->uid, vid->gid, 1);
         eos_static_info("ino=%lx delete-file", (long) md.md_ino());
         eos::IContainerMD::XAttrMap attrmap = pcmd->getAttributes();
 
@@ -3180,7 +3325,7 @@ FuseServer::HandleMD(const std::string& id,
       }
 
       if (S_ISLNK(md.mode())) {
-        gOFS->MgmStats.Add("Eosxd::ext::DELETELNK", vid->uid, vid->gid, 1);
+        MGM_STATS_ADD("Eosxd::ext::DELETELNK", vid->uid, vid->gid, 1);
         eos_static_info("ino=%lx delete-link", (long) md.md_ino());
         pcmd->removeFile(fmd->getName());
         fmd->setContainerId(0);
@@ -3209,7 +3354,7 @@ FuseServer::HandleMD(const std::string& id,
   }
 
   if (md.operation() == md.GETCAP) {
-    gOFS->MgmStats.Add("Eosxd::ext::GETCAP", vid->uid, vid->gid, 1);
+    MGM_STATS_ADD("Eosxd::ext::GETCAP", vid->uid, vid->gid, 1);
     eos::fusex::container cont;
     cont.set_type(cont.CAP);
     eos::fusex::md lmd;
@@ -3241,7 +3386,7 @@ FuseServer::HandleMD(const std::string& id,
   }
 
   if (md.operation() == md.GETLK) {
-    gOFS->MgmStats.Add("Eosxd::ext::GETLK", vid->uid, vid->gid, 1);
+    MGM_STATS_ADD("Eosxd::ext::GETLK", vid->uid, vid->gid, 1);
     eos::fusex::response resp;
     resp.set_type(resp.LOCK);
     struct flock lock;
@@ -3278,10 +3423,10 @@ FuseServer::HandleMD(const std::string& id,
     int sleep = 0;
 
     if (md.operation() == md.SETLKW) {
-      gOFS->MgmStats.Add("Eosxd::ext::SETLKW", vid->uid, vid->gid, 1);
+      MGM_STATS_ADD("Eosxd::ext::SETLKW", vid->uid, vid->gid, 1);
       sleep = 1;
     } else {
-      gOFS->MgmStats.Add("Eosxd::ext::SETLK", vid->uid, vid->gid, 1);
+      MGM_STATS_ADD("Eosxd::ext::SETLK", vid->uid, vid->gid, 1);
     }
 
     struct flock lock;
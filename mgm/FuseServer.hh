@@ -30,9 +30,11 @@
 #include <unistd.h>
 #include <map>
 #include <atomic>
-#include <deque>
+#include <tuple>
 #include "mgm/fusex.pb.h"
 #include "mgm/fuse-locks/LockTracker.hh"
+#include "mgm/TimerWheel.hh"
+#include "mgm/FuseBroadcaster.hh"
 #include "common/Mapping.hh"
 #include "XrdSys/XrdSysPthread.hh"
 #include <google/protobuf/util/json_util.h>
@@ -104,49 +106,23 @@ public:
     typedef std::map<clientid_t, ino_set_t> client_ino_set_t;
 
 
+    // (uid, gid, quota node inode) of the quota a cap is accounted on
+    typedef std::tuple<uid_t, gid_t, uint64_t> quota_id_t;
+    typedef std::map<quota_id_t, authid_set_t> quota_set_t;
+
     ssize_t ncaps()
     {
       eos::common::RWMutexReadLock lock(*this);
-      return mTimeOrderedCap.size();
+      return mCaps.size();
     }
 
-    void pop()
-    {
-      eos::common::RWMutexWriteLock lock(*this);
-      mTimeOrderedCap.pop_front();
-    }
-
-    bool expire()
-    {
-      eos::common::RWMutexWriteLock lock(*this);
-      authid_t id;
-
-      if (!mTimeOrderedCap.empty()) {
-        id = mTimeOrderedCap.front();
-      } else {
-        return false;
-      }
-
-      if (mCaps.count(id)) {
-        shared_cap cap = mCaps[id];
-        uint64_t now = (uint64_t) time(NULL);
-
-        if ((cap->vtime() + 10) <= now) {
-          mCaps.erase(id);
-          mInodeCaps[cap->id()].erase(id);
-
-          if (!mInodeCaps[cap->id()].size()) {
-            mInodeCaps.erase(cap->id());
-          }
-
-          return true;
-        } else {
-          return false;
-        }
-      }
-
-      return true;
-    }
+    //--------------------------------------------------------------------------
+    //! Remove all caps which are expired since 10 seconds - only visits the
+    //! caps which were scheduled to expire since the last call
+    //!
+    //! @return number of caps removed
+    //--------------------------------------------------------------------------
+    size_t expire();
 
     void Store(const eos::fusex::cap& cap,
                eos::common::Mapping::VirtualIdentity* vid);
@@ -159,6 +135,14 @@ public:
 
     int Delete(uint64_t id);
 
+    //--------------------------------------------------------------------------
+    //! Remove the caps a client id holds on an inode, used when the client
+    //! was asked to release them without being able to refuse
+    //!
+    //! @return number of caps removed
+    //--------------------------------------------------------------------------
+    size_t Revoke(uint64_t md_ino, const std::string& clientid);
+
     shared_cap Get(authid_t id);
 
     int BroadcastCap(shared_cap cap);
@@ -194,9 +178,32 @@ public:
       return mClientInoCaps;
     }
 
+    quota_set_t& QuotaCaps()
+    {
+      return mQuotaCaps;
+    }
+
   protected:
-    // a time ordered list pointing to caps
-    std::deque< authid_t > mTimeOrderedCap;
+    //--------------------------------------------------------------------------
+    //! Add a cap to all views replacing a cap with the same authid -
+    //! requires the write lock
+    //--------------------------------------------------------------------------
+    void Add(shared_cap cap);
+
+    //--------------------------------------------------------------------------
+    //! Remove a cap from all views - requires the write lock
+    //--------------------------------------------------------------------------
+    void Remove(shared_cap cap);
+
+    //--------------------------------------------------------------------------
+    //! Get the quota a cap is accounted on
+    //!
+    //! @return false if the cap carries no quota information
+    //--------------------------------------------------------------------------
+    static bool QuotaId(shared_cap cap, quota_id_t& qid);
+
+    // caps by expiry time
+    TimerWheel<authid_t> mExpiry;
     // authid=>cap lookup map
     std::map<authid_t, shared_cap> mCaps;
     // clientid=>list of authid
@@ -205,6 +212,8 @@ public:
     client_ino_set_t mClientInoCaps;
     // inode=>authid_t
     notify_set_t mInodeCaps;
+    // quota node=>authid_t
+    quota_set_t mQuotaCaps;
   };
 
   //----------------------------------------------------------------------------
@@ -321,14 +330,16 @@ public:
                    const std::string& uuid,
                    const std::string& clientid);
 
-    // send MD after update
+    // send MD after update, the cap of cap_ino is released instead if the
+    // client falls behind
     int SendMD(const eos::fusex::md& md,
                const std::string& uuid,
                const std::string& clientid,
                uint64_t md_ino,
                uint64_t md_pino,
                uint64_t clock,
-               struct timespec& p_mtime
+               struct timespec& p_mtime,
+               uint64_t cap_ino
               );
 
     // broadcast a new cap
@@ -506,6 +517,11 @@ public:
     return mFlushs;
   }
 
+  FuseBroadcaster& Broadcasts()
+  {
+    return mBroadcaster;
+  }
+
   void Print(std::string& out, std::string options = "", bool monitoring = false);
 
   int FillContainerMD(uint64_t id, eos::fusex::md& dir,
@@ -528,11 +544,52 @@ public:
 
   std::string Header(const std::string& response); // reply a sync-response header
 
+  //----------------------------------------------------------------------------
+  //! Handle a md request
+  //!
+  //! @param lspage the client merges an LS response sent as several containers
+  //----------------------------------------------------------------------------
   int HandleMD(const std::string& identity,
                const eos::fusex::md& md,
                std::string* response = 0,
                uint64_t* clock = 0,
-               eos::common::Mapping::VirtualIdentity* vid = 0);
+               eos::common::Mapping::VirtualIdentity* vid = 0,
+               bool lspage = false);
+
+  //----------------------------------------------------------------------------
+  //! Check if the children attached to an LS response are sent as a page.
+  //! Only clients sending mgm.lspage get the listing in several containers,
+  //! older clients take the first child of a container without its parent
+  //! for the listed directory.
+  //!
+  //! @param lspage client merges paged listings
+  //! @param n_attached number of md entries in the current container
+  //!
+  //! @return true if the current container is sent as a page
+  //----------------------------------------------------------------------------
+  static bool ListingPageFull(bool lspage, size_t n_attached)
+  {
+    return (lspage && (n_attached >= 128));
+  }
+
+  //----------------------------------------------------------------------------
+  //! Check if a GET/LS request is answered with EEXIST because the md did not
+  //! change since the client's clock. Only clients sending mgm.ifclock get
+  //! this answer, older clients always send their clock and expect the md.
+  //!
+  //! @param ifclock client asked for a conditional request
+  //! @param op requested operation
+  //! @param client_clock clock sent by the client
+  //! @param md_clock current clock of the md
+  //!
+  //! @return true if the request is answered with EEXIST
+  //----------------------------------------------------------------------------
+  static bool UnchangedSinceClock(bool ifclock, const std::string& op,
+                                  uint64_t client_clock, uint64_t md_clock)
+  {
+    return (ifclock && ((op == "GET") || (op == "LS")) && client_clock &&
+            (client_clock == md_clock));
+  }
 
   void
   MonitorCaps() noexcept;
@@ -552,6 +609,8 @@ protected:
   Caps mCaps;
   Lock mLocks;
   Flush mFlushs;
+  // asynchronous fan-out of md updates and cap releases
+  FuseBroadcaster mBroadcaster;
 
 private:
   std::atomic<bool> terminate_;
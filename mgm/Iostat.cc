@@ -26,17 +26,158 @@
 #include "common/Report.hh"
 #include "common/Path.hh"
 #include "common/JeMallocHandler.hh"
+#include "common/SymKeys.hh"
 #include "mgm/Iostat.hh"
 #include "mgm/XrdMgmOfs.hh"
 #include "mgm/FsView.hh"
 #include "namespace/interface/IView.hh"
 #include "namespace/Prefetcher.hh"
+#include "proto/IoReport.pb.h"
 /*----------------------------------------------------------------------------*/
 #include "XrdSys/XrdSysDNS.hh"
 /*----------------------------------------------------------------------------*/
 
 EOSMGMNAMESPACE_BEGIN
 
+namespace
+{
+//------------------------------------------------------------------------------
+//! Convert a binary report into a report object
+//------------------------------------------------------------------------------
+void
+IoReportToReport(const eos::fst::IoReport& in, eos::common::Report& out)
+{
+  out.ots = in.ots();
+  out.cts = in.cts();
+  out.otms = in.otms();
+  out.ctms = in.ctms();
+  out.logid = in.logid();
+  out.path = in.path();
+  out.uid = in.uid();
+  out.gid = in.gid();
+  out.td = in.has_td() ? in.td() : "none";
+  out.SetHost(in.has_host() ? in.host() : "none");
+  out.lid = in.lid();
+  out.fid = in.fid();
+  out.fsid = in.fsid();
+  out.rb = in.rb();
+  out.rb_min = in.rb_min();
+  out.rb_max = in.rb_max();
+  out.rb_sigma = in.rb_sigma();
+  out.rv_op = in.rv_op();
+  out.rvb_min = in.rvb_min();
+  out.rvb_max = in.rvb_max();
+  out.rvb_sum = in.rvb_sum();
+  out.rvb_sigma = in.rvb_sigma();
+  out.rs_op = in.rs_op();
+  out.rsb_min = in.rsb_min();
+  out.rsb_max = in.rsb_max();
+  out.rsb_sum = in.rsb_sum();
+  out.rsb_sigma = in.rsb_sigma();
+  out.rc_min = in.rc_min();
+  out.rc_max = in.rc_max();
+  out.rc_sum = in.rc_sum();
+  out.rc_sigma = in.rc_sigma();
+  out.wb = in.wb();
+  out.wb_min = in.wb_min();
+  out.wb_max = in.wb_max();
+  out.wb_sigma = in.wb_sigma();
+  out.sfwdb = in.sfwdb();
+  out.sbwdb = in.sbwdb();
+  out.sxlfwdb = in.sxlfwdb();
+  out.sxlbwdb = in.sxlbwdb();
+  out.nrc = in.nrc();
+  out.nwc = in.nwc();
+  out.nfwds = in.nfwds();
+  out.nbwds = in.nbwds();
+  out.nxlfwds = in.nxlfwds();
+  out.nxlbwds = in.nxlbwds();
+  out.rt = in.rt();
+  out.rvt = in.rvt();
+  out.wt = in.wt();
+  out.osize = in.osize();
+  out.csize = in.csize();
+  out.sec_prot = in.sec_prot();
+  out.sec_name = in.sec_name();
+  out.SetSecHost(in.sec_host());
+  out.sec_vorg = in.sec_vorg();
+  out.sec_grps = in.sec_grps();
+  out.sec_role = in.sec_role();
+  out.sec_info = in.sec_info();
+  out.sec_app = in.sec_app();
+
+  if (out.sec_app.find('?') != std::string::npos) {
+    out.sec_app.erase(out.sec_app.find('?'));
+  }
+
+  out.dsize = in.dsize();
+  out.dc_ts = in.dc_ts();
+  out.dc_tns = in.dc_tns();
+  out.dm_ts = in.dm_ts();
+  out.dm_tns = in.dm_tns();
+  out.da_ts = in.da_ts();
+  out.da_tns = in.da_tns();
+}
+
+//------------------------------------------------------------------------------
+//! Render a binary report in the env format used in the report log files,
+//! only the fields sent by the FST are rendered
+//------------------------------------------------------------------------------
+void
+IoReportToEnv(const eos::fst::IoReport& in, std::string& out)
+{
+  using google::protobuf::FieldDescriptor;
+  const google::protobuf::Descriptor* desc = in.GetDescriptor();
+  const google::protobuf::Reflection* refl = in.GetReflection();
+  char val[64];
+  out.clear();
+
+  for (int i = 0; i < desc->field_count(); ++i) {
+    const FieldDescriptor* field = desc->field(i);
+
+    if (!refl->HasField(in, field)) {
+      continue;
+    }
+
+    if (out.length()) {
+      out += '&';
+    }
+
+    out += eos::common::Report::EnvKey(field->name());
+    out += '=';
+
+    switch (field->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_STRING:
+      out += refl->GetString(in, field);
+      continue;
+
+    case FieldDescriptor::CPPTYPE_UINT32:
+      snprintf(val, sizeof(val), "%u", refl->GetUInt32(in, field));
+      break;
+
+    case FieldDescriptor::CPPTYPE_UINT64:
+      snprintf(val, sizeof(val), "%llu",
+               (unsigned long long) refl->GetUInt64(in, field));
+      break;
+
+    case FieldDescriptor::CPPTYPE_DOUBLE:
+      snprintf(val, sizeof(val), "%.02f", refl->GetDouble(in, field));
+      break;
+
+    case FieldDescriptor::CPPTYPE_FLOAT:
+      snprintf(val, sizeof(val), "%.02f", refl->GetFloat(in, field));
+      break;
+
+    default:
+      val[0] = '\0';
+      break;
+    }
+
+    out += val;
+  }
+}
+}
+
 const char* Iostat::gIostatCollect = "iostat::collect";
 const char* Iostat::gIostatReport = "iostat::report";
 const char* Iostat::gIostatReportNamespace = "iostat::reportnamespace";
@@ -49,6 +190,7 @@ Iostat::Iostat()
 {
   mRunning = false;
   mInit = false;
+  mDropped = 0;
   mStoreFileName = "";
   cthread = 0;
   thread = 0;
@@ -77,11 +219,6 @@ Iostat::Iostat()
   IoNodes.insert("cms-cdr"); // CMS DAQ
   IoNodes.insert("pc-tdq"); // ATLAS DAQ
 
-  for (size_t i = 0; i < IOSTAT_POPULARITY_HISTORY_DAYS; i++) {
-    IostatPopularity[i].set_deleted_key("");
-    IostatPopularity[i].resize(100000);
-  }
-
   IostatLastPopularityBin = 0;
   mReportPopularity = true;
   mReportNamespace = false;
@@ -178,6 +315,12 @@ Iostat::Start()
 
   if (!mRunning) {
     mClient.Subscribe();
+
+    for (unsigned int i = 0; i < sNumWorkers; ++i) {
+      mWorkers.emplace_back(new AssistedThread());
+      mWorkers.back()->reset(&Iostat::ProcessReports, this);
+    }
+
     XrdSysThread::Run(&thread, Iostat::StaticReceive, static_cast<void*>(this),
                       XRDSYSTHREAD_HOLD, "Report Receiver Thread");
     mRunning = true;
@@ -194,6 +337,13 @@ Iostat::Stop()
   if (mRunning) {
     XrdSysThread::Cancel(thread);
     XrdSysThread::Join(thread, NULL);
+
+    // workers merge what they collected before exiting
+    for (auto& worker : mWorkers) {
+      worker->stop();
+    }
+
+    mWorkers.clear();
     mRunning = false;
     mClient.Unsubscribe();
     return true;
@@ -233,257 +383,411 @@ Iostat::StaticCirculate(void* arg)
 void*
 Iostat::Receive(void)
 {
+  // the receiver thread only queues the message bodies, they are digested by
+  // the worker threads
   while (1) {
     XrdMqMessage* newmessage = 0;
 
     while ((newmessage = mClient.RecvMessage())) {
-      XrdOucString body = newmessage->GetBody();
+      std::string body = newmessage->GetBody();
+      delete newmessage;
+      std::unique_lock<std::mutex> lock(mQueueMutex);
 
-      while (body.replace("&&", "&")) {
-      }
+      if (mQueue.size() >= sMaxQueued) {
+        lock.unlock();
 
-      XrdOucEnv ioreport(body.c_str());
-      eos::common::Report* report = new eos::common::Report(ioreport);
-      Add("bytes_read", report->uid, report->gid, report->rb, report->ots,
-          report->cts);
-      Add("bytes_read", report->uid, report->gid, report->rvb_sum, report->ots,
-          report->cts);
-      Add("bytes_written", report->uid, report->gid, report->wb, report->ots,
-          report->cts);
-      Add("read_calls", report->uid, report->gid, report->nrc, report->ots,
-          report->cts);
-      Add("readv_calls", report->uid, report->gid, report->rv_op, report->ots,
-          report->cts);
-      Add("write_calls", report->uid, report->gid, report->nwc, report->ots,
-          report->cts);
-      Add("fwd_seeks", report->uid, report->gid, report->nfwds, report->ots,
-          report->cts);
-      Add("bwd_seeks", report->uid, report->gid, report->nbwds, report->ots,
-          report->cts);
-      Add("xl_fwd_seeks", report->uid, report->gid, report->nxlfwds, report->ots,
-          report->cts);
-      Add("xl_bwd_seeks", report->uid, report->gid, report->nxlbwds, report->ots,
-          report->cts);
-      Add("bytes_fwd_seek", report->uid, report->gid, report->sfwdb, report->ots,
-          report->cts);
-      Add("bytes_bwd_wseek", report->uid, report->gid, report->sbwdb, report->ots,
-          report->cts);
-      Add("bytes_xl_fwd_seek", report->uid, report->gid, report->sxlfwdb, report->ots,
-          report->cts);
-      Add("bytes_xl_bwd_wseek", report->uid, report->gid, report->sxlbwdb,
-          report->ots, report->cts);
-      Add("disk_time_read", report->uid, report->gid, (unsigned long long) report->rt,
-          report->ots, report->cts);
-      Add("disk_time_write", report->uid, report->gid,
-          (unsigned long long) report->wt, report->ots, report->cts);
-      {
-        // track deletions
-        time_t now = time(NULL);
-        Add("bytes_deleted", 0, 0, report->dsize, now - 30, now);
-        Add("files_deleted", 0, 0, 1, now - 30, now);
+        if (!(mDropped++ % 1000)) {
+          eos_static_err("msg=\"report queue full, dropping report messages\" "
+                         "dropped=%llu", mDropped.load());
+        }
+
+        continue;
       }
-      // do the UDP broadcasting here
-      {
-        XrdSysMutexHelper mLock(BroadcastMutex);
 
-        if (mUdpPopularityTarget.size()) {
-          UdpBroadCast(report);
-        }
+      mQueue.push_back(std::move(body));
+      lock.unlock();
+      mQueueCv.notify_one();
+    }
+
+    XrdSysThread::SetCancelOn();
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    XrdSysThread::CancelPoint();
+    XrdSysThread::SetCancelOff();
+  }
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Worker thread digesting the queued report messages
+//------------------------------------------------------------------------------
+void
+Iostat::ProcessReports(ThreadAssistant& assistant)
+{
+  IostatAggregate agg;
+  auto last_merge = std::chrono::steady_clock::now();
+
+  while (!assistant.terminationRequested()) {
+    std::string body;
+    {
+      std::unique_lock<std::mutex> lock(mQueueMutex);
+      mQueueCv.wait_for(lock, std::chrono::milliseconds(500),
+      [&] {return !mQueue.empty();});
+
+      if (!mQueue.empty()) {
+        body.swap(mQueue.front());
+        mQueue.pop_front();
       }
+    }
 
-      // do the domain accounting here
-      if (report->path.substr(0, 11) == "/replicate:") {
-        // check if this is a replication path
-        // push into the 'eos' domain
-        Mutex.Lock();
+    if (body.length()) {
+      ProcessMessage(body, agg);
+    }
 
-        if (report->rb) {
-          IostatAvgDomainIOrb["eos"].Add(report->rb, report->ots, report->cts);
-        }
+    auto now = std::chrono::steady_clock::now();
 
-        if (report->wb) {
-          IostatAvgDomainIOwb["eos"].Add(report->wb, report->ots, report->cts);
-        }
+    if (agg.mNumReports &&
+        (body.empty() || (now - last_merge >= std::chrono::seconds(1)))) {
+      Merge(agg);
+      last_merge = now;
+    }
+  }
 
-        Mutex.UnLock();
-      } else {
-        bool dfound = false;
+  Merge(agg);
+}
 
-        if (mReportPopularity) {
-          // do the popularity accounting here for everything which is not replication!
-          AddToPopularity(report->path, report->rb, report->ots, report->cts);
-        }
+//------------------------------------------------------------------------------
+// Digest a report message
+//------------------------------------------------------------------------------
+void
+Iostat::ProcessMessage(std::string& body, IostatAggregate& agg)
+{
+  static const std::string batch_tag = "iostat.batch=";
 
-        size_t pos = 0;
+  if (body.compare(0, batch_tag.length(), batch_tag)) {
+    // single report in env format as sent by older FSTs
+    XrdOucString sbody = body.c_str();
 
-        if ((pos = report->sec_domain.rfind(".")) != std::string::npos) {
-          // we can sort in by domain
-          std::string sdomain = report->sec_domain.substr(pos);
+    while (sbody.replace("&&", "&")) {
+    }
 
-          if (IoDomains.find(sdomain) != IoDomains.end()) {
-            Mutex.Lock();
+    XrdOucEnv ioreport(sbody.c_str());
+    eos::common::Report report(ioreport);
+    ProcessReport(report, sbody.c_str(), agg);
+    return;
+  }
 
-            if (report->rb) {
-              IostatAvgDomainIOrb[sdomain].Add(report->rb, report->ots, report->cts);
-            }
+  std::string zb64 = body.substr(batch_tag.length());
+  std::string raw;
+  eos::fst::IoReportBatch batch;
 
-            if (report->wb) {
-              IostatAvgDomainIOwb[sdomain].Add(report->wb, report->ots, report->cts);
-            }
+  if (!eos::common::SymKey::ZDeBase64(zb64, raw) ||
+      !batch.ParseFromString(raw)) {
+    eos_static_err("msg=\"failed to decode report batch\" length=%zu",
+                   body.length());
+    return;
+  }
 
-            Mutex.UnLock();
-            dfound = true;
-          }
-        }
+  bool records = (mReport || mReportNamespace);
+  std::string record;
 
-        // do the node accounting here - keep the node list small !!!
-        std::set<std::string>::const_iterator nit;
+  for (int i = 0; i < batch.report_size(); ++i) {
+    const eos::fst::IoReport& io_report = batch.report(i);
+    eos::common::Report report;
+    IoReportToReport(io_report, report);
 
-        for (nit = IoNodes.begin(); nit != IoNodes.end(); nit++) {
-          if (*nit == report->sec_host.substr(0, nit->length())) {
-            Mutex.Lock();
+    if (records) {
+      IoReportToEnv(io_report, record);
+    }
 
-            if (report->rb) {
-              IostatAvgDomainIOrb[*nit].Add(report->rb, report->ots, report->cts);
-            }
+    ProcessReport(report, record, agg);
+  }
+}
 
-            if (report->wb) {
-              IostatAvgDomainIOwb[*nit].Add(report->wb, report->ots, report->cts);
-            }
+//------------------------------------------------------------------------------
+// Digest one report
+//------------------------------------------------------------------------------
+void
+Iostat::ProcessReport(eos::common::Report& report, const std::string& record,
+                      IostatAggregate& agg)
+{
+  ++agg.mNumReports;
+  agg.Add("bytes_read", report.uid, report.gid, report.rb, report.ots,
+          report.cts);
+  agg.Add("bytes_read", report.uid, report.gid, report.rvb_sum, report.ots,
+          report.cts);
+  agg.Add("bytes_written", report.uid, report.gid, report.wb, report.ots,
+          report.cts);
+  agg.Add("read_calls", report.uid, report.gid, report.nrc, report.ots,
+          report.cts);
+  agg.Add("readv_calls", report.uid, report.gid, report.rv_op, report.ots,
+          report.cts);
+  agg.Add("write_calls", report.uid, report.gid, report.nwc, report.ots,
+          report.cts);
+  agg.Add("fwd_seeks", report.uid, report.gid, report.nfwds, report.ots,
+          report.cts);
+  agg.Add("bwd_seeks", report.uid, report.gid, report.nbwds, report.ots,
+          report.cts);
+  agg.Add("xl_fwd_seeks", report.uid, report.gid, report.nxlfwds, report.ots,
+          report.cts);
+  agg.Add("xl_bwd_seeks", report.uid, report.gid, report.nxlbwds, report.ots,
+          report.cts);
+  agg.Add("bytes_fwd_seek", report.uid, report.gid, report.sfwdb, report.ots,
+          report.cts);
+  agg.Add("bytes_bwd_wseek", report.uid, report.gid, report.sbwdb, report.ots,
+          report.cts);
+  agg.Add("bytes_xl_fwd_seek", report.uid, report.gid, report.sxlfwdb,
+          report.ots, report.cts);
+  agg.Add("bytes_xl_bwd_wseek", report.uid, report.gid, report.sxlbwdb,
+          report.ots, report.cts);
+  agg.Add("disk_time_read", report.uid, report.gid,
+          (unsigned long long) report.rt, report.ots, report.cts);
+  agg.Add("disk_time_write", report.uid, report.gid,
+          (unsigned long long) report.wt, report.ots, report.cts);
+  {
+    // track deletions
+    time_t now = time(NULL);
+    agg.Add("bytes_deleted", 0, 0, report.dsize, now - 30, now);
+    agg.Add("files_deleted", 0, 0, 1, now - 30, now);
+  }
+  // do the UDP broadcasting here
+  {
+    XrdSysMutexHelper mLock(BroadcastMutex);
 
-            Mutex.UnLock();
-            dfound = true;
-          }
-        }
+    if (mUdpPopularityTarget.size()) {
+      UdpBroadCast(&report);
+    }
+  }
 
-        if (!dfound) {
-          // push into the 'other' domain
-          Mutex.Lock();
+  // do the domain accounting here
+  if (report.path.substr(0, 11) == "/replicate:") {
+    // check if this is a replication path
+    // push into the 'eos' domain
+    if (report.rb) {
+      agg.mDomainIOrb["eos"].Add(report.rb, report.ots, report.cts);
+    }
 
-          if (report->rb) {
-            IostatAvgDomainIOrb["other"].Add(report->rb, report->ots, report->cts);
-          }
+    if (report.wb) {
+      agg.mDomainIOwb["eos"].Add(report.wb, report.ots, report.cts);
+    }
+  } else {
+    bool dfound = false;
 
-          if (report->wb) {
-            IostatAvgDomainIOwb["other"].Add(report->wb, report->ots, report->cts);
-          }
+    if (mReportPopularity) {
+      // do the popularity accounting here for everything which is not replication!
+      AddToPopularity(report.path, report.rb, report.ots, report.cts);
+    }
 
-          Mutex.UnLock();
+    size_t pos = 0;
+
+    if ((pos = report.sec_domain.rfind(".")) != std::string::npos) {
+      // we can sort in by domain
+      std::string sdomain = report.sec_domain.substr(pos);
+
+      if (IoDomains.find(sdomain) != IoDomains.end()) {
+        if (report.rb) {
+          agg.mDomainIOrb[sdomain].Add(report.rb, report.ots, report.cts);
         }
-      }
 
-      // do the application accounting here
-      std::string apptag = "other";
+        if (report.wb) {
+          agg.mDomainIOwb[sdomain].Add(report.wb, report.ots, report.cts);
+        }
 
-      if (report->sec_app.length()) {
-        apptag = report->sec_app;
+        dfound = true;
       }
+    }
+
+    // do the node accounting here - keep the node list small !!!
+    std::set<std::string>::const_iterator nit;
+
+    for (nit = IoNodes.begin(); nit != IoNodes.end(); nit++) {
+      if (*nit == report.sec_host.substr(0, nit->length())) {
+        if (report.rb) {
+          agg.mDomainIOrb[*nit].Add(report.rb, report.ots, report.cts);
+        }
 
-      // Push into app accounting
-      Mutex.Lock();
+        if (report.wb) {
+          agg.mDomainIOwb[*nit].Add(report.wb, report.ots, report.cts);
+        }
 
-      if (report->rb) {
-        IostatAvgAppIOrb[apptag].Add(report->rb, report->ots, report->cts);
+        dfound = true;
       }
+    }
 
-      if (report->wb) {
-        IostatAvgAppIOwb[apptag].Add(report->wb, report->ots, report->cts);
+    if (!dfound) {
+      // push into the 'other' domain
+      if (report.rb) {
+        agg.mDomainIOrb["other"].Add(report.rb, report.ots, report.cts);
       }
 
-      Mutex.UnLock();
-
-      if (mReport) {
-        // add the record to a daily report log file
-        static XrdOucString openreportfile = "";
-        time_t now = time(NULL);
-        struct tm nowtm;
-        XrdOucString reportfile = "";
-
-        if (localtime_r(&now, &nowtm)) {
-          static char logfile[4096];
-          snprintf(logfile, sizeof(logfile) - 1, "%s/%04u/%02u/%04u%02u%02u.eosreport",
-                   gOFS->IoReportStorePath.c_str(),
-                   1900 + nowtm.tm_year,
-                   nowtm.tm_mon + 1,
-                   1900 + nowtm.tm_year,
-                   nowtm.tm_mon + 1,
-                   nowtm.tm_mday);
-          reportfile = logfile;
-
-          if (reportfile == openreportfile) {
-            // just add it here;
-            if (gOpenReportFD) {
-              fprintf(gOpenReportFD, "%s\n", body.c_str());
-              fflush(gOpenReportFD);
-            }
-          } else {
-            Mutex.Lock();
-
-            if (gOpenReportFD) {
-              fclose(gOpenReportFD);
-            }
-
-            eos::common::Path cPath(reportfile.c_str());
-
-            if (cPath.MakeParentPath(S_IRWXU)) {
-              gOpenReportFD = fopen(reportfile.c_str(), "a+");
-
-              if (gOpenReportFD) {
-                fprintf(gOpenReportFD, "%s\n", body.c_str());
-                fflush(gOpenReportFD);
-              }
-
-              openreportfile = reportfile;
-            }
-
-            Mutex.UnLock();
-          }
-        }
+      if (report.wb) {
+        agg.mDomainIOwb["other"].Add(report.wb, report.ots, report.cts);
       }
+    }
+  }
 
-      if (mReportNamespace) {
-        // add the record into the report namespace file
-        char path[4096];
-        snprintf(path, sizeof(path) - 1, "%s/%s", gOFS->IoReportStorePath.c_str(),
-                 report->path.c_str());
-        eos::common::Path cPath(path);
+  // do the application accounting here
+  std::string apptag = "other";
 
-        if (cPath.MakeParentPath(S_IRWXU)) {
-          FILE* freport = fopen(path, "a+");
+  if (report.sec_app.length()) {
+    apptag = report.sec_app;
+  }
 
-          if (freport) {
-            fprintf(freport, "%s\n", body.c_str());
-            fclose(freport);
-          }
-        }
+  if (report.rb) {
+    agg.mAppIOrb[apptag].Add(report.rb, report.ots, report.cts);
+  }
+
+  if (report.wb) {
+    agg.mAppIOwb[apptag].Add(report.wb, report.ots, report.cts);
+  }
+
+  if (mReport) {
+    // collect the record for the daily report log file
+    agg.mRecords += record;
+    agg.mRecords += "\n";
+  }
+
+  if (mReportNamespace) {
+    // add the record into the report namespace file
+    char path[4096];
+    snprintf(path, sizeof(path) - 1, "%s/%s", gOFS->IoReportStorePath.c_str(),
+             report.path.c_str());
+    eos::common::Path cPath(path);
+
+    if (cPath.MakeParentPath(S_IRWXU)) {
+      FILE* freport = fopen(path, "a+");
+
+      if (freport) {
+        fprintf(freport, "%s\n", record.c_str());
+        fclose(freport);
       }
+    }
+  }
+}
 
-      delete report;
-      delete newmessage;
+//------------------------------------------------------------------------------
+// Merge the aggregated values into the maps and reset the aggregate
+//------------------------------------------------------------------------------
+void
+Iostat::Merge(IostatAggregate& agg)
+{
+  if (!agg.mNumReports) {
+    return;
+  }
+
+  Mutex.Lock();
+
+  for (const auto& tag : agg.mUid) {
+    auto& uids = IostatUid[tag.first];
+
+    for (const auto& elem : tag.second) {
+      uids[elem.first] += elem.second;
+    }
+  }
+
+  for (const auto& tag : agg.mGid) {
+    auto& gids = IostatGid[tag.first];
+
+    for (const auto& elem : tag.second) {
+      gids[elem.first] += elem.second;
     }
+  }
 
-    XrdSysThread::SetCancelOn();
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    XrdSysThread::CancelPoint();
-    XrdSysThread::SetCancelOff();
+  for (const auto& tag : agg.mAvgUid) {
+    auto& uids = IostatAvgUid[tag.first];
+
+    for (const auto& elem : tag.second) {
+      uids[elem.first].Merge(elem.second);
+    }
   }
 
-  return 0;
+  for (const auto& tag : agg.mAvgGid) {
+    auto& gids = IostatAvgGid[tag.first];
+
+    for (const auto& elem : tag.second) {
+      gids[elem.first].Merge(elem.second);
+    }
+  }
+
+  for (const auto& elem : agg.mDomainIOrb) {
+    IostatAvgDomainIOrb[elem.first].Merge(elem.second);
+  }
+
+  for (const auto& elem : agg.mDomainIOwb) {
+    IostatAvgDomainIOwb[elem.first].Merge(elem.second);
+  }
+
+  for (const auto& elem : agg.mAppIOrb) {
+    IostatAvgAppIOrb[elem.first].Merge(elem.second);
+  }
+
+  for (const auto& elem : agg.mAppIOwb) {
+    IostatAvgAppIOwb[elem.first].Merge(elem.second);
+  }
+
+  Mutex.UnLock();
+
+  if (agg.mRecords.length()) {
+    WriteReports(agg.mRecords);
+  }
+
+  agg.Clear();
 }
 
+//------------------------------------------------------------------------------
+// Append records to the daily report log file
+//------------------------------------------------------------------------------
+void
+Iostat::WriteReports(const std::string& records)
+{
+  time_t now = time(NULL);
+  struct tm nowtm;
+
+  if (!localtime_r(&now, &nowtm)) {
+    return;
+  }
+
+  char logfile[4096];
+  snprintf(logfile, sizeof(logfile) - 1, "%s/%04u/%02u/%04u%02u%02u.eosreport",
+           gOFS->IoReportStorePath.c_str(),
+           1900 + nowtm.tm_year,
+           nowtm.tm_mon + 1,
+           1900 + nowtm.tm_year,
+           nowtm.tm_mon + 1,
+           nowtm.tm_mday);
+  XrdSysMutexHelper lock(mReportMutex);
+
+  if (mOpenReportFile != logfile) {
+    if (gOpenReportFD) {
+      fclose(gOpenReportFD);
+      gOpenReportFD = 0;
+    }
+
+    eos::common::Path cPath(logfile);
+
+    if (cPath.MakeParentPath(S_IRWXU)) {
+      gOpenReportFD = fopen(logfile, "a+");
+    }
+
+    mOpenReportFile = logfile;
+  }
+
+  if (gOpenReportFD) {
+    fwrite(records.c_str(), 1, records.length(), gOpenReportFD);
+    fflush(gOpenReportFD);
+  }
+}
 
 /* ------------------------------------------------------------------------- */
 void
 Iostat::WriteRecord(std::string& record)
 {
-  Mutex.Lock();
+  XrdSysMutexHelper lock(mReportMutex);
 
   if (gOpenReportFD) {
     fprintf(gOpenReportFD, "%s\n", record.c_str());
     fflush(gOpenReportFD);
   }
-
-  Mutex.UnLock();
 }
 
 /* ------------------------------------------------------------------------- */
@@ -1162,11 +1466,30 @@ Iostat::PrintNs(XrdOucString& out, XrdOucString option)
     PopularityMutex.Lock();
     size_t sbin = (IOSTAT_POPULARITY_HISTORY_DAYS + popularitybin - pbin) %
                   IOSTAT_POPULARITY_HISTORY_DAYS;
-    google::sparse_hash_map<std::string, struct Popularity>::const_iterator it;
-    std::vector<popularity_t> popularity_nread(IostatPopularity[sbin].begin(),
-        IostatPopularity[sbin].end());
-    std::vector<popularity_t> popularity_rb(IostatPopularity[sbin].begin(),
-                                            IostatPopularity[sbin].end());
+    std::vector<popularity_t> popularity_nread;
+    std::vector<popularity_t> popularity_rb;
+
+    // merge the top entries of all the directory levels
+    for (size_t level = 0; level < IOSTAT_POPULARITY_LEVELS; ++level) {
+      if (bycount) {
+        for (const auto& entry :
+             IostatPopularity[sbin].mByAccess[level].Top(limit)) {
+          popularity_nread.emplace_back(entry.mKey, Popularity {
+            (unsigned int) entry.mCount, entry.mAux
+          });
+        }
+      }
+
+      if (bybytes) {
+        for (const auto& entry :
+             IostatPopularity[sbin].mByVolume[level].Top(limit)) {
+          popularity_rb.emplace_back(entry.mKey, Popularity {
+            (unsigned int) entry.mAux, entry.mCount
+          });
+        }
+      }
+    }
+
     // sort them (backwards) by rb or nread
     std::sort(popularity_nread.begin(), popularity_nread.end(),
               PopularityCmp_nread());
@@ -1538,8 +1861,7 @@ Iostat::Circulate()
     if (IostatLastPopularityBin != popularitybin) {
       // only if we enter a new bin we erase it
       PopularityMutex.Lock();
-      IostatPopularity[popularitybin].clear();
-      IostatPopularity[popularitybin].resize(10000);
+      IostatPopularity[popularitybin].Clear();
       IostatLastPopularityBin = popularitybin;
       PopularityMutex.UnLock();
     }
@@ -2077,13 +2399,15 @@ Iostat::AddToPopularity(std::string path, unsigned long long rb,
 {
   size_t popularitybin = (((starttime + stoptime) / 2) % (IOSTAT_POPULARITY_DAY *
                           IOSTAT_POPULARITY_HISTORY_DAYS)) / IOSTAT_POPULARITY_DAY;
-  PopularityMutex.Lock();
   eos::common::Path cPath(path.c_str());
+  PopularityMutex.Lock();
+  PopularityBin& bin = IostatPopularity[popularitybin];
 
   for (size_t k = 0; k < cPath.GetSubPathSize(); k++) {
     std::string sp = cPath.GetSubPath(k);
-    IostatPopularity[popularitybin][sp].rb += rb;
-    IostatPopularity[popularitybin][sp].nread++;
+    size_t level = std::min(k, (size_t) IOSTAT_POPULARITY_LEVELS - 1);
+    bin.mByAccess[level].Add(sp, 1, rb);
+    bin.mByVolume[level].Add(sp, rb, 1);
   }
 
   IostatLastPopularityBin = popularitybin;
@@ -2176,6 +2500,17 @@ IostatAvg::StampZero()
   avg60[(bin60 + 1) % 60] = 0;
 }
 
+void
+IostatAvg::Merge(const IostatAvg& other)
+{
+  for (int i = 0; i < 60; i++) {
+    avg86400[i] += other.avg86400[i];
+    avg3600[i] += other.avg3600[i];
+    avg300[i] += other.avg300[i];
+    avg60[i] += other.avg60[i];
+  }
+}
+
 double
 IostatAvg::GetAvg86400()
 {
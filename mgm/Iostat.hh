@@ -27,12 +27,19 @@
 #include "mgm/Namespace.hh"
 #include "mq/XrdMqClient.hh"
 #include "common/Logging.hh"
+#include "common/AssistedThread.hh"
+#include "common/HeavyHitters.hh"
 #include "XrdSys/XrdSysPthread.hh"
 #include <google/sparse_hash_map>
 #include <sys/types.h>
 #include <string>
 #include <set>
+#include <map>
+#include <deque>
+#include <memory>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -46,6 +53,10 @@ EOSMGMNAMESPACE_BEGIN
 // define the history in days we want to do popularity tracking
 #define IOSTAT_POPULARITY_HISTORY_DAYS 7
 #define IOSTAT_POPULARITY_DAY 86400
+// directory levels ranked separately, deeper levels share the last one
+#define IOSTAT_POPULARITY_LEVELS 16
+// maximum number of paths tracked per day, level and ranking
+#define IOSTAT_POPULARITY_CAPACITY 2048
 
 class IostatAvg
 {
@@ -71,6 +82,9 @@ public:
   void
   StampZero();
 
+  void
+  Merge(const IostatAvg& other);
+
   double
   GetAvg86400();
 
@@ -84,6 +98,57 @@ public:
   GetAvg60();
 };
 
+//------------------------------------------------------------------------------
+//! Values collected by a report worker thread during one aggregation interval,
+//! they are merged into the Iostat maps taking the lock only once
+//------------------------------------------------------------------------------
+class IostatAggregate
+{
+public:
+  IostatAggregate() : mNumReports(0) { }
+
+  void
+  Add(const char* tag, uid_t uid, gid_t gid, unsigned long long val,
+      time_t starttime, time_t stoptime)
+  {
+    mUid[tag][uid] += val;
+    mGid[tag][gid] += val;
+    IostatAvg& uid_avg = mAvgUid[tag][uid];
+    IostatAvg& gid_avg = mAvgGid[tag][gid];
+
+    if (val) {
+      uid_avg.Add(val, starttime, stoptime);
+      gid_avg.Add(val, starttime, stoptime);
+    }
+  }
+
+  void
+  Clear()
+  {
+    mUid.clear();
+    mGid.clear();
+    mAvgUid.clear();
+    mAvgGid.clear();
+    mDomainIOrb.clear();
+    mDomainIOwb.clear();
+    mAppIOrb.clear();
+    mAppIOwb.clear();
+    mRecords.clear();
+    mNumReports = 0;
+  }
+
+  std::map<std::string, std::map<uid_t, unsigned long long> > mUid;
+  std::map<std::string, std::map<gid_t, unsigned long long> > mGid;
+  std::map<std::string, std::map<uid_t, IostatAvg> > mAvgUid;
+  std::map<std::string, std::map<gid_t, IostatAvg> > mAvgGid;
+  std::map<std::string, IostatAvg> mDomainIOrb;
+  std::map<std::string, IostatAvg> mDomainIOwb;
+  std::map<std::string, IostatAvg> mAppIOrb;
+  std::map<std::string, IostatAvg> mAppIOwb;
+  std::string mRecords; ///< Report records to be added to the report log
+  size_t mNumReports; ///< Number of reports collected
+};
+
 class Iostat
 {
   // -------------------------------------------------------------
@@ -121,10 +186,38 @@ private:
     unsigned long long rb;
   };
 
+  //----------------------------------------------------------------------------
+  //! Popularity of one day - for each directory level the most read paths by
+  //! number of reads and by volume. The memory used does not depend on the
+  //! number of distinct paths and the counters have a bounded error, see
+  //! eos::common::HeavyHitters.
+  //----------------------------------------------------------------------------
+  struct PopularityBin {
+    PopularityBin()
+    {
+      for (size_t i = 0; i < IOSTAT_POPULARITY_LEVELS; ++i) {
+        mByAccess.emplace_back(IOSTAT_POPULARITY_CAPACITY);
+        mByVolume.emplace_back(IOSTAT_POPULARITY_CAPACITY);
+      }
+    }
+
+    void Clear()
+    {
+      for (size_t i = 0; i < IOSTAT_POPULARITY_LEVELS; ++i) {
+        mByAccess[i].Clear();
+        mByVolume[i].Clear();
+      }
+    }
+
+    //! Ranking by number of reads, the auxiliary counter holds the bytes read
+    std::vector<eos::common::HeavyHitters> mByAccess;
+    //! Ranking by bytes read, the auxiliary counter holds the number of reads
+    std::vector<eos::common::HeavyHitters> mByVolume;
+  };
+
   std::atomic<size_t> IostatLastPopularityBin; // this points to the bin which was last used in IostatPopularity
 
-  google::sparse_hash_map<std::string, struct Popularity>
-    IostatPopularity[ IOSTAT_POPULARITY_HISTORY_DAYS ];
+  PopularityBin IostatPopularity[ IOSTAT_POPULARITY_HISTORY_DAYS ];
 
   typedef std::pair<std::string, struct Popularity> popularity_t;
 
@@ -172,6 +265,23 @@ private:
   XrdOucString
   mStoreFileName; // file name where a dump is loaded/saved in Restore/Store
 
+  // -----------------------------------------------------------
+  // incoming report messages are queued by the receiver thread
+  // and digested by a pool of worker threads
+  // -----------------------------------------------------------
+
+  //! Number of threads digesting the report messages
+  static constexpr unsigned int sNumWorkers = 4;
+  //! Maximum number of report messages waiting to be digested
+  static constexpr size_t sMaxQueued = 100000;
+  std::mutex mQueueMutex; ///< Protects the message queue
+  std::condition_variable mQueueCv; ///< Signals new messages in the queue
+  std::deque<std::string> mQueue; ///< Queue of report message bodies
+  std::vector<std::unique_ptr<AssistedThread>> mWorkers; ///< Worker threads
+  std::atomic<unsigned long long> mDropped; ///< Number of dropped messages
+  XrdSysMutex mReportMutex; ///< Protects the report log file
+  std::string mOpenReportFile; ///< Name of the open report log file
+
 
 public:
   // configuration keys used in config key-val store
@@ -232,6 +342,38 @@ public:
   static void* StaticCirculate(void*);
   void* Receive();
 
+  //----------------------------------------------------------------------------
+  //! Worker thread digesting the queued report messages, the values are
+  //! aggregated locally and merged into the maps once per second
+  //----------------------------------------------------------------------------
+  void ProcessReports(ThreadAssistant& assistant);
+
+  //----------------------------------------------------------------------------
+  //! Digest a report message - either a batch of binary reports or a single
+  //! report env string
+  //----------------------------------------------------------------------------
+  void ProcessMessage(std::string& body, IostatAggregate& agg);
+
+  //----------------------------------------------------------------------------
+  //! Digest one report
+  //!
+  //! @param report report to digest
+  //! @param record report in env format, only used if reports are stored
+  //! @param agg aggregate collecting the values
+  //----------------------------------------------------------------------------
+  void ProcessReport(eos::common::Report& report, const std::string& record,
+                     IostatAggregate& agg);
+
+  //----------------------------------------------------------------------------
+  //! Merge the aggregated values into the maps and reset the aggregate
+  //----------------------------------------------------------------------------
+  void Merge(IostatAggregate& agg);
+
+  //----------------------------------------------------------------------------
+  //! Append records to the daily report log file
+  //----------------------------------------------------------------------------
+  void WriteReports(const std::string& records);
+
   void WriteRecord(std::string &record); // let's the MGM add some record into the stream
 
   static bool NamespaceReport(const char* path, XrdOucString& stdOut,
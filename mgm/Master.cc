@@ -1536,6 +1536,9 @@ Master::Slave2Master()
       FsView::gFsView.mNodeView[it->first]->SetConfigMember("manager",
           FsNode::gManagerId,
           true, it->first, true);
+      FsView::gFsView.mNodeView[it->first]->SetConfigMember("report.batch",
+          FsNode::gManagerId,
+          true, it->first, true);
     }
   }
   // Re-start the recycler thread
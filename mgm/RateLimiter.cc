@@ -0,0 +1,510 @@
+//------------------------------------------------------------------------------
+//! @file RateLimiter.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "mgm/RateLimiter.hh"
+#include "common/StringConversion.hh"
+#include "common/Logging.hh"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+EOSMGMNAMESPACE_BEGIN
+
+const std::string RateLimiter::sRulePrefix = "bucket:";
+
+//------------------------------------------------------------------------------
+// TokenBucket constructor
+//------------------------------------------------------------------------------
+TokenBucket::TokenBucket(double rate, double burst):
+  mRate(rate), mBurst(burst), mAccepted(0), mRejected(0),
+  mIntervalNs((int64_t)(1e9 / rate)),
+  mToleranceNs((int64_t)(1e9 * burst / rate)),
+  mTat(0)
+{}
+
+//------------------------------------------------------------------------------
+// Try to consume one token
+//------------------------------------------------------------------------------
+bool
+TokenBucket::Consume(int64_t now_ns, int64_t& wait_ns)
+{
+  int64_t tat = mTat.load(std::memory_order_relaxed);
+
+  while (true) {
+    int64_t new_tat = std::max(tat, now_ns) + mIntervalNs;
+
+    if (new_tat - now_ns > mToleranceNs) {
+      wait_ns = new_tat - now_ns - mToleranceNs;
+      mRejected.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    if (mTat.compare_exchange_weak(tat, new_tat, std::memory_order_relaxed)) {
+      mAccepted.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Check if one token could be consumed without consuming it
+//------------------------------------------------------------------------------
+bool
+TokenBucket::Check(int64_t now_ns, int64_t& wait_ns) const
+{
+  int64_t tat = mTat.load(std::memory_order_relaxed);
+  int64_t new_tat = std::max(tat, now_ns) + mIntervalNs;
+
+  if (new_tat - now_ns > mToleranceNs) {
+    wait_ns = new_tat - now_ns - mToleranceNs;
+    return false;
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Give back a token taken by a successful Consume
+//------------------------------------------------------------------------------
+void
+TokenBucket::Refund()
+{
+  mTat.fetch_sub(mIntervalNs, std::memory_order_relaxed);
+  mAccepted.fetch_sub(1, std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+// Check if the bucket is full and was not used for the given time
+//------------------------------------------------------------------------------
+bool
+TokenBucket::IsIdle(int64_t now_ns, int64_t idle_ns) const
+{
+  return (mTat.load(std::memory_order_relaxed) + idle_ns < now_ns);
+}
+
+//------------------------------------------------------------------------------
+// Get number of tokens currently available in the bucket
+//------------------------------------------------------------------------------
+double
+TokenBucket::GetTokens(int64_t now_ns) const
+{
+  int64_t used_ns = mTat.load(std::memory_order_relaxed) - now_ns;
+
+  if (used_ns <= 0) {
+    return mBurst;
+  }
+
+  double tokens = (double)(mToleranceNs - used_ns) / mIntervalNs;
+  return (tokens > 0) ? tokens : 0;
+}
+
+//------------------------------------------------------------------------------
+// Get current time in nanoseconds from the monotonic clock
+//------------------------------------------------------------------------------
+int64_t
+TokenBucket::Now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>
+         (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//------------------------------------------------------------------------------
+// Destructor
+//------------------------------------------------------------------------------
+RateLimiter::~RateLimiter()
+{
+  mPruneThread.join();
+}
+
+//------------------------------------------------------------------------------
+// Parse rate limiting rule
+//------------------------------------------------------------------------------
+bool
+RateLimiter::ParseRule(const std::string& key, const std::string& value,
+                       Rule& rule)
+{
+  if (!IsRule(key)) {
+    return false;
+  }
+
+  std::vector<std::string> tokens;
+  eos::common::StringConversion::Tokenize(key.substr(sRulePrefix.length()),
+                                          tokens, ":");
+
+  if (tokens.size() != 3) {
+    return false;
+  }
+
+  if (tokens[0] == "user") {
+    rule.mTarget = Target::USER;
+  } else if (tokens[0] == "group") {
+    rule.mTarget = Target::GROUP;
+  } else if (tokens[0] == "host") {
+    rule.mTarget = Target::HOST;
+  } else {
+    return false;
+  }
+
+  rule.mKey = key;
+  rule.mId = tokens[1];
+  rule.mOp = tokens[2];
+  char* end = nullptr;
+  rule.mRate = strtod(value.c_str(), &end);
+
+  if ((end == value.c_str()) || !std::isfinite(rule.mRate) ||
+      (rule.mRate <= 0)) {
+    return false;
+  }
+
+  rule.mBurst = rule.mRate;
+
+  if (*end == ':') {
+    const char* sburst = end + 1;
+    rule.mBurst = strtod(sburst, &end);
+
+    if ((end == sburst) || !std::isfinite(rule.mBurst) || (rule.mBurst < 1)) {
+      return false;
+    }
+  }
+
+  if (*end != '\0') {
+    return false;
+  }
+
+  // A bucket has to hold at least one token otherwise nothing passes
+  if (rule.mBurst < 1) {
+    rule.mBurst = 1;
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Update the rate limiting rules from the map of stall rules
+//------------------------------------------------------------------------------
+void
+RateLimiter::SetRules(const std::map<std::string, std::string>& stall_rules)
+{
+  std::vector<std::shared_ptr<const Rule>> rules;
+  std::set<std::string> specific;
+
+  for (auto it = stall_rules.lower_bound(sRulePrefix);
+       (it != stall_rules.end()) && IsRule(it->first); ++it) {
+    Rule rule;
+
+    if (!ParseRule(it->first, it->second, rule)) {
+      eos_static_err("msg=\"ignore malformed rate limit rule\" key=%s value=%s",
+                     it->first.c_str(), it->second.c_str());
+      continue;
+    }
+
+    if (rule.mId != "*") {
+      specific.insert(it->first.substr(sRulePrefix.length()));
+    }
+
+    rules.push_back(std::make_shared<const Rule>(rule));
+  }
+
+  eos::common::RWMutexWriteLock wr_lock(mMutex);
+
+  // Drop buckets of rules which were removed or modified
+  for (auto it = mBuckets.begin(); it != mBuckets.end(); /* no increment */) {
+    std::string key = it->first.substr(0, it->first.rfind('|'));
+    auto it_rule = stall_rules.find(key);
+    bool keep = false;
+
+    if (it_rule != stall_rules.end()) {
+      Rule rule;
+
+      if (ParseRule(it_rule->first, it_rule->second, rule)) {
+        keep = ((rule.mRate == it->second->mRate) &&
+                (rule.mBurst == it->second->mBurst));
+      }
+    }
+
+    if (keep) {
+      ++it;
+    } else {
+      it = mBuckets.erase(it);
+    }
+  }
+
+  mRules.swap(rules);
+  mSpecific.swap(specific);
+  mActive = !mRules.empty();
+
+  if (mActive && mIdleTimeout.count()) {
+    std::call_once(mPruneStarted, [this]() {
+      mPruneThread.reset(&RateLimiter::PruneLoop, this);
+    });
+  }
+}
+
+//------------------------------------------------------------------------------
+// Check if operation class matches the request
+//------------------------------------------------------------------------------
+bool
+RateLimiter::MatchOp(const std::string& op, const char* function,
+                     int access_mode)
+{
+  if (op == "*") {
+    return true;
+  }
+
+  if (op == "r") {
+    return ((access_mode == 0) || (access_mode == 2));
+  }
+
+  if (op == "w") {
+    return (access_mode == 1);
+  }
+
+  return (op == function);
+}
+
+//------------------------------------------------------------------------------
+// Get bucket for the given rule and identity, create it if needed
+//------------------------------------------------------------------------------
+std::shared_ptr<TokenBucket>
+RateLimiter::GetBucket(const Rule& rule, const std::string& identity)
+{
+  std::string key = rule.mKey;
+  key += '|';
+  key += identity;
+  {
+    eos::common::RWMutexReadLock rd_lock(mMutex);
+    auto it = mBuckets.find(key);
+
+    if (it != mBuckets.end()) {
+      return it->second;
+    }
+  }
+  eos::common::RWMutexWriteLock wr_lock(mMutex);
+  auto& bucket = mBuckets[key];
+
+  if (!bucket) {
+    bucket = std::make_shared<TokenBucket>(rule.mRate, rule.mBurst);
+  }
+
+  return bucket;
+}
+
+//------------------------------------------------------------------------------
+// Consume one token from all the buckets matching the given request
+//------------------------------------------------------------------------------
+bool
+RateLimiter::Allow(const char* function, int access_mode,
+                   const eos::common::Mapping::VirtualIdentity& vid,
+                   int& stalltime, std::string& rule_key)
+{
+  if (!mActive) {
+    return true;
+  }
+
+  // Collect the matching rules while holding the lock and then consume the
+  // tokens without any lock held
+  std::vector<std::pair<std::shared_ptr<const Rule>, std::string>> matches;
+  {
+    eos::common::RWMutexReadLock rd_lock(mMutex);
+
+    for (const auto& rule : mRules) {
+      if (!MatchOp(rule->mOp, function, access_mode)) {
+        continue;
+      }
+
+      const std::string* name {nullptr};
+      std::string target;
+
+      if (rule->mTarget == Target::USER) {
+        name = &vid.uid_string;
+        target = "user:";
+      } else if (rule->mTarget == Target::GROUP) {
+        name = &vid.gid_string;
+        target = "group:";
+      } else {
+        name = &vid.host;
+        target = "host:";
+      }
+
+      if (rule->mId == "*") {
+        // Skip the wildcard rule if there is a dedicated one for this identity
+        if (mSpecific.count(target + *name + ":" + rule->mOp)) {
+          continue;
+        }
+      } else if (rule->mId != *name) {
+        continue;
+      }
+
+      matches.emplace_back(rule, *name);
+    }
+  }
+
+  if (matches.empty()) {
+    return true;
+  }
+
+  // Check all the buckets first so that a request rejected by one of them
+  // does not use up the tokens of the others
+  int64_t now = TokenBucket::Now();
+  std::vector<std::shared_ptr<TokenBucket>> buckets;
+  buckets.reserve(matches.size());
+  size_t reject = matches.size();
+  int64_t wait_ns = 0;
+
+  for (size_t i = 0; i < matches.size(); ++i) {
+    buckets.push_back(GetBucket(*matches[i].first, matches[i].second));
+    int64_t bucket_wait_ns = 0;
+
+    if (!buckets.back()->Check(now, bucket_wait_ns) &&
+        (bucket_wait_ns > wait_ns)) {
+      wait_ns = bucket_wait_ns;
+      reject = i;
+    }
+  }
+
+  if (reject < matches.size()) {
+    buckets[reject]->mRejected.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    // A concurrent request can still take the last token between the check
+    // and the consume, in this case give back the tokens already taken
+    for (size_t i = 0; i < buckets.size(); ++i) {
+      if (!buckets[i]->Consume(now, wait_ns)) {
+        for (size_t j = 0; j < i; ++j) {
+          buckets[j]->Refund();
+        }
+
+        reject = i;
+        break;
+      }
+    }
+  }
+
+  if (reject == matches.size()) {
+    return true;
+  }
+
+  // Round up to the next second, the stall granularity of the protocol
+  stalltime = (int)((wait_ns + 999999999) / 1000000000);
+
+  if (stalltime < 1) {
+    stalltime = 1;
+  }
+
+  rule_key = matches[reject].first->mKey;
+  return false;
+}
+
+//------------------------------------------------------------------------------
+// Print the state of all the buckets
+//------------------------------------------------------------------------------
+void
+RateLimiter::Print(std::string& out, bool monitoring)
+{
+  eos::common::RWMutexReadLock rd_lock(mMutex);
+  int64_t now = TokenBucket::Now();
+  char line[1024];
+  int cnt = 0;
+
+  for (const auto& elem : mBuckets) {
+    const auto& bucket = elem.second;
+    size_t pos = elem.first.rfind('|');
+    std::string rule = elem.first.substr(0, pos);
+    std::string identity = elem.first.substr(pos + 1);
+    ++cnt;
+
+    if (monitoring) {
+      snprintf(line, sizeof(line), "bucket.rule=%s bucket.id=%s "
+               "bucket.rate=%.02f bucket.burst=%.02f bucket.tokens=%.02f "
+               "bucket.accepted=%llu bucket.rejected=%llu\n",
+               rule.c_str(), identity.c_str(), bucket->mRate, bucket->mBurst,
+               bucket->GetTokens(now),
+               (unsigned long long) bucket->mAccepted.load(),
+               (unsigned long long) bucket->mRejected.load());
+    } else {
+      snprintf(line, sizeof(line), "[ %02d ] %32s %16s rate=%.02f burst=%.02f "
+               "tokens=%.02f accepted=%llu rejected=%llu\n", cnt, rule.c_str(),
+               identity.c_str(), bucket->mRate, bucket->mBurst,
+               bucket->GetTokens(now),
+               (unsigned long long) bucket->mAccepted.load(),
+               (unsigned long long) bucket->mRejected.load());
+    }
+
+    out += line;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Drop the buckets which are full and were not used for the idle timeout
+//------------------------------------------------------------------------------
+size_t
+RateLimiter::PruneIdle(int64_t now_ns)
+{
+  int64_t idle_ns = std::chrono::duration_cast<std::chrono::nanoseconds>
+                    (mIdleTimeout).count();
+  size_t num_pruned = 0;
+  eos::common::RWMutexWriteLock wr_lock(mMutex);
+
+  for (auto it = mBuckets.begin(); it != mBuckets.end(); /* no increment */) {
+    if (it->second->IsIdle(now_ns, idle_ns)) {
+      it = mBuckets.erase(it);
+      ++num_pruned;
+    } else {
+      ++it;
+    }
+  }
+
+  return num_pruned;
+}
+
+//------------------------------------------------------------------------------
+// Get number of buckets
+//------------------------------------------------------------------------------
+size_t
+RateLimiter::GetNumBuckets()
+{
+  eos::common::RWMutexReadLock rd_lock(mMutex);
+  return mBuckets.size();
+}
+
+//------------------------------------------------------------------------------
+// Loop periodically dropping the idle buckets
+//------------------------------------------------------------------------------
+void
+RateLimiter::PruneLoop(ThreadAssistant& assistant) noexcept
+{
+  while (!assistant.terminationRequested()) {
+    assistant.wait_for(mIdleTimeout);
+
+    if (assistant.terminationRequested()) {
+      break;
+    }
+
+    size_t num_pruned = PruneIdle(TokenBucket::Now());
+
+    if (num_pruned) {
+      eos_static_debug("msg=\"dropped idle rate limit buckets\" count=%zu",
+                       num_pruned);
+    }
+  }
+}
+
+EOSMGMNAMESPACE_END
@@ -0,0 +1,276 @@
+//------------------------------------------------------------------------------
+//! @file RateLimiter.hh
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#pragma once
+#include "mgm/Namespace.hh"
+#include "common/RWMutex.hh"
+#include "common/Mapping.hh"
+#include "common/AssistedThread.hh"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+EOSMGMNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Class TokenBucket - lock-free token bucket implemented as a generic cell
+//! rate algorithm (GCRA). The whole bucket state is a single atomic
+//! "theoretical arrival time" which is advanced with a CAS loop, therefore
+//! concurrent consumers never block each other.
+//------------------------------------------------------------------------------
+class TokenBucket
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param rate number of tokens refilled per second
+  //! @param burst maximum number of tokens which can be consumed at once
+  //----------------------------------------------------------------------------
+  TokenBucket(double rate, double burst);
+
+  //----------------------------------------------------------------------------
+  //! Try to consume one token
+  //!
+  //! @param now_ns current time in nanoseconds (monotonic clock)
+  //! @param wait_ns time in nanoseconds until the next token is available,
+  //!        only set if the token could not be consumed
+  //!
+  //! @return true if token consumed, otherwise false
+  //----------------------------------------------------------------------------
+  bool Consume(int64_t now_ns, int64_t& wait_ns);
+
+  //----------------------------------------------------------------------------
+  //! Check if one token could be consumed without consuming it and without
+  //! touching the counters
+  //!
+  //! @param now_ns current time in nanoseconds (monotonic clock)
+  //! @param wait_ns time in nanoseconds until the next token is available,
+  //!        only set if no token is available
+  //!
+  //! @return true if a token is available, otherwise false
+  //----------------------------------------------------------------------------
+  bool Check(int64_t now_ns, int64_t& wait_ns) const;
+
+  //----------------------------------------------------------------------------
+  //! Give back a token taken by a successful Consume
+  //----------------------------------------------------------------------------
+  void Refund();
+
+  //----------------------------------------------------------------------------
+  //! Check if the bucket is full and was not used for the given time
+  //!
+  //! @param now_ns current time in nanoseconds (monotonic clock)
+  //! @param idle_ns idle time in nanoseconds
+  //----------------------------------------------------------------------------
+  bool IsIdle(int64_t now_ns, int64_t idle_ns) const;
+
+  //----------------------------------------------------------------------------
+  //! Get number of tokens currently available in the bucket
+  //!
+  //! @param now_ns current time in nanoseconds (monotonic clock)
+  //----------------------------------------------------------------------------
+  double GetTokens(int64_t now_ns) const;
+
+  //----------------------------------------------------------------------------
+  //! Get current time in nanoseconds from the monotonic clock
+  //----------------------------------------------------------------------------
+  static int64_t Now();
+
+  const double mRate; ///< Refill rate in Hz
+  const double mBurst; ///< Bucket size
+  std::atomic<uint64_t> mAccepted; ///< Number of accepted requests
+  std::atomic<uint64_t> mRejected; ///< Number of rejected requests
+
+private:
+  const int64_t mIntervalNs; ///< Time needed to refill one token
+  const int64_t mToleranceNs; ///< Time needed to refill the full bucket
+  std::atomic<int64_t> mTat; ///< Theoretical arrival time of next request
+};
+
+//------------------------------------------------------------------------------
+//! Class RateLimiter - applies token bucket rate limits per user, group or
+//! client host and operation class. The rules are defined via the access
+//! interface and are stored together with the stall rules using keys of the
+//! form:
+//!
+//!   bucket:{user,group,host}:{name,*}:{op} => <rate>[:<burst>]
+//!
+//! where {op} is either '*' (all operations), 'r' (read operations), 'w'
+//! (write operations) or the name of the MGM function e.g. 'stat', 'open'.
+//! A wildcard rule gives every user/group/host its own bucket while a rule
+//! naming an identity overrides the wildcard rule for the same operation.
+//------------------------------------------------------------------------------
+class RateLimiter
+{
+public:
+  //! Prefix of rate limiting rules in the stall rules map
+  static const std::string sRulePrefix;
+
+  //! Identity type a rule applies to
+  enum class Target {
+    USER,
+    GROUP,
+    HOST
+  };
+
+  //! Parsed rate limiting rule
+  struct Rule {
+    std::string mKey; ///< Original rule key
+    Target mTarget; ///< Identity type
+    std::string mId; ///< Identity name or '*'
+    std::string mOp; ///< Operation class
+    double mRate; ///< Refill rate in Hz
+    double mBurst; ///< Bucket size
+  };
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param idle_timeout buckets which are full and were not used for this
+  //!        time are dropped by the pruning thread
+  //----------------------------------------------------------------------------
+  RateLimiter(std::chrono::seconds idle_timeout = std::chrono::seconds(300)):
+    mIdleTimeout(idle_timeout)
+  {}
+
+  //----------------------------------------------------------------------------
+  //! Destructor
+  //----------------------------------------------------------------------------
+  ~RateLimiter();
+
+  //----------------------------------------------------------------------------
+  //! Check if key represents a rate limiting rule
+  //----------------------------------------------------------------------------
+  static inline bool IsRule(const std::string& key)
+  {
+    return (key.find(sRulePrefix) == 0);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Parse rate limiting rule
+  //!
+  //! @param key rule key bucket:{user,group,host}:{name,*}:{op}
+  //! @param value rule value <rate>[:<burst>], if burst is missing it
+  //!        defaults to the rate i.e. one second worth of requests
+  //! @param rule parsed rule
+  //!
+  //! @return true if successful, otherwise false
+  //----------------------------------------------------------------------------
+  static bool ParseRule(const std::string& key, const std::string& value,
+                        Rule& rule);
+
+  //----------------------------------------------------------------------------
+  //! Update the rate limiting rules from the map of stall rules. Buckets
+  //! belonging to rules which did not change keep their state and counters.
+  //!
+  //! @param stall_rules map of stall rules from the Access class
+  //----------------------------------------------------------------------------
+  void SetRules(const std::map<std::string, std::string>& stall_rules);
+
+  //----------------------------------------------------------------------------
+  //! Check if there is any rate limiting rule defined
+  //----------------------------------------------------------------------------
+  inline bool IsActive() const
+  {
+    return mActive;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Consume one token from all the buckets matching the given request. The
+  //! tokens are only consumed if every matching bucket has one available,
+  //! a rejected request is accounted once in the bucket which rejected it.
+  //!
+  //! @param function name of the MGM function
+  //! @param access_mode access mode as defined in mgm/Macros.hh
+  //! @param vid client virtual identity
+  //! @param stalltime suggested stall time in seconds if request rejected
+  //! @param rule_key key of the rule which rejected the request
+  //!
+  //! @return true if request is allowed, otherwise false
+  //----------------------------------------------------------------------------
+  bool Allow(const char* function, int access_mode,
+             const eos::common::Mapping::VirtualIdentity& vid,
+             int& stalltime, std::string& rule_key);
+
+  //----------------------------------------------------------------------------
+  //! Print the state of all the buckets
+  //!
+  //! @param out output string
+  //! @param monitoring if true use monitoring format
+  //----------------------------------------------------------------------------
+  void Print(std::string& out, bool monitoring);
+
+  //----------------------------------------------------------------------------
+  //! Drop the buckets which are full and were not used for the idle timeout,
+  //! they are recreated with the same state on their next use
+  //!
+  //! @param now_ns current time in nanoseconds (monotonic clock)
+  //!
+  //! @return number of buckets dropped
+  //----------------------------------------------------------------------------
+  size_t PruneIdle(int64_t now_ns);
+
+  //----------------------------------------------------------------------------
+  //! Get number of buckets
+  //----------------------------------------------------------------------------
+  size_t GetNumBuckets();
+
+private:
+  //----------------------------------------------------------------------------
+  //! Check if operation class matches the request
+  //----------------------------------------------------------------------------
+  static bool MatchOp(const std::string& op, const char* function,
+                      int access_mode);
+
+  //----------------------------------------------------------------------------
+  //! Get bucket for the given rule and identity, create it if needed
+  //----------------------------------------------------------------------------
+  std::shared_ptr<TokenBucket> GetBucket(const Rule& rule,
+                                         const std::string& identity);
+
+  //----------------------------------------------------------------------------
+  //! Loop periodically dropping the idle buckets
+  //!
+  //! @param assistant thread executing the method
+  //----------------------------------------------------------------------------
+  void PruneLoop(ThreadAssistant& assistant) noexcept;
+
+  std::atomic<bool> mActive {false}; ///< Mark if there are any rules
+  const std::chrono::seconds mIdleTimeout; ///< Idle time of dropped buckets
+  eos::common::RWMutex mMutex; ///< Protects the rules and the bucket map
+  std::vector<std::shared_ptr<const Rule>> mRules; ///< Active rules
+  //! Keys of rules naming an identity i.e. <target>:<id>:<op>
+  std::set<std::string> mSpecific;
+  //! Map of buckets indexed by <rule_key>|<identity>, idle ones are pruned
+  std::map<std::string, std::shared_ptr<TokenBucket>> mBuckets;
+  //! Thread pruning the idle buckets, started with the first rules
+  AssistedThread mPruneThread;
+  std::once_flag mPruneStarted; ///< Mark if the pruning thread was started
+};
+
+EOSMGMNAMESPACE_END
@@ -29,12 +29,345 @@
 #include "mq/XrdMqSharedObject.hh"
 #include "mgm/Quota.hh"
 #include "XrdOuc/XrdOucString.hh"
+#include <thread>
 
 EOSMGMNAMESPACE_BEGIN
 
+//! Number of execution time samples kept per tag for the average
+static constexpr unsigned long long sExecWindow = 100;
+
+//------------------------------------------------------------------------------
+// Exec accumulator constructor
+//------------------------------------------------------------------------------
+StatShard::Exec::Exec()
+{
+  for (int i = 0; i < eos::common::LatencyHistogram::sNumBins; ++i) {
+    mHist[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Table constructor
+//------------------------------------------------------------------------------
+StatShard::Table::Table()
+{
+  for (int i = 0; i < sMaxTags; ++i) {
+    mExec[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Table destructor
+//------------------------------------------------------------------------------
+StatShard::Table::~Table()
+{
+  for (int i = 0; i < sMaxTags; ++i) {
+    delete mExec[i].load();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Reset all the counters and free the slots
+//------------------------------------------------------------------------------
+void
+StatShard::Table::Reset()
+{
+  for (size_t i = 0; i < sNumSlots; ++i) {
+    mSlots[i].mKey.store(0, std::memory_order_relaxed);
+    mSlots[i].mVal.store(0, std::memory_order_relaxed);
+  }
+
+  for (int i = 0; i < sMaxTags; ++i) {
+    Exec* exec = mExec[i].load(std::memory_order_relaxed);
+
+    if (exec && exec->mN.load(std::memory_order_relaxed)) {
+      exec->mN.store(0, std::memory_order_relaxed);
+      exec->mSum.store(0, std::memory_order_relaxed);
+      exec->mSum2.store(0, std::memory_order_relaxed);
+
+      for (int k = 0; k < eos::common::LatencyHistogram::sNumBins; ++k) {
+        exec->mHist[k].store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Add value to the counter identified by key in the given table
+//------------------------------------------------------------------------------
+bool
+StatShard::Add(Table& table, uint64_t key, uint64_t val)
+{
+  size_t pos = (key * 0x9E3779B97F4A7C15ull) >> 53; // 11 bits = sNumSlots
+
+  for (size_t i = 0; i < sMaxProbe; ++i) {
+    Slot& slot = table.mSlots[(pos + i) & (sNumSlots - 1)];
+    uint64_t skey = slot.mKey.load(std::memory_order_relaxed);
+
+    if (skey == 0) {
+      slot.mKey.store(key, std::memory_order_relaxed);
+    } else if (skey != key) {
+      continue;
+    }
+
+    // The owner is the only writer of the active table
+    slot.mVal.store(slot.mVal.load(std::memory_order_relaxed) + val,
+                    std::memory_order_relaxed);
+    return true;
+  }
+
+  return false;
+}
+
+//------------------------------------------------------------------------------
+// Add value to the uid and gid counters of a tag - owner thread only
+//------------------------------------------------------------------------------
+void
+StatShard::Add(int tag_id, uid_t uid, gid_t gid, uint64_t val, bool& uid_ok,
+               bool& gid_ok)
+{
+  // Announce the write before picking the table, pairs with Retire
+  mWriting.store(true, std::memory_order_seq_cst);
+  Table& table = mTables[mActive.load(std::memory_order_seq_cst)];
+  uid_ok = Add(table, MakeKey(tag_id, false, uid), val);
+  gid_ok = Add(table, MakeKey(tag_id, true, gid), val);
+  mWriting.store(false, std::memory_order_release);
+}
+
+//------------------------------------------------------------------------------
+// Add execution time sample for tag - owner thread only
+//------------------------------------------------------------------------------
+void
+StatShard::AddExec(int tag_id, uint64_t exec_us)
+{
+  mWriting.store(true, std::memory_order_seq_cst);
+  Table& table = mTables[mActive.load(std::memory_order_seq_cst)];
+  Exec* exec = table.mExec[tag_id].load(std::memory_order_relaxed);
+
+  if (exec == nullptr) {
+    exec = new Exec();
+    table.mExec[tag_id].store(exec, std::memory_order_relaxed);
+  }
+
+  exec->mN.store(exec->mN.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+  exec->mSum.store(exec->mSum.load(std::memory_order_relaxed) + exec_us,
+                   std::memory_order_relaxed);
+  // Squares of long execution times overflow 64 bit integers
+  exec->mSum2.store(exec->mSum2.load(std::memory_order_relaxed) +
+                    (double) exec_us * exec_us, std::memory_order_relaxed);
+  std::atomic<uint32_t>& bin =
+    exec->mHist[eos::common::LatencyHistogram::BucketIndex(exec_us)];
+  bin.store(bin.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  mWriting.store(false, std::memory_order_release);
+}
+
+//------------------------------------------------------------------------------
+// Switch the owner to the other table and wait until it left the retired one
+//------------------------------------------------------------------------------
+StatShard::Table&
+StatShard::Retire()
+{
+  int retired = mActive.load(std::memory_order_relaxed);
+  mActive.store(1 - retired, std::memory_order_seq_cst);
+
+  // Once the owner is seen outside of an add, all its later adds go to the
+  // new active table
+  while (mWriting.load(std::memory_order_seq_cst)) {
+    std::this_thread::yield();
+  }
+
+  return mTables[retired];
+}
+
+//------------------------------------------------------------------------------
+// Get a shard for the calling thread
+//------------------------------------------------------------------------------
+StatShard*
+StatShardPool::Acquire()
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (!mFree.empty()) {
+    StatShard* shard = mFree.back();
+    mFree.pop_back();
+    return shard;
+  }
+
+  mShards.emplace_back(new StatShard());
+  return mShards.back().get();
+}
+
+//------------------------------------------------------------------------------
+// Return a shard to the pool
+//------------------------------------------------------------------------------
+void
+StatShardPool::Release(StatShard* shard)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  mFree.push_back(shard);
+}
+
+namespace
+{
+//------------------------------------------------------------------------------
+//! Process wide registry of statistics tags
+//------------------------------------------------------------------------------
+struct TagRegistry {
+  std::mutex mMutex;
+  std::map<std::string, int> mIds;
+  std::string mNames[StatShard::sMaxTags];
+};
+
+TagRegistry&
+GetTagRegistry()
+{
+  static TagRegistry registry;
+  return registry;
+}
+
+//------------------------------------------------------------------------------
+//! Per-thread cache of tag string pointers to tag ids. The content of the
+//! string is always compared since tags are not necessarily literals.
+//------------------------------------------------------------------------------
+struct TagCache {
+  static constexpr size_t sSize = 256;
+  const char* mPtr[sSize] = {nullptr};
+  int mId[sSize] = {0};
+};
+
+thread_local TagCache tlTagCache;
+
+//------------------------------------------------------------------------------
+//! Per-thread list of shards acquired from the different pools, they are
+//! given back to the pools when the thread exits.
+//------------------------------------------------------------------------------
+struct ThreadShards {
+  std::vector<std::pair<std::shared_ptr<StatShardPool>, StatShard*>> mShards;
+
+  ~ThreadShards()
+  {
+    for (auto& elem : mShards) {
+      elem.first->Release(elem.second);
+    }
+  }
+};
+
+thread_local ThreadShards tlShards;
+}
+
+//------------------------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------------------------
+Stat::Stat():
+  mShardPool(std::make_shared<StatShardPool>())
+{}
+
+//------------------------------------------------------------------------------
+// Get the id of a tag, registering it if needed
+//------------------------------------------------------------------------------
+int
+Stat::GetTagId(const char* tag)
+{
+  size_t pos = (((uintptr_t) tag) >> 3) % TagCache::sSize;
+
+  if ((tlTagCache.mPtr[pos] == tag) &&
+      (GetTagName(tlTagCache.mId[pos]) == tag)) {
+    return tlTagCache.mId[pos];
+  }
+
+  TagRegistry& registry = GetTagRegistry();
+  int id = -1;
+  {
+    std::lock_guard<std::mutex> lock(registry.mMutex);
+    auto it = registry.mIds.find(tag);
+
+    if (it != registry.mIds.end()) {
+      id = it->second;
+    } else if (registry.mIds.size() < (size_t) StatShard::sMaxTags) {
+      id = (int) registry.mIds.size();
+      registry.mNames[id] = tag;
+      registry.mIds[tag] = id;
+    }
+  }
+
+  if (id >= 0) {
+    tlTagCache.mPtr[pos] = tag;
+    tlTagCache.mId[pos] = id;
+  }
+
+  return id;
+}
+
+//------------------------------------------------------------------------------
+// Get the name of a registered tag id
+//------------------------------------------------------------------------------
+const std::string&
+Stat::GetTagName(int tag_id)
+{
+  return GetTagRegistry().mNames[tag_id];
+}
+
+//------------------------------------------------------------------------------
+// Get the shard of the calling thread
+//------------------------------------------------------------------------------
+StatShard*
+Stat::GetShard()
+{
+  for (auto& elem : tlShards.mShards) {
+    if (elem.first == mShardPool) {
+      return elem.second;
+    }
+  }
+
+  StatShard* shard = mShardPool->Acquire();
+  tlShards.mShards.emplace_back(mShardPool, shard);
+  return shard;
+}
+
 /*----------------------------------------------------------------------------*/
 void
 Stat::Add(const char* tag, uid_t uid, gid_t gid, unsigned long val)
+{
+  Add(GetTagId(tag), tag, uid, gid, val);
+}
+
+/*----------------------------------------------------------------------------*/
+void
+Stat::Add(int tag_id, const char* tag, uid_t uid, gid_t gid,
+          unsigned long val)
+{
+  if ((tag_id < 0) || (val == 0)) {
+    // zero values are used to make a tag appear in the output
+    AddLocked(tag, uid, gid, val);
+    return;
+  }
+
+  bool uid_ok = true;
+  bool gid_ok = true;
+  GetShard()->Add(tag_id, uid, gid, val, uid_ok, gid_ok);
+
+  if (!uid_ok || !gid_ok) {
+    // shard is full - account the value the slow way
+    Mutex.Lock();
+
+    if (!uid_ok) {
+      StatsUid[tag][uid] += val;
+      StatAvgUid[tag][uid].Add(val);
+    }
+
+    if (!gid_ok) {
+      StatsGid[tag][gid] += val;
+      StatAvgGid[tag][gid].Add(val);
+    }
+
+    Mutex.UnLock();
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+void
+Stat::AddLocked(const char* tag, uid_t uid, gid_t gid, unsigned long val)
 {
   Mutex.Lock();
   StatsUid[tag][uid] += val;
@@ -58,18 +391,124 @@ Stat::AddExt(const char* tag, uid_t uid, gid_t gid, unsigned long nsample,
 /*----------------------------------------------------------------------------*/
 void
 Stat::AddExec(const char* tag, float exectime)
+{
+  AddExec(GetTagId(tag), tag, exectime);
+}
+
+/*----------------------------------------------------------------------------*/
+void
+Stat::AddExec(int tag_id, const char* tag, float exectime)
+{
+  uint64_t exec_us = (exectime > 0) ? (uint64_t)(exectime * 1000.0) : 0;
+
+  if (tag_id < 0) {
+    eos::common::LatencyHistogram hist;
+    hist.Add(exec_us);
+    AddExecLocked(tag, StatExecBin {1, exectime, (double) exectime * exectime},
+                  hist);
+    return;
+  }
+
+  GetShard()->AddExec(tag_id, exec_us);
+}
+
+/*----------------------------------------------------------------------------*/
+void
+Stat::AddExecLocked(const char* tag, const StatExecBin& bin,
+                    const eos::common::LatencyHistogram& hist)
 {
   Mutex.Lock();
-  StatExec[tag].push_back(exectime);
+  StatLatency[tag].Add(hist);
+  std::deque<StatExecBin>& bins = StatExec[tag];
+  bins.push_back(bin);
+  unsigned long long n = 0;
+
+  for (auto it = bins.begin(); it != bins.end(); ++it) {
+    n += it->n;
+  }
 
-  // we average over 100 entries
-  if (StatExec[tag].size() > 100) {
-    StatExec[tag].pop_front();
+  // we average over (at least) the last 100 entries
+  while ((bins.size() > 1) && (n - bins.front().n >= sExecWindow)) {
+    n -= bins.front().n;
+    bins.pop_front();
   }
 
   Mutex.UnLock();
 }
 
+//------------------------------------------------------------------------------
+// Drain all the per-thread shards into the maps
+//------------------------------------------------------------------------------
+void
+Stat::Aggregate()
+{
+  std::vector<std::pair<uint64_t, uint64_t>> counters;
+  std::map<int, std::pair<StatExecBin, eos::common::LatencyHistogram>> execs;
+  mShardPool->ForEach([&](StatShard * shard) {
+    StatShard::Table& table = shard->Retire();
+
+    for (size_t i = 0; i < StatShard::sNumSlots; ++i) {
+      uint64_t key = table.mSlots[i].mKey.load(std::memory_order_relaxed);
+      uint64_t val = table.mSlots[i].mVal.load(std::memory_order_relaxed);
+
+      if (key && val) {
+        counters.emplace_back(key, val);
+      }
+    }
+
+    for (int i = 0; i < StatShard::sMaxTags; ++i) {
+      StatShard::Exec* exec = table.mExec[i].load(std::memory_order_relaxed);
+
+      if (exec) {
+        uint64_t n = exec->mN.load(std::memory_order_relaxed);
+
+        if (n) {
+          auto& elem = execs[i];
+          StatExecBin& bin = elem.first;
+          bin.n += n;
+          bin.sum += exec->mSum.load(std::memory_order_relaxed) / 1000.0;
+          bin.sum2 += exec->mSum2.load(std::memory_order_relaxed) / 1000000.0;
+
+          for (int k = 0; k < eos::common::LatencyHistogram::sNumBins; ++k) {
+            uint32_t cnt = exec->mHist[k].load(std::memory_order_relaxed);
+
+            if (cnt) {
+              elem.second.AddBin(k, cnt);
+            }
+          }
+        }
+      }
+    }
+
+    // Free the slots so that keys which are no longer used don't fill them
+    table.Reset();
+  });
+
+  if (counters.size()) {
+    Mutex.Lock();
+
+    for (const auto& elem : counters) {
+      const std::string& tag = GetTagName((int)(elem.first >> 33) - 1);
+      uint32_t id = (uint32_t) elem.first;
+
+      if (elem.first & (1ull << 32)) {
+        StatsGid[tag][id] += elem.second;
+        StatAvgGid[tag][id].Add(elem.second);
+      } else {
+        StatsUid[tag][id] += elem.second;
+        StatAvgUid[tag][id].Add(elem.second);
+      }
+    }
+
+    Mutex.UnLock();
+  }
+
+  for (const auto& elem : execs) {
+    AddExecLocked(GetTagName(elem.first).c_str(), elem.second.first,
+                  elem.second.second);
+  }
+}
+
 /*----------------------------------------------------------------------------*/
 unsigned long long
 Stat::GetTotal(const char* tag)
@@ -542,13 +981,15 @@ Stat::GetExec(const char* tag, double& deviation)
   deviation = 0;
 
   if (StatExec.count(tag)) {
-    std::deque<float>::const_iterator it;
+    std::deque<StatExecBin>::const_iterator it;
     double sum = 0;
-    int cnt = 0;
+    double sum2 = 0;
+    unsigned long long cnt = 0;
 
     for (it = StatExec[tag].begin(); it != StatExec[tag].end(); ++it) {
-      cnt++;
-      sum += *it;
+      cnt += it->n;
+      sum += it->sum;
+      sum2 += it->sum2;
     }
 
     if (!cnt) {
@@ -556,12 +997,8 @@ Stat::GetExec(const char* tag, double& deviation)
     }
 
     avg = sum / cnt;
-
-    for (it = StatExec[tag].begin(); it != StatExec[tag].end(); ++it) {
-      deviation += pow((*it - avg), 2);
-    }
-
-    deviation = sqrt(deviation / cnt);
+    deviation = sum2 / cnt - avg * avg;
+    deviation = (deviation > 0) ? sqrt(deviation) : 0;
   }
 
   return avg;
@@ -574,44 +1011,52 @@ double
 Stat::GetTotalExec(double& deviation)
 {
   // calculates average execution time for all commands
-  google::sparse_hash_map<std::string, std::deque<float> >::const_iterator ittag;
+  google::sparse_hash_map<std::string, std::deque<StatExecBin> >::const_iterator
+  ittag;
   double sum = 0;
+  double sum2 = 0;
   double avg = 0;
   deviation = 0;
-  int cnt = 0;
+  unsigned long long cnt = 0;
 
   for (ittag = StatExec.begin(); ittag != StatExec.end(); ittag++) {
-    std::deque<float>::const_iterator it;
+    std::deque<StatExecBin>::const_iterator it;
 
     for (it = ittag->second.begin(); it != ittag->second.end(); it++) {
-      cnt++;
-      sum += *it;
+      cnt += it->n;
+      sum += it->sum;
+      sum2 += it->sum2;
     }
   }
 
   if (cnt) {
     avg = sum / cnt;
+    deviation = sum2 / cnt - avg * avg;
+    deviation = (deviation > 0) ? sqrt(deviation) : 0;
   }
 
-  for (ittag = StatExec.begin(); ittag != StatExec.end(); ittag++) {
-    std::deque<float>::const_iterator it;
+  return avg;
+}
 
-    for (it = ittag->second.begin(); it != ittag->second.end(); it++) {
-      deviation += pow((*it - avg), 2);
+//------------------------------------------------------------------------------
+// Drain all the per-thread shards discarding their values
+//------------------------------------------------------------------------------
+void
+Stat::ClearShards()
+{
+  mShardPool->ForEach([](StatShard * shard) {
+    // Retiring twice resets the active and the retired table
+    for (int i = 0; i < 2; ++i) {
+      shard->Retire().Reset();
     }
-  }
-
-  if (cnt) {
-    deviation = sqrt(deviation / cnt);
-  }
-
-  return avg;
+  });
 }
 
 /*----------------------------------------------------------------------------*/
 void
 Stat::Clear()
 {
+  ClearShards();
   Mutex.Lock();
   google::sparse_hash_map<std::string, google::sparse_hash_map<uid_t, unsigned long long> >::iterator
   ittag;
@@ -625,7 +1070,11 @@ Stat::Clear()
     StatAvgUid[ittag->first].resize(1000);
     StatAvgGid[ittag->first].clear();
     StatAvgGid[ittag->first].resize(1000);
-    StatExec[ittag->first].resize(1000);
+    StatExec[ittag->first].clear();
+  }
+
+  for (auto& elem : StatLatency) {
+    elem.second.Clear();
   }
 
   Mutex.UnLock();
@@ -828,6 +1277,7 @@ Stat::PrintOutTotal(XrdOucString& out, bool details, bool monitoring,
   }
 
   out += table_all.GenerateTable(HEADER).c_str();
+  PrintOutLatency(out, details, monitoring);
 
   if (details) {
     google::sparse_hash_map<std::string, google::sparse_hash_map<uid_t, StatAvg > >::iterator
@@ -1157,6 +1607,94 @@ Stat::PrintOutTotal(XrdOucString& out, bool details, bool monitoring,
   Mutex.UnLock();
 }
 
+//------------------------------------------------------------------------------
+// Print the latency percentiles table - without details only the 1min window
+// is displayed, in monitoring format all the windows are always displayed.
+// warning: you have to lock the mutex if directly used
+//------------------------------------------------------------------------------
+void
+Stat::PrintOutLatency(XrdOucString& out, bool details, bool monitoring)
+{
+  using eos::common::LatencyHistogram;
+  using eos::common::LatencyWindows;
+  std::string format_s = !monitoring ? "s" : "os";
+  std::string format_ss = !monitoring ? "-s" : "os";
+  std::string format_l = !monitoring ? "+l" : "ol";
+  std::string format_f = !monitoring ? "f" : "of";
+  TableFormatterBase table_lat;
+
+  if (!monitoring) {
+    table_lat.SetHeader({
+      std::make_tuple("latency", 24, format_ss),
+      std::make_tuple("window", 6, format_s),
+      std::make_tuple("samples", 8, format_l),
+      std::make_tuple("p50(ms)", 8, format_f),
+      std::make_tuple("p90(ms)", 8, format_f),
+      std::make_tuple("p99(ms)", 8, format_f),
+      std::make_tuple("p999(ms)", 8, format_f)
+    });
+  } else {
+    table_lat.SetHeader({
+      std::make_tuple("uid", 0, format_ss),
+      std::make_tuple("gid", 0, format_s),
+      std::make_tuple("lat.cmd", 0, format_s),
+      std::make_tuple("lat.window", 0, format_s),
+      std::make_tuple("lat.n", 0, format_l),
+      std::make_tuple("lat.p50", 0, format_f),
+      std::make_tuple("lat.p90", 0, format_f),
+      std::make_tuple("lat.p99", 0, format_f),
+      std::make_tuple("lat.p999", 0, format_f)
+    });
+  }
+
+  time_t now = time(0);
+  bool all_windows = (details || monitoring);
+  bool empty = true;
+
+  for (auto it = StatLatency.begin(); it != StatLatency.end(); ++it) {
+    for (int w = 0; w < LatencyWindows::kNumWindows; ++w) {
+      if (!all_windows && (w != LatencyWindows::k60s)) {
+        continue;
+      }
+
+      LatencyHistogram hist = it->second.Get(w, now);
+
+      if (!hist.Count()) {
+        continue;
+      }
+
+      TableData table_data;
+      table_data.emplace_back();
+
+      if (monitoring) {
+        table_data.back().push_back(TableCell("all", format_ss));
+        table_data.back().push_back(TableCell("all", format_s));
+        table_data.back().push_back(TableCell(it->first, format_s));
+      } else {
+        table_data.back().push_back(TableCell(it->first, format_ss));
+      }
+
+      table_data.back().push_back(TableCell(LatencyWindows::GetName(w), format_s));
+      table_data.back().push_back(TableCell((unsigned long long) hist.Count(),
+                                            format_l));
+      table_data.back().push_back(TableCell(hist.Percentile(0.5) / 1000.0,
+                                            format_f));
+      table_data.back().push_back(TableCell(hist.Percentile(0.9) / 1000.0,
+                                            format_f));
+      table_data.back().push_back(TableCell(hist.Percentile(0.99) / 1000.0,
+                                            format_f));
+      table_data.back().push_back(TableCell(hist.Percentile(0.999) / 1000.0,
+                                            format_f));
+      table_lat.AddRows(table_data);
+      empty = false;
+    }
+  }
+
+  if (!empty) {
+    out += table_lat.GenerateTable(HEADER).c_str();
+  }
+}
+
 /*----------------------------------------------------------------------------*/
 void
 Stat::Circulate()
@@ -1238,6 +1776,8 @@ Stat::Circulate()
     l2 = l2tmp;
     l3 = l3tmp;
     // --------------------------------------------
+    // collect the per-thread counter shards
+    Aggregate();
     Mutex.Lock();
     google::sparse_hash_map<std::string, google::sparse_hash_map<uid_t, StatAvg> >::iterator
     tit;
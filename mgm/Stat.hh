@@ -26,6 +26,7 @@
 
 /*----------------------------------------------------------------------------*/
 #include "mgm/Namespace.hh"
+#include "common/LatencyHistogram.hh"
 /*----------------------------------------------------------------------------*/
 #include "XrdOuc/XrdOucString.hh"
 /*----------------------------------------------------------------------------*/
@@ -35,6 +36,9 @@
 #include <map>
 #include <string>
 #include <deque>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <math.h>
 
 EOSMGMNAMESPACE_BEGIN
@@ -444,6 +448,144 @@ public:
 };
 
 
+//------------------------------------------------------------------------------
+//! Execution time moments collected during one Circulate interval
+//------------------------------------------------------------------------------
+struct StatExecBin {
+  unsigned long long n; ///< Number of samples
+  double sum; ///< Sum of execution times in ms
+  double sum2; ///< Sum of squared execution times in ms^2
+};
+
+//------------------------------------------------------------------------------
+//! Per-thread shard of statistics counters. The shard holds two tables of
+//! counters: the owning thread adds to the active one while the
+//! Stat::Circulate thread retires it, drains it and resets its slots for
+//! reuse. The hot path never takes a lock nor touches shared cache lines and
+//! the slots are recycled at every aggregation.
+//------------------------------------------------------------------------------
+class StatShard
+{
+public:
+  //! Maximum number of distinct tags which can be registered
+  static constexpr int sMaxTags = 1024;
+  //! Number of (tag, uid/gid) counter slots per table
+  static constexpr size_t sNumSlots = 2048;
+  //! Maximum probe length before falling back to the locked path
+  static constexpr size_t sMaxProbe = 32;
+
+  //! Counter slot
+  struct Slot {
+    std::atomic<uint64_t> mKey {0};
+    std::atomic<uint64_t> mVal {0};
+  };
+
+  //! Execution time accumulator of one tag, times are in microseconds
+  struct Exec {
+    std::atomic<uint64_t> mN {0};
+    std::atomic<uint64_t> mSum {0};
+    std::atomic<double> mSum2 {0};
+    //! Latency histogram bins, see eos::common::LatencyHistogram
+    std::atomic<uint32_t> mHist[eos::common::LatencyHistogram::sNumBins];
+
+    Exec();
+  };
+
+  //! Table of counters - only written by the owning thread while active and
+  //! only read by the aggregator once retired
+  struct Table {
+    Slot mSlots[sNumSlots]; ///< Open addressing table of counters
+    std::atomic<Exec*> mExec[sMaxTags]; ///< Lazily allocated exec accumulators
+
+    Table();
+    ~Table();
+
+    //--------------------------------------------------------------------------
+    //! Reset all the counters and free the slots
+    //--------------------------------------------------------------------------
+    void Reset();
+  };
+
+  //----------------------------------------------------------------------------
+  //! Build slot key for a tag id and uid/gid
+  //----------------------------------------------------------------------------
+  static inline uint64_t MakeKey(int tag_id, bool is_gid, uint32_t id)
+  {
+    return (((uint64_t)(tag_id + 1)) << 33) | (((uint64_t) is_gid) << 32) | id;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Add value to the uid and gid counters of a tag - owner thread only
+  //!
+  //! @param uid_ok set to false if the uid counter has no free slot left
+  //! @param gid_ok set to false if the gid counter has no free slot left
+  //----------------------------------------------------------------------------
+  void Add(int tag_id, uid_t uid, gid_t gid, uint64_t val, bool& uid_ok,
+           bool& gid_ok);
+
+  //----------------------------------------------------------------------------
+  //! Add execution time sample for tag - owner thread only
+  //----------------------------------------------------------------------------
+  void AddExec(int tag_id, uint64_t exec_us);
+
+  //----------------------------------------------------------------------------
+  //! Switch the owner to the other table and wait until it stopped writing
+  //! to the retired one - aggregator only, the shard pool serializes callers
+  //!
+  //! @return retired table, it has to be reset before the next retirement
+  //----------------------------------------------------------------------------
+  Table& Retire();
+
+private:
+  //----------------------------------------------------------------------------
+  //! Add value to the counter identified by key in the given table
+  //!
+  //! @return true if successful, false if the table has no free slot left
+  //----------------------------------------------------------------------------
+  static bool Add(Table& table, uint64_t key, uint64_t val);
+
+  Table mTables[2]; ///< Active and retired table
+  std::atomic<int> mActive {0}; ///< Index of the table the owner adds to
+  std::atomic<bool> mWriting {false}; ///< Owner is adding to a table
+};
+
+//------------------------------------------------------------------------------
+//! Pool of statistics shards - a shard is handed out to each thread adding
+//! statistics and returned to the pool when the thread exits so that the
+//! number of shards is bounded by the peak number of threads.
+//------------------------------------------------------------------------------
+class StatShardPool
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Get a shard for the calling thread
+  //----------------------------------------------------------------------------
+  StatShard* Acquire();
+
+  //----------------------------------------------------------------------------
+  //! Return a shard to the pool, pending values are drained later on
+  //----------------------------------------------------------------------------
+  void Release(StatShard* shard);
+
+  //----------------------------------------------------------------------------
+  //! Apply function to all the shards
+  //----------------------------------------------------------------------------
+  template<typename Func>
+  void ForEach(Func func)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (auto& shard : mShards) {
+      func(shard.get());
+    }
+  }
+
+private:
+  std::mutex mMutex; ///< Protects the shard lists
+  std::vector<std::unique_ptr<StatShard>> mShards; ///< All shards
+  std::vector<StatShard*> mFree; ///< Shards not owned by any thread
+};
+
 #define EXEC_TIMING_BEGIN(__ID__)               \
   struct timeval start__ID__;                   \
   struct timeval stop__ID__;                    \
@@ -452,7 +594,17 @@ public:
 
 #define EXEC_TIMING_END(__ID__)                                         \
   gettimeofday(&stop__ID__, &tz__ID__);                                 \
-  gOFS->MgmStats.AddExec(__ID__, ((stop__ID__.tv_sec-start__ID__.tv_sec)*1000.0) + ((stop__ID__.tv_usec-start__ID__.tv_usec)/1000.0) );
+  {                                                                     \
+    static const int tag_id__ID__ = eos::mgm::Stat::GetTagId(__ID__);   \
+    gOFS->MgmStats.AddExec(tag_id__ID__, __ID__, ((stop__ID__.tv_sec-start__ID__.tv_sec)*1000.0) + ((stop__ID__.tv_usec-start__ID__.tv_usec)/1000.0) ); \
+  }
+
+// add to the counter of a literal tag - the tag id is resolved once per call site
+#define MGM_STATS_ADD(__TAG__, __UID__, __GID__, __VAL__)               \
+  do {                                                                  \
+    static const int tag_id = eos::mgm::Stat::GetTagId(__TAG__);       \
+    gOFS->MgmStats.Add(tag_id, __TAG__, __UID__, __GID__, __VAL__);     \
+  } while (0)
 
 class Stat
 {
@@ -466,13 +618,39 @@ public:
   google::sparse_hash_map<std::string, google::sparse_hash_map<gid_t, StatAvg> > StatAvgGid;
   google::sparse_hash_map<std::string, google::sparse_hash_map<uid_t, StatExt> > StatExtUid;
   google::sparse_hash_map<std::string, google::sparse_hash_map<gid_t, StatExt> > StatExtGid;
-  google::sparse_hash_map<std::string, std::deque<float> > StatExec;
-
+  google::sparse_hash_map<std::string, std::deque<StatExecBin> > StatExec;
+  // latency histograms per tag over the 5s, 1min, 5min and 1h windows
+  std::map<std::string, eos::common::LatencyWindows> StatLatency;
+
+  Stat ();
+
+  //----------------------------------------------------------------------------
+  //! Get the id of a tag, registering it if needed. Ids are process wide and
+  //! lookups of the same tag string are served from a per-thread cache.
+  //!
+  //! @return tag id or -1 if the tag registry is full
+  //----------------------------------------------------------------------------
+  static int GetTagId (const char* tag);
+
+  //----------------------------------------------------------------------------
+  //! Get the name of a registered tag id
+  //----------------------------------------------------------------------------
+  static const std::string& GetTagName (int tag_id);
+
+  // the counters are collected in per-thread shards and become visible in
+  // the maps above once aggregated by Circulate
   void Add (const char* tag, uid_t uid, gid_t gid, unsigned long val);
+  // add using a tag id from GetTagId, the tag is used if the id is invalid
+  void Add (int tag_id, const char* tag, uid_t uid, gid_t gid, unsigned long val);
 
   void AddExt (const char* tag, uid_t uid, gid_t gid, unsigned long nsample, const double &avgv, const double &minv, const double &maxv);
 
   void AddExec (const char* tag, float exectime);
+  // add using a tag id from GetTagId, the tag is used if the id is invalid
+  void AddExec (int tag_id, const char* tag, float exectime);
+
+  // drain all the per-thread shards into the maps - called by Circulate
+  void Aggregate ();
 
   unsigned long long GetTotal (const char* tag);
 
@@ -515,6 +693,26 @@ public:
   void PrintOutTotal (XrdOucString &out, bool details = false, bool monitoring = false, bool numerical = false);
 
   void Circulate ();
+
+private:
+  // add counter directly to the maps - used for new entries and as fallback
+  void AddLocked (const char* tag, uid_t uid, gid_t gid, unsigned long val);
+
+  // add execution time bin and latency histogram directly to the maps
+  void AddExecLocked (const char* tag, const StatExecBin& bin,
+                      const eos::common::LatencyHistogram& hist);
+
+  // print the latency percentiles table
+  // warning: you have to lock the mutex if directly used
+  void PrintOutLatency (XrdOucString &out, bool details, bool monitoring);
+
+  // get the shard of the calling thread
+  StatShard* GetShard ();
+
+  // drain all the per-thread shards discarding their values
+  void ClearShards ();
+
+  std::shared_ptr<StatShardPool> mShardPool; ///< Per-thread counter shards
 };
 
 EOSMGMNAMESPACE_END
@@ -0,0 +1,124 @@
+//------------------------------------------------------------------------------
+//! @file TimerWheel.hh
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#pragma once
+#include "mgm/Namespace.hh"
+#include <ctime>
+#include <set>
+#include <vector>
+
+EOSMGMNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Class TimerWheel - hashed timer wheel with a resolution of one second.
+//! Keys are kept in the slot of their deadline modulo the number of slots,
+//! so scheduling is O(1) and advancing the wheel only visits the slots of the
+//! elapsed seconds. The wheel does not own the deadlines: keys scheduled more
+//! than one turn ahead, rescheduled or removed meanwhile are handed out when
+//! their slot is visited and the owner has to check and reschedule them.
+//! The class is not thread-safe.
+//------------------------------------------------------------------------------
+template<typename Key>
+class TimerWheel
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param nslots number of one second slots, rounded up to a power of two
+  //----------------------------------------------------------------------------
+  TimerWheel(size_t nslots = 4096) : mMask(0), mLast(0), mSize(0)
+  {
+    size_t n = 1;
+
+    while (n < nslots) {
+      n <<= 1;
+    }
+
+    mSlots.resize(n);
+    mMask = n - 1;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Schedule a key - a deadline which already passed is due with the next
+  //! advance of the wheel
+  //----------------------------------------------------------------------------
+  void Insert(const Key& key, time_t deadline)
+  {
+    if (mLast && (deadline <= mLast)) {
+      deadline = mLast + 1;
+    }
+
+    if (mSlots[deadline & mMask].insert(key).second) {
+      mSize++;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Advance the wheel to now and collect the keys of all elapsed slots
+  //!
+  //! @param now current time
+  //! @param due filled with the keys which might have expired
+  //----------------------------------------------------------------------------
+  void Advance(time_t now, std::vector<Key>& due)
+  {
+    if (!mLast) {
+      // the first advance visits everything scheduled so far
+      mLast = now - mSlots.size();
+    }
+
+    if (now <= mLast) {
+      return;
+    }
+
+    time_t first = mLast + 1;
+
+    if ((now - mLast) > (time_t) mSlots.size()) {
+      first = now - mSlots.size() + 1;
+    }
+
+    for (time_t t = first; t <= now; ++t) {
+      std::set<Key>& slot = mSlots[t & mMask];
+      due.insert(due.end(), slot.begin(), slot.end());
+      mSize -= slot.size();
+      slot.clear();
+    }
+
+    mLast = now;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get number of scheduled keys
+  //----------------------------------------------------------------------------
+  size_t Size() const
+  {
+    return mSize;
+  }
+
+private:
+  std::vector<std::set<Key>> mSlots; ///< Keys by deadline modulo slots
+  size_t mMask; ///< Number of slots - 1
+  time_t mLast; ///< Last second visited by Advance
+  size_t mSize; ///< Number of scheduled keys
+};
+
+EOSMGMNAMESPACE_END
@@ -48,7 +48,7 @@ XrdMgmOfs::attr_ls(const char* inpath,
   BOUNCE_ILLEGAL_NAMES;
   XrdOucEnv access_Env(ininfo);
   AUTHORIZE(client, &access_Env, AOP_Stat, "access", inpath, error);
-  gOFS->MgmStats.Add("IdMap", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("IdMap", vid.uid, vid.gid, 1);
   BOUNCE_NOT_ALLOWED;
   return _attr_ls(path, error, vid, ininfo, map);
 }
@@ -65,7 +65,7 @@ XrdMgmOfs::_attr_ls(const char* path, XrdOucErrInfo& error,
   static const char* epname = "attr_ls";
   std::shared_ptr<eos::IContainerMD> dh;
   EXEC_TIMING_BEGIN("AttrLs");
-  gOFS->MgmStats.Add("AttrLs", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("AttrLs", vid.uid, vid.gid, 1);
   eos::common::RWMutexReadLock ns_rd_lock;
   errno = 0;
 
@@ -156,7 +156,7 @@ XrdMgmOfs::attr_set(const char* inpath, XrdOucErrInfo& error,
   BOUNCE_ILLEGAL_NAMES;
   XrdOucEnv access_Env(ininfo);
   AUTHORIZE(client, &access_Env, AOP_Update, "update", inpath, error);
-  gOFS->MgmStats.Add("IdMap", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("IdMap", vid.uid, vid.gid, 1);
   BOUNCE_NOT_ALLOWED;
   return _attr_set(path, error, vid, ininfo, key, value);
 }
@@ -172,7 +172,7 @@ XrdMgmOfs::_attr_set(const char* path, XrdOucErrInfo& error,
 {
   static const char* epname = "attr_set";
   EXEC_TIMING_BEGIN("AttrSet");
-  gOFS->MgmStats.Add("AttrSet", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("AttrSet", vid.uid, vid.gid, 1);
   errno = 0;
 
   if (!key || !value) {
@@ -304,7 +304,7 @@ XrdMgmOfs::attr_get(const char* inpath, XrdOucErrInfo& error,
   BOUNCE_ILLEGAL_NAMES;
   XrdOucEnv access_Env(ininfo);
   AUTHORIZE(client, &access_Env, AOP_Stat, "access", inpath, error);
-  gOFS->MgmStats.Add("IdMap", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("IdMap", vid.uid, vid.gid, 1);
   BOUNCE_NOT_ALLOWED;
   return _attr_get(path, error, vid, ininfo, key, value);
 }
@@ -321,7 +321,7 @@ XrdMgmOfs::_attr_get(const char* path, XrdOucErrInfo& error,
   static const char* epname = "attr_get";
   std::shared_ptr<eos::IContainerMD> dh;
   EXEC_TIMING_BEGIN("AttrGet");
-  gOFS->MgmStats.Add("AttrGet", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("AttrGet", vid.uid, vid.gid, 1);
   errno = 0;
 
   if (!key) {
@@ -492,7 +492,7 @@ XrdMgmOfs::_attr_get(uint64_t cid, std::string key, std::string& rvalue)
   std::shared_ptr<eos::IFileMD> fmd;
   errno = 0;
   EXEC_TIMING_BEGIN("AttrGet");
-  gOFS->MgmStats.Add("AttrGet", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("AttrGet", vid.uid, vid.gid, 1);
 
   if (!key.length()) {
     return false;
@@ -573,7 +573,7 @@ XrdMgmOfs::attr_rem(const char* inpath, XrdOucErrInfo& error,
   BOUNCE_ILLEGAL_NAMES;
   XrdOucEnv access_Env(ininfo);
   AUTHORIZE(client, &access_Env, AOP_Delete, "delete", inpath, error);
-  gOFS->MgmStats.Add("IdMap", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("IdMap", vid.uid, vid.gid, 1);
   BOUNCE_NOT_ALLOWED;
   return _attr_rem(path, error, vid, ininfo, key);
 }
@@ -592,7 +592,7 @@ XrdMgmOfs::_attr_rem(const char* path, XrdOucErrInfo& error,
   std::shared_ptr<eos::IFileMD> fmd;
   errno = 0;
   EXEC_TIMING_BEGIN("AttrRm");
-  gOFS->MgmStats.Add("AttrRm", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("AttrRm", vid.uid, vid.gid, 1);
 
   if (!key) {
     return Emsg(epname, error, EINVAL, "delete attribute", path);
@@ -59,7 +59,7 @@ XrdMgmOfs::exists(const char* inpath,
   BOUNCE_ILLEGAL_NAMES;
   XrdOucEnv exists_Env(ininfo);
   AUTHORIZE(client, &exists_Env, AOP_Stat, "execute exists", inpath, error);
-  gOFS->MgmStats.Add("IdMap", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("IdMap", vid.uid, vid.gid, 1);
   BOUNCE_NOT_ALLOWED;
   ACCESSMODE_R;
   MAYSTALL;
@@ -97,7 +97,7 @@ XrdMgmOfs::_exists(const char* path,
 {
   // try if that is directory
   EXEC_TIMING_BEGIN("Exists");
-  gOFS->MgmStats.Add("Exists", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("Exists", vid.uid, vid.gid, 1);
   std::shared_ptr<eos::IContainerMD> cmd;
   {
     // -------------------------------------------------------------------------
@@ -183,7 +183,7 @@ XrdMgmOfs::_exists(const char* path,
 
         rcode = SFS_REDIRECT;
         error.setErrInfo(ecode, redirectionhost.c_str());
-        gOFS->MgmStats.Add("RedirectENOENT", vid.uid, vid.gid, 1);
+        MGM_STATS_ADD("RedirectENOENT", vid.uid, vid.gid, 1);
         return rcode;
       }
     }
@@ -219,7 +219,7 @@ XrdMgmOfs::_exists(const char* path,
 /*----------------------------------------------------------------------------*/
 {
   EXEC_TIMING_BEGIN("Exists");
-  gOFS->MgmStats.Add("Exists", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("Exists", vid.uid, vid.gid, 1);
   std::shared_ptr<eos::IContainerMD> cmd;
   // try if that is directory
   {
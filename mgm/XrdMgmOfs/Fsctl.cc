@@ -151,6 +151,7 @@ XrdMgmOfs::FSctl(const int cmd,
   }
 
   bool fusexset = false;
+  bool fusexbatch = false;
 
   // check if this is a protocol buffer injection
   if ((cmd == SFS_FSCTL_PLUGIN) && (args.Arg2Len > 5)) {
@@ -159,6 +160,9 @@ XrdMgmOfs::FSctl(const int cmd,
 
     if (key == "fusex:") {
       fusexset = true;
+    } else if ((key == "fusexb") && (args.Arg2Len > 6) && (args.Arg2[6] == ':')) {
+      fusexset = true;
+      fusexbatch = true;
     }
   }
 
@@ -244,6 +248,12 @@ XrdMgmOfs::FSctl(const int cmd,
   if (fusexset) {
     eos_static_debug("5 fusexset=%d %s %s", fusexset, args.Arg1, args.Arg2);
     std::string protobuf;
+
+    if (fusexbatch) {
+      protobuf.assign(args.Arg2 + 7, args.Arg2Len - 7);
+#include "fsctl/FusexBatch.cc"
+    }
+
     protobuf.assign(args.Arg2 + 6, args.Arg2Len - 6);
 #include "fsctl/Fusex.cc"
   }
@@ -284,6 +294,11 @@ XrdMgmOfs::FSctl(const int cmd,
 #include "fsctl/Stat.cc"
     }
 
+    // Return eosxd meta data or capabilities as protocol buffer stream
+    if (execmd == "fusexget") {
+#include "fsctl/FusexGet.cc"
+    }
+
     // Make a directory and return it's inode
     if (execmd == "mkdir") {
 #include "fsctl/Mkdir.cc"
@@ -62,22 +62,22 @@ XrdMgmOfs::ShouldRedirect(const char* function, int __AccessMode__,
       if (c1) {
         eos::common::StringConversion::Tokenize(
           Access::gRedirectionRules[std::string("*")], tokens, delimiter);
-        gOFS->MgmStats.Add("Redirect", vid.uid, vid.gid, 1);
+        MGM_STATS_ADD("Redirect", vid.uid, vid.gid, 1);
       } else {
         if (c2) {
           eos::common::StringConversion::Tokenize(
             Access::gRedirectionRules[std::string("w:*")], tokens, delimiter);
-          gOFS->MgmStats.Add("RedirectW", vid.uid, vid.gid, 1);
+          MGM_STATS_ADD("RedirectW", vid.uid, vid.gid, 1);
         } else {
           if (c3) {
             eos::common::StringConversion::Tokenize(
               Access::gRedirectionRules[std::string("r:*")], tokens, delimiter);
-            gOFS->MgmStats.Add("RedirectR", vid.uid, vid.gid, 1);
+            MGM_STATS_ADD("RedirectR", vid.uid, vid.gid, 1);
           } else {
             if (c4) {
               eos::common::StringConversion::Tokenize(
                 Access::gRedirectionRules[std::string("w:*")], tokens, delimiter);
-              gOFS->MgmStats.Add("RedirectR-Master", vid.uid, vid.gid, 1);
+              MGM_STATS_ADD("RedirectR-Master", vid.uid, vid.gid, 1);
             }
           }
         }
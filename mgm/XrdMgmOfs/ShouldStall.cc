@@ -155,6 +155,26 @@ XrdMgmOfs::ShouldStall(const char* function,
         }
       }
 
+      if (!stalltime && Access::gStallBucket) {
+        // Token bucket rate limits per user/group/host and operation
+        std::string rule_key;
+
+        if (!Access::gRateLimiter.Allow(function, __AccessMode__, vid, stalltime,
+                                        rule_key)) {
+          auto it_comment = Access::gStallComment.find(rule_key);
+          smsg = "request rate limit exceeded for ";
+          smsg += rule_key;
+
+          if ((it_comment != Access::gStallComment.end()) &&
+              it_comment->second.length()) {
+            smsg += " - ";
+            smsg += it_comment->second;
+          }
+
+          MGM_STATS_ADD("RateLimit", vid.uid, vid.gid, 1);
+        }
+      }
+
       if (stalltime) {
         stallmsg = "Attention: you are currently hold in this instance and each"
                    " request is stalled for ";
@@ -163,7 +183,7 @@ XrdMgmOfs::ShouldStall(const char* function,
         stallmsg += smsg.c_str();
         eos_static_info("info=\"stalling access to\" uid=%u gid=%u host=%s",
                         vid.uid, vid.gid, vid.host.c_str());
-        gOFS->MgmStats.Add("Stall", vid.uid, vid.gid, 1);
+        MGM_STATS_ADD("Stall", vid.uid, vid.gid, 1);
         return true;
       }
     } else if (Access::gStallRules.size() &&
@@ -179,7 +199,7 @@ XrdMgmOfs::ShouldStall(const char* function,
       stallmsg += " seconds ...";
       eos_static_info("info=\"stalling access to\" uid=%u gid=%u host=%s",
                       vid.uid, vid.gid, vid.host.c_str());
-      gOFS->MgmStats.Add("Stall", vid.uid, vid.gid, 1);
+      MGM_STATS_ADD("Stall", vid.uid, vid.gid, 1);
       return true;
     }
   }
@@ -80,7 +80,7 @@ XrdMgmOfs::stat(const char* inpath,
   EXEC_TIMING_BEGIN("IdMap");
   eos::common::Mapping::IdMap(client, ininfo, tident, vid, false);
   EXEC_TIMING_END("IdMap");
-  gOFS->MgmStats.Add("IdMap", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("IdMap", vid.uid, vid.gid, 1);
   BOUNCE_NOT_ALLOWED;
   ACCESSMODE_R;
   MAYSTALL;
@@ -140,7 +140,7 @@ XrdMgmOfs::_stat(const char* path,
 {
   static const char* epname = "_stat";
   EXEC_TIMING_BEGIN("Stat");
-  gOFS->MgmStats.Add("Stat", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("Stat", vid.uid, vid.gid, 1);
   // ---------------------------------------------------------------------------
   // try if that is a file
   errno = 0;
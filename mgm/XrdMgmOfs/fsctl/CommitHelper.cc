@@ -26,6 +26,7 @@
 #include "mgm/FsView.hh"
 #include "mgm/Stat.hh"
 #include "common/http/OwnCloud.hh"
+#include "common/Constants.hh"
 #include "common/LayoutId.hh"
 #include "namespace/interface/IQuota.hh"
 #include "namespace/interface/IView.hh"
@@ -475,6 +476,12 @@ CommitHelper::handle_location(eos::common::Mapping::VirtualIdentity_t& vid,
 
   fmd->addLocation(fsid);
 
+  // A replica committed by an FST ends the inline-only state of a file
+  // created by eosxd
+  if (fmd->hasAttribute(eos::common::INLINE_ONLY_ATTR_NAME)) {
+    fmd->removeAttribute(eos::common::INLINE_ONLY_ATTR_NAME);
+  }
+
   // If fsid is in the deletion list, we try to remove it if there
   // is something in the deletion list
   if (fmd->getNumUnlinkedLocation()) {
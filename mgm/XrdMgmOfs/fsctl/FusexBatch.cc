@@ -0,0 +1,97 @@
+// ----------------------------------------------------------------------
+// File: FusexBatch.cc
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+
+// -----------------------------------------------------------------------
+// This file is included source code in XrdMgmOfs.cc to make the code more
+// transparent without slowing down the compilation time.
+// -----------------------------------------------------------------------
+
+{
+  ACCESSMODE_W;
+  MAYSTALL;
+  MAYREDIRECT;
+
+  // receive a batch of md records e.g. sibling creations and apply them to
+  // the namespace one after the other - every record gets its own ack
+
+  std::string id = std::string("Fusex::sync:") + vid.tident.c_str();
+
+  eos::fusex::md_batch batch;
+
+  if (!batch.ParseFromString(protobuf))
+  {
+    return Emsg(epname, error, EINVAL, "parse protocol buffer", "");
+  }
+
+  gOFS->MgmStats.Add("Eosxd::ext::0-HANDLE", vid.uid, vid.gid,
+                     batch.md__size());
+
+  eos_static_debug("protobuf-len=%d batch-size=%d", protobuf.length(),
+                   batch.md__size());
+
+  eos::fusex::response resp;
+  resp.set_type(resp.ACKS);
+
+  for (int i = 0; i < batch.md__size(); ++i)
+  {
+    std::string resultstream = "";
+    eos::fusex::ack* ack = resp.add_acks_();
+    int rc = gOFS->zMQ->gFuseServer.HandleMD(id, batch.md_(i), &resultstream,
+             0, &vid);
+
+    if (rc) {
+      ack->set_code(ack->PERMANENT_FAILURE);
+      ack->set_err_no(rc);
+      ack->set_err_msg("handle request");
+      continue;
+    }
+
+    eos::fusex::response entry;
+
+    if (!resultstream.length() || !entry.ParseFromString(resultstream)) {
+      ack->set_code(ack->PERMANENT_FAILURE);
+      ack->set_err_no(EINVAL);
+      ack->set_err_msg("illegal request - no response");
+      continue;
+    }
+
+    if (entry.type() == entry.ACK) {
+      *ack = entry.ack_();
+    } else {
+      // nothing to acknowledge
+      ack->set_code(ack->OK);
+    }
+  }
+
+  std::string resultstream;
+  resp.SerializeToString(&resultstream);
+
+  std::string b64response;
+  eos::common::SymKey::Base64(resultstream, b64response);
+
+  std::string response = "Fusex:";
+  response += b64response;
+
+  error.setErrInfo(response.length(), response.c_str());
+  return SFS_DATA;
+}
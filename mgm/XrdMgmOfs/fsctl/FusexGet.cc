@@ -0,0 +1,71 @@
+// ----------------------------------------------------------------------
+// File: FusexGet.cc
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+
+// -----------------------------------------------------------------------
+// This file is included source code in XrdMgmOfs.cc to make the code more
+// transparent without slowing down the compilation time.
+// -----------------------------------------------------------------------
+
+{
+  ACCESSMODE_R;
+  MAYSTALL;
+  MAYREDIRECT;
+
+  // Metadata GET of eosxd in a single query round trip - the opaque info is
+  // the same as for an open of /proc/user/?mgm.cmd=fuseX and the result
+  // stream is returned as query response instead of being read from a file
+  gOFS->MgmStats.Add("Eosxd::ext::0-QUERY", vid.uid, vid.gid, 1);
+  const char* proc_cmd = env.Get("mgm.cmd");
+
+  if (!proc_cmd || strcmp(proc_cmd, "fuseX")) {
+    return Emsg(epname, error, EINVAL, "illegal request - not a fuseX command",
+                "");
+  }
+
+  ProcCommand pc;
+
+  if (pc.open("/proc/user/", ininfo, vid, &error)) {
+    return SFS_ERROR;
+  }
+
+  struct stat buf;
+  pc.stat(&buf);
+
+  if (!buf.st_size) {
+    return Emsg(epname, error, EINVAL, "illegal request - no response", "");
+  }
+
+  // Ownership of the result is taken by xrd_buff and error then takes
+  // ownership of the xrd_buff object.
+  char* result = static_cast<char*>(malloc(buf.st_size));
+
+  if (!result) {
+    return Emsg(epname, error, ENOMEM, "allocate response buffer", "");
+  }
+
+  size_t nread = pc.read(0, result, buf.st_size);
+  pc.close();
+  XrdOucBuffer* xrd_buff = new XrdOucBuffer(result, nread);
+  error.setErrInfo(xrd_buff->BuffSize(), xrd_buff);
+  return SFS_DATA;
+}
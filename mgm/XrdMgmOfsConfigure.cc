@@ -2100,6 +2100,7 @@ XrdMgmOfs::InitStats()
   MgmStats.Add("Exists", 0, 0, 0);
   MgmStats.Add("Eosxd::ext::0-HANDLE", 0, 0, 0);
   MgmStats.Add("Eosxd::ext::0-STREAM", 0, 0, 0);
+  MgmStats.Add("Eosxd::ext::0-QUERY", 0, 0, 0);
   MgmStats.Add("Eosxd::ext::GET", 0, 0, 0);
   MgmStats.Add("Eosxd::ext::SET", 0, 0, 0);
   MgmStats.Add("Eosxd::ext::LS", 0, 0, 0);
@@ -2196,6 +2197,7 @@ XrdMgmOfs::InitStats()
   MgmStats.Add("Recycle", 0, 0, 0);
   MgmStats.Add("ReplicaFailedSize", 0, 0, 0);
   MgmStats.Add("ReplicaFailedChecksum", 0, 0, 0);
+  MgmStats.Add("RateLimit", 0, 0, 0);
   MgmStats.Add("Redirect", 0, 0, 0);
   MgmStats.Add("RedirectR", 0, 0, 0);
   MgmStats.Add("RedirectW", 0, 0, 0);
@@ -97,7 +97,7 @@ XrdMgmOfsDirectory::open(const char* inpath,
   EXEC_TIMING_BEGIN("IdMap");
   eos::common::Mapping::IdMap(client, ininfo, tident, vid);
   EXEC_TIMING_END("IdMap");
-  gOFS->MgmStats.Add("IdMap", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("IdMap", vid.uid, vid.gid, 1);
   BOUNCE_NOT_ALLOWED;
   ACCESSMODE_R;
   MAYSTALL;
@@ -162,7 +162,7 @@ XrdMgmOfsDirectory::_open(const char* dir_path,
   EXEC_TIMING_BEGIN("OpenDir");
   eos::common::Path cPath(dir_path);
   eos_info("name=opendir path=%s", cPath.GetPath());
-  gOFS->MgmStats.Add("OpenDir", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("OpenDir", vid.uid, vid.gid, 1);
   // Open the directory
   bool permok = false;
 
@@ -199,7 +199,7 @@ XrdMgmOfsDirectory::_open(const char* dir_path,
 
     if (permok) {
       // Add all the files and subdirectories
-      gOFS->MgmStats.Add("OpenDir-Entry", vid.uid, vid.gid,
+      MGM_STATS_ADD("OpenDir-Entry", vid.uid, vid.gid,
                          dh->getNumContainers() + dh->getNumFiles());
       // Collect all file names
       for (auto it = eos::FileMapIterator(dh); it.valid(); it.next()) {
@@ -27,6 +27,7 @@
 #include "common/Path.hh"
 #include "common/SecEntity.hh"
 #include "common/StackTrace.hh"
+#include "common/SymKeys.hh"
 #include "common/ZMQ.hh"
 #include "mgm/Access.hh"
 #include "mgm/FileSystem.hh"
@@ -98,7 +99,7 @@ XrdMgmOfsFile::open(const char* inpath,
     eos::common::Mapping::IdMap(client, ininfo, tident, vid);
     EXEC_TIMING_END("IdMap");
   }
-  gOFS->MgmStats.Add("IdMap", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("IdMap", vid.uid, vid.gid, 1);
   SetLogId(logId, vid, tident);
   NAMESPACEMAP;
   BOUNCE_ILLEGAL_NAMES;
@@ -391,7 +392,7 @@ XrdMgmOfsFile::open(const char* inpath,
                   " the requested permissions for that operation (1)", path);
     }
 
-    gOFS->MgmStats.Add("OpenProc", vid.uid, vid.gid, 1);
+    MGM_STATS_ADD("OpenProc", vid.uid, vid.gid, 1);
 
     if (!ProcInterface::Authorize(path, ininfo, vid, client)) {
       return Emsg(epname, error, EPERM, "execute proc command - you don't have "
@@ -423,7 +424,7 @@ XrdMgmOfsFile::open(const char* inpath,
     }
   }
 
-  gOFS->MgmStats.Add("Open", vid.uid, vid.gid, 1);
+  MGM_STATS_ADD("Open", vid.uid, vid.gid, 1);
   eos_debug("authorize start");
 
   if (open_flag & O_CREAT) {
@@ -463,7 +464,7 @@ XrdMgmOfsFile::open(const char* inpath,
       ec = gOFS->_mkdir(cPath.GetParentPath(), Mode, error, vid, ininfo);
 
       if (ec) {
-        gOFS->MgmStats.Add("OpenFailedPermission", vid.uid, vid.gid, 1);
+        MGM_STATS_ADD("OpenFailedPermission", vid.uid, vid.gid, 1);
         return SFS_ERROR;
       }
     }
@@ -578,7 +579,7 @@ XrdMgmOfsFile::open(const char* inpath,
 
           rcode = SFS_REDIRECT;
           error.setErrInfo(ecode, redirectionhost.c_str());
-          gOFS->MgmStats.Add("RedirectENOENT", vid.uid, vid.gid, 1);
+          MGM_STATS_ADD("RedirectENOENT", vid.uid, vid.gid, 1);
           XrdOucString predirectionhost = redirectionhost.c_str();
           eos::common::StringConversion::MaskTag(predirectionhost, "cap.msg");
           eos::common::StringConversion::MaskTag(predirectionhost, "cap.sym");
@@ -591,7 +592,7 @@ XrdMgmOfsFile::open(const char* inpath,
 
       // put back original errno
       errno = save_errno;
-      gOFS->MgmStats.Add("OpenFailedENOENT", vid.uid, vid.gid, 1);
+      MGM_STATS_ADD("OpenFailedENOENT", vid.uid, vid.gid, 1);
       return Emsg(epname, error, errno, "open file", path);
     }
 
@@ -657,7 +658,7 @@ XrdMgmOfsFile::open(const char* inpath,
     if (isRW && !acl.IsMutable() && vid.uid && !vid.sudoer) {
       // immutable directory
       errno = EPERM;
-      gOFS->MgmStats.Add("OpenFailedPermission", vid.uid, vid.gid, 1);
+      MGM_STATS_ADD("OpenFailedPermission", vid.uid, vid.gid, 1);
       return Emsg(epname, error, errno, "open file - directory immutable", path);
     }
 
@@ -666,7 +667,7 @@ XrdMgmOfsFile::open(const char* inpath,
       if (!((vid.uid == DAEMONUID) && (isPioReconstruct))) {
         // we don't apply this permission check for reconstruction jobs issued via the daemon account
         errno = EPERM;
-        gOFS->MgmStats.Add("OpenFailedPermission", vid.uid, vid.gid, 1);
+        MGM_STATS_ADD("OpenFailedPermission", vid.uid, vid.gid, 1);
         return Emsg(epname, error, errno, "open file", path);
       }
     }
@@ -741,7 +742,7 @@ XrdMgmOfsFile::open(const char* inpath,
          (eos::common::LayoutId::GetLayoutType(fmdlid) ==
           eos::common::LayoutId::kRaid6))) {
       // Unpriviledged users are not allowed to open RAIN files for update
-      gOFS->MgmStats.Add("OpenFailedNoUpdate", vid.uid, vid.gid, 1);
+      MGM_STATS_ADD("OpenFailedNoUpdate", vid.uid, vid.gid, 1);
       return Emsg(epname, error, EPERM, "update RAIN layout file - "
                   "you have to be a priviledged user for updates");
     }
@@ -750,7 +751,7 @@ XrdMgmOfsFile::open(const char* inpath,
       // check if this directory is write-once for the mapped user
       if (acl.HasAcl()) {
         if (acl.CanWriteOnce()) {
-          gOFS->MgmStats.Add("OpenFailedNoUpdate", vid.uid, vid.gid, 1);
+          MGM_STATS_ADD("OpenFailedNoUpdate", vid.uid, vid.gid, 1);
           // this is a write once user
           return Emsg(epname, error, EEXIST,
                       "overwrite existing file - you are write-once user");
@@ -790,10 +791,10 @@ XrdMgmOfsFile::open(const char* inpath,
         eos_info("keep attached to existing fmd in chunked upload");
       }
 
-      gOFS->MgmStats.Add("OpenWriteTruncate", vid.uid, vid.gid, 1);
+      MGM_STATS_ADD("OpenWriteTruncate", vid.uid, vid.gid, 1);
     } else {
       if (!(fmd) && ((open_flag & O_CREAT))) {
-        gOFS->MgmStats.Add("OpenWriteCreate", vid.uid, vid.gid, 1);
+        MGM_STATS_ADD("OpenWriteCreate", vid.uid, vid.gid, 1);
       } else {
         if (acl.HasAcl()) {
           if (acl.CanWriteOnce()) {
@@ -808,7 +809,7 @@ XrdMgmOfsFile::open(const char* inpath,
           }
         }
 
-        gOFS->MgmStats.Add("OpenWrite", vid.uid, vid.gid, 1);
+        MGM_STATS_ADD("OpenWrite", vid.uid, vid.gid, 1);
       }
     }
 
@@ -880,7 +881,7 @@ XrdMgmOfsFile::open(const char* inpath,
 
         if (!fmd) {
           // creation failed
-          gOFS->MgmStats.Add("OpenFailedCreate", vid.uid, vid.gid, 1);
+          MGM_STATS_ADD("OpenFailedCreate", vid.uid, vid.gid, 1);
           return Emsg(epname, error, errno, "create file", path);
         }
 
@@ -890,14 +891,14 @@ XrdMgmOfsFile::open(const char* inpath,
     } else {
       // we attached to an existing file
       if (open_flag & O_EXCL) {
-        gOFS->MgmStats.Add("OpenFailedExists", vid.uid, vid.gid, 1);
+        MGM_STATS_ADD("OpenFailedExists", vid.uid, vid.gid, 1);
         return Emsg(epname, error, EEXIST, "create file", path);
       }
 
       if (acl.HasAcl()) {
         if (!acl.CanUpdate()) {
           // the ACL has !u set - we don't allow to do file updates
-          gOFS->MgmStats.Add("OpenFailedNoUpdate", vid.uid, vid.gid, 1);
+          MGM_STATS_ADD("OpenFailedNoUpdate", vid.uid, vid.gid, 1);
           return Emsg(epname, error, EPERM, "update file - fobidden by ACL",
                       path);
         }
@@ -927,19 +928,19 @@ XrdMgmOfsFile::open(const char* inpath,
 
       rcode = SFS_REDIRECT;
       error.setErrInfo(ecode, redirectionhost.c_str());
-      gOFS->MgmStats.Add("RedirectENOENT", vid.uid, vid.gid, 1);
+      MGM_STATS_ADD("RedirectENOENT", vid.uid, vid.gid, 1);
       return rcode;
     }
 
     if ((!fmd)) {
-      gOFS->MgmStats.Add("OpenFailedENOENT", vid.uid, vid.gid, 1);
+      MGM_STATS_ADD("OpenFailedENOENT", vid.uid, vid.gid, 1);
       return Emsg(epname, error, errno, "open file", path);
     }
 
     if (isSharedFile) {
-      gOFS->MgmStats.Add("OpenShared", vid.uid, vid.gid, 1);
+      MGM_STATS_ADD("OpenShared", vid.uid, vid.gid, 1);
     } else {
-      gOFS->MgmStats.Add("OpenRead", vid.uid, vid.gid, 1);
+      MGM_STATS_ADD("OpenRead", vid.uid, vid.gid, 1);
     }
   }
 
@@ -1118,7 +1119,7 @@ XrdMgmOfsFile::open(const char* inpath,
         std::string errmsg = e.getMessage().str();
         eos_debug("msg=\"exception\" ec=%d emsg=\"%s\"\n",
                   e.getErrno(), e.getMessage().str().c_str());
-        gOFS->MgmStats.Add("OpenFailedQuota", vid.uid, vid.gid, 1);
+        MGM_STATS_ADD("OpenFailedQuota", vid.uid, vid.gid, 1);
         return Emsg(epname, error, errno, "open file", errmsg.c_str());
       }
     }
@@ -1130,6 +1131,28 @@ XrdMgmOfsFile::open(const char* inpath,
     return SFS_OK;
   }
 
+  // Files created inline-only by eosxd have no replica until they outgrow
+  // the inline size, the MGM serves their contents from the namespace
+  if (!isFuse && !fmd->getNumLocation() &&
+      fmd->hasAttribute(eos::common::INLINE_ONLY_ATTR_NAME)) {
+    if (isRW) {
+      MGM_STATS_ADD("OpenFailedInlineOnly", vid.uid, vid.gid, 1);
+      return Emsg(epname, error, ENOTSUP, "open - update inline-only file, "
+                  "it can only be updated via eosxd or overwritten", path);
+    }
+
+    int rc = GetInlineContents(fmd->getAttributes(), fmd->getSize(),
+                               mInlineContents);
+
+    if (rc) {
+      return Emsg(epname, error, rc, "open - decode inline-only file", path);
+    }
+
+    MGM_STATS_ADD("OpenReadInlineOnly", vid.uid, vid.gid, 1);
+    isInlineOnlyFile = true;
+    return SFS_OK;
+  }
+
   capability += "&mgm.ruid=";
   capability += (int) vid.uid;
   capability += "&mgm.rgid=";
@@ -1279,7 +1302,7 @@ XrdMgmOfsFile::open(const char* inpath,
 
     if (selectedfs.empty()) {
       // this file has not a single existing replica
-      gOFS->MgmStats.Add("OpenFileOffline", vid.uid, vid.gid, 1);
+      MGM_STATS_ADD("OpenFileOffline", vid.uid, vid.gid, 1);
       return Emsg(epname, error, ENODEV, "open - no disk replica exists", path);
     }
 
@@ -1483,7 +1506,7 @@ XrdMgmOfsFile::open(const char* inpath,
           gOFS->MgmHealMap.erase(fileId);
           gOFS->MgmHealMap.resize(0);
           gOFS->MgmHealMapMutex.UnLock();
-          gOFS->MgmStats.Add("OpenFailedHeal", vid.uid, vid.gid, 1);
+          MGM_STATS_ADD("OpenFailedHeal", vid.uid, vid.gid, 1);
           XrdOucString msg = "heal file with inaccessible replica's after ";
           msg += (int) nmaxheal;
           msg += " tries - giving up";
@@ -1510,7 +1533,7 @@ XrdMgmOfsFile::open(const char* inpath,
             stalltime = atoi(attrmap["sys.stall.unavailable"].c_str());
           }
 
-          gOFS->MgmStats.Add("OpenStalledHeal", vid.uid, vid.gid, 1);
+          MGM_STATS_ADD("OpenStalledHeal", vid.uid, vid.gid, 1);
           eos_info("attr=sys info=\"stalling file\" path=%s rw=%d stalltime=%d nstall=%d",
                    path, isRW, stalltime, nheal);
           return gOFS->Stall(error, stalltime, ""
@@ -1542,7 +1565,7 @@ XrdMgmOfsFile::open(const char* inpath,
           gOFS->MgmHealMap.erase(fileId);
           gOFS->MgmHealMap.resize(0);
           gOFS->MgmHealMapMutex.UnLock();
-          gOFS->MgmStats.Add("OpenFailedHeal", vid.uid, vid.gid, 1);
+          MGM_STATS_ADD("OpenFailedHeal", vid.uid, vid.gid, 1);
           XrdOucString msg = "heal file with inaccesible replica's after ";
           msg += (int) nmaxheal;
           msg += " tries - giving up";
@@ -1569,7 +1592,7 @@ XrdMgmOfsFile::open(const char* inpath,
               stalltime = atoi(attrmap["sys.stall.unavailable"].c_str());
             }
 
-            gOFS->MgmStats.Add("OpenStalledHeal", vid.uid, vid.gid, 1);
+            MGM_STATS_ADD("OpenStalledHeal", vid.uid, vid.gid, 1);
             eos_info("attr=sys info=\"stalling file\" path=%s rw=%d stalltime=%d nstall=%d",
                      path, isRW, stalltime, nheal);
             gOFS->MgmHealMapMutex.UnLock();
@@ -1589,7 +1612,7 @@ XrdMgmOfsFile::open(const char* inpath,
 
         if (stalltime) {
           // stall the client
-          gOFS->MgmStats.Add("OpenStalled", vid.uid, vid.gid, 1);
+          MGM_STATS_ADD("OpenStalled", vid.uid, vid.gid, 1);
           eos_info("attr=sys info=\"stalling file since replica's are down\" path=%s rw=%d",
                    path, isRW);
           return gOFS->Stall(error, stalltime,
@@ -1602,7 +1625,7 @@ XrdMgmOfsFile::open(const char* inpath,
 
         if (stalltime) {
           // stall the client
-          gOFS->MgmStats.Add("OpenStalled", vid.uid, vid.gid, 1);
+          MGM_STATS_ADD("OpenStalled", vid.uid, vid.gid, 1);
           eos_info("attr=user info=\"stalling file since replica's are down\" path=%s rw=%d",
                    path, isRW);
           return gOFS->Stall(error, stalltime,
@@ -1627,7 +1650,7 @@ XrdMgmOfsFile::open(const char* inpath,
 
         rcode = SFS_REDIRECT;
         error.setErrInfo(ecode, redirectionhost.c_str());
-        gOFS->MgmStats.Add("RedirectENONET", vid.uid, vid.gid, 1);
+        MGM_STATS_ADD("RedirectENONET", vid.uid, vid.gid, 1);
         return rcode;
       }
 
@@ -1637,11 +1660,11 @@ XrdMgmOfsFile::open(const char* inpath,
         ecode = 1094;
         rcode = SFS_REDIRECT;
         error.setErrInfo(ecode, redirectionhost.c_str());
-        gOFS->MgmStats.Add("RedirectENONET", vid.uid, vid.gid, 1);
+        MGM_STATS_ADD("RedirectENONET", vid.uid, vid.gid, 1);
         return rcode;
       }
 
-      gOFS->MgmStats.Add("OpenFileOffline", vid.uid, vid.gid, 1);
+      MGM_STATS_ADD("OpenFileOffline", vid.uid, vid.gid, 1);
     } else {
       // Remove the created file from the namespace as root since somebody could
       // have a no-delete ACL. Do this only if there are no replicas already
@@ -1668,7 +1691,7 @@ XrdMgmOfsFile::open(const char* inpath,
         }
       }
 
-      gOFS->MgmStats.Add("OpenFailedQuota", vid.uid, vid.gid, 1);
+      MGM_STATS_ADD("OpenFailedQuota", vid.uid, vid.gid, 1);
     }
 
     if (isRW) {
@@ -1720,7 +1743,7 @@ XrdMgmOfsFile::open(const char* inpath,
             std::string errmsg = e.getMessage().str();
             eos_debug("msg=\"exception\" ec=%d emsg=\"%s\"\n",
                       e.getErrno(), e.getMessage().str().c_str());
-            gOFS->MgmStats.Add("OpenFailedQuota", vid.uid, vid.gid, 1);
+            MGM_STATS_ADD("OpenFailedQuota", vid.uid, vid.gid, 1);
             return Emsg(epname, error, errno, "open file", errmsg.c_str());
           }
 
@@ -1758,7 +1781,7 @@ XrdMgmOfsFile::open(const char* inpath,
             std::string errmsg = e.getMessage().str();
             eos_debug("msg=\"exception\" ec=%d emsg=\"%s\"\n",
                       e.getErrno(), e.getMessage().str().c_str());
-            gOFS->MgmStats.Add("OpenFailedQuota", vid.uid, vid.gid, 1);
+            MGM_STATS_ADD("OpenFailedQuota", vid.uid, vid.gid, 1);
             return Emsg(epname, error, errno, "open file", errmsg.c_str());
           }
         }
@@ -2136,7 +2159,7 @@ XrdMgmOfsFile::open(const char* inpath,
 
       if (retc) {
         // the placement didn't work, we cannot schedule reconstruction
-        gOFS->MgmStats.Add("OpenFailedReconstruct", rootvid.uid, rootvid.gid, 1);
+        MGM_STATS_ADD("OpenFailedReconstruct", rootvid.uid, rootvid.gid, 1);
         return Emsg(epname, error, retc, "schedule stripes for reconstruction", path);
       }
 
@@ -2622,6 +2645,20 @@ XrdMgmOfsFile::read(XrdSfsFileOffset offset,
     return 0;
   }
 
+  if (isInlineOnlyFile) {
+    if ((offset < 0) || (blen < 0)) {
+      return Emsg(epname, error, EINVAL, "read", fileName.c_str());
+    }
+
+    if ((uint64_t) offset >= mInlineContents.size()) {
+      return 0;
+    }
+
+    size_t len = std::min((size_t) blen, mInlineContents.size() - offset);
+    memcpy(buff, mInlineContents.c_str() + offset, len);
+    return len;
+  }
+
   // Make sure the offset is not too large
   //
 #if _FILE_OFFSET_BITS!=64
@@ -2725,6 +2762,13 @@ XrdMgmOfsFile::stat(struct stat* buf)
     return 0;
   }
 
+  if (isInlineOnlyFile) {
+    memset(buf, 0, sizeof(struct stat));
+    buf->st_size = mInlineContents.size();
+    buf->st_mode = S_IFREG | S_IRUSR;
+    return 0;
+  }
+
   if (mProcCmd) {
     return mProcCmd->stat(buf);
   }
@@ -2876,3 +2920,35 @@ XrdMgmOfsFile::GetTriedrcErrno(const std::string& input) const
 
   return 0;
 }
+
+//------------------------------------------------------------------------------
+// Get the contents of a file created inline-only by eosxd
+//------------------------------------------------------------------------------
+int
+XrdMgmOfsFile::GetInlineContents(const std::map<std::string, std::string>&
+                                 xattrs, uint64_t size, std::string& contents)
+{
+  contents.clear();
+  auto it = xattrs.find(eos::common::INLINE_BUFFER_ATTR_NAME);
+
+  if (it == xattrs.end()) {
+    // an empty file has no inline buffer
+    return (size ? ENODATA : 0);
+  }
+
+  std::string encoded = it->second;
+  bool decoded = false;
+
+  if (encoded.substr(0, 8) == "zbase64:") {
+    decoded = eos::common::SymKey::ZDeBase64(encoded, contents);
+  } else if (encoded.substr(0, 7) == "base64:") {
+    decoded = eos::common::SymKey::DeBase64(encoded, contents);
+  }
+
+  if (!decoded || (contents.size() != size)) {
+    contents.clear();
+    return EIO;
+  }
+
+  return 0;
+}
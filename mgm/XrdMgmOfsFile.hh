@@ -79,6 +79,7 @@ public:
     fileId = 0;
     fmd.reset();
     isZeroSizeFile = false;
+    isInlineOnlyFile = false;
   }
 
   //----------------------------------------------------------------------------
@@ -202,7 +203,21 @@ public:
   int Emsg(const char*, XrdOucErrInfo&, int, const char* x,
            const char* y = "");
 
+  //----------------------------------------------------------------------------
+  //! Get the contents of a file created inline-only by eosxd, which has no
+  //! replica and keeps its contents in the sys.file.buffer attribute
+  //!
+  //! @param xattrs extended attributes of the file
+  //! @param size size of the file
+  //! @param contents decoded contents
+  //!
+  //! @return 0 if successful, otherwise errno
+  //----------------------------------------------------------------------------
+  static int GetInlineContents(const std::map<std::string, std::string>& xattrs,
+                               uint64_t size, std::string& contents);
+
   bool isZeroSizeFile; //< true if the file has 0 size
+  bool isInlineOnlyFile; //< true if the file is served from mInlineContents
 
 private:
 
@@ -222,6 +237,7 @@ private:
   std::unique_ptr<IProcCommand> mProcCmd; // proc command object
   std::shared_ptr<eos::IFileMD> fmd; //< file meta data object
   eos::common::Mapping::VirtualIdentity vid; //< virtual ID of the client
+  std::string mInlineContents; //< contents of an inline-only file
 };
 
 #endif
@@ -488,10 +488,18 @@ ProcCommand::Access()
       }
     } else {
       if (stall.length()) {
-        if ((atoi(stall.c_str()) > 0) &&
-            ((type.length() == 0) || (type == "r") || (type == "w") ||
-             ((type.find("rate:") == 0)) || (type == "ENONET") ||
-             (type == "ENOENT") || (type == "ENETUNREACH"))) {
+        RateLimiter::Rule bucket_rule;
+
+        if (RateLimiter::IsRule(type) &&
+            !RateLimiter::ParseRule(type, stall, bucket_rule)) {
+          stdErr = "error: rate limit has to be defined as <rate>[:<burst>] for "
+                   "bucket:{user,group,host}:{name,*}:{op}";
+          retc = EINVAL;
+        } else if ((RateLimiter::IsRule(type) || (atoi(stall.c_str()) > 0)) &&
+                   ((type.length() == 0) || (type == "r") || (type == "w") ||
+                    ((type.find("rate:") == 0)) || RateLimiter::IsRule(type) ||
+                    (type == "ENONET") || (type == "ENOENT") ||
+                    (type == "ENETUNREACH"))) {
           if (type == "r") {
             Access::gStallRules[std::string("r:*")] = stall;
             Access::gStallComment[std::string("r:*")] = mComment.c_str();
@@ -500,7 +508,8 @@ ProcCommand::Access()
               Access::gStallRules[std::string("w:*")] = stall;
               Access::gStallComment[std::string("w:*")] = mComment.c_str();
             } else {
-              if ((type.find("rate:user:") == 0) || (type.find("rate:group:") == 0)) {
+              if ((type.find("rate:user:") == 0) || (type.find("rate:group:") == 0) ||
+                  RateLimiter::IsRule(type)) {
                 Access::gStallRules[std::string(type.c_str())] = stall;
                 Access::gStallComment[std::string(type.c_str())] = mComment.c_str();
               } else {
@@ -526,7 +535,14 @@ ProcCommand::Access()
           }
 
           if (Access::StoreAccessConfig()) {
-            if (type.find("rate:") == 0) {
+            if (RateLimiter::IsRule(type)) {
+              stdOut += "success: setting token bucket rate ";
+              stdOut += std::to_string(bucket_rule.mRate).c_str();
+              stdOut += " Hz burst ";
+              stdOut += std::to_string(bucket_rule.mBurst).c_str();
+              stdOut += " for ";
+              stdOut += type.c_str();
+            } else if (type.find("rate:") == 0) {
               stdOut += "success: setting rate cutoff at ";
               stdOut += stall.c_str();
               stdOut += " Hz for rate:<user|group>:<operation>=";
@@ -655,7 +671,8 @@ ProcCommand::Access()
             Access::gStallRules.erase(std::string("ENETUNREACH:*"));
             Access::gStallComment.erase(std::string("ENETUNREACH:*"));
           } else {
-            if ((type.find("rate:user:") == 0) || (type.find("rate:group:") == 0)) {
+            if ((type.find("rate:user:") == 0) || (type.find("rate:group:") == 0) ||
+                RateLimiter::IsRule(type)) {
               Access::gStallRules.erase(std::string(type.c_str()));
               Access::gStallComment.erase(std::string(type.c_str()));
             } else {
@@ -666,7 +683,8 @@ ProcCommand::Access()
         }
 
         if (Access::StoreAccessConfig()) {
-          if ((type.find("rate:user:") == 0) || (type.find("rate:group:") == 0)) {
+          if ((type.find("rate:user:") == 0) || (type.find("rate:group:") == 0) ||
+              RateLimiter::IsRule(type)) {
             stdOut = "success: removing limit ";
 
             if (type.length()) {
@@ -1020,6 +1038,21 @@ ProcCommand::Access()
         stdOut += "\n";
       }
     }
+
+    if (Access::gStallBucket) {
+      std::string buckets;
+      Access::gRateLimiter.Print(buckets, monitoring);
+
+      if (buckets.length()) {
+        if (!monitoring) {
+          stdOut += "# ....................................................................................\n";
+          stdOut += "# Rate Limit Buckets ...\n";
+          stdOut += "# ....................................................................................\n";
+        }
+
+        stdOut += buckets.c_str();
+      }
+    }
   }
 
   return SFS_OK;
@@ -248,6 +248,9 @@ ProcCommand::Node()
           retc = EIO;
           stdErr = "error: cannot set the manager name";
         }
+
+        FsView::gFsView.mNodeView[nodename]->SetConfigMember("report.batch",
+            FsNode::gManagerId, true, nodename, true);
       }
     }
   } else if (mSubCmd == "rm") {
@@ -24,6 +24,7 @@
 #include "common/LinuxMemConsumption.hh"
 #include "common/LinuxStat.hh"
 #include "common/LinuxFds.hh"
+#include "common/LockProfiler.hh"
 #include "namespace/interface/IChLogFileMDSvc.hh"
 #include "namespace/interface/IChLogContainerMDSvc.hh"
 #include "namespace/interface/IContainerMDSvc.hh"
@@ -90,7 +91,8 @@ NsCmd::MutexSubcmd(const eos::console::NsProto_MutexProto& mutex,
 
     if (mutex.sample_rate1() || mutex.sample_rate10() ||
         mutex.sample_rate100() || mutex.toggle_timing() ||
-        mutex.toggle_order()) {
+        mutex.toggle_order() || mutex.contention() ||
+        mutex.toggle_contention() || mutex.reset_contention()) {
       no_option = false;
     }
 
@@ -135,7 +137,10 @@ NsCmd::MutexSubcmd(const eos::console::NsProto_MutexProto& mutex,
             << "% of the mutex lock/unlock cycle duration)";
       }
 
-      oss << std::endl;
+      oss << std::endl
+          << "contention profiling is : "
+          << (eos::common::LockProfiler::IsEnabled() ? "on" : "off")
+          << std::endl;
     }
 
     if (mutex.toggle_timing()) {
@@ -172,6 +177,27 @@ NsCmd::MutexSubcmd(const eos::console::NsProto_MutexProto& mutex,
       }
     }
 
+    if (mutex.toggle_contention()) {
+      if (eos::common::LockProfiler::IsEnabled()) {
+        eos::common::LockProfiler::SetEnabled(false);
+        oss << "mutex contention profiling is off" << std::endl;
+      } else {
+        eos::common::LockProfiler::SetEnabled(true);
+        oss << "mutex contention profiling is on" << std::endl;
+      }
+    }
+
+    if (mutex.reset_contention()) {
+      eos::common::LockProfiler::GetInstance().Reset();
+      oss << "mutex contention counters have been reset" << std::endl;
+    }
+
+    if (mutex.contention()) {
+      std::string out;
+      eos::common::LockProfiler::GetInstance().Print(out);
+      oss << out;
+    }
+
     if (mutex.sample_rate1() || mutex.sample_rate10() ||
         mutex.sample_rate100()) {
       float rate = 0.0;
@@ -208,6 +234,7 @@ NsCmd::StatSubcmd(const eos::console::NsProto_StatProto& stat)
 
   if (stat.reset()) {
     gOFS->MgmStats.Clear();
+    eos::common::LockProfiler::GetInstance().Reset();
     oss << "success: all counters have been reset" << std::endl;
   }
 
@@ -42,8 +42,8 @@ ProcCommand::FuseX()
   gOFS->MgmStats.Add("Eosxd::ext::0-STREAM", pVid->uid, pVid->gid, 1);
   // -------------------------------------------------------------------------------------------------------
   // This function returns meta data by inode or if provided first translates a path into an inode.
-  // The client can provide the meta-data clock. If it is equivalent to the stored clock, this function
-  // return EEXIST and no result stream.
+  // The client can provide the meta-data clock. If it also sets mgm.ifclock=1 and the clock is equivalent
+  // to the stored clock, this function returns EEXIST and no result stream.
   // If a path cannot be translated the function returns ENOENT or a relevant errno for namespace failures.
   // If mgm.op is equal to 'GETCAP' it does not return meta data but a capability.
   // -------------------------------------------------------------------------------------------------------
@@ -59,6 +59,12 @@ ProcCommand::FuseX()
   XrdOucString cid    = pOpaque->Get("mgm.cid") ? pOpaque->Get("mgm.cid") : "";
   XrdOucString authid = pOpaque->Get("mgm.authid") ? pOpaque->Get("mgm.authid") :
                         "";
+  // only clients which understand an EEXIST reply ask for it
+  bool ifclock = pOpaque->Get("mgm.ifclock") &&
+                 !strcmp(pOpaque->Get("mgm.ifclock"), "1");
+  // only clients which merge paged listings get large listings in pages
+  bool lspage = pOpaque->Get("mgm.lspage") &&
+                !strcmp(pOpaque->Get("mgm.lspage"), "1");
 
   if (spath.length()) {
     // decode escaped path name
@@ -190,31 +196,27 @@ ProcCommand::FuseX()
     }
   }
 
-  if (clock) {
-    // if a clock is given, we only retrieve the MD clock without calling the FillXXX functions
-    if (!eos::common::FileId::IsFileInode(md.md_ino())) {
-      try {
-        uint64_t md_clock;
+  if (clock && ifclock) {
+    // if a conditional clock is given, we only retrieve the MD clock without calling the FillXXX functions
+    eos::common::RWMutexReadLock lock(gOFS->eosViewRWMutex);
+
+    try {
+      if (!eos::common::FileId::IsFileInode(md.md_ino())) {
         gOFS->eosDirectoryService->getContainerMD(md.md_ino(), &md_clock);
-      } catch (eos::MDException& e) {
-        try {
-          gOFS->eosFileService->getFileMD(eos::common::FileId::InodeToFid(inode),
-                                          &md_clock);
-        } catch (eos::MDException& e) {
-          return gOFS->Emsg("FuseX", *mError, e.getErrno(),
-                            e.getMessage().str().c_str());
-        }
+      } else {
+        gOFS->eosFileService->getFileMD(eos::common::FileId::InodeToFid(
+                                          md.md_ino()), &md_clock);
       }
-    } else {
+    } catch (eos::MDException& e) {
+      return gOFS->Emsg("FuseX", *mError, e.getErrno(),
+                        e.getMessage().str().c_str());
     }
 
     eos_debug("c1=%llu c2=%llu", md_clock, clock);
 
-    if ((sop == "GET") || (sop == "LS")) {
-      if (md_clock == clock) {
-        // if the given clock is ok, we return EEXIST
-        return gOFS->Emsg("FuseX", *mError, EEXIST, "get-if-clock", inpath);
-      }
+    if (FuseServer::UnchangedSinceClock(ifclock, sop.c_str(), clock, md_clock)) {
+      // if the given clock is ok, we return EEXIST
+      return gOFS->Emsg("FuseX", *mError, EEXIST, "get-if-clock", inpath);
     }
   }
 
@@ -222,7 +224,7 @@ ProcCommand::FuseX()
   std::string id = std::string("Fusex::sync:") + vid.tident.c_str();
   mResultStream = "";
   int rc = gOFS->zMQ->gFuseServer.HandleMD(id, md, &result, &md_clock,
-           pVid);
+           pVid, lspage);
 
   if (rc) {
     return gOFS->Emsg("FuseX", *mError, rc, "handle request", "");
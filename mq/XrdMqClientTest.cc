@@ -26,12 +26,112 @@
 #include <mq/XrdMqTiming.hh>
 #include <XrdSys/XrdSysLogger.hh>
 #include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Elapsed time in seconds
+//------------------------------------------------------------------------------
+static double
+Seconds(const struct timeval& start, const struct timeval& stop)
+{
+  return (stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1e6;
+}
+
+//------------------------------------------------------------------------------
+// Measure the broker fan-out: broadcast nmsg messages to nsubscribers queues
+// and drain all of them. The send rate is the rate at which the broker
+// accepts and delivers a broadcast into all the queues.
+//------------------------------------------------------------------------------
+static int
+FanOutBench(int nsubscribers, int nmsg)
+{
+  std::vector<XrdMqClient*> subscribers;
+  struct timeval start, stop;
+
+  for (int i = 0; i < nsubscribers; i++) {
+    XrdOucString queue = "/xmessage/bench/";
+    queue += i;
+    XrdOucString url = "root://localhost/";
+    url += queue;
+    XrdMqClient* client = new XrdMqClient(queue.c_str());
+
+    if (!client->AddBroker(url.c_str()) || !client->Subscribe()) {
+      fprintf(stderr, "error: failed to subscribe %s\n", queue.c_str());
+      delete client;
+      break;
+    }
+
+    subscribers.push_back(client);
+  }
+
+  XrdMqClient sender("/xmessage/bench/sender");
+  sender.AddBroker("root://localhost//xmessage/bench/sender");
+  XrdMqMessage message("FanOutBench");
+  gettimeofday(&start, 0);
+
+  for (int i = 0; i < nmsg; i++) {
+    message.NewId();
+    message.kMessageHeader.kDescription = "FanOutBench";
+    message.kMessageHeader.kDescription += i;
+
+    if (!sender.SendMessage(message, "/xmessage/bench/*")) {
+      fprintf(stderr, "error: failed to send message %d\n", i);
+    }
+  }
+
+  gettimeofday(&stop, 0);
+  double tsend = Seconds(start, stop);
+  long long nrecv = 0;
+  gettimeofday(&start, 0);
+
+  for (size_t i = 0; i < subscribers.size(); i++) {
+    XrdMqMessage* newmessage;
+
+    while ((newmessage = subscribers[i]->RecvMessage())) {
+      nrecv++;
+      delete newmessage;
+    }
+  }
+
+  gettimeofday(&stop, 0);
+  double trecv = Seconds(start, stop);
+  fprintf(stdout, "subscribers=%-6lu messages=%-6d send=%.02f msg/s "
+          "fanout=%.02f deliveries/s drained=%lld in %.03f s\n",
+          (unsigned long) subscribers.size(), nmsg, nmsg / tsend,
+          nmsg * subscribers.size() / tsend, nrecv, trecv);
+
+  for (size_t i = 0; i < subscribers.size(); i++) {
+    delete subscribers[i];
+  }
+
+  return (nrecv == (long long) nmsg * (long long) subscribers.size()) ? 0 : -1;
+}
 
 int main(int argc, char* argv[])
 {
   printf("Starting up ...\n");
   XrdMqMessage::Logger = new XrdSysLogger();
   XrdMqMessage::Eroute.logger(XrdMqMessage::Logger);
+
+  if ((argc >= 2) && !strcmp(argv[1], "bench")) {
+    // usage: xrdmqclienttest bench [messages] [subscribers]
+    int nmsg = (argc >= 3) ? atoi(argv[2]) : 100;
+    std::vector<int> nsubscribers = {1000, 10000, 50000};
+    int retc = 0;
+
+    if (argc >= 4) {
+      nsubscribers = {atoi(argv[3])};
+    }
+
+    for (size_t i = 0; i < nsubscribers.size(); i++) {
+      retc |= FanOutBench(nsubscribers[i], nmsg);
+    }
+
+    return retc;
+  }
+
   XrdMqClient mqc;
   printf("Created broker ...\n");
 
@@ -27,8 +27,62 @@
 #include <XrdSys/XrdSysLogger.hh>
 #include <stdio.h>
 
+//------------------------------------------------------------------------------
+// Time the signature and verification of messages with the keys of the given
+// mq configuration file, with RSA and with HMAC signatures
+//------------------------------------------------------------------------------
+int SignVerifyBench(const char* config)
+{
+  XrdMqMessage::kFastSign = true;
+
+  if (XrdMqMessage::Configure(config) || !XrdMqMessage::kCanSign ||
+      !XrdMqMessage::kCanVerify) {
+    fprintf(stderr, "error: cannot load the keys from %s\n", config);
+    return -1;
+  }
+
+  std::string body(1024, 'x');
+
+  for (int fast = 0; fast < 2; ++fast) {
+    XrdMqMessage::kFastSign = fast;
+    XrdMqTiming mqs(fast ? "HMAC Sign/Verify-Timing" : "RSA Sign/Verify-Timing");
+    TIMING("START", &mqs);
+
+    for (int i = 0; i < 1000; i++) {
+      XrdMqMessage message("SignBench");
+      message.SetBody(body.c_str());
+
+      if (!message.Sign()) {
+        fprintf(stderr, "error: failed to sign message\n");
+        return -1;
+      }
+
+      XrdOucString raw = message.GetMessageBuffer();
+      XrdMqMessage received(raw);
+
+      if (!received.Verify()) {
+        fprintf(stderr, "error: failed to verify message\n");
+        return -1;
+      }
+    }
+
+    TIMING("STOP", &mqs);
+    mqs.Print();
+  }
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Usage: xrdmqcryptotest [<mq config file>] - with a configuration file the
+// message signatures are timed, otherwise the symmetric encryption
+//------------------------------------------------------------------------------
 int main(int argc, char* argv[])
 {
+  if (argc > 1) {
+    return SignVerifyBench(argv[1]);
+  }
+
   XrdMqMessage message("HelloCrypto");
   message.SetBody("mqtest=testmessage12343556124368273468273468273468273468234");
   XrdMqTiming mqs("Symmetric Enc/Dec-Timing");
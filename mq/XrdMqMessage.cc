@@ -28,6 +28,7 @@
 #include <fcntl.h>
 #include <dirent.h>
 #include <stdint.h>
+#include <climits>
 #include <iostream>
 #include <sstream>
 #include <openssl/rsa.h>
@@ -36,6 +37,10 @@
 #include <openssl/err.h>
 #include <openssl/pem.h>
 #include <openssl/ssl.h>
+#include <openssl/hmac.h>
+#include <openssl/sha.h>
+#include <openssl/crypto.h>
+#include <fstream>
 
 EVP_PKEY*    XrdMqMessage::PrivateKey = 0;
 XrdOucString XrdMqMessage::PublicKeyDirectory = "";
@@ -44,6 +49,10 @@ XrdOucString XrdMqMessage::PublicKeyFileHash = "";
 XrdOucHash<KeyWrapper> XrdMqMessage::PublicKeyHash;
 bool         XrdMqMessage::kCanSign = false;
 bool         XrdMqMessage::kCanVerify = false;
+bool         XrdMqMessage::kFastSign = false;
+XrdOucString XrdMqMessage::HmacKeyFile = "/etc/eos.keytab";
+std::string  XrdMqMessage::HmacKey = "";
+std::string  XrdMqMessage::HmacKeyId = "";
 XrdSysLogger* XrdMqMessage::Logger = 0;
 XrdSysError  XrdMqMessage::Eroute(0);
 
@@ -381,6 +390,18 @@ XrdMqMessage::Configure(const char* ConfigFN)
           PublicKeyFileHash = val;
         }
       }
+
+      if (!strcmp("signature", var)) {
+        if ((val = Config.GetWord())) {
+          kFastSign = !strcmp(val, "hmac");
+        }
+      }
+
+      if (!strcmp("hmackeyfile", var)) {
+        if ((val = Config.GetWord())) {
+          HmacKeyFile = val;
+        }
+      }
     }
   }
 
@@ -413,6 +434,24 @@ XrdMqMessage::Configure(const char* ConfigFN)
     kCanSign = true;
   }
 
+  if (kFastSign) {
+    // The HMAC key is derived from a secret shared by all the instance nodes
+    std::ifstream file(HmacKeyFile.c_str(), std::ios::binary);
+
+    if (!file.is_open()) {
+      return Eroute.Emsg("Config", errno, "open hmac key file fn=",
+                         HmacKeyFile.c_str());
+    }
+
+    std::string secret((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+
+    if (!SetHmacSecret(secret)) {
+      return Eroute.Emsg("Config", EINVAL, "derive hmac key from file fn=",
+                         HmacKeyFile.c_str());
+    }
+  }
+
   if (PublicKeyDirectory.length()) {
     // Read all public keys into the public key hash
     DIR* dp;
@@ -488,6 +527,13 @@ XrdMqMessage::Configure(const char* ConfigFN)
     Eroute.Say("=====> mq.privatekeyfile     :     ", PrivateKeyFile.c_str(), "");
     Eroute.Say("=====> mq.publickeyhash      :     ", PublicKeyFileHash.c_str(),
                "");
+    Eroute.Say("=====> mq.signature          :     ", kFastSign ? "hmac" : "rsa",
+               "");
+  }
+
+  if (kFastSign) {
+    Eroute.Say("=====> mq.hmackeyfile        :     ", HmacKeyFile.c_str(), "");
+    Eroute.Say("=====> hmac key id           :     ", HmacKeyId.c_str(), "");
   }
 
   if (kCanVerify) {
@@ -541,35 +587,17 @@ bool
 XrdMqMessage::Base64Encode(const char* decoded_bytes, ssize_t decoded_length,
                            std::string& out)
 {
-  BIO* bmem, *b64;
-  BUF_MEM* bptr;
-  b64 = BIO_new(BIO_f_base64());
-
-  if (!b64) {
-    Eroute.Emsg("Verify", ENOMEM, "get new base64 BIO");
+  if ((decoded_length < 0) || (decoded_length > INT_MAX / 4 * 3 - 3)) {
+    Eroute.Emsg("Base64Encode", EINVAL, "encode - illegal length");
     return false;
   }
 
-  BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
-  bmem = BIO_new(BIO_s_mem());
-
-  if (!bmem) {
-    Eroute.Emsg("Verify", ENOMEM, "get new mem BIO");
-    return false;
-  }
-
-  b64 = BIO_push(b64, bmem);
-  BIO_write(b64, decoded_bytes, decoded_length);
-
-  if (BIO_flush(b64) != 1) {
-    BIO_free_all(b64);
-    Eroute.Emsg("Verify", EIO, "flush bio");
-    return false;
-  }
-
-  BIO_get_mem_ptr(b64, &bptr);
-  out.assign(bptr->data, bptr->length);
-  BIO_free_all(b64);
+  // Encode in one pass into the output string, the block encoder writes a
+  // trailing null character
+  out.resize(4 * ((decoded_length + 2) / 3) + 1);
+  int len = EVP_EncodeBlock((unsigned char*) &out[0],
+                            (const unsigned char*) decoded_bytes, decoded_length);
+  out.resize(len);
   return true;
 }
 
@@ -580,29 +608,40 @@ bool
 XrdMqMessage::Base64Decode(const char* encoded_bytes, char*& decoded_bytes,
                            ssize_t& decoded_length)
 {
-  BIO* b64, *bmem;
-  ssize_t buffer_length;
-  bmem = BIO_new_mem_buf((void*)encoded_bytes, -1);
+  size_t encoded_length = strlen(encoded_bytes);
 
-  if (!bmem) {
-    Eroute.Emsg("Verify", ENOMEM, "get new mem BIO");
+  if ((encoded_length % 4) || (encoded_length > INT_MAX)) {
+    Eroute.Emsg("Base64Decode", EINVAL, "decode - illegal length");
     return false;
   }
 
-  b64 = BIO_new(BIO_f_base64());
+  decoded_bytes = (char*) malloc(encoded_length / 4 * 3 + 1);
 
-  if (!b64) {
-    Eroute.Emsg("Verify", ENOMEM, "get new BIO");
+  if (!decoded_bytes) {
+    Eroute.Emsg("Base64Decode", ENOMEM, "allocate decoding memory");
     return false;
   }
 
-  BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
-  bmem = BIO_push(b64, bmem);
-  buffer_length = BIO_get_mem_data(bmem, NULL);
-  decoded_bytes = (char*) malloc(buffer_length + 1);
-  decoded_length = BIO_read(bmem, decoded_bytes, buffer_length);
+  int len = EVP_DecodeBlock((unsigned char*) decoded_bytes,
+                            (const unsigned char*) encoded_bytes, encoded_length);
+
+  if (len < 0) {
+    free(decoded_bytes);
+    decoded_bytes = 0;
+    return false;
+  }
+
+  // The block decoder returns the padding as zero bytes
+  if (encoded_length && (encoded_bytes[encoded_length - 1] == '=')) {
+    len--;
+
+    if (encoded_bytes[encoded_length - 2] == '=') {
+      len--;
+    }
+  }
+
+  decoded_length = len;
   decoded_bytes[decoded_length] = '\0';
-  BIO_free_all(bmem);
   return true;
 }
 
@@ -864,6 +903,10 @@ XrdMqMessage::RSADecrypt(char* encrypted_data, ssize_t encrypted_length,
 //------------------------------------------------------------------------------
 bool XrdMqMessage::Sign(bool encrypt)
 {
+  if (kFastSign && !encrypt) {
+    return HmacSign();
+  }
+
   unsigned int sig_len;
   unsigned char sig_buf[16384];
   EVP_MD_CTX* md_ctx = EVP_MD_CTX_create();
@@ -1050,6 +1093,10 @@ bool XrdMqMessage::Verify()
     free(decrypteddigest);
   }
 
+  if (kMessageHeader.kMessageSignature.beginswith("hmac:")) {
+    return HmacVerify();
+  }
+
   // Decompose the signature
   if (!kMessageHeader.kMessageSignature.beginswith("rsa:")) {
     Eroute.Emsg(__FUNCTION__, EINVAL, "decode message signature - misses rsa: tag");
@@ -1343,6 +1390,10 @@ XrdMqMessage::RSADecrypt(char* encrypted_data, ssize_t encrypted_length,
 //------------------------------------------------------------------------------
 bool XrdMqMessage::Sign(bool encrypt)
 {
+  if (kFastSign && !encrypt) {
+    return HmacSign();
+  }
+
   unsigned int sig_len;
   unsigned char sig_buf[16384];
   EVP_MD_CTX md_ctx;
@@ -1528,6 +1579,10 @@ bool XrdMqMessage::Verify()
     free(decrypteddigest);
   }
 
+  if (kMessageHeader.kMessageSignature.beginswith("hmac:")) {
+    return HmacVerify();
+  }
+
   // Decompose the signature
   if (!kMessageHeader.kMessageSignature.beginswith("rsa:")) {
     Eroute.Emsg(__FUNCTION__, EINVAL, "decode message signature - misses rsa: tag");
@@ -1593,6 +1648,129 @@ bool XrdMqMessage::Verify()
 }
 #endif
 
+//------------------------------------------------------------------------------
+// Derive the HMAC key from a secret shared by all the nodes of the instance
+//------------------------------------------------------------------------------
+bool
+XrdMqMessage::SetHmacSecret(const std::string& secret)
+{
+  static const char* sLabel = "eos.mq.hmac";
+  unsigned char key[EVP_MAX_MD_SIZE];
+  unsigned int key_len = 0;
+
+  if (secret.empty() ||
+      !HMAC(EVP_sha1(), secret.c_str(), secret.length(),
+            (const unsigned char*) sLabel, strlen(sLabel), key, &key_len)) {
+    HmacKey.clear();
+    HmacKeyId.clear();
+    return false;
+  }
+
+  HmacKey.assign((char*) key, key_len);
+  // The key id lets a receiver tell a different secret from a forged message
+  unsigned char id[SHA_DIGEST_LENGTH];
+  SHA1(key, key_len, id);
+  char hexid[9];
+  snprintf(hexid, sizeof(hexid), "%02x%02x%02x%02x", id[0], id[1], id[2],
+           id[3]);
+  HmacKeyId = hexid;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Sign the message body with an HMAC using the shared key
+//------------------------------------------------------------------------------
+bool
+XrdMqMessage::HmacSign()
+{
+  if (HmacKey.empty()) {
+    Eroute.Emsg(__FUNCTION__, EINVAL, "sign message - no hmac key");
+    return false;
+  }
+
+  unsigned char mac[EVP_MAX_MD_SIZE];
+  unsigned int mac_len = 0;
+
+  if (!HMAC(EVP_sha1(), HmacKey.c_str(), HmacKey.length(),
+            (const unsigned char*) kMessageBody.c_str(), kMessageBody.length(),
+            mac, &mac_len)) {
+    Eroute.Emsg(__FUNCTION__, EINVAL, "compute hmac of message body");
+    return false;
+  }
+
+  std::string b64mac;
+
+  if (!Base64Encode((char*) mac, mac_len, b64mac)) {
+    return false;
+  }
+
+  // hmac:<key id>:<hmac>
+  kMessageHeader.kMessageSignature = "hmac:";
+  kMessageHeader.kMessageSignature += HmacKeyId.c_str();
+  kMessageHeader.kMessageSignature += ":";
+  kMessageHeader.kMessageSignature += b64mac.c_str();
+  kMessageHeader.kMessageDigest = "";
+  Encode();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Verify the HMAC signature of the message body
+//------------------------------------------------------------------------------
+bool
+XrdMqMessage::HmacVerify()
+{
+  std::string signature = kMessageHeader.kMessageSignature.c_str();
+  size_t kpos = signature.find(':', 5);
+
+  if (kpos == std::string::npos) {
+    Eroute.Emsg(__FUNCTION__, EINVAL, "decode message signature - misses hmac "
+                "fields");
+    return false;
+  }
+
+  if (HmacKey.empty()) {
+    Eroute.Emsg(__FUNCTION__, EINVAL, "verify hmac signature - no hmac key "
+                "configured");
+    return false;
+  }
+
+  if (signature.compare(5, kpos - 5, HmacKeyId)) {
+    Eroute.Emsg(__FUNCTION__, EPERM, "verify hmac signature - the sender uses "
+                "a different key id", signature.substr(5, kpos - 5).c_str());
+    return false;
+  }
+
+  char* sig = 0;
+  ssize_t siglen = 0;
+
+  if (!Base64Decode(signature.c_str() + kpos + 1, sig, siglen)) {
+    Eroute.Emsg(__FUNCTION__, EINVAL, "base64 decode message signature");
+    return false;
+  }
+
+  unsigned char mac[EVP_MAX_MD_SIZE];
+  unsigned int mac_len = 0;
+  bool retc = HMAC(EVP_sha1(), HmacKey.c_str(), HmacKey.length(),
+                   (const unsigned char*) kMessageBody.c_str(),
+                   kMessageBody.length(), mac, &mac_len) &&
+              (mac_len == (unsigned int) siglen) &&
+              !CRYPTO_memcmp(mac, sig, mac_len);
+  free(sig);
+
+  if (!retc) {
+    Eroute.Emsg(__FUNCTION__, EPERM, "verify hmac of message body");
+    return false;
+  }
+
+  kMessageBuffer = "";
+  kMessageHeader.kMessageSignature = "";
+  kMessageHeader.kMessageDigest = "";
+  kMessageHeader.kEncrypted = false;
+  kMessageHeader.Encode();
+  return true;
+}
+
 //------------------------------------------------------------------------------
 // SymmetricStringEncrypt - key length is SHA_DIGEST_LENGTH
 //------------------------------------------------------------------------------
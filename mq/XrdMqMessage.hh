@@ -315,17 +315,42 @@ public:
   //----------------------------------------------------------------------------
   //! Sign message object
   //!
-  //! @param encrypt if true
+  //! @param encrypt if true the body is encrypted, this always uses RSA
   //!
   //! @return true if signing successful, otherwise false
   //----------------------------------------------------------------------------
   bool Sign(bool encrypt = false);
 
   //----------------------------------------------------------------------------
-  //! Verify message object
+  //! Verify message object, both RSA and HMAC signatures are accepted
   //----------------------------------------------------------------------------
   bool Verify();
 
+  //----------------------------------------------------------------------------
+  //! Sign the message body with an HMAC. The HMAC key is derived from a
+  //! secret shared by all the nodes of the instance (the sss keytab by
+  //! default), so no key travels with the messages.
+  //!
+  //! @return true if signing successful, otherwise false
+  //----------------------------------------------------------------------------
+  bool HmacSign();
+
+  //----------------------------------------------------------------------------
+  //! Verify the HMAC signature of the message body
+  //!
+  //! @return true if the signature is valid, otherwise false
+  //----------------------------------------------------------------------------
+  bool HmacVerify();
+
+  //----------------------------------------------------------------------------
+  //! Derive the HMAC key and its id from a shared secret
+  //!
+  //! @param secret content of the shared secret e.g. the sss keytab
+  //!
+  //! @return true if successful, otherwise false
+  //----------------------------------------------------------------------------
+  static bool SetHmacSecret(const std::string& secret);
+
   //----------------------------------------------------------------------------
   //!
   //! key length is SHA_DIGEST_LENGTH
@@ -424,6 +449,10 @@ public:
   //! @todo These two should be review as they are used only for printing info
   static bool kCanSign;
   static bool kCanVerify;
+  static bool kFastSign; ///< sign with HMAC instead of RSA ("mq.signature hmac")
+  static XrdOucString HmacKeyFile; ///< shared secret file ("mq.hmackeyfile")
+  static std::string HmacKey; ///< HMAC key derived from the shared secret
+  static std::string HmacKeyId; ///< id of the HMAC key sent in the signature
 
   // Static settings and configuration
   static EVP_PKEY* PrivateKey;             ///< private key for signatures
@@ -91,16 +91,6 @@ STRINGSTORE(const char* __charptr__)
   }
 }
 
-XrdMqOfsOutMutex::XrdMqOfsOutMutex()
-{
-  gMqFS->QueueOutMutex.Lock();
-}
-
-XrdMqOfsOutMutex::~XrdMqOfsOutMutex()
-{
-  gMqFS->QueueOutMutex.UnLock();
-}
-
 /******************************************************************************/
 /*                           C o n s t r u c t o r                            */
 /******************************************************************************/
@@ -117,7 +107,9 @@ XrdMqOfs::XrdMqOfs(XrdSysError* ep):
   AdvisoryMessages = 0;
   UndeliverableMessages = 0;
   DiscardedMonitoringMessages = 0;
-  BacklogDeferred = NoMessages = QueueBacklogHits = 0;
+  NoMessages = 0;
+  BacklogDeferred = 0;
+  QueueBacklogHits = 0;
   MaxMessageBacklog  = MQOFSMAXMESSAGEBACKLOG;
   MaxQueueBacklog    = MQOFSMAXQUEUEBACKLOG;
   RejectQueueBacklog = MQOFSREJECTQUEUEBACKLOG;
@@ -274,9 +266,10 @@ XrdMqOfs::stat(const char*                queuename,
   ZTRACE(stat, "stat by buf: " << queuename);
   std::string squeue = queuename;
   {
-    XrdMqOfsOutMutex qm;
+    XrdMqRWMutexReadLock qm(gMqFS->QueueOutMutex);
+    auto it = gMqFS->QueueOut.find(squeue);
 
-    if ((!gMqFS->QueueOut.count(squeue)) || (!(Out = gMqFS->QueueOut[squeue]))) {
+    if ((it == gMqFS->QueueOut.end()) || (!(Out = it->second))) {
       return gMqFS->Emsg(epname, error, EINVAL, "check queue - no such queue");
     }
 
@@ -297,7 +290,7 @@ XrdMqOfs::stat(const char*                queuename,
     XrdSmartOucEnv* env = new XrdSmartOucEnv(amg.GetMessageBuffer());
     XrdMqOfsMatches matches(gMqFS->QueueAdvisory.c_str(), env, tident,
                             XrdMqMessageHeader::kQueryMessage, queuename);
-    XrdMqOfsOutMutex qm;
+    XrdMqRWMutexReadLock qm(gMqFS->QueueOutMutex);
 
     if (!gMqFS->Deliver(matches)) {
       delete env;
@@ -360,7 +353,7 @@ XrdMqOfsFile::open(const char*                queuename,
   tident = error.getErrUser();
   MAYREDIRECT;
   ZTRACE(open, "Connecting Queue: " << queuename);
-  XrdMqOfsOutMutex qm;
+  XrdMqRWMutexWriteLock qm(gMqFS->QueueOutMutex);
   QueueName = queuename;
   std::string squeue = queuename;
 
@@ -421,14 +414,15 @@ XrdMqOfsFile::close()
   ZTRACE(close, "Disconnecting Queue: " << QueueName.c_str());
   std::string squeue = QueueName.c_str();
   {
-    XrdMqOfsOutMutex qm;
+    XrdMqRWMutexWriteLock qm(gMqFS->QueueOutMutex);
 
     if ((gMqFS->QueueOut.count(squeue)) && (Out = gMqFS->QueueOut[squeue])) {
       // hmm this could create a dead lock
       //      Out->DeletionSem.Wait();
       Out->Lock();
       // we have to take away all pending messages
-      Out->RetrieveMessages();
+      Out->ReleaseMessages();
+      Out->UnLock();
       gMqFS->QueueOut.erase(squeue);
       delete Out;
     }
@@ -450,7 +444,7 @@ XrdMqOfsFile::close()
     XrdSmartOucEnv* env = new XrdSmartOucEnv(amg.GetMessageBuffer());
     XrdMqOfsMatches matches(gMqFS->QueueAdvisory.c_str(), env, tident,
                             XrdMqMessageHeader::kStatusMessage, QueueName.c_str());
-    XrdMqOfsOutMutex qm;
+    XrdMqRWMutexReadLock qm(gMqFS->QueueOutMutex);
 
     if (!gMqFS->Deliver(matches)) {
       delete env;
@@ -470,19 +464,12 @@ XrdMqOfsFile::read(XrdSfsFileOffset  fileOffset,
   ZTRACE(read, "read");
 
   if (Out) {
-    unsigned int mlen = Out->MessageBuffer.length();
     ZTRACE(read, "reading size:" << buffer_size);
-
-    if ((unsigned long) buffer_size < mlen) {
-      memcpy(buffer, Out->MessageBuffer.c_str(), buffer_size);
-      Out->MessageBuffer.erase(0, buffer_size);
-      return buffer_size;
-    } else {
-      memcpy(buffer, Out->MessageBuffer.c_str(), mlen);
-      Out->MessageBuffer.clear();
-      Out->MessageBuffer.reserve(0);
-      return mlen;
-    }
+    // the messages are copied straight from the shared buffers
+    Out->Lock();
+    XrdSfsXferSize nread = Out->Read(buffer, buffer_size);
+    Out->UnLock();
+    return nread;
   }
 
   error.setErrInfo(-1, "");
@@ -528,7 +515,7 @@ XrdMqOfsFile::stat(struct stat* buf)
       XrdSmartOucEnv* env = new XrdSmartOucEnv(amg.GetMessageBuffer());
       XrdMqOfsMatches matches(gMqFS->QueueAdvisory.c_str(), env, tident,
                               XrdMqMessageHeader::kQueryMessage, QueueName.c_str());
-      XrdMqOfsOutMutex qm;
+      XrdMqRWMutexReadLock qm(gMqFS->QueueOutMutex);
 
       if (!gMqFS->Deliver(matches)) {
         delete env;
@@ -775,7 +762,7 @@ XrdMqOfs::Statistics()
       rc = write(fd, line, strlen(line));
       sprintf(line, "mq.nqueues                %d\n", (int)QueueOut.size());
       rc = write(fd, line, strlen(line));
-      sprintf(line, "mq.backloghits            %lld\n", QueueBacklogHits);
+      sprintf(line, "mq.backloghits            %lld\n", QueueBacklogHits.load());
       rc = write(fd, line, strlen(line));
       sprintf(line, "mq.in_rate                %f\n",
               (1000.0 * (ReceivedMessages - LastReceivedMessages) / (tdiff)));
@@ -820,8 +807,8 @@ XrdMqOfs::Statistics()
     ZTRACE(getstats, "No        Messages            : " << NoMessages);
     ZTRACE(getstats, "Queue     Messages            : " << Messages.size());
     ZTRACE(getstats, "#Queues                       : " << QueueOut.size());
-    ZTRACE(getstats, "Deferred  Messages (backlog)  : " << BacklogDeferred);
-    ZTRACE(getstats, "Backlog   Messages Hits       : " << QueueBacklogHits);
+    ZTRACE(getstats, "Deferred  Messages (backlog)  : " << BacklogDeferred.load());
+    ZTRACE(getstats, "Backlog   Messages Hits       : " << QueueBacklogHits.load());
     char rates[4096];
     sprintf(rates,
             "Rates: IN: %.02f OUT: %.02f FAN: %.02f ADV: %.02f: UNDEV: %.02f DISCMON: %.02f NOMSG: %.02f"
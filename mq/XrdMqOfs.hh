@@ -25,6 +25,7 @@
 #define __XFTSOFS_NS_H__
 
 #include <sys/types.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <errno.h>
@@ -40,6 +41,7 @@
 #include <string>
 #include <vector>
 #include <deque>
+#include <atomic>
 
 #include <utime.h>
 #include <pwd.h>
@@ -52,6 +54,7 @@
 #include "XrdSys/XrdSysPthread.hh"
 #include "XrdSys/XrdSysSemWait.hh"
 #include "XrdOfs/XrdOfs.hh"
+#include "mq/XrdMqRWMutex.hh"
 
 class XrdSecEntity;
 
@@ -71,24 +74,26 @@ class XrdSecEntity;
 class XrdSysError;
 class XrdSysLogger;
 
+//------------------------------------------------------------------------------
+//! Class XrdSmartOucEnv - message shared by all the queues it is delivered to.
+//! Every queue holding the message owns one reference, the last one to drop
+//! its reference frees it.
+//------------------------------------------------------------------------------
 class XrdSmartOucEnv : public XrdOucEnv
 {
 private:
-  int nref;
+  std::atomic<int> nref;
 public:
-  XrdSysMutex procmutex;
-
   int  Refs()
   {
     return nref;
   }
-  void DecRefs()
+  int  DecRefs()
   {
-    nref--;
+    return --nref;
   }
   void AddRefs(int nrefs)
   {
-    ;
     nref += nrefs;
   }
   XrdSmartOucEnv(const char* vardata = 0, int vardlen = 0) : XrdOucEnv(vardata,
@@ -128,6 +133,65 @@ public:
   ~XrdMqOfsMatches() {}
 };
 
+//------------------------------------------------------------------------------
+//! Class XrdMqMessageRing - ring buffer of message pointers which doubles its
+//! capacity when full. It is not thread-safe, the owning output queue's mutex
+//! protects it.
+//------------------------------------------------------------------------------
+class XrdMqMessageRing
+{
+public:
+  XrdMqMessageRing(): mHead(0), mTail(0) {}
+
+  inline size_t Size() const
+  {
+    return mTail - mHead;
+  }
+
+  inline bool Empty() const
+  {
+    return (mTail == mHead);
+  }
+
+  inline void Push(XrdSmartOucEnv* message)
+  {
+    if (Size() == mSlots.size()) {
+      Grow();
+    }
+
+    mSlots[mTail++ & (mSlots.size() - 1)] = message;
+  }
+
+  inline XrdSmartOucEnv* Front() const
+  {
+    return mSlots[mHead & (mSlots.size() - 1)];
+  }
+
+  inline void Pop()
+  {
+    mHead++;
+  }
+
+private:
+  void Grow()
+  {
+    std::vector<XrdSmartOucEnv*> slots(mSlots.empty() ? 16 : 2 * mSlots.size());
+    size_t size = Size();
+
+    for (size_t i = 0; i < size; ++i) {
+      slots[i] = mSlots[(mHead + i) & (mSlots.size() - 1)];
+    }
+
+    mSlots.swap(slots);
+    mHead = 0;
+    mTail = size;
+  }
+
+  std::vector<XrdSmartOucEnv*> mSlots; ///< Power of two number of slots
+  uint64_t mHead; ///< Position of the first message
+  uint64_t mTail; ///< Position after the last message
+};
+
 // TODO (esindril): This needs to be reviewd since XrdSysMutex does not have a
 // virtual destructor hence XrdMqMessageOut can not inherit it.
 class XrdMqMessageOut : public XrdSysMutex
@@ -141,27 +205,53 @@ public:
   XrdOucString QueueName;
   XrdSysSemWait DeletionSem;
   XrdSysSemWait MessageSem;
-  std::deque<XrdSmartOucEnv*> MessageQueue;
+  XrdMqMessageRing MessageQueue; // -> messages delivered but not retrieved
 
   XrdMqMessageOut(const char* queuename)
   {
-    MessageBuffer = "";
     AdvisoryStatus = false;
     AdvisoryQuery = false;
     AdvisoryFlushBackLog = false;
     BrokenByFlush = false;
     nQueued = 0;
     QueueName = queuename;
-    MessageQueue.clear();
+    mRetrievedBytes = 0;
+    mReadOffset = 0;
   }
 
   virtual ~XrdMqMessageOut()
   {
-    RetrieveMessages();
+    ReleaseMessages();
   }
 
-  std::string MessageBuffer;
+  //----------------------------------------------------------------------------
+  //! Move the delivered messages to the ones to be read, the queue has to be
+  //! locked
+  //!
+  //! @return number of bytes to be read
+  //----------------------------------------------------------------------------
   size_t RetrieveMessages();
+
+  //----------------------------------------------------------------------------
+  //! Copy retrieved messages into the buffer of a reader and drop the
+  //! references of the ones completely read, the queue has to be locked
+  //!
+  //! @param buffer output buffer
+  //! @param size size of the output buffer
+  //!
+  //! @return number of bytes copied
+  //----------------------------------------------------------------------------
+  size_t Read(char* buffer, size_t size);
+
+  //----------------------------------------------------------------------------
+  //! Drop all delivered and retrieved messages
+  //----------------------------------------------------------------------------
+  void ReleaseMessages();
+
+private:
+  XrdMqMessageRing mRetrieved; ///< Messages retrieved but not fully read
+  size_t mRetrievedBytes; ///< Bytes left to read from the retrieved messages
+  size_t mReadOffset; ///< Bytes already read from the first retrieved message
 };
 
 
@@ -260,13 +350,6 @@ private:
 };
 
 
-class XrdMqOfsOutMutex
-{
-public:
-  XrdMqOfsOutMutex();
-  ~XrdMqOfsOutMutex();
-};
-
 class XrdMqOfs : public XrdSfsFileSystem
 {
 public:
@@ -323,11 +406,13 @@ public:
 
   std::map<std::string, XrdMqMessageOut*>
   QueueOut;  // -> hash of all output's connected
-  XrdSysMutex
-  QueueOutMutex;  // -> mutex protecting the output hash
+  XrdMqRWMutex
+  QueueOutMutex;  // -> write locked to add/remove outputs, read locked to deliver
 
   bool             Deliver(XrdMqOfsMatches&
                            Match); // -> delivers a message into matching output queues
+  void             ReleaseMessage(XrdSmartOucEnv*
+                                  message); // -> drops one reference of a message
 
   std::map<std::string, XrdSmartOucEnv*> Messages;  // -> hash with all messages
 
@@ -403,8 +488,8 @@ public:
   long long    UndeliverableMessages;
   long long    DiscardedMonitoringMessages;
   long long    NoMessages;
-  long long    BacklogDeferred;
-  long long    QueueBacklogHits;
+  std::atomic<long long> BacklogDeferred;
+  std::atomic<long long> QueueBacklogHits;
   long long    MaxMessageBacklog;
   long long    MaxQueueBacklog;
   long long    RejectQueueBacklog;
@@ -27,6 +27,7 @@
 #include "mq/XrdMqMessage.hh"
 #include "mq/XrdMqOfsTrace.hh"
 #include "XrdOuc/XrdOucEnv.hh"
+#include <algorithm>
 
 #define XRDMQOFS_FSCTLPATHLEN 1024
 
@@ -44,7 +45,6 @@ XrdMqOfs::Deliver(XrdMqOfsMatches& Matches)
   std::string sendername = Matches.sendername.c_str();
   // here we store all the queues where we need to deliver this message
   std::vector<XrdMqMessageOut*> MatchedOutputQueues;
-  Matches.message->procmutex.Lock();
 
   // If we have a status message we have to do a complete loop
   if (((Matches.messagetype) == XrdMqMessageHeader::kStatusMessage) ||
@@ -81,6 +81,8 @@ XrdMqOfs::Deliver(XrdMqOfsMatches& Matches)
     // If we have a wildcard match we have to do a complete loop
     if ((Matches.queuename.find("*") != STR_NPOS)) {
       std::map<std::string, XrdMqMessageOut*>::const_iterator QueueOutIt;
+      XrdOucString nowildcard = Matches.queuename;
+      nowildcard.replace("*", "");
 
       for (QueueOutIt = QueueOut.begin(); QueueOutIt != QueueOut.end();
            QueueOutIt++) {
@@ -94,8 +96,6 @@ XrdMqOfs::Deliver(XrdMqOfsMatches& Matches)
         }
 
         XrdOucString Key = QueueOutIt->first.c_str();
-        XrdOucString nowildcard = Matches.queuename;
-        nowildcard.replace("*", "");
         int nmatch = Key.matches(Matches.queuename.c_str(), '*');
 
         if (nmatch == nowildcard.length()) {
@@ -109,9 +109,10 @@ XrdMqOfs::Deliver(XrdMqOfsMatches& Matches)
       // We have just to find one named queue
       std::string queuename = Matches.queuename.c_str();
       XrdMqMessageOut* Out = 0;
+      auto it = QueueOut.find(queuename);
 
-      if (QueueOut.count(queuename)) {
-        Out = QueueOut[queuename];
+      if (it != QueueOut.end()) {
+        Out = it->second;
       }
 
       if (Out) {
@@ -126,15 +127,14 @@ XrdMqOfs::Deliver(XrdMqOfsMatches& Matches)
   if (MatchedOutputQueues.size()) {
     Matches.backlog = false;
     Matches.backlogrejected = false;
+    // Hold a reference while delivering, otherwise a reader could free the
+    // message before it was added to all the queues
+    Matches.message->AddRefs(1);
 
-    // Lock all matched queues at once
     for (unsigned int i = 0; i < MatchedOutputQueues.size(); ++i) {
       XrdMqMessageOut* Out = MatchedOutputQueues[i];
+      // Only the queue itself is locked, the message is shared by pointer
       Out->Lock();
-    }
-
-    for (unsigned int i = 0; i < MatchedOutputQueues.size(); ++i) {
-      XrdMqMessageOut* Out = MatchedOutputQueues[i];
 
       // check for backlog on this queue and set a warning flag
       if (Out->nQueued > MaxQueueBacklog) {
@@ -199,21 +199,22 @@ XrdMqOfs::Deliver(XrdMqOfsMatches& Matches)
           ZTRACE(fsctl, "Adding Message to Queuename: " << Out->QueueName.c_str());
           // fprintf(stderr, "%s adding message %llu\n",
           // Out->QueueName.c_str(), (unsigned long long)Matches.message);
-          Out->MessageQueue.push_back((Matches.message));
           Matches.message->AddRefs(1);
+          Out->MessageQueue.Push(Matches.message);
           Out->nQueued++;
         }
       }
-    }
 
-    // Unlock all matched queues at once
-    for (unsigned int i = 0; i < MatchedOutputQueues.size(); ++i) {
-      XrdMqMessageOut* Out = MatchedOutputQueues[i];
       Out->UnLock();
     }
-  }
 
-  Matches.message->procmutex.UnLock();
+    if (Matches.matches) {
+      ReleaseMessage(Matches.message);
+    } else {
+      // nobody got it, the caller still owns the message
+      Matches.message->DecRefs();
+    }
+  }
 
   if (Matches.matches > 0) {
     return true;
@@ -222,39 +223,99 @@ XrdMqOfs::Deliver(XrdMqOfsMatches& Matches)
   }
 }
 
+//------------------------------------------------------------------------------
+// Drop one reference of a message and free it if it was the last one
+//------------------------------------------------------------------------------
+void
+XrdMqOfs::ReleaseMessage(XrdSmartOucEnv* message)
+{
+  if (message->DecRefs() > 0) {
+    return;
+  }
+
+  // we can delete this message from the queue!
+  XrdOucString msg = message->Get(XMQHEADER);
+  MessagesMutex.Lock();
+  Messages.erase(msg.c_str());
+  FanOutMessages++;
+  MessagesMutex.UnLock();
+  delete message;
+}
+
+//------------------------------------------------------------------------------
+// Move the delivered messages to the ones to be read
+//------------------------------------------------------------------------------
 size_t
 XrdMqMessageOut::RetrieveMessages()
 {
-  XrdSmartOucEnv* message;
+  size_t nretrieved = MessageQueue.Size();
 
-  while (MessageQueue.size()) {
-    message = MessageQueue.front();
-    MessageQueue.pop_front();
-    message->procmutex.Lock();
-    //    fprintf(stderr,"%llu %s Message %llu nref: %d\n", (unsigned long long) &MessageQueue, QueueName.c_str(), (unsigned long long) message, message->Refs());
+  while (!MessageQueue.Empty()) {
+    XrdSmartOucEnv* message = MessageQueue.Front();
+    MessageQueue.Pop();
     int len;
-    MessageBuffer += message->Env(len);
+    message->Env(len);
+    mRetrievedBytes += len;
+    mRetrieved.Push(message);
+  }
+
+  if (nretrieved) {
+    nQueued -= nretrieved;
     gMqFS->MessagesMutex.Lock();
-    gMqFS->DeliveredMessages++;
-    message->DecRefs();
-
-    if (message->Refs() <= 0) {
-      // we can delete this message from the queue!
-      XrdOucString msg = message->Get(XMQHEADER);
-      gMqFS->Messages.erase(msg.c_str());
-      message->procmutex.UnLock();
-      //      fprintf(stderr,"%s delete %llu \n", QueueName.c_str(), (unsigned long long) message);
-      delete message;
-      gMqFS->FanOutMessages++;
-    } else {
-      message->procmutex.UnLock();
+    gMqFS->DeliveredMessages += nretrieved;
+    gMqFS->MessagesMutex.UnLock();
+  }
+
+  return mRetrievedBytes;
+}
+
+//------------------------------------------------------------------------------
+// Copy retrieved messages into the buffer of a reader
+//------------------------------------------------------------------------------
+size_t
+XrdMqMessageOut::Read(char* buffer, size_t size)
+{
+  size_t nread = 0;
+
+  while ((nread < size) && !mRetrieved.Empty()) {
+    XrdSmartOucEnv* message = mRetrieved.Front();
+    int len;
+    const char* env = message->Env(len);
+    size_t ncopy = std::min(size - nread, (size_t) len - mReadOffset);
+
+    if (ncopy) {
+      memcpy(buffer + nread, env + mReadOffset, ncopy);
     }
 
-    nQueued--;
-    gMqFS->MessagesMutex.UnLock();
+    nread += ncopy;
+    mReadOffset += ncopy;
+
+    if (mReadOffset == (size_t) len) {
+      mRetrieved.Pop();
+      mReadOffset = 0;
+      gMqFS->ReleaseMessage(message);
+    }
+  }
+
+  mRetrievedBytes -= nread;
+  return nread;
+}
+
+//------------------------------------------------------------------------------
+// Drop all delivered and retrieved messages
+//------------------------------------------------------------------------------
+void
+XrdMqMessageOut::ReleaseMessages()
+{
+  RetrieveMessages();
+
+  while (!mRetrieved.Empty()) {
+    gMqFS->ReleaseMessage(mRetrieved.Front());
+    mRetrieved.Pop();
   }
 
-  return MessageBuffer.length();
+  mRetrievedBytes = 0;
+  mReadOffset = 0;
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -346,7 +407,7 @@ XrdMqOfs::FSctl(const int               cmd,
   XrdMqOfsMatches matches(mh.kReceiverQueue.c_str(), env, tident, mh.kType,
                           mh.kSenderId.c_str());
   {
-    XrdMqOfsOutMutex qm;
+    XrdMqRWMutexReadLock qm(QueueOutMutex);
     Deliver(matches);
   }
 
@@ -363,7 +424,7 @@ XrdMqOfs::FSctl(const int               cmd,
 
     TRACES(backlogmessage.c_str());
 
-    if (!matches.message->Refs()) {
+    if (!matches.matches) {
       delete env;
     }
 
@@ -0,0 +1,304 @@
+// ----------------------------------------------------------------------
+// File: XrdMqSharedHashCodec.cc
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "mq/XrdMqSharedHashCodec.hh"
+#include "mq/XrdMqMessage.hh"
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace
+{
+//------------------------------------------------------------------------------
+// Append an unsigned varint
+//------------------------------------------------------------------------------
+void
+PutVarint(std::string& out, uint64_t value)
+{
+  while (value >= 0x80) {
+    out += (char)((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+
+  out += (char) value;
+}
+
+//------------------------------------------------------------------------------
+// Read an unsigned varint
+//------------------------------------------------------------------------------
+bool
+GetVarint(const char*& ptr, const char* end, uint64_t& value)
+{
+  value = 0;
+
+  for (int shift = 0; (shift < 64) && (ptr < end); shift += 7) {
+    uint8_t byte = (uint8_t) * ptr++;
+    value |= (uint64_t)(byte & 0x7f) << shift;
+
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+inline uint64_t
+ZigZag(int64_t value)
+{
+  return ((uint64_t) value << 1) ^ (uint64_t)(value >> 63);
+}
+
+inline int64_t
+UnZigZag(uint64_t value)
+{
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+//------------------------------------------------------------------------------
+// Format a decimal given as mantissa and number of fractional digits
+//------------------------------------------------------------------------------
+std::string
+FormatDecimal(int64_t mantissa, uint8_t scale)
+{
+  uint64_t abs = (mantissa < 0) ? (0 - (uint64_t) mantissa) : mantissa;
+  std::string sdigits = std::to_string(abs);
+
+  if (sdigits.length() < (size_t) scale + 1) {
+    sdigits.insert(0, scale + 1 - sdigits.length(), '0');
+  }
+
+  std::string out = (mantissa < 0) ? "-" : "";
+  out += sdigits.substr(0, sdigits.length() - scale);
+  out += ".";
+  out += sdigits.substr(sdigits.length() - scale);
+  return out;
+}
+}
+
+//------------------------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------------------------
+XrdMqSharedHashCodec::XrdMqSharedHashCodec(): mCount(0)
+{
+  Reset();
+}
+
+//------------------------------------------------------------------------------
+// Drop all pairs added so far
+//------------------------------------------------------------------------------
+void
+XrdMqSharedHashCodec::Reset()
+{
+  mData.assign(1, (char) kVersion);
+  mLastKey.clear();
+  mCount = 0;
+}
+
+//------------------------------------------------------------------------------
+// Append a pair to the encoding
+//------------------------------------------------------------------------------
+void
+XrdMqSharedHashCodec::Add(const std::string& key, const std::string& value)
+{
+  size_t shared = 0;
+
+  while ((shared < key.length()) && (shared < mLastKey.length()) &&
+         (key[shared] == mLastKey[shared])) {
+    shared++;
+  }
+
+  PutVarint(mData, shared);
+  PutVarint(mData, key.length() - shared);
+  mData.append(key, shared, std::string::npos);
+  mLastKey = key;
+  int64_t number;
+  uint8_t scale;
+
+  if (ParseInteger(value, number)) {
+    mData += (char) kInteger;
+    PutVarint(mData, ZigZag(number));
+  } else if (ParseDecimal(value, number, scale)) {
+    mData += (char) kDecimal;
+    PutVarint(mData, ZigZag(number));
+    mData += (char) scale;
+  } else {
+    mData += (char) kString;
+    PutVarint(mData, value.length());
+    mData += value;
+  }
+
+  mCount++;
+}
+
+//------------------------------------------------------------------------------
+// Get the encoding as base64 string
+//------------------------------------------------------------------------------
+bool
+XrdMqSharedHashCodec::ToEnv(std::string& out) const
+{
+  return XrdMqMessage::Base64Encode(mData.c_str(), mData.size(), out);
+}
+
+//------------------------------------------------------------------------------
+// Decode a binary encoding
+//------------------------------------------------------------------------------
+bool
+XrdMqSharedHashCodec::Decode(const char* data, size_t length, pairs_t& pairs)
+{
+  const char* ptr = data;
+  const char* end = data + length;
+
+  if ((ptr == end) || (*ptr++ != (char) kVersion)) {
+    return false;
+  }
+
+  std::string key;
+
+  while (ptr < end) {
+    uint64_t shared, len;
+
+    if (!GetVarint(ptr, end, shared) || !GetVarint(ptr, end, len) ||
+        (shared > key.length()) || (len > (uint64_t)(end - ptr))) {
+      return false;
+    }
+
+    key.erase(shared);
+    key.append(ptr, len);
+    ptr += len;
+
+    if (ptr == end) {
+      return false;
+    }
+
+    char type = *ptr++;
+    uint64_t value;
+
+    if (!GetVarint(ptr, end, value)) {
+      return false;
+    }
+
+    if (type == kInteger) {
+      char number[32];
+      snprintf(number, sizeof(number), "%lld", (long long) UnZigZag(value));
+      pairs.push_back(std::make_pair(key, std::string(number)));
+    } else if (type == kDecimal) {
+      if ((ptr == end) || ((uint8_t) * ptr > 18)) {
+        return false;
+      }
+
+      uint8_t scale = (uint8_t) * ptr++;
+      pairs.push_back(std::make_pair(key, FormatDecimal(UnZigZag(value), scale)));
+    } else if (type == kString) {
+      if (value > (uint64_t)(end - ptr)) {
+        return false;
+      }
+
+      pairs.push_back(std::make_pair(key, std::string(ptr, value)));
+      ptr += value;
+    } else {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Decode a base64 string created by ToEnv
+//------------------------------------------------------------------------------
+bool
+XrdMqSharedHashCodec::FromEnv(const char* encoded, pairs_t& pairs)
+{
+  char* data = 0;
+  ssize_t length = 0;
+
+  if (!encoded || !XrdMqMessage::Base64Decode(encoded, data, length)) {
+    return false;
+  }
+
+  bool retc = (length > 0) && Decode(data, length, pairs);
+  free(data);
+  return retc;
+}
+
+//------------------------------------------------------------------------------
+// Parse a value which can be typed as integer
+//------------------------------------------------------------------------------
+bool
+XrdMqSharedHashCodec::ParseInteger(const std::string& value, int64_t& number)
+{
+  size_t start = (!value.empty() && (value[0] == '-')) ? 1 : 0;
+
+  if ((value.length() == start) || (value.length() > start + 18)) {
+    return false;
+  }
+
+  for (size_t i = start; i < value.length(); ++i) {
+    if ((value[i] < '0') || (value[i] > '9')) {
+      return false;
+    }
+  }
+
+  number = strtoll(value.c_str(), 0, 10);
+  char canonical[32];
+  snprintf(canonical, sizeof(canonical), "%lld", (long long) number);
+  return (value == canonical);
+}
+
+//------------------------------------------------------------------------------
+// Parse a value which can be typed as decimal
+//------------------------------------------------------------------------------
+bool
+XrdMqSharedHashCodec::ParseDecimal(const std::string& value, int64_t& mantissa,
+                                   uint8_t& scale)
+{
+  size_t dot = value.find('.');
+
+  if ((dot == std::string::npos) || (dot + 1 == value.length())) {
+    return false;
+  }
+
+  // the integer check would reject leading zeros like in "0.05"
+  std::string digits = value.substr(0, dot) + value.substr(dot + 1);
+  size_t start = (!digits.empty() && (digits[0] == '-')) ? 1 : 0;
+
+  if ((digits.length() == start) || (digits.length() > start + 18)) {
+    return false;
+  }
+
+  for (size_t i = start; i < digits.length(); ++i) {
+    if ((digits[i] < '0') || (digits[i] > '9')) {
+      return false;
+    }
+  }
+
+  int64_t number = strtoll(digits.c_str(), 0, 10);
+  uint8_t nscale = value.length() - dot - 1;
+
+  if (FormatDecimal(number, nscale) != value) {
+    return false;
+  }
+
+  mantissa = number;
+  scale = nscale;
+  return true;
+}
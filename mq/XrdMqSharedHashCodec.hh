@@ -0,0 +1,167 @@
+// ----------------------------------------------------------------------
+// File: XrdMqSharedHashCodec.hh
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef __XRDMQ_SHAREDHASHCODEC_HH__
+#define __XRDMQ_SHAREDHASHCODEC_HH__
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//! Class XrdMqSharedHashCodec - compact binary encoding of the key/value pairs
+//! of a shared hash transaction, used instead of the "|key~value%cid" env
+//! encoding when binary framing is enabled.
+//!
+//! The encoding starts with a version byte followed by one record per pair:
+//!
+//!   varint shared   - length of the prefix shared with the previous key
+//!   varint length   - length of the rest of the key
+//!   bytes  suffix   - rest of the key
+//!   byte   type     - kString, kInteger or kDecimal
+//!   value           - kString : varint length + bytes
+//!                     kInteger: zigzag varint
+//!                     kDecimal: zigzag varint mantissa + byte scale
+//!
+//! Numeric values are only typed if the decoded string is identical to the
+//! original one, e.g. "007" or "-0.0" are sent as strings. The change ids are
+//! not sent since receivers assign their own.
+//------------------------------------------------------------------------------
+class XrdMqSharedHashCodec
+{
+public:
+  typedef std::vector<std::pair<std::string, std::string>> pairs_t;
+
+  enum {
+    kVersion = 1
+  };
+
+  enum type_t {
+    kString = 0,
+    kInteger = 1,
+    kDecimal = 2
+  };
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //----------------------------------------------------------------------------
+  XrdMqSharedHashCodec();
+
+  //----------------------------------------------------------------------------
+  //! Append a pair to the encoding
+  //!
+  //! @param key entry key
+  //! @param value entry value
+  //----------------------------------------------------------------------------
+  void Add(const std::string& key, const std::string& value);
+
+  //----------------------------------------------------------------------------
+  //! Drop all pairs added so far
+  //----------------------------------------------------------------------------
+  void Reset();
+
+  //----------------------------------------------------------------------------
+  //! Get number of pairs added
+  //----------------------------------------------------------------------------
+  inline size_t Count() const
+  {
+    return mCount;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get size of the binary encoding
+  //----------------------------------------------------------------------------
+  inline size_t Size() const
+  {
+    return mData.size();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get binary encoding
+  //----------------------------------------------------------------------------
+  inline const std::string& Data() const
+  {
+    return mData;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the encoding as base64 string which can be embedded in an env message
+  //!
+  //! @param out output base64 string
+  //!
+  //! @return true if successful, otherwise false
+  //----------------------------------------------------------------------------
+  bool ToEnv(std::string& out) const;
+
+  //----------------------------------------------------------------------------
+  //! Decode a binary encoding
+  //!
+  //! @param data encoded data
+  //! @param length length of the encoded data
+  //! @param pairs decoded pairs are appended here
+  //!
+  //! @return true if successful, false if the encoding is corrupted or has an
+  //!         unknown version
+  //----------------------------------------------------------------------------
+  static bool Decode(const char* data, size_t length, pairs_t& pairs);
+
+  //----------------------------------------------------------------------------
+  //! Decode a base64 string created by ToEnv
+  //!
+  //! @param encoded base64 string
+  //! @param pairs decoded pairs are appended here
+  //!
+  //! @return true if successful, otherwise false
+  //----------------------------------------------------------------------------
+  static bool FromEnv(const char* encoded, pairs_t& pairs);
+
+  //----------------------------------------------------------------------------
+  //! Parse a value which can be typed as integer
+  //!
+  //! @param value value string
+  //! @param number parsed number
+  //!
+  //! @return true if the value is the canonical representation of an int64
+  //----------------------------------------------------------------------------
+  static bool ParseInteger(const std::string& value, int64_t& number);
+
+  //----------------------------------------------------------------------------
+  //! Parse a value which can be typed as decimal
+  //!
+  //! @param value value string
+  //! @param mantissa value without the decimal point
+  //! @param scale number of digits after the decimal point
+  //!
+  //! @return true if the value is the canonical representation of the
+  //!         mantissa and scale
+  //----------------------------------------------------------------------------
+  static bool ParseDecimal(const std::string& value, int64_t& mantissa,
+                           uint8_t& scale);
+
+private:
+  std::string mData; ///< Binary encoding
+  std::string mLastKey; ///< Previous key added
+  size_t mCount; ///< Number of pairs added
+};
+
+#endif
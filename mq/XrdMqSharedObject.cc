@@ -24,6 +24,7 @@
 #include "mq/XrdMqSharedObject.hh"
 #include "mq/XrdMqMessaging.hh"
 #include "mq/XrdMqStringConversion.hh"
+#include "mq/XrdMqSharedHashCodec.hh"
 #include "common/Logging.hh"
 #include "XrdSys/XrdSysTimer.hh"
 #include "XrdOuc/XrdOucEnv.hh"
@@ -34,6 +35,30 @@
 
 std::atomic<bool> XrdMqSharedObjectManager::sDebug { false };
 bool XrdMqSharedObjectManager::sBroadcast = true;
+bool XrdMqSharedObjectManager::sBinaryFraming =
+  (getenv("EOS_MQ_BINARY_FRAMING") &&
+   !strcmp(getenv("EOS_MQ_BINARY_FRAMING"), "1"));
+time_t XrdMqSharedObjectManager::sDeltaRefresh = 60;
+
+//------------------------------------------------------------------------------
+// Add the pairs encoded so far as binary env message and reset the codec
+//------------------------------------------------------------------------------
+static void
+FlushCodec(const XrdOucString& header, XrdMqSharedHashCodec& codec,
+           std::vector<std::string>& out)
+{
+  std::string encoded;
+
+  if (codec.Count() && codec.ToEnv(encoded)) {
+    out.push_back(header.c_str());
+    out.back() += "&";
+    out.back() += XRDMQSHAREDHASH_BINPAIRS;
+    out.back() += "=";
+    out.back() += encoded;
+  }
+
+  codec.Reset();
+}
 
 // Static counters
 std::atomic<unsigned long long> XrdMqSharedHash::sSetCounter {0};
@@ -181,7 +206,8 @@ XrdMqSharedHash::XrdMqSharedHash(const char* subject, const char* bcast_queue,
                                  XrdMqSharedObjectManager* som):
   mType("hash"), mSOM(som), mSubject((subject ? subject : "")),
   mIsTransaction(false), mBroadcastQueue((bcast_queue ? bcast_queue : "")),
-  mTransactMutex(new XrdSysMutex()), mStoreMutex(new XrdMqRWMutex())
+  mTransactMutex(new XrdSysMutex()), mStoreMutex(new XrdMqRWMutex()),
+  mLastSentMutex(new XrdSysMutex())
 {}
 
 //------------------------------------------------------------------------------
@@ -203,6 +229,7 @@ XrdMqSharedHash::operator=(XrdMqSharedHash&& other)
     mSOM = nullptr;
     mTransactMutex.reset(nullptr);
     mStoreMutex.reset(nullptr);
+    mLastSentMutex.reset(nullptr);
     mType = other.mType;
     std::swap(mSOM, other.mSOM);
     mSubject = other.mSubject;
@@ -213,6 +240,8 @@ XrdMqSharedHash::operator=(XrdMqSharedHash&& other)
     std::swap(mTransactions, other.mTransactions);
     std::swap(mTransactMutex, other.mTransactMutex);
     std::swap(mStoreMutex, other.mStoreMutex);
+    std::swap(mLastSent, other.mLastSent);
+    std::swap(mLastSentMutex, other.mLastSentMutex);
   }
 
   return *this;
@@ -393,7 +422,21 @@ XrdMqSharedHash::CloseTransaction()
 {
   bool retval = true;
 
-  if (XrdMqSharedObjectManager::sBroadcast && mTransactions.size()) {
+  if (XrdMqSharedObjectManager::sBroadcast && mTransactions.size() &&
+      XrdMqSharedObjectManager::sBinaryFraming) {
+    XrdOucString header = "";
+    std::vector<std::string> txmessages;
+    MakeUpdateEnvHeader(header);
+    AddTransactionsToBinStrings(header, txmessages, true, false);
+
+    for (auto it = txmessages.begin(); it != txmessages.end(); ++it) {
+      XrdMqMessage message("XrdMqSharedHashMessage");
+      message.SetBody(it->c_str());
+      message.MarkAsMonitor();
+      retval &= XrdMqMessaging::gMessageClient.SendMessage(message,
+                mBroadcastQueue.c_str(), false, false, true);
+    }
+  } else if (XrdMqSharedObjectManager::sBroadcast && mTransactions.size()) {
     XrdOucString txmessage = "";
     MakeUpdateEnvHeader(txmessage);
     AddTransactionsToEnvString(txmessage, false);
@@ -524,9 +567,10 @@ XrdMqSharedHash::MakeRemoveEnvHeader(XrdOucString& out)
 // Broadcast hash as env string
 //-------------------------------------------------------------------------------
 bool
-XrdMqSharedHash::BroadCastEnvString(const char* receiver)
+XrdMqSharedHash::BroadCastEnvString(const char* receiver, bool binary)
 {
   XrdOucString txmessage = "";
+  std::vector<std::string> txmessages;
   {
     XrdSysMutexHelper lock(*mTransactMutex);
     mTransactions.clear();
@@ -539,23 +583,42 @@ XrdMqSharedHash::BroadCastEnvString(const char* receiver)
       }
     }
     MakeBroadCastEnvHeader(txmessage);
+
     // This will also clear the mTransactions set
-    AddTransactionsToEnvString(txmessage);
+    if (binary) {
+      AddTransactionsToBinStrings(txmessage, txmessages, false);
+
+      // Only the first message clears the hash of the receiver, the following
+      // ones are plain updates
+      for (size_t i = 1; i < txmessages.size(); ++i) {
+        txmessages[i].replace(0, strlen(XRDMQSHAREDHASH_BCREPLY),
+                              XRDMQSHAREDHASH_UPDATE);
+      }
+    } else {
+      AddTransactionsToEnvString(txmessage);
+      txmessages.push_back(txmessage.c_str());
+    }
+
     mIsTransaction = false;
   }
 
   if (XrdMqSharedObjectManager::sBroadcast) {
-    XrdMqMessage message("XrdMqSharedHashMessage");
-    message.SetBody(txmessage.c_str());
-    message.MarkAsMonitor();
+    bool retval = true;
 
     if (XrdMqSharedObjectManager::sDebug) {
       fprintf(stderr, "XrdMqSharedObjectManager::BroadCastEnvString=>[%s]=>%s \n",
               mSubject.c_str(), receiver);
     }
 
-    return XrdMqMessaging::gMessageClient.SendMessage(message, receiver, false,
-           false, true);
+    for (auto it = txmessages.begin(); it != txmessages.end(); ++it) {
+      XrdMqMessage message("XrdMqSharedHashMessage");
+      message.SetBody(it->c_str());
+      message.MarkAsMonitor();
+      retval &= XrdMqMessaging::gMessageClient.SendMessage(message, receiver,
+                false, false, true);
+    }
+
+    return retval;
   }
 
   return true;
@@ -593,6 +656,72 @@ XrdMqSharedHash::AddTransactionsToEnvString(XrdOucString& out, bool clear_after)
   }
 }
 
+//-------------------------------------------------------------------------------
+// Encode transactions as binary env strings - this must be called with the
+// mTransactMutex locked.
+//-------------------------------------------------------------------------------
+void
+XrdMqSharedHash::AddTransactionsToBinStrings(const XrdOucString& header,
+    std::vector<std::string>& out, bool delta, bool clear_after)
+{
+  XrdMqSharedHashCodec codec;
+  time_t now = time(NULL);
+  {
+    XrdMqRWMutexReadLock rd_lock(*mStoreMutex);
+
+    for (auto it = mTransactions.begin(); it != mTransactions.end(); ++it) {
+      auto entry = mStore.find(*it);
+
+      if (entry == mStore.end()) {
+        continue;
+      }
+
+      const std::string value = entry->second.GetValue();
+
+      if (delta && !IsDelta(*it, value, now)) {
+        continue;
+      }
+
+      codec.Add(*it, value);
+
+      // Keep every message below 1M before the base64 encoding
+      if (codec.Size() > (1000 * 1000)) {
+        FlushCodec(header, codec, out);
+      }
+    }
+  }
+  FlushCodec(header, codec, out);
+
+  if (clear_after) {
+    mTransactions.clear();
+  }
+}
+
+//-------------------------------------------------------------------------------
+// Check if a value has to be broadcast with delta updates
+//-------------------------------------------------------------------------------
+bool
+XrdMqSharedHash::IsDelta(const std::string& key, const std::string& value,
+                         time_t now)
+{
+  XrdSysMutexHelper lock(*mLastSentMutex);
+  auto it = mLastSent.find(key);
+
+  if (it == mLastSent.end()) {
+    mLastSent.insert(std::make_pair(key, std::make_pair(value, now)));
+    return true;
+  }
+
+  if ((it->second.first == value) &&
+      ((now - it->second.second) < XrdMqSharedObjectManager::sDeltaRefresh)) {
+    return false;
+  }
+
+  it->second.first = value;
+  it->second.second = now;
+  return true;
+}
+
 //-------------------------------------------------------------------------------
 // Encode deletions as env string - this must be called with the mTransactMutex
 // locked.
@@ -634,6 +763,12 @@ XrdMqSharedHash::BroadcastRequest(const char* req_target)
   out += XRDMQSHAREDHASH_TYPE;
   out += "=";
   out += mType.c_str();
+  // Announce that the reply can use the binary encoding, older versions
+  // ignore this tag
+  out += "&";
+  out += XRDMQSHAREDHASH_CAPS;
+  out += "=";
+  out += XRDMQSHAREDHASH_CAPS_BIN;
   message.SetBody(out.c_str());
   message.MarkAsMonitor();
   return XrdMqMessaging::gMessageClient.SendMessage(message, req_target, false,
@@ -670,6 +805,11 @@ XrdMqSharedHash::Delete(const std::string& key, bool broadcast)
   if (mStore.count(key)) {
     mStore.erase(key);
     deleted = true;
+    {
+      // A later update with the same value must be broadcast again
+      XrdSysMutexHelper lock(*mLastSentMutex);
+      mLastSent.erase(key);
+    }
 
     if (XrdMqSharedObjectManager::sBroadcast && broadcast) {
       // Emulate transaction for single shot deletions
@@ -698,12 +838,8 @@ XrdMqSharedHash::Delete(const std::string& key, bool broadcast)
                 mSubject.c_str(), key.c_str());
       }
 
-      XrdMqSharedObjectManager::Notification event(fkey,
-          XrdMqSharedObjectManager::kMqSubjectKeyDeletion);
-      mSOM->mSubjectsMutex.Lock();
-      mSOM->NotificationSubjects.push_back(event);
-      mSOM->SubjectsSem.Post();
-      mSOM->mSubjectsMutex.UnLock();
+      mSOM->PostNotification(XrdMqSharedObjectManager::Notification(fkey,
+                             XrdMqSharedObjectManager::kMqSubjectKeyDeletion));
     }
   }
 
@@ -729,6 +865,8 @@ XrdMqSharedHash::Clear(bool broadcast)
   }
 
   mStore.clear();
+  XrdSysMutexHelper lock(*mLastSentMutex);
+  mLastSent.clear();
 }
 
 //-------------------------------------------------------------------------------
@@ -746,6 +884,14 @@ XrdMqSharedHash::SetImpl(const char* key, const char* value, bool broadcast)
     } else {
       mStore[skey] = XrdMqSharedHashEntry(key, value);
     }
+
+    if (!broadcast) {
+      // The value was updated by another node e.g. via ParseEnvMessage, so
+      // the value we sent last is no longer the current one and setting it
+      // again must be broadcast
+      XrdSysMutexHelper lock(*mLastSentMutex);
+      mLastSent.erase(skey);
+    }
   }
 
   if (XrdMqSharedObjectManager::sBroadcast && broadcast) {
@@ -792,11 +938,8 @@ XrdMqSharedHash::SetImpl(const char* key, const char* value, bool broadcast)
               mSubject.c_str(), skey.c_str(), value);
     }
 
-    XrdSysMutexHelper lock(mSOM->mSubjectsMutex);
-    XrdMqSharedObjectManager::Notification event
-    (fkey, XrdMqSharedObjectManager::kMqSubjectModification);
-    mSOM->NotificationSubjects.push_back(event);
-    mSOM->SubjectsSem.Post();
+    mSOM->PostNotification(XrdMqSharedObjectManager::Notification(fkey,
+                           XrdMqSharedObjectManager::kMqSubjectModification));
   }
 
   return true;
@@ -1581,6 +1724,7 @@ XrdMqSharedObjectChangeNotifier::StartNotifyKey(Subscriber* subscriber,
     XrdMqSharedObjectChangeNotifier::notification_t type)
 {
   XrdSysMutexHelper lock(WatchMutex);
+  mWatchDirty = true;
   return (WatchKeys2Subscribers[type][key].mSubscribers.insert(
             subscriber)).second;
 }
@@ -1592,6 +1736,7 @@ XrdMqSharedObjectChangeNotifier::StartNotifyKeyRegex(Subscriber* subscriber,
     XrdMqSharedObjectChangeNotifier::notification_t type)
 {
   XrdSysMutexHelper lock(WatchMutex);
+  mWatchDirty = true;
   bool res = (WatchKeys2Subscribers[type][key].mSubscribers.insert(
                 subscriber)).second;
 
@@ -1617,6 +1762,7 @@ XrdMqSharedObjectChangeNotifier::StopNotifyKey(Subscriber* subscriber,
     XrdMqSharedObjectChangeNotifier::notification_t type)
 {
   XrdSysMutexHelper lock(WatchMutex);
+  mWatchDirty = true;
   _NotifierMapUpdate(WatchKeys2Subscribers[type], key, subscriber);
   return true;
 }
@@ -1628,6 +1774,7 @@ XrdMqSharedObjectChangeNotifier::StopNotifyKeyRegex(Subscriber* subscriber,
     XrdMqSharedObjectChangeNotifier::notification_t type)
 {
   XrdSysMutexHelper lock(WatchMutex);
+  mWatchDirty = true;
   _NotifierMapUpdate(WatchKeys2Subscribers[type], key, subscriber);
   return true;
 }
@@ -1639,6 +1786,7 @@ XrdMqSharedObjectChangeNotifier::StartNotifySubject(Subscriber* subscriber,
     XrdMqSharedObjectChangeNotifier::notification_t type)
 {
   XrdSysMutexHelper lock(WatchMutex);
+  mWatchDirty = true;
   return (WatchSubjects2Subscribers[type][subject].mSubscribers.insert(
             subscriber)).second;
 }
@@ -1650,10 +1798,11 @@ XrdMqSharedObjectChangeNotifier::StartNotifySubjectRegex(Subscriber* subscriber,
     XrdMqSharedObjectChangeNotifier::notification_t type)
 {
   XrdSysMutexHelper lock(WatchMutex);
+  mWatchDirty = true;
   bool res = (WatchSubjects2Subscribers[type][subject].mSubscribers.insert(
                 subscriber)).second;
 
-  if (WatchSubjects2Subscribers[type][subject].mRegex) {
+  if (WatchSubjects2Subscribers[type][subject].mRegex == NULL) {
     regex_t* r = new regex_t;
 
     if (regcomp(r, subject.c_str(), REG_NOSUB)) {
@@ -1675,6 +1824,7 @@ XrdMqSharedObjectChangeNotifier::StopNotifySubject(Subscriber* subscriber,
     XrdMqSharedObjectChangeNotifier::notification_t type)
 {
   XrdSysMutexHelper lock(WatchMutex);
+  mWatchDirty = true;
   _NotifierMapUpdate(WatchSubjects2Subscribers[type], subject, subscriber);
   return true;
 }
@@ -1686,6 +1836,7 @@ XrdMqSharedObjectChangeNotifier::StopNotifySubjectRegex(Subscriber* subscriber,
     XrdMqSharedObjectChangeNotifier::notification_t type)
 {
   XrdSysMutexHelper lock(WatchMutex);
+  mWatchDirty = true;
   _NotifierMapUpdate(WatchSubjects2Subscribers[type], subject, subscriber);
   return true;
 }
@@ -1742,6 +1893,7 @@ XrdMqSharedObjectChangeNotifier::StartNotifySubjectsAndKeys(
 
   bool insertIntoExisiting = false;
   XrdSysMutexHelper lock(WatchMutex);
+  mWatchDirty = true;
 
   for (auto it = WatchSubjectsXKeys2Subscribers[type].begin();
        it != WatchSubjectsXKeys2Subscribers[type].end(); ++it) {
@@ -1880,6 +2032,7 @@ XrdMqSharedObjectChangeNotifier::StopNotifySubjectsAndKeys(
   bool removedAll = false;
   // secondly update the global vector
   XrdSysMutexHelper lock(WatchMutex);
+  mWatchDirty = true;
 
   for (auto it = WatchSubjectsXKeys2Subscribers[type].begin();
        it != WatchSubjectsXKeys2Subscribers[type].end(); ++it) {
@@ -2010,6 +2163,7 @@ XrdMqSharedObjectChangeNotifier::StartNotifyCurrentThread()
     XrdSysMutexHelper lock1(tlSubscriber->WatchMutex);
     {
       XrdSysMutexHelper lock2(WatchMutex);
+      mWatchDirty = true;
 
       for (int type = 0; type < 5; type++) {
         for (auto it = tlSubscriber->WatchKeys[type].begin();
@@ -2089,6 +2243,7 @@ XrdMqSharedObjectChangeNotifier::StopNotifyCurrentThread()
     XrdSysMutexHelper lock1(tlSubscriber->WatchMutex);
     {
       XrdSysMutexHelper lock2(WatchMutex);
+      mWatchDirty = true;
 
       for (int type = 0; type < 5; type++) {
         for (auto it = tlSubscriber->WatchKeys[type].begin();
@@ -2153,206 +2308,209 @@ XrdMqSharedObjectChangeNotifier::SomListener()
   do {
     SOM->SubjectsSem.Wait();
     XrdSysThread::SetCancelOff();
-    // we always take a lock to take something from the queue and then release it
-    WatchMutex.Lock();
-    SOM->mSubjectsMutex.Lock();
-    std::set<Subscriber*> notifiedSubscribers;
-
-    while (SOM->NotificationSubjects.size()) {
-      XrdMqSharedObjectManager::Notification event;
-      event = SOM->NotificationSubjects.front();
-      SOM->NotificationSubjects.pop_front();
-      SOM->mSubjectsMutex.UnLock();
-      std::string newsubject = event.mSubject;
-      //eos_static_debug("SOM Listener new notification %d on %s",
-      // event.mType,event.mSubject.c_str());
-      int type = static_cast<int>(event.mType);
-      std::set<Subscriber*> notifiedSubscribersForCurrentEvent;
-      std::string key = newsubject;
-      std::string queue = newsubject;
-      size_t dpos = 0;
-
-      if ((dpos = queue.find(";")) != std::string::npos) {
-        key.erase(0, dpos + 1);
-        queue.erase(dpos);
-      }
+    // take all the queued notifications at once, so the producers never wait
+    // for the matching
+    std::deque<XrdMqSharedObjectManager::Notification> events;
+    {
+      XrdSysMutexHelper lock(SOM->mSubjectsMutex);
+      events.swap(SOM->NotificationSubjects);
+    }
 
-      // these are useful only if type == 4
-      std::string newVal;
-      bool newValAsserted = false;
-      bool isNewVal = false;
-
-      do {
-        // Check if there is a matching key
-        for (auto it = WatchKeys2Subscribers[type].begin();
-             it != WatchKeys2Subscribers[type].end(); ++it) {
-          if (((it->second.mRegex == NULL) && (key == it->first)) ||
-              ((it->second.mRegex != NULL) &&
-               !regexec(it->second.mRegex, key.c_str(), 0, NULL, 0))) {
-            if (type == 4) {
-              if (!newValAsserted) {
-                auto lvIt = LastValues.find(newsubject);
-                SOM->HashMutex.LockRead();
-                XrdMqSharedHash* hash = SOM->GetObject(queue.c_str(), "hash");
-                SOM->HashMutex.UnLockRead();
-
-                if (hash) {
-                  newVal = hash->Get(key.c_str());
-
-                  if (lvIt == LastValues.end() || lvIt->second != newVal) {
-                    isNewVal = true;
-                  }
-
-                  newValAsserted = true;
-                } else {
-                  continue;
-                }
-              }
+    if (events.size()) {
+      std::map<Subscriber*, std::vector<XrdMqSharedObjectManager::Notification>>
+          pending;
+      {
+        XrdSysMutexHelper lock(WatchMutex);
 
-              if (isNewVal) {
-                // eos_static_debug("notification on %s : new value %s IS a"
-                // "strict change",newsubject.c_str(),newVal.c_str());
-                LastValues[newsubject] = newVal;
-              } else {
-                //eos_static_debug("notification on %s : new value %s IS NOT"
-                //" a strict change",newsubject.c_str(),newVal.c_str());
-                continue;
-              }
-            }
+        if (mWatchDirty) {
+          BuildWatchIndex();
+        }
 
-            for (auto it2 = it->second.mSubscribers.begin();
-                 it2 != it->second.mSubscribers.end(); ++it2) {
-              (*it2)->SubjectsMutex.Lock();
-              (*it2)->NotificationSubjects.push_back(event);
-              (*it2)->SubjectsMutex.UnLock();
-              notifiedSubscribersForCurrentEvent.insert(*it2);
-              notifiedSubscribers.insert(*it2);
-            }
-          }
+        for (auto it = events.begin(); it != events.end(); ++it) {
+          Dispatch(*it, pending);
         }
+      }
 
-        // Check if there is a matching subject
-        for (auto it = WatchSubjects2Subscribers[type].begin();
-             it != WatchSubjects2Subscribers[type].end(); ++it) {
-          if (((it->second.mRegex == NULL) && (queue == it->first)) ||
-              ((it->second.mRegex != NULL) &&
-               !regexec(it->second.mRegex, queue.c_str(), 0, NULL, 0))) {
-            if (type == 4) {
-              if (!newValAsserted) {
-                auto lvIt = LastValues.find(newsubject);
-                SOM->HashMutex.LockRead();
-                XrdMqSharedHash* hash = SOM->GetObject(queue.c_str(), "hash");
-                SOM->HashMutex.UnLockRead();
-
-                if (hash) {
-                  newVal = hash->Get(key.c_str());
-
-                  if (lvIt == LastValues.end() || lvIt->second != newVal) {
-                    isNewVal = true;
-                  }
-
-                  newValAsserted = true;
-                }
-              }
+      // hand over the notifications of a batch with a single lock per
+      // subscriber and wake up all subscriber threads
+      for (auto it = pending.begin(); it != pending.end(); ++it) {
+        {
+          XrdSysMutexHelper lock(it->first->SubjectsMutex);
+          it->first->NotificationSubjects.insert(
+            it->first->NotificationSubjects.end(), it->second.begin(),
+            it->second.end());
+        }
+        it->first->SubjectsSem.Post();
+      }
+    }
 
-              if (isNewVal) {
-                // eos_static_debug("notification on %s : new value %s IS a "
-                // "strict change",newsubject.c_str(),newVal.c_str());
-                LastValues[newsubject] = newVal;
-              } else {
-                //eos_static_debug("notification on %s : new value %s IS NOT "
-                // "a strict change",newsubject.c_str(),newVal.c_str());
-                continue;
-              }
-            }
+    XrdSysThread::SetCancelOn();
+  } while (true);
+}
 
-            for (auto it2 = it->second.mSubscribers.begin();
-                 it2 != it->second.mSubscribers.end(); ++it2) {
-              if (notifiedSubscribersForCurrentEvent.count(*it2) == 0) {
-                // Don't notify twice for the same event
-                (*it2)->SubjectsMutex.Lock();
-                (*it2)->NotificationSubjects.push_back(event);
-                (*it2)->SubjectsMutex.UnLock();
-                notifiedSubscribersForCurrentEvent.insert(*it2);
-                notifiedSubscribers.insert(*it2);
-              }
-            }
-          } else {
-            // eos_static_info("regex %s DID NOT MATCH %s",it->first.c_str(),
-            // queue.c_str());
-          }
-        }
+/*----------------------------------------------------------------------------*/
+void
+XrdMqSharedObjectChangeNotifier::BuildWatchIndex()
+{
+  for (int type = 0; type < 5; ++type) {
+    WatchIndex& index = mWatchIndex[type];
+    index = WatchIndex();
 
-        // Check if there is a matching subjectXkey
-        for (auto it = WatchSubjectsXKeys2Subscribers[type].begin();
-             it != WatchSubjectsXKeys2Subscribers[type].end(); ++it) {
-          if (it->first.first.count(queue) && it->first.second.count(key)) {
-            if (type == 4) {
-              if (!newValAsserted) {
-                auto lvIt = LastValues.find(newsubject);
-                SOM->HashMutex.LockRead();
-                XrdMqSharedHash* hash = SOM->GetObject(queue.c_str(), "hash");
-                SOM->HashMutex.UnLockRead();
-
-                if (hash) {
-                  newVal = hash->Get(key.c_str());
-
-                  if (lvIt == LastValues.end() || lvIt->second != newVal) {
-                    isNewVal = true;
-                  }
-
-                  newValAsserted = true;
-                } else {
-                  continue;
-                }
-              }
+    for (auto it = WatchKeys2Subscribers[type].begin();
+         it != WatchKeys2Subscribers[type].end(); ++it) {
+      std::vector<Subscriber*> subscribers(it->second.mSubscribers.begin(),
+                                           it->second.mSubscribers.end());
 
-              if (isNewVal) {
-                //if(key=="id") {
-                // eos_static_warning("WARNING ID CHANGE in queue %s FROM %s "
-                // "to %s",queue.c_str(),LastValues[newsubject].c_str(),newVal.c_str());
-                //}
-                LastValues[newsubject] = newVal;
-              } else {
-                // eos_static_info("notification on %s : new value %s IS NOT "
-                // "a strict change",newsubject.c_str(),newVal.c_str());
-                continue;
-              }
-            }
+      if (it->second.mRegex) {
+        index.mKeysRegex.emplace_back(it->second.mRegex, subscribers);
+      } else {
+        index.mKeys[it->first] = subscribers;
+      }
+    }
 
-            for (auto it2 = it->second.begin(); it2 != it->second.end(); ++it2) {
-              if (notifiedSubscribersForCurrentEvent.count(*it2) == 0) {
-                // Don't notify twice for the same event
-                (*it2)->SubjectsMutex.Lock();
-                (*it2)->NotificationSubjects.push_back(event);
-                (*it2)->SubjectsMutex.UnLock();
-                notifiedSubscribersForCurrentEvent.insert(*it2);
-                notifiedSubscribers.insert(*it2);
-              }
-            }
-          }
-        }
+    for (auto it = WatchSubjects2Subscribers[type].begin();
+         it != WatchSubjects2Subscribers[type].end(); ++it) {
+      std::vector<Subscriber*> subscribers(it->second.mSubscribers.begin(),
+                                           it->second.mSubscribers.end());
 
-        if (type == 2) {
-          // If it's a modification, check also the strict modifications to be notified
-          type = 4;
-        } else {
-          break;
-        }
-      } while (true);
+      if (it->second.mRegex) {
+        index.mSubjectsRegex.emplace_back(it->second.mRegex, subscribers);
+      } else {
+        index.mSubjects[it->first] = subscribers;
+      }
+    }
+
+    for (size_t i = 0; i < WatchSubjectsXKeys2Subscribers[type].size(); ++i) {
+      const std::set<std::string>& keys =
+        WatchSubjectsXKeys2Subscribers[type][i].first.second;
 
-      SOM->mSubjectsMutex.Lock();
+      for (auto it = keys.begin(); it != keys.end(); ++it) {
+        index.mXKeys[*it].push_back(i);
+      }
     }
+  }
+
+  mWatchDirty = false;
+}
 
-    // wake up all subscriber threads
-    for (auto it = notifiedSubscribers.begin();
-         it != notifiedSubscribers.end(); ++it) {
-      (*it)->SubjectsSem.Post();
+/*----------------------------------------------------------------------------*/
+void
+XrdMqSharedObjectChangeNotifier::Match(int type, const std::string& queue,
+                                       const std::string& key,
+                                       std::vector<Subscriber*>& matched)
+{
+  WatchIndex& index = mWatchIndex[type];
+  auto it = index.mKeys.find(key);
+
+  if (it != index.mKeys.end()) {
+    matched.insert(matched.end(), it->second.begin(), it->second.end());
+  }
+
+  for (auto rit = index.mKeysRegex.begin(); rit != index.mKeysRegex.end();
+       ++rit) {
+    if (!regexec(rit->first, key.c_str(), 0, NULL, 0)) {
+      matched.insert(matched.end(), rit->second.begin(), rit->second.end());
     }
+  }
 
-    SOM->mSubjectsMutex.UnLock();
-    WatchMutex.UnLock();
-    XrdSysThread::SetCancelOn();
+  it = index.mSubjects.find(queue);
+
+  if (it != index.mSubjects.end()) {
+    matched.insert(matched.end(), it->second.begin(), it->second.end());
+  }
+
+  for (auto rit = index.mSubjectsRegex.begin();
+       rit != index.mSubjectsRegex.end(); ++rit) {
+    if (!regexec(rit->first, queue.c_str(), 0, NULL, 0)) {
+      matched.insert(matched.end(), rit->second.begin(), rit->second.end());
+    }
+  }
+
+  auto xit = index.mXKeys.find(key);
+
+  if (xit != index.mXKeys.end()) {
+    for (auto nit = xit->second.begin(); nit != xit->second.end(); ++nit) {
+      auto& entry = WatchSubjectsXKeys2Subscribers[type][*nit];
+
+      if (entry.first.first.count(queue)) {
+        matched.insert(matched.end(), entry.second.begin(), entry.second.end());
+      }
+    }
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+bool
+XrdMqSharedObjectChangeNotifier::IsStrictChange(const std::string& subject,
+    const std::string& queue, const std::string& key)
+{
+  XrdMqSharedHash* hash = 0;
+  {
+    XrdMqRWMutexReadLock lock(SOM->HashMutex);
+    hash = SOM->GetObject(queue.c_str(), "hash");
+  }
+
+  if (!hash) {
+    return false;
+  }
+
+  std::string value = hash->Get(key.c_str());
+  auto it = LastValues.find(subject);
+
+  if ((it != LastValues.end()) && (it->second == value)) {
+    return false;
+  }
+
+  LastValues[subject] = value;
+  return true;
+}
+
+/*----------------------------------------------------------------------------*/
+void
+XrdMqSharedObjectChangeNotifier::Dispatch(
+  const XrdMqSharedObjectManager::Notification& event,
+  std::map<Subscriber*, std::vector<XrdMqSharedObjectManager::Notification>>&
+  pending)
+{
+  int type = static_cast<int>(event.mType);
+
+  if ((type < 0) || (type >= kMqSubjectStrictModification)) {
+    return;
+  }
+
+  std::string key = event.mSubject;
+  std::string queue = event.mSubject;
+  size_t dpos = 0;
+
+  if ((dpos = queue.find(";")) != std::string::npos) {
+    key.erase(0, dpos + 1);
+    queue.erase(dpos);
+  }
+
+  std::set<Subscriber*> notified;
+  std::vector<Subscriber*> matched;
+
+  do {
+    matched.clear();
+    Match(type, queue, key, matched);
+
+    // strict modifications are only notified if the value actually changed
+    if (matched.size() && ((type != kMqSubjectStrictModification) ||
+                           IsStrictChange(event.mSubject, queue, key))) {
+      for (auto it = matched.begin(); it != matched.end(); ++it) {
+        // Don't notify twice for the same event
+        if (notified.insert(*it).second) {
+          pending[*it].push_back(event);
+        }
+      }
+    }
+
+    if (type == kMqSubjectModification) {
+      // If it's a modification, check also the strict modifications to be notified
+      type = kMqSubjectStrictModification;
+    } else {
+      break;
+    }
   } while (true);
 }
 
@@ -2428,6 +2586,23 @@ XrdMqSharedObjectManager::~XrdMqSharedObjectManager()
   }
 }
 
+//------------------------------------------------------------------------------
+// Queue a notification for the change notifier
+//------------------------------------------------------------------------------
+void
+XrdMqSharedObjectManager::PostNotification(const Notification& event)
+{
+  XrdSysMutexHelper lock(mSubjectsMutex);
+  // The listener drains the whole queue once woken up, so it only needs to be
+  // woken up for the first notification of an empty queue
+  bool wakeup = NotificationSubjects.empty();
+  NotificationSubjects.push_back(event);
+
+  if (wakeup) {
+    SubjectsSem.Post();
+  }
+}
+
 //----------------------------------------------------------------------------
 // Create requested shared object type
 //----------------------------------------------------------------------------
@@ -2472,10 +2647,7 @@ XrdMqSharedObjectManager::CreateSharedHash(const char* subject,
     HashMutex.UnLockWrite();
 
     if (mEnableQueue) {
-      mSubjectsMutex.Lock();
-      NotificationSubjects.push_back(event);
-      mSubjectsMutex.UnLock();
-      SubjectsSem.Post();
+      PostNotification(event);
     }
 
     return true;
@@ -2502,10 +2674,7 @@ XrdMqSharedObjectManager::CreateSharedQueue(const char* subject,
     HashMutex.UnLockWrite();
 
     if (mEnableQueue) {
-      mSubjectsMutex.Lock();
-      NotificationSubjects.push_back(event);
-      mSubjectsMutex.UnLock();
-      SubjectsSem.Post();
+      PostNotification(event);
     }
 
     return true;
@@ -2557,10 +2726,7 @@ XrdMqSharedObjectManager::DeleteSharedHash(const char* subject, bool broadcast)
     HashMutex.UnLockWrite();
 
     if (mEnableQueue) {
-      mSubjectsMutex.Lock();
-      NotificationSubjects.push_back(event);
-      mSubjectsMutex.UnLock();
-      SubjectsSem.Post();
+      PostNotification(event);
     }
 
     return true;
@@ -2594,10 +2760,7 @@ XrdMqSharedObjectManager::DeleteSharedQueue(const char* subject, bool broadcast)
     HashMutex.UnLockWrite();
 
     if (mEnableQueue) {
-      mSubjectsMutex.Lock();
-      NotificationSubjects.push_back(event);
-      mSubjectsMutex.UnLock();
-      SubjectsSem.Post();
+      PostNotification(event);
     }
 
     return true;
@@ -2955,51 +3118,66 @@ XrdMqSharedObjectManager::ParseEnvMessage(XrdMqMessage* message,
       // from here on we have a read lock on 'sh'
 
       if ((ftag == XRDMQSHAREDHASH_UPDATE) || (ftag == XRDMQSHAREDHASH_BCREPLY)) {
-        std::string val = (env.Get(XRDMQSHAREDHASH_PAIRS) ? env.Get(
-                             XRDMQSHAREDHASH_PAIRS) : "");
+        XrdMqSharedHashCodec::pairs_t pairs;
 
-        if (val.length() == 0) {
-          error = "no pairs in message body";
-          return false;
-        }
+        if (env.Get(XRDMQSHAREDHASH_BINPAIRS)) {
+          if (!XrdMqSharedHashCodec::FromEnv(env.Get(XRDMQSHAREDHASH_BINPAIRS),
+                                             pairs) || pairs.empty()) {
+            error = "update: parsing error in binary pairs tag";
+            return false;
+          }
+        } else {
+          std::string val = (env.Get(XRDMQSHAREDHASH_PAIRS) ? env.Get(
+                               XRDMQSHAREDHASH_PAIRS) : "");
 
-        if ((ftag == XRDMQSHAREDHASH_BCREPLY) && sh) {
-          // we don't have to broad cast this clear => it is a broad cast reply
-          sh->Clear(false);
-        }
+          if (val.length() == 0) {
+            error = "no pairs in message body";
+            return false;
+          }
 
-        std::string key;
-        std::string value;
-        std::string cid;
-        std::vector<int> keystart;
-        std::vector<int> valuestart;
-        std::vector<int> cidstart;
+          std::vector<int> keystart;
+          std::vector<int> valuestart;
+          std::vector<int> cidstart;
 
-        for (unsigned int i = 0; i < val.length(); i++) {
-          if (val.c_str()[i] == '|') {
-            keystart.push_back(i);
+          for (unsigned int i = 0; i < val.length(); i++) {
+            if (val.c_str()[i] == '|') {
+              keystart.push_back(i);
+            }
+
+            if (val.c_str()[i] == '~') {
+              valuestart.push_back(i);
+            }
+
+            if (val.c_str()[i] == '%') {
+              cidstart.push_back(i);
+            }
           }
 
-          if (val.c_str()[i] == '~') {
-            valuestart.push_back(i);
+          if (keystart.size() != valuestart.size()) {
+            error = "update: parsing error in pairs tag";
+            return false;
           }
 
-          if (val.c_str()[i] == '%') {
-            cidstart.push_back(i);
+          if (keystart.size() != cidstart.size()) {
+            error = "update: parsing error in pairs tag";
+            return false;
           }
-        }
 
-        if (keystart.size() != valuestart.size()) {
-          error = "update: parsing error in pairs tag";
-          return false;
+          // the change ids are not used by the receiver
+          for (unsigned int i = 0; i < keystart.size(); i++) {
+            pairs.push_back(std::make_pair(
+                              val.substr(keystart[i] + 1, valuestart[i] - 1 - (keystart[i])),
+                              val.substr(valuestart[i] + 1, cidstart[i] - 1 - (valuestart[i]))));
+          }
         }
 
-        if (keystart.size() != cidstart.size()) {
-          error = "update: parsing error in pairs tag";
-          return false;
+        if ((ftag == XRDMQSHAREDHASH_BCREPLY) && sh) {
+          // we don't have to broad cast this clear => it is a broad cast reply
+          sh->Clear(false);
         }
 
-        int parseindex = 0;
+        std::string key;
+        unsigned int parseindex = 0;
 
         for (size_t s = 0; s < subjectlist.size(); s++) {
           sh = GetObject(subjectlist[s].c_str(), type.c_str());
@@ -3009,17 +3187,9 @@ XrdMqSharedObjectManager::ParseEnvMessage(XrdMqMessage* message,
             return false;
           }
 
-          std::string sstr;
-
-          for (unsigned int i = parseindex; i < keystart.size(); i++) {
-            key.assign(val, keystart[i] + 1, valuestart[i] - 1 - (keystart[i]));
-            value.assign(val, valuestart[i] + 1, cidstart[i] - 1 - (valuestart[i]));
-
-            if (i == (keystart.size() - 1)) {
-              cid.assign(val, cidstart[i] + 1, val.length() - cidstart[i] - 1);
-            } else {
-              cid.assign(val, cidstart[i] + 1, keystart[i + 1] - 1 - (cidstart[i]));
-            }
+          for (unsigned int i = parseindex; i < pairs.size(); i++) {
+            key = pairs[i].first;
+            const std::string& value = pairs[i].second;
 
             if (sDebug) {
               fprintf(stderr,
@@ -3065,6 +3235,9 @@ XrdMqSharedObjectManager::ParseEnvMessage(XrdMqMessage* message,
 
       if (ftag == XRDMQSHAREDHASH_BCREQUEST) {
         bool success = true;
+        // Reply with the binary encoding if the requester understands it
+        bool binary = (env.Get(XRDMQSHAREDHASH_CAPS) &&
+                       strstr(env.Get(XRDMQSHAREDHASH_CAPS), XRDMQSHAREDHASH_CAPS_BIN));
 
         for (unsigned int l = 0; l < subjectlist.size(); l++) {
           // try 'queue' and 'hash' to have wildcard broadcasts for both
@@ -3075,7 +3248,7 @@ XrdMqSharedObjectManager::ParseEnvMessage(XrdMqMessage* message,
           }
 
           if (sh) {
-            success *= sh->BroadCastEnvString(reply.c_str());
+            success *= sh->BroadCastEnvString(reply.c_str(), binary);
           }
         }
 
@@ -3164,7 +3337,20 @@ XrdMqSharedObjectManager::CloseMuxTransaction()
   // no deletions of subjects
   XrdSysMutexHelper mLock(MuxTransactionsMutex);
 
-  if (MuxTransactions.size()) {
+  if (MuxTransactions.size() && sBinaryFraming) {
+    XrdOucString header = "";
+    std::vector<std::string> txmessages;
+    MakeMuxUpdateEnvHeader(header);
+    AddMuxTransactionBinStrings(header, txmessages);
+
+    for (auto it = txmessages.begin(); it != txmessages.end(); ++it) {
+      XrdMqMessage message("XrdMqSharedHashMessage");
+      message.SetBody(it->c_str());
+      message.MarkAsMonitor();
+      XrdMqMessaging::gMessageClient.SendMessage(message,
+          MuxTransactionBroadCastQueue.c_str(), false, false, true);
+    }
+  } else if (MuxTransactions.size()) {
     XrdOucString txmessage = "";
     MakeMuxUpdateEnvHeader(txmessage);
     AddMuxTransactionEnvString(txmessage);
@@ -3256,6 +3442,55 @@ XrdMqSharedObjectManager::AddMuxTransactionEnvString(XrdOucString& out)
   }
 }
 
+//------------------------------------------------------------------------------
+// Encode the multiplexed transactions as binary env strings
+//------------------------------------------------------------------------------
+void
+XrdMqSharedObjectManager::AddMuxTransactionBinStrings(
+  const XrdOucString& header, std::vector<std::string>& out)
+{
+  XrdMqSharedHashCodec codec;
+  time_t now = time(NULL);
+  size_t index = 0;
+
+  for (auto it_subj = MuxTransactions.begin(); it_subj != MuxTransactions.end();
+       ++it_subj) {
+    std::string prefix = "#" + std::to_string(index++) + "#";
+    XrdMqSharedHash* hash = GetObject(it_subj->first.c_str(),
+                                      MuxTransactionType.c_str());
+
+    if (!hash) {
+      continue;
+    }
+
+    XrdMqRWMutexReadLock lock(*(hash->mStoreMutex));
+
+    for (auto it = it_subj->second.begin(); it != it_subj->second.end(); ++it) {
+      auto entry = hash->mStore.find(*it);
+
+      if (entry == hash->mStore.end()) {
+        continue;
+      }
+
+      const std::string value = entry->second.GetValue();
+
+      if (!hash->IsDelta(*it, value, now)) {
+        continue;
+      }
+
+      // the subject is a prefix to the key as #<subject-index>#
+      codec.Add(prefix + *it, value);
+
+      // Keep every message below 1M before the base64 encoding
+      if (codec.Size() > (1000 * 1000)) {
+        FlushCodec(header, codec, out);
+      }
+    }
+  }
+
+  FlushCodec(header, codec, out);
+}
+
 
 //-------------------------------------------------------------------------------
 //
@@ -35,6 +35,7 @@
 #include <vector>
 #include <set>
 #include <deque>
+#include <unordered_map>
 #include <regex.h>
 #include <atomic>
 
@@ -50,6 +51,9 @@
 #define XRDMQSHAREDHASH_KEYS      "mqsh.keys"
 #define XRDMQSHAREDHASH_REPLY     "mqsh.reply"
 #define XRDMQSHAREDHASH_TYPE      "mqsh.type"
+#define XRDMQSHAREDHASH_BINPAIRS  "mqsh.bin"
+#define XRDMQSHAREDHASH_CAPS      "mqsh.caps"
+#define XRDMQSHAREDHASH_CAPS_BIN  "bin"
 
 //! Forward declaration
 class XrdMqSharedObjectManager;
@@ -455,6 +459,9 @@ private:
   mTransactMutex; ///< Mutex protecting the set of transactions
   std::unique_ptr<XrdMqRWMutex>
   mStoreMutex; ///< RW Mutex protecting the mStore object
+  //! Last value and time broadcast per key with binary framing
+  std::map<std::string, std::pair<std::string, time_t>> mLastSent;
+  std::unique_ptr<XrdSysMutex> mLastSentMutex; ///< Mutex protecting mLastSent
 
   //----------------------------------------------------------------------------
   //! Construct broadcast env header
@@ -492,6 +499,31 @@ private:
   //----------------------------------------------------------------------------
   void AddTransactionsToEnvString(XrdOucString& out, bool clearafter = true);
 
+  //----------------------------------------------------------------------------
+  //! Encode transactions as binary env strings
+  //!
+  //! @param header message header
+  //! @param out output messages, each one below the message size limit
+  //! @param delta if true skip the values which were already broadcast
+  //! @param clear_after if true clear transactions afterward, otherwise not
+  //----------------------------------------------------------------------------
+  void AddTransactionsToBinStrings(const XrdOucString& header,
+                                   std::vector<std::string>& out, bool delta,
+                                   bool clear_after = true);
+
+  //----------------------------------------------------------------------------
+  //! Check if a value has to be broadcast with delta updates i.e. it differs
+  //! from the last value broadcast or this one is older than the refresh
+  //! interval. The value is recorded as broadcast if true is returned.
+  //!
+  //! @param key entry key
+  //! @param value entry value
+  //! @param now current time
+  //!
+  //! @return true if value has to be broadcast, otherwise false
+  //----------------------------------------------------------------------------
+  bool IsDelta(const std::string& key, const std::string& value, time_t now);
+
   //----------------------------------------------------------------------------
   //! Encode deletions as env string
   //!
@@ -503,10 +535,11 @@ private:
   //! Broadcast hash as env string
   //!
   //! @param receiver target of the broadcast message
+  //! @param binary if true use the binary encoding understood by the receiver
   //!
   //! @return true if message sent successful, otherwise false
   //----------------------------------------------------------------------------
-  bool BroadCastEnvString(const char* receiver);
+  bool BroadCastEnvString(const char* receiver, bool binary = false);
 };
 
 
@@ -625,6 +658,8 @@ private:
 public:
   static std::atomic<bool> sDebug; ///< Set debug mode
   static bool sBroadcast; ///< Set broadcasting mode
+  static bool sBinaryFraming; ///< Send updates with the binary encoding
+  static time_t sDeltaRefresh; ///< Max age of unchanged values not broadcast
 
   //----------------------------------------------------------------------------
   //! Constructor
@@ -687,6 +722,20 @@ public:
     return sBroadcast;
   }
 
+  //----------------------------------------------------------------------------
+  //! En-/disable the binary encoding of updates. Only changed values are
+  //! broadcast and unchanged ones are refreshed every sDeltaRefresh seconds.
+  //! All the receivers have to understand the binary encoding, therefore it
+  //! is disabled by default unless EOS_MQ_BINARY_FRAMING=1 is set. Broadcast
+  //! replies always use the encoding announced by the requester.
+  //!
+  //! @param enable if true enable binary encoding, otherwise disable
+  //----------------------------------------------------------------------------
+  static void EnableBinaryFraming(bool enable)
+  {
+    sBinaryFraming = enable;
+  }
+
   //----------------------------------------------------------------------------
   //!
   //----------------------------------------------------------------------------
@@ -844,7 +893,24 @@ public:
   //----------------------------------------------------------------------------
   void AddMuxTransactionEnvString(XrdOucString& out);
 
+  //----------------------------------------------------------------------------
+  //! Encode the multiplexed transactions as binary env strings with delta
+  //! updates
+  //!
+  //! @param header message header
+  //! @param out output messages, each one below the message size limit
+  //----------------------------------------------------------------------------
+  void AddMuxTransactionBinStrings(const XrdOucString& header,
+                                   std::vector<std::string>& out);
+
 protected:
+  //----------------------------------------------------------------------------
+  //! Queue a notification for the change notifier
+  //!
+  //! @param event notification
+  //----------------------------------------------------------------------------
+  void PostNotification(const Notification& event);
+
   XrdSysMutex MuxTransactionsMutex; ///< protects the mux transaction map
   std::string MuxTransactionType; ///<
   std::string MuxTransactionBroadCastQueue;
@@ -956,7 +1022,7 @@ public:
   //! Constructor
   //----------------------------------------------------------------------------
   XrdMqSharedObjectChangeNotifier():
-    SOM(0), tid(0) {}
+    SOM(0), mWatchDirty(true), tid(0) {}
 
   //----------------------------------------------------------------------------
   //! Destructor
@@ -1035,6 +1101,7 @@ public:
   bool Stop();
 
 private:
+  friend class XrdMqChangeNotifierTest;
   XrdMqSharedObjectManager* SOM;
 
   struct WatchItemInfo {
@@ -1055,6 +1122,51 @@ private:
   //!  listof((Subjects,Keys),Subscribers)
   std::map<std::string, std::string> LastValues;
 
+  //! Watch items of one notification type compiled for matching: exact keys
+  //! and subjects are looked up, only the regular expressions are evaluated
+  struct WatchIndex {
+    std::unordered_map<std::string, std::vector<Subscriber*>> mKeys;
+    std::unordered_map<std::string, std::vector<Subscriber*>> mSubjects;
+    std::vector<std::pair<regex_t*, std::vector<Subscriber*>>> mKeysRegex;
+    std::vector<std::pair<regex_t*, std::vector<Subscriber*>>> mSubjectsRegex;
+    //! Entries of WatchSubjectsXKeys2Subscribers by key
+    std::unordered_map<std::string, std::vector<size_t>> mXKeys;
+  };
+
+  WatchIndex mWatchIndex[5]; ///< Compiled watch items by notification type
+  bool mWatchDirty; ///< Watch items changed since the index was compiled
+
+  //----------------------------------------------------------------------------
+  //! Compile the watch items - requires the WatchMutex
+  //----------------------------------------------------------------------------
+  void BuildWatchIndex();
+
+  //----------------------------------------------------------------------------
+  //! Collect the subscribers watching a key - requires the WatchMutex
+  //!
+  //! @param type notification type
+  //! @param queue subject of the notification
+  //! @param key key of the notification
+  //! @param matched matching subscribers are appended, maybe more than once
+  //----------------------------------------------------------------------------
+  void Match(int type, const std::string& queue, const std::string& key,
+             std::vector<Subscriber*>& matched);
+
+  //----------------------------------------------------------------------------
+  //! Check if a modification changed the value last notified as strict
+  //! modification and record the new value
+  //----------------------------------------------------------------------------
+  bool IsStrictChange(const std::string& subject, const std::string& queue,
+                      const std::string& key);
+
+  //----------------------------------------------------------------------------
+  //! Add a notification to the pending notifications of all the matching
+  //! subscribers - requires the WatchMutex
+  //----------------------------------------------------------------------------
+  void Dispatch(const XrdMqSharedObjectManager::Notification& event,
+                std::map<Subscriber*,
+                std::vector<XrdMqSharedObjectManager::Notification>>& pending);
+
   pthread_t tid; //< Thread ID of the dispatching change thread
   void SomListener();
   static void* StartSomListener(void* pp);
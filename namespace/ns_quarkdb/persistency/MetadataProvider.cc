@@ -29,8 +29,8 @@
 #include "namespace/MDException.hh"
 #include "namespace/ns_quarkdb/BackendClient.hh"
 #include "common/Assert.hh"
+#include "common/ThreadPoolExecutor.hh"
 #include <functional>
-#include <folly/executors/IOThreadPoolExecutor.h>
 
 using std::placeholders::_1;
 
@@ -43,7 +43,7 @@ MetadataProvider::MetadataProvider(const QdbContactDetails& contactDetails,
                                    IContainerMDSvc* contsvc, IFileMDSvc* filesvc)
   : mContSvc(contsvc), mFileSvc(filesvc), mContainerCache(3e6), mFileCache(3e7)
 {
-  mExecutor.reset(new folly::IOThreadPoolExecutor(16));
+  mExecutor.reset(new eos::common::ThreadPoolExecutor(16, 16, "md_provider"));
 
   for (size_t i = 0; i < kQClientPoolSize; i++) {
     mQclPool.emplace_back(eos::BackendClient::getInstance
@@ -0,0 +1,92 @@
+//------------------------------------------------------------------------------
+//! @file HeavyHittersTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "Namespace.hh"
+#include "common/HeavyHitters.hh"
+#include <map>
+
+EOSCOMMONTESTING_BEGIN
+
+using eos::common::HeavyHitters;
+
+TEST(HeavyHitters, ExactBelowCapacity)
+{
+  HeavyHitters hh(10);
+
+  for (int i = 0; i < 5; ++i) {
+    for (int j = 0; j <= i; ++j) {
+      hh.Add(std::to_string(i), 1, 100);
+    }
+  }
+
+  ASSERT_EQ(5u, hh.Size());
+  ASSERT_EQ(0u, hh.MaxError());
+  auto top = hh.Top(3);
+  ASSERT_EQ(3u, top.size());
+  ASSERT_EQ("4", top[0].mKey);
+  ASSERT_EQ(5u, top[0].mCount);
+  ASSERT_EQ(0u, top[0].mError);
+  ASSERT_EQ(500u, top[0].mAux);
+  ASSERT_EQ("3", top[1].mKey);
+  ASSERT_EQ("2", top[2].mKey);
+  ASSERT_EQ(5u, hh.Top(100).size());
+  hh.Clear();
+  ASSERT_EQ(0u, hh.Size());
+  ASSERT_EQ(0u, hh.Total());
+}
+
+TEST(HeavyHitters, ErrorBound)
+{
+  const size_t capacity = 64;
+  HeavyHitters hh(capacity);
+  std::map<std::string, uint64_t> exact;
+  uint64_t seed = 42;
+
+  // Skewed stream: a few hot keys within a long tail of cold keys
+  for (int i = 0; i < 200000; ++i) {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    std::string key = ((seed >> 33) % 4) ? std::to_string((seed >> 40) % 20000) :
+                      "hot" + std::to_string((seed >> 40) % 8);
+    uint64_t weight = 1 + (seed >> 60);
+    hh.Add(key, weight);
+    exact[key] += weight;
+  }
+
+  ASSERT_EQ(capacity, hh.Size());
+  ASSERT_LE(hh.MaxError(), hh.Total() / capacity);
+
+  for (const auto& entry : hh.Top(capacity)) {
+    ASSERT_GE(entry.mCount, exact[entry.mKey]);
+    ASSERT_LE(entry.mCount - entry.mError, exact[entry.mKey]);
+    ASSERT_LE(entry.mError, hh.Total() / capacity);
+  }
+
+  // All the hot keys are guaranteed to be found and ranked first
+  auto top = hh.Top(8);
+
+  for (const auto& entry : top) {
+    ASSERT_EQ(0u, entry.mKey.find("hot"));
+  }
+}
+
+EOSCOMMONTESTING_END
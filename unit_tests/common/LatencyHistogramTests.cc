@@ -0,0 +1,92 @@
+//------------------------------------------------------------------------------
+// File: LatencyHistogramTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "Namespace.hh"
+#include "common/LatencyHistogram.hh"
+
+EOSCOMMONTESTING_BEGIN
+
+using eos::common::LatencyHistogram;
+using eos::common::LatencyWindows;
+
+TEST(LatencyHistogram, BucketIndex)
+{
+  int prev = -1;
+
+  // Indices are monotonic and every value falls in its own bucket range
+  for (uint64_t val = 0; val < (1ull << 20); val += 7) {
+    int idx = LatencyHistogram::BucketIndex(val);
+    ASSERT_GE(idx, prev);
+    ASSERT_LE(LatencyHistogram::BucketLow(idx), val);
+    ASSERT_GT(LatencyHistogram::BucketLow(idx + 1), val);
+    prev = idx;
+  }
+
+  ASSERT_EQ(LatencyHistogram::sNumBins - 1,
+            LatencyHistogram::BucketIndex(1ull << 40));
+}
+
+TEST(LatencyHistogram, Percentile)
+{
+  LatencyHistogram hist;
+  ASSERT_EQ(0, hist.Percentile(0.5));
+
+  for (uint64_t val = 1; val <= 10000; ++val) {
+    hist.Add(val);
+  }
+
+  ASSERT_EQ(10000u, hist.Count());
+  // Relative error is bounded by the sub-bucket resolution
+  double err = 1.0 / LatencyHistogram::sSubBuckets;
+  ASSERT_NEAR(5000, hist.Percentile(0.5), 5000 * err);
+  ASSERT_NEAR(9000, hist.Percentile(0.9), 9000 * err);
+  ASSERT_NEAR(9900, hist.Percentile(0.99), 9900 * err);
+  ASSERT_NEAR(9990, hist.Percentile(0.999), 9990 * err);
+  LatencyHistogram other;
+  other.Add(1000000, 10000);
+  hist.Merge(other);
+  ASSERT_EQ(20000u, hist.Count());
+  ASSERT_NEAR(1000000, hist.Percentile(0.99), 1000000 * err);
+}
+
+TEST(LatencyHistogram, Windows)
+{
+  LatencyWindows windows;
+  LatencyHistogram hist;
+  hist.Add(100, 10);
+  time_t now = 1000000;
+  windows.Add(hist, now);
+  ASSERT_EQ(10u, windows.Get(LatencyWindows::k5s, now).Count());
+  ASSERT_EQ(10u, windows.Get(LatencyWindows::k3600s, now).Count());
+  // After 10 seconds the sample left the 5s window only
+  windows.Add(hist, now + 10);
+  ASSERT_EQ(10u, windows.Get(LatencyWindows::k5s, now + 10).Count());
+  ASSERT_EQ(20u, windows.Get(LatencyWindows::k60s, now + 10).Count());
+  ASSERT_EQ(20u, windows.Get(LatencyWindows::k3600s, now + 10).Count());
+  // After two hours everything is gone
+  ASSERT_EQ(0u, windows.Get(LatencyWindows::k3600s, now + 7200).Count());
+  windows.Clear();
+  ASSERT_EQ(0u, windows.Get(LatencyWindows::k60s, now + 10).Count());
+}
+
+EOSCOMMONTESTING_END
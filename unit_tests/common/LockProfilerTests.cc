@@ -0,0 +1,164 @@
+//------------------------------------------------------------------------------
+// File: LockProfilerTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "common/LockProfiler.hh"
+#include "common/RWMutex.hh"
+#include <thread>
+
+using eos::common::LockProfiler;
+
+namespace
+{
+//------------------------------------------------------------------------------
+// Sum the statistics of the sites of a lock taken at the given line
+//------------------------------------------------------------------------------
+LockProfiler::SiteStats
+GetSite(const std::string& lock, int line)
+{
+  LockProfiler::SiteStats sum;
+  sum.mLine = 0;
+  sum.mAcquired = sum.mContended = sum.mHoldN = 0;
+
+  for (auto& st : LockProfiler::GetInstance().GetStats()) {
+    if ((st.mLock == lock) && (st.mLine == line)) {
+      sum = st;
+    }
+  }
+
+  return sum;
+}
+}
+
+//------------------------------------------------------------------------------
+// Contended and uncontended acquisitions of a RWMutex
+//------------------------------------------------------------------------------
+TEST(LockProfiler, RWMutexContention)
+{
+  LockProfiler::SetEnabled(true);
+  eos::common::RWMutex mutex;
+  mutex.SetBlocking(true);
+  mutex.SetDebugName("profiler_rwmutex");
+  int line = 0;
+
+  for (int i = 0; i < 100; ++i) {
+    eos::common::RWMutexReadLock rd_lock(mutex); line = __LINE__;
+  }
+
+  LockProfiler::SiteStats st = GetSite("profiler_rwmutex", line);
+  ASSERT_EQ(100u, st.mAcquired);
+  ASSERT_EQ(0u, st.mContended);
+  ASSERT_FALSE(st.mWrite);
+  ASSERT_NE(std::string::npos, st.mFile.find("LockProfilerTests.cc"));
+  ASSERT_EQ("TestBody", st.mFunction);
+  // Every 64th uncontended acquisition has its hold time measured
+  ASSERT_GE(st.mHoldN, 1u);
+  mutex.LockWrite();
+  std::thread t([&]() {
+    eos::common::RWMutexWriteLock wr_lock(mutex); line = __LINE__;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  mutex.UnLockWrite();
+  t.join();
+  st = GetSite("profiler_rwmutex", line);
+  ASSERT_EQ(1u, st.mAcquired);
+  ASSERT_EQ(1u, st.mContended);
+  ASSERT_TRUE(st.mWrite);
+  ASSERT_EQ(1u, st.mHoldN);
+  ASSERT_GE(st.mWaitSum, 40000u);
+  ASSERT_GE(st.mWait.Percentile(0.5), 40000.0);
+  std::string out;
+  LockProfiler::GetInstance().Print(out);
+  ASSERT_NE(std::string::npos, out.find("profiler_rwmutex"));
+  ASSERT_NE(std::string::npos, out.find("LockProfilerTests.cc:" +
+                                        std::to_string(line)));
+  LockProfiler::GetInstance().Reset();
+  st = GetSite("profiler_rwmutex", line);
+  ASSERT_EQ(0u, st.mAcquired);
+  ASSERT_EQ(0u, st.mContended);
+}
+
+//------------------------------------------------------------------------------
+// Contended acquisition of a XrdSysMutex through the helper
+//------------------------------------------------------------------------------
+TEST(LockProfiler, MutexHelper)
+{
+  LockProfiler::SetEnabled(true);
+  XrdSysMutex mutex;
+  int line = 0;
+  mutex.Lock();
+  std::thread t([&]() {
+    eos::common::ProfiledMutexHelper lock(mutex, "profiler_mutex"); line = __LINE__;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  mutex.UnLock();
+  t.join();
+  LockProfiler::SiteStats st = GetSite("profiler_mutex", line);
+  ASSERT_EQ(1u, st.mAcquired);
+  ASSERT_EQ(1u, st.mContended);
+  ASSERT_GE(st.mWaitSum, 10000u);
+  // Disabled profiling records nothing
+  LockProfiler::SetEnabled(false);
+
+  for (int i = 0; i < 10; ++i) {
+    eos::common::ProfiledMutexHelper lock(mutex, "profiler_mutex"); line = __LINE__;
+  }
+
+  LockProfiler::SetEnabled(true);
+  ASSERT_EQ(0u, GetSite("profiler_mutex", line).mAcquired);
+}
+
+//------------------------------------------------------------------------------
+// Call sites registered concurrently by several threads get a single id
+//------------------------------------------------------------------------------
+TEST(LockProfiler, ConcurrentRegistration)
+{
+  LockProfiler::SetEnabled(true);
+  XrdSysMutex mutex;
+  int line1 = 0, line2 = 0;
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < 100; ++i) {
+        {
+          eos::common::ProfiledMutexHelper lock(mutex, "profiler_reg"); line1 = __LINE__;
+        }
+        eos::common::ProfiledMutexHelper lock(mutex, "profiler_reg"); line2 = __LINE__;
+      }
+    });
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  ASSERT_EQ(400u, GetSite("profiler_reg", line1).mAcquired);
+  ASSERT_EQ(400u, GetSite("profiler_reg", line2).mAcquired);
+  size_t num_sites = 0;
+
+  for (auto& st : LockProfiler::GetInstance().GetStats()) {
+    num_sites += (st.mLock == "profiler_reg");
+  }
+
+  ASSERT_EQ(2u, num_sites);
+}
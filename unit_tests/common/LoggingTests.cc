@@ -0,0 +1,221 @@
+//------------------------------------------------------------------------------
+// File: LoggingTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "common/Logging.hh"
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+int gEvaluated = 0;
+
+//------------------------------------------------------------------------------
+// Expensive log argument like a metadata dump
+//------------------------------------------------------------------------------
+std::string Dump()
+{
+  gEvaluated++;
+  return std::string(256, 'x');
+}
+}
+
+//------------------------------------------------------------------------------
+// Messages logged asynchronously end up in the log memory in thread order
+//------------------------------------------------------------------------------
+TEST(Logging, AsyncLogMemory)
+{
+  eos::common::Logging& g_logging = eos::common::Logging::GetInstance();
+  g_logging.SetLogPriority(LOG_NOTICE);
+  g_logging.SetAsync(true);
+  unsigned long start_idx;
+  {
+    XrdSysMutexHelper scope_lock(g_logging.gMutex);
+    start_idx = g_logging.gLogCircularIndex[LOG_NOTICE];
+  }
+  const int nthreads = 4;
+  const int nmsg = 100;
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < nthreads; ++t) {
+    threads.emplace_back([t]() {
+      for (int i = 0; i < nmsg; ++i) {
+        std::string rptr = eos_static_notice("async thread=%d msg=%03d", t, i);
+        std::string expected = SSTR("thread=" << t << " msg=");
+        ASSERT_NE(std::string::npos, rptr.find(expected));
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  g_logging.SetAsync(false);
+  XrdSysMutexHelper scope_lock(g_logging.gMutex);
+  ASSERT_EQ(start_idx + nthreads * nmsg,
+            g_logging.gLogCircularIndex[LOG_NOTICE]);
+  std::vector<int> last(nthreads, -1);
+
+  for (unsigned long idx = start_idx; idx < start_idx + nthreads * nmsg; ++idx) {
+    std::string line = g_logging.gLogMemory[LOG_NOTICE]
+                       [idx % g_logging.gCircularIndexSize].c_str();
+    int t, i;
+    size_t pos = line.find("async thread=");
+    ASSERT_NE(std::string::npos, pos);
+    ASSERT_EQ(2, sscanf(line.c_str() + pos, "async thread=%d msg=%d", &t, &i));
+    ASSERT_EQ(last[t] + 1, i);
+    last[t] = i;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Messages of different threads are written in the order they were logged
+//------------------------------------------------------------------------------
+TEST(Logging, AsyncCrossThreadOrder)
+{
+  eos::common::Logging& g_logging = eos::common::Logging::GetInstance();
+  g_logging.SetLogPriority(LOG_NOTICE);
+  g_logging.SetAsync(true);
+  unsigned long start_idx;
+  {
+    XrdSysMutexHelper scope_lock(g_logging.gMutex);
+    start_idx = g_logging.gLogCircularIndex[LOG_NOTICE];
+  }
+  const int nmsg = 200;
+  std::atomic<int> turn(0);
+  std::vector<std::thread> threads;
+
+  // the two threads log alternately, each waits for the message of the other
+  for (int t = 0; t < 2; ++t) {
+    threads.emplace_back([t, &turn]() {
+      for (int i = t; i < nmsg; i += 2) {
+        while (turn.load() != i) {
+          std::this_thread::yield();
+        }
+
+        eos_static_notice("ordered msg=%03d", i);
+        turn++;
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  g_logging.SetAsync(false);
+  XrdSysMutexHelper scope_lock(g_logging.gMutex);
+  ASSERT_EQ(start_idx + nmsg, g_logging.gLogCircularIndex[LOG_NOTICE]);
+
+  for (unsigned long idx = start_idx; idx < start_idx + nmsg; ++idx) {
+    std::string line = g_logging.gLogMemory[LOG_NOTICE]
+                       [idx % g_logging.gCircularIndexSize].c_str();
+    std::string expected = SSTR("ordered msg=" << std::setw(3) << std::setfill('0')
+                                << idx - start_idx);
+    ASSERT_NE(std::string::npos, line.find(expected)) << line;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Repeated error messages are suppressed like in synchronous mode
+//------------------------------------------------------------------------------
+TEST(Logging, AsyncRateLimit)
+{
+  eos::common::Logging& g_logging = eos::common::Logging::GetInstance();
+  g_logging.SetLogPriority(LOG_NOTICE);
+  g_logging.SetAsync(true);
+  unsigned long start_idx;
+  {
+    XrdSysMutexHelper scope_lock(g_logging.gMutex);
+    start_idx = g_logging.gLogCircularIndex[LOG_ERR];
+  }
+
+  for (int i = 0; i < 100; ++i) {
+    std::string rptr = eos_static_err("repeated error");
+    // only the first message is logged and returned
+    ASSERT_EQ(i == 0, !rptr.empty());
+  }
+
+  g_logging.SetAsync(false);
+  XrdSysMutexHelper scope_lock(g_logging.gMutex);
+  ASSERT_EQ(start_idx + 1, g_logging.gLogCircularIndex[LOG_ERR]);
+}
+
+//------------------------------------------------------------------------------
+// Arguments of disabled log statements are not evaluated
+//------------------------------------------------------------------------------
+TEST(Logging, LazyArguments)
+{
+  eos::common::Logging& g_logging = eos::common::Logging::GetInstance();
+  g_logging.SetLogPriority(LOG_INFO);
+  gEvaluated = 0;
+  ASSERT_STREQ("", eos_static_debug("dump=%s", Dump().c_str()));
+  ASSERT_FALSE(EOS_LOGS_DEBUG);
+  ASSERT_EQ(0, gEvaluated);
+  // unless debug messages are compiled out
+  bool compiled = (EOSCOMMONLOGGING_COMPILE_PRIORITY >= LOG_DEBUG);
+  g_logging.SetLogPriority(LOG_DEBUG);
+  ASSERT_EQ(compiled, strlen(eos_static_debug("dump=%s", Dump().c_str())) > 0);
+  ASSERT_EQ(compiled ? 1 : 0, gEvaluated);
+  g_logging.SetLogPriority(LOG_NOTICE);
+}
+
+//------------------------------------------------------------------------------
+// Cost of a disabled log statement
+//------------------------------------------------------------------------------
+TEST(Logging, DisabledLogBench)
+{
+  eos::common::Logging& g_logging = eos::common::Logging::GetInstance();
+  g_logging.SetLogPriority(LOG_INFO);
+  const int nloop = 1000000;
+  gEvaluated = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < nloop; ++i) {
+    eos_static_debug("dump=%s", Dump().c_str());
+  }
+
+  std::chrono::duration<double, std::nano> lazy =
+    std::chrono::steady_clock::now() - start;
+  ASSERT_EQ(0, gEvaluated);
+  start = std::chrono::steady_clock::now();
+
+  // what the macros did before: evaluate the arguments, then check the mask
+  for (int i = 0; i < nloop; ++i) {
+    g_logging.log(__FUNCTION__, __FILE__, __LINE__, "static",
+                  eos::common::Logging::gZeroVid, "", LOG_DEBUG, "dump=%s",
+                  Dump().c_str());
+  }
+
+  std::chrono::duration<double, std::nano> eager =
+    std::chrono::steady_clock::now() - start;
+  ASSERT_EQ(nloop, gEvaluated);
+  std::cout << "disabled debug statement: " << lazy.count() / nloop
+            << " ns, with argument evaluation: " << eager.count() / nloop
+            << " ns" << std::endl;
+  g_logging.SetLogPriority(LOG_NOTICE);
+}
@@ -23,9 +23,93 @@
 
 #include "gtest/gtest.h"
 #include "common/ThreadPool.hh"
+#include <array>
+#include <condition_variable>
+#include <functional>
+#include <queue>
+#include <set>
 
 using namespace eos::common;
 
+namespace
+{
+//------------------------------------------------------------------------------
+// Pool with a single locked queue of std::function tasks, the way the thread
+// pool worked before the work-stealing deques - used as benchmark baseline
+//------------------------------------------------------------------------------
+class SingleQueuePool
+{
+public:
+  explicit SingleQueuePool(unsigned int threads)
+  {
+    for (auto i = 0u; i < threads; i++) {
+      mThreads.emplace_back([this] {
+        while (true) {
+          std::shared_ptr<std::function<void(void)>> task;
+          {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCond.wait(lock, [this] { return !mTasks.empty(); });
+            task = mTasks.front();
+            mTasks.pop();
+          }
+
+          if (!task) {
+            break;
+          }
+
+          (*task)();
+        }
+      });
+    }
+  }
+
+  ~SingleQueuePool()
+  {
+    for (auto i = 0u; i < mThreads.size(); i++) {
+      Push(nullptr);
+    }
+
+    for (auto& thread : mThreads) {
+      thread.join();
+    }
+  }
+
+  template<typename Ret>
+  std::future<Ret> PushTask(std::function<Ret(void)> func)
+  {
+    auto task = std::make_shared<std::packaged_task<Ret(void)>>(func);
+    Push(std::make_shared<std::function<void(void)>>([task] {
+      (*task)();
+    }));
+    return task->get_future();
+  }
+
+private:
+  void Push(std::shared_ptr<std::function<void(void)>> task)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTasks.push(task);
+    mCond.notify_one();
+  }
+
+  std::vector<std::thread> mThreads;
+  std::mutex mMutex;
+  std::condition_variable mCond;
+  std::queue<std::shared_ptr<std::function<void(void)>>> mTasks;
+};
+
+//------------------------------------------------------------------------------
+// Wait until the counter reaches the given value
+//------------------------------------------------------------------------------
+void
+WaitFor(std::atomic<int>& counter, int value)
+{
+  while (counter.load() < value) {
+    std::this_thread::yield();
+  }
+}
+}
+
 TEST(ThreadPoolTest, PoolSizeTest)
 {
   ThreadPool pool(3, 3);
@@ -96,4 +180,182 @@ TEST(ThreadPoolTest, ScaleUpAndDownTest)
 
   // Check if we have scaled down to 2 threads
   ASSERT_EQ(2, threadIds.size());
-}
\ No newline at end of file
+}
+
+TEST(ThreadPoolTest, TaskStorageTest)
+{
+  // Small callables are stored inline, large ones on the heap
+  int calls = 0;
+  ThreadPool::Task small([&calls] { calls++; });
+  std::array<char, 256> big {{0}};
+  ThreadPool::Task large([&calls, big] { calls += 1 + big[0]; });
+  ThreadPool::Task moved(std::move(large));
+  ASSERT_FALSE(large);
+  ASSERT_TRUE(moved);
+  small();
+  moved();
+  ASSERT_EQ(2, calls);
+  // Move-only callables can be executed
+  ThreadPool pool(2, 2);
+  std::unique_ptr<int> value(new int(42));
+  std::promise<int> promise;
+  auto future = promise.get_future();
+  pool.Execute([v = std::move(value), p = std::move(promise)]() mutable {
+    p.set_value(*v);
+  });
+  ASSERT_EQ(42, future.get());
+  // Exceptions of executed tasks don't kill the worker
+  pool.Execute([] { throw std::runtime_error("task failure"); });
+  ASSERT_EQ(7, pool.PushTask<int>([] { return 7; }).get());
+}
+
+TEST(ThreadPoolTest, WorkStealingTest)
+{
+  ThreadPool pool(4, 4);
+  std::mutex mutex;
+  std::set<std::thread::id> threadIds;
+  std::atomic<int> done {0};
+  // Subtasks go to the deque of the blocked worker and are stolen by the
+  // other workers
+  pool.Execute([&] {
+    for (int i = 0; i < 100; i++) {
+      pool.Execute([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::lock_guard<std::mutex> lock(mutex);
+        threadIds.insert(std::this_thread::get_id());
+        done++;
+      });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  });
+  WaitFor(done, 100);
+  // At least one idle worker has to steal, how many do depends on scheduling
+  ASSERT_GE(threadIds.size(), 2u);
+}
+
+TEST(ThreadPoolTest, ExternalFifoOrderTest)
+{
+  ThreadPool pool(1, 1);
+  std::mutex mutex;
+  std::vector<int> order;
+  std::atomic<int> started {0};
+  std::atomic<int> done {0};
+  std::promise<void> gate;
+  std::shared_future<void> open = gate.get_future().share();
+  // Block the only worker so that all the following tasks are queued
+  pool.Execute([&started, open] {
+    started++;
+    open.wait();
+  });
+  WaitFor(started, 1);
+
+  for (int i = 0; i < 200; i++) {
+    pool.Execute([&, i] {
+      std::lock_guard<std::mutex> lock(mutex);
+      order.push_back(i);
+      done++;
+    });
+  }
+
+  gate.set_value();
+  WaitFor(done, 200);
+
+  // Tasks pushed from outside the pool complete in submission order
+  for (int i = 0; i < 200; i++) {
+    ASSERT_EQ(i, order[i]);
+  }
+}
+
+TEST(ThreadPoolTest, StopRunsQueuedTasksTest)
+{
+  std::atomic<int> done {0};
+  {
+    ThreadPool pool(2, 2);
+
+    for (int i = 0; i < 1000; i++) {
+      pool.Execute([&done] { done++; });
+    }
+  }
+  ASSERT_EQ(1000, done.load());
+}
+
+//------------------------------------------------------------------------------
+// Throughput of tiny tasks compared to a single locked queue - disabled in
+// the unit test run, use --gtest_also_run_disabled_tests to run it
+//------------------------------------------------------------------------------
+TEST(ThreadPoolTest, DISABLED_ThroughputBenchmark)
+{
+  const int numTasks = 200000;
+  const unsigned int numThreads = 4;
+  std::atomic<int> counter {0};
+  auto rate = [](std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() -
+                                            start;
+    return numTasks / elapsed.count() / 1e6;
+  };
+  {
+    SingleQueuePool pool(numThreads);
+    std::vector<std::future<void>> futures;
+    futures.reserve(numTasks);
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < numTasks; i++) {
+      futures.emplace_back(pool.PushTask<void>([&counter] { counter++; }));
+    }
+
+    for (auto& future : futures) {
+      future.get();
+    }
+
+    std::cout << "single queue PushTask   : " << rate(start) << " Mtasks/s"
+              << std::endl;
+  }
+  ThreadPool pool(numThreads, numThreads);
+  {
+    std::vector<std::future<void>> futures;
+    futures.reserve(numTasks);
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < numTasks; i++) {
+      futures.emplace_back(pool.PushTask<void>([&counter] { counter++; }));
+    }
+
+    for (auto& future : futures) {
+      future.get();
+    }
+
+    std::cout << "work stealing PushTask  : " << rate(start) << " Mtasks/s"
+              << std::endl;
+  }
+  {
+    counter = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < numTasks; i++) {
+      pool.Execute([&counter] { counter++; });
+    }
+
+    WaitFor(counter, numTasks);
+    std::cout << "work stealing Execute   : " << rate(start) << " Mtasks/s"
+              << std::endl;
+  }
+  {
+    // Tasks spawned by the workers stay in their own deques
+    counter = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned int t = 0; t < numThreads; t++) {
+      pool.Execute([&] {
+        for (int i = 0; i < numTasks / (int) numThreads; i++) {
+          pool.Execute([&counter] { counter++; });
+        }
+      });
+    }
+
+    WaitFor(counter, numTasks);
+    std::cout << "work stealing fan-out   : " << rate(start) << " Mtasks/s"
+              << std::endl;
+  }
+  ASSERT_EQ(numTasks, counter.load());
+}
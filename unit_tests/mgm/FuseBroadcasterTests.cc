@@ -0,0 +1,210 @@
+//------------------------------------------------------------------------------
+// File: FuseBroadcasterTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "mgm/FuseBroadcaster.hh"
+
+using eos::mgm::FuseBroadcaster;
+
+namespace
+{
+typedef std::vector<std::pair<std::string, eos::fusex::response>> sent_t;
+
+FuseBroadcaster::send_t Collect(sent_t& sent)
+{
+  return [&sent](const std::string & identity, const std::string & data) {
+    eos::fusex::response rsp;
+    ASSERT_TRUE(rsp.ParseFromString(data));
+    sent.push_back(std::make_pair(identity, rsp));
+  };
+}
+
+typedef std::vector<std::pair<uint64_t, std::string>> revoked_t;
+
+FuseBroadcaster::revoke_t Revoke(revoked_t& revoked)
+{
+  return [&revoked](uint64_t md_ino, const std::string & clientid) {
+    revoked.push_back(std::make_pair(md_ino, clientid));
+  };
+}
+
+void QueueMD(FuseBroadcaster& bc, const std::string& identity, bool batching,
+             uint64_t ino, uint64_t clock)
+{
+  eos::fusex::response rsp;
+  rsp.set_type(rsp.MD);
+  rsp.mutable_md_()->set_md_ino(ino);
+  rsp.mutable_md_()->set_clock(clock);
+  bc.QueueMD(identity, batching, rsp, 1, "client");
+}
+
+void QueueRelease(FuseBroadcaster& bc, const std::string& identity,
+                  uint64_t ino)
+{
+  eos::fusex::response rsp;
+  rsp.set_type(rsp.LEASE);
+  rsp.mutable_lease_()->set_type(eos::fusex::lease::RELEASECAP);
+  rsp.mutable_lease_()->set_md_ino(ino);
+  rsp.mutable_lease_()->set_clientid("client");
+  bc.QueueRelease(identity, false, rsp);
+}
+}
+
+//------------------------------------------------------------------------------
+// Test coalescing of updates within the window
+//------------------------------------------------------------------------------
+TEST(FuseBroadcaster, Coalesce)
+{
+  sent_t sent;
+  revoked_t revoked;
+  FuseBroadcaster bc(Collect(sent), Revoke(revoked), 2, std::chrono::seconds(3600));
+  QueueMD(bc, "a", false, 10, 1);
+  QueueRelease(bc, "a", 1);
+  QueueMD(bc, "a", false, 11, 2);
+  QueueMD(bc, "a", false, 10, 3);
+  QueueRelease(bc, "a", 1);
+  // nothing is sent before the end of the window
+  ASSERT_EQ(bc.Flush(FuseBroadcaster::clock_t::now()), 0u);
+  ASSERT_EQ(bc.Flush(FuseBroadcaster::clock_t::now(), true), 3u);
+  ASSERT_EQ(sent.size(), 3u);
+  // the latest update of an inode replaces the pending one and moves behind
+  // the responses queued in between
+  ASSERT_EQ(sent[0].second.md_().md_ino(), 11u);
+  ASSERT_EQ(sent[1].second.md_().md_ino(), 10u);
+  ASSERT_EQ(sent[1].second.md_().clock(), 3u);
+  ASSERT_EQ(sent[2].second.type(), eos::fusex::response::LEASE);
+  size_t pending = 0;
+  FuseBroadcaster::Stats stats = bc.GetStats(pending);
+  ASSERT_EQ(pending, 0u);
+  ASSERT_EQ(stats.mQueued, 5u);
+  ASSERT_EQ(stats.mCoalesced, 2u);
+  ASSERT_EQ(stats.mMessages, 3u);
+}
+
+//------------------------------------------------------------------------------
+// Test batching per client
+//------------------------------------------------------------------------------
+TEST(FuseBroadcaster, Batch)
+{
+  sent_t sent;
+  revoked_t revoked;
+  FuseBroadcaster bc(Collect(sent), Revoke(revoked), 1,
+                     std::chrono::milliseconds(0), 3);
+
+  for (uint64_t ino = 1; ino <= 5; ++ino) {
+    QueueMD(bc, "new", true, ino, 1);
+    QueueMD(bc, "old", false, ino, 1);
+  }
+
+  ASSERT_EQ(bc.Flush(FuseBroadcaster::clock_t::now() +
+                     std::chrono::milliseconds(1)), 7u);
+  std::vector<uint64_t> inos;
+
+  for (auto it = sent.begin(); it != sent.end(); ++it) {
+    if (it->first == "new") {
+      ASSERT_EQ(it->second.type(), eos::fusex::response::BATCH);
+
+      for (int i = 0; i < it->second.batch__size(); ++i) {
+        inos.push_back(it->second.batch_(i).md_().md_ino());
+      }
+    } else {
+      ASSERT_EQ(it->second.type(), eos::fusex::response::MD);
+    }
+  }
+
+  ASSERT_EQ(inos, std::vector<uint64_t>({1, 2, 3, 4, 5}));
+}
+
+//------------------------------------------------------------------------------
+// Test that a client falling behind gets its caps released
+//------------------------------------------------------------------------------
+TEST(FuseBroadcaster, Overflow)
+{
+  sent_t sent;
+  revoked_t revoked;
+  FuseBroadcaster bc(Collect(sent), Revoke(revoked), 1,
+                     std::chrono::seconds(3600), 256, 4);
+
+  for (uint64_t ino = 1; ino <= 5; ++ino) {
+    QueueMD(bc, "a", false, ino, 1);
+  }
+
+  // updates arriving after the overflow are still delivered
+  QueueMD(bc, "a", false, 6, 1);
+  ASSERT_EQ(bc.Flush(FuseBroadcaster::clock_t::now(), true), 2u);
+  ASSERT_EQ(sent[0].second.type(), eos::fusex::response::LEASE);
+  ASSERT_EQ(sent[0].second.lease_().md_ino(), 1u);
+  ASSERT_EQ(sent[0].second.lease_().clientid(), "client");
+  ASSERT_EQ(sent[1].second.md_().md_ino(), 6u);
+  size_t pending = 0;
+  FuseBroadcaster::Stats stats = bc.GetStats(pending);
+  ASSERT_EQ(stats.mDropped, 5u);
+  ASSERT_EQ(stats.mReleased, 1u);
+  // the released cap is revoked on the server once the release is sent
+  ASSERT_EQ(revoked, revoked_t({std::make_pair(1ul, std::string("client"))}));
+  ASSERT_TRUE(bc.Flush(FuseBroadcaster::clock_t::now(), true) == 0u);
+  ASSERT_EQ(revoked.size(), 1u);
+}
+
+//------------------------------------------------------------------------------
+// Test that a client gets at most max_send responses per window and that the
+// backlog leads to an overflow
+//------------------------------------------------------------------------------
+TEST(FuseBroadcaster, SendLimit)
+{
+  sent_t sent;
+  revoked_t revoked;
+  FuseBroadcaster bc(Collect(sent), Revoke(revoked), 1,
+                     std::chrono::milliseconds(10), 256, 6, 2);
+  FuseBroadcaster::clock_t::time_point now = FuseBroadcaster::clock_t::now();
+
+  for (uint64_t ino = 1; ino <= 3; ++ino) {
+    QueueMD(bc, "a", false, ino, 1);
+  }
+
+  QueueMD(bc, "b", false, 1, 1);
+  now += std::chrono::seconds(10);
+  ASSERT_EQ(bc.Flush(now), 3u);
+  ASSERT_EQ(sent[0].second.md_().md_ino(), 1u);
+  ASSERT_EQ(sent[1].second.md_().md_ino(), 2u);
+  ASSERT_EQ(sent[2].first, "b");
+  size_t pending = 0;
+  bc.GetStats(pending);
+  ASSERT_EQ(pending, 1u);
+  // the queued update still coalesces with newer ones
+  QueueMD(bc, "a", false, 3, 2);
+  ASSERT_EQ(bc.Flush(now), 0u);
+  now += std::chrono::seconds(10);
+  ASSERT_EQ(bc.Flush(now), 1u);
+  ASSERT_EQ(sent[3].second.md_().md_ino(), 3u);
+  ASSERT_EQ(sent[3].second.md_().clock(), 2u);
+  // a client receiving more than it is sent per window overflows
+  sent.clear();
+
+  for (uint64_t ino = 1; ino <= 7; ++ino) {
+    QueueMD(bc, "a", false, ino, 1);
+  }
+
+  ASSERT_EQ(bc.Flush(now, true), 1u);
+  ASSERT_EQ(sent[0].second.type(), eos::fusex::response::LEASE);
+  ASSERT_EQ(revoked.size(), 1u);
+}
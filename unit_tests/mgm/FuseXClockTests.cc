@@ -0,0 +1,52 @@
+//------------------------------------------------------------------------------
+// File: FuseXClockTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "mgm/FuseServer.hh"
+
+using eos::mgm::FuseServer;
+
+//------------------------------------------------------------------------------
+// Clients not sending mgm.ifclock always get the md
+//------------------------------------------------------------------------------
+TEST(FuseXClock, WithoutIfClock)
+{
+  ASSERT_FALSE(FuseServer::UnchangedSinceClock(false, "GET", 1234, 1234));
+  ASSERT_FALSE(FuseServer::UnchangedSinceClock(false, "LS", 1234, 1234));
+  ASSERT_FALSE(FuseServer::UnchangedSinceClock(false, "GET", 1234, 1235));
+}
+
+//------------------------------------------------------------------------------
+// Clients sending mgm.ifclock get EEXIST for an unchanged md
+//------------------------------------------------------------------------------
+TEST(FuseXClock, WithIfClock)
+{
+  ASSERT_TRUE(FuseServer::UnchangedSinceClock(true, "GET", 1234, 1234));
+  ASSERT_TRUE(FuseServer::UnchangedSinceClock(true, "LS", 1234, 1234));
+  // changed md
+  ASSERT_FALSE(FuseServer::UnchangedSinceClock(true, "GET", 1234, 1235));
+  ASSERT_FALSE(FuseServer::UnchangedSinceClock(true, "LS", 1235, 1234));
+  // no clock known by the client
+  ASSERT_FALSE(FuseServer::UnchangedSinceClock(true, "GET", 0, 0));
+  // caps are always returned
+  ASSERT_FALSE(FuseServer::UnchangedSinceClock(true, "GETCAP", 1234, 1234));
+}
@@ -0,0 +1,46 @@
+//------------------------------------------------------------------------------
+// File: FuseXListingTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "mgm/FuseServer.hh"
+
+using eos::mgm::FuseServer;
+
+//------------------------------------------------------------------------------
+// Clients not sending mgm.lspage get a listing in a single container
+//------------------------------------------------------------------------------
+TEST(FuseXListing, WithoutPages)
+{
+  ASSERT_FALSE(FuseServer::ListingPageFull(false, 1));
+  ASSERT_FALSE(FuseServer::ListingPageFull(false, 128));
+  ASSERT_FALSE(FuseServer::ListingPageFull(false, 100000));
+}
+
+//------------------------------------------------------------------------------
+// Clients sending mgm.lspage get pages of 128 entries
+//------------------------------------------------------------------------------
+TEST(FuseXListing, WithPages)
+{
+  ASSERT_FALSE(FuseServer::ListingPageFull(true, 1));
+  ASSERT_FALSE(FuseServer::ListingPageFull(true, 127));
+  ASSERT_TRUE(FuseServer::ListingPageFull(true, 128));
+}
@@ -0,0 +1,57 @@
+//------------------------------------------------------------------------------
+// File: InlineFileTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "mgm/XrdMgmOfsFile.hh"
+#include "common/Constants.hh"
+#include "common/SymKeys.hh"
+#include <errno.h>
+
+//------------------------------------------------------------------------------
+// Decoding of the contents of inline-only files served by the MGM
+//------------------------------------------------------------------------------
+TEST(InlineFile, GetInlineContents)
+{
+  std::map<std::string, std::string> xattrs;
+  xattrs[eos::common::INLINE_ONLY_ATTR_NAME] = "1";
+  std::string contents = "small file contents";
+  std::string encoded;
+  std::string out;
+  // an empty file has no buffer
+  ASSERT_EQ(0, XrdMgmOfsFile::GetInlineContents(xattrs, 0, out));
+  ASSERT_TRUE(out.empty());
+  ASSERT_EQ(ENODATA, XrdMgmOfsFile::GetInlineContents(xattrs, 10, out));
+  ASSERT_TRUE(eos::common::SymKey::Base64(contents, encoded));
+  xattrs[eos::common::INLINE_BUFFER_ATTR_NAME] = encoded;
+  ASSERT_EQ(0, XrdMgmOfsFile::GetInlineContents(xattrs, contents.size(), out));
+  ASSERT_EQ(contents, out);
+  ASSERT_TRUE(eos::common::SymKey::ZBase64(contents, encoded));
+  xattrs[eos::common::INLINE_BUFFER_ATTR_NAME] = encoded;
+  ASSERT_EQ(0, XrdMgmOfsFile::GetInlineContents(xattrs, contents.size(), out));
+  ASSERT_EQ(contents, out);
+  // a buffer not matching the file size is not served
+  ASSERT_EQ(EIO, XrdMgmOfsFile::GetInlineContents(xattrs, contents.size() + 1,
+            out));
+  ASSERT_TRUE(out.empty());
+  xattrs[eos::common::INLINE_BUFFER_ATTR_NAME] = contents;
+  ASSERT_EQ(EIO, XrdMgmOfsFile::GetInlineContents(xattrs, contents.size(), out));
+}
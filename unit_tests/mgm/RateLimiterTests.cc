@@ -0,0 +1,189 @@
+//------------------------------------------------------------------------------
+// File: RateLimiterTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "mgm/RateLimiter.hh"
+
+//------------------------------------------------------------------------------
+// Test parsing of rate limiting rules
+//------------------------------------------------------------------------------
+TEST(RateLimiter, ParseRule)
+{
+  using eos::mgm::RateLimiter;
+  RateLimiter::Rule rule;
+  ASSERT_FALSE(RateLimiter::ParseRule("rate:user:*:Stat", "100", rule));
+  ASSERT_FALSE(RateLimiter::ParseRule("bucket:user:*", "100", rule));
+  ASSERT_FALSE(RateLimiter::ParseRule("bucket:dummy:*:stat", "100", rule));
+  ASSERT_FALSE(RateLimiter::ParseRule("bucket:user:*:stat", "0", rule));
+  ASSERT_FALSE(RateLimiter::ParseRule("bucket:user:*:stat", "abc", rule));
+  ASSERT_FALSE(RateLimiter::ParseRule("bucket:user:*:stat", "10:", rule));
+  ASSERT_FALSE(RateLimiter::ParseRule("bucket:user:*:stat", "10:5x", rule));
+  ASSERT_TRUE(RateLimiter::ParseRule("bucket:user:*:stat", "100", rule));
+  ASSERT_EQ(RateLimiter::Target::USER, rule.mTarget);
+  ASSERT_EQ("*", rule.mId);
+  ASSERT_EQ("stat", rule.mOp);
+  ASSERT_EQ(100, rule.mRate);
+  ASSERT_EQ(100, rule.mBurst);
+  ASSERT_TRUE(RateLimiter::ParseRule("bucket:host:lxplus.cern.ch:w", "0.5:20",
+                                     rule));
+  ASSERT_EQ(RateLimiter::Target::HOST, rule.mTarget);
+  ASSERT_EQ("lxplus.cern.ch", rule.mId);
+  ASSERT_EQ("w", rule.mOp);
+  ASSERT_EQ(0.5, rule.mRate);
+  ASSERT_EQ(20, rule.mBurst);
+}
+
+//------------------------------------------------------------------------------
+// Test token bucket burst and refill behaviour
+//------------------------------------------------------------------------------
+TEST(RateLimiter, TokenBucket)
+{
+  using eos::mgm::TokenBucket;
+  // 10 Hz with a burst of 5 requests
+  TokenBucket bucket(10, 5);
+  int64_t now = 1000000000;
+  int64_t wait_ns = 0;
+
+  for (int i = 0; i < 5; ++i) {
+    ASSERT_TRUE(bucket.Consume(now, wait_ns));
+  }
+
+  ASSERT_FALSE(bucket.Consume(now, wait_ns));
+  ASSERT_EQ(100000000, wait_ns);
+  ASSERT_EQ(5u, bucket.mAccepted.load());
+  ASSERT_EQ(1u, bucket.mRejected.load());
+  // After 100ms one new token is available
+  now += 100000000;
+  ASSERT_TRUE(bucket.Consume(now, wait_ns));
+  ASSERT_FALSE(bucket.Consume(now, wait_ns));
+  // After one second the bucket is full again
+  now += 1000000000;
+  ASSERT_DOUBLE_EQ(5.0, bucket.GetTokens(now));
+}
+
+//------------------------------------------------------------------------------
+// Test rule matching for wildcard and dedicated rules
+//------------------------------------------------------------------------------
+TEST(RateLimiter, Allow)
+{
+  using eos::mgm::RateLimiter;
+  RateLimiter limiter;
+  eos::common::Mapping::VirtualIdentity vid;
+  vid.uid_string = "dummy";
+  vid.gid_string = "dgroup";
+  vid.host = "localhost";
+  std::map<std::string, std::string> rules {
+    {"*", "60"},
+    {"bucket:user:*:stat", "1:2"},
+    {"bucket:user:admin:stat", "1000"}
+  };
+  limiter.SetRules(rules);
+  ASSERT_TRUE(limiter.IsActive());
+  int stalltime = 0;
+  std::string rule_key;
+  // Not matching operation
+  ASSERT_TRUE(limiter.Allow("open", 0, vid, stalltime, rule_key));
+  ASSERT_TRUE(limiter.Allow("stat", 0, vid, stalltime, rule_key));
+  ASSERT_TRUE(limiter.Allow("stat", 0, vid, stalltime, rule_key));
+  ASSERT_FALSE(limiter.Allow("stat", 0, vid, stalltime, rule_key));
+  ASSERT_EQ(1, stalltime);
+  ASSERT_EQ("bucket:user:*:stat", rule_key);
+  // Other users have their own bucket
+  vid.uid_string = "other";
+  ASSERT_TRUE(limiter.Allow("stat", 0, vid, stalltime, rule_key));
+  // Dedicated rule overrides the wildcard one
+  vid.uid_string = "admin";
+
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(limiter.Allow("stat", 0, vid, stalltime, rule_key));
+  }
+
+  limiter.SetRules({});
+  ASSERT_FALSE(limiter.IsActive());
+  vid.uid_string = "dummy";
+  ASSERT_TRUE(limiter.Allow("stat", 0, vid, stalltime, rule_key));
+}
+
+//------------------------------------------------------------------------------
+// Test that a request rejected by one bucket does not consume tokens from the
+// other matching buckets and is accounted only once
+//------------------------------------------------------------------------------
+TEST(RateLimiter, AllOrNothing)
+{
+  using eos::mgm::RateLimiter;
+  RateLimiter limiter;
+  eos::common::Mapping::VirtualIdentity vid;
+  vid.uid_string = "dummy";
+  vid.gid_string = "dgroup";
+  vid.host = "localhost";
+  std::map<std::string, std::string> rules {
+    {"bucket:user:*:stat", "1:5"},
+    {"bucket:host:*:stat", "1:1"}
+  };
+  limiter.SetRules(rules);
+  int stalltime = 0;
+  std::string rule_key;
+  ASSERT_TRUE(limiter.Allow("stat", 0, vid, stalltime, rule_key));
+
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_FALSE(limiter.Allow("stat", 0, vid, stalltime, rule_key));
+    ASSERT_EQ("bucket:host:*:stat", rule_key);
+  }
+
+  std::string out;
+  limiter.Print(out, true);
+  ASSERT_NE(std::string::npos, out.find("bucket.rule=bucket:user:*:stat "
+                                        "bucket.id=dummy"));
+  ASSERT_NE(std::string::npos, out.find("bucket.burst=5.00 bucket.tokens=4."));
+  ASSERT_NE(std::string::npos, out.find("bucket.accepted=1 bucket.rejected=0"));
+  ASSERT_NE(std::string::npos, out.find("bucket.accepted=1 bucket.rejected=3"));
+  // Another host still has four tokens of the user bucket available
+  vid.host = "otherhost";
+  ASSERT_TRUE(limiter.Allow("stat", 0, vid, stalltime, rule_key));
+}
+
+//------------------------------------------------------------------------------
+// Test dropping of idle buckets
+//------------------------------------------------------------------------------
+TEST(RateLimiter, PruneIdle)
+{
+  using eos::mgm::RateLimiter;
+  using eos::mgm::TokenBucket;
+  RateLimiter limiter(std::chrono::seconds(10));
+  eos::common::Mapping::VirtualIdentity vid;
+  vid.gid_string = "dgroup";
+  vid.host = "localhost";
+  limiter.SetRules({{"bucket:user:*:*", "1:1"}});
+  int stalltime = 0;
+  std::string rule_key;
+
+  for (int i = 0; i < 100; ++i) {
+    vid.uid_string = "user" + std::to_string(i);
+    ASSERT_TRUE(limiter.Allow("stat", 0, vid, stalltime, rule_key));
+  }
+
+  ASSERT_EQ(100u, limiter.GetNumBuckets());
+  int64_t now = TokenBucket::Now();
+  ASSERT_EQ(0u, limiter.PruneIdle(now));
+  ASSERT_EQ(100u, limiter.PruneIdle(now + 20000000000ll));
+  ASSERT_EQ(0u, limiter.GetNumBuckets());
+}
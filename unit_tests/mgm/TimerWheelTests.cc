@@ -0,0 +1,80 @@
+//------------------------------------------------------------------------------
+// File: TimerWheelTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "mgm/TimerWheel.hh"
+#include <string>
+
+//------------------------------------------------------------------------------
+// Test that keys are handed out once their deadline passed
+//------------------------------------------------------------------------------
+TEST(TimerWheel, Expiry)
+{
+  eos::mgm::TimerWheel<std::string> wheel(16);
+  std::vector<std::string> due;
+  time_t now = 1000;
+  wheel.Insert("a", now + 1);
+  wheel.Insert("b", now + 5);
+  wheel.Insert("b", now + 5);
+  ASSERT_EQ(wheel.Size(), 2u);
+  // the first advance visits everything scheduled so far
+  wheel.Advance(now, due);
+  ASSERT_EQ(due.size(), 2u);
+  ASSERT_EQ(wheel.Size(), 0u);
+  due.clear();
+  wheel.Insert("a", now + 1);
+  wheel.Insert("b", now + 5);
+  wheel.Advance(now, due);
+  ASSERT_TRUE(due.empty());
+  wheel.Advance(now + 1, due);
+  ASSERT_EQ(due, std::vector<std::string>({"a"}));
+  due.clear();
+  wheel.Advance(now + 4, due);
+  ASSERT_TRUE(due.empty());
+  wheel.Advance(now + 5, due);
+  ASSERT_EQ(due, std::vector<std::string>({"b"}));
+  ASSERT_EQ(wheel.Size(), 0u);
+}
+
+//------------------------------------------------------------------------------
+// Test deadlines in the past and beyond the horizon of the wheel
+//------------------------------------------------------------------------------
+TEST(TimerWheel, Horizon)
+{
+  eos::mgm::TimerWheel<int> wheel(10);
+  std::vector<int> due;
+  time_t now = 1000;
+  wheel.Advance(now, due);
+  // a deadline in the past is due with the next advance
+  wheel.Insert(1, now - 100);
+  // a deadline beyond the horizon shows up early in its slot
+  wheel.Insert(2, now + 17);
+  wheel.Advance(now + 1, due);
+  ASSERT_EQ(due, std::vector<int>({1, 2}));
+  due.clear();
+  // a large gap visits every slot once
+  wheel.Insert(3, now + 5);
+  wheel.Insert(4, now + 9);
+  wheel.Advance(now + 1000, due);
+  ASSERT_EQ(due.size(), 2u);
+  ASSERT_EQ(wheel.Size(), 0u);
+}
@@ -0,0 +1,191 @@
+//------------------------------------------------------------------------------
+// File: XrdMqChangeNotifierTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "mq/XrdMqSharedObject.hh"
+
+//------------------------------------------------------------------------------
+//! Fixture giving access to the matching of the change notifier without
+//! running the listener thread
+//------------------------------------------------------------------------------
+class XrdMqChangeNotifierTest: public ::testing::Test
+{
+protected:
+  typedef XrdMqSharedObjectChangeNotifier Notifier;
+
+  XrdMqSharedObjectManager mSom;
+  Notifier mNotifier;
+
+  void SetUp() override
+  {
+    mNotifier.SetShareObjectManager(&mSom);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Start the notification of the given subscriber with its watch items
+  //----------------------------------------------------------------------------
+  void Start(const std::string& subscriber)
+  {
+    mNotifier.BindCurrentThread(subscriber);
+    ASSERT_TRUE(mNotifier.StartNotifyCurrentThread());
+  }
+
+  //----------------------------------------------------------------------------
+  //! Dispatch a notification and get the names of the notified subscribers
+  //----------------------------------------------------------------------------
+  std::multiset<std::string> Dispatch(const std::string& subject,
+                                      XrdMqSharedObjectManager::notification_t type)
+  {
+    std::map<Notifier::Subscriber*,
+        std::vector<XrdMqSharedObjectManager::Notification>> pending;
+    XrdSysMutexHelper lock(mNotifier.WatchMutex);
+
+    if (mNotifier.mWatchDirty) {
+      mNotifier.BuildWatchIndex();
+    }
+
+    mNotifier.Dispatch(XrdMqSharedObjectManager::Notification(subject, type),
+                       pending);
+    std::multiset<std::string> names;
+
+    for (auto it = pending.begin(); it != pending.end(); ++it) {
+      for (size_t i = 0; i < it->second.size(); ++i) {
+        EXPECT_EQ(subject, it->second[i].mSubject);
+        names.insert(it->first->Name);
+      }
+    }
+
+    return names;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Exact and regular expression matches of keys and subjects
+//------------------------------------------------------------------------------
+TEST_F(XrdMqChangeNotifierTest, KeyAndSubjectMatch)
+{
+  const auto modification = XrdMqSharedObjectManager::kMqSubjectModification;
+  const auto creation = XrdMqSharedObjectManager::kMqSubjectCreation;
+  ASSERT_TRUE(mNotifier.SubscribesToKey("key", "stat.active",
+                                        Notifier::kMqSubjectModification));
+  ASSERT_TRUE(mNotifier.SubscribesToKeyRegex("regex", "^stat\\.disk\\.",
+              Notifier::kMqSubjectModification));
+  ASSERT_TRUE(mNotifier.SubscribesToSubject("subject", "/eos/fst1/fst",
+              Notifier::kMqSubjectCreation));
+  Start("key");
+  Start("regex");
+  Start("subject");
+  ASSERT_EQ(std::multiset<std::string>({"key"}),
+            Dispatch("/eos/fst1/fst;stat.active", modification));
+  ASSERT_TRUE(Dispatch("/eos/fst1/fst;stat.active.since", modification).empty());
+  // the key regex matches prefixes but not the same characters elsewhere
+  ASSERT_EQ(std::multiset<std::string>({"regex"}),
+            Dispatch("/eos/fst1/fst;stat.disk.load", modification));
+  ASSERT_TRUE(Dispatch("/eos/fst1/fst;stat.sys.disk.load", modification).empty());
+  // watch items only match their notification type
+  ASSERT_TRUE(Dispatch("/eos/fst1/fst;stat.active", creation).empty());
+  ASSERT_EQ(std::multiset<std::string>({"subject"}),
+            Dispatch("/eos/fst1/fst", creation));
+  ASSERT_TRUE(Dispatch("/eos/fst2/fst", creation).empty());
+}
+
+//------------------------------------------------------------------------------
+// Subject regex subscribed once the notification is running - the regex used
+// to be left uncompiled and was then compared as an exact subject
+//------------------------------------------------------------------------------
+TEST_F(XrdMqChangeNotifierTest, SubjectRegexAfterStart)
+{
+  const auto deletion = XrdMqSharedObjectManager::kMqSubjectDeletion;
+  ASSERT_TRUE(mNotifier.SubscribesToKey("late", "dummy",
+                                        Notifier::kMqSubjectDeletion));
+  Start("late");
+  ASSERT_TRUE(mNotifier.SubscribesToSubjectRegex("late", "^/eos/.*/fst$",
+              Notifier::kMqSubjectDeletion));
+  ASSERT_EQ(std::multiset<std::string>({"late"}),
+            Dispatch("/eos/fst1:1095/fst", deletion));
+  ASSERT_TRUE(Dispatch("/eos/fst1:1095/fst/extra", deletion).empty());
+  ASSERT_TRUE(Dispatch("^/eos/.*/fst$", deletion).empty());
+  // a malformed regex is rejected and does not crash the matching
+  ASSERT_FALSE(mNotifier.SubscribesToSubjectRegex("late", "/eos/(",
+               Notifier::kMqSubjectDeletion));
+  ASSERT_EQ(std::multiset<std::string>({"late"}),
+            Dispatch("/eos/fst2:1095/fst", deletion));
+  // unsubscribing takes effect for the next dispatch
+  ASSERT_TRUE(mNotifier.UnsubscribesToSubjectRegex("late", "^/eos/.*/fst$",
+              Notifier::kMqSubjectDeletion));
+  ASSERT_TRUE(Dispatch("/eos/fst1:1095/fst", deletion).empty());
+}
+
+//------------------------------------------------------------------------------
+// Subject x key watches and subscribers matching several watch items
+//------------------------------------------------------------------------------
+TEST_F(XrdMqChangeNotifierTest, SubjectAndKeyMatch)
+{
+  const auto modification = XrdMqSharedObjectManager::kMqSubjectModification;
+  ASSERT_TRUE(mNotifier.SubscribesToSubjectAndKey("xkey", "/eos/fst1/fst",
+              "stat.errc", Notifier::kMqSubjectModification));
+  ASSERT_TRUE(mNotifier.SubscribesToKey("multi", "stat.errc",
+                                        Notifier::kMqSubjectModification));
+  ASSERT_TRUE(mNotifier.SubscribesToKeyRegex("multi", "errc$",
+              Notifier::kMqSubjectModification));
+  ASSERT_TRUE(mNotifier.SubscribesToSubject("multi", "/eos/fst1/fst",
+              Notifier::kMqSubjectModification));
+  Start("xkey");
+  Start("multi");
+  // every subscriber is notified once even if several of its items match
+  ASSERT_EQ(std::multiset<std::string>({"multi", "xkey"}),
+            Dispatch("/eos/fst1/fst;stat.errc", modification));
+  ASSERT_EQ(std::multiset<std::string>({"multi"}),
+            Dispatch("/eos/fst2/fst;stat.errc", modification));
+  ASSERT_EQ(std::multiset<std::string>({"multi"}),
+            Dispatch("/eos/fst1/fst;stat.geotag", modification));
+}
+
+//------------------------------------------------------------------------------
+// Strict modifications are only notified when the value changes
+//------------------------------------------------------------------------------
+TEST_F(XrdMqChangeNotifierTest, StrictChange)
+{
+  const auto modification = XrdMqSharedObjectManager::kMqSubjectModification;
+  ASSERT_TRUE(mNotifier.SubscribesToKey("strict", "stat.active",
+                                        Notifier::kMqSubjectStrictModification));
+  Start("strict");
+  // no hash for the subject, nothing to compare with
+  ASSERT_TRUE(Dispatch("/eos/fst1/fst;stat.active", modification).empty());
+  ASSERT_TRUE(mSom.CreateSharedHash("/eos/fst1/fst", "", &mSom));
+  XrdMqSharedHash* hash = nullptr;
+  {
+    XrdMqRWMutexReadLock lock(mSom.HashMutex);
+    hash = mSom.GetObject("/eos/fst1/fst", "hash");
+  }
+  ASSERT_TRUE(hash != nullptr);
+  hash->Set("stat.active", std::string("online"), false);
+  ASSERT_EQ(std::multiset<std::string>({"strict"}),
+            Dispatch("/eos/fst1/fst;stat.active", modification));
+  ASSERT_TRUE(Dispatch("/eos/fst1/fst;stat.active", modification).empty());
+  hash->Set("stat.active", std::string("offline"), false);
+  ASSERT_EQ(std::multiset<std::string>({"strict"}),
+            Dispatch("/eos/fst1/fst;stat.active", modification));
+  // only the strict modifications are looked at for the value
+  ASSERT_TRUE(Dispatch("/eos/fst1/fst;stat.active",
+                       XrdMqSharedObjectManager::kMqSubjectKeyDeletion).empty());
+}
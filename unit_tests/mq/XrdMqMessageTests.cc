@@ -185,3 +185,45 @@ TEST(XrdMqMessage, RSATest)
   free(encrypted_data);
   free(decrypted_data);
 }
+
+//------------------------------------------------------------------------------
+// HMAC sign and verify test
+//------------------------------------------------------------------------------
+TEST(XrdMqMessage, HmacSignTest)
+{
+  ASSERT_FALSE(XrdMqMessage::SetHmacSecret(""));
+  ASSERT_TRUE(XrdMqMessage::SetHmacSecret("shared instance secret"));
+  std::string key_id = XrdMqMessage::HmacKeyId;
+  XrdMqMessage::kFastSign = true;
+
+  for (int i = 0; i < 3; ++i) {
+    XrdMqMessage message("HmacTest");
+    std::string body = "mqtest=testmessage" + std::to_string(i);
+    message.SetBody(body.c_str());
+    ASSERT_TRUE(message.Sign());
+    std::string raw = message.GetMessageBuffer();
+    ASSERT_NE(std::string::npos, raw.find("hmac:" + key_id + ":"));
+    XrdOucString sraw = raw.c_str();
+    XrdMqMessage received(sraw);
+    ASSERT_TRUE(received.Verify());
+    ASSERT_EQ(body, received.GetBody());
+    // a modified body is rejected
+    raw.replace(raw.find("testmessage"), 4, "TEST");
+    XrdOucString stampered = raw.c_str();
+    XrdMqMessage tampered(stampered);
+    ASSERT_FALSE(tampered.Verify());
+  }
+
+  // a receiver with a different secret rejects the message
+  XrdMqMessage message("HmacTest");
+  message.SetBody("mqtest=testmessage");
+  ASSERT_TRUE(message.Sign());
+  XrdOucString raw = message.GetMessageBuffer();
+  ASSERT_TRUE(XrdMqMessage::SetHmacSecret("other instance secret"));
+  ASSERT_NE(key_id, XrdMqMessage::HmacKeyId);
+  XrdMqMessage received(raw);
+  ASSERT_FALSE(received.Verify());
+  XrdMqMessage::kFastSign = false;
+  XrdMqMessage::HmacKey.clear();
+  XrdMqMessage::HmacKeyId.clear();
+}
@@ -0,0 +1,115 @@
+//------------------------------------------------------------------------------
+// File: XrdMqSharedHashCodecTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "mq/XrdMqSharedHashCodec.hh"
+
+TEST(XrdMqSharedHashCodec, TypedValues)
+{
+  int64_t number;
+  uint8_t scale;
+  ASSERT_TRUE(XrdMqSharedHashCodec::ParseInteger("0", number));
+  ASSERT_EQ(0, number);
+  ASSERT_TRUE(XrdMqSharedHashCodec::ParseInteger("-1234567890123", number));
+  ASSERT_EQ(-1234567890123ll, number);
+  ASSERT_FALSE(XrdMqSharedHashCodec::ParseInteger("007", number));
+  ASSERT_FALSE(XrdMqSharedHashCodec::ParseInteger("-0", number));
+  ASSERT_FALSE(XrdMqSharedHashCodec::ParseInteger("12a", number));
+  ASSERT_FALSE(XrdMqSharedHashCodec::ParseInteger("", number));
+  ASSERT_TRUE(XrdMqSharedHashCodec::ParseDecimal("0.05", number, scale));
+  ASSERT_EQ(5, number);
+  ASSERT_EQ(2, scale);
+  ASSERT_TRUE(XrdMqSharedHashCodec::ParseDecimal("-12.500", number, scale));
+  ASSERT_EQ(-12500, number);
+  ASSERT_EQ(3, scale);
+  ASSERT_FALSE(XrdMqSharedHashCodec::ParseDecimal("-0.0", number, scale));
+  ASSERT_FALSE(XrdMqSharedHashCodec::ParseDecimal(".5", number, scale));
+  ASSERT_FALSE(XrdMqSharedHashCodec::ParseDecimal("5.", number, scale));
+  ASSERT_FALSE(XrdMqSharedHashCodec::ParseDecimal("1.2.3", number, scale));
+  ASSERT_FALSE(XrdMqSharedHashCodec::ParseDecimal("1e5", number, scale));
+}
+
+TEST(XrdMqSharedHashCodec, RoundTrip)
+{
+  XrdMqSharedHashCodec::pairs_t input = {
+    {"stat.disk.iops", "120"},
+    {"stat.disk.load", "0.37"},
+    {"stat.disk.readratemb", "-3.000"},
+    {"stat.errc", "007"},
+    {"stat.geotag", "cern::0513"},
+    {"stat.sys.kernel", ""},
+    {"#1#stat.active", "online"}
+  };
+  XrdMqSharedHashCodec codec;
+
+  for (auto it = input.begin(); it != input.end(); ++it) {
+    codec.Add(it->first, it->second);
+  }
+
+  ASSERT_EQ(input.size(), codec.Count());
+  XrdMqSharedHashCodec::pairs_t output;
+  ASSERT_TRUE(XrdMqSharedHashCodec::Decode(codec.Data().c_str(), codec.Size(),
+              output));
+  ASSERT_EQ(input, output);
+  // the shared key prefixes and typed numbers make it smaller than the pairs
+  size_t plain = 0;
+
+  for (auto it = input.begin(); it != input.end(); ++it) {
+    plain += it->first.length() + it->second.length() + 2;
+  }
+
+  ASSERT_LT(codec.Size(), plain);
+  // corrupted or truncated input is rejected
+  output.clear();
+
+  for (size_t len = 1; len < codec.Size(); ++len) {
+    XrdMqSharedHashCodec::pairs_t partial;
+
+    if (XrdMqSharedHashCodec::Decode(codec.Data().c_str(), len, partial)) {
+      ASSERT_LT(partial.size(), input.size());
+    }
+  }
+
+  std::string data = codec.Data();
+  data[0] = 0x7f;
+  ASSERT_FALSE(XrdMqSharedHashCodec::Decode(data.c_str(), data.size(), output));
+  codec.Reset();
+  ASSERT_EQ(0u, codec.Count());
+  ASSERT_EQ(1u, codec.Size());
+}
+
+TEST(XrdMqSharedHashCodec, Env)
+{
+  XrdMqSharedHashCodec codec;
+  codec.Add("stat.publishtimestamp", "1528798591123");
+  codec.Add("stat.boot", "booted");
+  std::string encoded;
+  ASSERT_TRUE(codec.ToEnv(encoded));
+  ASSERT_EQ(std::string::npos, encoded.find('&'));
+  XrdMqSharedHashCodec::pairs_t output;
+  ASSERT_TRUE(XrdMqSharedHashCodec::FromEnv(encoded.c_str(), output));
+  ASSERT_EQ(2u, output.size());
+  ASSERT_EQ("stat.publishtimestamp", output[0].first);
+  ASSERT_EQ("1528798591123", output[0].second);
+  ASSERT_EQ("stat.boot", output[1].first);
+  ASSERT_EQ("booted", output[1].second);
+}